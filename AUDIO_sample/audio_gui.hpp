@@ -22,6 +22,7 @@
 
 #include "sound/tag.hpp"
 #include "sound/af_play.hpp"
+#include "sound/media_index.hpp"
 
 #include "chip/FAMIPAD.hpp"
 #include "chip/FT5206.hpp"
@@ -151,6 +152,17 @@ namespace app {
 		typedef img::img_in<SCALING> IMG_IN;
 		IMG_IN		img_in_;
 
+	public:
+		typedef sound::media_index<> MEDIA_INDEX;
+
+	private:
+		static const int16_t THUMB_W = 64;
+		static const int16_t THUMB_H = 64;
+
+		MEDIA_INDEX*	index_;
+		uint16_t		thumb_[THUMB_W * THUMB_H];
+		static_assert(sizeof(thumb_) == MEDIA_INDEX::THUMB_SIZE, "Thumbnail size mismatch");
+
 		uint32_t	ctrl_;
 
 		char		path_[256];
@@ -187,6 +199,46 @@ namespace app {
 		int16_t		peak_hold_l_;
 		int16_t		peak_hold_r_;
 
+		// インデックスのサムネイルを LCD_Y × LCD_Y に拡大（バイリニア）して描画
+		bool render_thumb_() noexcept
+		{
+			if(index_ == nullptr) return false;
+			MEDIA_INDEX::record_t rec;
+			if(!index_->find(path_tag_, rec)) return false;
+			if(!index_->read_thumb(rec.thumb, thumb_)) return false;
+
+			render_.flush();
+			static const int32_t step = (THUMB_W << 16) / LCD_Y;
+			for(int16_t y = 0; y < LCD_Y; ++y) {
+				int32_t fy = y * step + step / 2 - 0x8000;
+				if(fy < 0) fy = 0;
+				int32_t y0 = std::min(static_cast<int32_t>(fy >> 16), static_cast<int32_t>(THUMB_H - 1));
+				int32_t y1 = std::min(y0 + 1, static_cast<int32_t>(THUMB_H - 1));
+				int32_t wy = (fy >> 8) & 0xff;
+				const auto* l0 = &thumb_[y0 * THUMB_W];
+				const auto* l1 = &thumb_[y1 * THUMB_W];
+				for(int16_t x = 0; x < LCD_Y; ++x) {
+					int32_t fx = x * step + step / 2 - 0x8000;
+					if(fx < 0) fx = 0;
+					int32_t x0 = std::min(static_cast<int32_t>(fx >> 16), static_cast<int32_t>(THUMB_W - 1));
+					int32_t x1 = std::min(x0 + 1, static_cast<int32_t>(THUMB_W - 1));
+					int32_t wx = (fx >> 8) & 0xff;
+					int32_t w00 = (256 - wx) * (256 - wy);
+					int32_t w01 = wx * (256 - wy);
+					int32_t w10 = (256 - wx) * wy;
+					int32_t w11 = wx * wy;
+					auto mix = [&](int sft, int32_t msk) {
+						int32_t v = ((l0[x0] >> sft) & msk) * w00 + ((l0[x1] >> sft) & msk) * w01
+							+ ((l1[x0] >> sft) & msk) * w10 + ((l1[x1] >> sft) & msk) * w11;
+						return static_cast<uint16_t>(((v + 0x8000) >> 16) << sft);
+					};
+					render_.fast_plot(vtx::spos(LCD_X - LCD_Y + x, y),
+						mix(11, 0x1f) | mix(5, 0x3f) | mix(0, 0x1f));
+				}
+			}
+			return true;
+		}
+
 		void render_tag_(utils::file_io& fin) noexcept
 		{
 			auto& tag = play_tag_;
@@ -196,7 +248,9 @@ namespace app {
 			render_.sync_frame(false);
 
 			scaling_.set_offset(vtx::spos(LCD_X - LCD_Y, 0));
-			if(tag.get_apic().len_ > 0) {
+			if(tag.get_apic().len_ > 0 && render_thumb_()) {
+				// メディア・インデックスのサムネイルを使う（APIC のデコードを省略）
+			} else if(tag.get_apic().len_ > 0) {
 				if(!img_in_.select_decoder(tag.get_apic().ext_)) {
 					scaling_.set_scale();
 					img_in_.load("/NoImage.jpg");
@@ -330,7 +384,7 @@ namespace app {
 			ff_(    vtx::srect(70*2, 272-64, 64, 64), ">>"),
 			level_l_(vtx::srect(70*1, 272-64*2+26*0, 134, 20)),
 			level_r_(vtx::srect(70*1, 272-64*2+26*1, 134, 20)),
-			scaling_(render_), img_in_(scaling_),
+			scaling_(render_), img_in_(scaling_), index_(nullptr), thumb_{ 0 },
 			ctrl_(0), path_{ 0 },
 			fin_artist_(), year_str_(), info_str_(), time_str_(),
 			play_stop_(), play_rew_(), play_pause_(), play_ff_(),
@@ -666,6 +720,16 @@ namespace app {
 		}
 
 
+		//-------------------------------------------------------------//
+		/*!
+			@brief  メディア・インデックスの登録 @n
+					※カバー画像の表示にサムネイルを使う（nullptr で無効）
+			@param[in]	index	メディア・インデックス
+		*/
+		//-------------------------------------------------------------//
+		void set_media_index(MEDIA_INDEX* index) noexcept { index_ = index; }
+
+
 		//-------------------------------------------------------------//
 		/*!
 			@brief  演奏ファイル名の登録
@@ -3,6 +3,7 @@
     @brief  RX64M/RX65N/RX72N Audio サンプル @n
 			SD-CARD にある MP3、WAV 形式のサファイルを再生する。@n
 			オーディオ出力として、マイコン内蔵 D/A 又は、SSIE を選択できる。@n
+			I/O タスクが次の曲まで先読みし、Codec タスクがデコードする（ギャップレス）@n
 			※ D/A を使う場合「#define USE_DAC」@n
 			※ SSIE を使う場合「#define USE_SSIE」(RX72N) @n
 			※ GLCDC を使う場合「#define USE_GLCDC」(RX65N/RX72N)
@@ -14,6 +15,7 @@
 //=====================================================================//
 #include "common/renesas.hpp"
 #include "common/cmt_mgr.hpp"
+#include "common/rtos_trace.hpp"
 #include "common/sci_io.hpp"
 #include "common/format.hpp"
 #include "common/command.hpp"
@@ -27,10 +29,13 @@
 
 #include "common/dir_list.hpp"
 #include "common/shell.hpp"
+#include "ff14/disk_cache.hpp"
 
 #include "sound/sound_out.hpp"
 #include "sound/dac_stream.hpp"
 #include "sound/codec_mgr.hpp"
+#include "sound/af_prefetch.hpp"
+#include "sound/media_index.hpp"
 
 #if defined(SIG_RX65N) || defined(SIG_RX72N)
 #include "audio_gui.hpp"
@@ -41,6 +46,14 @@ namespace {
 	typedef device::cmt_mgr<device::CMT0> CMT;
 	CMT			cmt_;
 
+	// デコード時間計測用のフリーラン・カウンター
+#if defined(SIG_RX72T)
+	// CMTW が無いので CMT1（16 ビット）、PCLKB/128 で周回（約 168ms）をフレームより長くする
+	typedef utils::rtos_trace_cmt<device::CMT1, 2> PROF_TIMER;
+#else
+	typedef utils::rtos_trace_cmtw<device::CMTW0> PROF_TIMER;  // PCLKB/8、32 ビット
+#endif
+
 #if defined(SIG_RX64M)
 	static const char* system_str_ = { "RX64M" };
 	typedef device::PORT<device::PORT0, device::bitpos::B7> LED;
@@ -142,6 +155,14 @@ namespace {
 	#define USE_DAC
 
 #endif
+	// SD カードのセクター・キャッシュ（FAT/ディレクトリーのライト・バックと先読み）
+#if defined(SIG_RX72T)
+	typedef fatfs::disk_cache<SDC, 4, 2, 8> SDC_CACHE;
+#else
+	typedef fatfs::disk_cache<SDC, 8, 4, 16> SDC_CACHE;
+#endif
+	SDC_CACHE	sdc_cache_(sdc_);
+
 	typedef device::system_io<> SYSTEM_IO;
 
 	typedef utils::fixed_fifo<char, 1024> RECV_BUFF;
@@ -247,6 +268,47 @@ namespace {
 	typedef sound::codec_mgr<list_ctrl, SOUND_OUT> CODEC_MGR;
 	CODEC_MGR	codec_mgr_(list_ctrl_, sound_out_);
 
+	// 圧縮データの先読みバッファ（SD のアクセス待ちを吸収し、次の曲を先読みする）
+#if defined(SIG_RX72T)
+	typedef sound::af_prefetch<16 * 1024> PREFETCH;
+#else
+	typedef sound::af_prefetch<64 * 1024> PREFETCH;
+#endif
+	PREFETCH	prefetch_;
+
+	// メディア・ライブラリー・インデックス（SD カードのマウントで差分走査する）
+	typedef sound::media_index<> MEDIA_INDEX;
+	MEDIA_INDEX	media_index_;
+	bool		index_mount_ = false;
+
+	void index_service_()
+	{
+		auto mount = sdc_.get_mount();
+		if(mount && !index_mount_) {  // カードが替わっている場合があるので開き直す
+			if(!media_index_.open() || !media_index_.start("/")) {
+				utils::format("Media index start fail\n");
+			}
+		}
+		index_mount_ = mount;
+		if(media_index_.is_busy()) {
+			if(!media_index_.service(4)) {
+				const auto& t = media_index_.get_scan();
+				utils::format("Media index: %u tracks (update: %u, remove: %u, thumb: %u, error: %u)\n")
+					% media_index_.size() % t.update % t.remove % t.thumb % t.error;
+			}
+		}
+	}
+
+	void index_list_(MEDIA_INDEX::ORDER order, uint32_t pos, uint32_t num)
+	{
+		for(uint32_t i = 0; i < num; ++i) {
+			MEDIA_INDEX::record_t r;
+			if(!media_index_.get(order, pos + i, r)) break;
+			utils::format("%5u: %s / %s / %u-%02u %s\n") % (pos + i)
+				% r.artist % r.album % r.disc % r.track % r.title;
+		}
+	}
+
 #ifdef USE_DAC
 	typedef sound::dac_stream<device::R12DA, device::MTU0, device::DMAC0, SOUND_OUT> DAC_STREAM;
 	DAC_STREAM	dac_stream_(sound_out_);
@@ -308,9 +370,69 @@ namespace {
 			} else {
 				codec_mgr_.play("");
 			}
+		} else if(cmd_.cmp_word(0, "stat")) {
+			utils::format("Prefetch: %u / %u bytes, underrun: %u, fetch: %u, reopen: %u\n")
+				% prefetch_.get_level() % prefetch_.get_size() % prefetch_.get_underrun()
+				% prefetch_.get_fetch_count() % prefetch_.get_reopen_count();
+			utils::format("Sound out: %u / %u samples, underrun: %u\n")
+				% sound_out_.at_fifo().length() % sound_out_.at_fifo().size()
+				% sound_out_.get_underrun();
+			{
+				const auto& t = codec_mgr_.at_mp3_in().get_stat();
+				if(t.frames > 0) {
+					auto us = [&](uint64_t v) {
+						return static_cast<uint32_t>(v * 1'000'000 / t.frames / PROF_TIMER::get_freq()); };
+					utils::format("MP3 decode: %u frames, %u samples, us/frame: decode: %u, synth: %u, convert: %u, read: %u, wait: %u\n")
+						% t.frames % t.samples % us(t.total.decode) % us(t.total.synth)
+						% us(t.total.convert) % us(t.total.read) % us(t.total.wait);
+				}
+			}
+			{
+				const auto& t = sdc_cache_.get_stat();
+				utils::format("Disk cache: hit: %u, read-ahead: %u, miss: %u, write: %u, write-back: %u\n")
+					% t.read_hit % t.ra_hit % t.read_miss % t.write_hit % t.write_back;
+				utils::format("  device read: %u cmd / %u sec, write: %u cmd / %u sec, error: %u\n")
+					% t.dev_read % t.dev_read_sec % t.dev_write % t.dev_write_sec % t.error;
+			}
+		} else if(cmd_.cmp_word(0, "index")) {  // index [scan|clear|artist|album|title [pos] [num]]
+			if(cmdn == 1) {
+				const auto& t = media_index_.get_scan();
+				utils::format("Media index: %u tracks, %u thumbs%s\n")
+					% media_index_.size() % media_index_.get_thumb_num()
+					% (media_index_.is_busy() ? " (scanning)" : "");
+				utils::format("  files: %u, update: %u, remove: %u, thumb: %u, skip: %u, error: %u\n")
+					% t.files % t.update % t.remove % t.thumb % t.skip % t.error;
+			} else if(cmd_.cmp_word(1, "scan")) {
+				if(!media_index_.start("/")) {
+					utils::format("Media index start fail\n");
+				}
+			} else if(cmd_.cmp_word(1, "clear")) {
+				if(!media_index_.format()) {
+					utils::format("Media index format fail\n");
+				}
+			} else {
+				auto order = MEDIA_INDEX::ORDER::ARTIST;
+				bool ok = true;
+				if(cmd_.cmp_word(1, "artist")) order = MEDIA_INDEX::ORDER::ARTIST;
+				else if(cmd_.cmp_word(1, "album")) order = MEDIA_INDEX::ORDER::ALBUM;
+				else if(cmd_.cmp_word(1, "title")) order = MEDIA_INDEX::ORDER::TITLE;
+				else ok = false;
+				int32_t pos = 0;
+				int32_t num = 20;
+				if(ok && cmdn >= 3) ok = cmd_.get_integer(2, pos) && pos >= 0;
+				if(ok && cmdn >= 4) ok = cmd_.get_integer(3, num) && num > 0;
+				if(ok) {
+					index_list_(order, pos, num);
+				} else {
+					utils::format("Index param error: '%s'\n") % cmd_.get_command();
+				}
+			}
 		} else if(cmd_.cmp_word(0, "help") || cmd_.cmp_word(0, "?")) {
 			shell_.help();
 			utils::format("    play file-name\n");
+			utils::format("    stat\n");
+			utils::format("    index [scan|clear]\n");
+			utils::format("    index artist|album|title [pos] [num]\n");
 		} else {
 			utils::format("Command error: '%s'\n") % cmd_.get_command();
 		}
@@ -384,27 +506,27 @@ extern "C" {
 
 
 	DSTATUS disk_initialize(BYTE drv) {
-		return sdc_.disk_initialize(drv);
+		return sdc_cache_.disk_initialize(drv);
 	}
 
 
 	DSTATUS disk_status(BYTE drv) {
-		return sdc_.disk_status(drv);
+		return sdc_cache_.disk_status(drv);
 	}
 
 
 	DRESULT disk_read(BYTE drv, BYTE* buff, DWORD sector, UINT count) {
-		return sdc_.disk_read(drv, buff, sector, count);
+		return sdc_cache_.disk_read(drv, buff, sector, count);
 	}
 
 
 	DRESULT disk_write(BYTE drv, const BYTE* buff, DWORD sector, UINT count) {
-		return sdc_.disk_write(drv, buff, sector, count);
+		return sdc_cache_.disk_write(drv, buff, sector, count);
 	}
 
 
 	DRESULT disk_ioctl(BYTE drv, BYTE ctrl, void* buff) {
-		return sdc_.disk_ioctl(drv, ctrl, buff);
+		return sdc_cache_.disk_ioctl(drv, ctrl, buff);
 	}
 
 
@@ -469,6 +591,9 @@ extern "C" {
 		// オーディオの開始
 		start_audio_();
 
+		PROF_TIMER::start();
+		codec_mgr_.at_mp3_in().set_counter(PROF_TIMER::get_counter, PROF_TIMER::BITS);
+
 		while(1) {
 			if(name_t_.get_ != name_t_.put_) {
 				if(strlen(name_t_.filename_) == 0) {
@@ -482,9 +607,19 @@ extern "C" {
 				}
 				++name_t_.get_;
 			}
-			codec_mgr_.service();
+			if(!codec_mgr_.decode_service(prefetch_)) {
+				vTaskDelay(10 / portTICK_PERIOD_MS);
+			}
+		}
+	}
+
 
-			vTaskDelay(10 / portTICK_PERIOD_MS);
+	void io_task_(void *pvParameters)
+	{
+		while(1) {
+			if(!codec_mgr_.io_service(prefetch_)) {
+				vTaskDelay(1);
+			}
 		}
 	}
 
@@ -498,10 +633,12 @@ extern "C" {
 		gui_.start();
 		gui_.setup_touch_panel();
 		gui_.open();  // 標準 GUI
+		gui_.set_media_index(&media_index_);
 		volatile uint32_t audio_t = audio_t_;
 #endif
 		while(1) {
 			sdc_.service();
+			index_service_();
 #ifdef USE_GLCDC
 			auto w = sound_out_.get_peak_level();
 			gui_.set_peak_level(w.l_ch, w.r_ch);
@@ -551,6 +688,13 @@ int main(int argc, char** argv)
         xTaskCreate(codec_task_, "Codec", stack_size, param, prio, nullptr);
     }
 
+    {
+        uint32_t stack_size = 8192;
+        void* param = nullptr;
+        uint32_t prio = 3;
+        xTaskCreate(io_task_, "I/O", stack_size, param, prio, nullptr);
+    }
+
     {
         uint32_t stack_size = 8192;
         void* param = nullptr;
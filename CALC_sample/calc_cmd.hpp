@@ -28,9 +28,10 @@ namespace app {
     */
     //+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
     class calc_cmd {
-
+	public:
 		static const uint32_t CALC_NUM = 250;  ///< 250 桁
 
+	private:
 		static const uint32_t ANS_NUM = 60;
 
 		typedef utils::command<256> CMD;
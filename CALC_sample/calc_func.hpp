@@ -15,7 +15,9 @@ namespace utils {
 
     //+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
     /*!
-        @brief  CALC FUNC クラス
+        @brief  CALC FUNC クラス @n
+				※mpfr::value の四則演算は式（mpfr::expr）を返し、NVAL::get_pi() 等の @n
+				一時オブジェクトも参照で持つ。式は auto で受けず、NVAL で受ける（返す）事
 		@param[in]	NVAL	数値クラス
     */
     //+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
@@ -103,12 +103,18 @@ namespace {
 
 #ifdef USE_GUI
 	typedef app::calc_gui GUI;
+	// limb プール（内部計算の一時領域も収まる様、２倍の精度で確保）
+	// ※mpfr::value を持つオブジェクトより先に構築する
+	typedef mpfr::limb_pool<mpfr::limb_size<GUI::CALC_NUM * 2>::value, 2> LIMB_POOL;
+	LIMB_POOL	limb_pool_;
 	GUI		gui_;
 	typedef app::calc_graph GRAPH;
 	GRAPH	graph_;
 
 #else
 	typedef app::calc_cmd CMD;
+	typedef mpfr::limb_pool<mpfr::limb_size<CMD::CALC_NUM * 2>::value, 2> LIMB_POOL;
+	LIMB_POOL	limb_pool_;
 	CMD		cmd_;
 #endif
 }
@@ -57,7 +57,11 @@
 #define configIDLE_SHOULD_YIELD			1
 #define configUSE_CO_ROUTINES 			0
 #define configUSE_MUTEXES				1
+#ifdef RTOS_TRACE
+#define configGENERATE_RUN_TIME_STATS	1
+#else
 #define configGENERATE_RUN_TIME_STATS	0
+#endif
 #define configCHECK_FOR_STACK_OVERFLOW	2
 #define configUSE_RECURSIVE_MUTEXES		1
 #define configQUEUE_REGISTRY_SIZE		0
@@ -137,4 +141,9 @@ required to ensure flase positive timing errors are not reported. */
 #define configNET_MASK2		255
 #define configNET_MASK3		0
 
+/* Task trace recorder hooks (common/rtos_trace.hpp). */
+#ifdef RTOS_TRACE
+#include "common/rtos_trace.h"
+#endif
+
 #endif /* FREERTOS_CONFIG_H */
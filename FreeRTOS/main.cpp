@@ -34,6 +34,10 @@
 #include "FreeRTOS.h"
 #include "task.h"
 
+#ifdef RTOS_TRACE
+#include "common/rtos_trace.hpp"
+#endif
+
 #ifdef SIG_RX64M
 // RX64Mで、GR-KAEDE の場合有効にする
 // #define GR_KAEDE
@@ -93,6 +97,13 @@ namespace {
 
 	typedef device::sci_io<SCI_CH, RXB, TXB> SCI;
 	SCI			sci_;
+
+#ifdef RTOS_TRACE
+	// トレースのタイムスタンプ（CMT0 はシステム・ティック）
+	typedef utils::rtos_trace_cmt<device::CMT1> TRACE_TIMER;
+	typedef utils::rtos_trace<TRACE_TIMER, utils::rtos_trace_isr_lock> TRACE;
+	TRACE		trace_;
+#endif
 }
 
 extern "C" {
@@ -135,6 +146,26 @@ extern "C" {
 		return sci_.recv_length();
 	}
 
+#ifdef RTOS_TRACE
+	// common/rtos_trace.h のカーネル・フックから呼ばれる
+	void rtos_trace_event(uint32_t ev, uint32_t arg)
+	{
+		trace_.put(ev, arg);
+	}
+
+
+	void rtos_trace_task(uint32_t id, const char* name, uint32_t prio)
+	{
+		trace_.task(id, name, prio);
+	}
+
+
+	uint32_t rtos_trace_runtime(void)
+	{
+		return trace_.get_runtime();
+	}
+#endif
+
 
 	void vApplicationMallocFailedHook(void)
 	{
@@ -264,6 +295,14 @@ namespace {
 		while(1) {
 			utils::format("Task3: %u\n") % cnt;
 			++cnt;
+#ifdef RTOS_TRACE
+			// 's': 実行時間統計、'd': トレースのダンプ（rtostrace で変換）
+			while(sci_length() > 0) {
+				auto ch = sci_getch();
+				if(ch == 's') trace_.list_stats();
+				else if(ch == 'd') trace_.dump();
+			}
+#endif
 			vTaskDelay(1000 / portTICK_PERIOD_MS);
 		}
 	}
@@ -293,6 +332,12 @@ int main(int argc, char** argv)
 	utils::format("Start FreeRTOS %s, sample for '%s' %d[MHz]\n")
 		% tskKERNEL_VERSION_NUMBER % system_str_ % clk;
 
+#ifdef RTOS_TRACE
+	// タスク名を記録する為、タスク生成の前に開始
+	// 実行時間統計は PCLK/8/16 (60MHz で 468.75KHz) で、約 2.5 時間で周回
+	trace_.start(TRACE::MODE::RING, 4);
+#endif
+
 	{
 		uint32_t stack_size = 512;
 		void* param = nullptr;
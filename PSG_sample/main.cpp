@@ -1234,14 +1234,7 @@ int main(int argc, char** argv)
 			}
 
 			pos = newpos;
-			int8_t tmp[n];
-			psg_mng_.render(n, tmp);
-			typename SOUND_OUT::WAVE t;
-			for(uint32_t i = 0; i < n; ++i) {
-				auto w = tmp[i];
-				t.l_ch = t.r_ch = (static_cast<int16_t>(w) << 8) | ((w & 0x7f) << 1);
-				sound_out_.at_fifo().put(t);
-			}
+			psg_mng_.render_wave(sound_out_, n);
 
 			if(delay > 0) {
 				delay--;
@@ -211,7 +211,7 @@ int main(int argc, char** argv)
 
 #ifdef LCD_MONO
 		if(nn >= 4) {
-			lcd_.copy(bitmap_.fb(), bitmap_.page_num());
+			lcd_.update(bitmap_);
 			nn = 0;
 		}
 		++nn;
@@ -191,7 +191,7 @@ int main(int argc, char** argv)
 			scene_.service();
 			// LCD 用速度と設定
 ////			core_.spi_.start(8000000, core_t::SPI::PHASE::TYPE4, core_t::SPI::DLEN::W8);
-			core_.lcd_.copy(core_.bitmap_.fb(), core_.bitmap_.page_num());
+			core_.lcd_.update(core_.bitmap_);
 ////			core_.sdc_.setup_speed();  //  SDC 用速度と設定
 		}
 
@@ -477,6 +477,11 @@ namespace device {
 				dst[3] = rd32_(io0_::address() + 12);
 			}
 
+			// メールボックスをフレームとして参照（コピーしない）
+			const can_frame& at_frame() {
+				return *reinterpret_cast<const can_frame*>(io0_::address());
+			}
+
 			mb_t& operator [] (uint32_t idx) {
 				set_index(idx);
 				return *this;
@@ -117,6 +117,48 @@ namespace device {
 		}
 
 
+		static void decode_type_(trans_type tft, uint8_t& sm, uint8_t& dm, uint8_t& sz) noexcept
+		{
+			sm = 0;
+			dm = 0;
+			sz = 0;
+			switch(tft) {
+			case trans_type::SN_DP_8:
+				sm = 0b00;  // n
+				dm = 0b10;  // ++
+				sz = 0;
+				break;
+			case trans_type::SP_DN_8:
+				sm = 0b10;  // ++
+				dm = 0b00;  // n
+				sz = 0;
+				break;
+			case trans_type::SN_DP_16:
+				sm = 0b00;  // n
+				dm = 0b10;  // ++
+				sz = 1;
+				break;
+			case trans_type::SP_DN_16:
+				sm = 0b10;  // ++
+				dm = 0b00;  // n
+				sz = 1;
+				break;
+			case trans_type::SN_DP_32:
+				sm = 0b00;  // n
+				dm = 0b10;  // ++
+				sz = 2;
+				break;
+			case trans_type::SP_DN_32:
+				sm = 0b10;  // ++
+				dm = 0b00;  // n
+				sz = 2;
+				break;
+			default:
+				break;
+			}
+		}
+
+
 	public:
 		//-----------------------------------------------------------------//
 		/*!
@@ -167,43 +209,10 @@ namespace device {
 
 			DMAC::DMCNT.DTE = 0;  // 念のため停止させる。
 
-			uint8_t dm = 0;
-			uint8_t sm = 0;
-			uint8_t sz = 0;
-			switch(tft) {
-			case trans_type::SN_DP_8:
-				sm = 0b00;  // n
-				dm = 0b10;  // ++
-				sz = 0;
-				break;
-			case trans_type::SP_DN_8:
-				sm = 0b10;  // ++
-				dm = 0b00;  // n
-				sz = 0;
-				break;
-			case trans_type::SN_DP_16:
-				sm = 0b00;  // n
-				dm = 0b10;  // ++
-				sz = 1;
-				break;
-			case trans_type::SP_DN_16:
-				sm = 0b10;  // ++
-				dm = 0b00;  // n
-				sz = 1;
-				break;
-			case trans_type::SN_DP_32:
-				sm = 0b00;  // n
-				dm = 0b10;  // ++
-				sz = 2;
-				break;
-			case trans_type::SP_DN_32:
-				sm = 0b10;  // ++
-				dm = 0b00;  // n
-				sz = 2;
-				break;
-			default:
-				break;
-			}
+			uint8_t sm;
+			uint8_t dm;
+			uint8_t sz;
+			decode_type_(tft, sm, dm, sz);
 
 			DMAC::DMAMD = DMAC::DMAMD.DM.b(dm) | DMAC::DMAMD.SM.b(sm);
 			// リピート転送
@@ -234,6 +243,65 @@ namespace device {
 		}
 
 
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	割り込み要因によるブロック転送の開始 @n
+					要因が発生する度に「bsz」個を転送し、「num」ブロックで終了 @n
+					※周辺のバッファ（SDHI の SDBUFR 等）との転送を想定
+			@param[in]	trg		転送開始要因
+			@param[in]	tft		転送タイプ
+			@param[in]	src		元アドレス
+			@param[in]	dst		先アドレス
+			@param[in]	bsz		ブロック・サイズ（転送単位の数：1 ～ 1024）
+			@param[in]	num		ブロック数（1 ～ 1024）
+			@param[in]	ilvl	転送完了割り込みレベル（０以上）@n
+								※無指定（０）なら割り込みを起動しない。
+			@return 成功なら「true」
+		 */
+		//-----------------------------------------------------------------//
+		bool start_block(ICU::VECTOR trg, trans_type tft, uint32_t src, uint32_t dst,
+			uint32_t bsz, uint32_t num, uint32_t ilvl) noexcept
+		{
+			if(bsz == 0 || bsz > 1024 || num == 0 || num > BLOCK_SIZE_MAX) return false;
+
+			power_mgr::turn(DMAC::PERIPHERAL);
+
+			DMAC::DMCNT.DTE = 0;  // 念のため停止させる。
+
+			uint8_t sm;
+			uint8_t dm;
+			uint8_t sz;
+			decode_type_(tft, sm, dm, sz);
+
+			DMAC::DMAMD = DMAC::DMAMD.DM.b(dm) | DMAC::DMAMD.SM.b(sm);
+			// ブロック転送（固定側のアドレスは変化しないので、ブロック領域の指定は無し）
+			DMAC::DMTMD = DMAC::DMTMD.DCTG.b(0b01) | DMAC::DMTMD.SZ.b(sz) |
+						  DMAC::DMTMD.DTS.b(0b10)  | DMAC::DMTMD.MD.b(0b10);
+			DMAC::DMSAR = src;
+			DMAC::DMDAR = dst;
+
+			DMAC::DMCRA = ((bsz & 0x3FF) << 16) | (bsz & 0x3FF);
+			DMAC::DMCRB = num & 0x3FF;  // 1024 は「0」
+
+			level_ = ilvl;
+			set_vector_(DMAC::IVEC);
+			icu_mgr::set_dmac(DMAC::PERIPHERAL, trg);
+			if(level_ > 0) {
+				DMAC::DMINT = DMAC::DMINT.DTIE.b();
+			} else {
+				DMAC::DMINT = 0x00;
+			}
+			DMAC::DMCSL.DISEL = 0;
+			DMAC::DMSTS = 0x00;
+
+			DMAC::DMCNT.DTE = 1;
+
+			DMAST.DMST = 1;
+
+			return true;
+		}
+
+
 		//-----------------------------------------------------------------//
 		/*!
 			@brief	転送再開 @n
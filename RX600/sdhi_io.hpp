@@ -2,14 +2,19 @@
 //=====================================================================//
 /*!	@file
 	@brief	RX600 グループ、SDHI（SD ホストインターフェース）FatFS ドライバー @n
-			SDHI インターフェースを使った SD カードアクセス
+			SDHI インターフェースを使った SD カードアクセス @n
+			・DMAC を指定した場合、ブロック転送を DMA で行う（SBFAI 起動）@n
+			・CMD6 で High-Speed モードに切り替え、バス・クロックを上げる @n
+			・start_read/start_write で転送を開始し、sync_trans で完了を待つ事も出来る
     @author 平松邦仁 (hira@rvf-rc45.net)
-	@copyright	Copyright (C) 2017, 2020 Kunihito Hiramatsu @n
+	@copyright	Copyright (C) 2017, 2021 Kunihito Hiramatsu @n
 				Released under the MIT license @n
 				https://github.com/hirakuni45/RX/blob/master/LICENSE
 */
 //=====================================================================//
+#include <type_traits>
 #include "common/renesas.hpp"
+#include "RX600/dmac_mgr.hpp"
 #include "ff14/source/ff.h"
 #include "ff14/source/diskio.h"
 
@@ -32,11 +37,31 @@ namespace fatfs {
 		@param[in]	POW		電源制御ポート・クラス
 		@param[in]	WPRT	書き込み禁止ポート・クラス
 		@param[in]	PSEL	ポート候補（port_map.hpp 参照）
+		@param[in]	DMAC	転送に使う DMA コントローラー（void の場合 CPU で転送）
 	*/
 	//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
 	template <class SDHI, class POW, class WPRT = device::NULL_PORT,
-		device::port_map::ORDER PSEL = device::port_map::ORDER::FIRST>
+		device::port_map::ORDER PSEL = device::port_map::ORDER::FIRST, class DMAC = void>
 	class sdhi_io {
+	public:
+
+		//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+		/*!
+			@brief  転送統計
+		*/
+		//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+		struct stat_t {
+			uint32_t	read_cmd;	///< 読み出しコマンド数
+			uint32_t	read_sec;	///< 読み出しセクター数
+			uint32_t	write_cmd;	///< 書き込みコマンド数
+			uint32_t	write_sec;	///< 書き込みセクター数
+			uint32_t	dma_trans;	///< DMA で転送したコマンド数
+			uint32_t	crc_error;	///< CRC エラー数
+			uint32_t	retry;		///< クロックを下げて再試行した数
+			uint32_t	error;		///< その他のエラー数
+		};
+
+	private:
 
 //		typedef utils::format debug_format;
 		typedef utils::null_format debug_format;
@@ -52,13 +77,16 @@ namespace fatfs {
 		static const uint8_t TIME_OUT_DIVIDE_    = 14;		///< タイムアウトカウント（０～１４）
 		// SD カード初期化時100～400KBPS(60MHz / 256: 224KBPS）
 		static const uint8_t CLOCK_SLOW_DIVIDE_  = 0b01000000;	///< 初期化時の分周比 (1/256)
+		// ブースト時の分周は、インデックス（n: 1/2^n）で管理する。
 		// RX65N Envision Kit では、30MHz までが安定動作。
 		// RX72N Envision Kit では、60MHz まで動作確認したものの、マージンを取り、30MHz で運用。
-///		static const uint8_t CLOCK_FAST_DIVIDE_  = 0b11111111;	///< ブースト時 (60MHz:1/1)
-		static const uint8_t CLOCK_FAST_DIVIDE_  = 0b00000000;	///< ブースト時 (30MHz:1/2)
-//		static const uint8_t CLOCK_FAST_DIVIDE_  = 0b00000001;	///< ブースト時 (15MHz:1/4)
-//		static const uint8_t CLOCK_FAST_DIVIDE_  = 0b00000010;	///< ブースト時 (7.5MHz:1/8)
-//		static const uint8_t CLOCK_FAST_DIVIDE_  = 0b00000100;	///< ブースト時 (3.75MHz:1/16)
+///		static const uint8_t CLOCK_FAST_INDEX_  = 0;	///< ブースト時上限 (60MHz:1/1)
+		static const uint8_t CLOCK_FAST_INDEX_  = 1;	///< ブースト時上限 (30MHz:1/2)
+//		static const uint8_t CLOCK_FAST_INDEX_  = 2;	///< ブースト時上限 (15MHz:1/4)
+		static const uint8_t CLOCK_RETRY_INDEX_ = 4;	///< CRC エラーで下げる下限 (3.75MHz:1/16)
+		// SD カードのバス・クロック上限
+		static const uint32_t CLOCK_DS_LIMIT_ = 25'000'000;	///< Default Speed モード
+		static const uint32_t CLOCK_HS_LIMIT_ = 50'000'000;	///< High Speed モード
 
 		// MMC card type flags (MMC_GET_TYPE)
 		static const uint8_t CT_MMC   = 0b00000001;	///< MMC ver 3
@@ -74,6 +102,34 @@ namespace fatfs {
 		static const int CMD3_LOOP_MAX   = 3;
 		static const int BRE_LOOP_LIMIT  = 1000;
 		static const int BWE_LOOP_LIMIT  = 1000;
+		static const int ACEND_SPIN_LIMIT = 100;	///< RTOS の場合、これを超えたらタスクを切り替える
+		static const uint32_t DMA_WAIT_LIMIT = 1'000'000;	///< DMA 完了待ち (us)
+
+		static constexpr bool USE_DMA_ = !std::is_void<DMAC>::value;
+
+		// DMA 転送終了割り込み
+		class dma_task {
+		public:
+			void operator () () noexcept {
+				++dma_end_;
+#ifdef RTOS
+				if(dma_wait_ != nullptr) {
+					BaseType_t woken = pdFALSE;
+					vTaskNotifyGiveFromISR(dma_wait_, &woken);
+					portYIELD_FROM_ISR(woken);
+				}
+#endif
+			}
+		};
+		struct dma_none { };
+		typedef typename std::conditional<USE_DMA_,
+			device::dmac_mgr<DMAC, dma_task>, dma_none>::type DMA_MGR;
+
+		enum class trans : uint8_t {
+			NONE,	///< 転送無し
+			READ,	///< DMA 読み出し中
+			WRITE,	///< DMA 書き込み中
+		};
 
 		FATFS		fatfs_;
 		DSTATUS		stat_;			// Disk status
@@ -86,6 +142,13 @@ namespace fatfs {
 		bool		start_;
 		bool		onew_;
 
+		DMA_MGR		dma_;
+		trans		trans_;
+		uint8_t		clk_idx_;
+		bool		hs_;
+		bool		crc_;
+		stat_t		trans_stat_;
+
 		uint32_t	rca_id_;
 		uint32_t	cid_[4];
 
@@ -97,7 +160,7 @@ namespace fatfs {
 			CMD3   = 3,       // -            R3    -	  RCA の読み出し
 			CMD4   = 4,       // -            R3    -	  DSR
 
-			CMD6   = 6,       // 
+			CMD6   = 0x1C06,  // Mode(32)     R1    あり  機能切り替え（拡張モード：64 バイト読み出し）
 			CMD7   = 7,       // RCA-ID       R1b         SD カードセレクト 
 			CMD8   = 8,       // *3           R7    -     SDC V2 専用、動作電圧確認
 			CMD9   = 9,       // -            R1    あり  CSD 読み出し
@@ -127,6 +190,13 @@ namespace fatfs {
 		};
 
 
+#ifdef RTOS
+		static bool scheduler_running_() noexcept {
+			return xTaskGetSchedulerState() == taskSCHEDULER_RUNNING;
+		}
+#endif
+
+
 		bool wait_busy_() noexcept {
 			int loop = 0;
 ///			while(SDHI::SDSTS2.CBSY() != 0) {
@@ -148,12 +218,116 @@ namespace fatfs {
 				if(loop >= ACEND_LOOP_LIMIT) {
 					return false;
 				}
+#ifdef RTOS
+				// 書き込み後のビジー等、長い待ちは他のタスクに譲る @n
+				// （スケジューラー起動前は、ビジー・ループで待つ）
+				if(loop > ACEND_SPIN_LIMIT && scheduler_running_()) {
+					vTaskDelay(1);
+					loop += (portTICK_PERIOD_MS * 100) - 1;
+					continue;
+				}
+#endif
 				utils::delay::micro_second(10);
 			}
 			return true;
 		}
 
 
+		bool wait_dma_() noexcept {
+			if constexpr (USE_DMA_) {
+#ifdef RTOS
+				bool sch = scheduler_running_();
+				dma_wait_ = sch ? xTaskGetCurrentTaskHandle() : nullptr;
+#endif
+				uint32_t us = 0;
+				while(DMAC::DMCNT.DTE() != 0) {
+					auto st = SDHI::SDSTS2();
+					if(st & SDHI::SDSTS2.CRCE.b()) {
+						debug_format("DMA: CRC error\n");
+						crc_ = true;
+						break;
+					}
+					if(st & (SDHI::SDSTS2.DTO.b() | SDHI::SDSTS2.ENDE.b() | SDHI::SDSTS2.ILA.b())) {
+						debug_format("DMA: Data error (%04X)\n") % st;
+						break;
+					}
+					if(us >= DMA_WAIT_LIMIT) {
+						debug_format("DMA: time out\n");
+						break;
+					}
+#ifdef RTOS
+					if(intr_lvl_ > 0 && sch) {
+						// 完了割り込みで起こされる（最大１ティックでエラーを再検査）
+						ulTaskNotifyTake(pdTRUE, 1);
+						us += portTICK_PERIOD_MS * 1000;
+						continue;
+					}
+#endif
+					utils::delay::micro_second(10);
+					us += 10;
+				}
+#ifdef RTOS
+				dma_wait_ = nullptr;
+#endif
+				return DMAC::DMCNT.DTE() == 0;
+			} else {
+				return true;
+			}
+		}
+
+
+		void abort_trans_() noexcept
+		{
+			if constexpr (USE_DMA_) {
+				dma_.stop();
+				SDHI::SDDMAEN.DMAEN = 0;
+			}
+			SDHI::SDSTOP.STP = 1;
+			SDHI::SDSTS1 = 0;
+			SDHI::SDSTS2 = 0;
+			trans_ = trans::NONE;
+		}
+
+
+		DRESULT error_(DRESULT ret) noexcept
+		{
+			abort_trans_();
+			if(crc_) ++trans_stat_.crc_error;
+			else ++trans_stat_.error;
+			return ret;
+		}
+
+
+		bool use_dma_(const void* buff, UINT count) const noexcept
+		{
+			if constexpr (USE_DMA_) {
+				// DMA は 32 ビット単位で転送するので、４バイト境界のバッファのみ
+				return (reinterpret_cast<uintptr_t>(buff) & 3) == 0 && count <= DMA_MGR::BLOCK_SIZE_MAX;
+			} else {
+				return false;
+			}
+		}
+
+
+		void start_dma_(bool write, void* buff, UINT count) noexcept
+		{
+			if constexpr (USE_DMA_) {
+				typedef typename DMA_MGR::trans_type TT;
+				auto buf = static_cast<uint32_t>(reinterpret_cast<uintptr_t>(buff));
+				auto sdbuf = SDHI::SDBUFR.address();
+				// BRE/BWE は DMA 要求にだけ使い、割り込みはマスクする
+				SDHI::SDIMSK2 = SDHI::SDIMSK2() | SDHI::SDIMSK2.BREM.b() | SDHI::SDIMSK2.BWEM.b();
+				if(write) {
+					dma_.start_block(SDHI::SBFA_VEC, TT::SP_DN_32, buf, sdbuf, 512 / 4, count, intr_lvl_);
+				} else {
+					dma_.start_block(SDHI::SBFA_VEC, TT::SN_DP_32, sdbuf, buf, 512 / 4, count, intr_lvl_);
+				}
+				SDHI::SDDMAEN.DMAEN = 1;
+				++trans_stat_.dma_trans;
+			}
+		}
+
+
 		bool set_bus_(bool single) noexcept {
 			if(!wait_busy_()) {
 				return false;
@@ -167,6 +341,25 @@ namespace fatfs {
 		}
 
 
+		// 分周インデックス (1/2^n) を CLKSEL の値に変換
+		static uint8_t clk_sel_(uint8_t idx) noexcept {
+			if(idx == 0) return 0b11111111;
+			else if(idx == 1) return 0b00000000;
+			else return 1 << (idx - 2);
+		}
+
+
+		// カードのモードで許される最速の分周インデックス
+		static uint8_t fast_index_(bool hs) noexcept {
+			uint32_t lim = hs ? CLOCK_HS_LIMIT_ : CLOCK_DS_LIMIT_;
+			uint8_t idx = CLOCK_FAST_INDEX_;
+			while(idx < 8 && (device::clock_profile::PCLKB >> idx) > lim) {
+				++idx;
+			}
+			return idx;
+		}
+
+
 		void set_clk_(bool fast) noexcept {
 			SDHI::SDSTS1 = 0;
 			SDHI::SDSTS2 = 0;
@@ -175,7 +368,7 @@ namespace fatfs {
 
 			SDHI::SDCLKCR.CLKEN = 0;
 			if(fast) {
-				SDHI::SDCLKCR.CLKSEL = CLOCK_FAST_DIVIDE_;
+				SDHI::SDCLKCR.CLKSEL = clk_sel_(clk_idx_);
 			} else {
 				SDHI::SDCLKCR.CLKSEL = CLOCK_SLOW_DIVIDE_;
 			}
@@ -294,6 +487,70 @@ namespace fatfs {
 		}
 
 
+		// CMD6 (SWITCH_FUNC) を発行して、６４バイトのステータスを読む
+		bool switch_func_(uint32_t arg, uint8_t* sts) noexcept
+		{
+			SDHI::SDSTS1 = 0;
+			SDHI::SDSTS2 = 0;
+			SDHI::SDSIZE = 64;
+			SDHI::SDSTOP = 0x00000000;  // single block
+			bool ok = send_cmd_data_(command::CMD6, arg);
+			if(ok) {
+				uint32_t* p = reinterpret_cast<uint32_t*>(sts);
+				for(uint32_t i = 0; i < (64 / 4); ++i) {
+					*p++ = SDHI::SDBUFR();
+				}
+				ok = wait_acend_();
+			}
+			SDHI::SDSTS1 = 0;
+			SDHI::SDSTS2 = 0;
+			SDHI::SDSIZE = 512;
+			return ok;
+		}
+
+
+		// High-Speed モード（グループ１、機能１）への切り替え
+		bool switch_high_speed_() noexcept
+		{
+			uint32_t tmp[64 / 4];
+			uint8_t* sts = reinterpret_cast<uint8_t*>(tmp);
+			// 問い合わせ (mode 0)、グループ１以外は「変更しない (F)」
+			if(!switch_func_(0x00FFFFF1, sts)) {
+				debug_format("CMD6: check error\n");
+				return false;
+			}
+			// bits 415:400 グループ１の対応機能
+			if((sts[13] & 0x02) == 0) {
+				debug_format("CMD6: High-Speed not support\n");
+				return false;
+			}
+			// 切り替え (mode 1)
+			if(!switch_func_(0x80FFFFF1, sts)) {
+				debug_format("CMD6: switch error\n");
+				return false;
+			}
+			// bits 379:376 グループ１の選択結果
+			if((sts[16] & 0x0F) != 1) {
+				debug_format("CMD6: switch fail (%02X)\n") % static_cast<uint16_t>(sts[16]);
+				return false;
+			}
+			// 切り替え後、８クロック以上待ってからクロックを上げる
+			utils::delay::micro_second(10);
+			return true;
+		}
+
+
+		// CRC エラーが起きた場合、クロックを一段下げる
+		bool slow_down_() noexcept
+		{
+			if(clk_idx_ >= CLOCK_RETRY_INDEX_) return false;
+			++clk_idx_;
+			++trans_stat_.retry;
+			set_clk_(true);
+			return true;
+		}
+
+
 		static void cdeti_task_() noexcept {
 		}
 
@@ -309,6 +566,11 @@ namespace fatfs {
 			++i_count_;
 		}
 
+		static volatile uint32_t dma_end_;
+#ifdef RTOS
+		static TaskHandle_t volatile dma_wait_;
+#endif
+
 		static void sync_data_end_() noexcept {
 		}
 
@@ -323,7 +585,8 @@ namespace fatfs {
 			stat_(STA_NOINIT), card_type_(0),
 			mount_delay_(0), intr_lvl_(0),
 			cd_(false), mount_(false), start_(false),
-			onew_(onew), rca_id_(0)
+			onew_(onew), dma_(), trans_(trans::NONE), clk_idx_(CLOCK_FAST_INDEX_),
+			hs_(false), crc_(false), trans_stat_(), rca_id_(0)
 		{ }
 
 
@@ -350,15 +613,21 @@ namespace fatfs {
 			port_map::turn_sdhi(port_map::sdhi_situation::START, PSEL);
 
 			intr_lvl_ = lvl;
-			if(intr_lvl_) {
-//				cdeti_task_
-//				caci_task_
-//				sdaci_task_
-				set_interrupt_task(sbfai_task_, static_cast<uint32_t>(SDHI::SBFA_VEC));
-			} else {
+			if constexpr (USE_DMA_) {
+				// SBFAI は DMAC の起動要因に使う（ICU の許可が必要なので、レベルは１以上）
 				set_interrupt_task(nullptr, static_cast<uint32_t>(SDHI::SBFA_VEC));
+				device::icu_mgr::set_level(SDHI::SBFA_VEC, intr_lvl_ > 0 ? intr_lvl_ : 1);
+			} else {
+				if(intr_lvl_) {
+//					cdeti_task_
+//					caci_task_
+//					sdaci_task_
+					set_interrupt_task(sbfai_task_, static_cast<uint32_t>(SDHI::SBFA_VEC));
+				} else {
+					set_interrupt_task(nullptr, static_cast<uint32_t>(SDHI::SBFA_VEC));
+				}
+				device::icu_mgr::set_level(SDHI::SBFA_VEC, intr_lvl_);
 			}
-			device::icu_mgr::set_level(SDHI::SBFA_VEC, intr_lvl_);
 
 			start_ = true;
 		}
@@ -442,6 +711,10 @@ namespace fatfs {
 			if(!SDHI::SDSTS1.SDCDMON()) {
 				return RES_NOTRDY;
 			}
+			if(trans_ != trans::NONE) {
+				abort_trans_();
+			}
+			hs_ = false;
 #if 0
 			debug_format("Start SDHI: disk_initialize\n");
 			debug_format("  Version IP1: 0x%02X, IP2: 0x%1X, CLKRAT: %d, CPRM: %d\n")
@@ -665,6 +938,11 @@ namespace fatfs {
 			card_type_ = ty;
 			stat_ = ty ? 0 : STA_NOINIT;
 
+			// High-Speed モードへ切り替え（非対応なら Default Speed のまま）
+			hs_ = switch_high_speed_();
+			clk_idx_ = fast_index_(hs_);
+			debug_format("SD: %s mode\n") % (hs_ ? "High-Speed" : "Default-Speed");
+
 			// Select FAST_CLK
 			set_clk_(true);
 
@@ -684,66 +962,91 @@ namespace fatfs {
 
 		//-----------------------------------------------------------------//
 		/*!
-			@brief	リード・セクター
+			@brief	リード・セクター開始 @n
+					DMA が使える場合、コマンドを発行して直ぐに戻る（sync_trans で完了を待つ）@n
+					DMA が使えない場合（DMAC 無し、４バイト境界に無いバッファ）は、@n
+					CPU で転送して完了してから戻る。
 			@param[in]	drv		Physical drive nmuber (0)
 			@param[out]	buff	Pointer to the data buffer to store read data
 			@param[in]	sector	Start sector number (LBA)
 			@param[in]	count	Sector count (1..128)
+			@return 結果
 		 */
 		//-----------------------------------------------------------------//
-		DRESULT disk_read(BYTE drv, void* buff, DWORD sector, UINT count) noexcept
+		DRESULT start_read(BYTE drv, void* buff, DWORD sector, UINT count) noexcept
 		{
 			if(!SDHI::SDSTS1.SDCDMON()) return RES_NOTRDY;
 			if(disk_status(drv) & STA_NOINIT) return RES_NOTRDY;
+			if(count == 0) return RES_PARERR;
+
+			auto ret = sync_trans();
+			if(ret != RES_OK) return ret;
 
 			// Convert LBA to byte address if needed
 			if(!(card_type_ & CT_BLOCK)) sector *= 512;
 
 ///			utils::format("disk_read: sector: %d, count: %d\n") % sector % count;
 
+			++trans_stat_.read_cmd;
+			trans_stat_.read_sec += count;
+
+			bool dma = use_dma_(buff, count);
+
+			SDHI::SDSTS1 = 0;
+			SDHI::SDSTS2 = 0;
 			SDHI::SDSIZE   = 512;
 //			SDHI::SDIMSK1  = 0x0000FFFE;
 //			SDHI::SDIMSK2  = 0x00007F80;
 			SDHI::SDSTOP   = 0x00000100;  // for multi block
 			SDHI::SDBLKCNT = count;  // for multi block read
 			SDHI::SDARG    = sector;
+			if(dma) {
+				start_dma_(false, buff, count);
+			}
 			command cmd = count > 1 ? command::CMD18 : command::CMD17;
 			const char* cmdstr = cmd == command::CMD17 ? "CMD17" : "CMD18";
 			SDHI::SDCMD = static_cast<uint32_t>(cmd);
 			while(SDHI::SDSTS1.RSPEND() == 0) {
 				if(SDHI::SDSTS2.CRCE()) {
 					debug_format("%s CRC Error (CRCE)\n") % cmdstr;
-					return RES_ERROR;
+					crc_ = true;
+					return error_(RES_ERROR);
 				}
 				if(SDHI::SDSTS2.CMDE()) {
 					debug_format("%s Command error (CMDE)\n") % cmdstr;
-					return RES_ERROR;
+					return error_(RES_ERROR);
 				}
 				if(SDHI::SDSTS2.RSPTO()) {
 					debug_format("%s Response Timeout (RSPTO)\n") % cmdstr;
-					return RES_ERROR;
+					return error_(RES_ERROR);
 				}
 			}
 			SDHI::SDSTS1 = 0x0000FFFE;
-			auto sp10 = SDHI::SDRSP10();
+///			auto sp10 = SDHI::SDRSP10();
 ///			utils::format("%s: Response: %08X\n") % cmdstr % sp10;
 
+			if(dma) {
+				trans_ = trans::READ;
+				return RES_OK;
+			}
+
 			while(count > 0) {
 
 				uint32_t loop = 0;
 				while(SDHI::SDSTS2.BRE() == 0) {
 					if(loop >= 10000) {
 						debug_format("%s time out\n") % cmdstr;
-						return RES_ERROR;
+						return error_(RES_ERROR);
 					}
 					auto st = SDHI::SDSTS2();
 					if(st & SDHI::SDSTS2.DTO.b()) {
 						debug_format("%s DTO error\n") % cmdstr;
-						return RES_ERROR;
+						return error_(RES_ERROR);
 					}
 					if(st & SDHI::SDSTS2.CRCE.b()) {
 						debug_format("%s CRC error\n") % cmdstr;
-						return RES_ERROR;
+						crc_ = true;
+						return error_(RES_ERROR);
 					}
 					++loop;
 					utils::delay::micro_second(100);
@@ -752,7 +1055,7 @@ namespace fatfs {
 				SDHI::SDSTS2 = 0x0000FEFF;
 ///				utils::format("%s BRE: OK\n") % cmdstr;
 
-				if((reinterpret_cast<uint32_t>(buff) & 0x3) == 0) {
+				if((reinterpret_cast<uintptr_t>(buff) & 0x3) == 0) {
 					uint32_t* p = static_cast<uint32_t*>(buff);
 					for(uint32_t n = 0; n < (512 / 4); ++n) {
 						*p++ = SDHI::SDBUFR(); 
@@ -774,7 +1077,7 @@ namespace fatfs {
 
 			if(!wait_acend_()) {
 				debug_format("Read: ACEND time out\n");
-				return RES_ERROR;				
+				return error_(RES_ERROR);
 			}
 
 			SDHI::SDSTS1 = 0x0000FFFB;
@@ -789,23 +1092,35 @@ namespace fatfs {
 
 		//-----------------------------------------------------------------//
 		/*!
-			@brief	ライト・セクター
+			@brief	ライト・セクター開始 @n
+					DMA が使える場合、コマンドを発行して直ぐに戻る（sync_trans で完了を待つ）@n
+					※完了するまで、バッファの内容を変更してはならない。
 			@param[in]	drv		Physical drive nmuber (0)
 			@param[in]	buff	Pointer to the data to be written	
 			@param[in]	sector	Start sector number (LBA)
 			@param[in]	count	Sector count (1..128)
+			@return 結果
 		 */
 		//-----------------------------------------------------------------//
-		DRESULT disk_write(BYTE drv, const void* buff, DWORD sector, UINT count) noexcept
+		DRESULT start_write(BYTE drv, const void* buff, DWORD sector, UINT count) noexcept
 		{
 			if(!SDHI::SDSTS1.SDCDMON()) return RES_NOTRDY;
 			if(disk_status(drv) & STA_NOINIT) return RES_NOTRDY;
 			if(WPRT::BIT_POS < 8) {
 				if(WPRT::P()) return RES_WRPRT;
 			}
+			if(count == 0) return RES_PARERR;
+
+			auto ret = sync_trans();
+			if(ret != RES_OK) return ret;
 
 			if(!(card_type_ & CT_BLOCK)) sector *= 512;	/* Convert LBA to byte address if needed */
 
+			++trans_stat_.write_cmd;
+			trans_stat_.write_sec += count;
+
+			bool dma = use_dma_(buff, count);
+
 			SDHI::SDSTS1 = 0;
 			SDHI::SDSTS2 = 0;
 			SDHI::SDSIZE = 512;
@@ -813,34 +1128,48 @@ namespace fatfs {
 			SDHI::SDSTOP   = 0x00000100;  // for multi block
 			SDHI::SDBLKCNT = count;  // for multi block read
 			SDHI::SDARG    = sector;
+			if(dma) {
+				start_dma_(true, const_cast<void*>(buff), count);
+			}
 			command cmd = count > 1 ? command::CMD25 : command::CMD24;
 			const char* cmdstr = cmd == command::CMD25 ? "CMD25" : "CMD24";
 			SDHI::SDCMD = static_cast<uint32_t>(cmd);
 
 			while(SDHI::SDSTS1.RSPEND() == 0) {
-				if(SDHI::SDSTS2() & (SDHI::SDSTS2.CMDE.b() | SDHI::SDSTS2.RSPTO.b())) {
-					return RES_ERROR;
+				auto st = SDHI::SDSTS2();
+				if(st & SDHI::SDSTS2.CRCE.b()) {
+					crc_ = true;
+					return error_(RES_ERROR);
+				}
+				if(st & (SDHI::SDSTS2.CMDE.b() | SDHI::SDSTS2.RSPTO.b())) {
+					return error_(RES_ERROR);
 				}
 			}
 			SDHI::SDSTS1 = 0x0000FFFE;
 //			auto sp54 = SDHI::SDRSP54();
 
+			if(dma) {
+				trans_ = trans::WRITE;
+				return RES_OK;
+			}
+
 			while(count > 0) {
 
 				uint32_t loop = 0;
 				while(SDHI::SDSTS2.BWE() == 0) {
 					if(loop >= BWE_LOOP_LIMIT) {
 						debug_format("%s time out\n") % cmdstr;
-						return RES_ERROR;
+						return error_(RES_ERROR);
 					}
 					auto st = SDHI::SDSTS2();
 					if(st & SDHI::SDSTS2.DTO.b()) {
 						debug_format("%s DTO error\n") % cmdstr;
-						return RES_ERROR;
+						return error_(RES_ERROR);
 					}
 					if(st & SDHI::SDSTS2.CRCE.b()) {
 						debug_format("%s CRC error\n") % cmdstr;
-						return RES_ERROR;
+						crc_ = true;
+						return error_(RES_ERROR);
 					}
 					++loop;
 					utils::delay::micro_second(100);
@@ -848,7 +1177,7 @@ namespace fatfs {
 
 				SDHI::SDSTS2 = 0xFDFF;
 
-				if((reinterpret_cast<uint32_t>(buff) & 0x3) == 0) {
+				if((reinterpret_cast<uintptr_t>(buff) & 0x3) == 0) {
 					const uint32_t* p = static_cast<const uint32_t*>(buff);
 					for(uint32_t n = 0; n < 128; ++n) {
 						SDHI::SDBUFR = *p++;
@@ -869,7 +1198,7 @@ namespace fatfs {
 
 			if(!wait_acend_()) {
 				debug_format("Write: ACEND time out\n");
-				return RES_ERROR;				
+				return error_(RES_ERROR);
 			}
 
 			SDHI::SDSTS1 = 0x0000FFFB;
@@ -878,6 +1207,98 @@ namespace fatfs {
 		}
 
 
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	転送中か検査
+			@return 転送中なら「true」
+		 */
+		//-----------------------------------------------------------------//
+		bool probe_trans() const noexcept
+		{
+			if(trans_ == trans::NONE) return false;
+			if constexpr (USE_DMA_) {
+				if(DMAC::DMCNT.DTE() != 0) return true;
+			}
+			return SDHI::SDSTS1.ACEND() == 0;
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	転送の完了を待つ @n
+					RTOS の場合、DMA の完了割り込みまで、他のタスクに処理を譲る。
+			@return 結果
+		 */
+		//-----------------------------------------------------------------//
+		DRESULT sync_trans() noexcept
+		{
+			if(trans_ == trans::NONE) return RES_OK;
+
+			bool ok = wait_dma_();
+			if(ok) {
+				ok = wait_acend_();
+				if(!ok) {
+					debug_format("%s: ACEND time out\n") % (trans_ == trans::READ ? "Read" : "Write");
+				}
+			}
+			if(!ok) {
+				return error_(RES_ERROR);
+			}
+			if constexpr (USE_DMA_) {
+				SDHI::SDDMAEN.DMAEN = 0;
+			}
+			SDHI::SDSTS1 = 0x0000FFFB;
+			trans_ = trans::NONE;
+			return RES_OK;
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	リード・セクター
+			@param[in]	drv		Physical drive nmuber (0)
+			@param[out]	buff	Pointer to the data buffer to store read data
+			@param[in]	sector	Start sector number (LBA)
+			@param[in]	count	Sector count (1..128)
+		 */
+		//-----------------------------------------------------------------//
+		DRESULT disk_read(BYTE drv, void* buff, DWORD sector, UINT count) noexcept
+		{
+			DRESULT ret;
+			do {
+				crc_ = false;
+				ret = start_read(drv, buff, sector, count);
+				if(ret == RES_OK) {
+					ret = sync_trans();
+				}
+			} while(ret == RES_ERROR && crc_ && slow_down_()) ;
+			return ret;
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	ライト・セクター
+			@param[in]	drv		Physical drive nmuber (0)
+			@param[in]	buff	Pointer to the data to be written	
+			@param[in]	sector	Start sector number (LBA)
+			@param[in]	count	Sector count (1..128)
+		 */
+		//-----------------------------------------------------------------//
+		DRESULT disk_write(BYTE drv, const void* buff, DWORD sector, UINT count) noexcept
+		{
+			DRESULT ret;
+			do {
+				crc_ = false;
+				ret = start_write(drv, buff, sector, count);
+				if(ret == RES_OK) {
+					ret = sync_trans();
+				}
+			} while(ret == RES_ERROR && crc_ && slow_down_()) ;
+			return ret;
+		}
+
+
 		//-----------------------------------------------------------------//
 		/*!
 			@brief	I/O コントロール
@@ -896,6 +1317,7 @@ namespace fatfs {
 			switch (ctrl) {
 			case CTRL_SYNC :		/* Make sure that no pending write process */
 ///				if(select_()) res = RES_OK;
+				res = sync_trans();
 				break;
 
 			case GET_SECTOR_COUNT:	/* Get number of sectors on the disk (DWORD) */
@@ -986,9 +1408,59 @@ namespace fatfs {
          */
         //-----------------------------------------------------------------//
         bool get_mount() const noexcept { return mount_; }
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	バス・クロックの取得
+			@return バス・クロック [Hz]
+		 */
+		//-----------------------------------------------------------------//
+		uint32_t get_bus_clock() const noexcept { return device::clock_profile::PCLKB >> clk_idx_; }
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	High-Speed モードか検査
+			@return High-Speed モードなら「true」
+		 */
+		//-----------------------------------------------------------------//
+		bool is_high_speed() const noexcept { return hs_; }
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	DMA 転送が有効か検査
+			@return DMA 転送が有効なら「true」
+		 */
+		//-----------------------------------------------------------------//
+		static constexpr bool is_dma() noexcept { return USE_DMA_; }
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	転送統計の取得
+			@return 転送統計
+		 */
+		//-----------------------------------------------------------------//
+		const stat_t& get_stat() const noexcept { return trans_stat_; }
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	転送統計のクリア
+		 */
+		//-----------------------------------------------------------------//
+		void clear_stat() noexcept { trans_stat_ = stat_t(); }
 	};
 
 	// テンプレート関数、実態の定義
-	template <class SDHI, class POW, class WPRT, device::port_map::ORDER PSEL>
-		volatile uint32_t sdhi_io<SDHI, POW, WPRT, PSEL>::i_count_ = 0;
+	template <class SDHI, class POW, class WPRT, device::port_map::ORDER PSEL, class DMAC>
+		volatile uint32_t sdhi_io<SDHI, POW, WPRT, PSEL, DMAC>::i_count_ = 0;
+	template <class SDHI, class POW, class WPRT, device::port_map::ORDER PSEL, class DMAC>
+		volatile uint32_t sdhi_io<SDHI, POW, WPRT, PSEL, DMAC>::dma_end_ = 0;
+#ifdef RTOS
+	template <class SDHI, class POW, class WPRT, device::port_map::ORDER PSEL, class DMAC>
+		TaskHandle_t volatile sdhi_io<SDHI, POW, WPRT, PSEL, DMAC>::dma_wait_ = nullptr;
+#endif
 }
@@ -27,7 +27,7 @@ namespace {
 
 	utils::command<64> command_;
 
-	typedef utils::log_man<device::standby_ram> LOG_MAN;
+	typedef utils::log_man<device::standby_ram, CMT> LOG_MAN;
 	LOG_MAN		log_man_;
 }
 
@@ -72,7 +72,9 @@ int main(int argc, char** argv)
 
 	utils::format("RX64M StadbyRAM/LOG sample\n");
 
-	log_man_.start();
+	if(log_man_.start()) {
+		LOG_TRACE(log_man_, "Restart: %u bytes", static_cast<uint32_t>(log_man_.get_length()));
+	}
 
 	device::PORT0::PDR.B7 = 1; // output
 
@@ -108,15 +110,11 @@ int main(int argc, char** argv)
 				if(command_.cmp_word(0, "log")) {
 					auto len = log_man_.get_length();
 					utils::format("LOG length: %d\n") % len;
-					uint16_t pos = 0;
-					while(pos < len) {
-						char ch = log_man_.getch(pos);
-						if(ch == '\n') {
-							sci_putch('\r');
-						}
-						sci_putch(ch);
-						++pos;
-					}
+					log_man_.list();
+				} else if(command_.cmp_word(0, "dump")) {
+					log_man_.list(true);
+				} else if(command_.cmp_word(0, "trace")) {
+					LOG_TRACE(log_man_, "Trace: cnt %u, LED %d", cnt, (cnt < 10) ? 1 : 0);
 				} else if(command_.cmp_word(0, "start")) {
 					utils::format("Start LOG\n");
 					loge = true;
@@ -127,6 +125,8 @@ int main(int argc, char** argv)
 					utils::format("start\n");
 					utils::format("clear\n");
 					utils::format("log\n");
+					utils::format("dump     (hex records for 'logdec')\n");
+					utils::format("trace\n");
 				} else {
 					char buff[32];
 					if(command_.get_word(0, buff, sizeof(buff))) {
@@ -44,9 +44,9 @@
 // DRW2D エンジンを使う場合
 // #define USE_DRW2D
 
-#include "graphics/tgl.hpp"
-
 #include "RX600/drw2d_mgr.hpp"
+#include "graphics/tgl_drw2d.hpp"
+#include "graphics/tgl_soft.hpp"
 
 namespace {
 
@@ -147,7 +147,12 @@ namespace {
 	static const uint32_t V_NUM = 500;  // 最大の頂点数
 	static const uint32_t P_NUM = 300;  // プリミティブ最大数
 	static const uint32_t T_NUM = 32;   // テクスチャー管理数
+#ifdef USE_DRW2D
 	typedef graphics::tgl<RENDER, V_NUM, P_NUM, T_NUM> TGL;
+#else
+	// Z バッファ（480 x 272 x 2 バイト）はフレームバッファと同時には RAM に入らないので使わない
+	typedef graphics::tgl<RENDER, V_NUM, P_NUM, T_NUM, graphics::tgl_soft<RENDER> > TGL;
+#endif
 	TGL			tgl_(render_);
 
 	// QSPI B グループ
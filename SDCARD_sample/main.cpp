@@ -137,8 +137,10 @@ namespace {
 	typedef device::SCI9 SCI_CH;
 	typedef device::PORT<device::PORT6, device::bitpos::B4, 0> SDC_POWER;  ///< 「０」でＯＮ
 	typedef device::NULL_PORT SDC_WPRT;  ///< カード書き込み禁止ポート設定
-	typedef fatfs::sdhi_io<device::SDHI, SDC_POWER, SDC_WPRT, device::port_map::ORDER::THIRD> SDC;
+	// DMAC0 でブロック転送
+	typedef fatfs::sdhi_io<device::SDHI, SDC_POWER, SDC_WPRT, device::port_map::ORDER::THIRD, device::DMAC0> SDC;
 	SDC		sdc_;
+	#define USE_SDHI
 
 	#define TOUCH_FILER
 	static const int16_t LCD_X = 480;
@@ -160,8 +162,10 @@ namespace {
 	typedef device::SCI2 SCI_CH;
 	typedef device::PORT<device::PORT4, device::bitpos::B2> SDC_POWER;
 	typedef device::NULL_PORT SDC_WPRT;  ///< カード書き込み禁止ポート設定
-	typedef fatfs::sdhi_io<device::SDHI, SDC_POWER, SDC_WPRT, device::port_map::ORDER::THIRD> SDC;
+	// DMAC0 でブロック転送
+	typedef fatfs::sdhi_io<device::SDHI, SDC_POWER, SDC_WPRT, device::port_map::ORDER::THIRD, device::DMAC0> SDC;
 	SDC		sdc_;
+	#define USE_SDHI
 
 	#define TOUCH_FILER
 	static const int16_t LCD_X = 480;
@@ -218,6 +222,14 @@ namespace {
 
 	static const uint32_t CMT_FREQ = 1000;  ///< 計測用タイマー分解能
 
+	// 速度テストの転送単位（マルチ・ブロック転送になるように大きく取る）
+#if defined(SIG_RX24T)
+	static const uint32_t TEST_BUFF_SIZE = 512;
+#else
+	static const uint32_t TEST_BUFF_SIZE = 8192;
+#endif
+	uint32_t test_buff_[TEST_BUFF_SIZE / 4];  // DMA 転送出来るように４バイト境界
+
 	class cmt_task {
 		volatile uint32_t	cnt_;
 		volatile uint32_t	div_;
@@ -314,15 +326,39 @@ namespace {
 	TOUCH	touch_(ft5206_i2c_);
 #endif
 
+	// 転送速度の表示（MB/s は小数点以下２桁）
+	void list_speed_(const char* head, uint32_t size, uint32_t t)
+	{
+		if(t == 0) t = 1;
+		auto pbyte = static_cast<uint64_t>(size) * CMT_FREQ / t;
+		auto mbs = pbyte * 100 / (1024 * 1024);
+		utils::format("%s: %d KBytes/Sec (%d.%02d MB/s)\n") % head
+			% static_cast<uint32_t>(pbyte / 1024)
+			% static_cast<uint32_t>(mbs / 100) % static_cast<uint32_t>(mbs % 100);
+	}
+
+
+	void list_sdc_()
+	{
+#ifdef USE_SDHI
+		utils::format("SD bus: %d [MHz], %s, %s\n")
+			% (sdc_.get_bus_clock() / 1'000'000)
+			% (sdc_.is_high_speed() ? "High-Speed" : "Default-Speed")
+			% (sdc_.is_dma() ? "DMA" : "CPU");
+#endif
+	}
+
+
 	// ファイル書き込みテスト
 	bool write_test_(const char* fname, uint32_t size)
 	{
 		utils::format("Write: '%s'\n") % fname;
+		list_sdc_();
 
-		uint8_t buff[512];
+		auto buff = reinterpret_cast<uint8_t*>(test_buff_);
 		utils::file_io fio;
 
-		for(uint16_t i = 0; i < sizeof(buff); ++i) {
+		for(uint16_t i = 0; i < TEST_BUFF_SIZE; ++i) {
 			buff[i] = rand();
 		}
 
@@ -337,7 +373,7 @@ namespace {
 
 		auto rs = size;
 		while(rs > 0) {
-			UINT sz = sizeof(buff);
+			UINT sz = TEST_BUFF_SIZE;
 			if(sz > rs) sz = rs;
 			auto bw = fio.write(buff, sz);
 			LED::P = !LED::P();
@@ -352,9 +388,7 @@ namespace {
 		uint32_t tclose = ed - st;
 
 		utils::format("Write Open:  %d [ms]\n") % (topen * 1000 / CMT_FREQ);
-		auto pbyte = size * CMT_FREQ / twrite;
-//		utils::format("Write: %d Bytes/Sec\n") % pbyte;
-		utils::format("Write: %d KBytes/Sec\n") % (pbyte / 1024);
+		list_speed_("Write", size, twrite);
 		utils::format("Write Close: %d [ms]\n") % (tclose * 1000 / CMT_FREQ);
 
 		return true;
@@ -365,6 +399,7 @@ namespace {
 	void read_test_(const char* fname, uint32_t size)
 	{
 		utils::format("Read: '%s'\n") % fname;
+		list_sdc_();
 
 		auto st = cmt_.get_counter();
 		utils::file_io fin;
@@ -378,10 +413,9 @@ namespace {
 
 		auto rs = size;
 		while(rs > 0) {
-			uint8_t buff[512];
-			uint32_t sz = sizeof(buff);
+			uint32_t sz = TEST_BUFF_SIZE;
 			if(sz > rs) sz = rs;
-			auto s = fin.read(buff, sz);
+			auto s = fin.read(test_buff_, sz);
 			if(s == 0) break;
 			LED::P = !LED::P();
 			rs -= s;
@@ -395,9 +429,7 @@ namespace {
 		uint32_t tclose = ed - st;
 
 		utils::format("Read Open:  %d [ms]\n") % (topen * 1000 / CMT_FREQ);
-		auto pbyte = size * CMT_FREQ / tread;
-//		utils::format("Read: %d Bytes/Sec\n") % pbyte;
-		utils::format("Read: %d KBytes/Sec\n") % (pbyte / 1024);
+		list_speed_("Read", size, tread);
 		utils::format("Read Close: %d [ms]\n") % (tclose * 1000 / CMT_FREQ);
 	}
 
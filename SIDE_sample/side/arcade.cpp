@@ -20,23 +20,13 @@
 #include "arcade.h"
 
 InvadersMachine::InvadersMachine()
+    : cpu_( *this )
 {
-    cpu_ = new I8080( *this );
     reset();
     memset( ram_, 0, 0x2000 );  // Clear the ROM area
     setFrameRate( 60 );
 }
 
-InvadersMachine::~InvadersMachine()
-{
-    delete cpu_;
-}
-
-unsigned char InvadersMachine::readByte( unsigned addr ) 
-{
-    return addr < sizeof(ram_) ? ram_[addr] : 0xFF;
-}
-
 unsigned char InvadersMachine::readPort( unsigned port ) 
 {
     unsigned char   b = 0;
@@ -88,36 +78,13 @@ void InvadersMachine::writePort( unsigned addr, unsigned char b )
     }
 }
 
-void InvadersMachine::writeByte( unsigned addr, unsigned char b )
-{
-    if( addr < 0x2000 || addr >= 0x4000 )
-        return;
-
-    ram_[addr] = b;
-
-    if( addr >= 0x2400 ) {
-        // This is a write to video memory. Since the video screen is rotated, 
-        // consecutive bits correspond to vertically consecutive pixels.
-        // This is accounted for in the following code, and an extra buffer
-        // is used to store the video memory in a more useable form.
-		unsigned k, y;
-
-		addr -= 0x2400;
-		y = ((255 - ((addr & 0x1F) * 8) )*224) + (addr / 32);
-        for( k=1; k<=128; k<<=1 ) {
-            video_[y] = b & k;
-			y -= ScreenWidth;
-        }
-    }
-}
-
 void InvadersMachine::reset( int ships, int easy )
 {
     // Make sure the number of ships is valid
     if( ships < 3 || ships > 6 ) ships = 3;
 
     // Reset the CPU and the other machine settings
-    cpu_->reset();
+    cpu_.reset();
     port1_ = 0;
     port2i_ = (ships - 3) & 0x03;   // DIP switches
     port2o_ = 0;
@@ -129,7 +96,7 @@ void InvadersMachine::reset( int ships, int easy )
 
     // Clear the RAM, but avoid the ROM area
     memset( ram_+0x2000, 0, sizeof(ram_)-0x2000 );
-    memset( video_, 0, sizeof(video_) );
+    dirty_ = 0xFFFFFFFF;
 
     // Win a ship at 1000 if easy, otherwise at 1500 (DIP switch)
     if( easy ) port2i_ |= 0x04; 
@@ -144,14 +111,13 @@ void InvadersMachine::step()
     // Before a frame is fully rendered, two interrupts have to occur
     for( int i=0; i<2; i++ ) {
         // Go on until an interrupt occurs
-        while( cpu_->getCycles() < cycles_per_interrupt_ )
-            cpu_->step();
+        cpu_.run( cycles_per_interrupt_ );
 
         // Adjust the cycles count
-        cpu_->setCycles( cpu_->getCycles() - cycles_per_interrupt_ );
+        cpu_.setCycles( cpu_.getCycles() - cycles_per_interrupt_ );
     
         // Call the proper interrupt
-        cpu_->interrupt( i ? 0x10 : 0x08 );
+        cpu_.interrupt( i ? 0x10 : 0x08 );
     }
 }
 
@@ -28,8 +28,9 @@
     Space Invaders arcade machine emulator.
 
     This class emulates in software the original Space Invaders arcade machine. It uses
-    the I8080 emulator to emulate the CPU and extends the I8080Environment to provide
-    the required functions to the CPU emulation.
+    the I8080 emulator to emulate the CPU and implements the I8080Environment interface
+    to provide the required functions to the CPU emulation. The CPU is instantiated for
+    this class, so memory accesses are inlined into the opcode handlers.
 
     For portability, this class does not make direct use of functions that may depend
     on a specific system, such as sound and video. However, it does provide access to
@@ -44,8 +45,10 @@
     @see I8080
     @see I8080Environment
 */
-class InvadersMachine : public I8080Environment
+class InvadersMachine
 {
+    friend class I8080<InvadersMachine>;
+
 public:
     /** Machine-related definitions. */
     enum Constants {
@@ -85,9 +88,6 @@ public:
     /** Constructor. */
     InvadersMachine();
 
-    /** Destructor. */
-    virtual ~InvadersMachine();
-
     /**
         Resets the machine.
 
@@ -112,20 +112,32 @@ public:
     void fireEvent( int event );
 
     /** 
-        Returns a pointer to the game video memory in normalized form
-        (224x256, one byte per pixel).
+        Returns a pointer to the game video memory in its original form.
 
         The original machine uses a one bit per pixel monochrome video adapter, where
-        a byte contains eight <i>vertically aligned</i> pixels. Since this format is not 
-        in use anymore, the emulator reorganizes video memory so that there is one <i>byte</i>
-        per pixel, with scanlines arranged <i>as usual</i>: the first scanline starts at offset
-        <b>0</b>, the second at offset <b>224</b> and so on. This "wastes" some memory,
-        but makes it much easier to render the video on current cards.
+        a byte contains eight <i>vertically aligned</i> pixels, because the monitor is
+        rotated. The byte at offset <b>x*32 + g</b> holds the pixels at column <b>x</b>
+        (0 to 223) and rows <b>255-8*g-k</b>, where <b>k</b> is the bit number (LSB first).
+
+        @return a pointer to the 7K video RAM
+    */
+    const unsigned char * getVideoRAM() const {
+        return ram_ + 0x2400;
+    }
+
+    /**
+        Returns and clears the set of changed video line groups.
 
-        @return a pointer to a 224x256 byte array, where each byte corresponds to a screen pixel
+        Bit <b>g</b> is set when any byte of group <b>g</b> (rows 248-8*g to 255-8*g)
+        was written with a different value since the last call, so only those rows
+        need to be converted and drawn. All bits are set after a reset.
+
+        @return dirty line group mask
     */
-    const unsigned char * getVideo() const {
-        return video_;
+    unsigned fetchDirty() {
+        unsigned d = dirty_;
+        dirty_ = 0;
+        return d;
     }
 
     /**
@@ -218,10 +230,40 @@ public:
     }
 
 protected:
-    // Implementation of the CpuEnvironment interface
-    unsigned char readByte( unsigned addr );
+    // Implementation of the I8080Environment interface
+    unsigned char readByte( unsigned addr ) {
+        return addr < sizeof(ram_) ? ram_[addr] : 0xFF;
+    }
+
+    unsigned readWord( unsigned addr ) {
+        if( addr < (sizeof(ram_) - 1) )
+            return ram_[addr] | ((unsigned)ram_[addr+1] << 8);
+        return readByte(addr) | ((unsigned)readByte(addr+1) << 8);
+    }
 
-    void writeByte( unsigned, unsigned char );
+    void writeByte( unsigned addr, unsigned char b ) {
+        if( addr < 0x2000 || addr >= 0x4000 ) // ROM, unmapped
+            return;
+        if( addr < 0x2400 ) {   // Work RAM
+            ram_[addr] = b;
+            return;
+        }
+        // Video RAM: the screen is rotated, a byte holds eight vertical pixels
+        if( ram_[addr] != b ) {
+            ram_[addr] = b;
+            dirty_ |= 1U << (addr & 0x1F);
+        }
+    }
+
+    void writeWord( unsigned addr, unsigned value ) {
+        if( addr >= 0x2000 && addr < 0x23FF ) { // Stack is in work RAM
+            ram_[addr] = value & 0xFF;
+            ram_[addr+1] = (value >> 8) & 0xFF;
+            return;
+        }
+        writeByte( addr, value & 0xFF );
+        writeByte( addr+1, (value >> 8) & 0xFF );
+    }
 
     unsigned char readPort( unsigned port );
 
@@ -236,11 +278,11 @@ private:
     unsigned char   port4hi_;   // Port 4 out (hi)
     unsigned char   port5o_;    // Port 5 out
     unsigned char   ram_[0x4000];
-    unsigned char   video_[ScreenWidth*ScreenHeight];
+    unsigned        dirty_;
     unsigned        sounds_;
     unsigned        fps_;
     unsigned        cycles_per_interrupt_;
-    I8080 *         cpu_;
+    I8080<InvadersMachine>  cpu_;
 };
 
 #endif // ARCADE_H_
@@ -18,20 +18,26 @@
     Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 */
 #include "i8080.h"
+#include "i8080opc.h"
+#include "i8080sub.h"
+#include "arcade.h"
 
-I8080::I8080( I8080Environment & env )
+template <class ENV>
+I8080<ENV>::I8080( ENV & env )
     : env_( env )
 {
     reset();
 }
 
-I8080::I8080( const I8080 & cpu )
+template <class ENV>
+I8080<ENV>::I8080( const I8080 & cpu )
     : env_( cpu.env_ )
 {
     operator = ( cpu );
 }
 
-I8080 & I8080::operator = ( const I8080 & cpu )
+template <class ENV>
+I8080<ENV> & I8080<ENV>::operator = ( const I8080 & cpu )
 {
     B = cpu.B;
     C = cpu.C;
@@ -50,7 +56,8 @@ I8080 & I8080::operator = ( const I8080 & cpu )
     return *this;
 }
 
-void I8080::reset()
+template <class ENV>
+void I8080<ENV>::reset()
 {
     B = 0; 
     C = 0;
@@ -67,19 +74,35 @@ void I8080::reset()
     cycles_ = 0;
 }
 
-void I8080::step()
+template <class ENV>
+void I8080<ENV>::step()
 {
-    unsigned op = env_.readByte( PC++ );
+    const OpcodeInfo & info = Opcode_[ env_.readByte( PC++ ) ];
 
     // Execute
-    cycles_ += Opcode_[ op ].cycles;
-    if( Opcode_[ op ].handler )
-        (this->*(Opcode_[ op ].handler))();
+    cycles_ += info.cycles;
+    if( info.handler )
+        (this->*(info.handler))();
 
     PC &= 0xFFFF;
 }
 
-void I8080::interrupt( unsigned address )
+template <class ENV>
+void I8080<ENV>::run( unsigned cycles )
+{
+    while( cycles_ < cycles ) {
+        const OpcodeInfo & info = Opcode_[ env_.readByte( PC++ ) ];
+
+        cycles_ += info.cycles;
+        if( info.handler )
+            (this->*(info.handler))();
+
+        PC &= 0xFFFF;
+    }
+}
+
+template <class ENV>
+void I8080<ENV>::interrupt( unsigned address )
 {
     if( F & Interrupt ) {
         if( halted_ ) {
@@ -91,3 +114,6 @@ void I8080::interrupt( unsigned address )
         PC = address & 0xFFFF;
     }
 }
+
+// CPU instances for the machines in use
+template class I8080<InvadersMachine>;
@@ -28,7 +28,9 @@
 
     An object (instance) of this class corresponds to a system that has no RAM, ROM or 
     ports: users of the I8080 emulator should provide the desired behaviour by writing a
-    descendant of this class that overrides the required functions.
+    class with the same member functions and passing it as the template parameter of
+    I8080. The functions are not virtual: the CPU is instantiated for the concrete
+    machine, so that memory and port accesses can be inlined.
 
     @author Alessandro Scotti
 */
@@ -44,10 +46,6 @@ public:
     I8080Environment() {
     }
 
-    /** Destructor. */
-    virtual ~I8080Environment() {
-    }
-
     /**
         Reads one byte from memory at the specified address.
 
@@ -61,7 +59,7 @@ public:
 
         @return the content of the specified memory address
     */
-    virtual unsigned char readByte( unsigned addr ) {
+    unsigned char readByte( unsigned addr ) {
         return 0xFF;
     }
 
@@ -74,12 +72,12 @@ public:
         handle them according to the implemented system 
         specifications.
 
-        The default implementation uses <i>readByte()</i>, so it is not
-        strictly necessary to override this method.
+        The default implementation uses <i>readByte()</i>; a machine
+        class must provide its own version.
 
         @see #readByte
     */
-    virtual unsigned readWord( unsigned addr ) {
+    unsigned readWord( unsigned addr ) {
         return readByte(addr) | (unsigned)(readByte(addr+1) << 8);
     }
 
@@ -95,7 +93,7 @@ public:
         @param  addr    address of memory byte to write
         @param  value   value to write at specified address
     */
-    virtual void writeByte( unsigned addr, unsigned char value ) {
+    void writeByte( unsigned addr, unsigned char value ) {
     }
 
     /**
@@ -107,8 +105,8 @@ public:
         handle them according to the specifications of the
         emulated system.
 
-        The default implementation uses <i>writeByte()</i>, so it is not
-        strictly necessary to override this method.
+        The default implementation uses <i>writeByte()</i>; a machine
+        class must provide its own version.
 
         <b>Note:</b> the low order byte is placed at the lowest address.
 
@@ -117,7 +115,7 @@ public:
 
         @see #writeByte
     */
-    virtual void writeWord( unsigned addr, unsigned value ) {
+    void writeWord( unsigned addr, unsigned value ) {
         writeByte( addr, value & 0xFF );
         writeByte( addr+1, (value >> 8) & 0xFF );
     }
@@ -131,7 +129,7 @@ public:
 
         @return the value of the specified port
     */
-    virtual unsigned char readPort( unsigned port ) {
+    unsigned char readPort( unsigned port ) {
         return 0xFF;
     }
 
@@ -143,15 +141,21 @@ public:
         @param  port    address of port to write
         @param  value   value to write to specified port
     */
-    virtual void writePort( unsigned port, unsigned char value ) {
+    void writePort( unsigned port, unsigned char value ) {
     }
 };
 
 /**
     I8080 CPU emulator.
 
+    The CPU is a template on the environment (machine) class, see I8080Environment
+    for the required interface. The member functions are defined in i8080.cpp,
+    i8080opc.h and i8080sub.h, and i8080.cpp explicitly instantiates the CPU for
+    the machines in use.
+
     @author Alessandro Scotti
 */
+template <class ENV = I8080Environment>
 class I8080
 {
 public:
@@ -198,27 +202,30 @@ public:
 
         @see I8080Environment
     */
-    I8080( I8080Environment & env );
+    I8080( ENV & env );
 
     /** Copy constructor. */
     I8080( const I8080 & cpu );
 
-    /** Destructor. */
-    virtual ~I8080() {
-    }
-
     /** Resets the CPU to its initial state. */
-    virtual void reset();
+    void reset();
 
     /** Executes one CPU instruction. */
-    virtual void step();
+    void step();
+
+    /**
+        Executes instructions until the cycle counter reaches the specified value.
+
+        @param  cycles  cycle count to reach
+    */
+    void run( unsigned cycles );
 
     /** 
         Informs the CPU that an interrupt has occurred.
 
         @param  address 16-bit address of the interrupt handler
     */
-    virtual void interrupt( unsigned address );
+    void interrupt( unsigned address );
 
     /** Returns the 16-bit pseudo-register AF. */
     unsigned AF() const {
@@ -558,7 +565,7 @@ private:
 
     unsigned            halted_;
     unsigned            cycles_;
-    I8080Environment &  env_;
+    ENV &               env_;
 };
 
 #endif // I8080_H_
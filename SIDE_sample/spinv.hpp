@@ -3,7 +3,7 @@
 /*!	@file
 	@brief	Space Invaders Emulator (side)
     @author 平松邦仁 (hira@rvf-rc45.net)
-	@copyright	Copyright (C) 2018 Kunihito Hiramatsu @n
+	@copyright	Copyright (C) 2018, 2021 Kunihito Hiramatsu @n
 				Released under the MIT license @n
 				https://github.com/hirakuni45/RX/blob/master/LICENSE
 */
@@ -154,20 +154,28 @@ namespace emu {
 		{
 			uint8_t pad = get_fami_pad();
 
-			const uint8_t* video = im_.getVideo();
-			if(video != nullptr) {
+			// 変化したライン・グループ（８ライン単位）だけを変換して描画する
+			uint32_t dirty = im_.fetchDirty();
+			if(dirty != 0) {
+				const uint8_t* vram = im_.getVideoRAM();
 				uint16_t* fb = static_cast<uint16_t*>(org);
 				uint32_t yo = (h - InvadersMachine::ScreenHeight) / 2;
 				uint32_t xo = (w - InvadersMachine::ScreenWidth) / 2;
-				for(uint32_t y = 0; y < InvadersMachine::ScreenHeight; ++y) {
-					uint32_t c = scan_lines_[y];
+				for(uint32_t g = 0; g < 32; ++g) {
+					if((dirty & (1 << g)) == 0) continue;
+					uint32_t y = InvadersMachine::ScreenHeight - 1 - g * 8;
+					uint16_t* top = &fb[(y + yo) * w + xo];
+					const uint16_t* cols = &scan_lines_[y];
+					const uint8_t* src = &vram[g];
 					for(uint32_t x = 0; x < InvadersMachine::ScreenWidth; ++x) {
-						if( *video ) {
-							fb[(y + yo) * w + x + xo] = c;
-						} else {
-							fb[(y + yo) * w + x + xo] = 0x0000;
+						uint32_t b = *src;
+						src += 32;
+						uint16_t* p = top + x;
+						for(uint32_t k = 0; k < 8; ++k) {
+							*p = (b & 1) ? cols[-static_cast<int32_t>(k)] : 0x0000;
+							b >>= 1;
+							p -= w;
 						}
-						++video;
 					}
 				}
 			}
@@ -30,7 +30,7 @@
 
 #include "synth_gui.hpp"
 
-#include "sound/smf/MD_MIDIFile.h"
+#include "sound/smf_stream.hpp"
 
 #include "sound/psg_mng.hpp"
 
@@ -231,7 +231,10 @@ namespace {
 
 	uint32_t	microsec_ = 0;
 	bool		midifile_ = false;
-	MD_MIDIFile	mdf_;
+	// SMF はロード時に全トラックをマージしてここへ展開（入りきらない場合はストリーミング再生）
+	uint8_t		smf_buff_[64 * 1024];
+	typedef sound::smf_stream<> SMF_STREAM;
+	SMF_STREAM	smf_(smf_buff_, sizeof(smf_buff_));
 
 
 	void service_note_() noexcept
@@ -314,23 +317,16 @@ namespace {
 	}
 
 
-	void midiCallback_(midi_event *pev)
+	void midiCallback_(const uint8_t* msg, uint32_t len)
 	{
-		if((pev->data[0] >= 0x80) && (pev->data[0] <= 0xe0)) {
-			uint8_t tmp = pev->data[0] | pev->channel;
-			ring_buffer_.Write(&tmp, 1);
-			ring_buffer_.Write(&pev->data[1], pev->size - 1);
-		} else {
-			ring_buffer_.Write(pev->data, pev->size);
-		}
+		ring_buffer_.Write(msg, len);
 #if 0
-		utils::format("T: %d") % static_cast<int>(pev->track);
-		utils::format(", Ch: %d\n") % static_cast<int>(pev->channel+1);
-		for (uint8_t i=0; i<pev->size; i++) {
+		utils::format("Ch: %d\n") % static_cast<int>((msg[0] & 0x0f) + 1);
+		for (uint32_t i = 0; i < len; i++) {
 			if(i == 0) {
-				utils::format("  %d") % static_cast<uint8_t>(pev->data[i]);
+				utils::format("  %d") % static_cast<uint8_t>(msg[i]);
 			} else {
-				utils::format(", %d") % static_cast<uint8_t>(pev->data[i]);
+				utils::format(", %d") % static_cast<uint8_t>(msg[i]);
 			}
 		}
 		utils::format("\n");
@@ -338,12 +334,11 @@ namespace {
 	}
 
 
-	void sysexCallback_(sysex_event *pev)
+	void sysexCallback_(const uint8_t* data, uint32_t len)
 	{
 #if 0
-		utils::format("T: %d") % static_cast<int>(pev->track);
-		for (uint8_t i=0; i<pev->size; i++) {
-			utils::format("%d,") % static_cast<int>(pev->data[i]);
+		for (uint32_t i = 0; i < len; i++) {
+			utils::format("%d,") % static_cast<int>(data[i]);
 		}
 		utils::format("\n");
 #endif
@@ -1320,12 +1315,6 @@ void select_synth_color(uint32_t no)
 }
 
 
-uint32_t micros()
-{
-	return microsec_;
-}
-
-
 extern "C" {
 
 	void set_sample_rate(uint32_t freq)
@@ -1470,9 +1459,8 @@ int main(int argc, char** argv)
 	synth_gui_.start(synth_color_name_);
 
 	{  // SMF プレイヤーの設定
-		mdf_.begin(nullptr);
-		mdf_.setMidiHandler(midiCallback_);
-		mdf_.setSysexHandler(sysexCallback_);
+		smf_.set_midi_task(midiCallback_);
+		smf_.set_sysex_task(sysexCallback_);
 	}
 
 	LED::DIR = 1;
@@ -1516,8 +1504,7 @@ int main(int argc, char** argv)
 			uint32_t id;
 			auto fn = synth_gui_.get_file_name(id);
 			if(id != file_id_) {
-				auto state = mdf_.load(fn);
-				if(state == MD_MIDIFile::E_OK) {
+				if(smf_.load(fn)) {
 					midifile_ = true;
 				}
 				file_id_ = id;
@@ -1529,12 +1516,10 @@ int main(int argc, char** argv)
 ///		command_();
 
 		if(midifile_) {
-		    if(!mdf_.isEOF()) {
-				if(mdf_.getNextEvent()) {
-       				// tickMetronome(mdf_.getTempo());
-   				}
+			if(!smf_.is_eof()) {
+				smf_.service(microsec_);
 			} else {
-				mdf_.close();
+				smf_.close();
 				midifile_ = false;
 			}
 		}
@@ -20,6 +20,7 @@
 #include "graphics/kfont.hpp"
 #include "graphics/font.hpp"
 #include "graphics/tgl.hpp"
+#include "graphics/tgl_drw2d.hpp"
 #include "graphics/shape_3d.hpp"
 
 #include "common/sci_i2c_io.hpp"
@@ -187,6 +188,7 @@ int main(int argc, char** argv)
 		tex_id_ = tgl_.GenTexture();
 		tgl_.BindTexture(TGL::TARGET::TEXTURE_2D, tex_id_);
 		tgl_.TexImage2D(TGL::TARGET::TEXTURE_2D, vtx::spos(TEX_W, TEX_H), TGL::FORMAT::RGBA8, texture_);
+		tgl_.enable(TGL::CTRL::TEXTURE_2D);
 	}
 
 	LED::OUTPUT();
@@ -2,93 +2,539 @@
 //=====================================================================//
 /*!	@file
 	@brief	HUB75 RGB LED Panel Driver クラス @n
-				R[01], G[01], B[01], SCLK, LATCH, BLANK(/OE), ADR[0-3] @n
+				R[01], G[01], B[01], SCLK, LATCH, BLANK(/OE), ADR[0-4] @n
 				note: http://bikerglen.com/projects/lighting/led-panel-1up/#Required_Hardware @n
 				 1: R1      2: G1    @n
 				 3: B1      4: GND   @n
 				 5: R2      6: G2    @n
-				 7: B2      8: GND   @n
+				 7: B2      8: E     @n
 				 9: A      10: B     @n
 				11: C      12: D     @n
 				13: CLK    14: LAT   @n
-				15: /OE    16: GND
-	@copyright	Copyright (C) 2018 Kunihito Hiramatsu @n
+				15: /OE    16: GND @n
+			・バイナリー・コード変調（BCM）で、各色最大 8 ビットの階調を出す。@n
+			・R1, G1, B1, R2, G2, B2, CLK は、同じ８ビット・ポートの B0 〜 B6 に配置する。@n
+			・フレームバッファをビット・プレーン（ポート・ワード列）に変換し（hub75_encoder）、@n
+			  タイマー起動の DMAC でポートへ出力する。@n
+			・表示時間はもう一つのタイマー（CMT）で決め、DMA 完了と表示時間経過の@n
+			  両方が揃った所で、ラッチ、行選択を行い、次のプレーンを転送する（hub75_scan）。@n
+			・hub75_encoder、hub75_scan はハードウェアに依存しないので、ホストでも試験出来る。
+	@copyright	Copyright (C) 2018, 2021 Kunihito Hiramatsu @n
 				Released under the MIT license @n
 				https://github.com/hirakuni45/RX/blob/master/LICENSE
 */
 //=====================================================================//
+#include <cstdint>
+#include <cstring>
 #include <cmath>
 
 namespace chip {
 
 	//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
 	/*!
-		@brief  HUB75 カラム選択ポート・クラス
-		@param[in]	a	デコーダーＡ
-		@param[in]	b	デコーダーＢ
-		@param[in]	c	デコーダーＣ
-		@param[in]	d	デコーダーＤ
+		@brief  HUB75 ポート・ワードのビット配置
 	*/
 	//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
-	template <PORT a, PORT b, PORT c, PORT d>
-	class PORTS {
+	struct hub75_bits {
+		static const uint8_t R1  = 0x01;
+		static const uint8_t G1  = 0x02;
+		static const uint8_t B1  = 0x04;
+		static const uint8_t R2  = 0x08;
+		static const uint8_t G2  = 0x10;
+		static const uint8_t B2  = 0x20;
+		static const uint8_t CLK = 0x40;
+	};
+
+
+	//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+	/*!
+		@brief  HUB75 ビット・プレーン・エンコーダー @n
+				フレームバッファを、BCM 用のポート・ワード列に変換する。@n
+				１行１プレーンは、ピクセル毎に「CLK=0, CLK=1」の２ワード。@n
+				バッファは２面持ち、表示中の面とは別の面に変換する。
+		@param[in]	WIDTH	パネルの幅（チェインした全体）
+		@param[in]	HEIGHT	パネルの高さ
+		@param[in]	DEPTH	各色のビット数（最大８）
+	*/
+	//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+	template <uint32_t WIDTH, uint32_t HEIGHT, uint32_t DEPTH = 8>
+	class hub75_encoder {
+
+		static_assert(DEPTH >= 1 && DEPTH <= 8, "DEPTH must be 1 to 8");
+		static_assert((HEIGHT & 1) == 0, "HEIGHT must be even");
+
 	public:
-		static void init() {
-			a::DIR = 1;
-			b::DIR = 1;
-			c::DIR = 1;
-			d::DIR = 1;
+		static const uint32_t DEPTH_ = DEPTH;
+		static const uint32_t ROWS  = HEIGHT / 2;		///< スキャン行数
+		static const uint32_t LINE  = WIDTH * 2;		///< １行１プレーンのワード数
+		static const uint32_t PLANE = ROWS * LINE;		///< １プレーンのワード数
+		static const uint32_t FRAME = DEPTH * PLANE;	///< １画面のワード数
+
+	private:
+		// ガンマ補正後の値の各ビットを、バイト毎に広げた値（バイト n がプレーン n）
+		uint64_t	spread_[256];
+		uint8_t		gamma_[256];
+
+		uint8_t		buf_[2][FRAME];
+		volatile uint8_t	front_;
+		volatile bool		swap_;
+
+		uint8_t*	back_() noexcept { return buf_[front_ ^ 1]; }
+
+		void put_(uint8_t* dst, uint32_t x, uint64_t w) noexcept
+		{
+			dst += x * 2;
+			for(uint32_t b = 0; b < DEPTH; ++b) {
+				uint8_t v = static_cast<uint8_t>(w >> (b * 8));
+				dst[0] = v;
+				dst[1] = v | hub75_bits::CLK;
+				dst += PLANE;
+			}
 		}
 
-		static void out(uint32_t v) {
-			a::P = v & 1;
-			b::P = (v >> 1) & 1;
-			c::P = (v >> 2) & 1;
-			d::P = (v >> 3) & 1;
+
+		uint64_t word_(uint8_t r1, uint8_t g1, uint8_t b1, uint8_t r2, uint8_t g2, uint8_t b2) const noexcept
+		{
+			return spread_[r1] | (spread_[g1] << 1) | (spread_[b1] << 2)
+				| (spread_[r2] << 3) | (spread_[g2] << 4) | (spread_[b2] << 5);
+		}
+
+
+		static uint8_t r5_(uint16_t c) noexcept { uint8_t v = (c >> 11) & 0x1f; return (v << 3) | (v >> 2); }
+		static uint8_t g6_(uint16_t c) noexcept { uint8_t v = (c >> 5) & 0x3f; return (v << 2) | (v >> 4); }
+		static uint8_t b5_(uint16_t c) noexcept { uint8_t v = c & 0x1f; return (v << 3) | (v >> 2); }
+
+	public:
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	コンストラクタ
+		 */
+		//-----------------------------------------------------------------//
+		hub75_encoder() noexcept : spread_{ }, gamma_{ }, buf_{ }, front_(0), swap_(false)
+		{
+			set_gamma(2.2f);
+			for(uint32_t i = 1; i < FRAME; i += 2) {  // 黒画面
+				buf_[0][i] = hub75_bits::CLK;
+				buf_[1][i] = hub75_bits::CLK;
+			}
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	ガンマ・テーブルの設定
+			@param[in]	gamma	ガンマ値（1.0 でリニア）
+		 */
+		//-----------------------------------------------------------------//
+		void set_gamma(float gamma) noexcept
+		{
+			const float max = static_cast<float>((1 << DEPTH) - 1);
+			for(uint32_t i = 0; i < 256; ++i) {
+				auto v = std::pow(static_cast<float>(i) / 255.0f, gamma) * max + 0.5f;
+				gamma_[i] = static_cast<uint8_t>(v);
+				uint64_t s = 0;
+				for(uint32_t b = 0; b < DEPTH; ++b) {
+					if(gamma_[i] & (1 << b)) s |= static_cast<uint64_t>(1) << (b * 8);
+				}
+				spread_[i] = s;
+			}
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	ガンマ補正値を取得
+			@param[in]	v	入力値（0 to 255）
+			@return 補正値（0 to 2^DEPTH - 1）
+		 */
+		//-----------------------------------------------------------------//
+		uint8_t get_gamma(uint8_t v) const noexcept { return gamma_[v]; }
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	RGB565 フレームバッファを変換
+			@param[in]	src		フレームバッファ（左上）
+			@param[in]	stride	１ラインのピクセル数
+		 */
+		//-----------------------------------------------------------------//
+		void encode(const uint16_t* src, uint32_t stride) noexcept
+		{
+			auto out = back_();
+			for(uint32_t y = 0; y < ROWS; ++y) {
+				const auto* up = src + y * stride;
+				const auto* lo = src + (y + ROWS) * stride;
+				auto dst = out + y * LINE;
+				for(uint32_t x = 0; x < WIDTH; ++x) {
+					auto c1 = up[x];
+					auto c2 = lo[x];
+					put_(dst, x, word_(r5_(c1), g6_(c1), b5_(c1), r5_(c2), g6_(c2), b5_(c2)));
+				}
+			}
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	RGB888 (0x00RRGGBB) フレームバッファを変換
+			@param[in]	src		フレームバッファ（左上）
+			@param[in]	stride	１ラインのピクセル数
+		 */
+		//-----------------------------------------------------------------//
+		void encode(const uint32_t* src, uint32_t stride) noexcept
+		{
+			auto out = back_();
+			for(uint32_t y = 0; y < ROWS; ++y) {
+				const auto* up = src + y * stride;
+				const auto* lo = src + (y + ROWS) * stride;
+				auto dst = out + y * LINE;
+				for(uint32_t x = 0; x < WIDTH; ++x) {
+					auto c1 = up[x];
+					auto c2 = lo[x];
+					put_(dst, x, word_(c1 >> 16, c1 >> 8, c1, c2 >> 16, c2 >> 8, c2));
+				}
+			}
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	変換した面の表示を要求（フレームの境目で切り替わる）
+		 */
+		//-----------------------------------------------------------------//
+		void swap() noexcept { swap_ = true; }
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	表示の切り替え待ちか検査 @n
+					切り替え待ちの間は、encode してはならない
+			@return 切り替え待ちなら「true」
+		 */
+		//-----------------------------------------------------------------//
+		bool is_swap() const noexcept { return swap_; }
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	フレームの境目（hub75_scan から呼ばれる）
+			@return 面を切り替えた場合「true」
+		 */
+		//-----------------------------------------------------------------//
+		bool frame_end() noexcept
+		{
+			if(!swap_) return false;
+			front_ ^= 1;
+			swap_ = false;
+			return true;
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	表示面の１行１プレーンを取得
+			@param[in]	plane	プレーン（0 が LSB）
+			@param[in]	row		行
+			@return ポート・ワード列（LINE ワード）
+		 */
+		//-----------------------------------------------------------------//
+		const uint8_t* get_line(uint32_t plane, uint32_t row) const noexcept
+		{
+			return &buf_[front_][plane * PLANE + row * LINE];
 		}
 	};
 
 
 	//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
 	/*!
-		@brief  HUB75 テンプレートクラス
-		@param[in]	red		赤シリアル・ポート
-		@param[in]	green	緑シリアル・ポート
-		@param[in]	blue	青シリアル・ポート
-		@param[in]	sclk	シリアル・クロック・ポート
-		@param[in]	latch	ラッチ・ポート
-		@param[in]	blank	ブランキング・ポート
-		@param[in]	adr		カラム・デコーダー・ポート		
+		@brief  HUB75 BCM スキャン・シーケンサー @n
+				転送（シフト）と表示（ラッチ後の /OE 期間）をパイプラインで進める。@n
+				使うプレーン数（set_depth）を減らすと、階調と引き換えに @n
+				リフレッシュ・レートが上がる。
+		@param[in]	ENC		hub75_encoder 型
 	*/
 	//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
-	template <PORT red, PORT green, PORT blue, PORT sclk, PORT latch, PORT blank, PORTS adr>
+	template <class ENC>
+	class hub75_scan {
+	public:
+
+		//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+		/*!
+			@brief  ラッチ時の指示
+		*/
+		//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+		struct latch_t {
+			uint32_t		row;		///< 表示する行（ラッチしたデータの行）
+			uint32_t		on_time;	///< 表示時間（タイマー・カウント）
+			const uint8_t*	next;		///< 次に転送するワード列
+			uint32_t		len;		///< 次に転送するワード数
+		};
+
+	private:
+		ENC&		enc_;
+
+		uint32_t	depth_;		// 使うプレーン数（上位から）
+		uint32_t	base_;		// 最下位プレーンの表示時間
+		uint32_t	plane_;		// 転送中のプレーン
+		uint32_t	row_;		// 転送中の行
+		uint32_t	frame_;
+
+		uint32_t low_() const noexcept { return ENC::DEPTH_ - depth_; }
+
+	public:
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	コンストラクタ
+			@param[in]	enc		エンコーダー
+		 */
+		//-----------------------------------------------------------------//
+		hub75_scan(ENC& enc) noexcept : enc_(enc),
+			depth_(ENC::DEPTH_), base_(1), plane_(0), row_(0), frame_(0) { }
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	階調とリフレッシュ・レートの設定 @n
+					フレーム時間 = ROWS x Σ max(base x 2^n, 転送時間)
+			@param[in]	depth	使うプレーン数（1 to DEPTH）
+			@param[in]	base	最下位プレーンの表示時間（タイマー・カウント）
+		 */
+		//-----------------------------------------------------------------//
+		void set_depth(uint32_t depth, uint32_t base) noexcept
+		{
+			if(depth < 1) depth = 1;
+			else if(depth > ENC::DEPTH_) depth = ENC::DEPTH_;
+			if(base < 1) base = 1;
+			depth_ = depth;
+			base_ = base;
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	１フレームの時間を計算
+			@param[in]	shift	１行１プレーンの転送時間（タイマー・カウント）
+			@return フレーム時間（タイマー・カウント）
+		 */
+		//-----------------------------------------------------------------//
+		uint32_t get_frame_time(uint32_t shift) const noexcept
+		{
+			uint32_t t = 0;
+			for(uint32_t n = 0; n < depth_; ++n) {
+				auto on = base_ << n;
+				t += on > shift ? on : shift;
+			}
+			return t * ENC::ROWS;
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	開始（最初に転送するワード列を返す）
+			@return ワード列（ENC::LINE ワード）
+		 */
+		//-----------------------------------------------------------------//
+		const uint8_t* start() noexcept
+		{
+			plane_ = low_();
+			row_ = 0;
+			return enc_.get_line(plane_, row_);
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	ラッチ（転送完了、前の表示時間経過後に呼ぶ）@n
+					転送したデータの行と表示時間、次の転送データを返す
+			@return ラッチ時の指示
+		 */
+		//-----------------------------------------------------------------//
+		latch_t latch() noexcept
+		{
+			latch_t t;
+			t.row = row_;
+			t.on_time = base_ << (plane_ - low_());
+
+			++plane_;
+			if(plane_ >= ENC::DEPTH_) {
+				plane_ = low_();
+				++row_;
+				if(row_ >= ENC::ROWS) {
+					row_ = 0;
+					++frame_;
+					enc_.frame_end();
+				}
+			}
+			t.next = enc_.get_line(plane_, row_);
+			t.len = ENC::LINE;
+			return t;
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	フレーム数を取得
+			@return フレーム数
+		 */
+		//-----------------------------------------------------------------//
+		uint32_t get_frame() const noexcept { return frame_; }
+	};
+
+
+	//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+	/*!
+		@brief  HUB75 行選択ポート・クラス
+		@param[in]	A	デコーダーＡ
+		@param[in]	B	デコーダーＢ
+		@param[in]	C	デコーダーＣ
+		@param[in]	D	デコーダーＤ（使わない場合 device::NULL_PORT）
+		@param[in]	E	デコーダーＥ（使わない場合 device::NULL_PORT）
+	*/
+	//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+	template <class A, class B, class C, class D, class E>
+	struct hub75_adrs {
+
+		static void init() noexcept
+		{
+			A::DIR = 1;
+			B::DIR = 1;
+			C::DIR = 1;
+			D::DIR = 1;
+			E::DIR = 1;
+		}
+
+		static void out(uint32_t v) noexcept
+		{
+			A::P = (v & 1) != 0;
+			B::P = (v & 2) != 0;
+			C::P = (v & 4) != 0;
+			D::P = (v & 8) != 0;
+			E::P = (v & 16) != 0;
+		}
+	};
+
+
+	//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+	/*!
+		@brief  HUB75 テンプレートクラス @n
+				シフト・クロック用のタイマー（CMT 等の DMAC 起動要因）と、@n
+				表示時間用の CMT を別に用意する。@n
+				DMA 完了割り込みから dma_task、表示時間 CMT の割り込みから @n
+				timer_task を呼ぶ事。
+		@param[in]	DATA	データ・ポート（device::PORTx、B0 〜 B6 を使う）
+		@param[in]	LAT		ラッチ・ポート
+		@param[in]	OE		ブランキング・ポート（/OE）
+		@param[in]	ADR		行選択ポート（hub75_adrs）
+		@param[in]	DMA		DMAC マネージャー（device::dmac_mgr）
+		@param[in]	CMT		表示時間用 CMT チャネル（device::CMTx）
+		@param[in]	ENC		エンコーダー（hub75_encoder）
+	*/
+	//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+	template <class DATA, class LAT, class OE, class ADR, class DMA, class CMT, class ENC>
 	class HUB75 {
+
+		typedef typename DMA::value_type DMAC;
+
+		DMA&			dma_;
+		ENC&			enc_;
+		hub75_scan<ENC>	scan_;
+
+		volatile bool	dma_done_;
+		volatile bool	time_done_;
+
+		void sync_() noexcept
+		{
+			if(!dma_done_ || !time_done_) return;
+			dma_done_ = false;
+			time_done_ = false;
+
+			auto t = scan_.latch();
+			LAT::P = 1;
+			ADR::out(t.row);
+			LAT::P = 0;
+			CMT::CMCOR = t.on_time - 1;
+			CMT::CMCNT = 0;
+			OE::P = 0;  // 表示
+
+			DMAC::DMCNT.DTE = 0;
+			DMAC::DMSAR = static_cast<uint32_t>(reinterpret_cast<uintptr_t>(t.next));
+			DMAC::DMCRA = ((t.len & 0x3FF) << 16) | (t.len & 0x3FF);
+			DMAC::DMCRB = 1;
+			DMAC::DMCNT.DTE = 1;
+		}
+
 	public:
 		//-----------------------------------------------------------------//
 		/*!
-			@brief	開始
+			@brief	コンストラクタ
+			@param[in]	dma		DMAC マネージャー
+			@param[in]	enc		エンコーダー
+		 */
+		//-----------------------------------------------------------------//
+		HUB75(DMA& dma, ENC& enc) noexcept : dma_(dma), enc_(enc), scan_(enc),
+			dma_done_(false), time_done_(false) { }
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	開始 @n
+					表示時間用 CMT は、割り込み付きで起動しておく事
+			@param[in]	trg		シフト・クロックの DMAC 起動要因（ICU::VECTOR）
+			@param[in]	lvl		DMA 完了割り込みレベル
+			@return 成功なら「true」
 		 */
 		//-----------------------------------------------------------------//
-		void start()
+		template <typename VECTOR>
+		bool start(VECTOR trg, uint8_t lvl) noexcept
 		{
-			red::DIR = 1;
-			green::DIR = 1;
-			blue::DIR = 1;
-			sclk::DIR = 1;
-			latch::DIR = 1;
-			blank::DIR = 1;
-			adr::init();
+			DATA::PODR = 0;
+			DATA::PDR = 0x7f;
+			LAT::DIR = 1;
+			LAT::P = 0;
+			OE::DIR = 1;
+			OE::P = 1;
+			ADR::init();
+			ADR::out(0);
+
+			dma_done_ = false;
+			time_done_ = true;
+			auto src = scan_.start();
+			return dma_.start(trg, DMA::trans_type::SP_DN_8, static_cast<uint32_t>(reinterpret_cast<uintptr_t>(src)),
+				DATA::PODR.address(), ENC::LINE, lvl, false);
 		}
 
 
 		//-----------------------------------------------------------------//
 		/*!
-			@brief	コピー
-			@param[in]	src		ソース
+			@brief	DMA 完了タスク（割り込みから呼ぶ）
 		 */
 		//-----------------------------------------------------------------//
-		void copy(const void* src)
+		void dma_task() noexcept
 		{
+			dma_done_ = true;
+			sync_();
 		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	表示時間経過タスク（割り込みから呼ぶ）
+		 */
+		//-----------------------------------------------------------------//
+		void timer_task() noexcept
+		{
+			OE::P = 1;  // 消灯
+			time_done_ = true;
+			sync_();
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	スキャン・シーケンサーへの参照
+			@return スキャン・シーケンサー
+		 */
+		//-----------------------------------------------------------------//
+		hub75_scan<ENC>& at_scan() noexcept { return scan_; }
 	};
 }
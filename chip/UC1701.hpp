@@ -134,5 +134,47 @@ namespace chip {
 			chip_enable_(false);
 		}
 
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief  ページの一部をコピー
+			@param[in]	src		転送ソース
+			@param[in]	page	ページ
+			@param[in]	org		開始カラム
+			@param[in]	len		転送カラム数
+		*/
+		//-----------------------------------------------------------------//
+		void copy_page(const uint8_t* src, uint8_t page, uint8_t org, uint8_t len) {
+			chip_enable_();
+			reg_select_(0);
+			set_pointer_(org, page);
+			reg_select_(1);
+			csi_.send(src, len);
+			reg_select_(0);
+			chip_enable_(false);
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief  更新されたページ範囲だけを転送
+			@param[in]	bmp	モノクロ・グラフィックス（graphics::monograph）
+			@return 転送したデータのバイト数
+		*/
+		//-----------------------------------------------------------------//
+		template <class BMP>
+		uint32_t update(BMP& bmp) {
+			uint32_t n = 0;
+			for(uint8_t page = 0; page < bmp.page_num(); ++page) {
+				uint16_t org;
+				uint16_t len;
+				if(!bmp.get_dirty(page, org, len)) continue;
+				copy_page(bmp.fb() + page * bmp.get_width() + org, page, org, len);
+				n += len;
+			}
+			bmp.clear_dirty();
+			return n;
+		}
+
 	};
 }
@@ -2,15 +2,22 @@
 //=====================================================================//
 /*!	@file
 	@brief	CAN 通信解析クラス @n
-			std::map を使う場合、Makefile でのリンクを修正する (USER_DEFS = m stdc++) @n
+			・ID テーブルは固定容量のオープンアドレス方式で、ヒープを使わない。@n
+			・ID 毎に、受信数、レート、最小／最大受信間隔、ペイロード変化を記録する。@n
+			・フレームの時間は、CAN タイムスタンプ・カウンタから求める為、@n
+			  service はカウンタが一周する前（1Mbps で 65ms 以内）に呼ぶ事。@n
+			・フレーム時間は単調増加（戻る場合は直前のフレーム時間に合わせる）@n
+			CAN_IO には以下が必要（ホスト上ではモックで置き換えられる）@n
+			  uint32_t get_recv_num() @n
+			  can_frame get_recv_frame() @n
+			  uint16_t get_timestamp() @n
+			  uint32_t get_speed()
     @author 平松邦仁 (hira@rvf-rc45.net)
-	@copyright	Copyright (C) 2020 Kunihito Hiramatsu @n
+	@copyright	Copyright (C) 2020, 2021 Kunihito Hiramatsu @n
 				Released under the MIT license @n
 				https://github.com/hirakuni45/RX/blob/master/LICENSE
 */
 //=====================================================================//
-#include <boost/unordered_map.hpp>
-// #include <map>
 #include "common/can_io.hpp"
 #include "common/format.hpp"
 
@@ -20,26 +27,158 @@ namespace utils {
 	/*!
 		@brief  CAN 通信解析クラス
 		@param[in]	CAN_IO	can_io クラス型
+		@param[in]	CAPA	ID テーブルの容量（２のべき乗）
 	*/
 	//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
-	template <class CAN_IO>
+	template <class CAN_IO, uint32_t CAPA = 256>
 	class can_analize {
 
-		CAN_IO&		can_io_;
+		static_assert((CAPA & (CAPA - 1)) == 0, "CAPA must be a power of 2");
+
+	public:
 
 		typedef device::can_frame FRAME;
 		typedef device::can_io_def CANDEF;
 
+		static const uint32_t RATE_WINDOW = 1'000'000;	///< レート計測時間 [us]
+
+		//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+		/*!
+			@brief  ID 情報
+		*/
+		//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
 		struct info_t {
-			uint32_t	count_;
-			FRAME		frame_;
-			info_t() : count_(0), frame_() { }
-			info_t(uint32_t count, const FRAME& frame) : count_(count), frame_(frame) { }
+			uint32_t	key_;		///< ID (B31: IDE)、EMPTY なら未使用
+			uint32_t	count_;		///< 受信数
+			uint32_t	last_;		///< 最終受信時間 [us]
+			uint32_t	min_dt_;	///< 最小受信間隔 [us]
+			uint32_t	max_dt_;	///< 最大受信間隔 [us]
+			uint32_t	change_;	///< ペイロード変化数
+			uint16_t	win_;		///< 現在のレート計測窓での受信数
+			uint16_t	rate_;		///< 受信レート [frames/s]
+			uint8_t		cmask_;		///< 変化したデータ・バイトのマスク
+			FRAME		frame_;		///< 最終フレーム
+
+			info_t() noexcept : key_(EMPTY), count_(0), last_(0), min_dt_(0), max_dt_(0),
+				change_(0), win_(0), rate_(0), cmask_(0), frame_() { }
 		};
 
-		typedef boost::unordered_map<uint32_t, info_t> MAP;
-//		typedef std::map<uint32_t, info_t> MAP;
-		MAP			map_;
+	private:
+
+		static const uint32_t EMPTY = 0xffffffff;
+
+		CAN_IO&		can_io_;
+
+		info_t		tbl_[CAPA];
+		uint32_t	num_;
+		uint32_t	overflow_;
+
+		uint16_t	ts_;		///< 前回のタイムスタンプ・カウンタ
+		uint32_t	now_;		///< 現在時間 [us]
+		uint32_t	last_;		///< 最後のフレーム時間 [us]
+		uint32_t	tick_;		///< 1 カウントの時間 [us] (Q16)
+		uint32_t	win_top_;
+
+		static uint32_t key_(const FRAME& frm) noexcept
+		{
+			return frm.get_id() | (static_cast<uint32_t>(frm.get_IDE()) << 31);
+		}
+
+
+		static uint32_t hash_(uint32_t key) noexcept
+		{
+			return (key * 0x9E3779B1) & (CAPA - 1);
+		}
+
+
+		info_t* find_(uint32_t key) noexcept
+		{
+			auto h = hash_(key);
+			for(uint32_t i = 0; i < CAPA; ++i) {
+				auto& t = tbl_[(h + i) & (CAPA - 1)];
+				if(t.key_ == key) return &t;
+				if(t.key_ == EMPTY) break;
+			}
+			return nullptr;
+		}
+
+
+		const info_t* find_(uint32_t key) const noexcept
+		{
+			return const_cast<can_analize*>(this)->find_(key);
+		}
+
+
+		info_t* insert_(uint32_t key) noexcept
+		{
+			auto h = hash_(key);
+			for(uint32_t i = 0; i < CAPA; ++i) {
+				auto& t = tbl_[(h + i) & (CAPA - 1)];
+				if(t.key_ == key) return &t;
+				if(t.key_ == EMPTY) {
+					// 充填率は 3/4 までとする
+					if(num_ >= (CAPA - CAPA / 4)) return nullptr;
+					t = info_t();
+					t.key_ = key;
+					++num_;
+					return &t;
+				}
+			}
+			return nullptr;
+		}
+
+
+		// DLC と DATA0～7 の変化をバイト単位のマスクで返す
+		static uint8_t diff_(const FRAME& a, const FRAME& b) noexcept
+		{
+			uint8_t m = 0;
+			if(a.get_DLC() != b.get_DLC()) m = 0xff;
+			if(((a[1] ^ b[1]) & 0xffff) == 0 && a[2] == b[2] && ((a[3] ^ b[3]) & 0xffff0000) == 0) {
+				return m;
+			}
+			for(uint32_t i = 0; i < 8; ++i) {
+				if(a.get_DATA(i) != b.get_DATA(i)) m |= 1 << i;
+			}
+			return m;
+		}
+
+
+		void update_(const FRAME& frm, uint32_t t) noexcept
+		{
+			auto p = insert_(key_(frm));
+			if(p == nullptr) {
+				++overflow_;
+				return;
+			}
+			if(p->count_ > 0) {
+				auto dt = t - p->last_;
+				if(p->count_ == 1 || dt < p->min_dt_) p->min_dt_ = dt;
+				if(dt > p->max_dt_) p->max_dt_ = dt;
+				auto m = diff_(p->frame_, frm);
+				if(m != 0) {
+					p->cmask_ |= m;
+					++p->change_;
+				}
+			}
+			++p->count_;
+			if(p->win_ < 0xffff) ++p->win_;
+			p->last_ = t;
+			p->frame_ = frm;
+		}
+
+
+		void window_() noexcept
+		{
+			if((now_ - win_top_) < RATE_WINDOW) return;
+
+			for(auto& t : tbl_) {
+				if(t.key_ == EMPTY) continue;
+				t.rate_ = t.win_;
+				t.win_ = 0;
+			}
+			win_top_ = now_;
+		}
+
 
 		void list_line_(const info_t& t) const
 		{
@@ -50,12 +189,13 @@ namespace utils {
 				ch = 'D';
 			}
 			if(t.frame_.get_IDE()) {
-				utils::format("%c %6u E:x%07X (%u)\n")
-					% ch % t.count_ % t.frame_.get_id() % t.frame_.get_id();
+				utils::format("%c %6u E:x%07X (%u)") % ch % t.count_ % t.frame_.get_id() % t.frame_.get_id();
 			} else {
-				utils::format("%c %6u S:x%07X (%u)\n")
-					% ch % t.count_ % t.frame_.get_id() % t.frame_.get_id();
+				utils::format("%c %6u S:x%07X (%u)") % ch % t.count_ % t.frame_.get_id() % t.frame_.get_id();
 			}
+			utils::format(" %u/s, dt: %u-%u us, chg: %u (%08b)\n")
+				% static_cast<uint32_t>(t.rate_) % t.min_dt_ % t.max_dt_
+				% t.change_ % static_cast<uint32_t>(t.cmask_);
 		}
 
 	public:
@@ -65,40 +205,115 @@ namespace utils {
 			@param[in]	can_io	can_io インスタンス
 		*/
 		//-----------------------------------------------------------------//
-		can_analize(CAN_IO& can_io) noexcept : can_io_(can_io), map_() { }
+		can_analize(CAN_IO& can_io) noexcept : can_io_(can_io), tbl_(), num_(0), overflow_(0),
+			ts_(0), now_(0), last_(0), tick_(0), win_top_(0) { }
 
 
 		//-----------------------------------------------------------------//
 		/*!
 			@brief  サービス @n
 					CAN/ID の収集と更新
+			@param[in]	func	フレーム毎に呼ばれる関数 (const FRAME&, uint32_t time_us) @n
+								time_us は単調増加
 		*/
 		//-----------------------------------------------------------------//
-		void service() noexcept
+		template <class FUNC>
+		void service(FUNC func) noexcept
 		{
+			if(tick_ == 0) {
+				auto spd = can_io_.get_speed();
+				if(spd == 0) return;
+				tick_ = (1'000'000ULL << 16) / spd;
+				ts_ = can_io_.get_timestamp();
+			}
+
+			// 受信数を先に読む（後から届いたフレームは、タイムスタンプより新しいので次回）
 			auto n = can_io_.get_recv_num();
+			uint16_t ts = can_io_.get_timestamp();
+			now_ += (static_cast<uint64_t>(static_cast<uint16_t>(ts - ts_)) * tick_) >> 16;
+			ts_ = ts;
+
 			while(n > 0) {
 				auto frm = can_io_.get_recv_frame();
-				auto it = map_.find(frm.get_id());
-				if(it != map_.end()) {  // 更新
-					it->second.count_++;
-					it->second.frame_ = frm;
-				} else {
-					map_.emplace(frm.get_id(), info_t(1, frm));
-				}
+				uint16_t age = ts - frm.get_TS();
+				uint32_t t = now_ - ((static_cast<uint64_t>(age) * tick_) >> 16);
+				// 時間は戻さない（カウンタが一周する程 service が遅れた場合等）
+				if(static_cast<int32_t>(t - last_) < 0) t = last_;
+				last_ = t;
+				update_(frm, t);
+				func(frm, t);
 				--n;
 			}
+			window_();
 		}
 
 
 		//-----------------------------------------------------------------//
 		/*!
-			@brief  マップをクリア
+			@brief  サービス @n
+					CAN/ID の収集と更新
+		*/
+		//-----------------------------------------------------------------//
+		void service() noexcept
+		{
+			service([](const FRAME& frm, uint32_t t) { });
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief  テーブルをクリア
 		*/
 		//-----------------------------------------------------------------//
 		void clear() noexcept
 		{
-			map_.clear();
+			for(auto& t : tbl_) {
+				t.key_ = EMPTY;
+			}
+			num_ = 0;
+			overflow_ = 0;
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief  現在時間を取得
+			@return 現在時間 [us]
+		*/
+		//-----------------------------------------------------------------//
+		uint32_t get_time() const noexcept { return now_; }
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief  登録 ID 数を取得
+			@return 登録 ID 数
+		*/
+		//-----------------------------------------------------------------//
+		uint32_t size() const noexcept { return num_; }
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief  テーブルが一杯で登録出来なかったフレーム数を取得
+			@return フレーム数
+		*/
+		//-----------------------------------------------------------------//
+		uint32_t get_overflow() const noexcept { return overflow_; }
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief  ID 情報を取得（標準 ID を優先して検索）
+			@param[in]	id	CAN/ID
+			@return ID 情報（見つからない場合「nullptr」）
+		*/
+		//-----------------------------------------------------------------//
+		const info_t* get(uint32_t id) const noexcept
+		{
+			auto p = find_(id);
+			if(p == nullptr) p = find_(id | 0x80000000);
+			return p;
 		}
 
 
@@ -111,7 +326,7 @@ namespace utils {
 		//-----------------------------------------------------------------//
 		bool find(uint32_t id) const noexcept
 		{
-			return map_.find(id) != map_.end();
+			return get(id) != nullptr;
 		}
 
 
@@ -125,11 +340,11 @@ namespace utils {
 		//-----------------------------------------------------------------//
 		bool list(uint32_t id, bool verb = false) noexcept
 		{
-			auto it = map_.find(id);
-			if(it == map_.end()) {
+			auto p = get(id);
+			if(p == nullptr) {
 				return false;
 			}
-			list_line_(it->second);
+			list_line_(*p);
 			return true;
 		}
 
@@ -147,11 +362,13 @@ namespace utils {
 			uint32_t r = 0;
 			uint32_t df = 0;
 			uint32_t rf = 0;
-			for(auto&& it : map_) {
-				const auto& t = it.second;
+			uint32_t rate = 0;
+			for(const auto& t : tbl_) {
+				if(t.key_ == EMPTY) continue;
 				list_line_(t);
 				a += t.count_;
 				r += t.frame_.get_DLC();
+				rate += t.rate_;
 				if(t.frame_.get_RTR()) {
 					++rf;
 				} else {
@@ -159,8 +376,11 @@ namespace utils {
 				}
 				++n;
 			}
-			utils::format("ID = %u / Total = %u, Records = %u, Df = %u, Rf = %u\n")
-				% n % a % r % df % rf;
+			utils::format("ID = %u / Total = %u, Records = %u, Df = %u, Rf = %u, %u/s\n")
+				% n % a % r % df % rf % rate;
+			if(overflow_ > 0) {
+				utils::format("Table overflow: %u\n") % overflow_;
+			}
 		}
 
 
@@ -173,12 +393,12 @@ namespace utils {
 		//-----------------------------------------------------------------//
 		bool dump(uint32_t id) noexcept
 		{
-			auto it = map_.find(id);
-			if(it == map_.end()) {
+			auto p = get(id);
+			if(p == nullptr) {
 				return false;
 			}
-			list_line_(it->second);
-			CANDEF::list(it->second.frame_);
+			list_line_(*p);
+			CANDEF::list(p->frame_);
 			return true;
 		}
 	};
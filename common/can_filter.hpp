@@ -0,0 +1,342 @@
+#pragma once
+//=====================================================================//
+/*!	@file
+	@brief	RX グループ・CAN 受信フィルター（アクセプタンス・フィルター）構成 @n
+			・(id, mask) のルールのリストから、メールボックスの ID、マスク・レジスタ @n
+			  （MKR）、マスク無効レジスタ（MKIVLR）、FIFO 受信 ID 比較レジスタ @n
+			  （FIDCR0/1）の値を求める（レジスタには触らない）@n
+			・MKR は４つのメールボックスで共有されるので、同じマスクのルールを @n
+			  同じグループに置き、完全一致のルールは MKIVLR で空きに置く @n
+			・入りきらない場合は、広げる量が最も少ないルールの対をまとめる @n
+			  （ハードウェアは広めに受け、ソフトウェアでルールを確認する）@n
+			・ID は can_frame::set_id と同じ統合 ID（SID + (EID << 11)）@n
+			・標準 ID フレームは SID だけが比較されるものとする
+    @author 平松邦仁 (hira@rvf-rc45.net)
+	@copyright	Copyright (C) 2021 Kunihito Hiramatsu @n
+				Released under the MIT license @n
+				https://github.com/hirakuni45/RX/blob/master/LICENSE
+*/
+//=====================================================================//
+#include <cstdint>
+
+namespace device {
+
+	//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+	/*!
+		@brief  CAN 受信フィルター構成クラス
+	*/
+	//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+	class can_filter {
+	public:
+		static const uint32_t RULE_MAX = 32;			///< ルールの最大数
+		static const uint32_t MB_NUM   = 32;			///< メールボックス数
+		static const uint32_t SID_MASK = 0x7ff;			///< 標準 ID の全ビット
+		static const uint32_t EXT_MASK = 0x1fffffff;	///< 拡張 ID の全ビット
+		static const uint32_t FIFO_TOP = 28;			///< 受信 FIFO のメールボックス
+		static const uint32_t RX_GROUPS = 0b11111011;	///< 受信に使うグループ（MB8..11 は送信）
+		static const uint32_t FIFO_GROUPS = 0b00111011;	///< FIFO モード時（MB24..31 は FIFO）
+
+		//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+		/*!
+			@brief  ルール @n
+					(受信 ID & mask) == (id & mask) で、IDE、RTR が一致したら受ける
+		*/
+		//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+		struct rule_t {
+			uint32_t	id;		///< 統合 ID
+			uint32_t	mask;	///< 比較するビットが「１」
+			bool		ide;	///< 拡張 ID フレーム
+			bool		rtr;	///< リモート・フレーム
+			bool		fifo;	///< 受信 FIFO（４段）で受ける（最大２つの比較）
+			rule_t(uint32_t id_ = 0, uint32_t mask_ = 0, bool ide_ = false, bool rtr_ = false,
+				bool fifo_ = false) noexcept :
+				id(id_), mask(mask_), ide(ide_), rtr(rtr_), fifo(fifo_) { }
+		};
+
+
+		//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+		/*!
+			@brief  レジスタ設定値 @n
+					ID、マスクはレジスタ形式（IDE:B31, RTR:B30, SID:B28-B18, EID:B17-B0）
+		*/
+		//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+		struct plan_t {
+			uint32_t	mkr[8];				///< MKR[k]（MB4k..4k+3、FIFO 時 MKR6/7 は FIDCR0/1）
+			uint32_t	mkivlr;				///< MKIVLR
+			uint32_t	mb_id[MB_NUM];		///< 受信メールボックスの ID
+			uint32_t	rx_mbs;				///< 受信メールボックス（ビット位置）
+			uint32_t	mb_rules[MB_NUM];	///< メールボックスに届き得るルール（ビット位置）
+			uint32_t	check;				///< ソフトウェアで確認が必要なメールボックス
+			uint32_t	fidcr[2];			///< FIDCR0/1
+			uint32_t	fifo_rules;			///< FIFO に届き得るルール
+			bool		fifo;				///< FIFO モード（CTLR.MBM = 1）
+			bool		fifo_check;			///< FIFO でソフトウェアの確認が必要
+			uint32_t	merge;				///< まとめたルールの対の数
+			plan_t() noexcept : mkr{ 0 }, mkivlr(0), mb_id{ 0 }, rx_mbs(0), mb_rules{ 0 },
+				check(0), fidcr{ 0 }, fifo_rules(0), fifo(false), fifo_check(false), merge(0) { }
+		};
+
+	private:
+		struct slot_t {
+			uint32_t	id;
+			uint32_t	mask;
+			uint32_t	rules;
+			bool		ide;
+			bool		rtr;
+			bool		fifo;
+		};
+
+		static uint32_t full_(bool ide) noexcept { return ide ? EXT_MASK : SID_MASK; }
+
+		static uint32_t bits_(uint32_t v) noexcept { return __builtin_popcount(v); }
+
+		static bool exact_(const slot_t& s) noexcept { return s.mask == full_(s.ide); }
+
+		static bool same_(const slot_t& a, const slot_t& b) noexcept
+		{
+			return a.ide == b.ide && a.rtr == b.rtr && a.fifo == b.fifo
+				&& a.id == b.id && a.mask == b.mask;
+		}
+
+		// 二つのパターンに共通の ID があるか
+		static bool cross_(const slot_t& s, const rule_t& r) noexcept
+		{
+			return s.ide == r.ide && s.rtr == r.rtr && ((s.id ^ r.id) & s.mask & r.mask) == 0;
+		}
+
+		static uint32_t merge_mask_(const slot_t& a, const slot_t& b) noexcept
+		{
+			return a.mask & b.mask & ~(a.id ^ b.id);
+		}
+
+		// 同じマスクのメールボックスのグループ数（完全一致は空きに入るので数えない）
+		static bool fit_(const slot_t* s, uint32_t n, uint32_t groups) noexcept
+		{
+			uint32_t need = 0;
+			uint32_t num = 0;
+			for(uint32_t i = 0; i < n; ++i) {
+				if(s[i].fifo) continue;
+				++num;
+				if(exact_(s[i])) continue;
+				bool first = true;
+				uint32_t cnt = 0;
+				for(uint32_t j = 0; j < n; ++j) {
+					if(s[j].fifo || exact_(s[j]) || to_mask(s[j].mask) != to_mask(s[i].mask)) continue;
+					if(j < i) { first = false; break; }
+					++cnt;
+				}
+				if(first) need += (cnt + 3) / 4;
+			}
+			return need <= groups && num <= groups * 4;
+		}
+
+		// 広げる量が最も少ない対をまとめる
+		static bool merge_(slot_t* s, uint32_t& n, bool fifo) noexcept
+		{
+			int32_t best = -1;
+			uint32_t bi = 0;
+			uint32_t bj = 0;
+			for(uint32_t i = 0; i < n; ++i) {
+				if(s[i].fifo != fifo) continue;
+				for(uint32_t j = i + 1; j < n; ++j) {
+					if(s[j].fifo != fifo || s[j].ide != s[i].ide || s[j].rtr != s[i].rtr) continue;
+					int32_t score = bits_(merge_mask_(s[i], s[j])) * 2;
+					// 既にあるマスクに揃うなら、グループが減る
+					if(to_mask(merge_mask_(s[i], s[j])) == to_mask(s[i].mask)
+						|| to_mask(merge_mask_(s[i], s[j])) == to_mask(s[j].mask)) ++score;
+					if(score > best) {
+						best = score;
+						bi = i;
+						bj = j;
+					}
+				}
+			}
+			if(best < 0) return false;
+			s[bi].mask = merge_mask_(s[bi], s[bj]);
+			s[bi].id &= s[bi].mask;
+			s[bi].rules |= s[bj].rules;
+			s[bj] = s[n - 1];
+			--n;
+			return true;
+		}
+
+	public:
+		//-----------------------------------------------------------------//
+		/*!
+			@brief  統合 ID をレジスタ形式に変換
+			@param[in]	id	統合 ID
+			@param[in]	ide	拡張 ID
+			@param[in]	rtr	リモート・フレーム
+			@return レジスタ形式
+		*/
+		//-----------------------------------------------------------------//
+		static uint32_t to_reg(uint32_t id, bool ide = false, bool rtr = false) noexcept
+		{
+			return (static_cast<uint32_t>(ide) << 31) | (static_cast<uint32_t>(rtr) << 30)
+				| ((id & 0x7ff) << 18) | ((id >> 11) & 0x3ffff);
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief  統合 ID のマスクを MKR 形式に変換
+			@param[in]	mask	マスク
+			@return MKR 形式
+		*/
+		//-----------------------------------------------------------------//
+		static uint32_t to_mask(uint32_t mask) noexcept { return to_reg(mask) & EXT_MASK; }
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief  ルールに一致するか
+			@param[in]	r	ルール
+			@param[in]	id	統合 ID
+			@param[in]	ide	拡張 ID
+			@param[in]	rtr	リモート・フレーム
+			@return 一致なら「true」
+		*/
+		//-----------------------------------------------------------------//
+		static bool match(const rule_t& r, uint32_t id, bool ide, bool rtr) noexcept
+		{
+			return r.ide == ide && r.rtr == rtr && ((r.id ^ id) & r.mask & full_(ide)) == 0;
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief  ルールのリストからレジスタ設定値を作る
+			@param[in]	rules	ルールのリスト
+			@param[in]	num		ルール数（１～RULE_MAX）
+			@param[out]	plan	レジスタ設定値
+			@return ルールが不正なら「false」
+		*/
+		//-----------------------------------------------------------------//
+		static bool build(const rule_t* rules, uint32_t num, plan_t& plan) noexcept
+		{
+			plan = plan_t();
+			if(rules == nullptr || num == 0 || num > RULE_MAX) return false;
+
+			slot_t s[RULE_MAX];
+			uint32_t n = 0;
+			uint32_t fifo_num = 0;
+			for(uint32_t i = 0; i < num; ++i) {
+				const auto& r = rules[i];
+				slot_t t;
+				t.mask = r.mask & full_(r.ide);
+				t.id = r.id & t.mask;
+				t.rules = 1u << i;
+				t.ide = r.ide;
+				t.rtr = r.rtr;
+				t.fifo = r.fifo;
+				bool dup = false;
+				for(uint32_t j = 0; j < n; ++j) {
+					if(same_(s[j], t)) {
+						s[j].rules |= t.rules;
+						dup = true;
+						break;
+					}
+				}
+				if(dup) continue;
+				if(t.fifo) ++fifo_num;
+				s[n] = t;
+				++n;
+			}
+
+			// FIFO の比較は二つ、IDE、RTR が揃わない分はメールボックスへ
+			while(fifo_num > 2) {
+				if(merge_(s, n, true)) {
+					++plan.merge;
+				} else {
+					for(uint32_t i = 0; i < n; ++i) {
+						if(s[i].fifo) {
+							s[i].fifo = false;
+							break;
+						}
+					}
+				}
+				--fifo_num;
+			}
+			plan.fifo = fifo_num > 0;
+			uint32_t gmask = plan.fifo ? FIFO_GROUPS : RX_GROUPS;
+			uint32_t groups = bits_(gmask);
+
+			while(!fit_(s, n, groups)) {
+				if(!merge_(s, n, false)) return false;
+				++plan.merge;
+			}
+
+			// FIFO
+			uint32_t k = 0;
+			for(uint32_t i = 0; i < n; ++i) {
+				if(!s[i].fifo) continue;
+				plan.fidcr[k] = to_reg(s[i].id, s[i].ide, s[i].rtr);
+				plan.mkr[6 + k] = to_mask(s[i].mask);
+				++k;
+			}
+			if(k == 1) {  // 二つ目も同じ比較にする
+				plan.fidcr[1] = plan.fidcr[0];
+				plan.mkr[7] = plan.mkr[6];
+			}
+
+			// マスクのあるスロットを、同じマスクのグループに詰める
+			uint8_t used[MB_NUM] = { 0 };
+			uint32_t g = 0;
+			for(uint32_t i = 0; i < n; ++i) {
+				if(s[i].fifo || exact_(s[i]) || used[i] != 0) continue;
+				auto m = to_mask(s[i].mask);
+				uint32_t pos = 4;
+				for(uint32_t j = i; j < n; ++j) {
+					if(s[j].fifo || exact_(s[j]) || used[j] != 0 || to_mask(s[j].mask) != m) continue;
+					if(pos >= 4) {
+						while(((gmask >> g) & 1) == 0) ++g;
+						plan.mkr[g] = m;
+						pos = 0;
+						++g;
+					}
+					auto mb = (g - 1) * 4 + pos;
+					plan.mb_id[mb] = to_reg(s[j].id, s[j].ide, s[j].rtr);
+					plan.rx_mbs |= 1u << mb;
+					used[j] = mb + 1;
+					++pos;
+				}
+			}
+			// 完全一致のスロットは、空いたメールボックスへ（マスク無効）
+			for(uint32_t i = 0; i < n; ++i) {
+				if(s[i].fifo || used[i] != 0) continue;
+				uint32_t mb = 0;
+				while(mb < MB_NUM && (((gmask >> (mb / 4)) & 1) == 0 || ((plan.rx_mbs >> mb) & 1) != 0)) {
+					++mb;
+				}
+				if(mb >= MB_NUM) return false;
+				plan.mb_id[mb] = to_reg(s[i].id, s[i].ide, s[i].rtr);
+				plan.mkivlr |= 1u << mb;
+				plan.rx_mbs |= 1u << mb;
+				used[i] = mb + 1;
+			}
+
+			// 届き得るルール（重なるルールも含める）と、ソフトウェアの確認
+			// 届くルールが全てスロットと同じマスクなら、確認は要らない
+			for(uint32_t i = 0; i < n; ++i) {
+				uint32_t m = 0;
+				for(uint32_t j = 0; j < num; ++j) {
+					if(cross_(s[i], rules[j])) m |= 1u << j;
+				}
+				bool chk = false;
+				for(uint32_t j = 0; j < num && !chk; ++j) {
+					if(((m >> j) & 1) == 0) continue;
+					if((rules[j].mask & full_(rules[j].ide)) != s[i].mask) chk = true;
+				}
+				if(s[i].fifo) {
+					plan.fifo_rules |= m;
+					if(chk || k > 1) plan.fifo_check = true;
+				} else {
+					auto mb = used[i] - 1;
+					plan.mb_rules[mb] = m;
+					if(chk) plan.check |= 1u << mb;
+				}
+			}
+			return true;
+		}
+	};
+}
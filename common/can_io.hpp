@@ -4,7 +4,12 @@
 	@brief	RX グループ・CAN I/O 制御 @n
 			・CAN クロックは、正確に一致しない場合、エラーとする。@n
 			・CAN ポートに、CAN バス・トランシーバーを接続する。@n
-			・CAN ペリフェラル内蔵 FIFO 機能は使わない設計とする。
+			・受信 FIFO は、set_filter で FIFO 指定のルールがある場合だけ使う。@n
+			・set_filter で、(id, mask) のルールからハードウェアの受信フィルター @n
+			  （メールボックスのマスク、FIDCR）を構成し、ルール毎のコールバックを @n
+			  受信割り込みの中から呼ぶ。@n
+			・メールボックスは、NEWDATA を落としてからローカルにコピーし、コピー中に @n
+			  上書きされて無い事（NEWDATA、INVALDATA が「０」）を確かめてから渡す。
     @author 平松邦仁 (hira@rvf-rc45.net)
 	@copyright	Copyright (C) 2019, 2020 Kunihito Hiramatsu @n
 				Released under the MIT license @n
@@ -14,6 +19,7 @@
 #include "common/renesas.hpp"
 #include "common/vect.h"
 #include "common/format.hpp"
+#include "common/can_filter.hpp"
 
 namespace device {
 
@@ -69,6 +75,53 @@ namespace device {
 		};
 
 
+		//-----------------------------------------------------------------//
+		/*!
+			@brief  受信コールバック型 @n
+					受信割り込みの中から呼ばれる、frm は割り込みの中だけ有効 @n
+					（メールボックスはコピー、受信 FIFO は FIFO そのもの、@n
+					  保持するならコピーする事）
+			@param[in]	frm		フレーム
+		*/
+		//-----------------------------------------------------------------//
+		typedef void (*recv_task_type)(const can_frame& frm);
+
+
+		//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+		/*!
+			@brief  受信フィルター設定 @n
+					(受信 ID & mask) == (id & mask) で、IDE、RTR が一致したフレームを受ける
+		*/
+		//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+		struct filter_t {
+			uint32_t		id;		///< SID+EID の ID
+			uint32_t		mask;	///< 比較するビットが「１」
+			recv_task_type	task;	///< コールバック（nullptr なら受信バッファへ）
+			bool			ide;	///< 拡張 ID フレーム
+			bool			rtr;	///< リモート・フレーム
+			bool			fifo;	///< 受信 FIFO（４段）で受ける（バースト向け、最大２つ）
+			filter_t(uint32_t id_ = 0, uint32_t mask_ = can_filter::SID_MASK,
+				recv_task_type task_ = nullptr, bool ide_ = false, bool rtr_ = false,
+				bool fifo_ = false) noexcept :
+				id(id_), mask(mask_), task(task_), ide(ide_), rtr(rtr_), fifo(fifo_) { }
+		};
+
+
+		//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+		/*!
+			@brief  受信統計
+		*/
+		//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+		struct stat_t {
+			uint32_t	recv;		///< ソフトウェアに届いたフレーム
+			uint32_t	dispatch;	///< コールバックを呼んだ回数
+			uint32_t	buffer;		///< 受信バッファに積んだフレーム
+			uint32_t	reject;		///< どのルールにも一致しなかったフレーム
+			uint32_t	lost;		///< メールボックス（読み出し中の上書きを含む）、FIFO で失ったフレーム
+			stat_t() noexcept : recv(0), dispatch(0), buffer(0), reject(0), lost(0) { }
+		};
+
+
 		//-----------------------------------------------------------------//
 		/*!
 			@brief  CAN フレームの表示
@@ -127,26 +180,105 @@ namespace device {
 		typedef utils::format		format;
 #endif
 
+		struct filt_t {
+			can_filter::plan_t	plan;
+			can_filter::rule_t	rule[can_filter::RULE_MAX];
+			recv_task_type		task[can_filter::RULE_MAX];
+			uint32_t			num;
+		};
+
 		interrupt_t		intr_;
 		MODE			mode_;
+		bool			rxf_;
 
 		static RBF		rbf_;
 		static TBF		tbf_;
 
+		static filt_t	filt_;
+		static stat_t	stat_;
+
 		void sleep_() const { asm("nop"); }
 
 
-		static INTERRUPT_FUNC void rxm_task_()
+		// フィルター無し：RX_MB_TOP から、データ／リモート、標準／拡張 ID を全て受ける
+		static void legacy_plan_(can_filter::plan_t& plan) noexcept
 		{
+			plan = can_filter::plan_t();
 			for(uint32_t i = RX_MB_TOP; i < (RX_MB_TOP + RX_MB_NUM); ++i) {
-				if(CAN::MCTL[i].NEWDATA() != 0) {
-					auto& t = rbf_.put_at();
-					CAN::MB[i].get(t);
-					rbf_.put_go();
+				plan.mb_id[i] = can_filter::to_reg(0, (i >> 1) & 1, i & 1);
+				plan.rx_mbs |= 1u << i;
+			}
+		}
+
+
+		static void dispatch_(const can_frame& frm, uint32_t rules, bool check) noexcept
+		{
+			++stat_.recv;
+			bool buf = rules == 0;
+			bool hit = buf;
+			uint32_t id = 0;
+			if(check) id = frm.get_id();
+			while(rules != 0) {
+				auto i = __builtin_ctz(rules);
+				rules &= rules - 1;
+				if(check && !can_filter::match(filt_.rule[i], id, frm.get_IDE(), frm.get_RTR())) {
+					continue;
+				}
+				hit = true;
+				auto task = filt_.task[i];
+				if(task != nullptr) {
+					(*task)(frm);
+					++stat_.dispatch;
+				} else {
+					buf = true;
+				}
+			}
+			if(buf) {
+				rbf_.put_at() = frm;
+				rbf_.put_go();
+				++stat_.buffer;
+			}
+			if(!hit) ++stat_.reject;
+		}
+
+
+		// 受信メールボックス割り込み
+		static INTERRUPT_FUNC void rxm_task_()
+		{
+			auto mbs = filt_.plan.rx_mbs;
+			while(mbs != 0) {
+				auto i = __builtin_ctz(mbs);
+				mbs &= mbs - 1;
+				while(CAN::MCTL[i].NEWDATA() != 0) {
+					can_frame frm;
+					while(1) {
+						if(CAN::MCTL[i].TMSGLOST() != 0) ++stat_.lost;
+						CAN::MCTL[i] = CAN::MCTL.RECREQ.b(1);  // NEWDATA、MSGLOST を落とす（受信は続ける）
+						CAN::MB[i].get(frm);
+						// コピー中に次のフレームが来た（格納中を含む）なら、読み直す
+						// （NEWDATA、INVALDATA は１回の読み出しで見る）
+						auto st = CAN::MCTL[i]();
+						if((st & (CAN::MCTL.NEWDATA.b(1) | CAN::MCTL.INVALDATA.b(1))) == 0) break;
+						++stat_.lost;
+						while(CAN::MCTL[i].INVALDATA() != 0) ;  // 格納が終わるまで待つ
+					}
+					dispatch_(frm, filt_.plan.mb_rules[i], (filt_.plan.check >> i) & 1);
 				}
-				CAN::MCTL[i] = 0;  // RECREQ を落とす
-				CAN::MCTL[i] = 0;  // NEWDATA を落とす
-				CAN::MCTL[i] = CAN::MCTL.RECREQ.b(1);  // 再度受信リクエスト
+			}
+		}
+
+
+		// 受信 FIFO 割り込み
+		static INTERRUPT_FUNC void rxf_task_()
+		{
+			while(CAN::RFCR.RFEST() == 0) {
+				dispatch_(CAN::MB[can_filter::FIFO_TOP].at_frame(), filt_.plan.fifo_rules,
+					filt_.plan.fifo_check);
+				CAN::RFPCR = 0xFF;
+			}
+			if(CAN::RFCR.RFMLF() != 0) {
+				++stat_.lost;
+				CAN::RFCR.RFMLF = 0;
 			}
 		}
 
@@ -175,13 +307,91 @@ namespace device {
 		static void ers_task_() {
 		}
 
+
+		// 送信が完全に停止中なら送信トリガを出す
+		void start_send_() noexcept
+		{
+			if(tbf_.length() == 0) return;
+			for(uint32_t i = TX_MB_TOP; i < (TX_MB_TOP + TX_MB_NUM); ++i) {
+				if(CAN::MCTL[i]() != 0) return;
+			}
+			const auto& t = tbf_.get_at();
+			CAN::MB[TX_MB_TOP].set(t);
+			tbf_.get_go();
+			CAN::MCTL[TX_MB_TOP] = CAN::MCTL.TRMREQ.b(1);
+		}
+
+
+		// マスク、メールボックスの設定（CAN リセット・モードで呼ぶ）
+		void setup_filter_() noexcept
+		{
+			const auto& p = filt_.plan;
+			for(uint32_t i = 0; i < 8; ++i) {
+				CAN::MKR[i] = p.mkr[i];
+			}
+			CAN::MKIVLR = p.mkivlr;  // 「１」のメールボックスはマスク無効（完全一致）
+
+			CAN::CTLR.MBM = p.fifo;
+			if(p.fifo) {  // FIFO メールボックス・モード（MB24..27 送信 FIFO、MB28..31 受信 FIFO）
+				CAN::FIDCR0 = p.fidcr[0];
+				CAN::FIDCR1 = p.fidcr[1];
+			}
+
+			// メールボックスを初期化
+			uint32_t n = p.fifo ? 24 : 32;
+			for(uint32_t i = 0; i < n; ++i) {
+				CAN::MCTL[i] = 0;  // 一応、MCTL も「０」クリア
+				CAN::MCTL[i] = 0;  // 完全にクリアするには、２度書く事が必要
+				CAN::MB[i].clear();
+				if((p.rx_mbs >> i) & 1) {
+					can_frame t;
+					t[0] = p.mb_id[i];
+					CAN::MB[i].set(t);
+				}
+			}
+		}
+
+
+		void setup_mier_() noexcept
+		{
+			uint32_t mier = 0;
+			if(intr_.rxm_level > 0) {
+				mier |= filt_.plan.rx_mbs;
+				if(filt_.plan.fifo) mier |= 1u << 28;  // 受信 FIFO 割り込み（毎回）
+			}
+			if(intr_.txm_level > 0) {
+				mier |= ((1u << TX_MB_NUM) - 1) << TX_MB_TOP;
+			}
+			CAN::MIER = mier;
+		}
+
+
+		void setup_rxf_() noexcept
+		{
+			if(filt_.plan.fifo && intr_.rxm_level > 0 && !rxf_) {
+				icu_mgr::set_interrupt(CAN::RXF_VEC, rxf_task_, intr_.rxm_level);
+				rxf_ = true;
+			}
+		}
+
+
+		// 受信開始（オペレーション・モードで呼ぶ）
+		void start_recv_() noexcept
+		{
+			auto mbs = filt_.plan.rx_mbs;
+			for(uint32_t i = 0; i < 32; ++i) {
+				if((mbs >> i) & 1) CAN::MCTL[i].RECREQ = 1;
+			}
+			if(filt_.plan.fifo) CAN::RFCR.RFE = 1;
+		}
+
 	public:
 		//-----------------------------------------------------------------//
 		/*!
 			@brief  コンストラクター
 		*/
 		//-----------------------------------------------------------------//
-		can_io() noexcept : intr_(), mode_(MODE::RESET) { }
+		can_io() noexcept : intr_(), mode_(MODE::RESET), rxf_(false) { }
 
 
 		//-----------------------------------------------------------------//
@@ -269,29 +479,9 @@ namespace device {
 			CAN::BCR = CAN::BCR.TSEG1.b(tseg1 - 1) | CAN::BCR.TSEG2.b(tseg2 - 1)
 				| CAN::BCR.BRP.b(brp - 1) | CAN::BCR.SJW.b(sjw - 1) | CAN::BCR.CCLKS.b(0);
 
-			for(uint32_t i = 0; i < 8; ++i) {
-				CAN::MKR[i] = 0;
-			}
-			CAN::MKIVLR = 0;  // マスク有効
-
-			// FIFO モードの場合： リモートフレーム、標準ID、拡張ID 受信可能設定
-			CAN::CTLR.MBM = 1;
-			CAN::FIDCR0 = CAN::FIDCR0.RTR.b(0) | CAN::FIDCR0.IDE.b(0);
-			CAN::FIDCR1 = CAN::FIDCR1.RTR.b(1) | CAN::FIDCR1.IDE.b(1);
-			CAN::CTLR.MBM = 0;
-
-			// メールボックスを初期化
-			for(uint32_t i = 0; i < 32; ++i) {
-				CAN::MCTL[i] = 0;  // 一応、MCTL も「０」クリア
-				CAN::MCTL[i] = 0;  // 完全にクリアするには、２度書く事が必要
-				CAN::MB[i].clear();
-				if(i >= RX_MB_TOP && i < (RX_MB_TOP + RX_MB_NUM)) {
-					// データフレーム、リモートフレーム受信用
-					// 標準ID、拡張ID 受信用
-					CAN::MB[i].RTR = i & 1;
-					CAN::MB[i].IDE = (i >> 1) & 1;
-				}
-			}
+			// 受信フィルター（set_filter が無ければ、全て受ける）
+			if(filt_.num == 0) legacy_plan_(filt_.plan);
+			setup_filter_();
 
 			intr_ = intr;
 			CAN::MIER = 0;
@@ -306,23 +496,19 @@ namespace device {
 			}
 			if(intr.rxm_level > 0) {  // 受信割り込み設定
 				icu_mgr::set_interrupt(CAN::RXM_VEC, rxm_task_, intr.rxm_level);
-				for(uint32_t i = RX_MB_TOP; i < (RX_MB_TOP + RX_MB_NUM); ++i) {
-					CAN::MIER.set(i);
-				}
+				setup_rxf_();
 			}
 			if(intr.txm_level > 0) {  // 送信割り込み設定
 				icu_mgr::set_interrupt(CAN::TXM_VEC, txm_task_, intr.txm_level);
-				for(uint32_t i = TX_MB_TOP; i < (TX_MB_TOP + TX_MB_NUM); ++i) {
-					CAN::MIER.set(i);
-				}
 			}
+			setup_mier_();
 
 			// CAN オペレーションモードに移行
 			uint8_t idfm = 0b10;  // 標準 ID モード、拡張 ID モード、ミックス
 			uint8_t bom  = 0b00;  // ISO 11898-1 規格、バスオフ復帰モード
 			bool tpm = 1;  // メールボックス番号優先送信モード
 			CAN::CTLR = CAN::CTLR.CANM.b(0b00) | CAN::CTLR.SLPM.b(0) | CAN::CTLR.IDFM.b(idfm)
-				| CAN::CTLR.BOM.b(bom) | CAN::CTLR.TPM.b(tpm);
+				| CAN::CTLR.BOM.b(bom) | CAN::CTLR.TPM.b(tpm) | CAN::CTLR.MBM.b(filt_.plan.fifo);
 
 			// CAN オペレーションモードに移行するまで待機
 			while(CAN::STR.RSTST() != 0 || CAN::STR.HLTST() != 0) {
@@ -331,13 +517,119 @@ namespace device {
 			mode_ = MODE::OPERATION;
 
 			// 受信メールボックス設定
-			for(uint32_t i = RX_MB_TOP; i < (RX_MB_TOP + RX_MB_NUM); ++i) {
-				CAN::MCTL[i].RECREQ = 1;
+			start_recv_();
+			return true;
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief  受信フィルターを設定 @n
+					・ルールから、メールボックスの ID、マスク、FIDCR を自動で割り当てる @n
+					・入りきらない場合は、似たルールをまとめてハードウェアは広めに受け、@n
+					  ソフトウェアでルールを確認する（get_filter_plan().merge） @n
+					・一致したルールのコールバックを受信割り込みから呼ぶ、@n
+					  コールバックが無いルールは、受信バッファに積む @n
+					・start 前に呼ぶのが望ましい、start 後の場合、リセット・モードを @n
+					  経由するので、送信中のフレームは失われる場合がある @n
+					・Halt、スリープ・モードでは、設定しない（失敗する）
+			@param[in]	list	ルールのリスト
+			@param[in]	num		ルール数（０なら全て受ける、最大 32）
+			@return 設定出来ない場合「false」
+		*/
+		//-----------------------------------------------------------------//
+		bool set_filter(const filter_t* list, uint32_t num) noexcept
+		{
+			if(num > can_filter::RULE_MAX || (num > 0 && list == nullptr)) return false;
+			// Halt、スリープ・モードから、リセット・モードへは移行できない
+			if(mode_ == MODE::HALT || mode_ == MODE::SLEEP) return false;
+
+			can_filter::rule_t rule[can_filter::RULE_MAX];
+			for(uint32_t i = 0; i < num; ++i) {
+				rule[i] = can_filter::rule_t(list[i].id, list[i].mask, list[i].ide, list[i].rtr,
+					list[i].fifo);
+			}
+			can_filter::plan_t plan;
+			if(num > 0) {
+				if(!can_filter::build(rule, num, plan)) return false;
+			} else {
+				legacy_plan_(plan);
+			}
+
+			bool run = mode_ == MODE::OPERATION;
+			if(run) {
+				CAN::MIER = 0;  // 割り込みハンドラーが参照するので止めてから更新
+				set_mode(MODE::RESET);
+			}
+			filt_.plan = plan;
+			for(uint32_t i = 0; i < num; ++i) {
+				filt_.rule[i] = rule[i];
+				filt_.task[i] = list[i].task;
+			}
+			filt_.num = num;
+			if(run) {
+				setup_filter_();
+				setup_rxf_();
+				setup_mier_();
+				set_mode(MODE::OPERATION);
+				start_recv_();
+				start_send_();
 			}
 			return true;
 		}
 
 
+		//-----------------------------------------------------------------//
+		/*!
+			@brief  受信フィルターのレジスタ設定値を参照
+			@return レジスタ設定値
+		*/
+		//-----------------------------------------------------------------//
+		static const can_filter::plan_t& get_filter_plan() noexcept { return filt_.plan; }
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief  受信フィルターの割り当てを表示
+		*/
+		//-----------------------------------------------------------------//
+		static void list_filter() noexcept
+		{
+			const auto& p = filt_.plan;
+			utils::format("Filter: %u rules, merge: %u, FIFO: %s\n")
+				% filt_.num % p.merge % (p.fifo ? "on" : "off");
+			for(uint32_t i = 0; i < can_filter::MB_NUM; ++i) {
+				if(((p.rx_mbs >> i) & 1) == 0) continue;
+				utils::format("  MB%02u: ID: %08X, MKR[%u]: %08X%s, rules: %08X%s\n")
+					% i % p.mb_id[i] % (i / 4) % p.mkr[i / 4]
+					% (((p.mkivlr >> i) & 1) ? " (invalid)" : "")
+					% p.mb_rules[i] % (((p.check >> i) & 1) ? " (check)" : "");
+			}
+			if(p.fifo) {
+				utils::format("  FIFO: FIDCR0: %08X/%08X, FIDCR1: %08X/%08X, rules: %08X%s\n")
+					% p.fidcr[0] % p.mkr[6] % p.fidcr[1] % p.mkr[7] % p.fifo_rules
+					% (p.fifo_check ? " (check)" : "");
+			}
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief  受信統計を取得
+			@return 受信統計
+		*/
+		//-----------------------------------------------------------------//
+		static const stat_t& get_stat() noexcept { return stat_; }
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief  受信統計をクリア
+		*/
+		//-----------------------------------------------------------------//
+		static void clear_stat() noexcept { stat_ = stat_t(); }
+
+
 		//-----------------------------------------------------------------//
 		/*!
 			@brief  動作モードを返す
@@ -473,6 +765,16 @@ namespace device {
 		}
 
 
+		//-----------------------------------------------------------------//
+		/*!
+			@brief  タイムスタンプ・カウンタを返す @n
+					CTLR.TSPS = 0 なので、１ビット時間毎にカウントアップする。
+			@return タイムスタンプ・カウンタ
+		*/
+		//-----------------------------------------------------------------//
+		uint16_t get_timestamp() const noexcept { return CAN::TSR(); }
+
+
 		//-----------------------------------------------------------------//
 		/*!
 			@brief  受信エラーカウントを返す
@@ -658,16 +960,7 @@ namespace device {
 			}
 			tbf_.put_go();
 
-			uint32_t n = 0;
-			for(uint32_t i = TX_MB_TOP; i < (TX_MB_TOP + TX_MB_NUM); ++i) {
-				if(CAN::MCTL[i]() == 0) ++n;
-			}
-			if(n == TX_MB_NUM) {  // 送信が完全に停止中なら送信トリガを出す
-				const auto& t = tbf_.get_at();
-				CAN::MB[TX_MB_TOP].set(t);
-				tbf_.get_go();
-				CAN::MCTL[TX_MB_TOP] = CAN::MCTL.TRMREQ.b(1);
-			}
+			start_send_();
 
 			return true;
 		} 
@@ -703,6 +996,10 @@ namespace device {
 			CAN::MIER = 0;
 			icu_mgr::set_interrupt(CAN::RXM_VEC, nullptr, 0);
 			icu_mgr::set_interrupt(CAN::TXM_VEC, nullptr, 0);
+			if(rxf_) {
+				icu_mgr::set_interrupt(CAN::RXF_VEC, nullptr, 0);
+				rxf_ = false;
+			}
 
 			CAN::CTLR = CAN::CTLR.CANM.b(0b11);  // CAN リセットモード（強制） 
 
@@ -719,4 +1016,8 @@ namespace device {
 		RBF can_io<CAN, RBF, TBF, PSEL>::rbf_;
 	template <class CAN, class RBF, class TBF, port_map::ORDER PSEL>
 		TBF can_io<CAN, RBF, TBF, PSEL>::tbf_;
+	template <class CAN, class RBF, class TBF, port_map::ORDER PSEL>
+		typename can_io<CAN, RBF, TBF, PSEL>::filt_t can_io<CAN, RBF, TBF, PSEL>::filt_;
+	template <class CAN, class RBF, class TBF, port_map::ORDER PSEL>
+		can_io_def::stat_t can_io<CAN, RBF, TBF, PSEL>::stat_;
 }
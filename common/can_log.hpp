@@ -0,0 +1,303 @@
+#pragma once
+//=====================================================================//
+/*!	@file
+	@brief	CAN フレーム・ロガー @n
+			・受信フレームを、タイムスタンプ付きでファイルに記録する。@n
+			・フレームはセクター単位のバンクに詰め、満杯のバンクだけを書き込む。@n
+			・バンクは複数持ち、SD の書き込み待ちの間も取りこぼさない。@n
+			・全てのバンクが満杯の時（service が間に合わない）のフレームは記録出来ない、@n
+			  put は「false」を返し、get_lost() で数え、flush はエラー（false）を返す。@n
+			  バス負荷と SD の書き込み時間に合わせて、SECNUM、BANK を決める事。@n
+			・flush は半端なセクターを書いた後、その位置に戻り、次の書き込みで上書きする、@n
+			  ファイルへの書き込みは、常にセクター境界から始まる。@n
+			・フレーム時間が戻った場合は、前のフレームと同じ時刻で記録する。@n
+			・記録形式は、バイナリ、又は candump (-l) 互換テキスト @n
+			  (1436509052.249713) can0 123#DEADBEEF @n
+			FIO には以下が必要（utils::file_io、又はホスト上のモック）@n
+			  uint32_t write(const void* src, uint32_t len) @n
+			  bool flush() @n
+			  uint32_t tell() @n
+			  bool seek(FIO::SEEK::SET, uint32_t pos)
+    @author 平松邦仁 (hira@rvf-rc45.net)
+	@copyright	Copyright (C) 2021 Kunihito Hiramatsu @n
+				Released under the MIT license @n
+				https://github.com/hirakuni45/RX/blob/master/LICENSE
+*/
+//=====================================================================//
+#include <cstring>
+#include "common/format.hpp"
+
+namespace utils {
+
+	//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+	/*!
+		@brief  CAN フレーム・ロガー・クラス
+		@param[in]	FIO		ファイル入出力クラス型
+		@param[in]	FRAME	フレーム型 (device::can_frame)
+		@param[in]	SECNUM	１バンクのセクター数
+		@param[in]	BANK	バンク数（最低２）
+	*/
+	//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+	template <class FIO, class FRAME, uint32_t SECNUM = 4, uint32_t BANK = 4>
+	class can_log {
+
+		static_assert(BANK >= 2, "BANK must be 2 or more");
+
+	public:
+
+		static const uint32_t SECTOR_SIZE = 512;
+		static const uint32_t BANK_SIZE = SECTOR_SIZE * SECNUM;
+
+		//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+		/*!
+			@brief  記録形式
+		*/
+		//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+		enum class FORMAT : uint8_t {
+			BINARY,		///< バイナリ（record_t）
+			CANDUMP,	///< candump 互換テキスト
+		};
+
+
+		//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+		/*!
+			@brief  バイナリ・レコード（リトルエンディアン、24 バイト）
+		*/
+		//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+		struct record_t {
+			uint32_t	sec_;		///< 秒
+			uint32_t	usec_;		///< マイクロ秒
+			uint32_t	id_;		///< ID (B31: IDE, B30: RTR)
+			uint8_t		dlc_;		///< DLC
+			uint8_t		pad_[3];
+			uint8_t		data_[8];	///< データ
+		};
+
+	private:
+
+		FIO&		fio_;
+		FORMAT		format_;
+		const char*	name_;
+
+		uint8_t		bank_[BANK][BANK_SIZE];
+		uint32_t	put_;		///< 書き込み中のバンク
+		uint32_t	get_;		///< ファイルへ出力するバンク
+		uint32_t	pos_;		///< 書き込み中バンクの位置
+		uint32_t	sync_;		///< 出力するバンクの、ファイルに書き込み済みの位置（セクター境界）
+		volatile uint32_t	full_;	///< 満杯のバンク数
+
+		uint32_t	last_;
+		uint32_t	sec_;
+		uint32_t	usec_;
+
+		uint32_t	count_;
+		uint32_t	lost_;
+		uint32_t	error_;
+
+		uint32_t free_() const noexcept
+		{
+			return (BANK - full_) * BANK_SIZE - pos_;
+		}
+
+
+		void copy_(const void* src, uint32_t len) noexcept
+		{
+			auto p = static_cast<const uint8_t*>(src);
+			while(len > 0) {
+				auto n = BANK_SIZE - pos_;
+				if(n > len) n = len;
+				std::memcpy(&bank_[put_][pos_], p, n);
+				p += n;
+				pos_ += n;
+				len -= n;
+				if(pos_ >= BANK_SIZE) {
+					put_ = (put_ + 1) % BANK;
+					pos_ = 0;
+					++full_;
+				}
+			}
+		}
+
+
+		void time_(uint32_t t) noexcept
+		{
+			if(static_cast<int32_t>(t - last_) < 0) return;
+
+			usec_ += t - last_;
+			last_ = t;
+			while(usec_ >= 1'000'000) {
+				usec_ -= 1'000'000;
+				++sec_;
+			}
+		}
+
+	public:
+		//-----------------------------------------------------------------//
+		/*!
+			@brief  コンストラクタ
+			@param[in]	fio		ファイル入出力（オープン済み）
+			@param[in]	fmt		記録形式
+			@param[in]	name	candump のインターフェース名
+		*/
+		//-----------------------------------------------------------------//
+		can_log(FIO& fio, FORMAT fmt = FORMAT::CANDUMP, const char* name = "can0") noexcept :
+			fio_(fio), format_(fmt), name_(name),
+			bank_(), put_(0), get_(0), pos_(0), sync_(0), full_(0),
+			last_(0), sec_(0), usec_(0),
+			count_(0), lost_(0), error_(0) { }
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief  開始時刻の設定
+			@param[in]	sec		開始時刻（time_t 等）[s]
+			@param[in]	t		開始時刻に対応するフレーム時間 [us]
+		*/
+		//-----------------------------------------------------------------//
+		void set_time(uint32_t sec, uint32_t t) noexcept
+		{
+			sec_ = sec;
+			usec_ = 0;
+			last_ = t;
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief  フレームを記録
+			@param[in]	frm		フレーム
+			@param[in]	t		フレーム時間 [us]
+			@return 空きが無く記録出来ない場合「false」（get_lost() で数える）
+		*/
+		//-----------------------------------------------------------------//
+		bool put(const FRAME& frm, uint32_t t) noexcept
+		{
+			time_(t);
+
+			if(format_ == FORMAT::BINARY) {
+				if(free_() < sizeof(record_t)) {
+					++lost_;
+					return false;
+				}
+				record_t r;
+				r.sec_  = sec_;
+				r.usec_ = usec_;
+				r.id_   = frm.get_id() | (static_cast<uint32_t>(frm.get_IDE()) << 31)
+					| (static_cast<uint32_t>(frm.get_RTR()) << 30);
+				r.dlc_  = frm.get_DLC();
+				r.pad_[0] = r.pad_[1] = r.pad_[2] = 0;
+				for(uint32_t i = 0; i < 8; ++i) {
+					r.data_[i] = i < r.dlc_ ? frm.get_DATA(i) : 0;
+				}
+				copy_(&r, sizeof(r));
+			} else {
+				char tmp[64];
+				if(frm.get_IDE()) {
+					utils::sformat("(%u.%06u) %s %08X#", tmp, sizeof(tmp))
+						% sec_ % usec_ % name_ % frm.get_id();
+				} else {
+					utils::sformat("(%u.%06u) %s %03X#", tmp, sizeof(tmp))
+						% sec_ % usec_ % name_ % frm.get_id();
+				}
+				if(frm.get_RTR()) {
+					utils::sformat("R", tmp, sizeof(tmp), true);
+				} else {
+					auto dlc = frm.get_DLC();
+					if(dlc > 8) dlc = 8;
+					for(uint32_t i = 0; i < dlc; ++i) {
+						utils::sformat("%02X", tmp, sizeof(tmp), true)
+							% static_cast<uint32_t>(frm.get_DATA(i));
+					}
+				}
+				utils::sformat("\n", tmp, sizeof(tmp), true);
+				uint32_t len = std::strlen(tmp);
+				if(free_() < len) {
+					++lost_;
+					return false;
+				}
+				copy_(tmp, len);
+			}
+			++count_;
+			return true;
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief  サービス @n
+					満杯のバンクを１つファイルに書き込む（メインループから呼ぶ）
+			@return 書き込んだ場合「true」
+		*/
+		//-----------------------------------------------------------------//
+		bool service() noexcept
+		{
+			if(full_ == 0) return false;
+
+			auto n = BANK_SIZE - sync_;
+			if(fio_.write(&bank_[get_][sync_], n) != n) {
+				++error_;
+			}
+			sync_ = 0;
+			get_ = (get_ + 1) % BANK;
+			--full_;
+			return true;
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief  フラッシュ @n
+					全ての満杯バンクと、書き込み中のバンクをファイルに出力する @n
+					半端なセクターはバンクに残し、次の書き込みで同じ位置に上書きする
+			@return 書き込みエラー、記録出来なかったフレームが無ければ「true」
+		*/
+		//-----------------------------------------------------------------//
+		bool flush() noexcept
+		{
+			while(service()) ;
+			if(pos_ > sync_) {
+				auto n = pos_ - sync_;
+				if(fio_.write(&bank_[put_][sync_], n) != n) {
+					++error_;
+				} else {
+					auto rem = pos_ % SECTOR_SIZE;
+					sync_ = pos_ - rem;
+					if(rem > 0 && !fio_.seek(FIO::SEEK::SET, fio_.tell() - rem)) {
+						++error_;
+					}
+				}
+			}
+			if(!fio_.flush()) {
+				++error_;
+			}
+			return error_ == 0 && lost_ == 0;
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief  記録したフレーム数を取得
+			@return フレーム数
+		*/
+		//-----------------------------------------------------------------//
+		uint32_t get_count() const noexcept { return count_; }
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief  バンクが一杯で記録出来なかったフレーム数を取得
+			@return フレーム数
+		*/
+		//-----------------------------------------------------------------//
+		uint32_t get_lost() const noexcept { return lost_; }
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief  書き込みエラー数を取得
+			@return エラー数
+		*/
+		//-----------------------------------------------------------------//
+		uint32_t get_error() const noexcept { return error_; }
+	};
+}
@@ -0,0 +1,635 @@
+#pragma once
+//=====================================================================//
+/*!	@file
+	@brief	文字コード変換（UTF-8, UTF-16, CP932 (Shift-JIS)） @n
+			・ASCII の連続は、ワード単位（ホストでは SSE2 の１６バイト単位）で処理 @n
+			・CP932 は、二段の直接参照テーブル（common/cp932_tbl.hpp）で変換 @n
+			・ソースの長さを指定するストリーム（チャンク）変換、途中のシーケンスは @n
+			  state_t に保持して、次のチャンクで続きを変換する @n
+			・不正、変換出来ない文字は、U+FFFD（Shift-JIS への変換では '?'）に置き換え、 @n
+			  その数を result_t::error で返す
+    @author 平松邦仁 (hira@rvf-rc45.net)
+	@copyright	Copyright (C) 2021 Kunihito Hiramatsu @n
+				Released under the MIT license @n
+				https://github.com/hirakuni45/RX/blob/master/LICENSE
+*/
+//=====================================================================//
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "common/cp932_tbl.hpp"
+
+namespace utils {
+
+	//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+	/*!
+		@brief  文字コード変換クラス
+	*/
+	//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+	struct code_conv {
+
+		static constexpr uint16_t REPLACE      = 0xFFFD;	///< 置き換え文字（Unicode）
+		static constexpr char     REPLACE_SJIS = '?';		///< 置き換え文字（Shift-JIS）
+
+
+		//=================================================================//
+		/*!
+			@brief  ストリーム変換の状態（チャンク間で保持する）
+		*/
+		//=================================================================//
+		struct state_t {
+			uint32_t	code;	///< UTF-8 デコード途中のコード
+			uint8_t		need;	///< UTF-8 残りバイト数
+			uint8_t		size;	///< UTF-8 シーケンスのバイト数
+			uint16_t	hold;	///< 保留中の上位サロゲート、又は、Shift-JIS 先行バイト
+
+			state_t() noexcept : code(0), need(0), size(0), hold(0) { }
+
+			void clear() noexcept { code = 0; need = 0; size = 0; hold = 0; }
+
+			bool empty() const noexcept { return need == 0 && hold == 0; }
+		};
+
+
+		//=================================================================//
+		/*!
+			@brief  変換結果
+		*/
+		//=================================================================//
+		struct result_t {
+			uint32_t	src;	///< 消費したソース数（単位はソースの型）
+			uint32_t	dst;	///< 書き込んだ数（単位は変換先の型）
+			uint32_t	error;	///< 置き換えた文字数
+		};
+
+	private:
+
+		// 先頭から連続する ASCII の数
+		static uint32_t scan_ascii_(const char* src, uint32_t n) noexcept
+		{
+			uint32_t i = 0;
+#ifdef __SSE2__
+			while((i + 16) <= n) {
+				auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+				auto m = _mm_movemask_epi8(v);
+				if(m != 0) return i + __builtin_ctz(m);
+				i += 16;
+			}
+#endif
+			while((i + 4) <= n) {
+				uint32_t w;
+				std::memcpy(&w, src + i, 4);
+				if((w & 0x80808080) != 0) break;
+				i += 4;
+			}
+			while(i < n && static_cast<uint8_t>(src[i]) < 0x80) ++i;
+			return i;
+		}
+
+
+		// 先頭から連続する ASCII をコピー（最大 n）
+		static uint32_t copy_ascii_(const char* src, char* dst, uint32_t n) noexcept
+		{
+			uint32_t i = 0;
+#ifdef __SSE2__
+			while((i + 16) <= n) {
+				auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+				if(_mm_movemask_epi8(v) != 0) break;
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), v);
+				i += 16;
+			}
+#endif
+			while((i + 4) <= n) {
+				uint32_t w;
+				std::memcpy(&w, src + i, 4);
+				if((w & 0x80808080) != 0) break;
+				std::memcpy(dst + i, &w, 4);
+				i += 4;
+			}
+			while(i < n && static_cast<uint8_t>(src[i]) < 0x80) {
+				dst[i] = src[i];
+				++i;
+			}
+			return i;
+		}
+
+
+		// 先頭から連続する ASCII を UTF-16 に拡張（最大 n）
+		static uint32_t widen_ascii_(const char* src, uint16_t* dst, uint32_t n) noexcept
+		{
+			uint32_t i = 0;
+#ifdef __SSE2__
+			const auto zero = _mm_setzero_si128();
+			while((i + 16) <= n) {
+				auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+				if(_mm_movemask_epi8(v) != 0) break;
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_unpacklo_epi8(v, zero));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 8), _mm_unpackhi_epi8(v, zero));
+				i += 16;
+			}
+#endif
+			while((i + 4) <= n) {
+				uint32_t w;
+				std::memcpy(&w, src + i, 4);
+				if((w & 0x80808080) != 0) break;
+				dst[i + 0] = static_cast<uint8_t>(src[i + 0]);
+				dst[i + 1] = static_cast<uint8_t>(src[i + 1]);
+				dst[i + 2] = static_cast<uint8_t>(src[i + 2]);
+				dst[i + 3] = static_cast<uint8_t>(src[i + 3]);
+				i += 4;
+			}
+			while(i < n && static_cast<uint8_t>(src[i]) < 0x80) {
+				dst[i] = static_cast<uint8_t>(src[i]);
+				++i;
+			}
+			return i;
+		}
+
+
+		// 先頭から連続する ASCII（UTF-16）を UTF-8 に縮小（最大 n）
+		static uint32_t narrow_ascii_(const uint16_t* src, char* dst, uint32_t n) noexcept
+		{
+			uint32_t i = 0;
+#ifdef __SSE2__
+			const auto mask = _mm_set1_epi16(static_cast<short>(0xff80));
+			const auto zero = _mm_setzero_si128();
+			while((i + 16) <= n) {
+				auto a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+				auto b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 8));
+				auto t = _mm_cmpeq_epi16(_mm_and_si128(_mm_or_si128(a, b), mask), zero);
+				if(_mm_movemask_epi8(t) != 0xffff) break;
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packus_epi16(a, b));
+				i += 16;
+			}
+#endif
+			while((i + 2) <= n) {
+				uint32_t w;
+				std::memcpy(&w, src + i, 4);
+				if((w & 0xff80ff80) != 0) break;
+				dst[i + 0] = static_cast<char>(src[i + 0]);
+				dst[i + 1] = static_cast<char>(src[i + 1]);
+				i += 2;
+			}
+			while(i < n && src[i] < 0x80) {
+				dst[i] = static_cast<char>(src[i]);
+				++i;
+			}
+			return i;
+		}
+
+
+		static uint32_t put_utf8_(uint32_t code, char* dst) noexcept
+		{
+			if(code < 0x80) {
+				dst[0] = code;
+				return 1;
+			} else if(code < 0x800) {
+				dst[0] = 0xc0 | (code >> 6);
+				dst[1] = 0x80 | (code & 0x3f);
+				return 2;
+			} else if(code < 0x10000) {
+				dst[0] = 0xe0 | (code >> 12);
+				dst[1] = 0x80 | ((code >> 6) & 0x3f);
+				dst[2] = 0x80 | (code & 0x3f);
+				return 3;
+			} else {
+				dst[0] = 0xf0 | (code >> 18);
+				dst[1] = 0x80 | ((code >> 12) & 0x3f);
+				dst[2] = 0x80 | ((code >> 6) & 0x3f);
+				dst[3] = 0x80 | (code & 0x3f);
+				return 4;
+			}
+		}
+
+
+		struct utf16_sink_ {
+			uint16_t*	dst;
+			uint32_t	len;
+			uint32_t	pos;
+			uint32_t	error;
+
+			uint32_t ascii(const char* src, uint32_t n) noexcept {
+				if(n > (len - pos)) n = len - pos;
+				n = widen_ascii_(src, dst + pos, n);
+				pos += n;
+				return n;
+			}
+
+			bool put(uint32_t code) noexcept {
+				if(code < 0x10000) {
+					if(pos >= len) return false;
+					dst[pos++] = code;
+				} else {
+					if((pos + 2) > len) return false;
+					code -= 0x10000;
+					dst[pos++] = 0xd800 | (code >> 10);
+					dst[pos++] = 0xdc00 | (code & 0x3ff);
+				}
+				return true;
+			}
+
+			bool bad() noexcept {
+				if(!put(REPLACE)) return false;
+				++error;
+				return true;
+			}
+		};
+
+
+		struct sjis_sink_ {
+			char*		dst;
+			uint32_t	len;
+			uint32_t	pos;
+			uint32_t	error;
+
+			uint32_t ascii(const char* src, uint32_t n) noexcept {
+				if(n > (len - pos)) n = len - pos;
+				n = copy_ascii_(src, dst + pos, n);
+				pos += n;
+				return n;
+			}
+
+			bool put(uint32_t code) noexcept {
+				uint16_t sj = 0;
+				if(code < 0x10000) sj = utf16_to_sjis(code);
+				if(sj == 0) return bad();
+				if(sj < 0x100) {
+					if(pos >= len) return false;
+					dst[pos++] = sj;
+				} else {
+					if((pos + 2) > len) return false;
+					dst[pos++] = sj >> 8;
+					dst[pos++] = sj & 0xff;
+				}
+				return true;
+			}
+
+			bool bad() noexcept {
+				if(pos >= len) return false;
+				dst[pos++] = REPLACE_SJIS;
+				++error;
+				return true;
+			}
+		};
+
+
+		struct null_sink_ {
+			uint32_t	pos;
+			uint32_t	error;
+
+			uint32_t ascii(const char* src, uint32_t n) noexcept { return scan_ascii_(src, n); }
+
+			bool put(uint32_t) noexcept { return true; }
+
+			bool bad() noexcept { return false; }
+		};
+
+
+		// UTF-8 デコーダー（変換先は SINK で切り替え）
+		template <class SINK>
+		static uint32_t decode_utf8_(const char* src, uint32_t slen, SINK& sink, state_t& st, bool last) noexcept
+		{
+			static const uint32_t min_code[5] = { 0, 0, 0x80, 0x800, 0x10000 };
+			uint32_t i = 0;
+			while(i < slen) {
+				uint8_t c = src[i];
+				if(st.need == 0) {
+					if(c < 0x80) {
+						auto n = sink.ascii(src + i, slen - i);
+						if(n == 0) break;
+						i += n;
+						continue;
+					}
+					// 完結した３バイト・シーケンスの連続（日本語など）
+					if((c & 0xf0) == 0xe0) {
+						bool full = false;
+						while((i + 3) <= slen) {
+							uint8_t c0 = src[i];
+							uint8_t c1 = src[i + 1];
+							uint8_t c2 = src[i + 2];
+							if((c0 & 0xf0) != 0xe0 || (c1 & 0xc0) != 0x80 || (c2 & 0xc0) != 0x80) break;
+							uint32_t code = ((c0 & 0x0f) << 12) | ((c1 & 0x3f) << 6) | (c2 & 0x3f);
+							if(code < 0x800 || (code - 0xd800) < 0x800) break;
+							if(!sink.put(code)) {
+								full = true;
+								break;
+							}
+							i += 3;
+						}
+						if(full) break;
+						if(i >= slen) break;
+						c = src[i];
+						if(c < 0x80) continue;
+					}
+					if(0xc2 <= c && c <= 0xdf) {
+						st.code = c & 0x1f;
+						st.need = 1;
+						st.size = 2;
+					} else if((c & 0xf0) == 0xe0) {
+						st.code = c & 0x0f;
+						st.need = 2;
+						st.size = 3;
+					} else if(0xf0 <= c && c <= 0xf4) {
+						st.code = c & 0x07;
+						st.need = 3;
+						st.size = 4;
+					} else {  // 単独の後続バイト、0xc0, 0xc1, 0xf5 以降
+						if(!sink.bad()) break;
+					}
+					++i;
+				} else {
+					if((c & 0xc0) != 0x80) {  // シーケンスが途切れた、c は次の文字として処理
+						if(!sink.bad()) break;
+						st.need = 0;
+						continue;
+					}
+					uint32_t code = (st.code << 6) | (c & 0x3f);
+					if(st.need > 1) {
+						st.code = code;
+						--st.need;
+						++i;
+						continue;
+					}
+					if(code >= min_code[st.size] && code <= 0x10ffff && (code < 0xd800 || code > 0xdfff)) {
+						if(!sink.put(code)) break;
+					} else {  // 冗長表現、サロゲート、範囲外
+						if(!sink.bad()) break;
+					}
+					st.need = 0;
+					++i;
+				}
+			}
+			if(last && i == slen && st.need != 0) {
+				if(sink.bad()) st.need = 0;
+			}
+			return i;
+		}
+
+	public:
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief  Shift-JIS から UTF-16 への変換（１文字）
+			@param[in]	sjis	Shift-JIS コード（２バイト・コードは先行バイトが上位）
+			@return UTF-16 コード（変換出来ない場合「０」）
+		*/
+		//-----------------------------------------------------------------//
+		static uint16_t sjis_to_utf16(uint16_t sjis) noexcept
+		{
+			if(sjis < 0x100) {
+				if(cp932_tbl::lead_[sjis] != 0) return 0;
+				return cp932_tbl::sjis_[0][sjis];
+			}
+			auto row = cp932_tbl::lead_[sjis >> 8];
+			if(row == 0) return 0;
+			return cp932_tbl::sjis_[row][sjis & 0xff];
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief  UTF-16 から Shift-JIS への変換（１文字）
+			@param[in]	code	UTF-16 コード
+			@return Shift-JIS コード（変換出来ない場合「０」）
+		*/
+		//-----------------------------------------------------------------//
+		static uint16_t utf16_to_sjis(uint16_t code) noexcept
+		{
+			return cp932_tbl::uni_[cp932_tbl::page_[code >> 8]][code & 0xff];
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief  UTF-8 の検証
+			@param[in]	src	ソース
+			@param[in]	len	ソースのバイト数
+			@param[out]	pos	不正なシーケンスの位置（nullptr の場合格納しない）
+			@return 正しい UTF-8 なら「true」
+		*/
+		//-----------------------------------------------------------------//
+		static bool validate_utf8(const char* src, uint32_t len, uint32_t* pos = nullptr) noexcept
+		{
+			state_t st;
+			null_sink_ sink = { 0, 0 };
+			auto i = decode_utf8_(src, len, sink, st, true);
+			if(i == len && st.need == 0) return true;
+			if(pos != nullptr) {
+				*pos = i - (st.need != 0 ? (st.size - st.need) : 0);
+			}
+			return false;
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief  UTF-8 から UTF-16 への変換 @n
+					※４バイト・シーケンスは、サロゲート・ペアに変換
+			@param[in]	src		ソース
+			@param[in]	slen	ソースのバイト数
+			@param[out]	dst		変換先
+			@param[in]	dlen	変換先の容量（文字数）
+			@param[in]	st		変換の状態
+			@param[in]	last	最後のチャンクの場合「true」（途中のシーケンスを置き換える）
+			@return 変換結果
+		*/
+		//-----------------------------------------------------------------//
+		static result_t utf8_to_utf16(const char* src, uint32_t slen, uint16_t* dst, uint32_t dlen,
+			state_t& st, bool last = true) noexcept
+		{
+			utf16_sink_ sink = { dst, dlen, 0, 0 };
+			auto i = decode_utf8_(src, slen, sink, st, last);
+			return result_t { i, sink.pos, sink.error };
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief  UTF-8 から Shift-JIS への変換
+			@param[in]	src		ソース
+			@param[in]	slen	ソースのバイト数
+			@param[out]	dst		変換先
+			@param[in]	dlen	変換先の容量（バイト数）
+			@param[in]	st		変換の状態
+			@param[in]	last	最後のチャンクの場合「true」（途中のシーケンスを置き換える）
+			@return 変換結果
+		*/
+		//-----------------------------------------------------------------//
+		static result_t utf8_to_sjis(const char* src, uint32_t slen, char* dst, uint32_t dlen,
+			state_t& st, bool last = true) noexcept
+		{
+			sjis_sink_ sink = { dst, dlen, 0, 0 };
+			auto i = decode_utf8_(src, slen, sink, st, last);
+			return result_t { i, sink.pos, sink.error };
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief  UTF-16 から UTF-8 への変換
+			@param[in]	src		ソース
+			@param[in]	slen	ソースの文字数
+			@param[out]	dst		変換先
+			@param[in]	dlen	変換先の容量（バイト数）
+			@param[in]	st		変換の状態
+			@param[in]	last	最後のチャンクの場合「true」（保留中の上位サロゲートを置き換える）
+			@return 変換結果
+		*/
+		//-----------------------------------------------------------------//
+		static result_t utf16_to_utf8(const uint16_t* src, uint32_t slen, char* dst, uint32_t dlen,
+			state_t& st, bool last = true) noexcept
+		{
+			result_t r = { 0, 0, 0 };
+			uint32_t i = 0;
+			uint32_t o = 0;
+			while(i < slen) {
+				uint32_t c = src[i];
+				if(st.hold != 0) {
+					if(0xdc00 <= c && c <= 0xdfff) {
+						if((o + 4) > dlen) break;
+						c = 0x10000 + ((st.hold - 0xd800) << 10) + (c - 0xdc00);
+						o += put_utf8_(c, dst + o);
+						++i;
+					} else {  // 単独の上位サロゲート、c は次の文字として処理
+						if((o + 3) > dlen) break;
+						o += put_utf8_(REPLACE, dst + o);
+						++r.error;
+					}
+					st.hold = 0;
+					continue;
+				}
+				if(c < 0x80) {
+					auto n = narrow_ascii_(src + i, dst + o, std::min(slen - i, dlen - o));
+					if(n == 0) break;
+					i += n;
+					o += n;
+					continue;
+				}
+				if(0xd800 <= c && c <= 0xdfff) {
+					if(c <= 0xdbff) {
+						st.hold = c;
+					} else {  // 単独の下位サロゲート
+						if((o + 3) > dlen) break;
+						o += put_utf8_(REPLACE, dst + o);
+						++r.error;
+					}
+					++i;
+					continue;
+				}
+				if(c < 0x800) {
+					if((o + 2) > dlen) break;
+					dst[o + 0] = 0xc0 | (c >> 6);
+					dst[o + 1] = 0x80 | (c & 0x3f);
+					o += 2;
+					++i;
+					continue;
+				}
+				// ３バイトの連続（日本語など）
+				if((o + 3) > dlen) break;
+				{
+					auto sp = src + i;
+					auto dp = dst + o;
+					const auto se = src + slen;
+					const auto de = dst + dlen - 3;
+					do {
+						dp[0] = 0xe0 | (c >> 12);
+						dp[1] = 0x80 | ((c >> 6) & 0x3f);
+						dp[2] = 0x80 | (c & 0x3f);
+						dp += 3;
+						++sp;
+					} while(sp < se && dp <= de && (c = *sp) >= 0x800 && (c - 0xd800) >= 0x800) ;
+					i = sp - src;
+					o = dp - dst;
+				}
+			}
+			if(last && i == slen && st.hold != 0 && (o + 3) <= dlen) {
+				o += put_utf8_(REPLACE, dst + o);
+				++r.error;
+				st.hold = 0;
+			}
+			r.src = i;
+			r.dst = o;
+			return r;
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief  Shift-JIS から UTF-8 への変換
+			@param[in]	src		ソース
+			@param[in]	slen	ソースのバイト数
+			@param[out]	dst		変換先
+			@param[in]	dlen	変換先の容量（バイト数）
+			@param[in]	st		変換の状態
+			@param[in]	last	最後のチャンクの場合「true」（保留中の先行バイトを置き換える）
+			@return 変換結果
+		*/
+		//-----------------------------------------------------------------//
+		static result_t sjis_to_utf8(const char* src, uint32_t slen, char* dst, uint32_t dlen,
+			state_t& st, bool last = true) noexcept
+		{
+			result_t r = { 0, 0, 0 };
+			uint32_t i = 0;
+			uint32_t o = 0;
+			while(i < slen) {
+				uint8_t c = src[i];
+				if(st.hold != 0) {
+					uint32_t u = cp932_tbl::sjis_[cp932_tbl::lead_[st.hold]][c];
+					if((o + 3) > dlen) break;
+					if(u != 0) {
+						o += put_utf8_(u, dst + o);
+						++i;
+					} else {
+						o += put_utf8_(REPLACE, dst + o);
+						++r.error;
+						// 後続バイトの範囲なら、２バイトで１文字とする
+						if((0x40 <= c && c <= 0x7e) || (0x80 <= c && c <= 0xfc)) ++i;
+					}
+					st.hold = 0;
+					continue;
+				}
+				if(c < 0x80) {
+					auto n = copy_ascii_(src + i, dst + o, std::min(slen - i, dlen - o));
+					if(n == 0) break;
+					i += n;
+					o += n;
+					continue;
+				}
+				auto row = cp932_tbl::lead_[c];
+				if(row != 0) {
+					if((i + 1) < slen) {  // ２バイト・コード
+						uint32_t u = cp932_tbl::sjis_[row][static_cast<uint8_t>(src[i + 1])];
+						if(u != 0) {
+							if((o + 3) > dlen) break;
+							o += put_utf8_(u, dst + o);
+							i += 2;
+							continue;
+						}
+					}
+					st.hold = c;
+					++i;
+					continue;
+				}
+				uint32_t u = cp932_tbl::sjis_[0][c];
+				if(u == 0) {
+					u = REPLACE;
+				}
+				if((o + 3) > dlen) break;
+				o += put_utf8_(u, dst + o);
+				if(u == REPLACE) ++r.error;
+				++i;
+			}
+			if(last && i == slen && st.hold != 0 && (o + 3) <= dlen) {
+				o += put_utf8_(REPLACE, dst + o);
+				++r.error;
+				st.hold = 0;
+			}
+			r.src = i;
+			r.dst = o;
+			return r;
+		}
+	};
+}
@@ -0,0 +1,572 @@
+#pragma once
+//=====================================================================//
+/*!	@file
+	@brief	ディレクトリー・キャッシュ・クラス @n
+			・ディレクトリーを一度だけ読み込み、アリーナ上にスナップショットを作る @n
+			・エントリーは「サイズ、日時、属性、名前」の可変長で詰めて格納 @n
+			・名前、日付、サイズでソート（ディレクトリーが先頭） @n
+			・「service()」で少しずつ読み込む（巨大なディレクトリー対応） @n
+			・最近使ったディレクトリーを MRU で複数保持 @n
+			・アリーナに収まらない場合は、ウィンドウ・モード（一部のみ保持）になる
+    @author 平松邦仁 (hira@rvf-rc45.net)
+	@copyright	Copyright (C) 2021 Kunihito Hiramatsu @n
+				Released under the MIT license @n
+				https://github.com/hirakuni45/RX/blob/master/LICENSE
+*/
+//=====================================================================//
+#include <cstring>
+#include <cstddef>
+#include <algorithm>
+#include "ff14/source/ff.h"
+
+namespace utils {
+
+	//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+	/*!
+		@brief  ディレクトリー・キャッシュ・クラス
+		@param[in]	ASIZE	アリーナのサイズ（バイト、４の倍数）
+		@param[in]	MRU		保持するディレクトリー数
+	*/
+	//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+	template <uint32_t ASIZE = 16384, uint32_t MRU = 4>
+	class dir_cache {
+
+		static_assert((ASIZE % 4) == 0, "ASIZE must be a multiple of 4");
+		static_assert(MRU > 0, "MRU must be greater than 0");
+
+	public:
+		//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+		/*!
+			@brief  ソート型
+		*/
+		//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+		enum class SORT : uint8_t {
+			NONE,	///< ディレクトリーの並び順
+			NAME,	///< 名前順（大文字、小文字を区別しない）
+			DATE,	///< 日付順（新しい順）
+			SIZE,	///< サイズ順（大きい順）
+		};
+
+
+		//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+		/*!
+			@brief  エントリー型（可変長）
+		*/
+		//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+		struct entry_t {
+			uint32_t	size;		///< ファイル・サイズ
+			uint32_t	time;		///< 更新日時（fdate << 16 | ftime）
+			uint8_t		attr;		///< 属性（AM_DIR など）
+			char		name[1];	///< 名前（０終端、可変長）
+
+			bool is_dir() const noexcept { return (attr & AM_DIR) != 0; }
+			uint16_t get_fdate() const noexcept { return time >> 16; }
+			uint16_t get_ftime() const noexcept { return time & 0xffff; }
+		};
+
+
+		//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+		/*!
+			@brief  統計型
+		*/
+		//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+		struct stat_t {
+			uint32_t	hit;		///< MRU ヒット数
+			uint32_t	miss;		///< MRU ミス数
+			uint32_t	read;		///< f_readdir 回数
+			uint32_t	evict;		///< 追い出し数
+			uint32_t	reload;		///< ウィンドウ再読み込み数
+		};
+
+	private:
+		static const uint32_t ENTRY_HEAD = offsetof(entry_t, name);
+
+		struct slot_t {
+			uint32_t	org;	///< アリーナ上の位置
+			uint32_t	len;	///< 使用サイズ
+			uint32_t	ent;	///< エントリー先頭（org からの相対）
+			uint32_t	idx;	///< インデックス配列（org からの相対）
+			uint32_t	num;	///< 格納エントリー数
+			uint32_t	total;	///< 全エントリー数
+			uint32_t	base;	///< 格納エントリーの先頭番号（ウィンドウ・モード）
+			uint32_t	age;	///< 参照順
+			SORT		sort;
+			bool		valid;
+			bool		window;
+		};
+
+		uint32_t	arena_[ASIZE / 4];
+		slot_t		slot_[MRU];
+
+		DIR			dir_;
+		uint32_t	cur_;
+		uint32_t	age_;
+		SORT		sort_;
+		bool		load_;
+
+		stat_t		stat_;
+
+		static uint32_t align_(uint32_t n) noexcept { return (n + 3) & ~3; }
+
+		uint8_t* ptr_(uint32_t ofs) noexcept {
+			return reinterpret_cast<uint8_t*>(arena_) + ofs;
+		}
+
+		const uint8_t* ptr_(uint32_t ofs) const noexcept {
+			return reinterpret_cast<const uint8_t*>(arena_) + ofs;
+		}
+
+		// 読み込み中のインデックスはアリーナの後端から下に向かって伸ばす
+		uint32_t* tmp_idx_(uint32_t n) noexcept {
+			return &arena_[ASIZE / 4 - 1 - n];
+		}
+
+		const uint32_t* tmp_idx_(uint32_t n) const noexcept {
+			return &arena_[ASIZE / 4 - 1 - n];
+		}
+
+		uint32_t* idx_(slot_t& s) noexcept {
+			return reinterpret_cast<uint32_t*>(ptr_(s.org + s.idx));
+		}
+
+
+		// 有効なスロットを前詰めし、使用サイズを返す
+		uint32_t compact_() noexcept
+		{
+			uint32_t pos = 0;
+			while(1) {
+				slot_t* t = nullptr;
+				for(uint32_t i = 0; i < MRU; ++i) {
+					auto& s = slot_[i];
+					if(!s.valid || s.org < pos) continue;
+					if(t == nullptr || s.org < t->org) t = &s;
+				}
+				if(t == nullptr) break;
+				if(t->org != pos) {
+					std::memmove(ptr_(pos), ptr_(t->org), t->len);
+					t->org = pos;
+				}
+				pos += t->len;
+			}
+			return pos;
+		}
+
+
+		// 現在のスロット以外で一番古いものを追い出す
+		bool evict_() noexcept
+		{
+			slot_t* t = nullptr;
+			for(uint32_t i = 0; i < MRU; ++i) {
+				auto& s = slot_[i];
+				if(!s.valid || i == cur_) continue;
+				if(t == nullptr || s.age < t->age) t = &s;
+			}
+			if(t == nullptr) return false;
+			t->valid = false;
+			++stat_.evict;
+			return true;
+		}
+
+
+		uint32_t free_(const slot_t& s) const noexcept
+		{
+			uint32_t top = ASIZE - (s.num + 1) * 4;
+			uint32_t end = s.org + s.len;
+			return top > end ? top - end : 0;
+		}
+
+
+		// エントリーを追加（入らない場合「false」）
+		bool add_(slot_t& s, const FILINFO& fi) noexcept
+		{
+			uint32_t l = std::strlen(fi.fname) + 1;
+			uint32_t need = align_(ENTRY_HEAD + l);
+			while(free_(s) < need) {
+				if(!evict_()) return false;
+				compact_();
+			}
+			auto e = reinterpret_cast<entry_t*>(ptr_(s.org + s.len));
+			e->size = fi.fsize;
+			e->time = (static_cast<uint32_t>(fi.fdate) << 16) | fi.ftime;
+			e->attr = fi.fattrib;
+			std::memcpy(e->name, fi.fname, l);
+			*tmp_idx_(s.num) = s.len;
+			s.len += need;
+			++s.num;
+			return true;
+		}
+
+
+		// 読み込み完了、インデックスをエントリーの後ろに移動
+		void finish_(slot_t& s) noexcept
+		{
+			f_closedir(&dir_);
+			load_ = false;
+			s.idx = s.len;
+			if(s.num > 0) {  // 後端の逆順インデックスを移動して、正順に並べ替える
+				auto dst = idx_(s);
+				std::memmove(dst, tmp_idx_(s.num - 1), s.num * 4);
+				std::reverse(dst, dst + s.num);
+			}
+			s.len += s.num * 4;
+			s.sort = SORT::NONE;
+			if(!s.window) {
+				sort_slot_(s, sort_);
+			}
+		}
+
+
+		static int compare_name_(const char* a, const char* b) noexcept
+		{
+			while(1) {
+				auto ca = static_cast<uint8_t>(*a++);
+				auto cb = static_cast<uint8_t>(*b++);
+				if(ca >= 'A' && ca <= 'Z') ca += 'a' - 'A';
+				if(cb >= 'A' && cb <= 'Z') cb += 'a' - 'A';
+				if(ca != cb) return static_cast<int>(ca) - static_cast<int>(cb);
+				if(ca == 0) return 0;
+			}
+		}
+
+
+		void sort_slot_(slot_t& s, SORT sort) noexcept
+		{
+			if(s.sort == sort || s.window) return;
+
+			auto idx = idx_(s);
+			auto org = ptr_(s.org);
+			auto ent = [=](uint32_t ofs) {
+				return reinterpret_cast<const entry_t*>(org + ofs);
+			};
+			switch(sort) {
+			case SORT::NONE:  // エントリーは読み込み順に並んでいる
+				std::sort(idx, idx + s.num);
+				break;
+			case SORT::NAME:
+				std::sort(idx, idx + s.num, [=](uint32_t a, uint32_t b) {
+					auto ea = ent(a);
+					auto eb = ent(b);
+					if(ea->is_dir() != eb->is_dir()) return ea->is_dir();
+					return compare_name_(ea->name, eb->name) < 0;
+				});
+				break;
+			case SORT::DATE:
+				std::sort(idx, idx + s.num, [=](uint32_t a, uint32_t b) {
+					auto ea = ent(a);
+					auto eb = ent(b);
+					if(ea->is_dir() != eb->is_dir()) return ea->is_dir();
+					if(ea->time != eb->time) return ea->time > eb->time;
+					return compare_name_(ea->name, eb->name) < 0;
+				});
+				break;
+			case SORT::SIZE:
+				std::sort(idx, idx + s.num, [=](uint32_t a, uint32_t b) {
+					auto ea = ent(a);
+					auto eb = ent(b);
+					if(ea->is_dir() != eb->is_dir()) return ea->is_dir();
+					if(ea->size != eb->size) return ea->size > eb->size;
+					return compare_name_(ea->name, eb->name) < 0;
+				});
+				break;
+			}
+			s.sort = sort;
+		}
+
+
+		// ウィンドウ・モードで、idx を含む範囲を読み直す
+		bool reload_(slot_t& s, uint32_t idx) noexcept
+		{
+			// アリーナ全体を使うので、他のスナップショットは追い出す
+			for(uint32_t i = 0; i < MRU; ++i) {
+				if(i != cur_ && slot_[i].valid) {
+					slot_[i].valid = false;
+					++stat_.evict;
+				}
+			}
+			compact_();
+
+			auto path = reinterpret_cast<const char*>(ptr_(s.org));
+			if(f_opendir(&dir_, path) != FR_OK) return false;
+			++stat_.reload;
+
+			// 前回格納できた数の半分を手前に残す
+			uint32_t half = s.num / 2;
+			s.base = idx > half ? idx - half : 0;
+			s.len = s.ent;
+			s.num = 0;
+			uint32_t n = 0;
+			while(1) {
+				FILINFO fi;
+				++stat_.read;
+				if(f_readdir(&dir_, &fi) != FR_OK || fi.fname[0] == 0) break;
+				if(n >= s.base) {
+					if(!add_(s, fi)) break;
+				}
+				++n;
+			}
+			finish_(s);
+			return idx >= s.base && idx < (s.base + s.num);
+		}
+
+	public:
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	コンストラクター
+		 */
+		//-----------------------------------------------------------------//
+		dir_cache() noexcept : arena_{ 0 }, slot_{ }, dir_(), cur_(0), age_(0),
+			sort_(SORT::NONE), load_(false), stat_{ } { }
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	ディレクトリーの取得開始 @n
+					MRU にあれば、ファイル・システムにはアクセスしない。@n
+					※「probe()」が「false」になるまで「service()」を呼ぶ
+			@param[in]	path	ディレクトリー・パス
+			@return エラー無ければ「true」
+		 */
+		//-----------------------------------------------------------------//
+		bool start(const char* path) noexcept
+		{
+			if(path == nullptr) return false;
+
+			if(load_) {  // 読み込み途中のスナップショットは破棄
+				f_closedir(&dir_);
+				load_ = false;
+				slot_[cur_].valid = false;
+			}
+
+			++age_;
+			for(uint32_t i = 0; i < MRU; ++i) {
+				auto& s = slot_[i];
+				if(s.valid && std::strcmp(reinterpret_cast<const char*>(ptr_(s.org)), path) == 0) {
+					cur_ = i;
+					s.age = age_;
+					sort_slot_(s, sort_);
+					++stat_.hit;
+					return true;
+				}
+			}
+			++stat_.miss;
+
+			// 空きスロット、無ければ一番古いスロットを使う
+			uint32_t n = MRU;
+			for(uint32_t i = 0; i < MRU; ++i) {
+				auto& s = slot_[i];
+				if(!s.valid) { n = i; break; }
+				if(n == MRU || s.age < slot_[n].age) n = i;
+			}
+			if(slot_[n].valid) {
+				slot_[n].valid = false;
+				++stat_.evict;
+			}
+			cur_ = n;
+
+			uint32_t l = std::strlen(path) + 1;
+			uint32_t need = align_(l);
+			uint32_t org = compact_();
+			while((org + need + 4) > ASIZE) {
+				if(!evict_()) return false;
+				org = compact_();
+			}
+
+			if(f_opendir(&dir_, path) != FR_OK) {
+				return false;
+			}
+
+			auto& s = slot_[n];
+			s.org = org;
+			std::memcpy(ptr_(org), path, l);
+			s.len = need;
+			s.ent = need;
+			s.idx = 0;
+			s.num = 0;
+			s.total = 0;
+			s.base = 0;
+			s.age = age_;
+			s.sort = SORT::NONE;
+			s.window = false;
+			s.valid = true;
+			load_ = true;
+			return true;
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	読み込みサービス
+			@param[in]	num		一度に読み込むエントリー数
+			@return エラー無ければ「true」
+		 */
+		//-----------------------------------------------------------------//
+		bool service(uint32_t num) noexcept
+		{
+			if(!load_) return false;
+
+			auto& s = slot_[cur_];
+			for(uint32_t i = 0; i < num; ++i) {
+				FILINFO fi;
+				++stat_.read;
+				if(f_readdir(&dir_, &fi) != FR_OK) {
+					f_closedir(&dir_);
+					load_ = false;
+					s.valid = false;
+					return false;
+				}
+				if(fi.fname[0] == 0) {
+					finish_(s);
+					break;
+				}
+				if(!s.window) {
+					if(!add_(s, fi)) {  // 他を全て追い出しても入らない
+						s.window = true;
+					}
+				}
+				++s.total;
+			}
+			return true;
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	読み込み中か
+			@return 読み込み中なら「true」
+		 */
+		//-----------------------------------------------------------------//
+		bool probe() const noexcept { return load_; }
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	有効なディレクトリーがあるか
+			@return 有効なら「true」
+		 */
+		//-----------------------------------------------------------------//
+		bool is_valid() const noexcept { return slot_[cur_].valid; }
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	ウィンドウ・モード（アリーナに入りきらない）か @n
+					※ウィンドウ・モードではソートしない
+			@return ウィンドウ・モードなら「true」
+		 */
+		//-----------------------------------------------------------------//
+		bool is_window() const noexcept { return slot_[cur_].valid && slot_[cur_].window; }
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	エントリー数を取得（読み込み中は、その時点の数）
+			@return エントリー数
+		 */
+		//-----------------------------------------------------------------//
+		uint32_t get_num() const noexcept
+		{
+			const auto& s = slot_[cur_];
+			if(!s.valid) return 0;
+			return s.total;
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	エントリーを取得 @n
+					ウィンドウ・モードで範囲外の場合、読み直しを行う。
+			@param[in]	idx		番号（ソート順）
+			@return エントリー（無い場合「nullptr」）
+		 */
+		//-----------------------------------------------------------------//
+		const entry_t* get(uint32_t idx) noexcept
+		{
+			auto& s = slot_[cur_];
+			if(!s.valid) return nullptr;
+
+			if(load_) {
+				if(idx >= s.num) return nullptr;
+				return reinterpret_cast<const entry_t*>(ptr_(s.org + *tmp_idx_(idx)));
+			}
+			if(idx >= s.total) return nullptr;
+			if(idx < s.base || idx >= (s.base + s.num)) {
+				if(!reload_(s, idx)) return nullptr;
+			}
+			return reinterpret_cast<const entry_t*>(ptr_(s.org + idx_(s)[idx - s.base]));
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	現在のディレクトリー・パスを取得
+			@return パス
+		 */
+		//-----------------------------------------------------------------//
+		const char* get_path() const noexcept
+		{
+			const auto& s = slot_[cur_];
+			if(!s.valid) return "";
+			return reinterpret_cast<const char*>(ptr_(s.org));
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	ソートを設定（読み込み済みなら、すぐに並べ替える）
+			@param[in]	sort	ソート型
+		 */
+		//-----------------------------------------------------------------//
+		void set_sort(SORT sort) noexcept
+		{
+			sort_ = sort;
+			auto& s = slot_[cur_];
+			if(s.valid && !load_) {
+				sort_slot_(s, sort_);
+			}
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	ソートを取得
+			@return ソート型
+		 */
+		//-----------------------------------------------------------------//
+		SORT get_sort() const noexcept { return sort_; }
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	全てのスナップショットを破棄 @n
+					※メディアの交換、書き込みを行った場合に呼ぶ
+		 */
+		//-----------------------------------------------------------------//
+		void flush() noexcept
+		{
+			if(load_) {
+				f_closedir(&dir_);
+				load_ = false;
+			}
+			for(uint32_t i = 0; i < MRU; ++i) {
+				slot_[i].valid = false;
+			}
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	統計を取得
+			@return 統計
+		 */
+		//-----------------------------------------------------------------//
+		const stat_t& get_stat() const noexcept { return stat_; }
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	統計をクリア
+		 */
+		//-----------------------------------------------------------------//
+		void clear_stat() noexcept { stat_ = stat_t { }; }
+	};
+}
@@ -341,7 +341,8 @@ namespace utils {
 		/*!
 			@brief	ファイルを開く
 			@param[in]	filename	ファイル名
-			@param[in]	mode		オープン・モード
+			@param[in]	mode		オープン・モード @n
+									※「r+」、「w+」で読み書き両用
 			@return 成功なら「true」
 		*/
 		//-----------------------------------------------------------------//
@@ -362,6 +363,9 @@ namespace utils {
 			if(strchr(mode, 'a') != nullptr) {
 				mdf |= FA_OPEN_APPEND;
 			}
+			if(strchr(mode, '+') != nullptr) {
+				mdf |= FA_READ | FA_WRITE;
+			}
 
 //			char tmp[PATH_MAX_SIZE];
 //			if(!make_full_path(filename, tmp, PATH_MAX_SIZE)) {
@@ -92,6 +92,43 @@ namespace utils {
 		}
 
 
+        //-----------------------------------------------------------------//
+        /*!
+            @brief  値の格納ポイントをまとめて移動
+			@param[in]	num	移動数（put_span で得た数以下）
+        */
+        //-----------------------------------------------------------------//
+		inline void put_go(uint32_t num) noexcept {
+			volatile auto put = put_;
+			put += num;
+			if(put >= SIZE) {
+				put -= SIZE;
+			}
+			put_ = put;
+		}
+
+
+        //-----------------------------------------------------------------//
+        /*!
+            @brief  連続して格納できる領域を得る @n
+					バッファ終端で折り返さない範囲、書き込み後に put_go(num) で確定する
+			@param[out]	num	格納できる数
+			@return 格納領域の先頭
+        */
+        //-----------------------------------------------------------------//
+		UNIT* put_span(uint32_t& num) noexcept {
+			uint32_t put = put_;
+			uint32_t get = get_;
+			if(put >= get) {
+				num = SIZE - put;
+				if(get == 0) --num;
+			} else {
+				num = get - put - 1;
+			}
+			return &buff_[put];
+		}
+
+
         //-----------------------------------------------------------------//
         /*!
             @brief  値の格納
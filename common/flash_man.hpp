@@ -1,83 +1,529 @@
 #pragma once
 //=====================================================================//
 /*!	@file
-	@brief	Flash memory マネージャー
+	@brief	Flash memory マネージャー @n
+			データ・フラッシュ上のログ構造キー／バリュー・ストア @n
+			・追記のみ（上書きしない）、レコード毎に CRC で保護 @n
+			・マウント時に一度だけ走査して RAM インデックスを構築 @n
+			・セクター単位のガベージ・コレクションと、消去回数による平滑化 @n
+			・書き込み途中の電源断からの復帰（古い値か新しい値のどちらか）
     @author 平松邦仁 (hira@rvf-rc45.net)
-	@copyright	Copyright (C) 2017 Kunihito Hiramatsu @n
+	@copyright	Copyright (C) 2017, 2021 Kunihito Hiramatsu @n
 				Released under the MIT license @n
 				https://github.com/hirakuni45/RX/blob/master/LICENSE
 */
 //=====================================================================//
-#include "common/renesas.hpp"
+#include <cstdint>
+#include <cstring>
 
 namespace utils {
 
 	//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
 	/*!
 		@brief  flash_man class @n
-				データ列の構造：@n
-				+0: ID (2 bytes) @n
-				+2: TM (2 bytes) タイムスタンプ（数値が一番大きいものが最新）@n
-				+4: SZ (2 bytes) サイズ
+				FIO は「device::flash_io」（RX600 系）と同じインターフェースを持つ事：@n
+				  read(org, dst, len) / write(org, src, len) / erase(org) @n
+				  erase_check(org, len) / data_flash_size / data_flash_block @n
+				※消去後の読み出し値は不定として扱い、空き判定は erase_check で行う。@n
+				※RX24T の flash_io はインターフェースが異なるのでアダプターが必要。@n
+				セクター構造：@n
+				+0:  MAGIC (4 bytes) @n
+				+4:  消去回数 (4 bytes) @n
+				+8:  CRC (2 bytes) + 予約 (2 bytes) @n
+				+12: シーケンス番号 (4 bytes) 使用開始時に書き込む @n
+				+16: CRC (2 bytes) + 予約 (2 bytes) @n
+				+20: レコード列 @n
+				レコード構造：@n
+				+0: KEY (2 bytes) @n
+				+2: LEN (2 bytes) B15 が「１」の場合削除レコード @n
+				+4: CRC (2 bytes) KEY、LEN、データの CRC @n
+				+6: CRC (2 bytes) ヘッダー（+0 ～ +5）の CRC @n
+				+8: データ（４バイト境界まで 0xFF で埋める）
 		@param[in]	FIO		フラッシュ I/O
-		@param[in]	OMAX	オープン最大
+		@param[in]	KNUM	キーの最大数（削除レコードを含む）
+		@param[in]	SECTOR	セクターのサイズ（data_flash_block の整数倍）
 	*/
 	//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
-	template <class FIO, uint32_t OMAX = 4>
+	template <class FIO, uint32_t KNUM = 32, uint32_t SECTOR = 1024>
 	class flash_man {
+	public:
+		static constexpr uint32_t SECTOR_NUM = FIO::data_flash_size / SECTOR;	///< セクター数
+		static constexpr uint32_t RESERVE = 1;		///< GC 用に残す空きセクター数
+		static constexpr uint32_t GC_LOW  = 2;		///< バックグラウンド GC を始める空きセクター数
+		static constexpr uint32_t WEAR_DIFF = 32;	///< 消去回数の差がこれを超えたら静的平滑化
+
+	private:
+		static_assert((SECTOR % FIO::data_flash_block) == 0, "SECTOR must be a multiple of data_flash_block");
+		static_assert(SECTOR_NUM >= 3, "Data flash too small (3 sectors or more)");
+		static_assert(SECTOR <= 0x8000, "SECTOR too large");
 
-		FIO&	fio_;
+		static constexpr uint32_t MAGIC = 0x564B4C46;	///< 'FLKV'
+		static constexpr uint16_t TOMB  = 0x8000;		///< 削除レコード
+		static constexpr uint32_t NONE  = SECTOR_NUM;
 
-		// 制限：　１ファイル、最大３２Ｋバイトまで
 		struct head_t {
-			uint16_t	id;		///< file ID
-			uint16_t	nx_sz;	///< (B15:1)next block, (B15:0)total size
+			uint32_t	magic;
+			uint32_t	ecnt;
+			uint16_t	crc;
+			uint16_t	rsv;
+		};
+
+		struct seq_t {
+			uint32_t	seq;
+			uint16_t	crc;
+			uint16_t	rsv;
 		};
 
+		struct rec_t {
+			uint16_t	key;
+			uint16_t	len;
+			uint16_t	crc;
+			uint16_t	hcrc;
+		};
+
+		static constexpr uint32_t DATA_ORG = sizeof(head_t) + sizeof(seq_t);
+		static constexpr uint32_t CAP = SECTOR - DATA_ORG;
+
+		struct idx_t {
+			uint16_t	key;
+			uint16_t	len;
+			uint32_t	addr;
+		};
+
+		enum class STAT : uint8_t {
+			FREE,	///< 消去済み（ヘッダー有り）
+			USED,	///< 使用中
+			BAD,	///< 要消去
+		};
+
+		FIO&		fio_;
+
+		idx_t		idx_[KNUM];
+		uint32_t	num_;
+
+		uint32_t	ecnt_[SECTOR_NUM];
+		uint32_t	seq_[SECTOR_NUM];
+		uint16_t	live_[SECTOR_NUM];
+		STAT		stat_[SECTOR_NUM];
+
+		uint32_t	head_sec_;
+		uint32_t	head_pos_;
+		uint32_t	seq_max_;
+
+		uint32_t	gc_sec_;
+
+		uint32_t	crc_error_;
+		uint32_t	gc_count_;
+		uint32_t	write_error_;
+
+
+		static uint16_t crc16_(const void* src, uint32_t len, uint16_t crc = 0xFFFF) noexcept
+		{
+			const uint8_t* p = static_cast<const uint8_t*>(src);
+			while(len > 0) {
+				crc ^= static_cast<uint16_t>(*p++) << 8;
+				for(int i = 0; i < 8; ++i) {
+					if(crc & 0x8000) crc = (crc << 1) ^ 0x1021;
+					else crc <<= 1;
+				}
+				--len;
+			}
+			return crc;
+		}
+
+
+		static uint32_t rec_size_(uint16_t len) noexcept
+		{
+			if(len & TOMB) return sizeof(rec_t);
+			return sizeof(rec_t) + ((len + 3) & ~3);
+		}
+
+
+		static uint32_t sec_org_(uint32_t sec) noexcept { return sec * SECTOR; }
+		static uint32_t sec_of_(uint32_t addr) noexcept { return addr / SECTOR; }
+
+
+		uint32_t find_(uint16_t key) const noexcept
+		{
+			for(uint32_t i = 0; i < num_; ++i) {
+				if(idx_[i].key == key) return i;
+			}
+			return num_;
+		}
+
+
+		uint32_t free_num_() const noexcept
+		{
+			uint32_t n = 0;
+			for(uint32_t i = 0; i < SECTOR_NUM; ++i) {
+				if(stat_[i] == STAT::FREE) ++n;
+			}
+			return n;
+		}
+
+
+		uint32_t head_remain_() const noexcept
+		{
+			if(head_sec_ == NONE) return 0;
+			return sec_org_(head_sec_ + 1) - head_pos_;
+		}
+
+
+		// 書き込みと読み戻し検証
+		bool prog_(uint32_t org, const void* src, uint32_t len) noexcept
+		{
+			if(!fio_.write(org, src, len)) {
+				return false;
+			}
+			const uint8_t* p = static_cast<const uint8_t*>(src);
+			uint8_t tmp[16];
+			while(len > 0) {
+				auto l = len;
+				if(l > sizeof(tmp)) l = sizeof(tmp);
+				if(!fio_.read(org, tmp, l)) return false;
+				if(std::memcmp(tmp, p, l) != 0) return false;
+				org += l;
+				p += l;
+				len -= l;
+			}
+			return true;
+		}
+
+
+		// フラッシュ上のデータの CRC
+		bool flash_crc_(uint32_t org, uint32_t len, uint16_t& crc) noexcept
+		{
+			uint8_t tmp[16];
+			while(len > 0) {
+				auto l = len;
+				if(l > sizeof(tmp)) l = sizeof(tmp);
+				if(!fio_.read(org, tmp, l)) return false;
+				crc = crc16_(tmp, l, crc);
+				org += l;
+				len -= l;
+			}
+			return true;
+		}
+
+
+		// ヘッダーのあるブロックを最初に消去する（途中で電源断が起きても BAD として扱える）
+		bool erase_sec_(uint32_t sec, uint32_t ecnt) noexcept
+		{
+			stat_[sec] = STAT::BAD;
+			live_[sec] = 0;
+			seq_[sec] = 0;
+			for(uint32_t ofs = 0; ofs < SECTOR; ofs += FIO::data_flash_block) {
+				if(!fio_.erase(sec_org_(sec) + ofs)) {
+					++write_error_;
+					return false;
+				}
+			}
+			ecnt_[sec] = ecnt;
+			head_t h;
+			h.magic = MAGIC;
+			h.ecnt = ecnt;
+			h.crc = crc16_(&ecnt, sizeof(ecnt));
+			h.rsv = 0;
+			if(!prog_(sec_org_(sec), &h, sizeof(h))) {
+				++write_error_;
+				return false;
+			}
+			stat_[sec] = STAT::FREE;
+			return true;
+		}
+
 
-		uint32_t free_()
+		// 消去回数が一番少ない空きセクターを使用開始
+		bool open_sec_(bool gc) noexcept
 		{
-			uint32_t pos = 0;
-			while(pos < FIO::data_flash_size) {
-				if(fio_.erase_check(pos)) {
-					return pos;
+			while(1) {
+				if(!gc && free_num_() <= RESERVE) {
+					return false;
+				}
+				uint32_t sec = NONE;
+				for(uint32_t i = 0; i < SECTOR_NUM; ++i) {
+					if(stat_[i] != STAT::FREE) continue;
+					if(sec == NONE || ecnt_[i] < ecnt_[sec]) sec = i;
+				}
+				if(sec == NONE) {
+					return false;
+				}
+				// 失敗したセクターと番号が重ならないように、先に進めておく
+				++seq_max_;
+				seq_t s;
+				s.seq = seq_max_;
+				s.crc = crc16_(&s.seq, sizeof(s.seq));
+				s.rsv = 0;
+				if(prog_(sec_org_(sec) + sizeof(head_t), &s, sizeof(s))) {
+					seq_[sec] = seq_max_;
+					stat_[sec] = STAT::USED;
+					head_sec_ = sec;
+					head_pos_ = sec_org_(sec) + DATA_ORG;
+					return true;
 				}
-				pos += FIO::data_flash_block;
+				++write_error_;
+				stat_[sec] = STAT::BAD;
 			}
-			return FIO::data_flash_size;
 		}
 
 
-		uint32_t scan_(uint16_t id) const
+		// レコードの追記、src が nullptr の場合はフラッシュ上の fsrc からコピー
+		uint32_t append_(uint16_t key, uint16_t len, const void* src, uint32_t fsrc, uint16_t crc, bool gc) noexcept
 		{
-			uint32_t pos = 0;
-			uint32_t match = FIO::data_flash_size;
-			while(pos < FIO::data_flash_size) {
-				uint32_t d = FIO::data_flash_block;
-				if(!fio_.erase_check(pos)) {
-					head_t h;
-					fio_.read(pos, &h, sizeof(head_t));
-					if(h.id == id) {
-						match = pos;
-						uint16_t s = h.size;
-						d = s / (FIO::data_flash_block - sizeof(head_t));
-						if(d == 0) ++d;
-						d *= FIO::data_flash_block;
+			auto need = rec_size_(len);
+			for(int retry = 0; retry < 2; ++retry) {
+				if(head_remain_() < need) {
+					if(!open_sec_(gc)) return 0;
+				}
+				auto org = head_pos_;
+				// 失敗しても書き込んだ領域は再利用出来ないので、先に進めておく
+				head_pos_ += need;
+				rec_t r;
+				r.key = key;
+				r.len = len;
+				r.crc = crc;
+				r.hcrc = crc16_(&r, 6);
+				bool ok = prog_(org, &r, sizeof(r));
+				uint32_t dlen = (len & TOMB) ? 0 : len;
+				uint32_t ofs = 0;
+				uint8_t tmp[16];
+				while(ok && ofs < dlen) {
+					uint32_t l = dlen - ofs;
+					if(l > sizeof(tmp)) l = sizeof(tmp);
+					if(src != nullptr) {
+						std::memcpy(tmp, static_cast<const uint8_t*>(src) + ofs, l);
+					} else {
+						ok = fio_.read(fsrc + ofs, tmp, l);
+						if(!ok) break;
 					}
+					// 最後の端数は 0xFF で埋める
+					uint32_t wl = (l + 3) & ~3;
+					for(uint32_t i = l; i < wl; ++i) tmp[i] = 0xFF;
+					ok = prog_(org + sizeof(rec_t) + ofs, tmp, wl);
+					ofs += l;
+				}
+				if(ok) {
+					return org;
+				}
+				++write_error_;
+				// 書き込みに失敗したセクターは閉じる
+				head_pos_ = sec_org_(head_sec_ + 1);
+			}
+			return 0;
+		}
+
+
+		void set_idx_(uint32_t i, uint16_t key, uint16_t len, uint32_t addr) noexcept
+		{
+			if(i < num_) {
+				live_[sec_of_(idx_[i].addr)] -= rec_size_(idx_[i].len);
+			} else {
+				i = num_;
+				++num_;
+			}
+			idx_[i].key = key;
+			idx_[i].len = len;
+			idx_[i].addr = addr;
+			live_[sec_of_(addr)] += rec_size_(len);
+		}
+
+
+		void erase_idx_(uint32_t i) noexcept
+		{
+			live_[sec_of_(idx_[i].addr)] -= rec_size_(idx_[i].len);
+			--num_;
+			idx_[i] = idx_[num_];
+		}
+
+
+		bool oldest_(uint32_t sec) const noexcept
+		{
+			for(uint32_t i = 0; i < SECTOR_NUM; ++i) {
+				if(stat_[i] == STAT::USED && seq_[i] < seq_[sec]) return false;
+			}
+			return true;
+		}
+
+
+		// 有効データが一番少ないセクター
+		uint32_t victim_() const noexcept
+		{
+			uint32_t sec = NONE;
+			for(uint32_t i = 0; i < SECTOR_NUM; ++i) {
+				if(stat_[i] != STAT::USED || i == head_sec_) continue;
+				if(live_[i] >= CAP) continue;
+				if(sec == NONE || live_[i] < live_[sec]) sec = i;
+			}
+			return sec;
+		}
+
+
+		// GC を開始出来るか（有効データを移す場所があるか）
+		bool start_gc_(uint32_t sec) noexcept
+		{
+			if(sec == NONE) return false;
+			if((head_remain_() + free_num_() * CAP) < live_[sec]) return false;
+			gc_sec_ = sec;
+			return true;
+		}
+
+
+		// GC を１レコード進める
+		bool gc_step_() noexcept
+		{
+			auto sec = gc_sec_;
+			for(uint32_t i = 0; i < num_; ++i) {
+				if(sec_of_(idx_[i].addr) != sec) continue;
+				const auto& t = idx_[i];
+				if((t.len & TOMB) != 0 && oldest_(sec)) {
+					// 最古のセクターにある削除レコードは、これより古い記録が無いので捨てる
+					erase_idx_(i);
+					return true;
 				}
-				pos += d;
+				rec_t r;
+				if(!fio_.read(t.addr, &r, sizeof(r))) return false;
+				auto a = append_(t.key, t.len, nullptr, t.addr + sizeof(rec_t), r.crc, true);
+				if(a == 0) {
+					return false;
+				}
+				set_idx_(i, t.key, t.len, a);
+				return true;
+			}
+			gc_sec_ = NONE;
+			++gc_count_;
+			return erase_sec_(sec, ecnt_[sec] + 1);
+		}
+
+
+		bool gc_finish_() noexcept
+		{
+			while(gc_sec_ != NONE) {
+				if(!gc_step_()) {
+					gc_sec_ = NONE;
+					return false;
+				}
+			}
+			return true;
+		}
+
+
+		bool fits_(uint32_t need) const noexcept
+		{
+			return head_remain_() >= need || free_num_() > RESERVE;
+		}
+
+
+		// 書き込める量（GC 用の予備は除く）
+		uint32_t avail_() const noexcept
+		{
+			auto n = free_num_();
+			return head_remain_() + (n > RESERVE ? (n - RESERVE) * CAP : 0);
+		}
+
+
+		bool make_space_(uint32_t need) noexcept
+		{
+			if(fits_(need)) return true;
+			if(!gc_finish_()) return false;
+			// 回収しても足りない場合は、無駄な消去をしない
+			uint32_t dead = avail_();
+			for(uint32_t i = 0; i < SECTOR_NUM; ++i) {
+				if(stat_[i] == STAT::USED && i != head_sec_) dead += CAP - live_[i];
+			}
+			if(dead < need) return false;
+			for(uint32_t n = 0; n < SECTOR_NUM; ++n) {
+				if(fits_(need)) return true;
+				auto a = avail_();
+				if(!start_gc_(victim_())) return false;
+				if(!gc_finish_()) return false;
+				// 断片化で空きが増えない
+				if(avail_() <= a && !fits_(need)) return false;
 			}
-			return match;
+			return fits_(need);
 		}
 
 
+		bool update_(uint16_t key, uint16_t len, const void* src) noexcept
+		{
+			auto i = find_(key);
+			if(i >= num_ && num_ >= KNUM) {
+				return false;
+			}
+			if(!make_space_(rec_size_(len))) {
+				return false;
+			}
+			uint16_t crc = crc16_(&key, 2);
+			crc = crc16_(&len, 2, crc);
+			if(src != nullptr) crc = crc16_(src, len, crc);
+			auto a = append_(key, len, src, 0, crc, false);
+			if(a == 0) {
+				return false;
+			}
+			set_idx_(i, key, len, a);
+			return true;
+		}
+
+
+		// セクター内のレコードを再生
+		bool replay_(uint32_t sec) noexcept
+		{
+			bool ret = true;
+			uint32_t pos = sec_org_(sec) + DATA_ORG;
+			uint32_t end = sec_org_(sec + 1);
+			while((pos + sizeof(rec_t)) <= end) {
+				if(fio_.erase_check(pos, sizeof(rec_t))) {
+					// 残りが全て空きなら、ここが書き込み位置
+					if(!fio_.erase_check(pos, end - pos)) pos = end;
+					break;
+				}
+				rec_t r;
+				if(!fio_.read(pos, &r, sizeof(r)) || crc16_(&r, 6) != r.hcrc) {
+					// ヘッダーが壊れている場合、以降は信用出来ないのでセクターを閉じる
+					++crc_error_;
+					pos = end;
+					break;
+				}
+				auto sz = rec_size_(r.len);
+				if((r.len & ~TOMB) > (CAP - sizeof(rec_t)) || (pos + sz) > end) {
+					++crc_error_;
+					pos = end;
+					break;
+				}
+				uint16_t crc = crc16_(&r.key, 2);
+				crc = crc16_(&r.len, 2, crc);
+				if((r.len & TOMB) == 0) {
+					flash_crc_(pos + sizeof(rec_t), r.len, crc);
+				}
+				if(crc != r.crc) {
+					// データが壊れている（書き込み途中の電源断）レコードは読み飛ばす
+					++crc_error_;
+				} else {
+					auto i = find_(r.key);
+					if(i >= num_ && num_ >= KNUM) {
+						ret = false;
+					} else {
+						set_idx_(i, r.key, r.len, pos);
+					}
+				}
+				pos += sz;
+			}
+			head_sec_ = sec;
+			head_pos_ = pos;
+			return ret;
+		}
+
 	public:
 		//-----------------------------------------------------------------//
 		/*!
 			@brief  コンストラクタ
+			@param[in]	fio	フラッシュ I/O
 		*/
 		//-----------------------------------------------------------------//
-		flash_man(FIO& fio) : fio_(fio) { }
+		flash_man(FIO& fio) noexcept : fio_(fio), idx_{ }, num_(0),
+			ecnt_{ }, seq_{ }, live_{ }, stat_{ },
+			head_sec_(NONE), head_pos_(0), seq_max_(0), gc_sec_(NONE),
+			crc_error_(0), gc_count_(0), write_error_(0)
+		{ }
 
 
 		//-----------------------------------------------------------------//
@@ -86,82 +532,283 @@ namespace utils {
 			@return FIO
 		*/
 		//-----------------------------------------------------------------//
-		FIO& at_fio() { return fio_; }
+		FIO& at_fio() noexcept { return fio_; }
 
 
 		//-----------------------------------------------------------------//
 		/*!
-			@brief  フリー領域の取得
-			@return フリー領域の取得
+			@brief  マウント @n
+					全セクターを一度だけ走査して、インデックスを構築する。@n
+					ヘッダーが無い（未初期化、消去途中の電源断）セクターは消去する。
+			@return エラーなら「false」（キー数の超過、消去失敗）
 		*/
 		//-----------------------------------------------------------------//
-		uint32_t get_free() const {
-			uint32_t space = 0;
-			for(uint32_t i = 0; i < FIO::data_flash_bank; ++i) {
-				if(fio_.erase_check(i)) {
-					space += FIO::data_flash_block - sizeof(head_t);
+		bool mount() noexcept
+		{
+			num_ = 0;
+			head_sec_ = NONE;
+			head_pos_ = 0;
+			seq_max_ = 0;
+			gc_sec_ = NONE;
+			crc_error_ = 0;
+
+			uint32_t emax = 0;
+			for(uint32_t sec = 0; sec < SECTOR_NUM; ++sec) {
+				stat_[sec] = STAT::BAD;
+				live_[sec] = 0;
+				seq_[sec] = 0;
+				ecnt_[sec] = 0;
+				auto org = sec_org_(sec);
+				head_t h;
+				if(fio_.erase_check(org, sizeof(h))) continue;
+				if(!fio_.read(org, &h, sizeof(h))) continue;
+				if(h.magic != MAGIC || crc16_(&h.ecnt, sizeof(h.ecnt)) != h.crc) continue;
+				ecnt_[sec] = h.ecnt;
+				if(h.ecnt > emax) emax = h.ecnt;
+				org += sizeof(head_t);
+				if(fio_.erase_check(org, sizeof(seq_t))) {
+					stat_[sec] = STAT::FREE;
+					continue;
+				}
+				seq_t s;
+				if(!fio_.read(org, &s, sizeof(s))) continue;
+				if(crc16_(&s.seq, sizeof(s.seq)) != s.crc) continue;
+				seq_[sec] = s.seq;
+				stat_[sec] = STAT::USED;
+				if(s.seq > seq_max_) seq_max_ = s.seq;
+			}
+
+			// シーケンス番号の順に再生
+			bool ret = true;
+			uint32_t last = 0;
+			while(1) {
+				uint32_t sec = NONE;
+				for(uint32_t i = 0; i < SECTOR_NUM; ++i) {
+					if(stat_[i] != STAT::USED || seq_[i] <= last) continue;
+					if(sec == NONE || seq_[i] < seq_[sec]) sec = i;
+				}
+				if(sec == NONE) break;
+				if(!replay_(sec)) ret = false;
+				last = seq_[sec];
+			}
+
+			// 壊れたセクターは、消去回数が不明なので最大値を引き継ぐ
+			for(uint32_t sec = 0; sec < SECTOR_NUM; ++sec) {
+				if(stat_[sec] == STAT::BAD) {
+					if(!erase_sec_(sec, emax)) ret = false;
 				}
 			}
-			return space;
+			return ret;
 		}
 
 
 		//-----------------------------------------------------------------//
 		/*!
-			@brief  ファイルがあるか？
-			@param[in]	id	ファイルＩＤ
+			@brief  フォーマット（全て消去）
+			@return エラーなら「false」
+		*/
+		//-----------------------------------------------------------------//
+		bool format() noexcept
+		{
+			bool ret = true;
+			for(uint32_t sec = 0; sec < SECTOR_NUM; ++sec) {
+				auto ecnt = stat_[sec] == STAT::BAD ? 0 : ecnt_[sec] + 1;
+				if(!erase_sec_(sec, ecnt)) ret = false;
+			}
+			num_ = 0;
+			head_sec_ = NONE;
+			head_pos_ = 0;
+			seq_max_ = 0;
+			gc_sec_ = NONE;
+			return ret;
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief  キーがあるか？
+			@param[in]	key	キー
 			@return ある場合「true」
 		*/
 		//-----------------------------------------------------------------//
-		bool probe(uint16_t id) const
+		bool probe(uint16_t key) const noexcept
+		{
+			auto i = find_(key);
+			return i < num_ && (idx_[i].len & TOMB) == 0;
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief  サイズの取得
+			@param[in]	key	キー
+			@return サイズ（無い場合「０」）
+		*/
+		//-----------------------------------------------------------------//
+		uint32_t get_size(uint16_t key) const noexcept
+		{
+			if(!probe(key)) return 0;
+			return idx_[find_(key)].len;
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief  読み込み
+			@param[in]	key		キー
+			@param[out]	dst		転送先
+			@param[in]	size	サイズ（バイト）レコードより大きい場合はレコードのサイズ
+			@return エラーなら「false」
+		*/
+		//-----------------------------------------------------------------//
+		bool read(uint16_t key, void* dst, uint32_t size) noexcept
 		{
-			return scan_(id) < FIO::data_flash_size;
+			if(!probe(key)) return false;
+			const auto& t = idx_[find_(key)];
+			if(size > t.len) size = t.len;
+			return fio_.read(t.addr + sizeof(rec_t), dst, size);
 		}
 
 
 		//-----------------------------------------------------------------//
 		/*!
-			@brief  書き込み
-			@param[in]	id		ＩＤ
+			@brief  書き込み @n
+					新しいレコードを追記し、検証後にインデックスを切り替える。@n
+					途中で電源断が起きた場合、マウント後は以前の値が読める。
+			@param[in]	key		キー
 			@param[in]	src		ソース
 			@param[in]	size	サイズ（バイト）
 			@return エラーなら「false」
 		*/
 		//-----------------------------------------------------------------//
-		bool write(uint16_t id, const void* src, uint32_t size)
+		bool write(uint16_t key, const void* src, uint32_t size) noexcept
 		{
-			uint32_t pos = free_();
-			if(pos >= FIO::data_flash_size) {
-				return false;
-			}
-			uint32_t fsb = (FIO::data_flash_size - pos) / FIO::data_flash_block;
-			uint32_t fs  = fsb * (FIO::data_flash_block - sizeof(head_t));
-			if(fs < size) {
+			if(size > (CAP - sizeof(rec_t))) {
 				return false;
 			}
+			return update_(key, size, src);
+		}
 
-			head_t t;
-			t.id = id;
-//			t.size = 
 
+		//-----------------------------------------------------------------//
+		/*!
+			@brief  削除
+			@param[in]	key		キー
+			@return エラーなら「false」
+		*/
+		//-----------------------------------------------------------------//
+		bool remove(uint16_t key) noexcept
+		{
+			if(!probe(key)) return false;
+			return update_(key, TOMB, nullptr);
+		}
 
 
+		//-----------------------------------------------------------------//
+		/*!
+			@brief  サービス（バックグラウンドでの GC） @n
+					GC 中は１レコード毎にコピーし、空きが少なくなったら @n
+					有効データの少ないセクターを回収する。@n
+					消去回数の差が大きい場合、変化しないデータを移動する。
+			@return 処理を行った場合「true」
+		*/
+		//-----------------------------------------------------------------//
+		bool service() noexcept
+		{
+			if(gc_sec_ != NONE) {
+				if(!gc_step_()) gc_sec_ = NONE;
+				return true;
+			}
+			for(uint32_t sec = 0; sec < SECTOR_NUM; ++sec) {
+				if(stat_[sec] == STAT::BAD) {
+					uint32_t emax = 0;
+					for(uint32_t i = 0; i < SECTOR_NUM; ++i) {
+						if(ecnt_[i] > emax) emax = ecnt_[i];
+					}
+					erase_sec_(sec, emax);
+					return true;
+				}
+			}
+			if(free_num_() <= GC_LOW) {
+				if(start_gc_(victim_())) return true;
+			}
+			uint32_t emax = 0;
+			uint32_t cold = NONE;
+			for(uint32_t i = 0; i < SECTOR_NUM; ++i) {
+				if(ecnt_[i] > emax) emax = ecnt_[i];
+				if(stat_[i] != STAT::USED || i == head_sec_) continue;
+				if(cold == NONE || ecnt_[i] < ecnt_[cold]) cold = i;
+			}
+			if(cold != NONE && (emax - ecnt_[cold]) > WEAR_DIFF) {
+				return start_gc_(cold);
+			}
 			return false;
 		}
 
 
 		//-----------------------------------------------------------------//
 		/*!
-			@brief  読み込み
-			@param[in]	id		ＩＤ
-			@param[in]	dst		転送先
-			@param[in]	size	サイズ（バイト）
-			@return エラーなら「false」
+			@brief  フリー領域の取得（目安）
+			@return フリー領域（バイト）
 		*/
 		//-----------------------------------------------------------------//
-		bool read(int desc, void* dst, uint32_t size)
+		uint32_t get_free() const noexcept
 		{
-			return false;
+			uint32_t live = 0;
+			for(uint32_t i = 0; i < SECTOR_NUM; ++i) live += live_[i];
+			uint32_t all = (SECTOR_NUM - RESERVE) * CAP;
+			if(live >= all) return 0;
+			return all - live;
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief  キーの数を取得（削除レコードを含む）
+			@return キーの数
+		*/
+		//-----------------------------------------------------------------//
+		uint32_t get_key_num() const noexcept { return num_; }
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief  セクターの消去回数を取得
+			@param[in]	sec	セクター
+			@return 消去回数
+		*/
+		//-----------------------------------------------------------------//
+		uint32_t get_erase_count(uint32_t sec) const noexcept
+		{
+			if(sec >= SECTOR_NUM) return 0;
+			return ecnt_[sec];
 		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief  マウント時に見つかった壊れたレコード数を取得
+			@return 壊れたレコード数
+		*/
+		//-----------------------------------------------------------------//
+		uint32_t get_crc_error() const noexcept { return crc_error_; }
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief  GC の回数を取得
+			@return GC の回数
+		*/
+		//-----------------------------------------------------------------//
+		uint32_t get_gc_count() const noexcept { return gc_count_; }
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief  書き込みエラーの回数を取得
+			@return 書き込みエラーの回数
+		*/
+		//-----------------------------------------------------------------//
+		uint32_t get_write_error() const noexcept { return write_error_; }
 	};
 }
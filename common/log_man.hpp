@@ -2,28 +2,94 @@
 //=====================================================================//
 /*!	@file
 	@brief	ログ・マネージャー・クラス @n
-			・バックアップ可能な、領域を使ったログメモリー
+			・バックアップ可能な、領域を使ったログメモリー @n
+			・レコード（フォーマット ID、タイムスタンプ、引数）単位で記録し、@n
+			  文字列への変換は読み出し時に行う。@n
+			・フォーマット文字列は「log_fmt」セクションに置かれ、ID はセクション先頭 @n
+			  からのオフセットなので、ホスト側では ELF から文字列を得られる（logdec）
     @author 平松邦仁 (hira@rvf-rc45.net)
-	@copyright	Copyright (C) 2017 Kunihito Hiramatsu @n
+	@copyright	Copyright (C) 2017, 2021 Kunihito Hiramatsu @n
 				Released under the MIT license @n
 				https://github.com/hirakuni45/RX/blob/master/LICENSE
 */
 //=====================================================================//
 #include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include "common/format.hpp"
+
+// フォーマット文字列セクションの範囲（リンカーが自動で定義する）
+extern "C" {
+	extern const char __start_log_fmt[] __attribute__((weak));
+	extern const char __stop_log_fmt[] __attribute__((weak));
+}
+
+//-----------------------------------------------------------------//
+/*!
+	@brief  トレース・ログ @n
+			※引数は３２ビットで記録される（double は float に変換）@n
+			※「%s」はポインターを記録するので、ROM 上の文字列に限る
+	@param[in]	log		log_man のインスタンス
+	@param[in]	form	フォーマット（文字列リテラル）
+*/
+//-----------------------------------------------------------------//
+#define LOG_TRACE(log, form, ...) \
+	do { \
+		static const char log_form_[] __attribute__((section("log_fmt"), used)) = form; \
+		(log).trace(log_form_, ##__VA_ARGS__); \
+	} while(0)
 
 namespace utils {
 
+	//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+	/*!
+		@brief  タイムスタンプ無し
+	*/
+	//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+	struct log_null_tick {
+		static uint32_t get_counter() noexcept { return 0; }
+	};
+
+
     //+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
     /*!
-        @brief  log_man クラス
+        @brief  log_man クラス @n
+				レコードの構造：@n
+				+0: ID (2 bytes) log_fmt セクションのオフセット、0xFFFF はテキスト @n
+				+2: LEN (1 byte) 引数（テキスト）のバイト数 @n
+				+3: MARK (1 byte) LEN ^ 0xA5 @n
+				+4: TIME (4 bytes) タイムスタンプ @n
+				+8: 引数（４バイト単位）、又はテキスト
 		@param[in]	MEMIO	メモリー入出力
+		@param[in]	TICK	タイムスタンプ（static get_counter() を持つ事）
     */
     //+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
-	template <class MEMIO>
+	template <class MEMIO, class TICK = log_null_tick>
 	class log_man {
+	public:
+		static const uint32_t ARG_MAX  = 8;		///< 引数の最大数
+		static const uint32_t LINE_MAX = 64;	///< putch のラインバッファ
+		static const uint16_t TEXT_ID  = 0xFFFF;	///< テキスト・レコードの ID
+
+		//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+		/*!
+			@brief  レコード
+		*/
+		//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+		struct record_t {
+			uint16_t	id;
+			uint8_t		len;
+			uint32_t	time;
+			union {
+				uint32_t	arg[64];
+				char		text[256];
+			};
+		};
 
-		static const uint32_t offset_ = 8;
-		static const uint32_t uniq_id_ = 0x1a3c5976;  // 初期化判定ユニークコード
+	private:
+		static const uint32_t uniq_id_ = 0x1a3c5977;  // 初期化判定ユニークコード
+		static const uint32_t head_size_ = 8;
+		static const uint16_t limit_ = MEMIO::SIZE - 8;
 
 		struct area_t {
 			uint32_t	id_;
@@ -33,13 +99,109 @@ namespace utils {
 
 		area_t		area_;
 
+		char		line_[LINE_MAX];
+		uint32_t	line_pos_;
+
+		uint32_t	drop_;
+
+		static uint32_t phys_(uint32_t pos) noexcept
+		{
+			return sizeof(area_t) + (pos % limit_);
+		}
+
+		// リングへの書き込み（末尾で折り返す）
+		static void write_(uint32_t pos, const void* src, uint32_t len) noexcept
+		{
+			pos %= limit_;
+			auto l = limit_ - pos;
+			if(l > len) l = len;
+			MEMIO::copy(src, l, sizeof(area_t) + pos);
+			if(l < len) {
+				MEMIO::copy(static_cast<const uint8_t*>(src) + l, len - l, sizeof(area_t));
+			}
+		}
+
+		static void read_(uint32_t pos, void* dst, uint32_t len) noexcept
+		{
+			pos %= limit_;
+			auto l = limit_ - pos;
+			if(l > len) l = len;
+			MEMIO::copy(sizeof(area_t) + pos, l, dst);
+			if(l < len) {
+				MEMIO::copy(sizeof(area_t), len - l, static_cast<uint8_t*>(dst) + l);
+			}
+		}
+
+		uint32_t top_() const noexcept
+		{
+			return area_.pos_ + limit_ - area_.len_;
+		}
+
+		// 一番古いレコードを捨てる
+		bool drop_one_() noexcept
+		{
+			uint8_t h[4];
+			read_(top_(), h, sizeof(h));
+			uint32_t sz = head_size_ + h[2];
+			if((h[2] ^ 0xA5) != h[3] || sz > area_.len_) {
+				area_.len_ = 0;  // 壊れている場合は全て捨てる
+				return false;
+			}
+			area_.len_ -= sz;
+			++drop_;
+			return true;
+		}
+
+		void commit_(const void* rec, uint32_t sz) noexcept
+		{
+			if((area_.len_ + sz) > limit_) {
+				while((area_.len_ + sz) > limit_) {
+					if(!drop_one_()) break;
+				}
+				// 上書きする前に先頭を確定しておく
+				MEMIO::copy(&area_, sizeof(area_t), 0x0000);
+			}
+			write_(area_.pos_, rec, sz);
+			area_.pos_ = (area_.pos_ + sz) % limit_;
+			area_.len_ += sz;
+			MEMIO::copy(&area_, sizeof(area_t), 0x0000);
+		}
+
+		void put_(uint16_t id, const void* src, uint32_t len) noexcept
+		{
+			uint8_t tmp[head_size_ + 255];
+			tmp[0] = id;
+			tmp[1] = id >> 8;
+			tmp[2] = len;
+			tmp[3] = len ^ 0xA5;
+			uint32_t t = TICK::get_counter();
+			std::memcpy(&tmp[4], &t, 4);
+			std::memcpy(&tmp[head_size_], src, len);
+			commit_(tmp, head_size_ + len);
+		}
+
+		template <typename T>
+		static uint32_t cast_(T v) noexcept
+		{
+			if constexpr (std::is_floating_point<T>::value) {
+				float f = static_cast<float>(v);
+				uint32_t u;
+				std::memcpy(&u, &f, 4);
+				return u;
+			} else if constexpr (std::is_pointer<T>::value) {
+				return static_cast<uint32_t>(reinterpret_cast<uintptr_t>(v));
+			} else {
+				return static_cast<uint32_t>(v);
+			}
+		}
+
 	public:
         //-----------------------------------------------------------------//
         /*!
             @brief  コンストラクター
         */
         //-----------------------------------------------------------------//
-		log_man() noexcept { }
+		log_man() noexcept : area_(), line_{ 0 }, line_pos_(0), drop_(0) { }
 
 
         //-----------------------------------------------------------------//
@@ -52,6 +214,8 @@ namespace utils {
 			area_.id_ = uniq_id_;
 			area_.pos_ = 0;
 			area_.len_ = 0;
+			line_pos_ = 0;
+			drop_ = 0;
 			MEMIO::copy(&area_, sizeof(area_t), 0x0000);
 		}
 
@@ -67,7 +231,7 @@ namespace utils {
 		{
 			MEMIO::start();
 			MEMIO::copy(0x0000, sizeof(area_t), &area_);
-			if(area_.id_ == uniq_id_) {
+			if(area_.id_ == uniq_id_ && area_.pos_ < limit_ && area_.len_ <= limit_) {
 				return true;
 			}
 			clear();
@@ -77,25 +241,52 @@ namespace utils {
 
         //-----------------------------------------------------------------//
         /*!
-            @brief  文字追加
+            @brief  トレース・レコードの追加 @n
+					※通常は「LOG_TRACE」マクロを使う
+			@param[in]	form	フォーマット（log_fmt セクション内）
+			@param[in]	args	引数
+        */
+        //-----------------------------------------------------------------//
+		template <typename... Args>
+		void trace(const char* form, Args... args) noexcept
+		{
+			static_assert(sizeof...(Args) <= ARG_MAX, "Too many trace arguments");
+			// log_fmt セクション外、又は ID がテキストと重なる（64K バイト超え）場合は捨てる
+			if(__start_log_fmt == nullptr || form < __start_log_fmt || form >= __stop_log_fmt
+			  || static_cast<uint32_t>(form - __start_log_fmt) >= TEXT_ID) {
+				++drop_;
+				return;
+			}
+			uint32_t tmp[2 + sizeof...(Args)];
+			uint16_t id = form - __start_log_fmt;
+			uint32_t len = sizeof...(Args) * 4;
+			tmp[0] = id | (len << 16) | ((len ^ 0xA5) << 24);
+			tmp[1] = TICK::get_counter();
+			uint32_t i = 2;
+			((tmp[i++] = cast_(args)), ...);
+			commit_(tmp, sizeof(tmp));
+		}
+
+
+        //-----------------------------------------------------------------//
+        /*!
+            @brief  文字追加 @n
+					※改行、又はラインバッファが一杯でテキスト・レコードにする
 			@param[in]	ch	文字
         */
         //-----------------------------------------------------------------//
 		void putch(char ch) noexcept
 		{
-			MEMIO::put8(sizeof(area_t) + area_.pos_, ch);
-			++area_.pos_;
-			uint16_t limit = MEMIO::SIZE - sizeof(area_t);
-			if(area_.pos_ >= limit) area_.pos_ = 0;
-			++area_.len_;
-			if(area_.len_ > limit) area_.len_ = limit;
-			MEMIO::copy(&area_, sizeof(area_t), 0x0000);
+			line_[line_pos_++] = ch;
+			if(ch == '\n' || line_pos_ >= LINE_MAX) {
+				flush();
+			}
 		}
 
 
         //-----------------------------------------------------------------//
         /*!
-            @brief  文字列追加
+            @brief  文字列追加（１レコード）
 			@param[in]	s	文字列
         */
         //-----------------------------------------------------------------//
@@ -103,18 +294,35 @@ namespace utils {
 		{
 			if(s == nullptr) return;
 
-			char ch;
-			while((ch = *s) != 0) {
-				putch(ch);
-				++s;
+			flush();
+			auto len = std::strlen(s);
+			while(len > 0) {
+				auto l = len;
+				if(l > 255) l = 255;
+				put_(TEXT_ID, s, l);
+				s += l;
+				len -= l;
 			}
 		}
 
 
+        //-----------------------------------------------------------------//
+        /*!
+            @brief  ラインバッファをテキスト・レコードにする
+        */
+        //-----------------------------------------------------------------//
+		void flush() noexcept
+		{
+			if(line_pos_ == 0) return;
+			put_(TEXT_ID, line_, line_pos_);
+			line_pos_ = 0;
+		}
+
+
         //-----------------------------------------------------------------//
         /*!
             @brief  記録長の取得
-			@return 記録長
+			@return 記録長（バイト）
         */
         //-----------------------------------------------------------------//
 		uint16_t get_length() const noexcept { return area_.len_; }
@@ -122,22 +330,137 @@ namespace utils {
 
         //-----------------------------------------------------------------//
         /*!
-            @brief  文字の取得
-			@param[in]	pos	取得位置
-			@return 文字
+            @brief  捨てたレコード数の取得（start 以降）
+			@return 捨てたレコード数
+        */
+        //-----------------------------------------------------------------//
+		uint32_t get_drop() const noexcept { return drop_; }
+
+
+        //-----------------------------------------------------------------//
+        /*!
+            @brief  レコードの取得
+			@param[in,out]	ofs	記録の先頭からの位置（次のレコードへ進む）
+			@param[out]		rec	レコード
+			@return レコードが無い、壊れている場合「false」
         */
         //-----------------------------------------------------------------//
-		char getch(uint16_t pos) const noexcept
+		bool get_record(uint16_t& ofs, record_t& rec) const noexcept
 		{
-			if(area_.len_ == 0) return 0;
+			if((ofs + head_size_) > area_.len_) return false;
 
-			pos += area_.pos_ - area_.len_;
-			pos %= MEMIO::SIZE - sizeof(area_t);
-			uint8_t data;
-			if(MEMIO::get8(pos + sizeof(area_t), data)) {
-				return static_cast<char>(data);
-			} else {
-				return 0;
+			auto pos = top_() + ofs;
+			uint8_t h[head_size_];
+			read_(pos, h, head_size_);
+			if((h[2] ^ 0xA5) != h[3]) return false;
+			uint32_t sz = head_size_ + h[2];
+			if((ofs + sz) > area_.len_) return false;
+
+			rec.id = h[0] | (h[1] << 8);
+			rec.len = h[2];
+			std::memcpy(&rec.time, &h[4], 4);
+			read_(pos + head_size_, rec.text, rec.len);
+			if(rec.id == TEXT_ID) rec.text[rec.len] = 0;
+			ofs += sz;
+			return true;
+		}
+
+
+        //-----------------------------------------------------------------//
+        /*!
+            @brief  レコードのフォーマットを取得
+			@param[in]	rec	レコード
+			@return フォーマット（テキスト・レコードは nullptr）
+        */
+        //-----------------------------------------------------------------//
+		static const char* get_format(const record_t& rec) noexcept
+		{
+			if(rec.id == TEXT_ID || __start_log_fmt == nullptr) return nullptr;
+			if(rec.id >= (__stop_log_fmt - __start_log_fmt)) return nullptr;
+			return __start_log_fmt + rec.id;
+		}
+
+
+        //-----------------------------------------------------------------//
+        /*!
+            @brief  フォーマットに従い、引数を型変換して適用する
+			@param[in]	form	get_format で取得したフォーマットで初期化したもの
+			@param[in]	rec		レコード
+        */
+        //-----------------------------------------------------------------//
+		template <class FORM>
+		static void apply(FORM& form, const record_t& rec) noexcept
+		{
+			auto p = get_format(rec);
+			if(p == nullptr) return;
+			uint32_t n = 0;
+			uint32_t num = rec.len / 4;
+			char ch;
+			while((ch = *p++) != 0 && n < num) {
+				if(ch != '%') continue;
+				while((ch = *p) != 0) {
+					++p;
+					if(ch == '%') break;
+					auto v = rec.arg[n];
+					if(ch == 'd' || ch == 'i' || ch == 'c') {
+						form % static_cast<int32_t>(v);
+					} else if(ch == 'u' || ch == 'x' || ch == 'X' || ch == 'o' || ch == 'b' || ch == 'y') {
+						form % v;
+					} else if(ch == 's' || ch == 'p') {
+						form % reinterpret_cast<const char*>(static_cast<uintptr_t>(v));
+					} else if(ch == 'f' || ch == 'F' || ch == 'e' || ch == 'E' || ch == 'g' || ch == 'G') {
+						float f;
+						std::memcpy(&f, &v, 4);
+						form % f;
+					} else {
+						continue;
+					}
+					++n;
+					break;
+				}
+			}
+		}
+
+
+        //-----------------------------------------------------------------//
+        /*!
+            @brief  全レコードの表示
+			@param[in]	dump	「true」の場合、ホスト・デコーダー（logdec）用に @n
+								レコードを１６進で出力
+        */
+        //-----------------------------------------------------------------//
+		template <class FORM = utils::format>
+		void list(bool dump = false) const noexcept
+		{
+			uint16_t ofs = 0;
+			record_t rec;
+			while(1) {
+				auto org = ofs;
+				if(!get_record(ofs, rec)) break;
+				if(dump) {
+					FORM("#");
+					uint8_t tmp[head_size_ + 255];
+					read_(top_() + org, tmp, ofs - org);
+					for(uint32_t i = 0; i < static_cast<uint32_t>(ofs - org); ++i) {
+						FORM("%02X") % static_cast<uint32_t>(tmp[i]);
+					}
+					FORM("\n");
+					continue;
+				}
+				FORM("%10u: ") % rec.time;
+				if(rec.id == TEXT_ID) {
+					FORM("%s") % rec.text;
+					if(rec.len == 0 || rec.text[rec.len - 1] != '\n') FORM("\n");
+				} else {
+					auto p = get_format(rec);
+					if(p == nullptr) {
+						FORM("(ID: %04X)\n") % rec.id;
+						continue;
+					}
+					FORM form(p);
+					apply(form, rec);
+					FORM("\n");
+				}
 			}
 		}
 	};
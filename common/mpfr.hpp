@@ -2,18 +2,312 @@
 //=============================================================================//
 /*! @file
     @brief  mpfr ラッパークラス @n
-			GNU gmp, mpfr の C++ ラッパー
+			GNU gmp, mpfr の C++ ラッパー @n
+			・四則演算は式テンプレートで、代入先へ直接評価する。@n
+			  「a * b + c」は mpfr_fma １回となり、一時オブジェクトを作らない。@n
+			  ※式（expr）はオペランドの value を参照で保持する。「auto x = a + b;」の x は @n
+			  value では無く、a、b（一時オブジェクトも）より長く使えないので、value で受ける事 @n
+			・整数、浮動小数点との四則演算（「a + 1」等）は、mpfr_add_si 等で行い value を返す。@n
+			・limb_pool を使うと、limb 領域を固定ブロックから割り当てる。
     @author 平松邦仁 (hira@rvf-rc45.net)
-	@copyright	Copyright (C) 2020 Kunihito Hiramatsu @n
+	@copyright	Copyright (C) 2020, 2021 Kunihito Hiramatsu @n
 				Released under the MIT license @n
 				https://github.com/hirakuni45/RX/blob/master/LICENSE
 */
 //=============================================================================//
 #include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <type_traits>
 #include <mpfr.h>
+#include "common/fixed_block.hpp"
 
 namespace mpfr {
 
+	//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+	/*!
+		@brief  精度（ビット数）から、mpfr が確保する limb 領域のバイト数を求める
+		@param[in]	num		精度
+	*/
+	//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+	template <uint32_t num>
+	struct limb_size {
+		// mpfr_init2 は、limb 配列の前に確保サイズ（mp_size_t）を置く
+		static const uint32_t value = ((num + GMP_NUMB_BITS - 1) / GMP_NUMB_BITS) * sizeof(mp_limb_t)
+			+ sizeof(mp_size_t);
+	};
+
+
+	//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+	/*!
+		@brief  limb プール @n
+				mp_set_memory_functions で GMP/MPFR のメモリー管理を置き換え、@n
+				UNIT バイト以下の要求を固定ブロックから割り当てる。@n
+				UNIT を超える要求、プールが満杯の場合は、ヒープを使う。@n
+				※他のオブジェクトより先に構築する事（それ以前にヒープから確保された @n
+				領域も、正しく開放される）
+		@param[in]	UNIT	ブロックのバイト数（limb_size<num>::value 等）
+		@param[in]	BANK	バンク数（１バンク３２ブロック）
+	*/
+	//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+	template <uint32_t UNIT, uint32_t BANK = 2>
+	class limb_pool {
+
+		static const uint32_t BLOCK_NUM = 32;
+
+		struct unit_t {
+			mp_limb_t	body_[(UNIT + sizeof(mp_limb_t) - 1) / sizeof(mp_limb_t)];
+		};
+		typedef utils::fixed_block<unit_t, BLOCK_NUM> BLOCK;
+
+		static BLOCK	block_[BANK];
+
+		static uint32_t	alloc_count_;
+		static uint32_t	heap_count_;
+		static uint32_t	used_;
+		static uint32_t	peak_;
+
+		static bool find_(const void* ptr, uint32_t& bank, uint32_t& idx) noexcept
+		{
+			auto p = reinterpret_cast<uintptr_t>(ptr);
+			for(uint32_t i = 0; i < BANK; ++i) {
+				auto org = reinterpret_cast<uintptr_t>(&block_[i].at(0));
+				if(p >= org && p < (org + sizeof(unit_t) * BLOCK_NUM)) {
+					bank = i;
+					idx = (p - org) / sizeof(unit_t);
+					return true;
+				}
+			}
+			return false;
+		}
+
+		static void* pool_alloc_() noexcept
+		{
+			for(uint32_t i = 0; i < BANK; ++i) {
+				auto idx = block_[i].alloc();
+				if(idx < BLOCK_NUM) {
+					block_[i].unlock(idx);
+					++used_;
+					if(peak_ < used_) peak_ = used_;
+					return &block_[i].at(idx);
+				}
+			}
+			return nullptr;
+		}
+
+		static void* alloc_(size_t size)
+		{
+			++alloc_count_;
+			if(size <= sizeof(unit_t)) {
+				auto p = pool_alloc_();
+				if(p != nullptr) return p;
+			}
+			++heap_count_;
+			return std::malloc(size);
+		}
+
+		static void free_(void* ptr, size_t)
+		{
+			uint32_t bank;
+			uint32_t idx;
+			if(find_(ptr, bank, idx)) {
+				block_[bank].erase(idx);
+				--used_;
+			} else {
+				std::free(ptr);
+			}
+		}
+
+		static void* realloc_(void* ptr, size_t old_size, size_t new_size)
+		{
+			uint32_t bank;
+			uint32_t idx;
+			bool pool = find_(ptr, bank, idx);
+			if(pool && new_size <= sizeof(unit_t)) {
+				return ptr;
+			}
+			if(!pool && new_size > sizeof(unit_t)) {
+				++heap_count_;
+				return std::realloc(ptr, new_size);
+			}
+			auto p = alloc_(new_size);
+			if(p != nullptr) {
+				std::memcpy(p, ptr, old_size < new_size ? old_size : new_size);
+				free_(ptr, old_size);
+			}
+			return p;
+		}
+
+	public:
+		//-----------------------------------------------------------------//
+		/*!
+			@brief  コンストラクター（メモリー管理関数を登録する）
+		*/
+		//-----------------------------------------------------------------//
+		limb_pool() noexcept { start(); }
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief  メモリー管理関数を登録
+		*/
+		//-----------------------------------------------------------------//
+		static void start() noexcept
+		{
+			mp_set_memory_functions(alloc_, realloc_, free_);
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief  確保要求回数を取得
+			@return 確保要求回数
+		*/
+		//-----------------------------------------------------------------//
+		static uint32_t get_alloc_count() noexcept { return alloc_count_; }
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief  ヒープを使った回数を取得
+			@return ヒープを使った回数
+		*/
+		//-----------------------------------------------------------------//
+		static uint32_t get_heap_count() noexcept { return heap_count_; }
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief  使用中のブロック数を取得
+			@return 使用中のブロック数
+		*/
+		//-----------------------------------------------------------------//
+		static uint32_t get_used() noexcept { return used_; }
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief  使用ブロック数の最大値を取得
+			@return 使用ブロック数の最大値
+		*/
+		//-----------------------------------------------------------------//
+		static uint32_t get_peak() noexcept { return peak_; }
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief  ブロック総数を取得
+			@return ブロック総数
+		*/
+		//-----------------------------------------------------------------//
+		static uint32_t capacity() noexcept { return BANK * BLOCK_NUM; }
+	};
+
+	template <uint32_t UNIT, uint32_t BANK>
+		typename limb_pool<UNIT, BANK>::BLOCK limb_pool<UNIT, BANK>::block_[BANK];
+	template <uint32_t UNIT, uint32_t BANK> uint32_t limb_pool<UNIT, BANK>::alloc_count_;
+	template <uint32_t UNIT, uint32_t BANK> uint32_t limb_pool<UNIT, BANK>::heap_count_;
+	template <uint32_t UNIT, uint32_t BANK> uint32_t limb_pool<UNIT, BANK>::used_;
+	template <uint32_t UNIT, uint32_t BANK> uint32_t limb_pool<UNIT, BANK>::peak_;
+
+
+	//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+	/*!
+		@brief  式テンプレートの演算子
+	*/
+	//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+	struct op_add {
+		static void apply(mpfr_ptr d, mpfr_srcptr a, mpfr_srcptr b, mpfr_rnd_t rnd) noexcept {
+			mpfr_add(d, a, b, rnd);
+		}
+	};
+	struct op_sub {
+		static void apply(mpfr_ptr d, mpfr_srcptr a, mpfr_srcptr b, mpfr_rnd_t rnd) noexcept {
+			mpfr_sub(d, a, b, rnd);
+		}
+	};
+	struct op_mul {
+		static void apply(mpfr_ptr d, mpfr_srcptr a, mpfr_srcptr b, mpfr_rnd_t rnd) noexcept {
+			mpfr_mul(d, a, b, rnd);
+		}
+	};
+	struct op_div {
+		static void apply(mpfr_ptr d, mpfr_srcptr a, mpfr_srcptr b, mpfr_rnd_t rnd) noexcept {
+			mpfr_div(d, a, b, rnd);
+		}
+	};
+
+
+	//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+	/*!
+		@brief  式テンプレート（二項演算） @n
+				オペランドの参照を保持し、value への代入時に評価する
+		@param[in]	OP	演算子
+		@param[in]	L	左辺（value、又は expr）
+		@param[in]	R	右辺（value、又は expr）
+	*/
+	//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+	template <uint32_t num> class value;
+	template <class OP, class L, class R> struct expr;
+
+	// 式のオペランドの保持：value は参照、式（一時オブジェクト）は値で持つ
+	template <class T> struct operand_hold { typedef const T& type; };
+	template <class OP, class L, class R> struct operand_hold<expr<OP, L, R> > { typedef const expr<OP, L, R> type; };
+
+	template <class OP, class L, class R>
+	struct expr {
+		static_assert(L::NUM == R::NUM, "mpfr::expr: precision mismatch");
+		static const uint32_t NUM = L::NUM;
+		typename operand_hold<L>::type	l_;
+		typename operand_hold<R>::type	r_;
+		expr(const L& l, const R& r) noexcept : l_(l), r_(r) { }
+	};
+
+	template <class T> struct is_operand : std::false_type { };
+	template <uint32_t num> struct is_operand<value<num> > : std::true_type { };
+	template <class OP, class L, class R> struct is_operand<expr<OP, L, R> > : std::true_type { };
+
+
+	//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+	/*!
+		@brief  スカラーとの演算（符号付き整数は si、符号無し整数は ui、@n
+				浮動小数点は d の関数を使う）
+	*/
+	//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+	struct scalar {
+		template <class T>
+		using type = typename std::conditional<std::is_integral<T>::value,
+			typename std::conditional<std::is_signed<T>::value, long, unsigned long>::type, double>::type;
+
+		static void set(mpfr_ptr d, long v, mpfr_rnd_t rnd) noexcept { mpfr_set_si(d, v, rnd); }
+		static void set(mpfr_ptr d, unsigned long v, mpfr_rnd_t rnd) noexcept { mpfr_set_ui(d, v, rnd); }
+		static void set(mpfr_ptr d, double v, mpfr_rnd_t rnd) noexcept { mpfr_set_d(d, v, rnd); }
+
+		static void add(mpfr_ptr d, mpfr_srcptr a, long v, mpfr_rnd_t rnd) noexcept { mpfr_add_si(d, a, v, rnd); }
+		static void add(mpfr_ptr d, mpfr_srcptr a, unsigned long v, mpfr_rnd_t rnd) noexcept { mpfr_add_ui(d, a, v, rnd); }
+		static void add(mpfr_ptr d, mpfr_srcptr a, double v, mpfr_rnd_t rnd) noexcept { mpfr_add_d(d, a, v, rnd); }
+
+		static void sub(mpfr_ptr d, mpfr_srcptr a, long v, mpfr_rnd_t rnd) noexcept { mpfr_sub_si(d, a, v, rnd); }
+		static void sub(mpfr_ptr d, mpfr_srcptr a, unsigned long v, mpfr_rnd_t rnd) noexcept { mpfr_sub_ui(d, a, v, rnd); }
+		static void sub(mpfr_ptr d, mpfr_srcptr a, double v, mpfr_rnd_t rnd) noexcept { mpfr_sub_d(d, a, v, rnd); }
+
+		static void sub(mpfr_ptr d, long v, mpfr_srcptr a, mpfr_rnd_t rnd) noexcept { mpfr_si_sub(d, v, a, rnd); }
+		static void sub(mpfr_ptr d, unsigned long v, mpfr_srcptr a, mpfr_rnd_t rnd) noexcept { mpfr_ui_sub(d, v, a, rnd); }
+		static void sub(mpfr_ptr d, double v, mpfr_srcptr a, mpfr_rnd_t rnd) noexcept { mpfr_d_sub(d, v, a, rnd); }
+
+		static void mul(mpfr_ptr d, mpfr_srcptr a, long v, mpfr_rnd_t rnd) noexcept { mpfr_mul_si(d, a, v, rnd); }
+		static void mul(mpfr_ptr d, mpfr_srcptr a, unsigned long v, mpfr_rnd_t rnd) noexcept { mpfr_mul_ui(d, a, v, rnd); }
+		static void mul(mpfr_ptr d, mpfr_srcptr a, double v, mpfr_rnd_t rnd) noexcept { mpfr_mul_d(d, a, v, rnd); }
+
+		static void div(mpfr_ptr d, mpfr_srcptr a, long v, mpfr_rnd_t rnd) noexcept { mpfr_div_si(d, a, v, rnd); }
+		static void div(mpfr_ptr d, mpfr_srcptr a, unsigned long v, mpfr_rnd_t rnd) noexcept { mpfr_div_ui(d, a, v, rnd); }
+		static void div(mpfr_ptr d, mpfr_srcptr a, double v, mpfr_rnd_t rnd) noexcept { mpfr_div_d(d, a, v, rnd); }
+
+		static void div(mpfr_ptr d, long v, mpfr_srcptr a, mpfr_rnd_t rnd) noexcept { mpfr_si_div(d, v, a, rnd); }
+		static void div(mpfr_ptr d, unsigned long v, mpfr_srcptr a, mpfr_rnd_t rnd) noexcept { mpfr_ui_div(d, v, a, rnd); }
+		static void div(mpfr_ptr d, double v, mpfr_srcptr a, mpfr_rnd_t rnd) noexcept { mpfr_d_div(d, v, a, rnd); }
+	};
+
 	//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
 	/*!
 		@brief  mpfr オブジェクト
@@ -29,6 +323,8 @@ namespace mpfr {
 		static uint32_t ref_count_;
 
 	public:
+		static const uint32_t NUM = num;	///< 精度
+
 		//-----------------------------------------------------------------//
 		/*!
 			@brief  コンストラクター
@@ -55,6 +351,21 @@ namespace mpfr {
 		}
 
 
+		//-----------------------------------------------------------------//
+		/*!
+			@brief  コンストラクター（式の評価）
+			@param[in]	e	式
+			@param[in]	rnd	丸めパラメータ
+		*/
+		//-----------------------------------------------------------------//
+		template <class OP, class L, class R>
+		value(const expr<OP, L, R>& e, mpfr_rnd_t rnd = MPFR_RNDN) noexcept : rnd_(rnd) {
+			mpfr_init2(t_, num);
+			eval(t_, e, rnd_);
+			++ref_count_;
+		}
+
+
 		//-----------------------------------------------------------------//
 		/*!
 			@brief  コンストラクター(int)
@@ -134,6 +445,15 @@ namespace mpfr {
 		mpfr_ptr get() noexcept { return t_; }
 
 
+		//-----------------------------------------------------------------//
+		/*!
+			@brief  mpfr_srcptr を取得
+			@return mpfr_srcptr
+		*/
+		//-----------------------------------------------------------------//
+		mpfr_srcptr get() const noexcept { return t_; }
+
+
 		//-----------------------------------------------------------------//
 		/*!
 			@brief  mpfr_rnd_t を取得
@@ -273,17 +593,19 @@ namespace mpfr {
 			mpfr_set(t_, th.t_, rnd_);
 			return *this;
 		}
-		value& operator = (long v) noexcept {
-			mpfr_set_si(t_, v, rnd_);
+		template <class T, class = typename std::enable_if<std::is_arithmetic<T>::value>::type>
+		value& operator = (T v) noexcept {
+			scalar::set(t_, static_cast<scalar::type<T> >(v), rnd_);
 			return *this;
-		}	
-		value& operator = (double v) noexcept {
-			mpfr_set_d(t_, v, rnd_);
+		}
+		template <class OP, class L, class R>
+		value& operator = (const expr<OP, L, R>& e) noexcept {
+			eval(t_, e, rnd_);
 			return *this;
 		}
 
 
-		const value operator - () noexcept
+		const value operator - () const noexcept
 		{
 			value tmp(*this);
 			mpfr_neg(tmp.t_, tmp.t_, rnd_);
@@ -315,10 +637,38 @@ namespace mpfr {
 			return *this;
 		}
 
-		value operator + (const value& th) const noexcept { return value(*this) += th; }
-		value operator - (const value& th) const noexcept { return value(*this) -= th; }
-		value operator * (const value& th) const noexcept { return value(*this) *= th; }
-		value operator / (const value& th) const noexcept { return value(*this) /= th; }
+		// 整数、浮動小数点（int、unsigned、float 等も曖昧にならない）
+		template <class T, class = typename std::enable_if<std::is_arithmetic<T>::value>::type>
+		value& operator += (T v) noexcept { scalar::add(t_, t_, static_cast<scalar::type<T> >(v), rnd_); return *this; }
+		template <class T, class = typename std::enable_if<std::is_arithmetic<T>::value>::type>
+		value& operator -= (T v) noexcept { scalar::sub(t_, t_, static_cast<scalar::type<T> >(v), rnd_); return *this; }
+		template <class T, class = typename std::enable_if<std::is_arithmetic<T>::value>::type>
+		value& operator *= (T v) noexcept { scalar::mul(t_, t_, static_cast<scalar::type<T> >(v), rnd_); return *this; }
+		template <class T, class = typename std::enable_if<std::is_arithmetic<T>::value>::type>
+		value& operator /= (T v) noexcept { scalar::div(t_, t_, static_cast<scalar::type<T> >(v), rnd_); return *this; }
+
+		// this += a * b、this -= a * b は、mpfr_fma、mpfr_fms １回で行う
+		value& operator += (const expr<op_mul, value, value>& e) noexcept
+		{
+			mpfr_fma(t_, e.l_.t_, e.r_.t_, t_, rnd_);
+			return *this;
+		}
+
+		value& operator -= (const expr<op_mul, value, value>& e) noexcept
+		{
+			mpfr_fms(t_, e.l_.t_, e.r_.t_, t_, rnd_);
+			mpfr_neg(t_, t_, rnd_);
+			return *this;
+		}
+
+		template <class OP, class L, class R>
+		value& operator += (const expr<OP, L, R>& e) noexcept { return *this += value(e, rnd_); }
+		template <class OP, class L, class R>
+		value& operator -= (const expr<OP, L, R>& e) noexcept { return *this -= value(e, rnd_); }
+		template <class OP, class L, class R>
+		value& operator *= (const expr<OP, L, R>& e) noexcept { return *this *= value(e, rnd_); }
+		template <class OP, class L, class R>
+		value& operator /= (const expr<OP, L, R>& e) noexcept { return *this /= value(e, rnd_); }
 
 
 		//-----------------------------------------------------------------//
@@ -470,4 +820,139 @@ namespace mpfr {
 
 	// テンプレート関数、実態の定義
 	template<uint32_t num> uint32_t value<num>::ref_count_;
+
+
+	// 式の葉（value）なら mpfr_srcptr、式なら nullptr
+	template <uint32_t num>
+	inline mpfr_srcptr leaf(const value<num>& v) noexcept { return v.get(); }
+	template <class OP, class L, class R>
+	inline mpfr_srcptr leaf(const expr<OP, L, R>&) noexcept { return nullptr; }
+
+
+	//-----------------------------------------------------------------//
+	/*!
+		@brief  式の評価 @n
+				代入先 d を作業領域として使い、一時オブジェクトは、@n
+				右辺が式で、左辺が d と重なる場合だけ作る。
+		@param[out]	d	代入先
+		@param[in]	e	式
+		@param[in]	rnd	丸めパラメータ
+	*/
+	//-----------------------------------------------------------------//
+	template <uint32_t num>
+	inline void eval(mpfr_ptr d, const value<num>& v, mpfr_rnd_t rnd) noexcept
+	{
+		if(d != v.get()) mpfr_set(d, v.get(), rnd);
+	}
+
+
+	// a * b + c
+	template <uint32_t num>
+	inline void eval(mpfr_ptr d, const expr<op_add, expr<op_mul, value<num>, value<num> >, value<num> >& e,
+		mpfr_rnd_t rnd) noexcept
+	{
+		mpfr_fma(d, e.l_.l_.get(), e.l_.r_.get(), e.r_.get(), rnd);
+	}
+
+
+	// c + a * b
+	template <uint32_t num>
+	inline void eval(mpfr_ptr d, const expr<op_add, value<num>, expr<op_mul, value<num>, value<num> > >& e,
+		mpfr_rnd_t rnd) noexcept
+	{
+		mpfr_fma(d, e.r_.l_.get(), e.r_.r_.get(), e.l_.get(), rnd);
+	}
+
+
+	// a * b - c
+	template <uint32_t num>
+	inline void eval(mpfr_ptr d, const expr<op_sub, expr<op_mul, value<num>, value<num> >, value<num> >& e,
+		mpfr_rnd_t rnd) noexcept
+	{
+		mpfr_fms(d, e.l_.l_.get(), e.l_.r_.get(), e.r_.get(), rnd);
+	}
+
+
+	template <class OP, class L, class R>
+	inline void eval(mpfr_ptr d, const expr<OP, L, R>& e, mpfr_rnd_t rnd) noexcept
+	{
+		auto l = leaf(e.l_);
+		auto r = leaf(e.r_);
+		if(l != nullptr && r != nullptr) {
+			OP::apply(d, l, r, rnd);
+		} else if(r != nullptr && r != d) {
+			eval(d, e.l_, rnd);
+			OP::apply(d, d, r, rnd);
+		} else if(l != nullptr && l != d) {
+			eval(d, e.r_, rnd);
+			OP::apply(d, l, d, rnd);
+		} else {
+			value<expr<OP, L, R>::NUM> tmp(rnd);
+			eval(tmp.get(), e.r_, rnd);
+			eval(d, e.l_, rnd);
+			OP::apply(d, d, tmp.get(), rnd);
+		}
+	}
+
+
+	template <class L, class R, class = typename std::enable_if<is_operand<L>::value && is_operand<R>::value>::type>
+	inline expr<op_add, L, R> operator + (const L& l, const R& r) noexcept { return expr<op_add, L, R>(l, r); }
+
+	template <class L, class R, class = typename std::enable_if<is_operand<L>::value && is_operand<R>::value>::type>
+	inline expr<op_sub, L, R> operator - (const L& l, const R& r) noexcept { return expr<op_sub, L, R>(l, r); }
+
+	template <class L, class R, class = typename std::enable_if<is_operand<L>::value && is_operand<R>::value>::type>
+	inline expr<op_mul, L, R> operator * (const L& l, const R& r) noexcept { return expr<op_mul, L, R>(l, r); }
+
+	template <class L, class R, class = typename std::enable_if<is_operand<L>::value && is_operand<R>::value>::type>
+	inline expr<op_div, L, R> operator / (const L& l, const R& r) noexcept { return expr<op_div, L, R>(l, r); }
+
+
+	// スカラーとの演算は、value（式は評価して）に mpfr_add_si 等を行う
+	template <class L, class T>
+	using if_scalar = typename std::enable_if<is_operand<L>::value && std::is_arithmetic<T>::value, value<L::NUM> >::type;
+
+	template <class L, class T>
+	inline if_scalar<L, T> operator + (const L& l, T v) noexcept {
+		value<L::NUM> t(l);
+		scalar::add(t.get(), t.get(), static_cast<scalar::type<T> >(v), t.get_rnd());
+		return t;
+	}
+	template <class T, class R>
+	inline if_scalar<R, T> operator + (T v, const R& r) noexcept { return r + v; }
+
+	template <class L, class T>
+	inline if_scalar<L, T> operator - (const L& l, T v) noexcept {
+		value<L::NUM> t(l);
+		scalar::sub(t.get(), t.get(), static_cast<scalar::type<T> >(v), t.get_rnd());
+		return t;
+	}
+	template <class T, class R>
+	inline if_scalar<R, T> operator - (T v, const R& r) noexcept {
+		value<R::NUM> t(r);
+		scalar::sub(t.get(), static_cast<scalar::type<T> >(v), t.get(), t.get_rnd());
+		return t;
+	}
+
+	template <class L, class T>
+	inline if_scalar<L, T> operator * (const L& l, T v) noexcept {
+		value<L::NUM> t(l);
+		scalar::mul(t.get(), t.get(), static_cast<scalar::type<T> >(v), t.get_rnd());
+		return t;
+	}
+	template <class T, class R>
+	inline if_scalar<R, T> operator * (T v, const R& r) noexcept { return r * v; }
+
+	template <class L, class T>
+	inline if_scalar<L, T> operator / (const L& l, T v) noexcept {
+		value<L::NUM> t(l);
+		scalar::div(t.get(), t.get(), static_cast<scalar::type<T> >(v), t.get_rnd());
+		return t;
+	}
+	template <class T, class R>
+	inline if_scalar<R, T> operator / (T v, const R& r) noexcept {
+		value<R::NUM> t(r);
+		scalar::div(t.get(), static_cast<scalar::type<T> >(v), t.get(), t.get_rnd());
+		return t;
+	}
 }
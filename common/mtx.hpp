@@ -128,6 +128,39 @@ namespace mtx {
 	}
 
 
+	//-----------------------------------------------------------------//
+	/*!
+		@brief	OpenGL ４×４マトリックスと複数ベクターの積 (mat * vec[n] -> out[n]) @n
+				マトリックスの要素をレジスタに保持して、頂点を連続で変換する。@n
+				ベクターは x, y, z, w の並びで、out と vec は同じでも良い。
+		@param[out]	out		出力ベクター列
+		@param[in]	mat		入力マトリックス
+		@param[in]	vec		入力ベクター列
+		@param[in]	num		ベクター数
+	 */
+	//-----------------------------------------------------------------//
+	template <class T>
+	void matmul1n(T* out, const T* mat, const T* vec, uint32_t num) noexcept
+	{
+		const T m0  = mat[0],  m1  = mat[1],  m2  = mat[2],  m3  = mat[3];
+		const T m4  = mat[4],  m5  = mat[5],  m6  = mat[6],  m7  = mat[7];
+		const T m8  = mat[8],  m9  = mat[9],  m10 = mat[10], m11 = mat[11];
+		const T m12 = mat[12], m13 = mat[13], m14 = mat[14], m15 = mat[15];
+		for(uint32_t i = 0; i < num; ++i) {
+			const T x = vec[0];
+			const T y = vec[1];
+			const T z = vec[2];
+			const T w = vec[3];
+			out[0] = m0 * x + m4 * y + m8  * z + m12 * w;
+			out[1] = m1 * x + m5 * y + m9  * z + m13 * w;
+			out[2] = m2 * x + m6 * y + m10 * z + m14 * w;
+			out[3] = m3 * x + m7 * y + m11 * z + m15 * w;
+			vec += 4;
+			out += 4;
+		}
+	}
+
+
 	//-----------------------------------------------------------------//
 	/*!
 		@brief	OpenGL スケール（拡大／縮小）行列をベースマトリックスに合成する
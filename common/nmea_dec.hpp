@@ -5,7 +5,7 @@
 			for GTPA013 @n
 			初期ボーレートは９６００で行う。
     @author 平松邦仁 (hira@rvf-rc45.net)
-	@copyright	Copyright (C) 2016, 2019 Kunihito Hiramatsu @n
+	@copyright	Copyright (C) 2016, 2021 Kunihito Hiramatsu @n
 				Released under the MIT license @n
 				https://github.com/hirakuni45/RX/blob/master/LICENSE
 */
@@ -15,12 +15,15 @@
 #include "common/time.h"
 #include "common/format.hpp"
 #include "common/input.hpp"
+#include "common/nmea_parse.hpp"
 
 namespace utils {
 
 	//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
 	/*!
-		@brief  NMEA デコード・クラス
+		@brief  NMEA デコード・クラス @n
+				受信データは nmea_parse で逐次解析され、文字列バッファを持たない。@n
+				文字列を返す API は、互換の為、呼ばれた時に数値から生成する。
 		@param[in]	SCI_IO	シリアルＩ／Ｏ
 	*/
 	//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
@@ -31,53 +34,25 @@ namespace utils {
 		static const uint32_t UPDATE_FAST_RATE = 10;	///< 10Hz
 
 	public:
-		static const uint32_t SINFO_MAX = 14;		///< 衛星情報の最大数
+		static const uint32_t SINFO_MAX = nmea_parse::SINFO_MAX;	///< 衛星情報の最大数
 
-		//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
-		/*!
-			@brief  衛星パラメーター
-		*/
-		//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
-		struct sat_info {
-			char	no_[4] ;  		///< 衛星番号
-			char	elv_[4];	///< 衛星仰角(Elevation)、０～９０度
-			char	azi_[4];	///< 衛星方位角(Azimuth)、０～３５９度
-			char	cn_[4];		///< キャリア／ノイズ比、０～９９dB
-
-			sat_info() {
-				no_[0] = 0;
-				elv_[0] = 0;
-				azi_[0] = 0;
-				cn_[0] = 0;
-			}
-		};
+		typedef nmea_parse::fix_t fix_t;
+		typedef nmea_parse::sat_info sat_info;
 
 	private:
 		SCI_IO&		sci_;
 
 		uint16_t	sci_errc_;
 
-		uint16_t	pos_;
-		char		line_[256];
-
-		char		time_[12];  // 時間
-		char		lat_[12];   // 緯度(latitude)
-		char		ns_[2];     // 北緯、南緯
-		char		lon_[12];   // 経度(longitude)
-		char		ew_[2];     // 東経、西経
-		char		q_[2];      // 品質
-		char		satellite_[4];  // 衛星数
-		char		hq_[4];		// 水平精度低下率
-		char		alt_[6];	// 海抜高度(Altitude above sea level)
-		char		alt_unit_[2];	// 海抜高度単位
-
-		char		date_[8];   // 日付
-
-		uint16_t	sidx_;
-		sat_info	sinfo_[SINFO_MAX];	// 衛星情報
+		nmea_parse	parse_;
 
-		uint32_t	id_;
-		uint32_t	iid_;
+		mutable char	time_[12];
+		mutable char	date_[8];
+		mutable char	lat_[14];
+		mutable char	lon_[14];
+		mutable char	q_[4];
+		mutable char	hq_[8];
+		mutable char	alt_[12];
 
 		uint16_t	intr_;
 		uint16_t	update_real_rate_;
@@ -86,115 +61,6 @@ namespace utils {
 		uint32_t	baud_real_rate_;
 		uint32_t	baud_fast_rate_;
 
-		static uint16_t word_(const char* src)
-		{
-			const char* top = src;
-			char ch;
-			while((ch = *src++) != 0) {
-				if(ch == ',' || ch == '*') return src - top;
-			}
-			return 0;
-		}
-
-		static void copy_word_(char* dst, const char* src, uint16_t len)
-		{
-			std::strncpy(dst, src, len);
-			dst[len] = 0;
-		}
-
-
-		static int32_t get_dec_(const char* t, uint16_t n = 0)
-		{
-			int32_t val = 0;
-			char ch;
-			while((ch = *t++) != 0) {
-				if('0' <= ch && ch <= '9') {
-					val *= 10;
-					val += ch - '0';
-				} else {
-					break;
-				}
-				if(n > 0) {
-					--n;
-					if(n == 0) break;
-				}
-			}
-			return val;
-		}
-
-
-		bool parse_()
-		{
-			if(line_[0] != '$') return false;
-
-			if(std::strncmp(&line_[1], "GPGGA,", 6) == 0) {
-				const char* p = &line_[7];
-				uint16_t n = 0;
-				uint16_t l;
-				while((l = word_(p)) != 0) {
-					if(n == 0) copy_word_(time_, p, l - 1);
-					else if(n == 1) copy_word_(lat_, p, l - 1);
-					else if(n == 2) copy_word_(ns_, p, l - 1);
-					else if(n == 3) copy_word_(lon_, p, l - 1);
-					else if(n == 4) copy_word_(ew_, p, l - 1);
-					else if(n == 5) copy_word_(q_, p, l - 1);
-					else if(n == 6) copy_word_(satellite_, p, l - 1);
-					else if(n == 7) copy_word_(hq_, p, l - 1);
-					else if(n == 8) copy_word_(alt_, p, l - 1);
-					else if(n == 9) copy_word_(alt_unit_, p, l - 1);
-					else {
-						break;
-					}
-					p += l;
-					++n;
-				}
-			} else if(std::strncmp(&line_[1], "GPRMC,", 6) == 0) {
-				const char* p = &line_[7];
-				uint16_t n = 0;
-				uint16_t l;
-				while((l = word_(p)) != 0) {
-					if(n == 8) copy_word_(date_, p, l - 1);
-					p += l;
-					++n;
-				}
-			} else if(std::strncmp(&line_[1], "GPGSV,", 6) == 0) {  // 衛星情報
-				const char* p = &line_[7];
-				uint16_t sidx = 0;
-				uint16_t n = 0;
-				uint16_t l;
-				while((l = word_(p)) != 0) {
-					if(n == 1) {
-						char tmp[4];
-						copy_word_(tmp, p, l - 1);
-						sidx = get_dec_(tmp);
-						sidx *= 4;
-					} else if(n >= 3) {
-						if(*(p - 1) == '*') break;
-						auto& t = sinfo_[sidx % SINFO_MAX];
-						auto mod = (n - 3) % 4;
-						if(mod == 0) {
-							copy_word_(t.no_, p, l - 1);
-						} else if(mod == 1) copy_word_(t.elv_, p, l - 1);
-						else if(mod == 2) copy_word_(t.azi_, p, l - 1);
-						else if(mod == 3) {
-							copy_word_(t.cn_, p, l - 1);
-							++sidx;
-						}
-					}
-					p += l;
-					++n;
-				}
-				++iid_;
-			} else if(std::strncmp(&line_[1], "GPVTG,", 6) == 0) {
-				++id_;
-				return true;
-			} else {
-//				utils::format("ND: '%s'\n") % line_;
-			}
-			return false;
-		}
-
-
 		static uint8_t sum_(const char* str)
 		{
 			if(*str == '$') ++str;
@@ -209,12 +75,21 @@ namespace utils {
 		}
 
 
+		// 1e-7 度単位を ddmm.mmmmm 形式へ
+		static void latlon_str_(int32_t v, char* dst, uint32_t len) noexcept
+		{
+			uint32_t a = v < 0 ? -v : v;
+			uint32_t deg = a / 10000000;
+			uint32_t min = (a % 10000000) * 6;  // 1e-6 分
+			utils::sformat("%d%02d.%05d", dst, len) % deg % (min / 1000000) % ((min % 1000000) / 10);
+		}
+
+
 		void init_()
 		{
 			no_recv_cnt_ = 0;
 			sci_.auto_crlf(false);
-			line_[0] = 0;
-			pos_ = 0;
+			parse_.reset();
 		}
 
 	public:
@@ -223,24 +98,40 @@ namespace utils {
             @brief  コンストラクター
         */
         //-----------------------------------------------------------------//
-		nmea_dec(SCI_IO& sci) noexcept : sci_(sci), sci_errc_(0), pos_(0), line_{ 0 },
-			time_{ 0 }, lat_{ 0 }, ns_{ 0 }, lon_{ 0 },
-			ew_{ 0 }, q_{ 0 }, satellite_{ 0 }, hq_{ 0 },
-			alt_{ 0 }, alt_unit_{ 0 }, date_{ 0 },
-			sidx_(0), id_(0), iid_(0), intr_(0),
+		nmea_dec(SCI_IO& sci) noexcept : sci_(sci), sci_errc_(0), parse_(),
+			time_{ 0 }, date_{ 0 }, lat_{ 0 }, lon_{ 0 }, q_{ 0 }, hq_{ 0 }, alt_{ 0 },
+			intr_(0),
 			update_real_rate_(0), update_fast_rate_(0),
 			no_recv_cnt_(0),
 			baud_real_rate_(0), baud_fast_rate_(0)
 		{ }
 
 
+        //-----------------------------------------------------------------//
+        /*!
+            @brief  パーサーの参照
+			@return パーサー
+        */
+        //-----------------------------------------------------------------//
+		const nmea_parse& get_parse() const noexcept { return parse_; }
+
+
+        //-----------------------------------------------------------------//
+        /*!
+            @brief  測位情報（固定小数点）を取得
+			@return 測位情報
+        */
+        //-----------------------------------------------------------------//
+		const fix_t& get_fix() const noexcept { return parse_.get_fix(); }
+
+
         //-----------------------------------------------------------------//
         /*!
             @brief  処理ＩＤを取得
 			@return 処理ＩＤ
         */
         //-----------------------------------------------------------------//
-		uint32_t get_id() const noexcept { return id_; }
+		uint32_t get_id() const noexcept { return parse_.get_id(); }
 
 
         //-----------------------------------------------------------------//
@@ -249,7 +140,7 @@ namespace utils {
 			@return 情報処理ＩＤ
         */
         //-----------------------------------------------------------------//
-		uint32_t get_iid() const noexcept { return iid_; }
+		uint32_t get_iid() const noexcept { return parse_.get_iid(); }
 
 
         //-----------------------------------------------------------------//
@@ -258,7 +149,14 @@ namespace utils {
 			@return 時間
         */
         //-----------------------------------------------------------------//
-		const char* get_time() const noexcept { return time_; }
+		const char* get_time() const noexcept
+		{
+			const auto& f = parse_.get_fix();
+			utils::sformat("%02d%02d%02d.%02d", time_, sizeof(time_))
+				% static_cast<uint32_t>(f.hour_) % static_cast<uint32_t>(f.min_)
+				% static_cast<uint32_t>(f.sec_) % static_cast<uint32_t>(f.ms_ / 10);
+			return time_;
+		}
 
 
         //-----------------------------------------------------------------//
@@ -267,7 +165,14 @@ namespace utils {
 			@return 日付
         */
         //-----------------------------------------------------------------//
-		const char* get_date() const noexcept { return date_; }
+		const char* get_date() const noexcept
+		{
+			const auto& f = parse_.get_fix();
+			utils::sformat("%02d%02d%02d", date_, sizeof(date_))
+				% static_cast<uint32_t>(f.day_) % static_cast<uint32_t>(f.mon_)
+				% static_cast<uint32_t>(f.year_ % 100);
+			return date_;
+		}
 
 
         //-----------------------------------------------------------------//
@@ -277,17 +182,17 @@ namespace utils {
         */
         //-----------------------------------------------------------------//
 		time_t get_gmtime() const noexcept {
-			if(time_[0] == 0) {
+			const auto& f = parse_.get_fix();
+			if(f.year_ == 0) {
 				return 0;
 			}
 			tm ts;
-			ts.tm_sec  = get_dec_(&time_[4], 2);
-			ts.tm_min  = get_dec_(&time_[2], 2);
-			ts.tm_hour = get_dec_(&time_[0], 2);
-			ts.tm_mday = get_dec_(&date_[0], 2);
-			ts.tm_mon  = get_dec_(&date_[2], 2) - 1;
-			ts.tm_year = get_dec_(&date_[4], 2);
-			ts.tm_year += 100;  // 起点１９００年
+			ts.tm_sec  = f.sec_;
+			ts.tm_min  = f.min_;
+			ts.tm_hour = f.hour_;
+			ts.tm_mday = f.day_;
+			ts.tm_mon  = f.mon_ - 1;
+			ts.tm_year = f.year_ - 1900;  // 起点１９００年
 			return mktime_gmt(&ts);
 		}
 
@@ -298,7 +203,11 @@ namespace utils {
 			@return 緯度
         */
         //-----------------------------------------------------------------//
-		const char* get_lat() const noexcept { return lat_; }
+		const char* get_lat() const noexcept
+		{
+			latlon_str_(parse_.get_fix().lat_, lat_, sizeof(lat_));
+			return lat_;
+		}
 
 
         //-----------------------------------------------------------------//
@@ -307,7 +216,11 @@ namespace utils {
 			@return 経度
         */
         //-----------------------------------------------------------------//
-		const char* get_lon() const noexcept { return lon_; }
+		const char* get_lon() const noexcept
+		{
+			latlon_str_(parse_.get_fix().lon_, lon_, sizeof(lon_));
+			return lon_;
+		}
 
 
         //-----------------------------------------------------------------//
@@ -374,7 +287,11 @@ namespace utils {
 			@return 品質
         */
         //-----------------------------------------------------------------//
-		const char* get_quality() const noexcept { return q_; }
+		const char* get_quality() const noexcept
+		{
+			utils::sformat("%d", q_, sizeof(q_)) % static_cast<uint32_t>(parse_.get_fix().quality_);
+			return q_;
+		}
 
 
         //-----------------------------------------------------------------//
@@ -383,12 +300,7 @@ namespace utils {
 			@return 衛星数
         */
         //-----------------------------------------------------------------//
-		int get_satellite_num() const noexcept
-		{
-			int n = 0;
-			utils::input("%d", satellite_) % n;
-			return n;
-		}
+		int get_satellite_num() const noexcept { return parse_.get_fix().satellite_; }
 
 
         //-----------------------------------------------------------------//
@@ -397,7 +309,12 @@ namespace utils {
 			@return 水平品質
         */
         //-----------------------------------------------------------------//
-		const char* get_holizontal_quality() const noexcept { return hq_; }
+		const char* get_holizontal_quality() const noexcept
+		{
+			uint32_t d = parse_.get_fix().dop_;
+			utils::sformat("%d.%02d", hq_, sizeof(hq_)) % (d / 100) % (d % 100);
+			return hq_;
+		}
 
 
         //-----------------------------------------------------------------//
@@ -406,7 +323,14 @@ namespace utils {
 			@return 海抜高度
         */
         //-----------------------------------------------------------------//
-		const char* get_altitude() const noexcept { return alt_; }
+		const char* get_altitude() const noexcept
+		{
+			int32_t a = parse_.get_fix().alt_;
+			uint32_t u = a < 0 ? -a : a;
+			utils::sformat("%s%d.%d", alt_, sizeof(alt_)) % (a < 0 ? "-" : "")
+				% (u / 1000) % ((u % 1000) / 100);
+			return alt_;
+		}
 
 
         //-----------------------------------------------------------------//
@@ -415,7 +339,16 @@ namespace utils {
 			@return 海抜高度単位
         */
         //-----------------------------------------------------------------//
-		const char* get_altitude_unit() const noexcept { return alt_unit_; }
+		const char* get_altitude_unit() const noexcept { return "M"; }
+
+
+        //-----------------------------------------------------------------//
+        /*!
+            @brief  衛星情報数を取得
+			@return 衛星情報数
+        */
+        //-----------------------------------------------------------------//
+		uint32_t get_satellite_info_num() const noexcept { return parse_.get_satellite_info_num(); }
 
 
         //-----------------------------------------------------------------//
@@ -427,12 +360,7 @@ namespace utils {
         //-----------------------------------------------------------------//
 		const sat_info& get_satellite_info(uint16_t idx) const noexcept
 		{
-			if(idx < SINFO_MAX) {
-				return sinfo_[idx];
-			} else {
-				static sat_info si;
-				return si;
-			}
+			return parse_.get_satellite_info(idx);
 		}
 
 
@@ -494,6 +422,7 @@ namespace utils {
 			if(errc != sci_errc_) {
 				sci_errc_ = errc;
 				sci_.flush_recv();
+				parse_.reset();
 				++no_recv_cnt_;
 				if(no_recv_cnt_ >= (60 * 5)) {  // ５秒間受信が無い場合、ボーレートを変更
 					if(baud_real_rate_ == 9600) {  // 9600 で通信出来てないので、高速になってるかも
@@ -515,21 +444,7 @@ namespace utils {
 			}
 			no_recv_cnt_ = 0;
 			while(len > 0) {
-				auto ch = sci_.getch();
-				if(ch == 0x0d) {
-					line_[pos_] = 0;
-					ret = parse_();
-					pos_ = 0;
-				} else {
-					if(ch >= ' ' && ch <= 0x7f) {  // CTRL コードは無視する。
-						if(pos_ < (sizeof(line_) - 1)) {
-							line_[pos_] = ch;
-							++pos_;
-						} else {
-							pos_ = 0;
-						}
-					}
-				}
+				if(parse_.put(sci_.getch())) ret = true;
 				--len;
 			}
 			if(ret && baud_real_rate_ == baud_fast_rate_) {  // fast rate なら、10Hz にする。
@@ -664,6 +579,7 @@ namespace utils {
 #define PGCMD_NOANTENNA "$PGCMD,33,0*6D" 
 
 // センテンス例：
+/*
 $GPGSV,3,1,12,26,72,352,28,05,65,066,37,15,50,268,35,27,33,189,37*7F
  単語例 	説明 	意味
 3 	総GSVセンテンス数 	総GSVセンテンス数：3個
@@ -686,6 +602,7 @@ $GPGSV,3,1,12,26,72,352,28,05,65,066,37,15,50,268,35,27,33,189,37*7F
 189 	衛星方位角。000～359度 	衛星方位角：189度
 37 	C/No（キャリア／ノイズ比）。00～99dB 	C/No：37dB
 *7F 	チェックサム 	チェックサム値：7F
+*/
 #endif
 	};
 }
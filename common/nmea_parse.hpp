@@ -0,0 +1,745 @@
+#pragma once
+//=====================================================================//
+/*!	@file
+	@brief	NMEA/UBX ストリーム・パーサー @n
+			・受信バイト列を１バイトずつ状態遷移で解析する。@n
+			・チェックサムは受信と同時に計算し、正しい場合のみ結果を反映する。@n
+			・緯度、経度、速度、方位などは、文字列を経由せず固定小数点で得る。@n
+			・トーカー： GP(GPS), GN(複合), GL(GLONASS), GA(Galileo), GB/BD(BeiDou) @n
+			・センテンス： GGA, RMC, GSV, VTG @n
+			・u-blox UBX バイナリ： NAV-PVT
+    @author 平松邦仁 (hira@rvf-rc45.net)
+	@copyright	Copyright (C) 2021 Kunihito Hiramatsu @n
+				Released under the MIT license @n
+				https://github.com/hirakuni45/RX/blob/master/LICENSE
+*/
+//=====================================================================//
+#include <cstdint>
+
+namespace utils {
+
+	//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+	/*!
+		@brief  NMEA/UBX パーサー・クラス
+	*/
+	//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+	class nmea_parse {
+	public:
+
+		static const uint32_t SINFO_MAX = 32;		///< 衛星情報の最大数
+
+		//=================================================================//
+		/*!
+			@brief  トーカー型
+		*/
+		//=================================================================//
+		enum class TALKER : uint8_t {
+			NONE,	///< 不明
+			GP,		///< GPS
+			GN,		///< 複合 GNSS
+			GL,		///< GLONASS
+			GA,		///< Galileo
+			GB,		///< BeiDou (GB/BD)
+			UBX,	///< u-blox バイナリ
+		};
+
+
+		//=================================================================//
+		/*!
+			@brief  測位情報 @n
+					lat_, lon_: 1e-7 度単位（北緯、東経が正）@n
+					alt_: 海抜高度 [mm] @n
+					speed_: 対地速度 [mm/s] @n
+					heading_: 進行方位 1e-5 度単位 @n
+					dop_: 精度低下率 0.01 単位
+		*/
+		//=================================================================//
+		struct fix_t {
+			int32_t		lat_;
+			int32_t		lon_;
+			int32_t		alt_;
+			uint32_t	speed_;
+			int32_t		heading_;
+			uint16_t	dop_;
+			uint16_t	year_;
+			uint8_t		mon_;
+			uint8_t		day_;
+			uint8_t		hour_;
+			uint8_t		min_;
+			uint8_t		sec_;
+			uint16_t	ms_;
+			uint8_t		quality_;	///< 品質（０：無効）
+			uint8_t		satellite_;	///< 測位に使用している衛星数
+			bool		valid_;		///< RMC ステータス 'A'、又は UBX gnssFixOK
+			TALKER		talker_;	///< 最後に更新したトーカー
+
+			fix_t() noexcept : lat_(0), lon_(0), alt_(0), speed_(0), heading_(0),
+				dop_(0), year_(0), mon_(0), day_(0), hour_(0), min_(0), sec_(0), ms_(0),
+				quality_(0), satellite_(0), valid_(false), talker_(TALKER::NONE)
+			{ }
+		};
+
+
+		//=================================================================//
+		/*!
+			@brief  衛星パラメーター
+		*/
+		//=================================================================//
+		struct sat_info {
+			TALKER		talker_;	///< トーカー
+			uint8_t		no_;		///< 衛星番号
+			uint8_t		elv_;		///< 衛星仰角(Elevation)、０～９０度
+			uint8_t		cn_;		///< キャリア／ノイズ比、０～９９dB
+			uint16_t	azi_;		///< 衛星方位角(Azimuth)、０～３５９度
+
+			sat_info() noexcept : talker_(TALKER::NONE), no_(0), elv_(0), cn_(0), azi_(0) { }
+		};
+
+	private:
+
+		enum class STATE : uint8_t {
+			WAIT,		///< '$' 又は UBX 同期待ち
+			ADRS,		///< アドレス（トーカー＋センテンス）
+			FIELD,		///< フィールド
+			SUM_H,		///< チェックサム上位
+			SUM_L,		///< チェックサム下位
+			UBX_SYNC,	///< UBX 同期２バイト目
+			UBX_HEAD,	///< UBX クラス、ID、長さ
+			UBX_BODY,	///< UBX ペイロード
+			UBX_CKA,	///< UBX チェックサム A
+			UBX_CKB,	///< UBX チェックサム B
+		};
+
+		enum class SENTENCE : uint8_t {
+			NONE,
+			GGA,
+			RMC,
+			GSV,
+			VTG,
+		};
+
+		static const uint8_t  UBX_SYNC1 = 0xB5;
+		static const uint8_t  UBX_SYNC2 = 0x62;
+		static const uint16_t UBX_NAV_PVT = 0x0107;	///< class, id
+		static const uint16_t UBX_NAV_PVT_LEN = 92;
+		static const uint8_t  FIELD_MAX = 24;
+		static const uint8_t  FRAC_MAX = 7;
+
+		STATE		state_;
+		SENTENCE	sentence_;
+		TALKER		talker_;
+
+		uint8_t		sum_;
+		uint8_t		rsum_;
+		uint8_t		pos_;		///< アドレス位置、又はフィールド番号
+		char		adrs_[5];
+
+		// フィールド・アキュムレーター
+		uint32_t	ival_;
+		uint32_t	fval_;
+		uint8_t		fdig_;
+		uint8_t		flen_;
+		bool		dot_;
+		bool		neg_;
+		char		fch_;
+
+		fix_t		fix_;
+		fix_t		work_;
+
+		// GSV
+		uint8_t		gsv_msg_;
+		uint8_t		gsv_num_;
+		uint8_t		gsv_view_;
+		sat_info	gsv_[4];
+		uint8_t		sinfo_num_;
+		sat_info	sinfo_[SINFO_MAX];
+
+		// UBX
+		uint8_t		ubx_head_[4];
+		uint16_t	ubx_len_;
+		uint16_t	ubx_pos_;
+		uint8_t		ubx_cka_;
+		uint8_t		ubx_ckb_;
+		uint8_t		ubx_[UBX_NAV_PVT_LEN];
+
+		uint32_t	id_;
+		uint32_t	iid_;
+		uint32_t	sentence_count_;
+		uint32_t	ubx_count_;
+		uint32_t	error_count_;
+
+
+		static uint32_t scale_(uint32_t frac, uint8_t fdig, uint8_t n) noexcept
+		{
+			while(fdig < n) { frac *= 10; ++fdig; }
+			while(fdig > n) { frac /= 10; --fdig; }
+			return frac;
+		}
+
+
+		uint32_t fixed_(uint32_t unit, uint8_t n) const noexcept
+		{
+			return ival_ * unit + scale_(fval_, fdig_, n);
+		}
+
+
+		void clear_field_() noexcept
+		{
+			ival_ = 0;
+			fval_ = 0;
+			fdig_ = 0;
+			flen_ = 0;
+			dot_ = false;
+			neg_ = false;
+			fch_ = 0;
+		}
+
+
+		// ddmm.mmmmmm 形式を 1e-7 度単位へ
+		int32_t latlon_() const noexcept
+		{
+			uint32_t deg = ival_ / 100;
+			uint32_t min = (ival_ % 100) * 1000000 + scale_(fval_, fdig_, 6);
+			return deg * 10000000 + min / 6;
+		}
+
+
+		static TALKER get_talker_(char a, char b) noexcept
+		{
+			if(a == 'G') {
+				if(b == 'P') return TALKER::GP;
+				else if(b == 'N') return TALKER::GN;
+				else if(b == 'L') return TALKER::GL;
+				else if(b == 'A') return TALKER::GA;
+				else if(b == 'B') return TALKER::GB;
+			} else if(a == 'B' && b == 'D') {
+				return TALKER::GB;
+			}
+			return TALKER::NONE;
+		}
+
+
+		static SENTENCE get_sentence_(const char* s) noexcept
+		{
+			if(s[0] == 'G' && s[1] == 'G' && s[2] == 'A') return SENTENCE::GGA;
+			else if(s[0] == 'R' && s[1] == 'M' && s[2] == 'C') return SENTENCE::RMC;
+			else if(s[0] == 'G' && s[1] == 'S' && s[2] == 'V') return SENTENCE::GSV;
+			else if(s[0] == 'V' && s[1] == 'T' && s[2] == 'G') return SENTENCE::VTG;
+			return SENTENCE::NONE;
+		}
+
+
+		static int hex_(char ch) noexcept
+		{
+			if(ch >= '0' && ch <= '9') return ch - '0';
+			else if(ch >= 'A' && ch <= 'F') return ch - 'A' + 10;
+			else if(ch >= 'a' && ch <= 'f') return ch - 'a' + 10;
+			return -1;
+		}
+
+
+		void field_gga_() noexcept
+		{
+			switch(pos_) {
+			case 0:
+				work_.hour_ = ival_ / 10000;
+				work_.min_  = (ival_ / 100) % 100;
+				work_.sec_  = ival_ % 100;
+				work_.ms_   = scale_(fval_, fdig_, 3);
+				break;
+			case 1: work_.lat_ = latlon_(); break;
+			case 2: if(fch_ == 'S') work_.lat_ = -work_.lat_; break;
+			case 3: work_.lon_ = latlon_(); break;
+			case 4: if(fch_ == 'W') work_.lon_ = -work_.lon_; break;
+			case 5: work_.quality_ = ival_; break;
+			case 6: work_.satellite_ = ival_; break;
+			case 7: work_.dop_ = fixed_(100, 2); break;
+			case 8:
+				work_.alt_ = fixed_(1000, 3);
+				if(neg_) work_.alt_ = -work_.alt_;
+				break;
+			default:
+				break;
+			}
+		}
+
+
+		void field_rmc_() noexcept
+		{
+			switch(pos_) {
+			case 0:
+				work_.hour_ = ival_ / 10000;
+				work_.min_  = (ival_ / 100) % 100;
+				work_.sec_  = ival_ % 100;
+				work_.ms_   = scale_(fval_, fdig_, 3);
+				break;
+			case 1: work_.valid_ = (fch_ == 'A'); break;
+			case 2: work_.lat_ = latlon_(); break;
+			case 3: if(fch_ == 'S') work_.lat_ = -work_.lat_; break;
+			case 4: work_.lon_ = latlon_(); break;
+			case 5: if(fch_ == 'W') work_.lon_ = -work_.lon_; break;
+			case 6:  // knots
+				work_.speed_ = static_cast<uint64_t>(fixed_(1000, 3)) * 1852 / 3600;
+				break;
+			case 7: work_.heading_ = fixed_(100000, 5); break;
+			case 8:
+				work_.day_  = ival_ / 10000;
+				work_.mon_  = (ival_ / 100) % 100;
+				work_.year_ = 2000 + (ival_ % 100);
+				break;
+			default:
+				break;
+			}
+		}
+
+
+		void field_vtg_() noexcept
+		{
+			switch(pos_) {
+			case 0: work_.heading_ = fixed_(100000, 5); break;
+			case 6:  // km/h
+				work_.speed_ = static_cast<uint64_t>(fixed_(1000, 3)) * 10 / 36;
+				break;
+			default:
+				break;
+			}
+		}
+
+
+		void field_gsv_() noexcept
+		{
+			switch(pos_) {
+			case 0: gsv_msg_ = ival_; break;
+			case 1: gsv_num_ = ival_; break;
+			case 2: gsv_view_ = ival_; break;
+			default:
+				{
+					uint8_t n = (pos_ - 3) / 4;
+					if(n >= 4) break;
+					auto& t = gsv_[n];
+					switch((pos_ - 3) % 4) {
+					case 0:
+						t.talker_ = talker_;
+						t.no_ = ival_;
+						break;
+					case 1: t.elv_ = ival_; break;
+					case 2: t.azi_ = ival_; break;
+					case 3: t.cn_ = ival_; break;
+					}
+				}
+				break;
+			}
+		}
+
+
+		void field_() noexcept
+		{
+			if(flen_ > 0) {
+				switch(sentence_) {
+				case SENTENCE::GGA: field_gga_(); break;
+				case SENTENCE::RMC: field_rmc_(); break;
+				case SENTENCE::GSV: field_gsv_(); break;
+				case SENTENCE::VTG: field_vtg_(); break;
+				default: break;
+				}
+			}
+			clear_field_();
+		}
+
+
+		void commit_gsv_() noexcept
+		{
+			if(gsv_num_ == 1) {  // 最初のメッセージで、同じトーカーの情報を消去
+				uint8_t j = 0;
+				for(uint8_t i = 0; i < sinfo_num_; ++i) {
+					if(sinfo_[i].talker_ != talker_) {
+						sinfo_[j] = sinfo_[i];
+						++j;
+					}
+				}
+				sinfo_num_ = j;
+			}
+			uint8_t n = 0;
+			if(pos_ > 3) n = (pos_ - 3 + 3) / 4;
+			if(n > 4) n = 4;
+			for(uint8_t i = 0; i < n; ++i) {
+				if(gsv_[i].no_ == 0) continue;
+				if(sinfo_num_ >= SINFO_MAX) break;
+				sinfo_[sinfo_num_] = gsv_[i];
+				++sinfo_num_;
+			}
+			++iid_;
+		}
+
+
+		bool commit_() noexcept
+		{
+			++sentence_count_;
+			if(sentence_ == SENTENCE::GSV) {
+				commit_gsv_();
+				return false;
+			}
+			work_.talker_ = talker_;
+			fix_ = work_;
+			++id_;
+			return true;
+		}
+
+
+		uint32_t ubx_u32_(uint16_t ofs) const noexcept
+		{
+			return static_cast<uint32_t>(ubx_[ofs])
+				| (static_cast<uint32_t>(ubx_[ofs + 1]) << 8)
+				| (static_cast<uint32_t>(ubx_[ofs + 2]) << 16)
+				| (static_cast<uint32_t>(ubx_[ofs + 3]) << 24);
+		}
+
+
+		uint16_t ubx_u16_(uint16_t ofs) const noexcept
+		{
+			return static_cast<uint16_t>(ubx_[ofs]) | (static_cast<uint16_t>(ubx_[ofs + 1]) << 8);
+		}
+
+
+		bool commit_nav_pvt_() noexcept
+		{
+			fix_t t = fix_;
+			uint8_t valid = ubx_[11];
+			if(valid & 0x01) {  // validDate
+				t.year_ = ubx_u16_(4);
+				t.mon_  = ubx_[6];
+				t.day_  = ubx_[7];
+			}
+			if(valid & 0x02) {  // validTime
+				t.hour_ = ubx_[8];
+				t.min_  = ubx_[9];
+				t.sec_  = ubx_[10];
+				int32_t nano = static_cast<int32_t>(ubx_u32_(16));
+				t.ms_ = nano > 0 ? (nano / 1000000) : 0;
+			}
+			uint8_t type = ubx_[20];
+			t.valid_ = (ubx_[21] & 0x01) != 0;  // gnssFixOK
+			t.quality_ = (t.valid_ && type >= 2 && type <= 4) ? 1 : 0;
+			t.satellite_ = ubx_[23];
+			t.lon_ = static_cast<int32_t>(ubx_u32_(24));
+			t.lat_ = static_cast<int32_t>(ubx_u32_(28));
+			t.alt_ = static_cast<int32_t>(ubx_u32_(36));  // hMSL
+			int32_t gs = static_cast<int32_t>(ubx_u32_(60));
+			t.speed_ = gs < 0 ? 0 : gs;
+			t.heading_ = static_cast<int32_t>(ubx_u32_(64));
+			t.dop_ = ubx_u16_(76);
+			t.talker_ = TALKER::UBX;
+			fix_ = t;
+			++ubx_count_;
+			++id_;
+			return true;
+		}
+
+
+		void ubx_sum_(uint8_t ch) noexcept
+		{
+			ubx_cka_ += ch;
+			ubx_ckb_ += ubx_cka_;
+		}
+
+
+		bool put_ubx_(uint8_t ch) noexcept
+		{
+			switch(state_) {
+			case STATE::UBX_SYNC:
+				if(ch == UBX_SYNC2) {
+					ubx_pos_ = 0;
+					ubx_cka_ = 0;
+					ubx_ckb_ = 0;
+					state_ = STATE::UBX_HEAD;
+				} else {
+					state_ = STATE::WAIT;
+				}
+				break;
+			case STATE::UBX_HEAD:
+				ubx_sum_(ch);
+				ubx_head_[ubx_pos_] = ch;
+				++ubx_pos_;
+				if(ubx_pos_ >= 4) {
+					ubx_len_ = ubx_head_[2] | (static_cast<uint16_t>(ubx_head_[3]) << 8);
+					ubx_pos_ = 0;
+					state_ = ubx_len_ > 0 ? STATE::UBX_BODY : STATE::UBX_CKA;
+				}
+				break;
+			case STATE::UBX_BODY:
+				ubx_sum_(ch);
+				if(ubx_pos_ < UBX_NAV_PVT_LEN) ubx_[ubx_pos_] = ch;
+				++ubx_pos_;
+				if(ubx_pos_ >= ubx_len_) state_ = STATE::UBX_CKA;
+				break;
+			case STATE::UBX_CKA:
+				if(ch == ubx_cka_) {
+					state_ = STATE::UBX_CKB;
+				} else {
+					++error_count_;
+					state_ = STATE::WAIT;
+				}
+				break;
+			case STATE::UBX_CKB:
+				state_ = STATE::WAIT;
+				if(ch != ubx_ckb_) {
+					++error_count_;
+					break;
+				}
+				if(((static_cast<uint16_t>(ubx_head_[0]) << 8) | ubx_head_[1]) == UBX_NAV_PVT
+					&& ubx_len_ == UBX_NAV_PVT_LEN) {
+					return commit_nav_pvt_();
+				}
+				break;
+			default:
+				state_ = STATE::WAIT;
+				break;
+			}
+			return false;
+		}
+
+
+		void start_nmea_() noexcept
+		{
+			state_ = STATE::ADRS;
+			sum_ = 0;
+			pos_ = 0;
+		}
+
+	public:
+        //-----------------------------------------------------------------//
+        /*!
+            @brief  コンストラクター
+        */
+        //-----------------------------------------------------------------//
+		nmea_parse() noexcept : state_(STATE::WAIT), sentence_(SENTENCE::NONE), talker_(TALKER::NONE),
+			sum_(0), rsum_(0), pos_(0), adrs_{ 0 },
+			ival_(0), fval_(0), fdig_(0), flen_(0), dot_(false), neg_(false), fch_(0),
+			fix_(), work_(),
+			gsv_msg_(0), gsv_num_(0), gsv_view_(0), gsv_{ }, sinfo_num_(0), sinfo_{ },
+			ubx_head_{ 0 }, ubx_len_(0), ubx_pos_(0), ubx_cka_(0), ubx_ckb_(0), ubx_{ 0 },
+			id_(0), iid_(0), sentence_count_(0), ubx_count_(0), error_count_(0)
+		{ }
+
+
+        //-----------------------------------------------------------------//
+        /*!
+            @brief  リセット（解析途中のセンテンスを破棄）
+        */
+        //-----------------------------------------------------------------//
+		void reset() noexcept { state_ = STATE::WAIT; }
+
+
+        //-----------------------------------------------------------------//
+        /*!
+            @brief  １バイト解析
+			@param[in]	ch	受信バイト
+			@return 測位情報が更新されたら「true」
+        */
+        //-----------------------------------------------------------------//
+		bool put(char ch) noexcept
+		{
+			uint8_t c = static_cast<uint8_t>(ch);
+			if(state_ >= STATE::UBX_SYNC) {
+				return put_ubx_(c);
+			}
+
+			if(c == '$') {
+				start_nmea_();
+				return false;
+			}
+
+			switch(state_) {
+			case STATE::WAIT:
+				if(c == UBX_SYNC1) state_ = STATE::UBX_SYNC;
+				break;
+
+			case STATE::ADRS:
+				if(c < ' ' || c >= 0x7f) {
+					state_ = STATE::WAIT;
+					break;
+				}
+				sum_ ^= c;
+				if(pos_ < 5) {
+					adrs_[pos_] = ch;
+					++pos_;
+					break;
+				}
+				talker_ = get_talker_(adrs_[0], adrs_[1]);
+				sentence_ = get_sentence_(&adrs_[2]);
+				if(c != ',' || talker_ == TALKER::NONE || sentence_ == SENTENCE::NONE) {
+					state_ = STATE::WAIT;
+					break;
+				}
+				if(sentence_ == SENTENCE::GSV) {
+					for(auto& t : gsv_) { t = sat_info(); }
+				} else {
+					work_ = fix_;
+				}
+				pos_ = 0;
+				clear_field_();
+				state_ = STATE::FIELD;
+				break;
+
+			case STATE::FIELD:
+				if(c == '*') {
+					field_();
+					state_ = STATE::SUM_H;
+				} else if(c == ',') {
+					field_();
+					++pos_;
+					if(pos_ >= FIELD_MAX) state_ = STATE::WAIT;
+					else sum_ ^= c;
+				} else if(c >= '0' && c <= '9') {
+					sum_ ^= c;
+					++flen_;
+					if(!dot_) {
+						ival_ = ival_ * 10 + (c - '0');
+					} else if(fdig_ < FRAC_MAX) {
+						fval_ = fval_ * 10 + (c - '0');
+						++fdig_;
+					}
+				} else if(c >= ' ' && c < 0x7f) {
+					sum_ ^= c;
+					++flen_;
+					if(c == '.') dot_ = true;
+					else if(c == '-') neg_ = true;
+					else if(fch_ == 0) fch_ = ch;
+				} else {  // チェックサムの無いセンテンスは破棄
+					state_ = STATE::WAIT;
+				}
+				break;
+
+			case STATE::SUM_H:
+				{
+					auto h = hex_(ch);
+					if(h < 0) { state_ = STATE::WAIT; break; }
+					rsum_ = h << 4;
+					state_ = STATE::SUM_L;
+				}
+				break;
+
+			case STATE::SUM_L:
+				{
+					state_ = STATE::WAIT;
+					auto l = hex_(ch);
+					if(l < 0) break;
+					rsum_ |= l;
+					if(rsum_ != sum_) {
+						++error_count_;
+						break;
+					}
+					return commit_();
+				}
+				break;
+
+			default:
+				state_ = STATE::WAIT;
+				break;
+			}
+			return false;
+		}
+
+
+        //-----------------------------------------------------------------//
+        /*!
+            @brief  バイト列の解析
+			@param[in]	src	ソース
+			@param[in]	len	長さ
+			@return 測位情報が更新されたら「true」
+        */
+        //-----------------------------------------------------------------//
+		bool put(const void* src, uint32_t len) noexcept
+		{
+			bool ret = false;
+			auto p = static_cast<const char*>(src);
+			while(len > 0) {
+				if(put(*p)) ret = true;
+				++p;
+				--len;
+			}
+			return ret;
+		}
+
+
+        //-----------------------------------------------------------------//
+        /*!
+            @brief  測位情報を取得
+			@return 測位情報
+        */
+        //-----------------------------------------------------------------//
+		const fix_t& get_fix() const noexcept { return fix_; }
+
+
+        //-----------------------------------------------------------------//
+        /*!
+            @brief  測位更新ＩＤを取得（GGA, RMC, VTG, NAV-PVT 毎に進む）
+			@return 測位更新ＩＤ
+        */
+        //-----------------------------------------------------------------//
+		uint32_t get_id() const noexcept { return id_; }
+
+
+        //-----------------------------------------------------------------//
+        /*!
+            @brief  衛星情報更新ＩＤを取得（GSV 毎に進む）
+			@return 衛星情報更新ＩＤ
+        */
+        //-----------------------------------------------------------------//
+		uint32_t get_iid() const noexcept { return iid_; }
+
+
+        //-----------------------------------------------------------------//
+        /*!
+            @brief  受理した NMEA センテンス数を取得
+			@return NMEA センテンス数
+        */
+        //-----------------------------------------------------------------//
+		uint32_t get_sentence_count() const noexcept { return sentence_count_; }
+
+
+        //-----------------------------------------------------------------//
+        /*!
+            @brief  受理した UBX NAV-PVT 数を取得
+			@return UBX NAV-PVT 数
+        */
+        //-----------------------------------------------------------------//
+		uint32_t get_ubx_count() const noexcept { return ubx_count_; }
+
+
+        //-----------------------------------------------------------------//
+        /*!
+            @brief  チェックサム・エラー数を取得
+			@return チェックサム・エラー数
+        */
+        //-----------------------------------------------------------------//
+		uint32_t get_error_count() const noexcept { return error_count_; }
+
+
+        //-----------------------------------------------------------------//
+        /*!
+            @brief  衛星情報数を取得
+			@return 衛星情報数
+        */
+        //-----------------------------------------------------------------//
+		uint32_t get_satellite_info_num() const noexcept { return sinfo_num_; }
+
+
+        //-----------------------------------------------------------------//
+        /*!
+            @brief  衛星情報の取得
+			@param[in]	idx	衛星インデックス
+			@return 衛星情報
+        */
+        //-----------------------------------------------------------------//
+		const sat_info& get_satellite_info(uint32_t idx) const noexcept
+		{
+			if(idx < sinfo_num_) {
+				return sinfo_[idx];
+			} else {
+				static sat_info si;
+				return si;
+			}
+		}
+	};
+}
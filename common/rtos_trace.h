@@ -0,0 +1,84 @@
+#pragma once
+//=====================================================================//
+/*!	@file
+	@brief	FreeRTOS トレース・フック定義 @n
+			・「FreeRTOSConfig.h」の最後でインクルードする（RTOS_TRACE 定義時）@n
+			・カーネルのトレース・マクロを「rtos_trace_event」等の C 関数に接続する @n
+			・C 関数の実体は、アプリケーション側で「utils::rtos_trace」に接続する @n
+			・configGENERATE_RUN_TIME_STATS のカウンターもトレースの時間軸を使う
+    @author 平松邦仁 (hira@rvf-rc45.net)
+	@copyright	Copyright (C) 2021 Kunihito Hiramatsu @n
+				Released under the MIT license @n
+				https://github.com/hirakuni45/RX/blob/master/LICENSE
+*/
+//=====================================================================//
+
+/// イベント ID（バイナリ・フォーマット、rtostrace と共通）
+#define RTOS_TRACE_EV_SWITCH_IN		1	///< タスク切り替え（タスク番号）
+#define RTOS_TRACE_EV_READY			2	///< レディー状態へ（タスク番号）
+#define RTOS_TRACE_EV_DELAY			3	///< vTaskDelay/vTaskDelayUntil
+#define RTOS_TRACE_EV_QUEUE_RECV	4	///< キュー受信待ち（キューのアドレス）
+#define RTOS_TRACE_EV_QUEUE_SEND	5	///< キュー送信待ち（キューのアドレス）
+#define RTOS_TRACE_EV_NOTIFY		6	///< タスク通知待ち
+#define RTOS_TRACE_EV_TICK			7	///< システム・ティック
+#define RTOS_TRACE_EV_ISR_ENTER		8	///< 割り込み開始（割り込み番号）
+#define RTOS_TRACE_EV_ISR_EXIT		9	///< 割り込み終了
+#define RTOS_TRACE_EV_CREATE		10	///< タスク生成（タスク番号、優先度）
+#define RTOS_TRACE_EV_DELETE		11	///< タスク削除（タスク番号）
+#define RTOS_TRACE_EV_LOST			12	///< 失ったイベント数
+#define RTOS_TRACE_EV_USER			13	///< ユーザー・イベント（ID、値）
+
+#ifndef __ASSEMBLER__
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+	void rtos_trace_event(uint32_t ev, uint32_t arg);
+	void rtos_trace_task(uint32_t id, const char* name, uint32_t prio);
+	uint32_t rtos_trace_runtime(void);
+#ifdef __cplusplus
+};
+#endif
+#endif
+
+//-----------------------------------------------------------------//
+/*!
+	@brief  割り込みハンドラーの先頭と最後に置く（任意）
+	@param[in]	n	割り込み番号（ベクター番号など）
+*/
+//-----------------------------------------------------------------//
+#define RTOS_TRACE_ISR_ENTER(n)	rtos_trace_event(RTOS_TRACE_EV_ISR_ENTER, (uint32_t)(n))
+#define RTOS_TRACE_ISR_EXIT()	rtos_trace_event(RTOS_TRACE_EV_ISR_EXIT, 0)
+
+#ifdef RTOS_TRACE
+// カーネル・フック（tasks.c、queue.c 内で展開される）
+#define traceTASK_SWITCHED_IN() \
+	rtos_trace_event(RTOS_TRACE_EV_SWITCH_IN, pxCurrentTCB->uxTCBNumber)
+#define traceMOVED_TASK_TO_READY_STATE(pxTCB) \
+	rtos_trace_event(RTOS_TRACE_EV_READY, (pxTCB)->uxTCBNumber)
+#define traceTASK_DELAY() \
+	rtos_trace_event(RTOS_TRACE_EV_DELAY, 0)
+#define traceTASK_DELAY_UNTIL(x) \
+	rtos_trace_event(RTOS_TRACE_EV_DELAY, 0)
+#define traceBLOCKING_ON_QUEUE_RECEIVE(pxQueue) \
+	rtos_trace_event(RTOS_TRACE_EV_QUEUE_RECV, (uint32_t)(uintptr_t)(pxQueue))
+#define traceBLOCKING_ON_QUEUE_PEEK(pxQueue) \
+	rtos_trace_event(RTOS_TRACE_EV_QUEUE_RECV, (uint32_t)(uintptr_t)(pxQueue))
+#define traceBLOCKING_ON_QUEUE_SEND(pxQueue) \
+	rtos_trace_event(RTOS_TRACE_EV_QUEUE_SEND, (uint32_t)(uintptr_t)(pxQueue))
+#define traceTASK_NOTIFY_TAKE_BLOCK(uxIndexToWait) \
+	rtos_trace_event(RTOS_TRACE_EV_NOTIFY, 0)
+#define traceTASK_NOTIFY_WAIT_BLOCK(uxIndexToWait) \
+	rtos_trace_event(RTOS_TRACE_EV_NOTIFY, 0)
+#define traceTASK_INCREMENT_TICK(xTickCount) \
+	rtos_trace_event(RTOS_TRACE_EV_TICK, 0)
+#define traceTASK_CREATE(pxNewTCB) \
+	rtos_trace_task((pxNewTCB)->uxTCBNumber, (pxNewTCB)->pcTaskName, (pxNewTCB)->uxPriority)
+#define traceTASK_DELETE(pxTaskToDelete) \
+	rtos_trace_event(RTOS_TRACE_EV_DELETE, (pxTaskToDelete)->uxTCBNumber)
+
+// 実行時間統計（vTaskGetRunTimeStats、uxTaskGetSystemState）
+#define portCONFIGURE_TIMER_FOR_RUN_TIME_STATS()
+#define portGET_RUN_TIME_COUNTER_VALUE()	rtos_trace_runtime()
+#endif
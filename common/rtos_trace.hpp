@@ -0,0 +1,617 @@
+#pragma once
+//=====================================================================//
+/*!	@file
+	@brief	FreeRTOS タスク・トレース・レコーダー @n
+			・カーネルのトレース・フック（common/rtos_trace.h）からイベントを受け、@n
+			  コンパクトなバイナリ（種別、時間差分、引数の可変長整数）で RAM に記録 @n
+			・記録はブロック単位で、各ブロックは絶対時間と実行中タスクを持つので、@n
+			  リング（古いブロックを上書き）でも、どこからでもデコードできる @n
+			・ストリーム・モードでは、満杯のブロックを SCI、USB、SD などへ送出し、@n
+			  送れなかったイベントは数だけ記録する（LOST イベント）@n
+			・タイムスタンプは CMTW（３２ビット）、CMT（１６ビット）のフリーラン・カウンター @n
+			  をソフトで６４ビットに拡張したもので、実行時間統計の時間軸も兼ねる @n
+			・「rtostrace」でホスト上で Chrome/Perfetto 用の JSON に変換できる
+    @author 平松邦仁 (hira@rvf-rc45.net)
+	@copyright	Copyright (C) 2021 Kunihito Hiramatsu @n
+				Released under the MIT license @n
+				https://github.com/hirakuni45/RX/blob/master/LICENSE
+*/
+//=====================================================================//
+#include <cstdint>
+#include <cstring>
+#include "common/renesas.hpp"
+#include "common/format.hpp"
+#include "common/rtos_trace.h"
+
+#ifdef FAT_FS
+#include "common/file_io.hpp"
+#endif
+
+#ifdef RTOS
+#include "FreeRTOS.h"
+#include "task.h"
+#endif
+
+namespace utils {
+
+	//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+	/*!
+		@brief  CMTW（３２ビット）タイムスタンプ @n
+				PCLK/8 のフリーラン（コンペアマッチでクリアしない）
+		@param[in]	CMTW	CMTW チャネル（device::CMTW0 など）
+	*/
+	//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+	template <class CMTW>
+	struct rtos_trace_cmtw {
+		static const uint32_t BITS = 32;	///< カウンターのビット数
+
+		static void start() noexcept
+		{
+			device::power_mgr::turn(CMTW::PERIPHERAL);
+			CMTW::CMWSTR = 0;
+			CMTW::CMWCR = CMTW::CMWCR.CKS.b(0) | CMTW::CMWCR.CCLR.b(1);
+			CMTW::CMWCNT = 0;
+			CMTW::CMWSTR.STR = 1;
+		}
+
+		static uint32_t get_freq() noexcept { return CMTW::PCLK / 8; }
+
+		static uint32_t get_counter() noexcept { return CMTW::CMWCNT(); }
+	};
+
+
+	//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+	/*!
+		@brief  CMT（１６ビット）タイムスタンプ @n
+				PCLK/8 で CMCOR = 0xFFFF、割り込みは使わない @n
+				※周回（PCLK=60MHz で約 8.7ms）より短い間隔でイベントが必要 @n
+				  （システム・ティックのイベントがあれば満たされる）
+		@param[in]	CMT		CMT チャネル（device::CMT1 など）
+		@param[in]	CLK		クロック選択（0: PCLK/8, 1: PCLK/32, 2: PCLK/128, 3: PCLK/512）@n
+							間隔の長い計測では、分周を大きくして周回を延ばす
+	*/
+	//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+	template <class CMT, uint8_t CLK = 0>
+	struct rtos_trace_cmt {
+		static const uint32_t BITS = 16;	///< カウンターのビット数
+
+		static void start() noexcept
+		{
+			device::power_mgr::turn(CMT::PERIPHERAL);
+			CMT::enable(false);
+			CMT::CMCNT = 0;
+			CMT::CMCOR = 0xFFFF;
+			CMT::CMCR = CMT::CMCR.CKS.b(CLK);
+			CMT::enable();
+		}
+
+		static uint32_t get_freq() noexcept { return CMT::PCLK >> (3 + CLK * 2); }
+
+		static uint32_t get_counter() noexcept { return CMT::CMCNT(); }
+	};
+
+
+	//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+	/*!
+		@brief  排他無し（割り込みから記録しない場合、ホスト）
+	*/
+	//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+	struct rtos_trace_null_lock {
+		static uint32_t lock() noexcept { return 0; }
+		static void unlock(uint32_t) noexcept { }
+	};
+
+
+#ifdef RTOS
+	//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+	/*!
+		@brief  カーネル割り込みマスクによる排他 @n
+				※configMAX_SYSCALL_INTERRUPT_PRIORITY より上の割り込みからは記録不可
+	*/
+	//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+	struct rtos_trace_isr_lock {
+		static uint32_t lock() noexcept { return portSET_INTERRUPT_MASK_FROM_ISR(); }
+		static void unlock(uint32_t m) noexcept { portCLEAR_INTERRUPT_MASK_FROM_ISR(m); }
+	};
+#endif
+
+
+    //+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+    /*!
+        @brief  rtos_trace クラス @n
+				ダンプの構造（リトル・エンディアン）：@n
+				情報ブロック（BLOCK_SIZE）+ データ・ブロック（BLOCK_SIZE）* N @n
+				情報ブロック：@n
+				+0: "RTTR"、+4: VERSION (2)、+6: BLOCK_SIZE (2)、+8: 周波数 (4) @n
+				+12: ブロック数 (4) ０なら終端まで、+16: LOST 合計 (4) @n
+				+20: タスク数 (2)、+22: エントリー・サイズ (2) @n
+				+32: タスク・エントリー（番号 (2)、優先度 (1)、予約 (1)、名前 (12)）@n
+				データ・ブロック：@n
+				+0: 通番 (4)、+4: 使用バイト数 (2)、+6: 実行中タスク (2)、+8: 時間 (8) @n
+				+16: イベント（種別 (1)、時間差分、引数の LEB128）@n
+				※CREATE は引数の後に名前（長さ (1)、文字列）を持つ
+		@param[in]	TIMER		タイムスタンプ（BITS、start()、get_freq()、get_counter()）
+		@param[in]	LOCK		排他制御（lock()、unlock()）
+		@param[in]	BLOCK_NUM	データ・ブロック数
+		@param[in]	BLOCK_SIZE	ブロック・サイズ（ストリームの転送単位）
+		@param[in]	TASK_MAX	タスク名の最大登録数
+    */
+    //+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+	template <class TIMER, class LOCK, uint32_t BLOCK_NUM = 8, uint32_t BLOCK_SIZE = 512,
+		uint32_t TASK_MAX = 16>
+	class rtos_trace {
+	public:
+		static const uint16_t VERSION    = 1;	///< フォーマットのバージョン
+		static const uint32_t HEAD_SIZE  = 16;	///< データ・ブロックのヘッダー
+		static const uint32_t INFO_SIZE  = 32;	///< 情報ブロックのヘッダー
+		static const uint32_t ENTRY_SIZE = 16;	///< タスク・エントリー
+		static const uint32_t NAME_SIZE  = 12;	///< タスク名（終端を含まない）
+		static const uint32_t EVENT_MAX  = 32;	///< １イベントの最大バイト数
+
+		static_assert(BLOCK_NUM >= 2, "BLOCK_NUM must be 2 or more");
+		static_assert(BLOCK_SIZE <= 65535, "BLOCK_SIZE overflow");
+		static_assert(INFO_SIZE + ENTRY_SIZE * TASK_MAX <= BLOCK_SIZE, "TASK_MAX too large");
+		static_assert(HEAD_SIZE + EVENT_MAX * 2 <= BLOCK_SIZE, "BLOCK_SIZE too small");
+
+		//=================================================================//
+		/*!
+			@brief  記録モード
+		*/
+		//=================================================================//
+		enum class MODE : uint8_t {
+			RING,	///< 古いブロックを上書き（最後の期間が残る）
+			STREAM,	///< 読み出されるまで保持、満杯なら捨てて数える
+		};
+
+	private:
+		static const uint64_t MASK = (static_cast<uint64_t>(1) << TIMER::BITS) - 1;
+
+		uint8_t		info_[BLOCK_SIZE];
+		uint8_t		block_[BLOCK_NUM][BLOCK_SIZE];
+
+		uint64_t	ext_;
+		uint32_t	last_;
+		uint64_t	prev_;
+
+		uint32_t	seq_;
+		uint32_t	wr_;
+		uint32_t	rd_;
+		uint32_t	cnt_;
+		uint32_t	pos_;
+
+		uint32_t	lost_;
+		uint32_t	lost_total_;
+		uint32_t	task_num_;
+		uint32_t	shift_;
+
+		uint16_t	cur_;
+		MODE		mode_;
+		volatile bool	run_;
+
+		static void put16_(uint8_t* p, uint32_t v) noexcept
+		{
+			p[0] = v;
+			p[1] = v >> 8;
+		}
+
+		static void put32_(uint8_t* p, uint32_t v) noexcept
+		{
+			put16_(p, v);
+			put16_(p + 2, v >> 16);
+		}
+
+		static uint8_t* leb_(uint8_t* p, uint32_t v) noexcept
+		{
+			while(v >= 0x80) {
+				*p++ = (v & 0x7f) | 0x80;
+				v >>= 7;
+			}
+			*p++ = v;
+			return p;
+		}
+
+		static uint32_t nargs_(uint32_t ev) noexcept
+		{
+			switch(ev) {
+			case RTOS_TRACE_EV_DELAY:
+			case RTOS_TRACE_EV_NOTIFY:
+			case RTOS_TRACE_EV_TICK:
+			case RTOS_TRACE_EV_ISR_EXIT:
+				return 0;
+			case RTOS_TRACE_EV_CREATE:
+			case RTOS_TRACE_EV_USER:
+				return 2;
+			default:
+				return 1;
+			}
+		}
+
+		static uint32_t next_(uint32_t n) noexcept
+		{
+			++n;
+			if(n >= BLOCK_NUM) n = 0;
+			return n;
+		}
+
+		// 周回の間に一度は呼ばれる事
+		uint64_t time_() noexcept
+		{
+			uint32_t raw = TIMER::get_counter();
+			ext_ += (raw - last_) & MASK;
+			last_ = raw;
+			return ext_;
+		}
+
+		bool open_(uint64_t t) noexcept
+		{
+			if(cnt_ >= BLOCK_NUM) {
+				if(mode_ == MODE::STREAM) return false;
+				rd_ = next_(rd_);
+				--cnt_;
+			}
+			uint8_t* p = block_[wr_];
+			put32_(p + 0, seq_);
+			put16_(p + 4, 0);
+			put16_(p + 6, cur_);
+			put32_(p + 8, t);
+			put32_(p + 12, t >> 32);
+			++seq_;
+			pos_ = HEAD_SIZE;
+			prev_ = t;
+			return true;
+		}
+
+		void close_() noexcept
+		{
+			put16_(block_[wr_] + 4, pos_);
+			wr_ = next_(wr_);
+			++cnt_;
+			pos_ = 0;
+		}
+
+		void event_(uint32_t ev, uint64_t t, uint32_t a, uint32_t b, const char* name) noexcept
+		{
+			uint8_t* top = block_[wr_];
+			uint8_t* p = top + pos_;
+			*p++ = ev;
+			p = leb_(p, t - prev_);
+			auto n = nargs_(ev);
+			if(n >= 1) p = leb_(p, a);
+			if(n >= 2) p = leb_(p, b);
+			if(ev == RTOS_TRACE_EV_CREATE) {
+				uint32_t l = name != nullptr ? strnlen(name, NAME_SIZE) : 0;
+				*p++ = l;
+				std::memcpy(p, name, l);
+				p += l;
+			}
+			prev_ = t;
+			pos_ = p - top;
+		}
+
+		void put_(uint32_t ev, uint32_t a, uint32_t b, const char* name = nullptr) noexcept
+		{
+			auto t = time_();
+			// 捨てたイベントでも、次のブロックの実行中タスクは正しくする
+			if(ev == RTOS_TRACE_EV_SWITCH_IN) cur_ = a;
+			if(pos_ > 0 && ((pos_ + EVENT_MAX) > BLOCK_SIZE || (t - prev_) > 0xFFFFFFFFULL)) {
+				close_();
+			}
+			if(pos_ == 0) {
+				if(!open_(t)) {
+					++lost_;
+					return;
+				}
+				if(lost_ > 0) {
+					event_(RTOS_TRACE_EV_LOST, t, lost_, 0, nullptr);
+					lost_total_ += lost_;
+					lost_ = 0;
+				}
+			}
+			event_(ev, t, a, b, name);
+		}
+
+		void update_info_(uint32_t blocks) noexcept
+		{
+			std::memcpy(&info_[0], "RTTR", 4);
+			put16_(&info_[4], VERSION);
+			put16_(&info_[6], BLOCK_SIZE);
+			put32_(&info_[8], TIMER::get_freq());
+			put32_(&info_[12], blocks);
+			put32_(&info_[16], lost_total_ + lost_);
+			put16_(&info_[20], task_num_);
+			put16_(&info_[22], ENTRY_SIZE);
+		}
+
+		bool stop_() noexcept
+		{
+			auto run = run_;
+			run_ = false;
+			auto m = LOCK::lock();
+			if(pos_ > HEAD_SIZE) close_();
+			LOCK::unlock(m);
+			return run;
+		}
+
+	public:
+		//-------------------------------------------------------------//
+		/*!
+			@brief  コンストラクター
+		*/
+		//-------------------------------------------------------------//
+		rtos_trace() noexcept : info_{ 0 },
+			ext_(0), last_(0), prev_(0), seq_(0), wr_(0), rd_(0), cnt_(0), pos_(0),
+			lost_(0), lost_total_(0), task_num_(0), shift_(0),
+			cur_(0), mode_(MODE::RING), run_(false)
+		{ }
+
+
+		//-------------------------------------------------------------//
+		/*!
+			@brief  開始 @n
+					※タスク名を得る為、タスク生成より前に呼ぶ事
+			@param[in]	mode	記録モード
+			@param[in]	shift	実行時間統計カウンターの右シフト量 @n
+								（３２ビットで周回する期間を延ばす）
+		*/
+		//-------------------------------------------------------------//
+		void start(MODE mode = MODE::RING, uint32_t shift = 0) noexcept
+		{
+			run_ = false;
+			TIMER::start();
+			auto m = LOCK::lock();
+			mode_ = mode;
+			shift_ = shift;
+			last_ = TIMER::get_counter();
+			ext_ = 0;
+			seq_ = 0;
+			wr_ = 0;
+			rd_ = 0;
+			cnt_ = 0;
+			pos_ = 0;
+			lost_ = 0;
+			lost_total_ = 0;
+			LOCK::unlock(m);
+			run_ = true;
+		}
+
+
+		//-------------------------------------------------------------//
+		/*!
+			@brief  記録の許可、禁止
+			@param[in]	ena		「false」なら禁止
+		*/
+		//-------------------------------------------------------------//
+		void enable(bool ena = true) noexcept
+		{
+			if(ena) run_ = true;
+			else stop_();
+		}
+
+
+		//-------------------------------------------------------------//
+		/*!
+			@brief  イベントの記録
+			@param[in]	ev	イベント ID（RTOS_TRACE_EV_xxx）
+			@param[in]	a	引数１
+			@param[in]	b	引数２
+		*/
+		//-------------------------------------------------------------//
+		void put(uint32_t ev, uint32_t a = 0, uint32_t b = 0) noexcept
+		{
+			auto m = LOCK::lock();
+			if(run_) put_(ev, a, b);
+			LOCK::unlock(m);
+		}
+
+
+		//-------------------------------------------------------------//
+		/*!
+			@brief  ユーザー・イベントの記録
+			@param[in]	id		ID
+			@param[in]	value	値
+		*/
+		//-------------------------------------------------------------//
+		void user(uint32_t id, uint32_t value) noexcept
+		{
+			put(RTOS_TRACE_EV_USER, id, value);
+		}
+
+
+		//-------------------------------------------------------------//
+		/*!
+			@brief  タスクの登録（traceTASK_CREATE から呼ばれる）
+			@param[in]	id		タスク番号
+			@param[in]	name	タスク名
+			@param[in]	prio	優先度
+		*/
+		//-------------------------------------------------------------//
+		void task(uint32_t id, const char* name, uint32_t prio) noexcept
+		{
+			auto m = LOCK::lock();
+			if(task_num_ < TASK_MAX) {
+				uint8_t* p = &info_[INFO_SIZE + task_num_ * ENTRY_SIZE];
+				put16_(p, id);
+				p[2] = prio;
+				p[3] = 0;
+				std::strncpy(reinterpret_cast<char*>(p + 4), name, NAME_SIZE);
+				++task_num_;
+			}
+			if(run_) put_(RTOS_TRACE_EV_CREATE, id, prio, name);
+			LOCK::unlock(m);
+		}
+
+
+		//-------------------------------------------------------------//
+		/*!
+			@brief  実行時間統計のカウンター（portGET_RUN_TIME_COUNTER_VALUE）
+			@return カウンター
+		*/
+		//-------------------------------------------------------------//
+		uint32_t get_runtime() noexcept
+		{
+			auto m = LOCK::lock();
+			auto t = time_();
+			LOCK::unlock(m);
+			return t >> shift_;
+		}
+
+
+		//-------------------------------------------------------------//
+		/*!
+			@brief  記録中のブロックを閉じる（ストリームで早く送りたい場合）
+		*/
+		//-------------------------------------------------------------//
+		void flush() noexcept
+		{
+			auto m = LOCK::lock();
+			if(pos_ > HEAD_SIZE) close_();
+			LOCK::unlock(m);
+		}
+
+
+		//-------------------------------------------------------------//
+		/*!
+			@brief  失ったイベント数を取得
+			@return 失ったイベント数
+		*/
+		//-------------------------------------------------------------//
+		uint32_t get_lost() const noexcept { return lost_total_ + lost_; }
+
+
+		//-------------------------------------------------------------//
+		/*!
+			@brief  情報ブロックを取得（ストリームの先頭に送る）
+			@param[in]	blocks	続くブロック数（０なら終端まで）
+			@return 情報ブロック（BLOCK_SIZE バイト）
+		*/
+		//-------------------------------------------------------------//
+		const uint8_t* get_info(uint32_t blocks = 0) noexcept
+		{
+			auto m = LOCK::lock();
+			update_info_(blocks);
+			LOCK::unlock(m);
+			return info_;
+		}
+
+
+		//-------------------------------------------------------------//
+		/*!
+			@brief  最も古い完成ブロックを取得 @n
+					※リング・モードでは、enable(false) してから読む事
+			@return ブロック（BLOCK_SIZE バイト）、無い場合「nullptr」
+		*/
+		//-------------------------------------------------------------//
+		const uint8_t* get_block() const noexcept
+		{
+			return cnt_ > 0 ? block_[rd_] : nullptr;
+		}
+
+
+		//-------------------------------------------------------------//
+		/*!
+			@brief  get_block で得たブロックを解放
+		*/
+		//-------------------------------------------------------------//
+		void free_block() noexcept
+		{
+			auto m = LOCK::lock();
+			if(cnt_ > 0) {
+				rd_ = next_(rd_);
+				--cnt_;
+			}
+			LOCK::unlock(m);
+		}
+
+
+		//-------------------------------------------------------------//
+		/*!
+			@brief  完成ブロック数を取得
+			@return 完成ブロック数
+		*/
+		//-------------------------------------------------------------//
+		uint32_t get_block_num() const noexcept { return cnt_; }
+
+
+		//-------------------------------------------------------------//
+		/*!
+			@brief  記録の１６進ダンプ（rtostrace 用、'#' で始まる行）@n
+					記録は一時停止され、出力したブロックは解放される
+		*/
+		//-------------------------------------------------------------//
+		template <class FORM = utils::format>
+		void dump() noexcept
+		{
+			auto run = stop_();
+			auto n = cnt_;
+			const uint8_t* p = get_info(n);
+			for(uint32_t i = 0; i <= n; ++i) {
+				FORM("#");
+				for(uint32_t j = 0; j < BLOCK_SIZE; ++j) {
+					FORM("%02X") % static_cast<uint32_t>(p[j]);
+				}
+				FORM("\n");
+				if(i > 0) free_block();
+				p = get_block();
+			}
+			run_ = run;
+		}
+
+
+#ifdef FAT_FS
+		//-------------------------------------------------------------//
+		/*!
+			@brief  記録をファイルに保存（バイナリ）@n
+					記録は一時停止され、保存したブロックは解放される
+			@param[in]	path	ファイル名
+			@return 成功なら「true」
+		*/
+		//-------------------------------------------------------------//
+		bool save(const char* path) noexcept
+		{
+			auto run = stop_();
+			utils::file_io fio;
+			bool ret = fio.open(path, "wb");
+			if(ret) {
+				auto n = cnt_;
+				ret = fio.write(get_info(n), BLOCK_SIZE) == BLOCK_SIZE;
+				for(uint32_t i = 0; ret && i < n; ++i) {
+					ret = fio.write(get_block(), BLOCK_SIZE) == BLOCK_SIZE;
+					free_block();
+				}
+				fio.close();
+			}
+			run_ = run;
+			return ret;
+		}
+#endif
+
+
+#ifdef RTOS
+		//-------------------------------------------------------------//
+		/*!
+			@brief  タスク毎の実行時間統計を表示
+		*/
+		//-------------------------------------------------------------//
+		template <class FORM = utils::format>
+		void list_stats() noexcept
+		{
+			TaskStatus_t st[TASK_MAX];
+			uint32_t total = 0;
+			auto n = uxTaskGetSystemState(st, TASK_MAX, &total);
+			FORM("%-12s %4s %10s %6s %6s\n") % "Name" % "Prio" % "Time" % "CPU" % "Stack";
+			for(uint32_t i = 0; i < n; ++i) {
+				const auto& t = st[i];
+				uint32_t pm = 0;
+				if(total > 0) {
+					pm = static_cast<uint64_t>(t.ulRunTimeCounter) * 1000 / total;
+				}
+				FORM("%-12s %4u %10u %3u.%u%% %6u\n")
+					% t.pcTaskName % static_cast<uint32_t>(t.uxCurrentPriority)
+					% t.ulRunTimeCounter % (pm / 10) % (pm % 10)
+					% static_cast<uint32_t>(t.usStackHighWaterMark);
+			}
+			FORM("Trace: %u blocks, lost %u\n") % cnt_ % get_lost();
+		}
+#endif
+	};
+}
@@ -16,6 +16,7 @@
 #include "common/time.h"
 #include "common/format.hpp"
 #include "common/input.hpp"
+#include "common/code_conv.hpp"
 
 /// string, vector が使える環境
 // #define STRING_VECTOR
@@ -164,45 +165,24 @@ namespace utils {
 
 		//-----------------------------------------------------------------//
 		/*!
-			@brief  UTF-8 から UTF-16 への変換
+			@brief  UTF-8 から UTF-16 への変換 @n
+					※不正なシーケンスは U+FFFD に置き換える
 			@param[in]	src	ソース
 			@param[in]	dst	変換先
 			@param[in]	dsz	変換先のサイズ（バイトサイズ）
-			@return 正常終了なら「true」
+			@return 正常終了なら「true」（変換先が足りない場合「false」）
 		*/
 		//-----------------------------------------------------------------//
 		static bool utf8_to_utf16(const char* src, uint16_t* dst, uint32_t dsz) noexcept
 		{
 			uint32_t len = dsz / 2;
 			if(len <= 1) return false;
- 
-			uint8_t cnt = 0;
-			uint16_t code = 0;
-			char tc;
-			while((tc = *src++) != 0 && len > 1) {
-				uint8_t c = static_cast<uint8_t>(tc);
-				if(c < 0x80) { code = c; cnt = 0; }
-				else if((c & 0xf0) == 0xe0) { code = (c & 0x0f); cnt = 2; }
-				else if((c & 0xe0) == 0xc0) { code = (c & 0x1f); cnt = 1; }
-				else if((c & 0xc0) == 0x80) {
-					code <<= 6;
-					code |= c & 0x3f;
-					cnt--;
-					if(cnt == 0 && code < 0x80) {
-						code = 0;	// 不正なコードとして無視
-						break;
-					} else if(cnt < 0) {
-						code = 0;
-					}
-				}
-				if(cnt == 0 && code != 0) {
-					*dst++ = code;
-					--len;
-					code = 0;
-				}
-			}
-			*dst = 0;
-			return len >= 1;
+
+			uint32_t slen = std::strlen(src);
+			code_conv::state_t st;
+			auto r = code_conv::utf8_to_utf16(src, slen, dst, len - 1, st);
+			dst[r.dst] = 0;
+			return r.src == slen;
 		}
 
 
@@ -254,24 +234,18 @@ namespace utils {
 		{
 			if(dsz <= 1) return false;
 
-			uint16_t code;
-			while((code = *src++) != 0) {
-				auto len = utf16_to_utf8(code, dst, dsz);
-				if(dsz > len) {
-					dsz -= len;
-					dst += len;
-				} else {
-					break;
-				}
-			}
-			*dst = 0;
-			return dsz >= 1;
+			uint32_t slen = 0;
+			while(src[slen] != 0) ++slen;
+			code_conv::state_t st;
+			auto r = code_conv::utf16_to_utf8(src, slen, dst, dsz - 1, st);
+			dst[r.dst] = 0;
+			return r.src == slen;
 		}
 
-#if FF_USE_LFN != 0
+
 		//-----------------------------------------------------------------//
 		/*!
-			@brief  OEM code から UTF-8 への変換
+			@brief  OEM code (CP932) から UTF-8 への変換
 			@param[in]	src	ソース
 			@param[in]	dst	変換先
 			@param[in]	dsz	変換先のサイズ
@@ -280,48 +254,20 @@ namespace utils {
 		//-----------------------------------------------------------------//
 		static bool oemc_to_utf8(const char* src, char* dst, uint32_t dsz) noexcept
 		{
-			if(src == nullptr) return false;
+			if(src == nullptr || dsz <= 1) return false;
 
-			uint16_t wc = 0;
-			char ch;
-			while((ch = *src++) != 0 && dsz > 1) {
-				uint8_t c = static_cast<uint8_t>(ch);
-				if(wc) {
-					if(0x40 <= c && c <= 0x7e) {
-						wc <<= 8;
-						wc |= c;
-						uint16_t tmp = ff_oem2uni(wc, FF_CODE_PAGE);
-						auto len = utf16_to_utf8(tmp, dst, dsz);
-						if(len == 0) break;
-						dst += len;
-						dsz -= len;
-					} else if(0x80 <= c && c <= 0xfc) {
-						wc <<= 8;
-						wc |= c;
-						uint16_t tmp = ff_oem2uni(wc, FF_CODE_PAGE);
-						auto len = utf16_to_utf8(tmp, dst, dsz);
-						if(len == 0) break;
-						dst += len;
-						dsz -= len;
-					}
-					wc = 0;
-				} else {
-					if(0x81 <= c && c <= 0x9f) wc = c;
-					else if(0xe0 <= c && c <= 0xfc) wc = c;
-					else {
-						*dst++ = c;
-						dsz -= 1;
-					}
-				}
-			}
-			*dst = 0;
-			return dsz > 0;
+			uint32_t slen = std::strlen(src);
+			code_conv::state_t st;
+			auto r = code_conv::sjis_to_utf8(src, slen, dst, dsz - 1, st);
+			dst[r.dst] = 0;
+			return r.src == slen;
 		}
 
 
 		//-----------------------------------------------------------------//
 		/*!
-			@brief  UTF-8 から OEM code への変換
+			@brief  UTF-8 から OEM code (CP932) への変換 @n
+					※変換出来ない文字は「?」に置き換える
 			@param[in]	src	ソース
 			@param[out]	dst	変換先
 			@param[in]	dsz	変換先のサイズ
@@ -330,46 +276,14 @@ namespace utils {
 		//-----------------------------------------------------------------//
 		static bool utf8_to_oemc(const char* src, char* dst, uint32_t dsz) noexcept
 		{
-			int8_t cnt = 0;
-			uint16_t code = 0;
-			char tc;
-			while((tc = *src++) != 0) {
-				uint8_t c = static_cast<uint8_t>(tc);
-				if(c < 0x80) {
-					if(dsz <= 1) break;
-					*dst++ = tc;
-					code = 0;
-					--dsz;
-				} else if((c & 0xf0) == 0xe0) {
-					code = (c & 0x0f);
-					cnt = 2;
-				} else if((c & 0xe0) == 0xc0) {
-					code = (c & 0x1f);
-					cnt = 1;
-				} else if((c & 0xc0) == 0x80) {
-					code <<= 6;
-					code |= c & 0x3f;
-					cnt--;
-					if(cnt == 0 && code < 0x80) {
-						code = 0;	// 不正なコードとして無視
-						break;
-					} else if(cnt < 0) {
-						code = 0;
-					}
-				}
-				if(cnt == 0 && code != 0) {
-					if(dsz <= 3) break;
-					auto wc = ff_uni2oem(code, FF_CODE_PAGE);
-					*dst++ = static_cast<char>(wc >> 8);
-					*dst++ = static_cast<char>(wc & 0xff);
-					dsz -= 2;
-					code = 0;
-				}			
-			}
-			*dst = 0;
-			return dsz > 0;
+			if(dsz <= 1) return false;
+
+			uint32_t slen = std::strlen(src);
+			code_conv::state_t st;
+			auto r = code_conv::utf8_to_sjis(src, slen, dst, dsz - 1, st);
+			dst[r.dst] = 0;
+			return r.src == slen;
 		}
-#endif
 
 
 #ifdef FAT_FS
@@ -0,0 +1,285 @@
+//=====================================================================//
+/*!	@file
+	@brief	CP932 (Shift-JIS) <-> Unicode 直接参照テーブル・ジェネレーター @n
+			・FatFs の「ffunicode.c」から、「uni2oem932」、「oem2uni932」の @n
+			  ペア・テーブルを読み込み、「common/cp932_tbl.hpp」を生成する @n
+			・SJIS -> Unicode：先行バイト -> 行、後続バイト -> 列の二段 @n
+			・Unicode -> SJIS：上位８ビット -> ページ、下位８ビット -> 列の二段
+    @author 平松邦仁 (hira@rvf-rc45.net)
+	@copyright	Copyright (C) 2021 Kunihito Hiramatsu @n
+				Released under the MIT license @n
+				https://github.com/hirakuni45/RX/blob/master/LICENSE
+*/
+//=====================================================================//
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+namespace {
+
+	static const char* version_ = "0.50b";
+
+	typedef std::vector<std::pair<uint16_t, uint16_t>> PAIRS;
+
+	std::string	src_;
+
+
+	bool load_(const std::string& file)
+	{
+		std::ifstream ifs(file, std::ios::binary);
+		if(!ifs) return false;
+		src_.assign(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+		return true;
+	}
+
+
+	// 「static const WCHAR name[] = { ... };」の中の１６進数を読む
+	bool scan_pairs_(const char* name, PAIRS& out)
+	{
+		std::string key = std::string(name) + "[]";
+		auto pos = src_.find(key);
+		if(pos == std::string::npos) return false;
+		pos = src_.find('{', pos);
+		auto end = src_.find('}', pos);
+		if(pos == std::string::npos || end == std::string::npos) return false;
+
+		std::vector<uint16_t> v;
+		const char* p = src_.c_str() + pos + 1;
+		const char* e = src_.c_str() + end;
+		while(p < e) {
+			if(p[0] == '/' && p[1] == '*') {
+				auto q = std::strstr(p + 2, "*/");
+				if(q == nullptr) return false;
+				p = q + 2;
+			} else if(p[0] == '0' && (p[1] == 'x' || p[1] == 'X')) {
+				char* q;
+				v.push_back(static_cast<uint16_t>(std::strtoul(p, &q, 16)));
+				p = q;
+			} else {
+				++p;
+			}
+		}
+		if(v.empty() || (v.size() & 1) != 0) return false;
+		for(uint32_t i = 0; i < v.size(); i += 2) {
+			out.emplace_back(v[i], v[i + 1]);
+		}
+		return true;
+	}
+
+
+	void out_u16_(std::ostream& os, const uint16_t* p, uint32_t n)
+	{
+		char tmp[16];
+		for(uint32_t i = 0; i < n; ++i) {
+			if((i % 16) == 0) os << "\t\t\t";
+			snprintf(tmp, sizeof(tmp), "0x%04X,", p[i]);
+			os << tmp;
+			if((i % 16) == 15) os << '\n';
+			else os << ' ';
+		}
+	}
+
+
+	void out_u8_(std::ostream& os, const uint8_t* p, uint32_t n)
+	{
+		char tmp[16];
+		for(uint32_t i = 0; i < n; ++i) {
+			if((i % 16) == 0) os << "\t\t";
+			snprintf(tmp, sizeof(tmp), "%3u,", p[i]);
+			os << tmp;
+			if((i % 16) == 15) os << '\n';
+			else os << ' ';
+		}
+	}
+
+
+	bool is_lead_(uint32_t c)
+	{
+		return (0x81 <= c && c <= 0x9f) || (0xe0 <= c && c <= 0xfc);
+	}
+
+
+	void help_(const char* cmd)
+	{
+		std::string s = cmd;
+		auto p = s.find_last_of("/\\");
+		if(p != std::string::npos) s = s.substr(p + 1);
+		std::cout << "CP932 <-> Unicode table generator Version " << version_ << std::endl;
+		std::cout << "usage:" << std::endl;
+		std::cout << "    " << s << " ffunicode.c [output.hpp]" << std::endl;
+		std::cout << "ex: " << s << " ../ff14/source/ffunicode.c ../common/cp932_tbl.hpp" << std::endl;
+	}
+}
+
+
+int main(int argc, char* argv[])
+{
+	if(argc < 2) {
+		help_(argv[0]);
+		return 1;
+	}
+
+	if(!load_(argv[1])) {
+		std::cerr << "Can't open source: '" << argv[1] << "'" << std::endl;
+		return 1;
+	}
+
+	PAIRS u2s;
+	PAIRS s2u;
+	if(!scan_pairs_("uni2oem932", u2s) || !scan_pairs_("oem2uni932", s2u)) {
+		std::cerr << "Can't find CP932 pair tables: '" << argv[1] << "'" << std::endl;
+		return 1;
+	}
+
+	// SJIS -> Unicode
+	// 行０：１バイト・コード（ASCII、半角カナ）、行１：マップの無い先行バイト
+	uint8_t lead[256];
+	std::vector<uint16_t> rows(2 * 256, 0);
+	for(uint32_t i = 0; i < 0x80; ++i) rows[i] = i;
+	for(uint32_t i = 0; i < 256; ++i) lead[i] = is_lead_(i) ? 1 : 0;
+	for(const auto& t : s2u) {
+		auto sj = t.first;
+		if(sj < 0x100) {
+			if(is_lead_(sj)) {
+				std::cerr << "Lead byte mapped as single byte: " << sj << std::endl;
+				return 1;
+			}
+			rows[sj] = t.second;
+			continue;
+		}
+		uint32_t hi = sj >> 8;
+		if(!is_lead_(hi)) {
+			std::cerr << "Illegal lead byte: " << hi << std::endl;
+			return 1;
+		}
+		if(lead[hi] == 1) {
+			lead[hi] = rows.size() / 256;
+			rows.resize(rows.size() + 256, 0);
+		}
+		rows[lead[hi] * 256 + (sj & 0xff)] = t.second;
+	}
+
+	// Unicode -> SJIS
+	// ページ０：マップの無いページ
+	uint8_t page[256];
+	std::memset(page, 0, sizeof(page));
+	std::vector<uint16_t> pages(2 * 256, 0);
+	page[0] = 1;
+	for(uint32_t i = 0; i < 0x80; ++i) pages[256 + i] = i;
+	for(const auto& t : u2s) {
+		uint32_t hi = t.first >> 8;
+		if(page[hi] == 0) {
+			page[hi] = pages.size() / 256;
+			pages.resize(pages.size() + 256, 0);
+		}
+		pages[page[hi] * 256 + (t.first & 0xff)] = t.second;
+	}
+	// １バイト・コード（半角カナ）は、oem2uni 側にしか無い
+	for(uint32_t i = 0x80; i < 0x100; ++i) {
+		auto u = rows[i];
+		if(u == 0) continue;
+		uint32_t hi = u >> 8;
+		if(page[hi] == 0) {
+			page[hi] = pages.size() / 256;
+			pages.resize(pages.size() + 256, 0);
+		}
+		auto& d = pages[page[hi] * 256 + (u & 0xff)];
+		if(d == 0) d = i;
+	}
+
+	// 往復の確認
+	uint32_t error = 0;
+	for(const auto& t : s2u) {
+		auto sj = t.first;
+		uint32_t r = sj < 0x100 ? 0 : lead[sj >> 8];
+		if(rows[r * 256 + (sj & 0xff)] != t.second) ++error;
+	}
+	for(const auto& t : u2s) {
+		if(pages[page[t.first >> 8] * 256 + (t.first & 0xff)] != t.second) ++error;
+	}
+	if(error > 0) {
+		std::cerr << "Table verify error: " << error << std::endl;
+		return 1;
+	}
+	if(rows.size() / 256 > 255 || pages.size() / 256 > 255) {
+		std::cerr << "Too many rows/pages" << std::endl;
+		return 1;
+	}
+
+	std::ofstream ofs;
+	if(argc >= 3) {
+		ofs.open(argv[2], std::ios::binary);
+		if(!ofs) {
+			std::cerr << "Can't open output: '" << argv[2] << "'" << std::endl;
+			return 1;
+		}
+	}
+	std::ostream& os = (argc >= 3) ? ofs : std::cout;
+
+	uint32_t nrow = rows.size() / 256;
+	uint32_t npage = pages.size() / 256;
+	os << "#pragma once\n";
+	os << "//=====================================================================//\n";
+	os << "/*!\t@file\n";
+	os << "\t@brief\tCP932 (Shift-JIS) <-> Unicode 直接参照テーブル @n\n";
+	os << "\t\t\t※「cp932gen」で「ff14/source/ffunicode.c」から生成、編集しない事 @n\n";
+	os << "\t\t\tSJIS -> Unicode: " << s2u.size() << " codes, " << nrow << " rows @n\n";
+	os << "\t\t\tUnicode -> SJIS: " << u2s.size() << " codes, " << npage << " pages @n\n";
+	os << "\t\t\tROM: " << (256 + nrow * 512 + 256 + npage * 512) << " bytes\n";
+	os << "    @author 平松邦仁 (hira@rvf-rc45.net)\n";
+	os << "\t@copyright\tCopyright (C) 2021 Kunihito Hiramatsu @n\n";
+	os << "\t\t\t\tReleased under the MIT license @n\n";
+	os << "\t\t\t\thttps://github.com/hirakuni45/RX/blob/master/LICENSE\n";
+	os << "*/\n";
+	os << "//=====================================================================//\n";
+	os << "#include <cstdint>\n\n";
+	os << "namespace utils {\n\n";
+	os << "\t//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//\n";
+	os << "\t/*!\n";
+	os << "\t\t@brief  CP932 テーブル @n\n";
+	os << "\t\t\t\tSJIS -> Unicode: sjis_[lead_[b1]][b2]、lead_ が０なら１バイト (sjis_[0][b1]) @n\n";
+	os << "\t\t\t\tUnicode -> SJIS: uni_[page_[u >> 8]][u & 0xff] @n\n";
+	os << "\t\t\t\t※マップが無い場合は０\n";
+	os << "\t*/\n";
+	os << "\t//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//\n";
+	os << "\ttemplate <class _>\n";
+	os << "\tstruct cp932_tbl_ {\n\n";
+	os << "\t\tstatic const uint32_t ROWS  = " << nrow << ";\n";
+	os << "\t\tstatic const uint32_t PAGES = " << npage << ";\n\n";
+	os << "\t\tstatic const uint8_t  lead_[256];\n";
+	os << "\t\tstatic const uint16_t sjis_[ROWS][256];\n";
+	os << "\t\tstatic const uint8_t  page_[256];\n";
+	os << "\t\tstatic const uint16_t uni_[PAGES][256];\n";
+	os << "\t};\n";
+	os << "\ttypedef cp932_tbl_<void> cp932_tbl;\n\n";
+	os << "\ttemplate <class _> const uint8_t cp932_tbl_<_>::lead_[256] = {\n";
+	out_u8_(os, lead, 256);
+	os << "\t};\n\n";
+	os << "\ttemplate <class _> const uint16_t cp932_tbl_<_>::sjis_[ROWS][256] = {\n";
+	for(uint32_t i = 0; i < nrow; ++i) {
+		os << "\t\t{\n";
+		out_u16_(os, &rows[i * 256], 256);
+		os << "\t\t},\n";
+	}
+	os << "\t};\n\n";
+	os << "\ttemplate <class _> const uint8_t cp932_tbl_<_>::page_[256] = {\n";
+	out_u8_(os, page, 256);
+	os << "\t};\n\n";
+	os << "\ttemplate <class _> const uint16_t cp932_tbl_<_>::uni_[PAGES][256] = {\n";
+	for(uint32_t i = 0; i < npage; ++i) {
+		os << "\t\t{\n";
+		out_u16_(os, &pages[i * 256], 256);
+		os << "\t\t},\n";
+	}
+	os << "\t};\n";
+	os << "}\n";
+
+	std::cerr << "SJIS -> Unicode: " << s2u.size() << " codes, " << nrow << " rows" << std::endl;
+	std::cerr << "Unicode -> SJIS: " << u2s.size() << " codes, " << npage << " pages" << std::endl;
+	return 0;
+}
@@ -0,0 +1,507 @@
+#pragma once
+//=====================================================================//
+/*!	@file
+	@brief	FatFs diskio セクター・キャッシュ @n
+			・mmc_io、sdhi_io、usb::hmsc 等の disk_xxx を持つクラスを包む @n
+			・FAT/ディレクトリーの様な単発セクターは、セット・アソシエイティブ @n
+			  （LRU）キャッシュに保持して、ライト・バックする @n
+			・連続したセクターの読み出しを検出すると、先読みの窓を広げて @n
+			  （2, 4, 8 ... RA_MAX）マルチ・ブロック（CMD18）で読む @n
+			・ダーティー・セクターは連続した範囲をまとめて（CMD25）書く @n
+			・CTRL_SYNC（f_sync、f_close）で、全てのダーティー・セクターを書く
+    @author 平松邦仁 (hira@rvf-rc45.net)
+	@copyright	Copyright (C) 2021 Kunihito Hiramatsu @n
+				Released under the MIT license @n
+				https://github.com/hirakuni45/RX/blob/master/LICENSE
+*/
+//=====================================================================//
+#include <cstring>
+#include <algorithm>
+#include "ff14/source/ff.h"
+#include "ff14/source/diskio.h"
+
+namespace fatfs {
+
+	//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+	/*!
+		@brief  diskio セクター・キャッシュ・テンプレートクラス
+		@param[in]	DEV		ドライバー・クラス（disk_status, disk_initialize, @n
+							disk_read, disk_write, disk_ioctl）
+		@param[in]	SETS	セット数（２のべき乗）
+		@param[in]	WAYS	ウェイ数
+		@param[in]	RA_MAX	先読みの最大セクター数（ライト・バックのまとめ書きにも使う）
+	*/
+	//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+	template <class DEV, uint32_t SETS = 8, uint32_t WAYS = 4, uint32_t RA_MAX = 16>
+	class disk_cache {
+
+		static_assert((SETS & (SETS - 1)) == 0, "SETS must be a power of 2");
+		static_assert(WAYS > 0 && WAYS <= 255, "WAYS out of range");
+		static_assert(RA_MAX >= 2, "RA_MAX must be 2 or more");
+
+	public:
+		static const uint32_t SECTOR_SIZE = 512;	///< セクター・サイズ
+
+		//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+		/*!
+			@brief  統計情報
+		*/
+		//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+		struct stat_t {
+			uint32_t	read_hit;		///< キャッシュでの読み出し（セクター）
+			uint32_t	ra_hit;			///< 先読みでの読み出し（セクター）
+			uint32_t	read_miss;		///< ミス（セクター）
+			uint32_t	write_hit;		///< キャッシュへの書き込み（セクター）
+			uint32_t	write_back;		///< ライト・バックしたセクター
+			uint32_t	dev_read;		///< デバイス読み出しコマンド数
+			uint32_t	dev_read_sec;	///< デバイス読み出しセクター数
+			uint32_t	dev_write;		///< デバイス書き込みコマンド数
+			uint32_t	dev_write_sec;	///< デバイス書き込みセクター数
+			uint32_t	error;			///< デバイス・エラー数
+			stat_t() noexcept : read_hit(0), ra_hit(0), read_miss(0), write_hit(0), write_back(0),
+				dev_read(0), dev_read_sec(0), dev_write(0), dev_write_sec(0), error(0) { }
+		};
+
+	private:
+		static const uint32_t INVALID = 0xFFFFFFFF;
+
+		struct line_t {
+			uint32_t	sector;
+			uint32_t	stamp;
+			bool		dirty;
+			line_t() noexcept : sector(INVALID), stamp(0), dirty(false) { }
+		};
+
+		DEV&		dev_;
+
+		line_t		line_[SETS * WAYS];
+		uint8_t		data_[SETS * WAYS][SECTOR_SIZE];
+
+		// 先読みの窓（ライト・バック時のまとめ書きの作業領域を兼ねる）
+		uint8_t		ra_buf_[RA_MAX * SECTOR_SIZE];
+		uint32_t	ra_org_;
+		uint32_t	ra_num_;
+		uint32_t	ra_len_;		// 次の先読みのセクター数
+		uint32_t	ra_next_;		// ストリームの次のセクター
+		uint32_t	miss_[2];		// 直近のミス・セクター（ストリームの検出）
+
+		uint32_t	limit_;			// セクター数（0 なら不明）
+		uint32_t	stamp_;
+		uint32_t	dirty_num_;
+		bool		enable_;
+
+		stat_t		stat_;
+
+
+		line_t* find_(uint32_t sector) noexcept
+		{
+			auto* l = &line_[(sector & (SETS - 1)) * WAYS];
+			for(uint32_t i = 0; i < WAYS; ++i) {
+				if(l[i].sector == sector) return &l[i];
+			}
+			return nullptr;
+		}
+
+
+		uint8_t* data_at_(const line_t* l) noexcept { return data_[l - line_]; }
+
+
+		DRESULT dev_read_(BYTE drv, void* dst, uint32_t sector, uint32_t count) noexcept
+		{
+			++stat_.dev_read;
+			stat_.dev_read_sec += count;
+			auto ret = dev_.disk_read(drv, static_cast<BYTE*>(dst), sector, count);
+			if(ret != RES_OK) ++stat_.error;
+			return ret;
+		}
+
+
+		DRESULT dev_write_(BYTE drv, const void* src, uint32_t sector, uint32_t count) noexcept
+		{
+			++stat_.dev_write;
+			stat_.dev_write_sec += count;
+			auto ret = dev_.disk_write(drv, static_cast<const BYTE*>(src), sector, count);
+			if(ret != RES_OK) ++stat_.error;
+			return ret;
+		}
+
+
+		// 連続するダーティー・セクターをまとめて書く（先読みの窓を作業領域に使う）
+		DRESULT flush_run_(BYTE drv, uint32_t sector) noexcept
+		{
+			auto org = sector;
+			while(org > 0 && (sector - org) < (RA_MAX - 1)) {
+				auto* l = find_(org - 1);
+				if(l == nullptr || !l->dirty) break;
+				--org;
+			}
+			uint32_t num = 0;
+			while(num < RA_MAX) {
+				auto* l = find_(org + num);
+				if(l == nullptr || !l->dirty) break;
+				std::memcpy(&ra_buf_[num * SECTOR_SIZE], data_at_(l), SECTOR_SIZE);
+				++num;
+			}
+			ra_num_ = 0;
+			if(num == 0) return RES_OK;
+
+			auto ret = dev_write_(drv, ra_buf_, org, num);
+			if(ret != RES_OK) return ret;
+			for(uint32_t i = 0; i < num; ++i) {
+				find_(org + i)->dirty = false;
+			}
+			dirty_num_ -= num;
+			stat_.write_back += num;
+			return RES_OK;
+		}
+
+
+		// ラインを確保（無効なライン、又は、最も古いライン）
+		line_t* alloc_(BYTE drv, uint32_t sector, DRESULT& ret) noexcept
+		{
+			ret = RES_OK;
+			auto* l = &line_[(sector & (SETS - 1)) * WAYS];
+			line_t* v = &l[0];
+			for(uint32_t i = 0; i < WAYS; ++i) {
+				if(l[i].sector == INVALID) {
+					v = &l[i];
+					break;
+				}
+				if(l[i].stamp < v->stamp) v = &l[i];
+			}
+			if(v->sector != INVALID && v->dirty) {
+				ret = flush_run_(drv, v->sector);
+				if(ret != RES_OK) return nullptr;
+			}
+			v->sector = sector;
+			v->dirty = false;
+			return v;
+		}
+
+
+		bool in_ra_(uint32_t sector) const noexcept
+		{
+			return ra_num_ > 0 && sector >= ra_org_ && sector < (ra_org_ + ra_num_);
+		}
+
+
+		// 先読み（失敗したら窓を無効にする）
+		bool read_ahead_(BYTE drv, uint32_t sector) noexcept
+		{
+			auto n = ra_len_;
+			if(limit_ > 0) {
+				if(sector >= limit_) return false;
+				if((limit_ - sector) < n) n = limit_ - sector;
+			}
+			ra_num_ = 0;
+			if(dev_read_(drv, ra_buf_, sector, n) != RES_OK) return false;
+			ra_org_ = sector;
+			ra_num_ = n;
+			// ストリームが続く限り、次の窓を広げる
+			if(ra_len_ < RA_MAX) ra_len_ = std::min(ra_len_ * 2, RA_MAX);
+			// ダーティー・セクターを窓に反映
+			if(dirty_num_ > 0) {
+				for(uint32_t i = 0; i < n; ++i) {
+					auto* l = find_(sector + i);
+					if(l != nullptr && l->dirty) {
+						std::memcpy(&ra_buf_[i * SECTOR_SIZE], data_at_(l), SECTOR_SIZE);
+					}
+				}
+			}
+			return true;
+		}
+
+
+		DRESULT read_one_(BYTE drv, BYTE* buff, uint32_t sector) noexcept
+		{
+			auto* l = find_(sector);
+			if(l != nullptr) {
+				l->stamp = ++stamp_;
+				std::memcpy(buff, data_at_(l), SECTOR_SIZE);
+				++stat_.read_hit;
+				return RES_OK;
+			}
+			if(in_ra_(sector)) {
+				std::memcpy(buff, &ra_buf_[(sector - ra_org_) * SECTOR_SIZE], SECTOR_SIZE);
+				++stat_.ra_hit;
+				ra_next_ = sector + 1;
+				return RES_OK;
+			}
+
+			++stat_.read_miss;
+			// ストリームの続き、又は、直近のミスに続くセクターなら先読み
+			bool seq = sector == ra_next_;
+			if(!seq && ((miss_[0] != INVALID && sector == (miss_[0] + 1))
+				|| (miss_[1] != INVALID && sector == (miss_[1] + 1)))) {
+				seq = true;
+				ra_len_ = 2;
+			}
+			miss_[1] = miss_[0];
+			miss_[0] = sector;
+			if(seq && read_ahead_(drv, sector)) {
+				std::memcpy(buff, ra_buf_, SECTOR_SIZE);
+				ra_next_ = sector + 1;
+				return RES_OK;
+			}
+
+			DRESULT ret;
+			l = alloc_(drv, sector, ret);
+			if(l == nullptr) return ret;
+			ret = dev_read_(drv, data_at_(l), sector, 1);
+			if(ret != RES_OK) {
+				l->sector = INVALID;
+				return ret;
+			}
+			l->stamp = ++stamp_;
+			std::memcpy(buff, data_at_(l), SECTOR_SIZE);
+			return RES_OK;
+		}
+
+	public:
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	コンストラクター
+			@param[in]	dev		ドライバー
+		*/
+		//-----------------------------------------------------------------//
+		disk_cache(DEV& dev) noexcept : dev_(dev), line_(), data_{ }, ra_buf_{ },
+			ra_org_(0), ra_num_(0), ra_len_(2), ra_next_(INVALID), miss_{ INVALID, INVALID },
+			limit_(0), stamp_(0), dirty_num_(0), enable_(true), stat_()
+		{ }
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	ドライバーの参照
+			@return ドライバー
+		*/
+		//-----------------------------------------------------------------//
+		DEV& at_dev() noexcept { return dev_; }
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	キャッシュの許可 @n
+					※不許可にする場合、ダーティー・セクターを書いてから無効にする
+			@param[in]	ena		不許可なら「false」
+			@param[in]	drv		Physical drive nmuber (0)
+		*/
+		//-----------------------------------------------------------------//
+		void enable(bool ena = true, BYTE drv = 0) noexcept
+		{
+			if(!ena) {
+				sync(drv);
+				invalidate();
+			}
+			enable_ = ena;
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	キャッシュを無効にする（ダーティー・セクターは捨てる）
+		*/
+		//-----------------------------------------------------------------//
+		void invalidate() noexcept
+		{
+			for(auto& l : line_) {
+				l = line_t();
+			}
+			ra_num_ = 0;
+			ra_len_ = 2;
+			ra_next_ = INVALID;
+			miss_[0] = INVALID;
+			miss_[1] = INVALID;
+			dirty_num_ = 0;
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	全てのダーティー・セクターを書く
+			@param[in]	drv		Physical drive nmuber (0)
+			@return リザルト
+		*/
+		//-----------------------------------------------------------------//
+		DRESULT sync(BYTE drv) noexcept
+		{
+			if(dirty_num_ == 0) return RES_OK;
+
+			// 小さいセクター番号から書く（連続した範囲はまとめる）
+			while(dirty_num_ > 0) {
+				const line_t* m = nullptr;
+				for(const auto& l : line_) {
+					if(l.dirty && (m == nullptr || l.sector < m->sector)) m = &l;
+				}
+				if(m == nullptr) break;
+				auto ret = flush_run_(drv, m->sector);
+				if(ret != RES_OK) return ret;
+			}
+			return RES_OK;
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	ダーティー・セクター数を取得
+			@return ダーティー・セクター数
+		*/
+		//-----------------------------------------------------------------//
+		uint32_t get_dirty_num() const noexcept { return dirty_num_; }
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	統計情報を取得
+			@return 統計情報
+		*/
+		//-----------------------------------------------------------------//
+		const stat_t& get_stat() const noexcept { return stat_; }
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	統計情報をクリア
+		*/
+		//-----------------------------------------------------------------//
+		void clear_stat() noexcept { stat_ = stat_t(); }
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	ディスク・ステータスを取得
+			@param[in]	drv		Physical drive nmuber (0)
+			@return ステータス
+		*/
+		//-----------------------------------------------------------------//
+		DSTATUS disk_status(BYTE drv) noexcept { return dev_.disk_status(drv); }
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	ドライブを初期化 @n
+					※カードが交換されている場合があるので、キャッシュを無効にする
+			@param[in]	drv		Physical drive nmuber (0)
+			@return ステータス
+		*/
+		//-----------------------------------------------------------------//
+		DSTATUS disk_initialize(BYTE drv) noexcept
+		{
+			invalidate();
+			limit_ = 0;
+			auto st = dev_.disk_initialize(drv);
+			if((st & STA_NOINIT) == 0) {
+				DWORD n = 0;
+				if(dev_.disk_ioctl(drv, GET_SECTOR_COUNT, &n) == RES_OK) {
+					limit_ = n;
+				}
+			}
+			return st;
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	リード・セクター
+			@param[in]	drv		Physical drive nmuber (0)
+			@param[out]	buff	Pointer to the data buffer to store read data
+			@param[in]	sector	Start sector number (LBA)
+			@param[in]	count	Sector count (1..128)
+			@return リザルト
+		 */
+		//-----------------------------------------------------------------//
+		DRESULT disk_read(BYTE drv, BYTE* buff, DWORD sector, UINT count) noexcept
+		{
+			if(!enable_) return dev_read_(drv, buff, sector, count);
+
+			if(count == 1) return read_one_(drv, buff, sector);
+
+			// 複数セクターは直接読み、キャッシュ上の新しい内容を反映する
+			auto ret = dev_read_(drv, buff, sector, count);
+			if(ret != RES_OK) return ret;
+			stat_.read_miss += count;
+			for(uint32_t i = 0; i < count; ++i) {
+				auto* l = find_(sector + i);
+				if(l != nullptr && l->dirty) {
+					std::memcpy(&buff[i * SECTOR_SIZE], data_at_(l), SECTOR_SIZE);
+				}
+			}
+			ra_next_ = sector + count;
+			return RES_OK;
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	ライト・セクター @n
+					※１セクターはキャッシュに書き、複数セクターは直接書く
+			@param[in]	drv		Physical drive nmuber (0)
+			@param[in]	buff	Pointer to the data to be written
+			@param[in]	sector	Start sector number (LBA)
+			@param[in]	count	Sector count (1..128)
+			@return リザルト
+		 */
+		//-----------------------------------------------------------------//
+		DRESULT disk_write(BYTE drv, const BYTE* buff, DWORD sector, UINT count) noexcept
+		{
+			if(!enable_) return dev_write_(drv, buff, sector, count);
+
+			for(uint32_t i = 0; i < count; ++i) {
+				if(in_ra_(sector + i)) {
+					std::memcpy(&ra_buf_[(sector + i - ra_org_) * SECTOR_SIZE], &buff[i * SECTOR_SIZE], SECTOR_SIZE);
+				}
+			}
+
+			if(count == 1) {
+				auto* l = find_(sector);
+				if(l == nullptr) {
+					DRESULT ret;
+					l = alloc_(drv, sector, ret);
+					if(l == nullptr) return ret;
+				}
+				std::memcpy(data_at_(l), buff, SECTOR_SIZE);
+				l->stamp = ++stamp_;
+				if(!l->dirty) {
+					l->dirty = true;
+					++dirty_num_;
+				}
+				++stat_.write_hit;
+				return RES_OK;
+			}
+
+			auto ret = dev_write_(drv, buff, sector, count);
+			if(ret != RES_OK) return ret;
+			for(uint32_t i = 0; i < count; ++i) {
+				auto* l = find_(sector + i);
+				if(l != nullptr) {
+					std::memcpy(data_at_(l), &buff[i * SECTOR_SIZE], SECTOR_SIZE);
+					if(l->dirty) {
+						l->dirty = false;
+						--dirty_num_;
+					}
+				}
+			}
+			return RES_OK;
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	I/O コントロール @n
+					※CTRL_SYNC では、ダーティー・セクターを書いてからドライバーへ渡す
+			@param[in]	drv		Physical drive nmuber (0)
+			@param[in]	ctrl	Control code
+			@param[in]	buff	Buffer to send/receive control data
+			@return リザルト
+		 */
+		//-----------------------------------------------------------------//
+		DRESULT disk_ioctl(BYTE drv, BYTE ctrl, void* buff) noexcept
+		{
+			if(ctrl == CTRL_SYNC) {
+				auto ret = sync(drv);
+				if(ret != RES_OK) return ret;
+			}
+			return dev_.disk_ioctl(drv, ctrl, buff);
+		}
+	};
+}
@@ -0,0 +1,657 @@
+#pragma once
+//=====================================================================//
+/*!	@file
+	@brief	FatFs diskio 非同期リクエスト・キュー @n
+			・usb_host::hmsc、sdhi_io 等の start_read/start_write、probe_trans、@n
+			  sync_trans を持つクラスを包む @n
+			・要求を積んで直ぐに戻り、service で前のコマンドが終わったら次を発行する @n
+			・待ち行列の中で、同じ方向、連続したセクター、連続したバッファの要求は @n
+			  一つのコマンド（READ(10)/WRITE(10)）にまとめる（最大 MERGE_MAX） @n
+			・完了は、コールバック、又は、wait で待っているタスクに通知で知らせる @n
+			・disk_read は、連続読み出しを検出すると RA_NUM 個の先読みの窓を @n
+			  積んでおき、アプリケーションが窓を消費している間に次の窓を転送する @n
+			・BOT（Bulk Only Transport）は同時に一つのコマンドしか扱えないので、@n
+			  重ねるのは「転送」と「アプリケーションの処理」、コマンド間の隙間を無くす @n
+			・RTOS の場合、wait は他のタスクが service 中ならタスク通知を待ち、@n
+			  そうでなければ自分で service を回す @n
+			・タスク通知の値は他の用途（sdhi_io の DMA 待ち等）と共有するので、@n
+			  wait で止まっているタスクにだけ通知し、余分な通知を残さない
+    @author 平松邦仁 (hira@rvf-rc45.net)
+	@copyright	Copyright (C) 2021 Kunihito Hiramatsu @n
+				Released under the MIT license @n
+				https://github.com/hirakuni45/RX/blob/master/LICENSE
+*/
+//=====================================================================//
+#include <cstring>
+#include <algorithm>
+#include "ff14/source/ff.h"
+#include "ff14/source/diskio.h"
+
+#ifdef RTOS
+#include "FreeRTOS.h"
+#include "task.h"
+#endif
+
+namespace fatfs {
+
+	//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+	/*!
+		@brief  diskio 非同期リクエスト・キュー・テンプレートクラス
+		@param[in]	DEV			ドライバー・クラス（disk_status, disk_initialize, @n
+								disk_ioctl, start_read, start_write, probe_trans, sync_trans）
+		@param[in]	QUEUE_NUM	要求の最大数（２のべき乗）
+		@param[in]	MERGE_MAX	一つのコマンドにまとめる最大セクター数
+		@param[in]	RA_LEN		先読みの窓のセクター数
+		@param[in]	RA_NUM		先読みの窓の数（２以上）
+	*/
+	//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+	template <class DEV, uint32_t QUEUE_NUM = 8, uint32_t MERGE_MAX = 64,
+		uint32_t RA_LEN = 16, uint32_t RA_NUM = 2>
+	class disk_queue {
+
+		static_assert((QUEUE_NUM & (QUEUE_NUM - 1)) == 0, "QUEUE_NUM must be a power of 2");
+		static_assert(QUEUE_NUM > RA_NUM, "QUEUE_NUM must be larger than RA_NUM");
+		static_assert(RA_NUM >= 2, "RA_NUM must be 2 or more");
+		static_assert(RA_LEN > 0 && RA_LEN <= MERGE_MAX, "RA_LEN out of range");
+
+	public:
+		static const uint32_t SECTOR_SIZE = 512;	///< セクター・サイズ
+
+		//-------------------------------------------------------------//
+		/*!
+			@brief  完了コールバック型 @n
+					service の中から呼ばれる（中で wait しない事）
+			@param[in]	ctx	要求で指定したコンテキスト
+			@param[in]	id	要求 ID
+			@param[in]	res	結果
+		*/
+		//-------------------------------------------------------------//
+		typedef void (*callback_type)(void* ctx, uint32_t id, DRESULT res);
+
+		//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+		/*!
+			@brief  統計情報
+		*/
+		//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+		struct stat_t {
+			uint32_t	request;		///< 要求数
+			uint32_t	merge;			///< 前の要求にまとめた要求数
+			uint32_t	dev_read;		///< デバイス読み出しコマンド数
+			uint32_t	dev_read_sec;	///< デバイス読み出しセクター数
+			uint32_t	dev_write;		///< デバイス書き込みコマンド数
+			uint32_t	dev_write_sec;	///< デバイス書き込みセクター数
+			uint32_t	ra_issue;		///< 積んだ先読みの窓
+			uint32_t	ra_hit;			///< 先読みでの読み出し（セクター）
+			uint32_t	ra_miss;		///< 直接読んだセクター
+			uint32_t	full;			///< キューが一杯で積めなかった回数
+			uint32_t	error;			///< デバイス・エラー数
+			stat_t() noexcept : request(0), merge(0), dev_read(0), dev_read_sec(0),
+				dev_write(0), dev_write_sec(0), ra_issue(0), ra_hit(0), ra_miss(0),
+				full(0), error(0) { }
+		};
+
+	private:
+		static const uint32_t INVALID = 0xFFFFFFFF;
+
+		struct req_t {
+			uint8_t*		buff;
+			uint32_t		sector;
+			uint32_t		count;
+			callback_type	cb;
+			void*			ctx;
+#ifdef RTOS
+			TaskHandle_t	waiter;		///< wait で止まっているタスク
+#endif
+			BYTE			drv;
+			bool			write;
+			DRESULT			result;
+		};
+
+		struct ra_t {
+			uint32_t	org;
+			uint32_t	num;
+			uint32_t	id;
+			bool		valid;
+		};
+
+		DEV&		dev_;
+
+		// 要求 ID は積んだ順の通し番号：[done_, get_) 実行中、[get_, put_) 待ち
+		req_t		que_[QUEUE_NUM];
+		volatile uint32_t	put_;
+		volatile uint32_t	get_;
+		volatile uint32_t	done_;
+		volatile bool		lock_;
+
+		// 先読みの窓（リング、隣の窓とバッファが連続するのでまとめて読める）
+		uint8_t		ra_buf_[RA_NUM * RA_LEN * SECTOR_SIZE];
+		ra_t		ra_[RA_NUM];
+		uint32_t	ra_pos_;		// 次に積む窓
+		uint32_t	ra_next_;		// ストリームの次のセクター
+		uint32_t	ra_end_;		// 積んだ窓の終わり
+		uint32_t	miss_end_;		// 直前に直接読んだ範囲の終わり（ストリームの検出）
+		bool		ra_enable_;
+
+		uint32_t	limit_;			// セクター数（0 なら不明）
+
+		stat_t		stat_;
+
+
+		bool try_lock_() noexcept
+		{
+#ifdef RTOS
+			taskENTER_CRITICAL();
+#endif
+			bool ok = !lock_;
+			lock_ = true;
+#ifdef RTOS
+			taskEXIT_CRITICAL();
+#endif
+			return ok;
+		}
+
+
+		void complete_(uint32_t num, DRESULT ret) noexcept
+		{
+			while(num > 0) {
+				auto& r = que_[done_ & (QUEUE_NUM - 1)];
+				r.result = ret;
+				auto id = done_;
+				++done_;
+				if(r.cb != nullptr) (*r.cb)(r.ctx, id, ret);
+#ifdef RTOS
+				taskENTER_CRITICAL();
+				auto t = r.waiter;
+				r.waiter = nullptr;
+				if(t != nullptr) xTaskNotifyGive(t);
+				taskEXIT_CRITICAL();
+#endif
+				--num;
+			}
+		}
+
+
+		// 待ち行列の先頭から、まとめられる要求を一つのコマンドで発行
+		void issue_() noexcept
+		{
+			const auto& r = que_[get_ & (QUEUE_NUM - 1)];
+			uint32_t num = 1;
+			uint32_t cnt = r.count;
+			while((get_ + num) != put_) {
+				const auto& n = que_[(get_ + num) & (QUEUE_NUM - 1)];
+				if(n.drv != r.drv || n.write != r.write || n.sector != (r.sector + cnt)
+					|| n.buff != (r.buff + cnt * SECTOR_SIZE) || (cnt + n.count) > MERGE_MAX) break;
+				cnt += n.count;
+				++num;
+			}
+			stat_.merge += num - 1;
+
+			DRESULT ret;
+			if(r.write) {
+				++stat_.dev_write;
+				stat_.dev_write_sec += cnt;
+				ret = dev_.start_write(r.drv, r.buff, r.sector, cnt);
+			} else {
+				++stat_.dev_read;
+				stat_.dev_read_sec += cnt;
+				ret = dev_.start_read(r.drv, r.buff, r.sector, cnt);
+			}
+			get_ += num;
+			if(ret != RES_OK) {
+				++stat_.error;
+				complete_(num, ret);
+			}
+		}
+
+
+		bool service_() noexcept
+		{
+			if(done_ != get_) {
+				if(dev_.probe_trans()) return true;
+				auto ret = dev_.sync_trans();
+				if(ret != RES_OK) ++stat_.error;
+				complete_(get_ - done_, ret);
+			}
+			while(get_ != put_) {
+				issue_();
+				if(done_ != get_) return true;  // 発行エラーなら次へ
+			}
+			return false;
+		}
+
+
+		bool push_(BYTE drv, uint8_t* buff, uint32_t sector, uint32_t count, bool write,
+			uint32_t* id, callback_type cb, void* ctx) noexcept
+		{
+			if(count == 0) return false;
+#ifdef RTOS
+			taskENTER_CRITICAL();
+#endif
+			bool ok = (put_ - done_) < QUEUE_NUM;
+			if(ok) {
+				auto& r = que_[put_ & (QUEUE_NUM - 1)];
+				r.buff = buff;
+				r.sector = sector;
+				r.count = count;
+				r.cb = cb;
+				r.ctx = ctx;
+#ifdef RTOS
+				r.waiter = nullptr;
+#endif
+				r.drv = drv;
+				r.write = write;
+				r.result = RES_OK;
+				if(id != nullptr) *id = put_;
+				++put_;
+				++stat_.request;
+			} else {
+				++stat_.full;
+			}
+#ifdef RTOS
+			taskEXIT_CRITICAL();
+#endif
+			return ok;
+		}
+
+
+#ifdef RTOS
+		// 要求の完了通知を、最大１ティック待つ @n
+		// 他の用途の通知を受けたら戻し、以後はティック単位で待つ（foreign）
+		void sleep_(uint32_t id, bool& foreign) noexcept
+		{
+			if(xTaskGetSchedulerState() != taskSCHEDULER_RUNNING) return;
+
+			auto self = xTaskGetCurrentTaskHandle();
+			auto& r = que_[id & (QUEUE_NUM - 1)];
+			taskENTER_CRITICAL();
+			bool done = is_done(id);
+			bool set = !done && !foreign && r.waiter == nullptr;
+			if(set) r.waiter = self;
+			taskEXIT_CRITICAL();
+			if(done) return;
+			if(!set) {
+				vTaskDelay(1);
+				return;
+			}
+
+			auto n = ulTaskNotifyTake(pdFALSE, 1);
+			taskENTER_CRITICAL();
+			bool mine = r.waiter == self;  // 通知されていない
+			if(mine) r.waiter = nullptr;
+			taskEXIT_CRITICAL();
+			if(mine && n > 0) {
+				xTaskNotifyGive(self);
+				foreign = true;
+			} else if(!mine && n == 0) {  // タイムアウトの後の通知を消費
+				ulTaskNotifyTake(pdFALSE, 0);
+			}
+		}
+#endif
+
+
+		// 積めるまで service を回す（同期版）
+		DRESULT rw_(BYTE drv, uint8_t* buff, uint32_t sector, uint32_t count, bool write) noexcept
+		{
+			uint32_t id;
+			while(!push_(drv, buff, sector, count, write, &id, nullptr, nullptr)) {
+				wait(done_);
+			}
+			return wait(id);
+		}
+
+
+		ra_t* find_ra_(uint32_t sector) noexcept
+		{
+			for(auto& w : ra_) {
+				if(w.valid && sector >= w.org && sector < (w.org + w.num)) return &w;
+			}
+			return nullptr;
+		}
+
+
+		void drop_ra_() noexcept
+		{
+			for(auto& w : ra_) {
+				w.valid = false;
+			}
+			ra_end_ = INVALID;
+		}
+
+
+		// ストリームの先に、消費済みの窓を積みなおす
+		void refill_(BYTE drv) noexcept
+		{
+			if(ra_end_ == INVALID || ra_end_ < ra_next_ || (ra_end_ - ra_next_) > (RA_NUM * RA_LEN)) {
+				drop_ra_();
+				ra_end_ = ra_next_;
+			}
+			for(uint32_t i = 0; i < RA_NUM; ++i) {
+				auto& w = ra_[ra_pos_];
+				if(w.valid && (w.org + w.num) > ra_next_) break;
+				if(limit_ > 0 && ra_end_ >= limit_) break;
+				auto n = RA_LEN;
+				if(limit_ > 0 && (limit_ - ra_end_) < n) n = limit_ - ra_end_;
+				w.valid = false;
+				if(!push_(drv, &ra_buf_[ra_pos_ * RA_LEN * SECTOR_SIZE], ra_end_, n, false,
+					&w.id, nullptr, nullptr)) break;
+				w.org = ra_end_;
+				w.num = n;
+				w.valid = true;
+				++stat_.ra_issue;
+				ra_end_ += n;
+				++ra_pos_;
+				if(ra_pos_ >= RA_NUM) ra_pos_ = 0;
+			}
+		}
+
+	public:
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	コンストラクター
+			@param[in]	dev		ドライバー
+		*/
+		//-----------------------------------------------------------------//
+		disk_queue(DEV& dev) noexcept : dev_(dev), que_{ }, put_(0), get_(0), done_(0),
+			lock_(false), ra_buf_{ }, ra_{ }, ra_pos_(0), ra_next_(INVALID), ra_end_(INVALID),
+			miss_end_(INVALID), ra_enable_(true), limit_(0), stat_()
+		{ }
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	ドライバーの参照
+			@return ドライバー
+		*/
+		//-----------------------------------------------------------------//
+		DEV& at_dev() noexcept { return dev_; }
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	先読みの許可
+			@param[in]	ena		不許可なら「false」
+		*/
+		//-----------------------------------------------------------------//
+		void enable_read_ahead(bool ena = true) noexcept
+		{
+			if(!ena) {
+				flush();
+				drop_ra_();
+			}
+			ra_enable_ = ena;
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	リード要求を積む @n
+					※バッファは完了するまで保持する事
+			@param[in]	drv		Physical drive nmuber (0)
+			@param[out]	buff	Pointer to the data buffer to store read data
+			@param[in]	sector	Start sector number (LBA)
+			@param[in]	count	Sector count
+			@param[out]	id		要求 ID（不要なら nullptr）
+			@param[in]	cb		完了コールバック（不要なら nullptr）
+			@param[in]	ctx		コールバックに渡すコンテキスト
+			@return キューが一杯なら「false」
+		 */
+		//-----------------------------------------------------------------//
+		bool push_read(BYTE drv, void* buff, DWORD sector, UINT count, uint32_t* id = nullptr,
+			callback_type cb = nullptr, void* ctx = nullptr) noexcept
+		{
+			return push_(drv, static_cast<uint8_t*>(buff), sector, count, false, id, cb, ctx);
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	ライト要求を積む @n
+					※バッファは完了するまで保持する事
+			@param[in]	drv		Physical drive nmuber (0)
+			@param[in]	buff	Pointer to the data to be written
+			@param[in]	sector	Start sector number (LBA)
+			@param[in]	count	Sector count
+			@param[out]	id		要求 ID（不要なら nullptr）
+			@param[in]	cb		完了コールバック（不要なら nullptr）
+			@param[in]	ctx		コールバックに渡すコンテキスト
+			@return キューが一杯なら「false」
+		 */
+		//-----------------------------------------------------------------//
+		bool push_write(BYTE drv, const void* buff, DWORD sector, UINT count, uint32_t* id = nullptr,
+			callback_type cb = nullptr, void* ctx = nullptr) noexcept
+		{
+			return push_(drv, (uint8_t*)(buff), sector, count, true, id, cb, ctx);
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	サービス @n
+					前のコマンドが完了していたら、完了を通知して次のコマンドを発行する @n
+					※RTOS の場合、USB 等のタスクから回す事も出来る
+			@return 転送中、又は、待ち行列に要求があれば「true」
+		 */
+		//-----------------------------------------------------------------//
+		bool service() noexcept
+		{
+			if(!try_lock_()) return true;
+			auto busy = service_();
+			lock_ = false;
+			return busy;
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	要求が完了したか検査
+			@param[in]	id	要求 ID
+			@return 完了なら「true」
+		 */
+		//-----------------------------------------------------------------//
+		bool is_done(uint32_t id) const noexcept
+		{
+			return static_cast<int32_t>(done_ - id) > 0;
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	要求の完了を待つ @n
+					※結果は、同じスロットに次の要求（QUEUE_NUM 個後）を積むまで有効
+			@param[in]	id	要求 ID
+			@return 結果
+		 */
+		//-----------------------------------------------------------------//
+		DRESULT wait(uint32_t id) noexcept
+		{
+#ifdef RTOS
+			bool foreign = false;
+#endif
+			while(!is_done(id)) {
+				if(try_lock_()) {
+					service_();
+					lock_ = false;
+#ifdef RTOS
+					taskYIELD();
+#endif
+				} else {
+#ifdef RTOS
+					sleep_(id, foreign);
+#endif
+				}
+			}
+			return que_[id & (QUEUE_NUM - 1)].result;
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	全ての要求の完了を待つ
+			@return 最後の要求の結果
+		 */
+		//-----------------------------------------------------------------//
+		DRESULT flush() noexcept
+		{
+			if(put_ == done_) return RES_OK;
+			return wait(put_ - 1);
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	待ち行列の要求数を取得（実行中を含む）
+			@return 要求数
+		*/
+		//-----------------------------------------------------------------//
+		uint32_t get_queue_num() const noexcept { return put_ - done_; }
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	統計情報を取得
+			@return 統計情報
+		*/
+		//-----------------------------------------------------------------//
+		const stat_t& get_stat() const noexcept { return stat_; }
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	統計情報をクリア
+		*/
+		//-----------------------------------------------------------------//
+		void clear_stat() noexcept { stat_ = stat_t(); }
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	ディスク・ステータスを取得
+			@param[in]	drv		Physical drive nmuber (0)
+			@return ステータス
+		*/
+		//-----------------------------------------------------------------//
+		DSTATUS disk_status(BYTE drv) noexcept { return dev_.disk_status(drv); }
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	ドライブを初期化 @n
+					※メディアが交換されている場合があるので、先読みを捨てる
+			@param[in]	drv		Physical drive nmuber (0)
+			@return ステータス
+		*/
+		//-----------------------------------------------------------------//
+		DSTATUS disk_initialize(BYTE drv) noexcept
+		{
+			flush();
+			drop_ra_();
+			ra_next_ = INVALID;
+			miss_end_ = INVALID;
+			limit_ = 0;
+			auto st = dev_.disk_initialize(drv);
+			if((st & STA_NOINIT) == 0) {
+				DWORD n = 0;
+				if(dev_.disk_ioctl(drv, GET_SECTOR_COUNT, &n) == RES_OK) {
+					limit_ = n;
+				}
+			}
+			return st;
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	リード・セクター @n
+					先読みの窓にあればコピーし、無ければ要求を積んで待つ @n
+					連続読み出しなら、消費した窓の先を積んでおく
+			@param[in]	drv		Physical drive nmuber (0)
+			@param[out]	buff	Pointer to the data buffer to store read data
+			@param[in]	sector	Start sector number (LBA)
+			@param[in]	count	Sector count (1..128)
+			@return リザルト
+		 */
+		//-----------------------------------------------------------------//
+		DRESULT disk_read(BYTE drv, BYTE* buff, DWORD sector, UINT count) noexcept
+		{
+			if(!ra_enable_) return rw_(drv, buff, sector, count, false);
+
+			uint32_t i = 0;
+			while(i < count) {
+				auto* w = find_ra_(sector + i);
+				if(w == nullptr) break;
+				if(wait(w->id) != RES_OK) {
+					w->valid = false;
+					break;
+				}
+				auto ofs = sector + i - w->org;
+				auto n = std::min(count - i, w->num - ofs);
+				std::memcpy(&buff[i * SECTOR_SIZE],
+					&ra_buf_[((w - ra_) * RA_LEN + ofs) * SECTOR_SIZE], n * SECTOR_SIZE);
+				stat_.ra_hit += n;
+				i += n;
+			}
+
+			bool seq = i > 0 || sector == ra_next_ || sector == miss_end_;
+			if(i < count) {
+				auto ret = rw_(drv, &buff[i * SECTOR_SIZE], sector + i, count - i, false);
+				if(ret != RES_OK) return ret;
+				stat_.ra_miss += count - i;
+			}
+
+			// FAT 等の単発の読み出しは、ストリームを壊さない
+			if(seq) {
+				ra_next_ = sector + count;
+				refill_(drv);
+			} else {
+				miss_end_ = sector + count;
+			}
+			return RES_OK;
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	ライト・セクター @n
+					要求を積んで完了を待つ、先読みの窓と重なる場合は窓も更新する
+			@param[in]	drv		Physical drive nmuber (0)
+			@param[in]	buff	Pointer to the data to be written
+			@param[in]	sector	Start sector number (LBA)
+			@param[in]	count	Sector count (1..128)
+			@return リザルト
+		 */
+		//-----------------------------------------------------------------//
+		DRESULT disk_write(BYTE drv, const BYTE* buff, DWORD sector, UINT count) noexcept
+		{
+			for(auto& w : ra_) {
+				if(!w.valid || (sector + count) <= w.org || sector >= (w.org + w.num)) continue;
+				if(wait(w.id) != RES_OK) {
+					w.valid = false;
+					continue;
+				}
+				auto org = std::max(static_cast<uint32_t>(sector), w.org);
+				auto end = std::min(static_cast<uint32_t>(sector + count), w.org + w.num);
+				std::memcpy(&ra_buf_[((&w - ra_) * RA_LEN + org - w.org) * SECTOR_SIZE],
+					&buff[(org - sector) * SECTOR_SIZE], (end - org) * SECTOR_SIZE);
+			}
+			return rw_(drv, (uint8_t*)(buff), sector, count, true);
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	I/O コントロール @n
+					※全ての要求の完了を待ってからドライバーへ渡す
+			@param[in]	drv		Physical drive nmuber (0)
+			@param[in]	ctrl	Control code
+			@param[in]	buff	Buffer to send/receive control data
+			@return リザルト
+		 */
+		//-----------------------------------------------------------------//
+		DRESULT disk_ioctl(BYTE drv, BYTE ctrl, void* buff) noexcept
+		{
+			auto ret = flush();
+			if(ctrl == CTRL_SYNC && ret != RES_OK) return ret;
+			return dev_.disk_ioctl(drv, ctrl, buff);
+		}
+	};
+}
@@ -13,13 +13,16 @@
 			・「SELECT」ファイル選択（ファイラーは自動で閉じる） @n
 			・「INFO」ファイル情報の表示 @n
 			・「CLOSE」ファイラーを閉じる @n
+			・「SORT」並び順の切り替え（ディレクトリー順、名前、日付、サイズ） @n
 			タッチ操作方法： @n
 			・コンストラクターの第二引数を「true」にすると、３本タッチでオープンする。 @n
 			・ファイラー起動中、３本タッチでクローズ（true の場合） @n
 			・ファイラーがオープンしたら、上下にドラッグでスクロール @n
 			・右にドラッグでファイル選択（フォーカスされているファイル） @n
 			・ディレクトリー選択した場合、ディレクトリー移動 @n
-			・左にドラッグでディレクトリーを一つ手前に戻る
+			・左にドラッグでディレクトリーを一つ手前に戻る @n
+			ディレクトリーは「utils::dir_cache」にスナップショットとして読み込み、@n
+			表示されている行だけを描画する。
     @author 平松邦仁 (hira@rvf-rc45.net)
 	@copyright	Copyright (C) 2018, 2021 Kunihito Hiramatsu @n
 				Released under the MIT license @n
@@ -27,6 +30,7 @@
 */
 //=====================================================================//
 #include "common/file_io.hpp"
+#include "common/dir_cache.hpp"
 #include "common/fixed_stack.hpp"
 
 namespace gui {
@@ -52,6 +56,7 @@ namespace gui {
 			SELECT,		///< 選択
 			INFO,		///< ファイルの情報を表示
 			CLOSE,		///< ファイラーを閉じる
+			SORT,		///< 並び順の切り替え
 		};
 
 
@@ -85,20 +90,30 @@ namespace gui {
 	//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
 	/*!
 		@brief	ファイラー・クラス
-		@param[in]	RDR	描画クラス型
+		@param[in]	RDR		描画クラス型
+		@param[in]	ARENA	ディレクトリー・キャッシュのサイズ（バイト） @n
+							既定は 2K バイト（画面数枚分、大きなディレクトリーはウィンドウ・モード）@n
+							RAM に余裕があれば、大きくすると全体をソート出来る
+		@param[in]	MRU		キャッシュするディレクトリー数（既定は１）
 	*/
 	//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
-	template <class RDR>
+	template <class RDR, uint32_t ARENA = 2048, uint32_t MRU = 1>
 	class filer : public filer_base {
 
 		using GLC = typename RDR::glc_type;
 
-		static const int32_t FRAME_PER_FILES = 10;  ///< ディレクトリー取得で処理するフレーム辺りのファイル数
+	public:
+		typedef utils::dir_cache<ARENA, MRU> DCACHE;
+		typedef typename DCACHE::SORT SORT;
+
+	private:
+		static const int32_t FRAME_PER_FILES = 64;  ///< ディレクトリー取得で処理するフレーム辺りのファイル数
 		static const int16_t MODAL_RADIUS = 10;  ///< modal round radius
 
 		static const int16_t SPC = 2;									///< 文字間隙間
 		static const int16_t FLN = RDR::font_type::height + SPC;		///< 行幅
 		static const int16_t SCN = (RDR::glc_type::height - SPC) / FLN;	///< 行数
+		static const int16_t ROW = (RDR::glc_type::height - SPC + FLN - 1) / FLN;	///< 描画行数（下端の欠けた行を含む）
 
 		static const uint16_t REPEAT_DELAY = 40;	///< リピートまでの時間（フレーム数）
 		static const uint16_t REPEAT_CYCLE = 8;		///< リピート間隔（フレーム数）
@@ -107,32 +122,22 @@ namespace gui {
 
 		RDR&		rdr_;
 
-		typedef utils::dir_list DLIST;
-		DLIST		dlist_;
+		DCACHE		dcache_;
 
 		uint32_t	ctrl_;
 
-		struct rdr_st {
-			int16_t		vofs_;
-			int16_t		vpos_;
-			int16_t		sel_pos_;
-			uint16_t	num_;
-			int16_t		match_;
-
-			rdr_st() noexcept : vofs_(0), vpos_(0),
-				sel_pos_(0), num_(0), match_(-1)
-			{ }
-		};
-		rdr_st		rdr_st_;
+		uint32_t	top_;		///< 先頭行のエントリー番号
+		int16_t		sel_pos_;	///< 選択行
+		uint32_t	drawn_;		///< 描画済みの行数（読み込み中）
 
 		bool		open_;
 		bool		info_;
 
 		struct pos_t {
-			int16_t		vofs_;
+			uint32_t	top_;
 			int16_t		sel_pos_;
-			pos_t(int16_t vofs = 0, int16_t sel_pos = 0) noexcept :
-				vofs_(vofs), sel_pos_(sel_pos) { }
+			pos_t(uint32_t top = 0, int16_t sel_pos = 0) noexcept :
+				top_(top), sel_pos_(sel_pos) { }
 		};
 		typedef utils::fixed_stack<pos_t, 16> POS_STACK;
 		POS_STACK	pos_stack_;
@@ -156,42 +161,34 @@ namespace gui {
 		}
 
 
-		void dir_draw_func_(const char* name, const FILINFO* fi, bool dir, void* opt) noexcept
+		void draw_entry_(uint32_t idx) noexcept
 		{
-			rdr_st& t = *static_cast<rdr_st*>(opt);
-			bool draw = false;
-			if(t.match_ < 0) {
-				draw = true;
-			} else if(t.num_ == static_cast<uint16_t>(t.match_)) {
-				draw = true;
-			}
-			if(draw && t.vpos_ >= 0 && t.vpos_ < RDR::glc_type::height) {
-				rdr_.set_fore_color(DEF_COLOR::Black);
-				rdr_.fill_box(vtx::srect(SPC, t.vpos_,
-					RDR::glc_type::width - SPC * 2, RDR::font_type::height));
-				rdr_.set_fore_color(DEF_COLOR::White);
-				if(dir) rdr_.draw_font(vtx::spos(SPC, t.vpos_), '/');
-				if(dir) {
-					rdr_.set_fore_color(DEF_COLOR::Blue);
-				} else {
-					rdr_.set_fore_color(DEF_COLOR::White);
-				}
-				auto w = rdr_.draw_text(vtx::spos(SPC + 8, t.vpos_), name);
+			if(idx < top_ || idx >= (top_ + ROW)) return;
+			auto e = dcache_.get(idx);
+			if(e == nullptr) return;
+
+			int16_t vpos = (idx - top_) * FLN + 2;
+			rdr_.set_fore_color(DEF_COLOR::Black);
+			rdr_.fill_box(vtx::srect(SPC, vpos,
+				RDR::glc_type::width - SPC * 2, RDR::font_type::height));
+			rdr_.set_fore_color(DEF_COLOR::White);
+			if(e->is_dir()) {
+				rdr_.draw_font(vtx::spos(SPC, vpos), '/');
+				rdr_.set_fore_color(DEF_COLOR::Blue);
 			}
-			t.vpos_ += FLN;
-			++t.num_;
+			rdr_.draw_text(vtx::spos(SPC + 8, vpos), e->name);
 		}
 
 
-		void start_dir_draw_(int16_t match = -1) noexcept
+		// 表示範囲で、読み込み済みの行を描画
+		void draw_rows_(uint32_t org) noexcept
 		{
-			rdr_st_.vpos_ = rdr_st_.vofs_ + 2;
-			rdr_st_.num_ = 0;
-			rdr_st_.match_ = match;
-			char tmp[FF_MAX_LFN + 1];
-			if(utils::file_io::pwd(tmp, sizeof(tmp))) {
-				dlist_.start(tmp);
+			uint32_t end = top_ + ROW;
+			if(end > dcache_.get_num()) end = dcache_.get_num();
+			for(uint32_t i = top_ + org; i < end; ++i) {
+				draw_entry_(i);
 			}
+			drawn_ = end > top_ ? end - top_ : 0;
 		}
 
 
@@ -207,18 +204,41 @@ namespace gui {
 		{
 			if(back) {
 				if(pos_stack_.empty()) {
-					rdr_st_.vofs_ = 0;
-					rdr_st_.sel_pos_ = 0;
+					top_ = 0;
+					sel_pos_ = 0;
 				} else {
 					const auto& t = pos_stack_.pop();
-					rdr_st_.vofs_ = t.vofs_;
-					rdr_st_.sel_pos_ = t.sel_pos_;
+					top_ = t.top_;
+					sel_pos_ = t.sel_pos_;
 				}
 			} else {
-				rdr_st_.vofs_ = 0;
-				rdr_st_.sel_pos_ = 0;
+				top_ = 0;
+				sel_pos_ = 0;
+			}
+			drawn_ = 0;
+			char tmp[FF_MAX_LFN + 1];
+			if(utils::file_io::pwd(tmp, sizeof(tmp))) {
+				dcache_.start(tmp);  // キャッシュにあれば、読み込みは行わない
+			}
+			if(!dcache_.probe()) {
+				draw_rows_(0);
+			}
+		}
+
+
+		void service_dir_() noexcept
+		{
+			if(!dcache_.probe()) return;
+
+			dcache_.service(FRAME_PER_FILES);
+			if(!open_ || info_) return;
+
+			if(dcache_.probe()) {
+				draw_rows_(drawn_);
+			} else {  // 読み込み完了、並べ替えた場合は描き直す
+				bool sorted = dcache_.get_sort() != SORT::NONE && !dcache_.is_window();
+				draw_rows_(sorted ? 0 : drawn_);
 			}
-			start_dir_draw_();
 		}
 
 	public:
@@ -229,8 +249,8 @@ namespace gui {
 			@param[in]	tto		３本指タッチオープンを有効にする場合「true」
 		*/
 		//-----------------------------------------------------------------//
-		filer(RDR& rdr, bool tto = false) noexcept : rdr_(rdr), dlist_(),
-			ctrl_(0), rdr_st_(), open_(false), info_(false), 
+		filer(RDR& rdr, bool tto = false) noexcept : rdr_(rdr), dcache_(),
+			ctrl_(0), top_(0), sel_pos_(0), drawn_(0), open_(false), info_(false),
 			touch_lvl_(false), touch_pos_(false), touch_neg_(false), touch_num_(0),
 			touch_(0), touch_org_(0), touch_end_(0),
 			back_num_(0), tto_(tto), repeat_(0)
@@ -271,6 +291,42 @@ namespace gui {
 		bool get_state() const noexcept { return open_; }
 
 
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	並び順を設定
+			@param[in]	sort	並び順
+		*/
+		//-----------------------------------------------------------------//
+		void set_sort(SORT sort) noexcept { dcache_.set_sort(sort); }
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	並び順を取得
+			@return 並び順
+		*/
+		//-----------------------------------------------------------------//
+		SORT get_sort() const noexcept { return dcache_.get_sort(); }
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	ディレクトリー・キャッシュを破棄 @n
+					※ファイラーが開いている間に、ファイルを書き換えた場合など
+		*/
+		//-----------------------------------------------------------------//
+		void flush() noexcept { dcache_.flush(); }
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	ディレクトリー・キャッシュの参照
+			@return ディレクトリー・キャッシュ
+		*/
+		//-----------------------------------------------------------------//
+		const DCACHE& get_cache() const noexcept { return dcache_; }
+
+
 		//-----------------------------------------------------------------//
 		/*!
 			@brief	スクリーン・タッチ位置設定 @n
@@ -311,12 +367,11 @@ namespace gui {
 			uint32_t ntrg =  ctrl_ & ~ctrl;
 			ctrl_ = ctrl;
 
-			dlist_.service(FRAME_PER_FILES,
-				[&](const char* name, const FILINFO* fi, bool dir, void* opt) {
-				dir_draw_func_(name, fi, dir, opt); }, true, &rdr_st_);
+			service_dir_();
 
 			if((ntrg & ctrl_mask_(ctrl::MOUNT))) {  // SD カードのマウント状態
 				pos_stack_.clear();
+				dcache_.flush();
 				if(open_) {
 					rdr_.clear(DEF_COLOR::Black);
 				}
@@ -339,6 +394,7 @@ namespace gui {
 				rdr_.clear(DEF_COLOR::Black);
 				if(open_) {
 					rdr_.at_font().at_kfont().flush_cash();
+					dcache_.flush();  // 閉じている間に書き換えられている場合がある
 					scan_dir_(false);
 				}
 			}
@@ -392,37 +448,22 @@ namespace gui {
 				}
 			}
 
-			{
-				if(dlist_.probe()) return status::NONE;
-				if(rdr_st_.num_ < static_cast<int16_t>(dlist_.get_total())) {
-					return status::NONE;
-				}
-			}
+			if(dcache_.probe()) return status::NONE;
 
 			if(ptrg & ctrl_mask_(ctrl::INFO)) {
 				if(info_) {
-					pos_stack_.push(pos_t(rdr_st_.vofs_, rdr_st_.sel_pos_));
 					info_ = false;
 					rdr_.clear(DEF_COLOR::Black);
-					scan_dir_(true);
+					draw_rows_(0);
 					return status::NONE;
 				} else {
-					info_ = true;
-					uint32_t idx = rdr_st_.sel_pos_ - rdr_st_.vofs_ / FLN;
-					char tmp[FF_MAX_LFN + 1];
-					if(!utils::file_io::pwd(tmp, sizeof(tmp))) {
+					auto e = dcache_.get(top_ + sel_pos_);
+					if(e == nullptr) {
 						return status::NONE;
 					}
-					if(!utils::file_io::get_dir_path(tmp, idx, dst, dstlen)) {
-						return status::NONE;
-					}
-					bool dir = false;
-					uint32_t l = strlen(dst);
-					if(dst[l - 1] == '/') {
-						dir = true;
-						dst[l - 1] = 0;
-					}
-					auto t = utils::file_io::get_time(dst);
+					info_ = true;
+					char tmp[64];
+					auto t = utils::str::fatfs_time_to(e->get_fdate(), e->get_ftime());
 					struct tm *m = localtime(&t);
 					utils::sformat("%s %2d %4d %02d:%02d\n", tmp, sizeof(tmp))
 						% get_mon(m->tm_mon)
@@ -430,10 +471,9 @@ namespace gui {
 						% static_cast<int>(m->tm_year + 1900)
 						% static_cast<int>(m->tm_hour)
 						% static_cast<int>(m->tm_min);
-					if(!dir) {
-						auto n = utils::file_io::get_file_size(dst);
-						l = strlen(tmp);
-						utils::sformat("%u bytes", &tmp[l], sizeof(tmp) - l) % n;
+					if(!e->is_dir()) {
+						auto l = strlen(tmp);
+						utils::sformat("%u bytes", &tmp[l], sizeof(tmp) - l) % e->size;
 					}
 					modal(vtx::spos(300, 80), tmp);
 				}
@@ -442,69 +482,77 @@ namespace gui {
 				return status::NONE;
 			}
 
+			if(ptrg & ctrl_mask_(ctrl::SORT)) {  // 並び順の切り替え
+				auto n = (static_cast<uint8_t>(dcache_.get_sort()) + 1) % 4;
+				dcache_.set_sort(static_cast<SORT>(n));
+				if(!dcache_.is_window()) {
+					top_ = 0;
+					sel_pos_ = 0;
+					rdr_.clear(DEF_COLOR::Black);
+					draw_rows_(0);
+				}
+			}
+
 			// 選択フレームの描画
 			rdr_.set_fore_color(DEF_COLOR::White);
-			draw_sel_frame_(rdr_st_.sel_pos_);
-			int16_t pos = rdr_st_.sel_pos_;
+			draw_sel_frame_(sel_pos_);
+			int16_t pos = sel_pos_;
 			if(ptrg & ctrl_mask_(ctrl::UP)) {
 				pos--;
 			}
 			if(ptrg & ctrl_mask_(ctrl::DOWN)) {
 				++pos;
 			}
-			int16_t vofs = rdr_st_.vofs_;
+			int32_t num = dcache_.get_num();
+			int32_t top = top_;
 			int16_t scn = SCN;
-			if(rdr_st_.num_ < scn) scn = rdr_st_.num_; 
+			if(num < scn) scn = num;
 			if(pos < 0) {
 				pos = 0;
-				vofs += FLN;
+				--top;
 			} else if(pos >= scn) {
-				pos = scn - 1;
-				vofs -= FLN;
+				pos = scn > 0 ? scn - 1 : 0;
+				++top;
 			}
-			int16_t lim = 0;
-			if(rdr_st_.num_ > scn) {
-				lim = -(rdr_st_.num_ - scn) * FLN;
+			int32_t lim = 0;
+			if(num > scn) {
+				lim = num - scn;
 			}
-			if(vofs > 0) {
-				vofs = 0;
-			} else if(vofs < lim) {
-				vofs = lim;
+			if(top < 0) {
+				top = 0;
+			} else if(top > lim) {
+				top = lim;
 			}
-			if(vofs != rdr_st_.vofs_) {
+			if(top != static_cast<int32_t>(top_)) {
 				rdr_.set_fore_color(DEF_COLOR::Black);
-				draw_sel_frame_(rdr_st_.sel_pos_);  // delete frame
-				int16_t match = -1;
-				if(vofs < rdr_st_.vofs_) {  // down
+				draw_sel_frame_(sel_pos_);  // delete frame
+				if(top > static_cast<int32_t>(top_)) {  // down
 					rdr_.scroll(FLN);
-					match = -vofs / FLN + (RDR::glc_type::height / FLN) - 1;
-				} else if(vofs > rdr_st_.vofs_) {  // up
+					top_ = top;
+					for(uint32_t i = RDR::glc_type::height / FLN - 1; i < ROW; ++i) {
+						draw_entry_(top_ + i);
+					}
+				} else {  // up
 					rdr_.scroll(-FLN);
-					match = -vofs / FLN;
+					top_ = top;
+					draw_entry_(top_);
 				}
-				rdr_st_.vofs_ = vofs;
-				start_dir_draw_(match);
 			}
-			
-			if(pos != rdr_st_.sel_pos_) {
+
+			if(pos != sel_pos_) {
 				rdr_.set_fore_color(DEF_COLOR::Black);
-				draw_sel_frame_(rdr_st_.sel_pos_);
-				rdr_st_.sel_pos_ = pos;
+				draw_sel_frame_(sel_pos_);
+				sel_pos_ = pos;
 			}
 
 			if(ptrg & ctrl_mask_(ctrl::SELECT)) {
-				uint32_t idx = rdr_st_.sel_pos_ - rdr_st_.vofs_ / FLN;
-				char root[FF_MAX_LFN + 1];
-				if(!utils::file_io::pwd(root, sizeof(root))) {
-					return status::NONE;
-				}
-				if(!utils::file_io::get_dir_path(root, idx, dst, dstlen)) {
+				auto e = dcache_.get(top_ + sel_pos_);
+				if(e == nullptr) {
 					return status::NONE;
 				}
-				uint32_t l = strlen(dst);
-				if(dst[l - 1] == '/') {  // directory ?
-					pos_stack_.push(pos_t(rdr_st_.vofs_, rdr_st_.sel_pos_));
-					dst[l - 1] = 0;
+				utils::str::strncpy_(dst, e->name, dstlen);
+				if(e->is_dir()) {
+					pos_stack_.push(pos_t(top_, sel_pos_));
 					utils::file_io::cd(dst);
 					rdr_.clear(DEF_COLOR::Black);
 					scan_dir_(false);
@@ -407,6 +407,89 @@ namespace gl {
 		}
 
 
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	複数の頂点から変換されたワールド座標を得る（in と out は同じでも良い）
+			@param[in]	mat		ベース・マトリックス
+			@param[in]	in		頂点列（w を含む）
+			@param[out]	out		結果を受け取るベクター列
+			@param[in]	num		頂点数
+		 */
+		//-----------------------------------------------------------------//
+		static void vertex_world(const matrix_type& mat, const vtx::vertex4<T>* in, vtx::vertex4<T>* out, uint32_t num) noexcept
+		{
+			mtx::matmul1n<T>(&out->x, mat(), &in->x, num);
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	視錐台の６平面を取り出す（左、右、下、上、手前、奥） @n
+					平面は正規化され、内側で「a*x + b*y + c*z + d」が正になる
+			@param[in]	mat		ワールド・マトリックス
+			@param[out]	pl		平面 (a, b, c, d) x 6
+		 */
+		//-----------------------------------------------------------------//
+		static void frustum_planes(const matrix_type& mat, vtx::vertex4<T>* pl) noexcept
+		{
+			const T* m = mat();
+			for(uint32_t i = 0; i < 6; ++i) {
+				uint32_t row = i >> 1;
+				T s = (i & 1) ? static_cast<T>(-1) : static_cast<T>(1);
+				auto& p = pl[i];
+				p.x = m[3]  + s * m[row];
+				p.y = m[7]  + s * m[row + 4];
+				p.z = m[11] + s * m[row + 8];
+				p.w = m[15] + s * m[row + 12];
+				T len = std::sqrt(p.x * p.x + p.y * p.y + p.z * p.z);
+				if(len > static_cast<T>(0)) {
+					T il = static_cast<T>(1) / len;
+					p.x *= il;
+					p.y *= il;
+					p.z *= il;
+					p.w *= il;
+				}
+			}
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	境界球が視錐台の中に（一部でも）あるか検査する
+			@param[in]	pl		視錐台の平面（frustum_planes で取得）
+			@param[in]	c		境界球の中心（モデル座標）
+			@param[in]	r		境界球の半径
+			@return 完全に外側なら「false」
+		 */
+		//-----------------------------------------------------------------//
+		static bool sphere_visible(const vtx::vertex4<T>* pl, const vtx::vertex3<T>& c, T r) noexcept
+		{
+			for(uint32_t i = 0; i < 6; ++i) {
+				const auto& p = pl[i];
+				if((p.x * c.x + p.y * c.y + p.z * c.z + p.w) < -r) return false;
+			}
+			return true;
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	現在のマトリックスで、境界球が視錐台の中にあるか検査する
+			@param[in]	c		境界球の中心（モデル座標）
+			@param[in]	r		境界球の半径
+			@return 完全に外側なら「false」
+		 */
+		//-----------------------------------------------------------------//
+		bool sphere_visible(const vtx::vertex3<T>& c, T r) const noexcept
+		{
+			matrix_type wm;
+			world_matrix(wm);
+			vtx::vertex4<T> pl[6];
+			frustum_planes(wm, pl);
+			return sphere_visible(pl, c, r);
+		}
+
+
 		//-----------------------------------------------------------------//
 		/*!
 			@brief	頂点から正規化されたスクリーン座標を得る
@@ -186,6 +186,15 @@ namespace graphics {
 		const value_type* fb() const noexcept { return fb_; }
 
 
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	フレームバッファへの参照（直接描画用）
+			@return フレームバッファ・アドレス
+		*/
+		//-----------------------------------------------------------------//
+		value_type* at_fb() noexcept { return fb_; }
+
+
 		//-----------------------------------------------------------------//
 		/*!
 			@brief	フォア・カラーの取得
@@ -999,6 +1008,99 @@ namespace graphics {
 		}
 
 
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	Unicode フォント（ufont）で文字を描画
+			@param[in]	uf		Unicode フォント
+			@param[in]	pos		描画位置（行の左上）
+			@param[in]	code	UTF-16 コード
+			@param[in]	back	背景を描画する場合「true」
+			@return 送り幅（グリフが無い場合「０」）
+		*/
+		//-----------------------------------------------------------------//
+		template <class UFONT>
+		int16_t draw_glyph(UFONT& uf, const vtx::spos& pos, uint16_t code, bool back = false)
+			noexcept
+		{
+			typename UFONT::glyph_t g;
+			if(!uf.find(code, g)) return 0;
+
+			auto h = uf.get_height();
+			if(pos.y >= clip_.end_y() || (pos.y + h) <= clip_.org.y) return g.adv;
+			if(back) {
+				swap_color();
+				fill_box(vtx::srect(pos.x, pos.y, g.adv, h));
+				swap_color();
+			}
+			vtx::spos org(pos.x + g.bx, pos.y + g.by);
+			if(org.x >= clip_.end_x() || (org.x + g.w) <= clip_.org.x) return g.adv;
+
+			// 階調毎の色（2bpp で背景を描かない場合、中間階調は下地と合成）
+			bool mix = uf.get_bpp() == 2 && !back;
+			T lvl[4];
+			lvl[1] = lvl[2] = lvl[3] = fore_color_.rgb565;
+			if(uf.get_bpp() == 2 && back) {
+				for(uint8_t i = 1; i < 3; ++i) {
+					auto c = share_color::blend(fore_color_.rgba8.unit, i * 85, back_color_.rgba8.unit);
+					lvl[i] = share_color::to_565(c.r, c.g, c.b);
+				}
+			}
+			uf.decode(g, [&](int16_t x, int16_t y, int16_t len, uint8_t l) {
+				int16_t yy = org.y + y;
+				if(yy < clip_.org.y || yy >= clip_.end_y()) return;
+				int16_t xs = org.x + x;
+				int16_t xe = xs + len;
+				if(xs < clip_.org.x) xs = clip_.org.x;
+				if(xe > clip_.end_x()) xe = clip_.end_x();
+				T* out = &fb_[yy * GLC::line_width];
+				if(mix && l < 3) {
+					for(int16_t i = xs; i < xe; ++i) {
+						auto c = share_color::blend(fore_color_.rgba8.unit, l * 85,
+							share_color::conv_rgba8(out[i]));
+						out[i] = share_color::to_565(c.r, c.g, c.b);
+					}
+				} else {
+					auto c = lvl[l];
+					for(int16_t i = xs; i < xe; ++i) {
+						out[i] = c;
+					}
+				}
+			});
+			return g.adv;
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	Unicode フォント（ufont）で文字列を描画 @n
+					送り幅はグリフ毎（プロポーショナル）、改行は選択フェイスの高さ
+			@param[in]	uf		Unicode フォント
+			@param[in]	pos		描画位置
+			@param[in]	str		文字列　(UTF-8)
+			@param[in]	back	背景を描画する場合「true」
+			@return 文字の最終座標 (X)
+		*/
+		//-----------------------------------------------------------------//
+		template <class UFONT>
+		int16_t draw_text(UFONT& uf, const vtx::spos& pos, const char* str, bool back = false)
+			noexcept
+		{
+			if(str == nullptr) return 0;
+
+			auto p = pos;
+			char ch;
+			while((ch = *str++) != 0) {
+				if(ch == '\n') {
+					p.x = pos.x;
+					p.y += uf.get_height();
+				} else if(uf.injection_utf8(static_cast<uint8_t>(ch))) {
+					p.x += draw_glyph(uf, p, uf.get_utf16(), back);
+				}
+			}
+			return p.x;
+		}
+
+
 		//-----------------------------------------------------------------//
 		/*!
 			@brief	オフセットを設定
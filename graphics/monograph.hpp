@@ -51,20 +51,88 @@ namespace graphics {
 	template <uint16_t WIDTH, uint16_t HEIGHT, class AFONT = afont_null, class KFONT = kfont_null>
 	class monograph {
 
+		static const uint16_t PAGE_NUM = HEIGHT / 8;
+
 		KFONT& kfont_;
 
 		uint8_t	fb_[WIDTH * HEIGHT / 8];
 
+		// ページ毎の更新カラム範囲（min > max なら更新無し）
+		uint16_t	dirty_min_[PAGE_NUM];
+		uint16_t	dirty_max_[PAGE_NUM];
+
 		uint16_t	code_;
 		uint8_t		cnt_;
 
+		enum class ROP : uint8_t {
+			SET,	///< セット
+			RESET,	///< リセット
+			XOR,	///< 反転
+		};
+
+		void mark_(uint16_t page, uint16_t x0, uint16_t x1) noexcept
+		{
+			if(dirty_min_[page] > x0) dirty_min_[page] = x0;
+			if(dirty_max_[page] < x1) dirty_max_[page] = x1;
+		}
+
+		// ページ内の横一列にマスク付きで演算（x, w はクリップ済み）
+		void row_op_(int16_t x, int16_t w, uint16_t page, uint8_t mask, ROP op) noexcept
+		{
+#ifdef LED16X16
+			for(int16_t j = x; j < (x + w); ++j) {
+				for(uint8_t i = 0; i < 8; ++i) {
+					if((mask & (1 << i)) == 0) continue;
+					int16_t y = (page << 3) + i;
+					if(op == ROP::SET) point_set(j, y);
+					else if(op == ROP::RESET) point_reset(j, y);
+					else point_reverse(j, y);
+				}
+			}
+#else
+			uint8_t* p = &fb_[page * WIDTH + x];
+			switch(op) {
+			case ROP::SET:
+				for(int16_t j = 0; j < w; ++j) p[j] |= mask;
+				break;
+			case ROP::RESET:
+				mask = ~mask;
+				for(int16_t j = 0; j < w; ++j) p[j] &= mask;
+				break;
+			case ROP::XOR:
+				for(int16_t j = 0; j < w; ++j) p[j] ^= mask;
+				break;
+			}
+			mark_(page, x, x + w - 1);
+#endif
+		}
+
+		// 矩形をページ単位のマスク演算に分解
+		void rect_op_(int16_t x, int16_t y, int16_t w, int16_t h, ROP op) noexcept
+		{
+			if(x < 0) { w += x; x = 0; }
+			if(y < 0) { h += y; y = 0; }
+			if((x + w) > static_cast<int16_t>(WIDTH)) w = WIDTH - x;
+			if((y + h) > static_cast<int16_t>(HEIGHT)) h = HEIGHT - y;
+			if(w <= 0 || h <= 0) return;
+
+			int16_t ye = y + h;
+			for(uint16_t page = y >> 3; page <= static_cast<uint16_t>((ye - 1) >> 3); ++page) {
+				int16_t top = page << 3;
+				uint8_t mask = 0xff;
+				if(y > top) mask &= 0xff << (y - top);
+				if(ye < (top + 8)) mask &= 0xff >> (top + 8 - ye);
+				row_op_(x, w, page, mask, op);
+			}
+		}
+
 	public:
 		//-----------------------------------------------------------------//
 		/*!
 			@brief	コンストラクター
 		*/
 		//-----------------------------------------------------------------//
-		monograph(KFONT& kf) : kfont_(kf), code_(0), cnt_(0) { }
+		monograph(KFONT& kf) : kfont_(kf), code_(0), cnt_(0) { set_dirty(); }
 
 
 		//-----------------------------------------------------------------//
@@ -139,6 +207,89 @@ namespace graphics {
 		uint8_t page_num() const { return HEIGHT / 8; }
 
 
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	全ページを更新対象にする
+		*/
+		//-----------------------------------------------------------------//
+		void set_dirty() noexcept
+		{
+			for(uint16_t i = 0; i < PAGE_NUM; ++i) {
+				dirty_min_[i] = 0;
+				dirty_max_[i] = WIDTH - 1;
+			}
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	領域を更新対象にする（fb を直接書き換えた場合など）
+			@param[in]	x	開始位置 X
+			@param[in]	y	開始位置 Y
+			@param[in]	w	横幅
+			@param[in]	h	高さ
+		*/
+		//-----------------------------------------------------------------//
+		void mark_dirty(int16_t x, int16_t y, int16_t w, int16_t h) noexcept
+		{
+			if(x < 0) { w += x; x = 0; }
+			if(y < 0) { h += y; y = 0; }
+			if((x + w) > static_cast<int16_t>(WIDTH)) w = WIDTH - x;
+			if((y + h) > static_cast<int16_t>(HEIGHT)) h = HEIGHT - y;
+			if(w <= 0 || h <= 0) return;
+			for(uint16_t page = y >> 3; page <= static_cast<uint16_t>((y + h - 1) >> 3); ++page) {
+				mark_(page, x, x + w - 1);
+			}
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	更新対象をクリア（転送後に呼ぶ）
+		*/
+		//-----------------------------------------------------------------//
+		void clear_dirty() noexcept
+		{
+			for(uint16_t i = 0; i < PAGE_NUM; ++i) {
+				dirty_min_[i] = WIDTH;
+				dirty_max_[i] = 0;
+			}
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	ページの更新範囲を取得
+			@param[in]	page	ページ
+			@param[out]	org		開始カラム
+			@param[out]	len		カラム数
+			@return 更新が無い場合「false」
+		*/
+		//-----------------------------------------------------------------//
+		bool get_dirty(uint16_t page, uint16_t& org, uint16_t& len) const noexcept
+		{
+			if(page >= PAGE_NUM || dirty_min_[page] > dirty_max_[page]) return false;
+			org = dirty_min_[page];
+			len = dirty_max_[page] - dirty_min_[page] + 1;
+			return true;
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	更新対象があるか検査
+			@return 更新対象がある場合「true」
+		*/
+		//-----------------------------------------------------------------//
+		bool is_dirty() const noexcept
+		{
+			for(uint16_t i = 0; i < PAGE_NUM; ++i) {
+				if(dirty_min_[i] <= dirty_max_[i]) return true;
+			}
+			return false;
+		}
+
+
 		//-----------------------------------------------------------------//
 		/*!
 			@brief	点を描画する
@@ -152,7 +303,8 @@ namespace graphics {
 #ifdef LED16X16
 			fb_[((x & 8) >> 3) + (y << 1)] |= (1 << (x & 7));
 #else
-			fb_[((y & 0xf8) << 4) + x] |= (1 << (y & 7));
+			fb_[(y >> 3) * WIDTH + x] |= (1 << (y & 7));
+			mark_(y >> 3, x, x);
 #endif
 		}
 
@@ -170,7 +322,8 @@ namespace graphics {
 #ifdef LED16X16
 			fb_[((x & 8) >> 3) + (y << 1)] &= ~(1 << (x & 7));
 #else
-			fb_[((y & 0xf8) << 4) + x] &= ~(1 << (y & 7));
+			fb_[(y >> 3) * WIDTH + x] &= ~(1 << (y & 7));
+			mark_(y >> 3, x, x);
 #endif
 		}
 
@@ -188,7 +341,8 @@ namespace graphics {
 #ifdef LED16X16
 			fb_[((x & 8) >> 3) + (y << 1)] ^= (1 << (x & 7));
 #else
-			fb_[((y & 0xf8) << 4) + x] ^= (1 << (y & 7));
+			fb_[(y >> 3) * WIDTH + x] ^= (1 << (y & 7));
+			mark_(y >> 3, x, x);
 #endif
 		}
 
@@ -204,19 +358,7 @@ namespace graphics {
 		*/
 		//-----------------------------------------------------------------//
 		void fill(int16_t x, int16_t y, int16_t w, int16_t h, bool c) {
-			if(c) {
-				for(int16_t i = y; i < (y + h); ++i) {
-					for(int16_t j = x; j < (x + w); ++j) {
-						point_set(j, i);
-					}
-				}
-			} else {
-				for(int16_t i = y; i < (y + h); ++i) {
-					for(int16_t j = x; j < (x + w); ++j) {
-						point_reset(j, i);
-					}
-				}
-			}
+			rect_op_(x, y, w, h, c ? ROP::SET : ROP::RESET);
 		}
 
 
@@ -230,11 +372,7 @@ namespace graphics {
 		*/
 		//-----------------------------------------------------------------//
 		void reverse(int16_t x, int16_t y, int16_t w, int16_t h) {
-			for(int16_t i = y; i < (y + h); ++i) {
-				for(int16_t j = x; j < (x + w); ++j) {
-					point_reverse(j, i);
-				}
-			}
+			rect_op_(x, y, w, h, ROP::XOR);
 		}
 
 
@@ -248,6 +386,7 @@ namespace graphics {
 			for(uint16_t i = 0; i < (WIDTH * HEIGHT / 8); ++i) {
 				fb_[i] = c;
 			}
+			set_dirty();
 		}
 
 
@@ -320,24 +459,12 @@ namespace graphics {
 		*/
 		//-----------------------------------------------------------------//
 		void frame(int16_t x, int16_t y, int16_t w, int16_t h, bool c) {
-			for(int16_t i = 0; i < w; ++i) {
-				if(c) {
-					point_set(x + i, y);
-					point_set(x + i, y + h - 1);
-				} else {
-					point_reset(x + i, y);
-					point_reset(x + i, y + h - 1);
-				}
-			}
-			for(int16_t i = 0; i < h; ++i) {
-				if(c) {
-					point_set(x, y + i);
-					point_set(x + w - 1, y + i);
-				} else {
-					point_reset(x, y + i);
-					point_reset(x + w - 1, y + i);
-				}
-			}
+			if(w <= 0 || h <= 0) return;
+			auto op = c ? ROP::SET : ROP::RESET;
+			rect_op_(x, y, w, 1, op);
+			rect_op_(x, y + h - 1, w, 1, op);
+			rect_op_(x, y, 1, h, op);
+			rect_op_(x + w - 1, y, 1, h, op);
 		}
 
 
@@ -355,21 +482,40 @@ namespace graphics {
 		{
 			if(img == nullptr) return;
 
+			// ソースは横方向に連続したビット列、縦８ドット分をまとめてカラムに OR する
 			const uint8_t* p = static_cast<const uint8_t*>(img);
-			uint8_t k = 1;
-			uint8_t c = *p++;
-			for(uint8_t i = 0; i < h; ++i) {
-				int16_t xx = x;
-				for(uint8_t j = 0; j < w; ++j) {
-					if(c & k) point_set(xx, y);
-					k <<= 1;
-					if(k == 0) {
-						k = 1;
-						c = *p++;
+			int16_t xs = x < 0 ? -x : 0;
+			int16_t xe = (x + w) > static_cast<int16_t>(WIDTH) ? WIDTH - x : w;
+			int16_t ys = y < 0 ? -y : 0;
+			int16_t ye = (y + h) > static_cast<int16_t>(HEIGHT) ? HEIGHT - y : h;
+			if(xs >= xe || ys >= ye) return;
+
+			int16_t i = ys;
+			while(i < ye) {
+				uint16_t page = (y + i) >> 3;
+				int16_t sft = (y + i) & 7;
+				int16_t n = 8 - sft;
+				if(n > (ye - i)) n = ye - i;
+				for(int16_t j = xs; j < xe; ++j) {
+					uint8_t bits = 0;
+					uint16_t idx = i * w + j;
+					for(int16_t k = 0; k < n; ++k) {
+						if(p[idx >> 3] & (1 << (idx & 7))) bits |= 1 << k;
+						idx += w;
 					}
-					++xx;
+					if(bits == 0) continue;
+#ifdef LED16X16
+					for(int16_t k = 0; k < n; ++k) {
+						if(bits & (1 << k)) point_set(x + j, y + i + k);
+					}
+#else
+					fb_[page * WIDTH + x + j] |= bits << sft;
+#endif
 				}
-				++y;
+#ifndef LED16X16
+				mark_(page, x + xs, x + xe - 1);
+#endif
+				i += n;
 			}
 		}
 
@@ -158,7 +158,7 @@ namespace img {
 
 			fin.seek(utils::file_io::SEEK::SET, ofs);
 
-			return false;
+			return true;
 		}
 
 
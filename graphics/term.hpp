@@ -1,31 +1,770 @@
 #pragma once
 //=====================================================================//
 /*!	@file
-	@brief	ターミナル・クラス
+	@brief	ターミナル・クラス @n
+			・VT100/ANSI エスケープ・シーケンスを解釈し、セル（文字＋属性）に展開する @n
+			  カーソル移動、SGR（１６色、太字、下線、反転）、消去、挿入、削除、@n
+			  スクロール領域（DECSTBM）、カーソルの保存と復帰 @n
+			・描画は、前回描画したセルと比較して、変化したセルだけ行う @n
+			・スクロールは「move」でブロック転送し、新しく現れた行だけ描画する @n
+			・画面から押し出された行は、スクロールバック・バッファに圧縮して保存 @n
+			  （行末の空白を削除、属性は変化点のみ、文字は UTF-8）
     @author 平松邦仁 (hira@rvf-rc45.net)
-	@copyright	Copyright (C) 2019, 2020 Kunihito Hiramatsu @n
+	@copyright	Copyright (C) 2019, 2021 Kunihito Hiramatsu @n
 				Released under the MIT license @n
 				https://github.com/hirakuni45/RX/blob/master/LICENSE
 */
 //=====================================================================//
+#include <cstring>
+#include <algorithm>
+#include <utility>
 #include "graphics/widget.hpp"
 
 namespace gui {
 
 	//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
 	/*!
-		@brief	ターミナル・クラス
-		@param[in]	SX		横幅
-		@param[in]	SY		高さ
+		@brief	ターミナル・ベース・クラス @n
+				バッファは派生クラス（term）が持つ。
 	*/
 	//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
-	template <uint32_t SX, uint32_t SY>
-	struct term : public widget {
+	struct term_base : public widget {
 
-		typedef term value_type;
+		typedef term_base value_type;
+
+		//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+		/*!
+			@brief	セル型
+		*/
+		//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+		struct cell_t {
+			uint16_t	code;	///< 文字コード（UTF-16）
+			uint8_t		color;	///< 色（上位４ビット：前景、下位４ビット：背景）
+			uint8_t		attr;	///< 属性
+
+			bool operator == (const cell_t& t) const noexcept {
+				return code == t.code && color == t.color && attr == t.attr;
+			}
+			bool operator != (const cell_t& t) const noexcept { return !(*this == t); }
+		};
+
+
+		//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+		/*!
+			@brief	属性
+		*/
+		//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+		struct ATTR {
+			static const uint8_t BOLD      = 0x01;	///< 太字（明るい前景色）
+			static const uint8_t UNDERLINE = 0x02;	///< 下線
+			static const uint8_t REVERSE   = 0x04;	///< 反転
+			static const uint8_t WIDE      = 0x08;	///< 全角文字の右半分
+			static const uint8_t CURSOR    = 0x80;	///< カーソル（描画時のみ）
+		};
+
+
+		//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+		/*!
+			@brief	統計
+		*/
+		//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+		struct stat_t {
+			uint32_t	chars;	///< 処理したバイト数
+			uint32_t	cells;	///< 描画したセル数
+			uint32_t	moves;	///< ブロック転送の回数
+			uint32_t	lines;	///< スクロールした行数
+		};
+
+		static const uint8_t DEF_FG = 7;	///< 標準の前景色
+		static const uint8_t DEF_BG = 0;	///< 標準の背景色
 
 	private:
-		uint8_t		code_[SX * SY];
+		static const uint16_t INVALID_CODE = 0xffff;
+		static const uint32_t PARAM_MAX = 8;
+
+		enum class PS : uint8_t {
+			NORMAL,
+			ESC,
+			CSI,
+			CHARSET,
+			OSC,
+		};
+
+		cell_t*		cell_;		///< 画面
+		cell_t*		disp_;		///< 描画済みの画面
+		cell_t*		line_;		///< スクロールバック展開用
+		uint8_t*	dirty_;		///< 行の更新フラグ
+		uint8_t*	sb_;		///< スクロールバック・バッファ
+		uint32_t	sb_size_;
+		uint32_t	sb_head_;
+		uint32_t	sb_tail_;
+		uint32_t	sb_used_;
+		uint32_t	sb_lines_;
+
+		int16_t		sx_;
+		int16_t		sy_;
+
+		vtx::spos	cur_;
+		vtx::spos	dcur_;		///< 描画済みのカーソル位置
+		vtx::spos	save_cur_;
+		uint8_t		save_color_;
+		uint8_t		save_attr_;
+		uint8_t		color_;
+		uint8_t		attr_;
+		int16_t		top_;		///< スクロール領域（先頭行）
+		int16_t		bot_;		///< スクロール領域（最終行）
+		bool		wrap_pend_;
+		bool		autowrap_;
+		bool		cursor_ena_;
+		bool		redraw_;
+
+		PS			ps_;
+		uint16_t	param_[PARAM_MAX];
+		uint8_t		pnum_;
+		bool		priv_;
+		uint16_t	u8code_;
+		uint8_t		u8cnt_;
+
+		// 描画待ちのスクロール（正：上、負：下）
+		int16_t		pscr_;
+		int16_t		pscr_top_;
+		int16_t		pscr_bot_;
+		bool		pscr_ok_;
+
+		uint32_t	view_;		///< スクロールバックの表示位置（行）
+
+		stat_t		stat_;
+
+		static graphics::share_color palette_(uint8_t idx) noexcept
+		{
+			static const uint8_t rgb[16][3] = {
+				{   0,   0,   0 }, { 170,   0,   0 }, {   0, 170,   0 }, { 170,  85,   0 },
+				{   0,   0, 170 }, { 170,   0, 170 }, {   0, 170, 170 }, { 170, 170, 170 },
+				{  85,  85,  85 }, { 255,  85,  85 }, {  85, 255,  85 }, { 255, 255,  85 },
+				{  85,  85, 255 }, { 255,  85, 255 }, {  85, 255, 255 }, { 255, 255, 255 },
+			};
+			const auto& t = rgb[idx & 15];
+			return graphics::share_color(t[0], t[1], t[2]);
+		}
+
+		cell_t* row_(int16_t y) noexcept { return &cell_[y * sx_]; }
+
+		cell_t blank_() const noexcept {
+			return cell_t { ' ', static_cast<uint8_t>((DEF_FG << 4) | (color_ & 15)), 0 };
+		}
+
+		static bool is_wide_(uint16_t code) noexcept { return code >= 0x80; }
+
+		void dirty_rows_(int16_t y0, int16_t y1) noexcept
+		{
+			for(int16_t y = y0; y <= y1; ++y) dirty_[y] = 1;
+		}
+
+		void fill_(int16_t y, int16_t x0, int16_t x1) noexcept
+		{
+			auto b = blank_();
+			auto p = row_(y);
+			for(int16_t x = x0; x < x1; ++x) p[x] = b;
+			dirty_[y] = 1;
+		}
+
+
+		//---------- スクロールバック ----------//
+
+		void sb_put_(uint8_t v) noexcept
+		{
+			sb_[sb_head_] = v;
+			++sb_head_;
+			if(sb_head_ >= sb_size_) sb_head_ = 0;
+		}
+
+		uint8_t sb_at_(uint32_t pos) const noexcept
+		{
+			return sb_[pos % sb_size_];
+		}
+
+		uint16_t sb_len_(uint32_t pos) const noexcept
+		{
+			return sb_at_(pos) | (static_cast<uint16_t>(sb_at_(pos + 1)) << 8);
+		}
+
+		void sb_push_(const cell_t* src) noexcept
+		{
+			if(sb_size_ == 0) return;
+
+			// 行末の空白を削除
+			int16_t n = sx_;
+			while(n > 0) {
+				const auto& c = src[n - 1];
+				if(c.code != ' ' || (c.color & 15) != DEF_BG || (c.attr & (ATTR::UNDERLINE | ATTR::REVERSE)) != 0) {
+					break;
+				}
+				--n;
+			}
+			// 長さを求める
+			uint32_t len = 0;
+			uint8_t color = (DEF_FG << 4) | DEF_BG;
+			uint8_t attr = 0;
+			for(int16_t i = 0; i < n; ++i) {
+				const auto& c = src[i];
+				if(c.attr & ATTR::WIDE) continue;
+				if(c.color != color || c.attr != attr) {
+					len += 3;
+					color = c.color;
+					attr = c.attr;
+				}
+				len += c.code < 0x80 ? 1 : (c.code < 0x800 ? 2 : 3);
+			}
+			uint32_t need = len + 4;
+			if(need > sb_size_) return;
+			while((sb_used_ + need) > sb_size_) {  // 古い行を捨てる
+				auto l = sb_len_(sb_tail_);
+				sb_tail_ = (sb_tail_ + l + 4) % sb_size_;
+				sb_used_ -= l + 4;
+				--sb_lines_;
+			}
+			sb_put_(len & 0xff);
+			sb_put_(len >> 8);
+			color = (DEF_FG << 4) | DEF_BG;
+			attr = 0;
+			for(int16_t i = 0; i < n; ++i) {
+				const auto& c = src[i];
+				if(c.attr & ATTR::WIDE) continue;
+				if(c.color != color || c.attr != attr) {
+					sb_put_(0x1b);
+					sb_put_(c.color);
+					sb_put_(c.attr);
+					color = c.color;
+					attr = c.attr;
+				}
+				auto code = c.code;
+				if(code < 0x80) {
+					sb_put_(code);
+				} else if(code < 0x800) {
+					sb_put_(0xc0 | (code >> 6));
+					sb_put_(0x80 | (code & 0x3f));
+				} else {
+					sb_put_(0xe0 | (code >> 12));
+					sb_put_(0x80 | ((code >> 6) & 0x3f));
+					sb_put_(0x80 | (code & 0x3f));
+				}
+			}
+			sb_put_(len & 0xff);
+			sb_put_(len >> 8);
+			sb_used_ += need;
+			++sb_lines_;
+		}
+
+
+		// 新しい方から k 番目（０が最新）の行の先頭
+		uint32_t sb_find_(uint32_t k) const noexcept
+		{
+			uint32_t pos = sb_head_ + sb_size_;
+			for(uint32_t i = 0; i <= k; ++i) {
+				auto l = sb_len_(pos - 2);
+				pos -= l + 4;
+			}
+			return pos % sb_size_;
+		}
+
+
+		// pos の行を line_ に展開して、次の行の位置を返す
+		uint32_t sb_decode_(uint32_t pos) noexcept
+		{
+			auto len = sb_len_(pos);
+			for(int16_t x = 0; x < sx_; ++x) {
+				line_[x] = cell_t { ' ', (DEF_FG << 4) | DEF_BG, 0 };
+			}
+			uint8_t color = (DEF_FG << 4) | DEF_BG;
+			uint8_t attr = 0;
+			uint32_t p = pos + 2;
+			uint32_t end = p + len;
+			int16_t x = 0;
+			while(p < end && x < sx_) {
+				uint8_t ch = sb_at_(p++);
+				if(ch == 0x1b) {
+					color = sb_at_(p++);
+					attr = sb_at_(p++);
+					continue;
+				}
+				uint16_t code = ch;
+				if((ch & 0xe0) == 0xc0) {
+					code = ((ch & 0x1f) << 6) | (sb_at_(p++) & 0x3f);
+				} else if((ch & 0xf0) == 0xe0) {
+					code = ((ch & 0x0f) << 12) | ((sb_at_(p) & 0x3f) << 6) | (sb_at_(p + 1) & 0x3f);
+					p += 2;
+				}
+				line_[x++] = cell_t { code, color, attr };
+				if(is_wide_(code) && x < sx_) {
+					line_[x++] = cell_t { ' ', color, static_cast<uint8_t>(attr | ATTR::WIDE) };
+				}
+			}
+			return (pos + len + 4) % sb_size_;
+		}
+
+
+		//---------- スクロール ----------//
+
+		void add_scroll_(int16_t top, int16_t bot, int16_t n) noexcept
+		{
+			if(pscr_ == 0 && pscr_ok_) {
+				pscr_top_ = top;
+				pscr_bot_ = bot;
+				pscr_ = n;
+			} else if(pscr_top_ == top && pscr_bot_ == bot) {
+				pscr_ += n;
+			} else {  // 領域が違う場合は、差分描画に任せる
+				pscr_ = 0;
+				pscr_ok_ = false;
+			}
+		}
+
+
+		void scroll_up_(int16_t top, int16_t bot, int16_t n, bool save) noexcept
+		{
+			int16_t h = bot - top + 1;
+			if(n <= 0) return;
+			if(n > h) n = h;
+			if(save) {
+				for(int16_t i = 0; i < n; ++i) sb_push_(row_(top + i));
+			}
+			std::memmove(row_(top), row_(top + n), (h - n) * sx_ * sizeof(cell_t));
+			for(int16_t y = bot - n + 1; y <= bot; ++y) fill_(y, 0, sx_);
+			dirty_rows_(top, bot);
+			add_scroll_(top, bot, n);
+			stat_.lines += n;
+		}
+
+
+		void scroll_down_(int16_t top, int16_t bot, int16_t n) noexcept
+		{
+			int16_t h = bot - top + 1;
+			if(n <= 0) return;
+			if(n > h) n = h;
+			std::memmove(row_(top + n), row_(top), (h - n) * sx_ * sizeof(cell_t));
+			for(int16_t y = top; y < (top + n); ++y) fill_(y, 0, sx_);
+			dirty_rows_(top, bot);
+			add_scroll_(top, bot, -n);
+			stat_.lines += n;
+		}
+
+
+		//---------- カーソル、文字 ----------//
+
+		void set_cur_(int16_t x, int16_t y) noexcept
+		{
+			if(x < 0) x = 0; else if(x >= sx_) x = sx_ - 1;
+			if(y < 0) y = 0; else if(y >= sy_) y = sy_ - 1;
+			cur_.set(x, y);
+			wrap_pend_ = false;
+		}
+
+
+		void linefeed_() noexcept
+		{
+			if(cur_.y == bot_) {
+				scroll_up_(top_, bot_, 1, top_ == 0);
+			} else if(cur_.y < (sy_ - 1)) {
+				++cur_.y;
+			}
+			wrap_pend_ = false;
+		}
+
+
+		void reverse_index_() noexcept
+		{
+			if(cur_.y == top_) {
+				scroll_down_(top_, bot_, 1);
+			} else if(cur_.y > 0) {
+				--cur_.y;
+			}
+			wrap_pend_ = false;
+		}
+
+
+		// 全角文字の片側を上書きする場合、もう片側を消す
+		void break_wide_(int16_t x) noexcept
+		{
+			auto p = row_(cur_.y);
+			if((p[x].attr & ATTR::WIDE) != 0 && x > 0) {
+				p[x - 1] = blank_();
+			}
+			if(is_wide_(p[x].code) && (x + 1) < sx_ && (p[x + 1].attr & ATTR::WIDE) != 0) {
+				p[x + 1] = blank_();
+			}
+		}
+
+
+		void put_(uint16_t code) noexcept
+		{
+			int16_t w = is_wide_(code) ? 2 : 1;
+			if(wrap_pend_ && autowrap_) {
+				cur_.x = 0;
+				linefeed_();
+			}
+			if((cur_.x + w) > sx_) {  // 全角文字が右端に入らない
+				if(!autowrap_) return;
+				fill_(cur_.y, cur_.x, sx_);
+				cur_.x = 0;
+				linefeed_();
+			}
+			auto p = row_(cur_.y);
+			break_wide_(cur_.x);
+			p[cur_.x] = cell_t { code, color_, attr_ };
+			if(w == 2) {
+				break_wide_(cur_.x + 1);
+				p[cur_.x + 1] = cell_t { ' ', color_, static_cast<uint8_t>(attr_ | ATTR::WIDE) };
+			}
+			dirty_[cur_.y] = 1;
+			cur_.x += w;
+			if(cur_.x >= sx_) {
+				cur_.x = sx_ - 1;
+				wrap_pend_ = true;
+			}
+		}
+
+
+		void control_(char ch) noexcept
+		{
+			switch(ch) {
+			case 0x08:  // BS
+				if(cur_.x > 0) --cur_.x;
+				wrap_pend_ = false;
+				break;
+			case 0x09:  // HT
+				set_cur_((cur_.x + 8) & ~7, cur_.y);
+				break;
+			case 0x0a:  // LF
+			case 0x0b:  // VT
+			case 0x0c:  // FF
+				linefeed_();
+				break;
+			case 0x0d:  // CR
+				cur_.x = 0;
+				wrap_pend_ = false;
+				break;
+			default:
+				break;
+			}
+		}
+
+
+		uint16_t param_at_(uint32_t idx, uint16_t def) const noexcept
+		{
+			if(idx >= pnum_ || param_[idx] == 0) return def;
+			return param_[idx];
+		}
+
+
+		void sgr_() noexcept
+		{
+			if(pnum_ == 0) {
+				color_ = (DEF_FG << 4) | DEF_BG;
+				attr_ = 0;
+				return;
+			}
+			for(uint32_t i = 0; i < pnum_; ++i) {
+				auto n = param_[i];
+				if(n == 0) {
+					color_ = (DEF_FG << 4) | DEF_BG;
+					attr_ = 0;
+				} else if(n == 1) {
+					attr_ |= ATTR::BOLD;
+				} else if(n == 4) {
+					attr_ |= ATTR::UNDERLINE;
+				} else if(n == 7) {
+					attr_ |= ATTR::REVERSE;
+				} else if(n == 22) {
+					attr_ &= ~ATTR::BOLD;
+				} else if(n == 24) {
+					attr_ &= ~ATTR::UNDERLINE;
+				} else if(n == 27) {
+					attr_ &= ~ATTR::REVERSE;
+				} else if(n >= 30 && n <= 37) {
+					color_ = ((n - 30) << 4) | (color_ & 15);
+				} else if(n == 39) {
+					color_ = (DEF_FG << 4) | (color_ & 15);
+				} else if(n >= 40 && n <= 47) {
+					color_ = (color_ & 0xf0) | (n - 40);
+				} else if(n == 49) {
+					color_ = (color_ & 0xf0) | DEF_BG;
+				} else if(n >= 90 && n <= 97) {
+					color_ = ((n - 90 + 8) << 4) | (color_ & 15);
+				} else if(n >= 100 && n <= 107) {
+					color_ = (color_ & 0xf0) | (n - 100 + 8);
+				} else if((n == 38 || n == 48) && (i + 1) < pnum_) {
+					// 256 色、RGB 指定は１６色の範囲だけ使う
+					uint8_t c = 0xff;
+					if(param_[i + 1] == 5 && (i + 2) < pnum_) {
+						if(param_[i + 2] < 16) c = param_[i + 2];
+						i += 2;
+					} else if(param_[i + 1] == 2) {
+						i += 4;
+					}
+					if(c != 0xff) {
+						if(n == 38) color_ = (c << 4) | (color_ & 15);
+						else color_ = (color_ & 0xf0) | c;
+					}
+				}
+			}
+		}
+
+
+		void csi_(char ch) noexcept
+		{
+			int16_t n = param_at_(0, 1);
+			auto p = row_(cur_.y);
+			switch(ch) {
+			case 'A':
+				set_cur_(cur_.x, cur_.y - n);
+				break;
+			case 'B':
+				set_cur_(cur_.x, cur_.y + n);
+				break;
+			case 'C':
+				set_cur_(cur_.x + n, cur_.y);
+				break;
+			case 'D':
+				set_cur_(cur_.x - n, cur_.y);
+				break;
+			case 'E':
+				set_cur_(0, cur_.y + n);
+				break;
+			case 'F':
+				set_cur_(0, cur_.y - n);
+				break;
+			case 'G':
+			case '`':
+				set_cur_(n - 1, cur_.y);
+				break;
+			case 'd':
+				set_cur_(cur_.x, n - 1);
+				break;
+			case 'H':
+			case 'f':
+				set_cur_(param_at_(1, 1) - 1, n - 1);
+				break;
+			case 'J':
+				switch(param_at_(0, 0)) {
+				case 0:
+					fill_(cur_.y, cur_.x, sx_);
+					for(int16_t y = cur_.y + 1; y < sy_; ++y) fill_(y, 0, sx_);
+					break;
+				case 1:
+					for(int16_t y = 0; y < cur_.y; ++y) fill_(y, 0, sx_);
+					fill_(cur_.y, 0, cur_.x + 1);
+					break;
+				case 2:
+					for(int16_t y = 0; y < sy_; ++y) fill_(y, 0, sx_);
+					break;
+				case 3:
+					clear_scrollback();
+					for(int16_t y = 0; y < sy_; ++y) fill_(y, 0, sx_);
+					break;
+				}
+				break;
+			case 'K':
+				switch(param_at_(0, 0)) {
+				case 0: fill_(cur_.y, cur_.x, sx_); break;
+				case 1: fill_(cur_.y, 0, cur_.x + 1); break;
+				case 2: fill_(cur_.y, 0, sx_); break;
+				}
+				break;
+			case 'L':
+				if(cur_.y >= top_ && cur_.y <= bot_) {
+					scroll_down_(cur_.y, bot_, n);
+					cur_.x = 0;
+				}
+				break;
+			case 'M':
+				if(cur_.y >= top_ && cur_.y <= bot_) {
+					scroll_up_(cur_.y, bot_, n, false);
+					cur_.x = 0;
+				}
+				break;
+			case 'S':
+				scroll_up_(top_, bot_, n, false);
+				break;
+			case 'T':
+				scroll_down_(top_, bot_, n);
+				break;
+			case '@':
+				if(n > (sx_ - cur_.x)) n = sx_ - cur_.x;
+				std::memmove(&p[cur_.x + n], &p[cur_.x], (sx_ - cur_.x - n) * sizeof(cell_t));
+				fill_(cur_.y, cur_.x, cur_.x + n);
+				break;
+			case 'P':
+				if(n > (sx_ - cur_.x)) n = sx_ - cur_.x;
+				std::memmove(&p[cur_.x], &p[cur_.x + n], (sx_ - cur_.x - n) * sizeof(cell_t));
+				fill_(cur_.y, sx_ - n, sx_);
+				break;
+			case 'X':
+				fill_(cur_.y, cur_.x, std::min<int16_t>(cur_.x + n, sx_));
+				break;
+			case 'm':
+				sgr_();
+				break;
+			case 'r':
+				{
+					int16_t t = param_at_(0, 1) - 1;
+					int16_t b = param_at_(1, sy_) - 1;
+					if(b >= sy_) b = sy_ - 1;
+					if(t < b) {
+						top_ = t;
+						bot_ = b;
+						set_cur_(0, 0);
+					}
+				}
+				break;
+			case 's':
+				save_cursor_();
+				break;
+			case 'u':
+				restore_cursor_();
+				break;
+			case 'h':
+			case 'l':
+				if(priv_) {
+					for(uint32_t i = 0; i < pnum_; ++i) {
+						if(param_[i] == 25) cursor_ena_ = ch == 'h';
+						else if(param_[i] == 7) autowrap_ = ch == 'h';
+					}
+				}
+				break;
+			default:
+				break;
+			}
+		}
+
+
+		void save_cursor_() noexcept
+		{
+			save_cur_ = cur_;
+			save_color_ = color_;
+			save_attr_ = attr_;
+		}
+
+
+		void restore_cursor_() noexcept
+		{
+			set_cur_(save_cur_.x, save_cur_.y);
+			color_ = save_color_;
+			attr_ = save_attr_;
+		}
+
+
+		void esc_(char ch) noexcept
+		{
+			ps_ = PS::NORMAL;
+			switch(ch) {
+			case '[':
+				ps_ = PS::CSI;
+				pnum_ = 0;
+				priv_ = false;
+				std::memset(param_, 0, sizeof(param_));
+				break;
+			case ']':
+				ps_ = PS::OSC;
+				break;
+			case '(':
+			case ')':
+				ps_ = PS::CHARSET;
+				break;
+			case '7':
+				save_cursor_();
+				break;
+			case '8':
+				restore_cursor_();
+				break;
+			case 'D':
+				linefeed_();
+				break;
+			case 'E':
+				cur_.x = 0;
+				linefeed_();
+				break;
+			case 'M':
+				reverse_index_();
+				break;
+			case 'c':
+				reset();
+				break;
+			default:
+				break;
+			}
+		}
+
+
+		void utf8_(uint8_t ch) noexcept
+		{
+			if(ch < 0x80) {
+				u8cnt_ = 0;
+				put_(ch);
+			} else if((ch & 0xc0) == 0x80) {
+				if(u8cnt_ == 0) return;
+				u8code_ = (u8code_ << 6) | (ch & 0x3f);
+				--u8cnt_;
+				if(u8cnt_ == 0) put_(u8code_);
+			} else if((ch & 0xe0) == 0xc0) {
+				u8code_ = ch & 0x1f;
+				u8cnt_ = 1;
+			} else if((ch & 0xf0) == 0xe0) {
+				u8code_ = ch & 0x0f;
+				u8cnt_ = 2;
+			} else {  // BMP 外は表示できない
+				u8cnt_ = 0;
+				put_('?');
+			}
+		}
+
+
+		//---------- 描画 ----------//
+
+		template <class RDR>
+		void draw_cell_(RDR& rdr, const vtx::spos& org, int16_t x, int16_t y, const cell_t& c, int16_t w) noexcept
+		{
+			static const int16_t CW = RDR::font_type::a_type::width;
+			static const int16_t CH = RDR::font_type::height;
+
+			vtx::spos pos(org.x + x * CW, org.y + y * CH);
+			uint8_t fg = c.color >> 4;
+			uint8_t bg = c.color & 15;
+			if((c.attr & ATTR::BOLD) != 0 && fg < 8) fg += 8;
+			if(((c.attr & ATTR::REVERSE) != 0) != ((c.attr & ATTR::CURSOR) != 0)) {
+				std::swap(fg, bg);
+			}
+			rdr.set_fore_color(palette_(bg));
+			if(c.code == ' ' || (c.attr & ATTR::WIDE) != 0 || RDR::font_type::a_type::height < CH) {
+				rdr.fill_box(vtx::srect(pos, vtx::spos(CW * w, CH)));
+			}
+			rdr.set_fore_color(palette_(fg));
+			if(c.code != ' ' && (c.attr & ATTR::WIDE) == 0) {
+				rdr.set_back_color(palette_(bg));
+				rdr.draw_font_utf16(pos, c.code, true);
+			}
+			if(c.attr & ATTR::UNDERLINE) {
+				rdr.line_h(pos.y + CH - 1, pos.x, CW * w);
+			}
+			stat_.cells += w;
+		}
+
+	protected:
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	バッファの設定（派生クラスのコンストラクターから呼ぶ）
+		*/
+		//-----------------------------------------------------------------//
+		void setup_(cell_t* cell, cell_t* disp, cell_t* line, uint8_t* dirty, uint8_t* sb, uint32_t sbsz)
+			noexcept
+		{
+			cell_ = cell;
+			disp_ = disp;
+			line_ = line;
+			dirty_ = dirty;
+			sb_ = sb;
+			sb_size_ = sbsz;
+			reset();
+		}
 
 	public:
 		//-----------------------------------------------------------------//
@@ -33,16 +772,25 @@ namespace gui {
 			@brief	コンストラクター
 			@param[in]	loc		ロケーション
 			@param[in]	str		タイトル
+			@param[in]	sx		横幅（文字数）
+			@param[in]	sy		高さ（行数）
 		*/
 		//-----------------------------------------------------------------//
-		term(const vtx::srect& loc = vtx::srect(0), const char* str = nullptr) noexcept :
-			widget(loc, str), code_{ 0x20 }
+		term_base(const vtx::srect& loc, const char* str, int16_t sx, int16_t sy) noexcept :
+			widget(loc, str),
+			cell_(nullptr), disp_(nullptr), line_(nullptr), dirty_(nullptr),
+			sb_(nullptr), sb_size_(0), sb_head_(0), sb_tail_(0), sb_used_(0), sb_lines_(0),
+			sx_(sx), sy_(sy), cur_(0), dcur_(0), save_cur_(0), save_color_(0), save_attr_(0),
+			color_((DEF_FG << 4) | DEF_BG), attr_(0), top_(0), bot_(sy - 1),
+			wrap_pend_(false), autowrap_(true), cursor_ena_(true), redraw_(true),
+			ps_(PS::NORMAL), param_{ 0 }, pnum_(0), priv_(false), u8code_(0), u8cnt_(0),
+			pscr_(0), pscr_top_(0), pscr_bot_(0), pscr_ok_(true), view_(0), stat_{ }
 		{
 			insert_widget(this);
 		}
 
-		term(const term& th) = delete;
-		term& operator = (const term& th) = delete;
+		term_base(const term_base& th) = delete;
+		term_base& operator = (const term_base& th) = delete;
 
 
 		//-----------------------------------------------------------------//
@@ -50,7 +798,7 @@ namespace gui {
 			@brief	デストラクタ
 		*/
 		//-----------------------------------------------------------------//
-		virtual ~term() noexcept { remove_widget(this); }
+		virtual ~term_base() noexcept { remove_widget(this); }
 
 
 		//-----------------------------------------------------------------//
@@ -76,7 +824,7 @@ namespace gui {
 			@brief	初期化
 		*/
 		//-----------------------------------------------------------------//
-		void init() noexcept override { }
+		void init() noexcept override { redraw_ = true; }
 
 
 		//-----------------------------------------------------------------//
@@ -84,7 +832,6 @@ namespace gui {
 			@brief	タッチ判定を更新
 			@param[in]	pos		判定位置
 			@param[in]	num		タッチ数
-			@param[in]	slt		スライド・タイプの場合「true」
 		*/
 		//-----------------------------------------------------------------//
 		void update_touch(const vtx::spos& pos, uint16_t num) noexcept override { }
@@ -107,7 +854,375 @@ namespace gui {
 		//-----------------------------------------------------------------//
 		void enable(bool ena = true) override
 		{
+			if(ena) {
+				set_state(STATE::ENABLE);
+				redraw_ = true;
+			} else {
+				set_state(STATE::DISABLE);
+				reset_touch_state();
+			}
 		}
 
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	リセット（画面、属性、スクロール領域を初期化）
+		*/
+		//-----------------------------------------------------------------//
+		void reset() noexcept
+		{
+			color_ = (DEF_FG << 4) | DEF_BG;
+			attr_ = 0;
+			top_ = 0;
+			bot_ = sy_ - 1;
+			autowrap_ = true;
+			cursor_ena_ = true;
+			ps_ = PS::NORMAL;
+			u8cnt_ = 0;
+			save_cur_.set(0, 0);
+			save_color_ = color_;
+			save_attr_ = 0;
+			for(int16_t y = 0; y < sy_; ++y) fill_(y, 0, sx_);
+			set_cur_(0, 0);
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	スクロールバックを消去
+		*/
+		//-----------------------------------------------------------------//
+		void clear_scrollback() noexcept
+		{
+			sb_head_ = 0;
+			sb_tail_ = 0;
+			sb_used_ = 0;
+			sb_lines_ = 0;
+			if(view_ != 0) {
+				view_ = 0;
+				redraw_ = true;
+			}
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	文字出力（UTF-8、エスケープ・シーケンスを解釈）
+			@param[in]	ch	文字
+		*/
+		//-----------------------------------------------------------------//
+		void putch(char ch) noexcept
+		{
+			++stat_.chars;
+			if(view_ != 0) {  // 出力があったら、スクロールバック表示を解除
+				view_ = 0;
+				pscr_ = 0;
+				pscr_ok_ = false;
+				dirty_rows_(0, sy_ - 1);
+			}
+			set_update();
+
+			auto c = static_cast<uint8_t>(ch);
+			switch(ps_) {
+			case PS::NORMAL:
+				if(c == 0x1b) {
+					ps_ = PS::ESC;
+				} else if(c < 0x20) {
+					control_(ch);
+				} else if(c != 0x7f) {
+					utf8_(c);
+				}
+				break;
+			case PS::ESC:
+				esc_(ch);
+				break;
+			case PS::CSI:
+				if(ch >= '0' && ch <= '9') {
+					if(pnum_ == 0) pnum_ = 1;
+					if(pnum_ <= PARAM_MAX) {
+						auto& v = param_[pnum_ - 1];
+						v = v * 10 + (ch - '0');
+					}
+				} else if(ch == ';') {
+					if(pnum_ == 0) pnum_ = 1;
+					if(pnum_ < PARAM_MAX) ++pnum_;
+				} else if(ch == '?') {
+					priv_ = true;
+				} else if(c >= 0x40 && c <= 0x7e) {
+					if(pnum_ > PARAM_MAX) pnum_ = PARAM_MAX;
+					ps_ = PS::NORMAL;
+					csi_(ch);
+				} else if(c < 0x20) {
+					if(c == 0x1b) ps_ = PS::ESC;
+					else control_(ch);
+				}
+				break;
+			case PS::CHARSET:
+				ps_ = PS::NORMAL;
+				break;
+			case PS::OSC:
+				if(c == 0x07) ps_ = PS::NORMAL;
+				else if(c == 0x1b) ps_ = PS::ESC;
+				break;
+			}
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	文字列出力
+			@param[in]	str		文字列
+		*/
+		//-----------------------------------------------------------------//
+		void puts(const char* str) noexcept
+		{
+			if(str == nullptr) return;
+			char ch;
+			while((ch = *str++) != 0) {
+				putch(ch);
+			}
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	出力
+			@param[in]	src		ソース
+			@param[in]	len		長さ
+		*/
+		//-----------------------------------------------------------------//
+		void write(const void* src, uint32_t len) noexcept
+		{
+			auto p = static_cast<const char*>(src);
+			for(uint32_t i = 0; i < len; ++i) {
+				putch(p[i]);
+			}
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	横幅（文字数）を取得
+			@return 横幅
+		*/
+		//-----------------------------------------------------------------//
+		int16_t get_sx() const noexcept { return sx_; }
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	高さ（行数）を取得
+			@return 高さ
+		*/
+		//-----------------------------------------------------------------//
+		int16_t get_sy() const noexcept { return sy_; }
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	カーソル位置を取得
+			@return カーソル位置
+		*/
+		//-----------------------------------------------------------------//
+		const vtx::spos& get_cursor() const noexcept { return cur_; }
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	セルを取得
+			@param[in]	x	X 位置
+			@param[in]	y	Y 位置
+			@return セル
+		*/
+		//-----------------------------------------------------------------//
+		const cell_t& get_cell(int16_t x, int16_t y) const noexcept { return cell_[y * sx_ + x]; }
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	スクロールバックの行数を取得
+			@return 行数
+		*/
+		//-----------------------------------------------------------------//
+		uint32_t get_scrollback() const noexcept { return sb_lines_; }
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	スクロールバックの表示位置を設定 @n
+					※文字が出力されると、０（最新）に戻る
+			@param[in]	view	戻る行数（０で最新）
+		*/
+		//-----------------------------------------------------------------//
+		void set_view(uint32_t view) noexcept
+		{
+			if(view > sb_lines_) view = sb_lines_;
+			if(view == view_) return;
+			add_scroll_(0, sy_ - 1, static_cast<int16_t>(view_) - static_cast<int16_t>(view));
+			view_ = view;
+			dirty_rows_(0, sy_ - 1);
+			set_update();
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	スクロールバックの表示位置を取得
+			@return 表示位置
+		*/
+		//-----------------------------------------------------------------//
+		uint32_t get_view() const noexcept { return view_; }
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	全体を再描画する
+		*/
+		//-----------------------------------------------------------------//
+		void redraw() noexcept
+		{
+			redraw_ = true;
+			set_update();
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	統計を取得
+			@return 統計
+		*/
+		//-----------------------------------------------------------------//
+		const stat_t& get_stat() const noexcept { return stat_; }
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	統計をクリア
+		*/
+		//-----------------------------------------------------------------//
+		void clear_stat() noexcept { stat_ = stat_t { }; }
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	描画（変化したセルだけ描画する）
+			@param[in]	rdr	レンダー・クラス
+		*/
+		//-----------------------------------------------------------------//
+		template <class RDR>
+		void draw(RDR& rdr) noexcept
+		{
+			static const int16_t CW = RDR::font_type::a_type::width;
+			static const int16_t CH = RDR::font_type::height;
+
+			auto org = get_final_position();
+			if(redraw_) {
+				redraw_ = false;
+				for(int32_t i = 0; i < (sx_ * sy_); ++i) {
+					disp_[i] = cell_t { INVALID_CODE, 0, 0 };
+				}
+				dirty_rows_(0, sy_ - 1);
+				pscr_ = 0;
+			}
+
+			// スクロールは、描画済みの画面をブロック転送
+			int16_t h = pscr_bot_ - pscr_top_ + 1;
+			if(pscr_ok_ && pscr_ != 0 && pscr_ > -h && pscr_ < h) {
+				int16_t n = pscr_ > 0 ? pscr_ : -pscr_;
+				if(pscr_ > 0) {  // 上
+					rdr.move(vtx::srect(org.x, org.y + (pscr_top_ + n) * CH, sx_ * CW, (h - n) * CH),
+						vtx::spos(org.x, org.y + pscr_top_ * CH));
+					std::memmove(&disp_[pscr_top_ * sx_], &disp_[(pscr_top_ + n) * sx_],
+						(h - n) * sx_ * sizeof(cell_t));
+				} else {  // 下（重なるので下の行から）
+					for(int16_t y = pscr_bot_ - n; y >= pscr_top_; --y) {
+						rdr.move(vtx::srect(org.x, org.y + y * CH, sx_ * CW, CH),
+							vtx::spos(org.x, org.y + (y + n) * CH));
+					}
+					std::memmove(&disp_[(pscr_top_ + n) * sx_], &disp_[pscr_top_ * sx_],
+						(h - n) * sx_ * sizeof(cell_t));
+				}
+				++stat_.moves;
+			}
+			pscr_ = 0;
+			pscr_ok_ = true;
+
+			// カーソルの移動
+			if(dcur_ != cur_) {
+				dirty_[dcur_.y] = 1;
+				dirty_[cur_.y] = 1;
+			}
+			dcur_ = cur_;
+			bool cursor = cursor_ena_ && view_ == 0;
+
+			uint32_t sbpos = 0;
+			if(view_ > 0) sbpos = sb_find_(view_ - 1);
+			for(int16_t y = 0; y < sy_; ++y) {
+				const cell_t* src;
+				if(static_cast<uint32_t>(y) < view_) {
+					sbpos = sb_decode_(sbpos);
+					src = line_;
+				} else {
+					src = &cell_[(y - view_) * sx_];
+				}
+				if(dirty_[y] == 0) continue;
+				dirty_[y] = 0;
+				auto dst = &disp_[y * sx_];
+				for(int16_t x = 0; x < sx_; ++x) {
+					auto c = src[x];
+					if(cursor && y == cur_.y && x == cur_.x) c.attr |= ATTR::CURSOR;
+					bool wide = is_wide_(c.code) && (x + 1) < sx_ && (src[x + 1].attr & ATTR::WIDE) != 0;
+					if(wide) {
+						if(c != dst[x] || src[x + 1] != dst[x + 1]) {
+							draw_cell_(rdr, org, x, y, c, 2);
+							dst[x] = c;
+							dst[x + 1] = src[x + 1];
+						}
+						++x;
+					} else if(c != dst[x]) {
+						if(is_wide_(c.code)) c.code = '?';  // 右端で切れた全角
+						draw_cell_(rdr, org, x, y, c, 1);
+						dst[x] = src[x];
+						if(cursor && y == cur_.y && x == cur_.x) dst[x].attr |= ATTR::CURSOR;
+					}
+				}
+			}
+		}
+	};
+
+
+	//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+	/*!
+		@brief	ターミナル・クラス
+		@param[in]	SX		横幅（文字数）
+		@param[in]	SY		高さ（行数）
+		@param[in]	SBSIZE	スクロールバック・バッファのサイズ（バイト）
+	*/
+	//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+	template <uint32_t SX, uint32_t SY, uint32_t SBSIZE = 8192>
+	struct term : public term_base {
+
+		typedef term value_type;
+
+	private:
+		cell_t		cell_buf_[SX * SY];
+		cell_t		disp_buf_[SX * SY];
+		cell_t		line_buf_[SX];
+		uint8_t		dirty_buf_[SY];
+		uint8_t		sb_buf_[SBSIZE];
+
+	public:
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	コンストラクター
+			@param[in]	loc		ロケーション
+			@param[in]	str		タイトル
+		*/
+		//-----------------------------------------------------------------//
+		term(const vtx::srect& loc = vtx::srect(0), const char* str = nullptr) noexcept :
+			term_base(loc, str, SX, SY)
+		{
+			setup_(cell_buf_, disp_buf_, line_buf_, dirty_buf_, sb_buf_, SBSIZE);
+		}
 	};
 }
@@ -1,7 +1,10 @@
 #pragma once
 //=====================================================================//
 /*!	@file
-	@brief	Tiny 3D Glaphics Library (Tiny OpenGL)
+	@brief	Tiny 3D Glaphics Library (Tiny OpenGL) @n
+			・頂点変換まで行い、クリップ座標系の頂点をバックエンドへ渡す。@n
+			・DRW2D を使う場合：「graphics/tgl_drw2d.hpp」（既定のバックエンド）@n
+			・ソフトウェア描画：「graphics/tgl_soft.hpp」（graphics::render 用）
     @author 平松邦仁 (hira@rvf-rc45.net)
 	@copyright	Copyright (C) 2018, 2021 Kunihito Hiramatsu @n
 				Released under the MIT license @n
@@ -15,6 +18,8 @@
 
 namespace graphics {
 
+	template <class RDR> class tgl_drw2d;
+
 	//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
 	/*!
 		@brief	TinyGL class
@@ -22,33 +27,44 @@ namespace graphics {
 		@param[in]	VNUM	最大頂点数
 		@param[in]	PNUM	最大プリミティブ数
 		@param[in]	TNUM	テクスチャー管理数
+		@param[in]	BACKEND	描画バックエンド（tgl_drw2d、tgl_soft）
 	*/
 	//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
-	template<class RDR, uint32_t VNUM, uint32_t PNUM, uint32_t TNUM>
+	template<class RDR, uint32_t VNUM, uint32_t PNUM, uint32_t TNUM, class BACKEND = tgl_drw2d<RDR>>
 	class tgl : public tgl_base {
 
-		RDR&		rdr_;
+		static const uint32_t CACHE_NUM = 64;	///< 変換済み頂点キャッシュ数（２のべき乗）
+
+		BACKEND		back_;
 
-		// 頂点関係
+		// 頂点関係（座標は、レンダリング時にまとめて変換する為、別の配列に置く）
 		struct vtx_t {
-			vtx::fvtx	p_;		// 頂点
 			vtx::fvtx	n_;		// 法線
 			vtx::fpos	t_;		// テクスチャー座標
+			share_color	c_;		// 頂点カラー
 			bool		normal_;
 			bool		texture_;
-			vtx_t() noexcept : p_(), n_(), t_(), normal_(false), texture_(false) { }
+			vtx_t() noexcept : n_(), t_(), c_(0, 0, 0), normal_(false), texture_(false) { }
 		};
 
 		uint32_t	vtx_idx_;
+		vtx::fvtx4	pos_[VNUM];
 		vtx_t		vtxs_[VNUM];
 
 		// プリミティブ関係
 		struct dt_t {
 			PTYPE		pt_;
-			share_color	col_;
+			uint32_t	tex_;
 			uint32_t	org_;
 			uint32_t	end_;
-			dt_t() noexcept : pt_(PTYPE::NONE), col_(0, 0, 0), org_(0), end_(0) { }
+			// 頂点配列（DrawArrays、DrawElements の場合）
+			const uint16_t*		idx_;
+			const vtx::fvtx*	va_;
+			const share_color*	ca_;
+			const vtx::fpos*	ta_;
+			share_color	col_;
+			dt_t() noexcept : pt_(PTYPE::NONE), tex_(TNUM), org_(0), end_(0),
+				idx_(nullptr), va_(nullptr), ca_(nullptr), ta_(nullptr), col_(0, 0, 0) { }
 		};
 
 		uint32_t	dt_idx_;
@@ -79,36 +95,112 @@ namespace graphics {
 
 		uint32_t	flags_;
 
-		bool test_cw_(const vtx::spos* p, int32_t num) noexcept
+		// 頂点配列
+		const vtx::fvtx*	va_;
+		const share_color*	ca_;
+		const vtx::fpos*	ta_;
+
+		// 変換済み頂点キャッシュ（ダイレクト・マップ）
+		cvtx_t		cache_[CACHE_NUM];
+		uint32_t	tag_[CACHE_NUM];
+
+		uint32_t	xform_count_;
+		uint32_t	hit_count_;
+		uint32_t	cull_count_;
+
+		static void set_color_(const share_color& c, cvtx_t& out) noexcept
+		{
+			out.r = c.rgba8.unit.r;
+			out.g = c.rgba8.unit.g;
+			out.b = c.rgba8.unit.b;
+		}
+
+
+		// プリミティブの i 番目の頂点（クリップ座標系）を得る
+		void fetch_(const MATRIX::matrix_type& wm, const dt_t& t, uint32_t i, cvtx_t& out) noexcept
 		{
-			for(int32_t i = 0; i < (num - 1); ++i) {
-				auto n = i + 1;
-				if(p[i].y >= p[n].y) {
-					if(p[i].x < p[n].x) return true;  // CW
-					else if(p[i].x > p[n].x) return false;  // CCW
+			if(t.va_ == nullptr) {  // Begin/End の頂点（変換済み）
+				auto j = t.org_ + i;
+				const auto& p = pos_[j];
+				const auto& v = vtxs_[j];
+				out.x = p.x;
+				out.y = p.y;
+				out.z = p.z;
+				out.w = p.w;
+				set_color_(v.c_, out);
+				if(v.texture_) {
+					out.s = v.t_.x;
+					out.t = v.t_.y;
 				} else {
-					if(p[i].x > p[n].x) return true;  // CW
-					else if(p[i].x < p[n].x) return false;  // CCW
+					out.s = 0.0f;
+					out.t = 0.0f;
 				}
+				return;
 			}
-			// 判定が出来ない場合は「false」
-			return false;
+
+			uint32_t j = t.idx_ != nullptr ? t.idx_[i] : (t.org_ + i);
+			auto k = j & (CACHE_NUM - 1);
+			if(tag_[k] == j) {
+				out = cache_[k];
+				++hit_count_;
+				return;
+			}
+
+			vtx::fvtx4 d;
+			MATRIX::vertex_world(wm, t.va_[j], d);
+			++xform_count_;
+			out.x = d.x;
+			out.y = d.y;
+			out.z = d.z;
+			out.w = d.w;
+			set_color_(t.ca_ != nullptr ? t.ca_[j] : t.col_, out);
+			if(t.ta_ != nullptr) {
+				out.s = t.ta_[j].x;
+				out.t = t.ta_[j].y;
+			} else {
+				out.s = 0.0f;
+				out.t = 0.0f;
+			}
+			cache_[k] = out;
+			tag_[k] = j;
+		}
+
+
+		bool add_array_(PTYPE pt, uint32_t org, uint32_t end, const uint16_t* idx) noexcept
+		{
+			if(dt_idx_ >= PNUM || va_ == nullptr || org >= end) return false;
+
+			auto& t = dts_[dt_idx_];
+			t.pt_  = pt;
+			t.tex_ = bind_hnd_;
+			t.org_ = org;
+			t.end_ = end;
+			t.idx_ = idx;
+			t.va_  = va_;
+			t.ca_  = ca_;
+			t.ta_  = ta_;
+			t.col_ = color_;
+			++dt_idx_;
+			return true;
 		}
 
 	public:
 		//-----------------------------------------------------------------//
 		/*!
 			@brief	コンストラクター
-			@param[in]	rdr		レンダークラス（DRW2D インスタンス）
+			@param[in]	rdr		レンダークラス
 		*/
 		//-----------------------------------------------------------------//
-		tgl(RDR& rdr) noexcept : rdr_(rdr),
-			vtx_idx_(0), vtxs_{},
+		tgl(RDR& rdr) noexcept : back_(rdr),
+			vtx_idx_(0), pos_{}, vtxs_{},
 			dt_idx_(0), dts_{},
 			color_(0, 0, 0),
 			matrix_(),
 			tex_{ }, bind_hnd_(TNUM),
-			flags_(0)
+			flags_(0),
+			va_(nullptr), ca_(nullptr), ta_(nullptr),
+			cache_{ }, tag_{ },
+			xform_count_(0), hit_count_(0), cull_count_(0)
 		{ }
 
 
@@ -133,7 +225,7 @@ namespace graphics {
 		//-----------------------------------------------------------------//
 		void LineWidth(float w) noexcept
 		{
-			rdr_.set_pen_size(static_cast<int16_t>(w * 16.0f));
+			back_.line_width(w);
 		}
 
 
@@ -148,9 +240,11 @@ namespace graphics {
 			if(dt_idx_ >= PNUM) return;
 
 			dts_[dt_idx_].pt_ = pt;
-			dts_[dt_idx_].col_ = color_;
+			dts_[dt_idx_].tex_ = bind_hnd_;
 			dts_[dt_idx_].org_ = vtx_idx_;
 			dts_[dt_idx_].end_ = vtx_idx_;
+			dts_[dt_idx_].idx_ = nullptr;
+			dts_[dt_idx_].va_  = nullptr;
 		}
 
 
@@ -161,6 +255,7 @@ namespace graphics {
 		//-----------------------------------------------------------------//
 		void End() noexcept
 		{
+			if(dt_idx_ >= PNUM) return;
 			if(dts_[dt_idx_].org_ == vtx_idx_) {
 				return;
 			}
@@ -191,10 +286,12 @@ namespace graphics {
 		void Vertex(float x, float y) noexcept
 		{
 			if(vtx_idx_ >= VNUM) return;
-			auto& p = vtxs_[vtx_idx_].p_;
+			auto& p = pos_[vtx_idx_];
 			p.x = x;
 			p.y = y;
 			p.z = 0.0f;
+			p.w = 1.0f;
+			vtxs_[vtx_idx_].c_ = color_;
 			++vtx_idx_;
 		}
 		void Vertex(const vtx::spos& v) noexcept { Vertex(v.x, v.y); }
@@ -213,10 +310,12 @@ namespace graphics {
 		void Vertex(float x, float y, float z) noexcept
 		{
 			if(vtx_idx_ >= VNUM) return;
-			auto& p = vtxs_[vtx_idx_].p_;
+			auto& p = pos_[vtx_idx_];
 			p.x = x;
 			p.y = y;
 			p.z = z;
+			p.w = 1.0f;
+			vtxs_[vtx_idx_].c_ = color_;
 			++vtx_idx_;
 		}
 		void Vertex(const vtx::svtx& v) noexcept { Vertex(v.x, v.y, v.z); }
@@ -337,6 +436,84 @@ namespace graphics {
 		}
 
 
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	頂点配列の設定 @n
+					配列は、renderring が終わるまで保持する事
+			@param[in]	v	頂点配列（nullptr で解除）
+		*/
+		//-----------------------------------------------------------------//
+		void VertexPointer(const vtx::fvtx* v) noexcept { va_ = v; }
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	頂点カラー配列の設定（nullptr なら Color で指定した色）
+			@param[in]	c	頂点カラー配列
+		*/
+		//-----------------------------------------------------------------//
+		void ColorPointer(const share_color* c) noexcept { ca_ = c; }
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	テクスチャー座標配列の設定
+			@param[in]	t	テクスチャー座標配列（nullptr で解除）
+		*/
+		//-----------------------------------------------------------------//
+		void TexCoordPointer(const vtx::fpos* t) noexcept { ta_ = t; }
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	頂点配列の連続した頂点で描画
+			@param[in]	pt		描画タイプ
+			@param[in]	first	最初の頂点
+			@param[in]	count	頂点数
+			@return 登録出来たら「true」
+		*/
+		//-----------------------------------------------------------------//
+		bool DrawArrays(PTYPE pt, uint32_t first, uint32_t count) noexcept
+		{
+			return add_array_(pt, first, first + count, nullptr);
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	インデックス配列で描画 @n
+					共有される頂点は、変換済み頂点キャッシュにより一度だけ変換される。@n
+					インデックス配列は、renderring が終わるまで保持する事
+			@param[in]	pt		描画タイプ
+			@param[in]	count	インデックス数
+			@param[in]	idx		インデックス配列
+			@return 登録出来たら「true」
+		*/
+		//-----------------------------------------------------------------//
+		bool DrawElements(PTYPE pt, uint32_t count, const uint16_t* idx) noexcept
+		{
+			if(idx == nullptr) return false;
+			return add_array_(pt, 0, count, idx);
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	境界球による視錐台の検査（オブジェクト単位の除去） @n
+					現在のマトリックスで検査する、外側なら描画を省略出来る
+			@param[in]	center	境界球の中心（モデル座標）
+			@param[in]	radius	境界球の半径
+			@return 見える可能性があれば「true」
+		*/
+		//-----------------------------------------------------------------//
+		bool SphereVisible(const vtx::fvtx& center, float radius) noexcept
+		{
+			if(matrix_.sphere_visible(center, radius)) return true;
+			++cull_count_;
+			return false;
+		}
+
+
 		//-----------------------------------------------------------------//
 		/*!
 			@brief	制御フラグの許可
@@ -346,16 +523,77 @@ namespace graphics {
 		//-----------------------------------------------------------------//
 		void enable(CTRL ctrl, bool ena = true) noexcept
 		{
+			if(ena) flags_ |= ctrl_bit(ctrl);
+			else flags_ &= ~ctrl_bit(ctrl);
 		}
 
 
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	制御フラグの状態
+			@param[in]	ctrl	制御フラグ
+			@return 許可されていれば「true」
+		*/
+		//-----------------------------------------------------------------//
+		bool is_enable(CTRL ctrl) const noexcept { return (flags_ & ctrl_bit(ctrl)) != 0; }
+
+
 		//-----------------------------------------------------------------//
 		/*!
 			@brief	マトリックス・クラスへの参照
 			@return マトリックス・クラス
 		*/
 		//-----------------------------------------------------------------//
-		MATRIX& at_matrix() noexcept { return matrix_; }		
+		MATRIX& at_matrix() noexcept { return matrix_; }
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	バックエンドへの参照
+			@return バックエンド
+		*/
+		//-----------------------------------------------------------------//
+		BACKEND& at_backend() noexcept { return back_; }
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	座標変換した頂点数を取得
+			@return 頂点数
+		*/
+		//-----------------------------------------------------------------//
+		uint32_t get_transform_count() const noexcept { return xform_count_; }
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	変換済み頂点キャッシュのヒット数を取得
+			@return ヒット数
+		*/
+		//-----------------------------------------------------------------//
+		uint32_t get_cache_hit_count() const noexcept { return hit_count_; }
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	境界球で除去したオブジェクト数を取得
+			@return オブジェクト数
+		*/
+		//-----------------------------------------------------------------//
+		uint32_t get_cull_count() const noexcept { return cull_count_; }
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	統計のリセット
+		*/
+		//-----------------------------------------------------------------//
+		void reset_count() noexcept
+		{
+			xform_count_ = 0;
+			hit_count_ = 0;
+			cull_count_ = 0;
+		}
 
 
 		//-----------------------------------------------------------------//
@@ -372,66 +610,103 @@ namespace graphics {
 			int oy;
 			int w;
 			int h;
-			matrix_.get_viewport(ox, oy, w, h);  // drw2d for fixed point
-			ox <<= 4;
-			oy <<= 4;
-			w <<= 4;
-			h <<= 4;
+			matrix_.get_viewport(ox, oy, w, h);
+			back_.begin(ox, oy, w, h, flags_);
+
+			bool tex = (flags_ & ctrl_bit(CTRL::TEXTURE_2D)) != 0;
+			uint32_t tex_hnd = TNUM;
+			back_.set_texture(nullptr, vtx::spos(0), FORMAT::RGBA8);
 
-			rdr_.set_back_color(def_color::Black);
+			// Begin/End で登録された頂点をまとめて変換する
+			MATRIX::vertex_world(wm, pos_, pos_, vtx_idx_);
+			xform_count_ += vtx_idx_;
 
 			for(uint32_t i = 0; i < dt_idx_; ++i) {
 				const auto& t = dts_[i];
-				rdr_.set_fore_color(t.col_);
 
-
-				rdr_.set_texture(tex_[0].image_, tex_[0].size_, d2_mode_rgba8888);
-
-
-				uint32_t k = 0;
-				vtx::spos tmp[16];
-				for(uint32_t j = t.org_; j < t.end_; ++j) {
-					vtx::fvtx dst;
-					matrix_.vertex_screen(wm, vtxs_[j].p_, dst);
-					tmp[k].x = static_cast<int16_t>(dst.x * w) + (w / 2) + ox;
-					tmp[k].y = static_cast<int16_t>(dst.y * h) + (h / 2) + oy;
-					++k;
-					{
-						vtx::fvtx4 dst;
-						const auto& st = vtxs_[j].t_;
-						matrix_.vertex_world(wm, vtx::fvtx(st.x, st.y, 0.0f), dst);
+				uint32_t hnd = TNUM;
+				if(tex && t.tex_ < TNUM && tex_[t.tex_].image_ != nullptr) hnd = t.tex_;
+				if(hnd != tex_hnd) {
+					tex_hnd = hnd;
+					if(hnd < TNUM) {
+						const auto& tx = tex_[hnd];
+						back_.set_texture(tx.image_, tx.size_, tx.format_);
+					} else {
+						back_.set_texture(nullptr, vtx::spos(0), FORMAT::RGBA8);
 					}
 				}
+
+				if(t.va_ != nullptr) {  // 頂点配列毎にキャッシュを無効にする
+					for(uint32_t k = 0; k < CACHE_NUM; ++k) tag_[k] = 0xffffffff;
+				}
+
+				uint32_t n = t.end_ - t.org_;
+				cvtx_t v[4];
 				switch(t.pt_) {
 				case PTYPE::POINTS:
-
+					for(uint32_t j = 0; j < n; ++j) {
+						fetch_(wm, t, j, v[0]);
+						back_.point(v[0]);
+					}
 					break;
 				case PTYPE::LINES:
-					for(uint32_t j = 0; j < k; j += 2) {
-						rdr_.line_d(tmp[j], tmp[j+1]);
+					for(uint32_t j = 0; (j + 1) < n; j += 2) {
+						fetch_(wm, t, j + 0, v[0]);
+						fetch_(wm, t, j + 1, v[1]);
+						back_.line(v[0], v[1]);
 					}
 					break;
 				case PTYPE::LINE_STRIP:
-					for(uint32_t j = 0; j < (k - 1); ++j) {
-						rdr_.line_d(tmp[j], tmp[j+1]);
-					}
-					break;
 				case PTYPE::LINE_LOOP:
-					// if(!test_cw_(tmp, k)) break;  // ccw を描画しない
-					for(uint32_t j = 0; j < k; ++j) {
-						auto n = j + 1;
-						if(n >= k) n = 0;
-						rdr_.line_d(tmp[j], tmp[n]);
+					if(n < 2) break;
+					fetch_(wm, t, 0, v[0]);
+					v[2] = v[0];
+					for(uint32_t j = 1; j < n; ++j) {
+						fetch_(wm, t, j, v[1]);
+						back_.line(v[0], v[1]);
+						v[0] = v[1];
+					}
+					if(t.pt_ == PTYPE::LINE_LOOP) {
+						back_.line(v[0], v[2]);
 					}
 					break;
 				case PTYPE::QUAD:
-					for(uint32_t j = 0; j < k; j += 4) {
-						rdr_.quad_d(tmp[j+0], tmp[j+1], tmp[j+2], tmp[j+3], true);
+					for(uint32_t j = 0; (j + 3) < n; j += 4) {
+						fetch_(wm, t, j + 0, v[0]);
+						fetch_(wm, t, j + 1, v[1]);
+						fetch_(wm, t, j + 2, v[2]);
+						fetch_(wm, t, j + 3, v[3]);
+						back_.quad(v[0], v[1], v[2], v[3]);
 					}
 					break;
 				case PTYPE::TRIANGLE:
-					for(uint32_t j = 0; j < k; j += 3) {
-						rdr_.triangle_d(tmp[j+0], tmp[j+1], tmp[j+2], true);
+					for(uint32_t j = 0; (j + 2) < n; j += 3) {
+						fetch_(wm, t, j + 0, v[0]);
+						fetch_(wm, t, j + 1, v[1]);
+						fetch_(wm, t, j + 2, v[2]);
+						back_.triangle(v[0], v[1], v[2]);
+					}
+					break;
+				case PTYPE::TRIANGLE_STRIP:
+					if(n < 3) break;
+					fetch_(wm, t, 0, v[0]);
+					fetch_(wm, t, 1, v[1]);
+					for(uint32_t j = 2; j < n; ++j) {
+						fetch_(wm, t, j, v[2]);
+						if(j & 1) back_.triangle(v[1], v[0], v[2]);  // 奇数番目は向きを揃える
+						else back_.triangle(v[0], v[1], v[2]);
+						v[0] = v[1];
+						v[1] = v[2];
+					}
+					break;
+				case PTYPE::TRIANGLE_FAN:
+					if(n < 3) break;
+					fetch_(wm, t, 0, v[0]);
+					fetch_(wm, t, 1, v[1]);
+					for(uint32_t j = 2; j < n; ++j) {
+						fetch_(wm, t, j, v[2]);
+						back_.triangle(v[0], v[1], v[2]);
+						v[1] = v[2];
 					}
 					break;
 				default:
@@ -34,6 +34,8 @@ namespace graphics {
 			LINE_LOOP,		///< 閉じた線の描画
 			QUAD,			///< ４角形の描画
 			TRIANGLE,		///< ３角形の描画
+			TRIANGLE_STRIP,	///< 連続３角形の描画
+			TRIANGLE_FAN,	///< 扇状３角形の描画
 		};
 
 
@@ -44,9 +46,24 @@ namespace graphics {
 		//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
 		enum class CTRL : uint8_t {
 			NONE,
+			DEPTH_TEST,		///< デプス・テスト（Z バッファ）
+			CULL_FACE,		///< 裏面の除去
+			TEXTURE_2D,		///< テクスチャー・マッピング
 		};
 
 
+		//-------------------------------------------------------------//
+		/*!
+			@brief	制御型からフラグ・ビットを得る
+			@param[in]	ctrl	制御型
+			@return フラグ・ビット
+		*/
+		//-------------------------------------------------------------//
+		static constexpr uint32_t ctrl_bit(CTRL ctrl) noexcept {
+			return 1 << static_cast<uint32_t>(ctrl);
+		}
+
+
 		//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
 		/*!
 			@brief	TinyGL ターゲット型（テクスチャー）
@@ -70,5 +87,23 @@ namespace graphics {
 		};
 
 		typedef gl::matrixf MATRIX;
+
+
+		//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+		/*!
+			@brief	クリップ座標系の頂点（バックエンドへ渡す）
+		*/
+		//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+		struct cvtx_t {
+			float	x;		///< クリップ座標 X
+			float	y;		///< クリップ座標 Y
+			float	z;		///< クリップ座標 Z
+			float	w;		///< クリップ座標 W
+			float	r;		///< 赤 (0 to 255)
+			float	g;		///< 緑 (0 to 255)
+			float	b;		///< 青 (0 to 255)
+			float	s;		///< テクスチャー座標 S
+			float	t;		///< テクスチャー座標 T
+		};
 	};
 }
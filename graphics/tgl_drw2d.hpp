@@ -0,0 +1,198 @@
+#pragma once
+//=====================================================================//
+/*!	@file
+	@brief	Tiny OpenGL 描画バックエンド（DRW2D） @n
+			・頂点を 12.4 固定小数点のスクリーン座標に変換して DRW2D へ渡す。@n
+			・スクリーンの Y は、従来の tgl と同じく正規化座標の Y と同じ向き（下向き）@n
+			・クリッピング、デプス・テスト、頂点カラーの補間は行わない。@n
+			RDR には device::drw2d_mgr を使う（「RX600/drw2d_mgr.hpp」を先にインクルード）
+    @author 平松邦仁 (hira@rvf-rc45.net)
+	@copyright	Copyright (C) 2021 Kunihito Hiramatsu @n
+				Released under the MIT license @n
+				https://github.com/hirakuni45/RX/blob/master/LICENSE
+*/
+//=====================================================================//
+#include "graphics/tgl_base.hpp"
+
+namespace graphics {
+
+	//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+	/*!
+		@brief	Tiny OpenGL 描画バックエンド（DRW2D）
+		@param[in]	RDR		レンダークラス（DRW2D インスタンス）
+	*/
+	//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+	template <class RDR>
+	class tgl_drw2d : public tgl_base {
+
+		RDR&		rdr_;
+
+		float		vp_x_;
+		float		vp_y_;
+		float		vp_w_;
+		float		vp_h_;
+
+		bool		tex_;
+
+		// 12.4 固定小数点のスクリーン座標へ変換（W が正で無い頂点は描けない）
+		bool project_(const cvtx_t& v, vtx::spos& p) const noexcept
+		{
+			if(v.w <= 1e-6f) return false;
+			float iw = 1.0f / v.w;
+			p.x = static_cast<int16_t>((vp_x_ + (v.x * iw + 1.0f) * vp_w_) * 16.0f);
+			p.y = static_cast<int16_t>((vp_y_ + (v.y * iw + 1.0f) * vp_h_) * 16.0f);
+			return true;
+		}
+
+
+		void color_(const cvtx_t& v) noexcept
+		{
+			rdr_.set_fore_color(share_color(static_cast<uint8_t>(v.r),
+				static_cast<uint8_t>(v.g), static_cast<uint8_t>(v.b)));
+		}
+
+	public:
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	コンストラクター
+			@param[in]	rdr		レンダークラス（DRW2D インスタンス）
+		*/
+		//-----------------------------------------------------------------//
+		tgl_drw2d(RDR& rdr) noexcept : rdr_(rdr),
+			vp_x_(0.0f), vp_y_(0.0f), vp_w_(0.0f), vp_h_(0.0f),
+			tex_(false)
+		{ }
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	描画線サイズ指定
+			@param[in]	w	線幅
+		*/
+		//-----------------------------------------------------------------//
+		void line_width(float w) noexcept
+		{
+			rdr_.set_pen_size(static_cast<int16_t>(w * 16.0f));
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	描画開始
+			@param[in]	ox		ビューポート X
+			@param[in]	oy		ビューポート Y
+			@param[in]	w		ビューポート幅
+			@param[in]	h		ビューポート高さ
+			@param[in]	flags	制御フラグ
+		*/
+		//-----------------------------------------------------------------//
+		void begin(int ox, int oy, int w, int h, uint32_t flags) noexcept
+		{
+			vp_x_ = static_cast<float>(ox);
+			vp_y_ = static_cast<float>(oy);
+			vp_w_ = static_cast<float>(w) * 0.5f;
+			vp_h_ = static_cast<float>(h) * 0.5f;
+			rdr_.set_back_color(def_color::Black);
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	テクスチャーの設定
+			@param[in]	image	画像（nullptr ならテクスチャー無し）
+			@param[in]	size	画像サイズ
+			@param[in]	form	画像フォーマット
+		*/
+		//-----------------------------------------------------------------//
+		void set_texture(const void* image, const vtx::spos& size, FORMAT form) noexcept
+		{
+			tex_ = image != nullptr;
+			if(!tex_) return;
+
+			uint32_t mode = d2_mode_rgba8888;
+			switch(form) {
+			case FORMAT::RGB565:
+				mode = d2_mode_rgb565;
+				break;
+			case FORMAT::RGBA4:
+				mode = d2_mode_rgba4444;
+				break;
+			default:
+				break;
+			}
+			rdr_.set_texture(image, size, mode);
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	点の描画
+			@param[in]	a	頂点
+		*/
+		//-----------------------------------------------------------------//
+		void point(const cvtx_t& a) noexcept
+		{
+			vtx::spos p;
+			if(!project_(a, p)) return;
+			rdr_.plot(vtx::spos(p.x >> 4, p.y >> 4), share_color::to_565(static_cast<uint8_t>(a.r),
+				static_cast<uint8_t>(a.g), static_cast<uint8_t>(a.b)));
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	線の描画
+			@param[in]	a	頂点０
+			@param[in]	b	頂点１
+		*/
+		//-----------------------------------------------------------------//
+		void line(const cvtx_t& a, const cvtx_t& b) noexcept
+		{
+			vtx::spos p0;
+			vtx::spos p1;
+			if(!project_(a, p0) || !project_(b, p1)) return;
+			color_(a);
+			rdr_.line_d(p0, p1);
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	三角形の描画
+			@param[in]	a	頂点０
+			@param[in]	b	頂点１
+			@param[in]	c	頂点２
+		*/
+		//-----------------------------------------------------------------//
+		void triangle(const cvtx_t& a, const cvtx_t& b, const cvtx_t& c) noexcept
+		{
+			vtx::spos p0;
+			vtx::spos p1;
+			vtx::spos p2;
+			if(!project_(a, p0) || !project_(b, p1) || !project_(c, p2)) return;
+			color_(a);
+			rdr_.triangle_d(p0, p1, p2, tex_);
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	四角形の描画
+			@param[in]	a	頂点０
+			@param[in]	b	頂点１
+			@param[in]	c	頂点２
+			@param[in]	d	頂点３
+		*/
+		//-----------------------------------------------------------------//
+		void quad(const cvtx_t& a, const cvtx_t& b, const cvtx_t& c, const cvtx_t& d) noexcept
+		{
+			vtx::spos p0;
+			vtx::spos p1;
+			vtx::spos p2;
+			vtx::spos p3;
+			if(!project_(a, p0) || !project_(b, p1) || !project_(c, p2) || !project_(d, p3)) return;
+			color_(a);
+			rdr_.quad_d(p0, p1, p2, p3, tex_);
+		}
+	};
+}
@@ -0,0 +1,673 @@
+#pragma once
+//=====================================================================//
+/*!	@file
+	@brief	Tiny OpenGL 描画バックエンド（ソフトウェア・ラスタライザー） @n
+			・同次座標系で６平面のクリッピング（Sutherland-Hodgman）@n
+			・28.4 固定小数点のエッジ関数（トップ・レフト規則）で三角形を塗る @n
+			・16 ビット Z バッファ（CTRL::DEPTH_TEST、テンプレート引数 DEPTH で有効）@n
+			・裏面の除去（CTRL::CULL_FACE、正規化座標（Y 上向き）で反時計回りが表）@n
+			・スクリーンの Y は、従来の tgl と同じく正規化座標の Y と同じ向き（下向き）@n
+			・頂点カラーのグーロー補間（アフィン）@n
+			・パースペクティブ補正されたテクスチャー（最近傍、リピート）@n
+			  RGBA8 (graphics::rgba8_t)、RGB565、RGBA4 に対応、アルファ 0 は描かない。@n
+			・線はクリップ後 RDR::line で描く（Z は参照しない）@n
+			RDR には graphics::render (RGB565) を使う。
+    @author 平松邦仁 (hira@rvf-rc45.net)
+	@copyright	Copyright (C) 2021 Kunihito Hiramatsu @n
+				Released under the MIT license @n
+				https://github.com/hirakuni45/RX/blob/master/LICENSE
+*/
+//=====================================================================//
+#include <cstring>
+#include <algorithm>
+#include "graphics/tgl_base.hpp"
+
+namespace graphics {
+
+	//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+	/*!
+		@brief	Tiny OpenGL 描画バックエンド（ソフトウェア）
+		@param[in]	RDR		レンダークラス（graphics::render）
+		@param[in]	DEPTH	Z バッファを持つ場合「true」@n
+							（Z バッファは、幅 x 高さ x 2 バイトの RAM を使う為、既定では持たない）
+	*/
+	//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+	template <class RDR, bool DEPTH = false>
+	class tgl_soft : public tgl_base {
+	public:
+		typedef typename RDR::glc_type GLC;
+
+		static const int32_t WIDTH  = GLC::width;
+		static const int32_t HEIGHT = GLC::height;
+
+	private:
+		static const uint32_t CLIP_MAX = 4 + 6;		///< クリップ後の最大頂点数
+
+		// スクリーン座標系の頂点
+		struct svtx_t {
+			int32_t	x;		// 28.4 固定小数点
+			int32_t	y;		// 28.4 固定小数点
+			float	fx;		// x と同じ値（ピクセル単位）
+			float	fy;
+			float	z;		// 0 to 65535
+			float	r;
+			float	g;
+			float	b;
+			float	iw;		// 1 / w
+			float	sw;		// s / w
+			float	tw;		// t / w
+		};
+
+		RDR&		rdr_;
+
+		uint16_t	zbuf_[DEPTH ? (WIDTH * HEIGHT) : 1];
+
+		float		vp_x_;
+		float		vp_y_;
+		float		vp_w_;
+		float		vp_h_;
+		int32_t		cx0_;	// 描画範囲（ビューポートとクリップ領域の積）
+		int32_t		cy0_;
+		int32_t		cx1_;
+		int32_t		cy1_;
+
+		uint32_t	flags_;
+
+		const void*	tex_image_;
+		FORMAT		tex_form_;
+		int32_t		tex_w_;
+		int32_t		tex_h_;
+		int32_t		tex_mask_w_;	// ２のべき乗なら「サイズ－１」
+		int32_t		tex_mask_h_;
+
+		cvtx_t		poly_[2][CLIP_MAX];
+
+		uint32_t	tri_count_;
+		uint32_t	cull_count_;
+		uint32_t	pixel_count_;
+
+		static uint32_t outcode_(const cvtx_t& v) noexcept
+		{
+			uint32_t code = 0;
+			if(v.x < -v.w) code |= 0x01;
+			if(v.x >  v.w) code |= 0x02;
+			if(v.y < -v.w) code |= 0x04;
+			if(v.y >  v.w) code |= 0x08;
+			if(v.z < -v.w) code |= 0x10;
+			if(v.z >  v.w) code |= 0x20;
+			return code;
+		}
+
+
+		// 平面までの距離（内側が正）
+		static float dist_(const cvtx_t& v, uint32_t plane) noexcept
+		{
+			switch(plane) {
+			case 0:  return v.w + v.x;
+			case 1:  return v.w - v.x;
+			case 2:  return v.w + v.y;
+			case 3:  return v.w - v.y;
+			case 4:  return v.w + v.z;
+			default: return v.w - v.z;
+			}
+		}
+
+
+		static void lerp_(const cvtx_t& a, const cvtx_t& b, float t, cvtx_t& out) noexcept
+		{
+			out.x = a.x + (b.x - a.x) * t;
+			out.y = a.y + (b.y - a.y) * t;
+			out.z = a.z + (b.z - a.z) * t;
+			out.w = a.w + (b.w - a.w) * t;
+			out.r = a.r + (b.r - a.r) * t;
+			out.g = a.g + (b.g - a.g) * t;
+			out.b = a.b + (b.b - a.b) * t;
+			out.s = a.s + (b.s - a.s) * t;
+			out.t = a.t + (b.t - a.t) * t;
+		}
+
+
+		// 多角形を、code に含まれる平面でクリップする（結果は poly_[0]）
+		uint32_t clip_polygon_(uint32_t n, uint32_t code) noexcept
+		{
+			uint32_t src = 0;
+			for(uint32_t plane = 0; plane < 6; ++plane) {
+				if((code & (1 << plane)) == 0) continue;
+
+				const auto* in = poly_[src];
+				auto* out = poly_[src ^ 1];
+				uint32_t m = 0;
+				for(uint32_t i = 0; i < n; ++i) {
+					const auto& a = in[i];
+					const auto& b = in[(i + 1) < n ? (i + 1) : 0];
+					auto da = dist_(a, plane);
+					auto db = dist_(b, plane);
+					if(da >= 0.0f) {
+						out[m++] = a;
+					}
+					if((da >= 0.0f) != (db >= 0.0f)) {
+						lerp_(a, b, da / (da - db), out[m++]);
+					}
+				}
+				n = m;
+				src ^= 1;
+				if(n < 3) return 0;
+			}
+			if(src != 0) {
+				for(uint32_t i = 0; i < n; ++i) poly_[0][i] = poly_[1][i];
+			}
+			return n;
+		}
+
+
+		void project_(const cvtx_t& v, svtx_t& s) const noexcept
+		{
+			float iw = 1.0f / v.w;
+			float fx = vp_x_ + (v.x * iw + 1.0f) * vp_w_;
+			float fy = vp_y_ + (v.y * iw + 1.0f) * vp_h_;
+			s.x = static_cast<int32_t>(fx * 16.0f + 0.5f);
+			s.y = static_cast<int32_t>(fy * 16.0f + 0.5f);
+			s.fx = static_cast<float>(s.x) * (1.0f / 16.0f);
+			s.fy = static_cast<float>(s.y) * (1.0f / 16.0f);
+			float z = v.z * iw * 0.5f + 0.5f;
+			if(z < 0.0f) z = 0.0f;
+			else if(z > 1.0f) z = 1.0f;
+			s.z = z * 65535.0f;
+			s.r = v.r;
+			s.g = v.g;
+			s.b = v.b;
+			s.iw = iw;
+			s.sw = v.s * iw;
+			s.tw = v.t * iw;
+		}
+
+
+		void texel_(float u, float v, int32_t& r, int32_t& g, int32_t& b, int32_t& a) const noexcept
+		{
+			// 負の座標でもリピートするように、切り捨ててから正の剰余を取る
+			float fu = u * static_cast<float>(tex_w_);
+			float fv = v * static_cast<float>(tex_h_);
+			int32_t x = static_cast<int32_t>(fu);
+			int32_t y = static_cast<int32_t>(fv);
+			if(fu < static_cast<float>(x)) --x;
+			if(fv < static_cast<float>(y)) --y;
+			if(tex_mask_w_ != 0) {
+				x &= tex_mask_w_;
+			} else {
+				x %= tex_w_;
+				if(x < 0) x += tex_w_;
+			}
+			if(tex_mask_h_ != 0) {
+				y &= tex_mask_h_;
+			} else {
+				y %= tex_h_;
+				if(y < 0) y += tex_h_;
+			}
+			auto idx = y * tex_w_ + x;
+			switch(tex_form_) {
+			case FORMAT::RGB565:
+				{
+					auto c = static_cast<const uint16_t*>(tex_image_)[idx];
+					r = (c >> 8) & 0xf8;
+					g = (c >> 3) & 0xfc;
+					b = (c << 3) & 0xf8;
+					a = 255;
+				}
+				break;
+			case FORMAT::RGBA4:
+				{
+					auto c = static_cast<const uint16_t*>(tex_image_)[idx];
+					r = (c >> 8) & 0xf0;
+					g = (c >> 4) & 0xf0;
+					b = c & 0xf0;
+					a = (c << 4) & 0xf0;
+				}
+				break;
+			default:
+				{
+					const auto& c = static_cast<const rgba8_t*>(tex_image_)[idx];
+					r = c.r;
+					g = c.g;
+					b = c.b;
+					a = c.a;
+				}
+				break;
+			}
+		}
+
+
+		static int32_t clamp8_(int32_t v) noexcept
+		{
+			return v < 0 ? 0 : (v > 255 ? 255 : v);
+		}
+
+
+		static uint16_t to_565_(int32_t r, int32_t g, int32_t b) noexcept
+		{
+			return ((r & 0xf8) << 8) | ((g & 0xfc) << 3) | (b >> 3);
+		}
+
+
+		void raster_(const svtx_t* v0, const svtx_t* v1, const svtx_t* v2) noexcept
+		{
+			// スクリーン座標は正規化座標と同じ向きなので、表（反時計回り）の面積が正になる
+			int32_t area = (v1->x - v0->x) * (v2->y - v0->y) - (v2->x - v0->x) * (v1->y - v0->y);
+			if(area == 0) return;
+			if(area < 0) {
+				if((flags_ & ctrl_bit(CTRL::CULL_FACE)) != 0) {
+					++cull_count_;
+					return;
+				}
+				std::swap(v1, v2);
+				area = -area;
+			}
+
+			// バウンディング・ボックス（ピクセル中心が含まれる範囲）
+			auto minx = std::min(v0->x, std::min(v1->x, v2->x));
+			auto maxx = std::max(v0->x, std::max(v1->x, v2->x));
+			auto miny = std::min(v0->y, std::min(v1->y, v2->y));
+			auto maxy = std::max(v0->y, std::max(v1->y, v2->y));
+			int32_t x0 = std::max((minx + 7) >> 4, cx0_);
+			int32_t x1 = std::min((maxx - 8) >> 4, cx1_ - 1);
+			int32_t y0 = std::max((miny + 7) >> 4, cy0_);
+			int32_t y1 = std::min((maxy - 8) >> 4, cy1_ - 1);
+			if(x0 > x1 || y0 > y1) return;
+
+			++tri_count_;
+
+			// エッジ関数 E(p) = A * (p.x - a.x) + B * (p.y - a.y)
+			const svtx_t* vs[3] = { v0, v1, v2 };
+			int32_t ea[3];
+			int32_t eb[3];
+			int32_t er[3];
+			int32_t px = (x0 << 4) + 8;
+			int32_t py = (y0 << 4) + 8;
+			for(uint32_t i = 0; i < 3; ++i) {
+				const auto* a = vs[i];
+				const auto* b = vs[(i + 1) % 3];
+				ea[i] = a->y - b->y;
+				eb[i] = b->x - a->x;
+				// トップ・レフト規則：それ以外のエッジ上のピクセルは含めない
+				bool tl = (ea[i] == 0 && eb[i] > 0) || ea[i] > 0;
+				er[i] = ea[i] * (px - a->x) + eb[i] * (py - a->y) + (tl ? 0 : -1);
+				ea[i] *= 16;
+				eb[i] *= 16;
+			}
+
+			// 属性の平面方程式（ピクセル単位）
+			float dx1 = v1->fx - v0->fx;
+			float dy1 = v1->fy - v0->fy;
+			float dx2 = v2->fx - v0->fx;
+			float dy2 = v2->fy - v0->fy;
+			float ia = 256.0f / static_cast<float>(area);
+			float ox = static_cast<float>(x0) + 0.5f - v0->fx;
+			float oy = static_cast<float>(y0) + 0.5f - v0->fy;
+			auto gx = [&](float q0, float q1, float q2) { return ((q1 - q0) * dy2 - (q2 - q0) * dy1) * ia; };
+			auto gy = [&](float q0, float q1, float q2) { return ((q2 - q0) * dx1 - (q1 - q0) * dx2) * ia; };
+
+			bool depth = DEPTH && (flags_ & ctrl_bit(CTRL::DEPTH_TEST)) != 0;
+			float zdx = gx(v0->z, v1->z, v2->z);
+			float zdy = gy(v0->z, v1->z, v2->z);
+			int32_t z_row = static_cast<int32_t>((v0->z + zdx * ox + zdy * oy) * 256.0f);
+			int32_t z_dx = static_cast<int32_t>(zdx * 256.0f);
+			int32_t z_dy = static_cast<int32_t>(zdy * 256.0f);
+
+			bool flat = v0->r == v1->r && v0->r == v2->r && v0->g == v1->g && v0->g == v2->g
+				&& v0->b == v1->b && v0->b == v2->b;
+			float cdx[3];
+			float cdy[3];
+			int32_t c_row[3];
+			int32_t c_dx[3];
+			int32_t c_dy[3];
+			for(uint32_t i = 0; i < 3; ++i) {
+				float q0 = i == 0 ? v0->r : (i == 1 ? v0->g : v0->b);
+				float q1 = i == 0 ? v1->r : (i == 1 ? v1->g : v1->b);
+				float q2 = i == 0 ? v2->r : (i == 1 ? v2->g : v2->b);
+				cdx[i] = flat ? 0.0f : gx(q0, q1, q2);
+				cdy[i] = flat ? 0.0f : gy(q0, q1, q2);
+				c_row[i] = static_cast<int32_t>((q0 + cdx[i] * ox + cdy[i] * oy) * 65536.0f);
+				c_dx[i] = static_cast<int32_t>(cdx[i] * 65536.0f);
+				c_dy[i] = static_cast<int32_t>(cdy[i] * 65536.0f);
+			}
+			uint16_t flat_c = to_565_(static_cast<int32_t>(v0->r), static_cast<int32_t>(v0->g),
+				static_cast<int32_t>(v0->b));
+
+			bool tex = tex_image_ != nullptr;
+			float wdx = 0.0f, wdy = 0.0f, sdx = 0.0f, sdy = 0.0f, tdx = 0.0f, tdy = 0.0f;
+			float w_row = 0.0f, s_row = 0.0f, t_row = 0.0f;
+			if(tex) {
+				wdx = gx(v0->iw, v1->iw, v2->iw);
+				wdy = gy(v0->iw, v1->iw, v2->iw);
+				sdx = gx(v0->sw, v1->sw, v2->sw);
+				sdy = gy(v0->sw, v1->sw, v2->sw);
+				tdx = gx(v0->tw, v1->tw, v2->tw);
+				tdy = gy(v0->tw, v1->tw, v2->tw);
+				w_row = v0->iw + wdx * ox + wdy * oy;
+				s_row = v0->sw + sdx * ox + sdy * oy;
+				t_row = v0->tw + tdx * ox + tdy * oy;
+			}
+
+			auto* fb = rdr_.at_fb() + y0 * GLC::line_width;
+			auto* zb = &zbuf_[DEPTH ? (y0 * WIDTH) : 0];
+			for(int32_t y = y0; y <= y1; ++y) {
+				int32_t e0 = er[0];
+				int32_t e1 = er[1];
+				int32_t e2 = er[2];
+				int32_t z = z_row;
+				int32_t cr = c_row[0];
+				int32_t cg = c_row[1];
+				int32_t cb = c_row[2];
+				float iw = w_row;
+				float sw = s_row;
+				float tw = t_row;
+				for(int32_t x = x0; x <= x1; ++x) {
+					if((e0 | e1 | e2) >= 0) {
+						auto zv = z >> 8;
+						uint16_t zz = zv < 0 ? 0 : (zv > 0xffff ? 0xffff : zv);
+						if(!depth || zz < zb[x]) {
+							uint16_t c;
+							bool draw = true;
+							if(tex) {
+								float w = 1.0f / iw;
+								int32_t r, g, b, a;
+								texel_(sw * w, tw * w, r, g, b, a);
+								if(a == 0) {
+									draw = false;
+								}
+								r = (r * (clamp8_(cr >> 16) + 1)) >> 8;
+								g = (g * (clamp8_(cg >> 16) + 1)) >> 8;
+								b = (b * (clamp8_(cb >> 16) + 1)) >> 8;
+								c = to_565_(r, g, b);
+							} else if(flat) {
+								c = flat_c;
+							} else {
+								c = to_565_(clamp8_(cr >> 16), clamp8_(cg >> 16), clamp8_(cb >> 16));
+							}
+							if(draw) {
+								if(depth) zb[x] = zz;
+								fb[x] = c;
+								++pixel_count_;
+							}
+						}
+					}
+					e0 += ea[0];
+					e1 += ea[1];
+					e2 += ea[2];
+					z += z_dx;
+					cr += c_dx[0];
+					cg += c_dx[1];
+					cb += c_dx[2];
+					if(tex) {
+						iw += wdx;
+						sw += sdx;
+						tw += tdx;
+					}
+				}
+				er[0] += eb[0];
+				er[1] += eb[1];
+				er[2] += eb[2];
+				z_row += z_dy;
+				c_row[0] += c_dy[0];
+				c_row[1] += c_dy[1];
+				c_row[2] += c_dy[2];
+				if(tex) {
+					w_row += wdy;
+					s_row += sdy;
+					t_row += tdy;
+				}
+				fb += GLC::line_width;
+				if(DEPTH) zb += WIDTH;
+			}
+		}
+
+
+		// poly_[0] の多角形をクリップして、三角形ファンで描く
+		void polygon_(uint32_t n) noexcept
+		{
+			uint32_t and_code = 0x3f;
+			uint32_t or_code = 0;
+			for(uint32_t i = 0; i < n; ++i) {
+				auto code = outcode_(poly_[0][i]);
+				and_code &= code;
+				or_code |= code;
+			}
+			if(and_code != 0) return;
+			if(or_code != 0) {
+				n = clip_polygon_(n, or_code);
+				if(n < 3) return;
+			}
+
+			svtx_t sv[CLIP_MAX];
+			for(uint32_t i = 0; i < n; ++i) {
+				if(poly_[0][i].w <= 1e-6f) return;
+				project_(poly_[0][i], sv[i]);
+			}
+			for(uint32_t i = 1; (i + 1) < n; ++i) {
+				raster_(&sv[0], &sv[i], &sv[i + 1]);
+			}
+		}
+
+	public:
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	コンストラクター
+			@param[in]	rdr		レンダークラス
+		*/
+		//-----------------------------------------------------------------//
+		tgl_soft(RDR& rdr) noexcept : rdr_(rdr), zbuf_{ },
+			vp_x_(0.0f), vp_y_(0.0f), vp_w_(0.0f), vp_h_(0.0f),
+			cx0_(0), cy0_(0), cx1_(0), cy1_(0),
+			flags_(0),
+			tex_image_(nullptr), tex_form_(FORMAT::RGBA8), tex_w_(0), tex_h_(0),
+			tex_mask_w_(0), tex_mask_h_(0),
+			poly_{ },
+			tri_count_(0), cull_count_(0), pixel_count_(0)
+		{ }
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	描画線サイズ指定（ソフトウェア描画では１ピクセル固定）
+			@param[in]	w	線幅
+		*/
+		//-----------------------------------------------------------------//
+		void line_width(float w) noexcept { }
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	描画開始 @n
+					DEPTH_TEST が有効なら Z バッファを初期化する
+			@param[in]	ox		ビューポート X
+			@param[in]	oy		ビューポート Y
+			@param[in]	w		ビューポート幅
+			@param[in]	h		ビューポート高さ
+			@param[in]	flags	制御フラグ
+		*/
+		//-----------------------------------------------------------------//
+		void begin(int ox, int oy, int w, int h, uint32_t flags) noexcept
+		{
+			vp_x_ = static_cast<float>(ox);
+			vp_y_ = static_cast<float>(oy);
+			vp_w_ = static_cast<float>(w) * 0.5f;
+			vp_h_ = static_cast<float>(h) * 0.5f;
+
+			const auto& clip = rdr_.get_clip();
+			cx0_ = std::max(std::max(ox, 0), static_cast<int>(clip.org.x));
+			cy0_ = std::max(std::max(oy, 0), static_cast<int>(clip.org.y));
+			cx1_ = std::min(std::min(ox + w, static_cast<int>(WIDTH)), static_cast<int>(clip.end_x()));
+			cy1_ = std::min(std::min(oy + h, static_cast<int>(HEIGHT)), static_cast<int>(clip.end_y()));
+
+			flags_ = flags;
+			if(DEPTH && (flags_ & ctrl_bit(CTRL::DEPTH_TEST)) != 0) {
+				clear_depth();
+			}
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	Z バッファの初期化（最遠）
+		*/
+		//-----------------------------------------------------------------//
+		void clear_depth() noexcept
+		{
+			std::memset(zbuf_, 0xff, sizeof(zbuf_));
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	テクスチャーの設定
+			@param[in]	image	画像（nullptr ならテクスチャー無し）
+			@param[in]	size	画像サイズ
+			@param[in]	form	画像フォーマット
+		*/
+		//-----------------------------------------------------------------//
+		void set_texture(const void* image, const vtx::spos& size, FORMAT form) noexcept
+		{
+			if(size.x <= 0 || size.y <= 0) image = nullptr;
+			tex_image_ = image;
+			tex_form_ = form;
+			tex_w_ = size.x;
+			tex_h_ = size.y;
+			tex_mask_w_ = (tex_w_ & (tex_w_ - 1)) == 0 ? (tex_w_ - 1) : 0;
+			tex_mask_h_ = (tex_h_ & (tex_h_ - 1)) == 0 ? (tex_h_ - 1) : 0;
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	点の描画
+			@param[in]	a	頂点
+		*/
+		//-----------------------------------------------------------------//
+		void point(const cvtx_t& a) noexcept
+		{
+			if(outcode_(a) != 0 || a.w <= 1e-6f) return;
+			svtx_t s;
+			project_(a, s);
+			vtx::spos p(s.x >> 4, s.y >> 4);
+			if(p.x < cx0_ || p.x >= cx1_ || p.y < cy0_ || p.y >= cy1_) return;
+			rdr_.fast_plot(p, to_565_(static_cast<int32_t>(a.r), static_cast<int32_t>(a.g),
+				static_cast<int32_t>(a.b)));
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	線の描画（同次座標系でクリップする）
+			@param[in]	a	頂点０
+			@param[in]	b	頂点１
+		*/
+		//-----------------------------------------------------------------//
+		void line(const cvtx_t& a, const cvtx_t& b) noexcept
+		{
+			auto ca = outcode_(a);
+			auto cb = outcode_(b);
+			if((ca & cb) != 0) return;
+
+			float t0 = 0.0f;
+			float t1 = 1.0f;
+			if((ca | cb) != 0) {
+				for(uint32_t plane = 0; plane < 6; ++plane) {
+					auto da = dist_(a, plane);
+					auto db = dist_(b, plane);
+					if(da < 0.0f && db < 0.0f) return;
+					if(da < 0.0f) t0 = std::max(t0, da / (da - db));
+					else if(db < 0.0f) t1 = std::min(t1, da / (da - db));
+				}
+				if(t0 > t1) return;
+			}
+			cvtx_t p0;
+			cvtx_t p1;
+			lerp_(a, b, t0, p0);
+			lerp_(a, b, t1, p1);
+			if(p0.w <= 1e-6f || p1.w <= 1e-6f) return;
+
+			svtx_t s0;
+			svtx_t s1;
+			project_(p0, s0);
+			project_(p1, s1);
+			rdr_.set_fore_color(share_color(static_cast<uint8_t>(a.r),
+				static_cast<uint8_t>(a.g), static_cast<uint8_t>(a.b)));
+			rdr_.line(vtx::spos(s0.x >> 4, s0.y >> 4), vtx::spos(s1.x >> 4, s1.y >> 4));
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	三角形の描画
+			@param[in]	a	頂点０
+			@param[in]	b	頂点１
+			@param[in]	c	頂点２
+		*/
+		//-----------------------------------------------------------------//
+		void triangle(const cvtx_t& a, const cvtx_t& b, const cvtx_t& c) noexcept
+		{
+			poly_[0][0] = a;
+			poly_[0][1] = b;
+			poly_[0][2] = c;
+			polygon_(3);
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	四角形の描画
+			@param[in]	a	頂点０
+			@param[in]	b	頂点１
+			@param[in]	c	頂点２
+			@param[in]	d	頂点３
+		*/
+		//-----------------------------------------------------------------//
+		void quad(const cvtx_t& a, const cvtx_t& b, const cvtx_t& c, const cvtx_t& d) noexcept
+		{
+			poly_[0][0] = a;
+			poly_[0][1] = b;
+			poly_[0][2] = c;
+			poly_[0][3] = d;
+			polygon_(4);
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	描画した三角形数を取得
+			@return 三角形数
+		*/
+		//-----------------------------------------------------------------//
+		uint32_t get_triangle_count() const noexcept { return tri_count_; }
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	裏面として除去した三角形数を取得
+			@return 三角形数
+		*/
+		//-----------------------------------------------------------------//
+		uint32_t get_cull_count() const noexcept { return cull_count_; }
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	書き込んだピクセル数を取得
+			@return ピクセル数
+		*/
+		//-----------------------------------------------------------------//
+		uint32_t get_pixel_count() const noexcept { return pixel_count_; }
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	統計のリセット
+		*/
+		//-----------------------------------------------------------------//
+		void reset_count() noexcept
+		{
+			tri_count_ = 0;
+			cull_count_ = 0;
+			pixel_count_ = 0;
+		}
+	};
+}
@@ -0,0 +1,786 @@
+#pragma once
+//=====================================================================//
+/*!	@file
+	@brief	Unicode フォント・コンテナ・クラス @n
+			・UTF-16（BMP）コードで直接引ける２段ページ・テーブル @n
+			  （上位８ビットでページ、ページ内はビットマップとランクで索引）@n
+			・グリフ毎の送り幅、ベアリング（プロポーショナル）@n
+			・ビットマップは 1bpp/2bpp、生データ又は RLE（グリフ毎に小さい方）@n
+			・複数サイズ（フェイス）を一つのファイルに格納 @n
+			・ROM（フラッシュ）上に置く場合はゼロコピー、SD カードの場合は @n
+			  ブロック・キャッシュ経由でアクセス @n
+			ファイルは、ホスト・ツール「ufontconv」で BDF/TTF から作成する。
+    @author 平松邦仁 (hira@rvf-rc45.net)
+	@copyright	Copyright (C) 2021 Kunihito Hiramatsu @n
+				Released under the MIT license @n
+				https://github.com/hirakuni45/RX/blob/master/LICENSE
+*/
+//=====================================================================//
+#include <cstdint>
+#include <cstring>
+#include "common/vtx.hpp"
+#ifdef FAT_FS
+#include "ff14/source/ff.h"
+#endif
+
+namespace graphics {
+
+	//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+	/*!
+		@brief	Unicode フォント・ファイル定義 @n
+				全てリトル・エンディアン、テーブルは４バイト境界に置く。 @n
+				header_t, face_t[face_num], 各フェイスのテーブルとビットマップ
+	*/
+	//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+	struct ufont_def {
+
+		static const uint16_t VERSION = 1;
+		static const uint16_t NO_PAGE = 0xffff;	///< ページ無し
+
+		//=============================================================//
+		/*!
+			@brief	ビットマップの符号化
+		*/
+		//=============================================================//
+		enum class ENC : uint8_t {
+			RAW,	///< 画素を LSB から詰めた生データ（行を跨いで連続）
+			RLE,	///< 1bpp: bit7 画素、bit0-6 長さ-1 @n
+					///< 2bpp: bit6-7 階調、bit0-5 長さ-1（行を跨いで連続）
+		};
+
+		//=============================================================//
+		/*!
+			@brief	ファイル・ヘッダー（16 バイト）
+		*/
+		//=============================================================//
+		struct header_t {
+			char		magic[4];	///< "UFNT"
+			uint16_t	version;
+			uint16_t	face_num;
+			uint32_t	size;		///< ファイル全体の大きさ
+			uint32_t	glyph_max;	///< 最大のグリフ・ビットマップのバイト数（0 なら不明）
+		};
+
+		//=============================================================//
+		/*!
+			@brief	フェイス（サイズ）定義（32 バイト）
+		*/
+		//=============================================================//
+		struct face_t {
+			uint8_t		height;		///< 行の高さ
+			uint8_t		ascent;		///< ベースラインまでの高さ
+			uint8_t		bpp;		///< 1 又は 2
+			uint8_t		max_adv;	///< 最大送り幅
+			uint16_t	page_num;	///< ２段目のページ数
+			uint16_t	def_code;	///< グリフが無い場合に使うコード（0 なら無し）
+			uint32_t	glyph_num;
+			uint32_t	l1_ofs;		///< uint16_t[256]（ページ番号、NO_PAGE）
+			uint32_t	l2_ofs;		///< page_t[page_num]
+			uint32_t	glyph_ofs;	///< glyph_t[glyph_num]
+			uint32_t	bits_ofs;	///< ビットマップ領域
+			uint32_t	bits_size;
+		};
+
+		//=============================================================//
+		/*!
+			@brief	２段目のページ（36 バイト、256 コード分）@n
+					グリフ番号 = base + （bits の code 未満のビット数）
+		*/
+		//=============================================================//
+		struct page_t {
+			uint32_t	base;
+			uint32_t	bits[8];
+		};
+
+		//=============================================================//
+		/*!
+			@brief	グリフ定義（12 バイト）
+		*/
+		//=============================================================//
+		struct glyph_t {
+			uint32_t	ofs;	///< ビットマップ領域先頭からのオフセット
+			uint8_t		w;		///< ビットマップの幅
+			uint8_t		h;		///< ビットマップの高さ
+			int8_t		bx;		///< 描画位置からビットマップ左端まで
+			int8_t		by;		///< 行の上端からビットマップ上端まで
+			uint8_t		adv;	///< 送り幅
+			ENC			enc;
+			uint16_t	len;	///< ビットマップのバイト数
+		};
+
+
+		//-------------------------------------------------------------//
+		/*!
+			@brief	ページ内のグリフ番号を求める
+			@param[in]	pg		ページ
+			@param[in]	lo		コードの下位８ビット
+			@param[out]	idx		グリフ番号
+			@return グリフがあれば「true」
+		*/
+		//-------------------------------------------------------------//
+		static bool rank(const page_t& pg, uint8_t lo, uint32_t& idx) noexcept
+		{
+			uint32_t w = lo >> 5;
+			uint32_t m = 1UL << (lo & 31);
+			if((pg.bits[w] & m) == 0) return false;
+			uint32_t n = pg.base + __builtin_popcount(pg.bits[w] & (m - 1));
+			for(uint32_t i = 0; i < w; ++i) {
+				n += __builtin_popcount(pg.bits[i]);
+			}
+			idx = n;
+			return true;
+		}
+
+
+		//-------------------------------------------------------------//
+		/*!
+			@brief	ビットマップを水平ランに展開する
+			@param[in]	g		グリフ
+			@param[in]	bpp		1 又は 2
+			@param[in]	src		ビットマップ（g.len バイト）
+			@param[in]	fn		ファンクタ fn(x, y, len, level)、level は 1 以上
+			@return ラン数
+		*/
+		//-------------------------------------------------------------//
+		template <class FUNC>
+		static uint32_t decode(const glyph_t& g, uint8_t bpp, const uint8_t* src, FUNC fn) noexcept
+		{
+			if(g.w == 0 || g.h == 0 || src == nullptr) return 0;
+
+			uint32_t runs = 0;
+			int16_t x = 0;
+			int16_t y = 0;
+			// 行を跨ぐランを分割して出力
+			auto out = [&](uint8_t lvl, uint32_t n) {
+				while(n > 0 && y < g.h) {
+					int16_t l = g.w - x;
+					if(static_cast<uint32_t>(l) > n) l = n;
+					if(lvl != 0) {
+						fn(x, y, l, lvl);
+						++runs;
+					}
+					x += l;
+					n -= l;
+					if(x >= g.w) {
+						x = 0;
+						++y;
+					}
+				}
+			};
+
+			if(g.enc == ENC::RLE) {
+				const uint8_t* end = src + g.len;
+				if(bpp == 1) {
+					while(src < end) {
+						auto c = *src++;
+						out(c >> 7, (c & 0x7f) + 1);
+					}
+				} else {
+					while(src < end) {
+						auto c = *src++;
+						out(c >> 6, (c & 0x3f) + 1);
+					}
+				}
+			} else if(bpp == 1 && g.w <= 25) {
+				// 1bpp の生データは、行単位で取り出して、点のある区間だけ探す
+				uint32_t pos = 0;
+				uint32_t msk = (1UL << g.w) - 1;
+				for(y = 0; y < g.h; ++y) {
+					const uint8_t* p = src + (pos >> 3);
+					uint32_t nb = ((pos & 7) + g.w + 7) >> 3;
+					uint32_t v = 0;
+					for(uint32_t i = 0; i < nb; ++i) {
+						v |= static_cast<uint32_t>(p[i]) << (i * 8);
+					}
+					v = (v >> (pos & 7)) & msk;
+					x = 0;
+					while(v != 0) {
+						uint32_t s = __builtin_ctz(v);
+						v >>= s;
+						x += s;
+						uint32_t l = __builtin_ctz(~v);
+						fn(x, y, static_cast<int16_t>(l), 1);
+						++runs;
+						v >>= l;
+						x += l;
+					}
+					pos += g.w;
+				}
+			} else {
+				// 生データは、同じ画素の並びをランにまとめる
+				uint32_t num = static_cast<uint32_t>(g.w) * g.h;
+				uint8_t mask = (1 << bpp) - 1;
+				uint8_t cur = 0;
+				uint32_t n = 0;
+				uint32_t sh = 0;
+				uint8_t c = 0;
+				for(uint32_t i = 0; i < num; ++i) {
+					if(sh == 0) c = *src++;
+					uint8_t v = (c >> sh) & mask;
+					sh += bpp;
+					if(sh >= 8) sh = 0;
+					if(v != cur) {
+						if(n > 0) out(cur, n);
+						cur = v;
+						n = 0;
+					}
+					++n;
+				}
+				if(n > 0) out(cur, n);
+			}
+			return runs;
+		}
+	};
+
+
+	//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+	/*!
+		@brief	ROM 上の Unicode フォント・ソース @n
+				ポインターをそのまま返す（ゼロコピー）
+	*/
+	//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+	class ufont_rom {
+
+		const uint8_t*	org_;
+		uint32_t		size_;
+
+	public:
+		static const uint32_t READ_MAX = 0xffffffff;	///< 一度に読めるバイト数の最大
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	コンストラクター
+			@param[in]	org		フォント・データの先頭（４バイト境界）
+			@param[in]	size	フォント・データの大きさ
+		*/
+		//-----------------------------------------------------------------//
+		ufont_rom(const void* org, uint32_t size) noexcept :
+			org_(static_cast<const uint8_t*>(org)), size_(size) { }
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	データを読む
+			@param[in]	ofs		オフセット
+			@param[in]	len		バイト数
+			@return データのポインター（範囲外なら「nullptr」）
+		*/
+		//-----------------------------------------------------------------//
+		const uint8_t* read(uint32_t ofs, uint32_t len) noexcept
+		{
+			if(org_ == nullptr || ofs > size_ || len > (size_ - ofs)) return nullptr;
+			return org_ + ofs;
+		}
+	};
+
+
+#ifdef FAT_FS
+	//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+	/*!
+		@brief	ファイル上の Unicode フォント・ソース @n
+				ブロック単位の LRU キャッシュを持ち、ファイルは開いたままにする。 @n
+				read が返すポインターは、次の read まで有効。 @n
+				ブロックを跨ぐ読み出しは、ブロック毎にテンポラリへつなげるので、 @n
+				TSIZE 以下ならブロック・サイズより大きなグリフも読める。 @n
+				必要な TSIZE は、ufontconv が表示する（ヘッダーの glyph_max）。
+		@param[in]	BNUM	キャッシュ・ブロック数
+		@param[in]	BSIZE	ブロック・サイズ
+		@param[in]	TSIZE	テンポラリ・サイズ（一度に読めるバイト数の最大）
+	*/
+	//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+	template <uint32_t BNUM = 8, uint32_t BSIZE = 512, uint32_t TSIZE = BSIZE * 2>
+	class ufont_file {
+
+		static_assert(TSIZE >= BSIZE, "TSIZE must be BSIZE or larger");
+
+	public:
+		static const uint32_t READ_MAX = TSIZE;	///< 一度に読めるバイト数の最大
+
+		//=============================================================//
+		/*!
+			@brief	キャッシュ統計
+		*/
+		//=============================================================//
+		struct stat_t {
+			uint32_t	hit;
+			uint32_t	miss;
+			uint32_t	span;	///< ブロックを跨いだ読み出し
+			stat_t() noexcept : hit(0), miss(0), span(0) { }
+		};
+
+	private:
+		static const uint32_t NO_BLOCK = 0xffffffff;
+
+		FIL			fil_;
+		bool		open_;
+		uint32_t	size_;
+
+		uint32_t	blk_[BNUM];
+		uint32_t	age_[BNUM];
+		uint32_t	tick_;
+		uint8_t		buf_[BNUM][BSIZE] __attribute__((aligned(4)));
+		uint8_t		tmp_[TSIZE] __attribute__((aligned(4)));
+
+		stat_t		stat_;
+
+		const uint8_t* load_(uint32_t blk) noexcept
+		{
+			++tick_;
+			uint32_t old = 0;
+			for(uint32_t i = 0; i < BNUM; ++i) {
+				if(blk_[i] == blk) {
+					age_[i] = tick_;
+					++stat_.hit;
+					return buf_[i];
+				}
+				if(age_[i] < age_[old]) old = i;
+			}
+			++stat_.miss;
+			blk_[old] = NO_BLOCK;
+			if(f_lseek(&fil_, blk * BSIZE) != FR_OK) return nullptr;
+			UINT rs;
+			if(f_read(&fil_, buf_[old], BSIZE, &rs) != FR_OK) return nullptr;
+			blk_[old] = blk;
+			age_[old] = tick_;
+			return buf_[old];
+		}
+
+	public:
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	コンストラクター
+		*/
+		//-----------------------------------------------------------------//
+		ufont_file() noexcept : fil_(), open_(false), size_(0), blk_{ }, age_{ }, tick_(0),
+			stat_()
+		{
+			for(uint32_t i = 0; i < BNUM; ++i) blk_[i] = NO_BLOCK;
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	デストラクター
+		*/
+		//-----------------------------------------------------------------//
+		~ufont_file() { close(); }
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	フォント・ファイルを開く
+			@param[in]	path	ファイル・パス
+			@return 成功なら「true」
+		*/
+		//-----------------------------------------------------------------//
+		bool open(const char* path) noexcept
+		{
+			close();
+			if(f_open(&fil_, path, FA_READ) != FR_OK) return false;
+			size_ = f_size(&fil_);
+			open_ = true;
+			return true;
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	フォント・ファイルを閉じる @n
+					※カードを抜いた場合等にも呼ぶ
+		*/
+		//-----------------------------------------------------------------//
+		void close() noexcept
+		{
+			if(open_) {
+				f_close(&fil_);
+				open_ = false;
+			}
+			for(uint32_t i = 0; i < BNUM; ++i) {
+				blk_[i] = NO_BLOCK;
+				age_[i] = 0;
+			}
+			tick_ = 0;
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	データを読む
+			@param[in]	ofs		オフセット
+			@param[in]	len		バイト数（TSIZE 以下）
+			@return データのポインター（失敗なら「nullptr」）
+		*/
+		//-----------------------------------------------------------------//
+		const uint8_t* read(uint32_t ofs, uint32_t len) noexcept
+		{
+			if(!open_ || len > TSIZE || ofs > size_ || len > (size_ - ofs)) return nullptr;
+
+			uint32_t blk = ofs / BSIZE;
+			uint32_t pos = ofs % BSIZE;
+			auto p = load_(blk);
+			if(p == nullptr) return nullptr;
+			if((pos + len) <= BSIZE) return p + pos;
+
+			// ブロックを跨ぐ場合は、ブロック毎にテンポラリにつなげる
+			++stat_.span;
+			uint32_t l = BSIZE - pos;
+			std::memcpy(tmp_, p + pos, l);
+			uint32_t n = l;
+			while(n < len) {
+				p = load_(++blk);
+				if(p == nullptr) return nullptr;
+				l = len - n;
+				if(l > BSIZE) l = BSIZE;
+				std::memcpy(tmp_ + n, p, l);
+				n += l;
+			}
+			return tmp_;
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	キャッシュ統計を取得
+			@return キャッシュ統計
+		*/
+		//-----------------------------------------------------------------//
+		const stat_t& get_stat() const noexcept { return stat_; }
+	};
+#endif
+
+
+	//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+	/*!
+		@brief	Unicode フォント・クラス
+		@param[in]	SRC		ソース・クラス（ufont_rom、ufont_file）
+		@param[in]	FNUM	扱えるフェイス数の最大
+	*/
+	//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+	template <class SRC, uint32_t FNUM = 4>
+	class ufont {
+	public:
+		typedef ufont_def::face_t face_t;
+		typedef ufont_def::glyph_t glyph_t;
+
+		//=============================================================//
+		/*!
+			@brief	統計
+		*/
+		//=============================================================//
+		struct stat_t {
+			uint32_t	find;	///< 検索回数
+			uint32_t	miss;	///< グリフが無かった回数
+			uint32_t	glyph;	///< 展開したグリフ数
+			uint32_t	run;	///< 展開したラン数
+			stat_t() noexcept : find(0), miss(0), glyph(0), run(0) { }
+		};
+
+	private:
+		SRC&		src_;
+
+		face_t		face_[FNUM];
+		uint32_t	face_num_;
+		uint32_t	sel_;
+
+		uint16_t	code_;
+		int8_t		cnt_;
+
+		stat_t		stat_;
+
+		bool find_(uint16_t code, glyph_t& g) noexcept
+		{
+			const auto& f = face_[sel_];
+			auto p = src_.read(f.l1_ofs + (code >> 8) * sizeof(uint16_t), sizeof(uint16_t));
+			if(p == nullptr) return false;
+			uint16_t pg = p[0] | (static_cast<uint16_t>(p[1]) << 8);
+			if(pg == ufont_def::NO_PAGE || pg >= f.page_num) return false;
+			p = src_.read(f.l2_ofs + pg * sizeof(ufont_def::page_t), sizeof(ufont_def::page_t));
+			if(p == nullptr) return false;
+			ufont_def::page_t page;
+			std::memcpy(&page, p, sizeof(page));
+			uint32_t idx;
+			if(!ufont_def::rank(page, code & 0xff, idx) || idx >= f.glyph_num) return false;
+			p = src_.read(f.glyph_ofs + idx * sizeof(glyph_t), sizeof(glyph_t));
+			if(p == nullptr) return false;
+			std::memcpy(&g, p, sizeof(glyph_t));
+			return true;
+		}
+
+	public:
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	コンストラクター
+			@param[in]	src		ソース
+		*/
+		//-----------------------------------------------------------------//
+		ufont(SRC& src) noexcept : src_(src), face_{ }, face_num_(0), sel_(0),
+			code_(0), cnt_(0), stat_() { }
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	ソースの参照
+			@return ソース
+		*/
+		//-----------------------------------------------------------------//
+		SRC& at_src() noexcept { return src_; }
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	ヘッダーとフェイス定義を読み込む @n
+					最大のグリフがソースで読めない場合も失敗する
+			@return 正しいフォント・ファイルなら「true」
+		*/
+		//-----------------------------------------------------------------//
+		bool open() noexcept
+		{
+			face_num_ = 0;
+			sel_ = 0;
+			auto p = src_.read(0, sizeof(ufont_def::header_t));
+			if(p == nullptr) return false;
+			ufont_def::header_t h;
+			std::memcpy(&h, p, sizeof(h));
+			if(std::memcmp(h.magic, "UFNT", 4) != 0 || h.version != ufont_def::VERSION) {
+				return false;
+			}
+			if(h.glyph_max > SRC::READ_MAX) return false;
+			uint32_t n = h.face_num;
+			if(n > FNUM) n = FNUM;
+			for(uint32_t i = 0; i < n; ++i) {
+				p = src_.read(sizeof(ufont_def::header_t) + i * sizeof(face_t), sizeof(face_t));
+				if(p == nullptr) return false;
+				std::memcpy(&face_[i], p, sizeof(face_t));
+				if(face_[i].bpp != 1 && face_[i].bpp != 2) return false;
+			}
+			face_num_ = n;
+			return n > 0;
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	フェイス数を取得
+			@return フェイス数
+		*/
+		//-----------------------------------------------------------------//
+		uint32_t get_face_num() const noexcept { return face_num_; }
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	フェイス定義を取得
+			@param[in]	idx		フェイス番号
+			@return フェイス定義
+		*/
+		//-----------------------------------------------------------------//
+		const face_t& get_face(uint32_t idx) const noexcept { return face_[idx < FNUM ? idx : 0]; }
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	フェイスを選択する
+			@param[in]	idx		フェイス番号
+			@return 範囲外なら「false」
+		*/
+		//-----------------------------------------------------------------//
+		bool select_face(uint32_t idx) noexcept
+		{
+			if(idx >= face_num_) return false;
+			sel_ = idx;
+			return true;
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	高さでフェイスを選択する @n
+					指定以下で一番大きいフェイス（無ければ一番小さいフェイス）
+			@param[in]	height	行の高さ
+			@return 選択したフェイス番号
+		*/
+		//-----------------------------------------------------------------//
+		uint32_t select(uint8_t height) noexcept
+		{
+			uint32_t best = FNUM;
+			uint32_t small = 0;
+			for(uint32_t i = 0; i < face_num_; ++i) {
+				auto h = face_[i].height;
+				if(h <= height && (best == FNUM || h > face_[best].height)) best = i;
+				if(h < face_[small].height) small = i;
+			}
+			sel_ = best < FNUM ? best : small;
+			return sel_;
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	選択しているフェイス番号
+			@return フェイス番号
+		*/
+		//-----------------------------------------------------------------//
+		uint32_t get_select() const noexcept { return sel_; }
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	行の高さ（選択フェイス）
+			@return 行の高さ
+		*/
+		//-----------------------------------------------------------------//
+		int16_t get_height() const noexcept { return face_num_ > 0 ? face_[sel_].height : 0; }
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	階調のビット数（選択フェイス）
+			@return 1 又は 2
+		*/
+		//-----------------------------------------------------------------//
+		uint8_t get_bpp() const noexcept { return face_[sel_].bpp; }
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	グリフを探す @n
+					無い場合は、フェイスの def_code のグリフを返す
+			@param[in]	code	UTF-16 コード
+			@param[out]	g		グリフ
+			@return グリフがあれば「true」
+		*/
+		//-----------------------------------------------------------------//
+		bool find(uint16_t code, glyph_t& g) noexcept
+		{
+			if(face_num_ == 0) return false;
+			++stat_.find;
+			if(find_(code, g)) return true;
+			++stat_.miss;
+			auto def = face_[sel_].def_code;
+			return def != 0 && def != code && find_(def, g);
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	グリフを水平ランに展開する
+			@param[in]	g		グリフ
+			@param[in]	fn		ファンクタ fn(x, y, len, level)、level は 1 以上
+			@return 成功なら「true」
+		*/
+		//-----------------------------------------------------------------//
+		template <class FUNC>
+		bool decode(const glyph_t& g, FUNC fn) noexcept
+		{
+			if(g.len == 0) return true;
+			const auto& f = face_[sel_];
+			auto p = src_.read(f.bits_ofs + g.ofs, g.len);
+			if(p == nullptr) return false;
+			++stat_.glyph;
+			stat_.run += ufont_def::decode(g, f.bpp, p, fn);
+			return true;
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	文字の送り幅を取得
+			@param[in]	code	UTF-16 コード
+			@return 送り幅
+		*/
+		//-----------------------------------------------------------------//
+		int16_t get_advance(uint16_t code) noexcept
+		{
+			glyph_t g;
+			if(find(code, g)) return g.adv;
+			return 0;
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	UTF-8 コードを押し込む
+			@param[in]	ch	UTF-8 の１バイト
+			@return UTF-16 コードが完了した場合「true」
+		*/
+		//-----------------------------------------------------------------//
+		bool injection_utf8(uint8_t ch) noexcept
+		{
+			if(ch < 0x80) {
+				code_ = ch;
+				cnt_ = 0;
+				return true;
+			} else if((ch & 0xf0) == 0xe0) {
+				code_ = ch & 0x0f;
+				cnt_ = 2;
+			} else if((ch & 0xe0) == 0xc0) {
+				code_ = ch & 0x1f;
+				cnt_ = 1;
+			} else if((ch & 0xc0) == 0x80 && cnt_ > 0) {
+				code_ <<= 6;
+				code_ |= ch & 0x3f;
+				--cnt_;
+				return cnt_ == 0;
+			} else {
+				cnt_ = 0;	// ４バイト・コード、不正なコードは捨てる
+			}
+			return false;
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	UTF-16 コードを取得
+			@return UTF-16 コード
+		*/
+		//-----------------------------------------------------------------//
+		uint16_t get_utf16() const noexcept { return code_; }
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	テキストの描画サイズを得る
+			@param[in]	text	テキスト（UTF-8）
+			@return 描画サイズ
+		*/
+		//-----------------------------------------------------------------//
+		vtx::spos get_text_size(const char* text) noexcept
+		{
+			vtx::spos sz(0);
+			if(text == nullptr) return sz;
+
+			auto h = get_height();
+			int16_t x = 0;
+			char ch;
+			while((ch = *text++) != 0) {
+				if(ch == '\n') {
+					if(sz.x < x) sz.x = x;
+					x = 0;
+					sz.y += h;
+				} else if(injection_utf8(static_cast<uint8_t>(ch))) {
+					x += get_advance(get_utf16());
+				}
+			}
+			if(sz.x < x) sz.x = x;
+			if(sz.y == 0 || x > 0) sz.y += h;
+			return sz;
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	統計を取得
+			@return 統計
+		*/
+		//-----------------------------------------------------------------//
+		const stat_t& get_stat() const noexcept { return stat_; }
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	統計をクリア
+		*/
+		//-----------------------------------------------------------------//
+		void clear_stat() noexcept { stat_ = stat_t(); }
+	};
+}
@@ -306,6 +306,7 @@ namespace gui {
 					t.draw_ = false;
 					++dc;
 				}
+				bool refresh = t.refresh_;
 				if(t.refresh_) {
 					draw = true;
 					t.refresh_ = false;
@@ -387,9 +388,10 @@ namespace gui {
 					break;
 				case widget::ID::TERM:
 					{
-//						auto* w = dynamic_cast<term*>(t.w_);
-//						if(w == nullptr) break;
-//						w->draw(rdr_);
+						auto* w = dynamic_cast<term_base*>(t.w_);
+						if(w == nullptr) break;
+						if(refresh) w->redraw();
+						w->draw(rdr_);
 					}
 					break;
 				case widget::ID::SPINBOX:
@@ -0,0 +1,144 @@
+#pragma once
+//=====================================================================//
+/*!	@file
+	@brief	ホスト・テスト用 libmad のモック @n
+			フレームは本物の MPEG-1 Layer III ヘッダー（48KHz/128Kbps、384 バイト）@n
+			で、ペイロードに合成する PCM の情報を持つ @n
+			ペイロード：'SYN!', フレーム番号, スキップ数, 有効サンプル数, ベース値 @n
+			有効範囲はランプ波形、範囲外（エンコーダー遅延、パディング）は 0x7abc
+    @author 平松邦仁 (hira@rvf-rc45.net)
+	@copyright	Copyright (C) 2021 Kunihito Hiramatsu @n
+				Released under the MIT license @n
+				https://github.com/hirakuni45/RX/blob/master/LICENSE
+*/
+//=====================================================================//
+#include <cstdint>
+#include <cstring>
+
+typedef int32_t mad_fixed_t;
+
+#define MAD_F_FRACBITS		28
+#define MAD_F_ONE			0x10000000L
+#define MAD_BUFFER_GUARD	8
+#define mad_f_mul(a, b)		((mad_fixed_t)(((int64_t)(a) * (b)) >> MAD_F_FRACBITS))
+
+enum mad_layer { MAD_LAYER_I = 1, MAD_LAYER_II = 2, MAD_LAYER_III = 3 };
+enum mad_mode {
+	MAD_MODE_SINGLE_CHANNEL = 0, MAD_MODE_DUAL_CHANNEL = 1, MAD_MODE_JOINT_STEREO = 2, MAD_MODE_STEREO = 3
+};
+enum { MAD_FLAG_PROTECTION = 0x0010, MAD_FLAG_LSF_EXT = 0x1000 };
+enum mad_error { MAD_ERROR_NONE = 0, MAD_ERROR_BUFLEN = 0x0001, MAD_ERROR_LOSTSYNC = 0x0101 };
+
+#define MAD_RECOVERABLE(error)	((error) & 0xff00)
+
+struct mad_stream {
+	const unsigned char*	buffer;
+	const unsigned char*	bufend;
+	const unsigned char*	this_frame;
+	const unsigned char*	next_frame;
+	int						error;
+};
+
+struct mad_header {
+	enum mad_layer	layer;
+	enum mad_mode	mode;
+	int				flags;
+	unsigned long	bitrate;
+	unsigned int	samplerate;
+};
+
+struct mad_frame {
+	mad_header				header;
+	const unsigned char*	payload;
+	mad_fixed_t				sbsample[2][36][32];
+};
+
+struct mad_pcm {
+	unsigned short	length;
+	mad_fixed_t		samples[2][1152];
+};
+
+struct mad_synth {
+	mad_pcm		pcm;
+};
+
+#define MAD_NSBSAMPLES(h)	(36)
+#define MAD_NCHANNELS(h)	((h)->mode ? 2 : 1)
+
+static const unsigned MOCK_FRAME_LEN = 384;
+
+inline void mad_stream_init(mad_stream* s) { memset(s, 0, sizeof(*s)); }
+inline void mad_stream_finish(mad_stream*) { }
+inline void mad_stream_buffer(mad_stream* s, const unsigned char* b, unsigned long len)
+{
+	s->buffer = b;
+	s->bufend = b + len;
+	s->this_frame = b;
+	s->next_frame = b;
+}
+inline void mad_header_init(mad_header* h) { memset(h, 0, sizeof(*h)); }
+#define mad_header_finish(h)	do { } while(0)
+inline void mad_frame_init(mad_frame* f) { memset(f, 0, sizeof(*f)); }
+#define mad_frame_finish(f)		do { } while(0)
+inline void mad_frame_mute(mad_frame*) { }
+inline void mad_synth_init(mad_synth* s) { memset(s, 0, sizeof(*s)); }
+#define mad_synth_finish(s)		do { } while(0)
+inline void mad_synth_mute(mad_synth*) { }
+
+
+inline int mad_header_decode(mad_header* h, mad_stream* s)
+{
+	const unsigned char* p = s->next_frame;
+	while((p + 4) <= s->bufend && !(p[0] == 0xff && (p[1] & 0xe0) == 0xe0)) ++p;
+	if((p + MOCK_FRAME_LEN) > s->bufend) {
+		s->next_frame = p;
+		s->error = MAD_ERROR_BUFLEN;
+		return -1;
+	}
+	h->layer = MAD_LAYER_III;
+	h->mode = (p[3] >> 6) == 3 ? MAD_MODE_SINGLE_CHANNEL : MAD_MODE_STEREO;
+	h->flags = (p[1] & 1) ? 0 : MAD_FLAG_PROTECTION;
+	h->bitrate = 128000;
+	h->samplerate = 48000;
+	s->this_frame = p;
+	s->next_frame = p + MOCK_FRAME_LEN;
+	s->error = 0;
+	return 0;
+}
+
+
+inline int mad_frame_decode(mad_frame* f, mad_stream* s)
+{
+	if(mad_header_decode(&f->header, s)) return -1;
+	f->payload = s->this_frame + 36;
+	return 0;
+}
+
+
+inline uint32_t mock_get32(const unsigned char* p)
+{
+	uint32_t v;
+	memcpy(&v, p, 4);
+	return v;
+}
+
+
+inline void mad_synth_frame(mad_synth* sy, const mad_frame* f)
+{
+	sy->pcm.length = 1152;
+	const unsigned char* p = f->payload;
+	bool syn = memcmp(p, "SYN!", 4) == 0;
+	uint32_t fr = mock_get32(p + 4);
+	uint32_t skip = mock_get32(p + 8);
+	uint32_t valid = mock_get32(p + 12);
+	uint32_t base = mock_get32(p + 16);
+	for(uint32_t i = 0; i < 1152; ++i) {
+		int32_t v = 0;
+		if(syn) {
+			uint32_t j = fr * 1152 + i;
+			if(j >= skip && (valid == 0 || j < (skip + valid))) v = ((base + j - skip) % 0x3fff) + 1;
+			else v = 0x7abc;
+		}
+		sy->pcm.samples[0][i] = sy->pcm.samples[1][i] = v << (MAD_F_FRACBITS - 15);
+	}
+}
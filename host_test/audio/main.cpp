@@ -0,0 +1,455 @@
+//=====================================================================//
+/*!	@file
+	@brief	codec_mgr、af_prefetch、曲間無し再生テスト @n
+			FAT16 の RAM ディスク（FatFs）に合成した mp3/wav を置き、SD の遅延を模擬して @n
+			null DAC（実時間の４倍速）で再生する。@n
+			パイプライン再生（I/O タスク、デコード・タスク）と同期再生で、出力が期待値と @n
+			ビット単位で一致する事、曲間の無音、先読みのアンダーランを検査する。@n
+			・t1.mp3: LAME タグ（エンコーダー遅延、パディング）@n
+			・t2.wav: 奇数長 @n
+			・t3.mp3: Xing 無し、iTunSMPB（COMM）、ID3v1 @n
+			・t4.mp3: LAME タグ、100KB の APIC（タグの読み飛ばしでファイルを開き直す）
+    @author 平松邦仁 (hira@rvf-rc45.net)
+	@copyright	Copyright (C) 2021 Kunihito Hiramatsu @n
+				Released under the MIT license @n
+				https://github.com/hirakuni45/RX/blob/master/LICENSE
+*/
+//=====================================================================//
+#include "FreeRTOS.h"
+#include "task.h"
+#include <vector>
+#include <string>
+#include <atomic>
+#include <thread>
+#include <unistd.h>
+#include <fcntl.h>
+#include "test.hpp"
+#include "host_stub.hpp"
+#include "rtos_host.hpp"
+#include "ram_disk.hpp"
+#include "sound/codec_mgr.hpp"
+#include "sound/af_prefetch.hpp"
+
+extern "C" {
+	void set_sample_rate(uint32_t freq) { }
+}
+
+namespace {
+
+	static const uint32_t SPEED = 4;			///< null DAC の速度（実時間の倍率）
+	static const uint32_t READ_US = 150;		///< コマンド毎の遅延
+	static const uint32_t STALL_EVERY = 40;		///< ストールするコマンド間隔
+	static const uint32_t STALL_US = 60000;		///< ストール時間
+
+	typedef sound::sound_out<int16_t, 8192, 1024> SOUND_OUT;
+	SOUND_OUT	sound_out_(0);
+
+	struct list_ctrl {
+		bool		ctrl_ena_ = false;
+		uint32_t	ctrl_n_ = 0;
+		uint32_t	tags_ = 0;
+		uint32_t	starts_ = 0;
+
+		void start(const char* fn) { ++starts_; }
+		void close() { }
+		sound::af_play::CTRL ctrl() {
+			++ctrl_n_;
+			if(ctrl_ena_) {
+				if(ctrl_n_ == 100) return sound::af_play::CTRL::REPLAY;
+				if(ctrl_n_ == 300) return sound::af_play::CTRL::NEXT;
+				if(ctrl_n_ == 600) return sound::af_play::CTRL::STOP;
+			}
+			return sound::af_play::CTRL::NONE;
+		}
+		void tag(utils::file_io& fin, const sound::tag_t& t) { ++tags_; }
+		void update(uint32_t t) { }
+	};
+
+	std::vector<int16_t>	expect_;
+	uint32_t				expect_base_ = 0;
+	uint32_t				t3_org_ = 0;
+
+
+	//----- 合成メディア -----//
+
+	static const uint32_t FRAME = 384;
+
+	void be32_(std::string& s, uint32_t v)
+	{
+		s += static_cast<char>(v >> 24);
+		s += static_cast<char>(v >> 16);
+		s += static_cast<char>(v >> 8);
+		s += static_cast<char>(v);
+	}
+
+
+	void le32_(std::string& s, uint32_t v)
+	{
+		s += static_cast<char>(v);
+		s += static_cast<char>(v >> 8);
+		s += static_cast<char>(v >> 16);
+		s += static_cast<char>(v >> 24);
+	}
+
+
+	void le16_(std::string& s, uint16_t v)
+	{
+		s += static_cast<char>(v);
+		s += static_cast<char>(v >> 8);
+	}
+
+
+	std::string hdr_()
+	{
+		return std::string("\xff\xfb\x94\x04", 4);
+	}
+
+
+	std::string id3v2_(const std::vector<std::pair<std::string, std::string>>& frames)
+	{
+		std::string body;
+		for(const auto& f : frames) {
+			body += f.first;
+			be32_(body, f.second.size());
+			body += std::string(2, '\0');
+			body += f.second;
+		}
+		auto n = body.size();
+		std::string s("ID3\x03\x00\x00", 6);
+		s += static_cast<char>((n >> 21) & 0x7f);
+		s += static_cast<char>((n >> 14) & 0x7f);
+		s += static_cast<char>((n >> 7) & 0x7f);
+		s += static_cast<char>(n & 0x7f);
+		return s + body;
+	}
+
+
+	std::string info_frame_(uint32_t nframes, uint32_t delay, uint32_t padding)
+	{
+		std::string f = hdr_() + std::string(FRAME - 4, '\0');
+		std::string x = "Info";
+		be32_(x, 0x0f);
+		be32_(x, nframes);
+		be32_(x, nframes * FRAME);
+		x += std::string(100, '\0');
+		be32_(x, 50);
+		std::string l(36, '\0');
+		l.replace(0, 9, "LAME3.100");
+		l[21] = (delay >> 4) & 0xff;
+		l[22] = ((delay & 0xf) << 4) | ((padding >> 8) & 0xf);
+		l[23] = padding & 0xff;
+		x += l;
+		f.replace(36, x.size(), x);
+		return f;
+	}
+
+
+	std::string audio_(uint32_t nframes, uint32_t skip, uint32_t valid)
+	{
+		std::string d;
+		for(uint32_t i = 0; i < nframes; ++i) {
+			std::string f = hdr_() + std::string(FRAME - 4, '\0');
+			std::string p = "SYN!";
+			le32_(p, i);
+			le32_(p, skip);
+			le32_(p, valid);
+			le32_(p, expect_base_);
+			f.replace(36, p.size(), p);
+			d += f;
+		}
+		return d;
+	}
+
+
+	void ramp_(uint32_t n)
+	{
+		for(uint32_t k = 0; k < n; ++k) {
+			expect_.push_back(((expect_base_ + k) % 0x3fff) + 1);
+		}
+		expect_base_ += n;
+	}
+
+
+	bool make_media_()
+	{
+		static const uint32_t LIBMAD_DELAY = 529;
+		bool ok = true;
+		{  // t1: LAME タグ
+			uint32_t valid = 100000;
+			uint32_t delay = 576;
+			uint32_t nf = (delay + valid + LIBMAD_DELAY + 1151) / 1152;
+			uint32_t pad = nf * 1152 - delay - valid;
+			auto d = id3v2_({ { "TIT2", std::string("\0Track one", 10) } })
+				+ info_frame_(nf, delay, pad) + audio_(nf, delay + LIBMAD_DELAY, valid);
+			ok &= test::write_file("t1.mp3", d.data(), d.size());
+			ramp_(valid);
+		}
+		{  // t2: wav、奇数長
+			uint32_t n = 37777;
+			std::string pcm;
+			for(uint32_t k = 0; k < n; ++k) {
+				uint16_t v = ((expect_base_ + k) % 0x3fff) + 1;
+				le16_(pcm, v);
+				le16_(pcm, v);
+			}
+			ramp_(n);
+			std::string w = "RIFF";
+			le32_(w, 4 + 8 + 16 + 8 + pcm.size());
+			w += "WAVEfmt ";
+			le32_(w, 16);
+			le16_(w, 1);
+			le16_(w, 2);
+			le32_(w, 48000);
+			le32_(w, 48000 * 4);
+			le16_(w, 4);
+			le16_(w, 16);
+			w += "data";
+			le32_(w, pcm.size());
+			w += pcm;
+			ok &= test::write_file("t2.wav", w.data(), w.size());
+		}
+		{  // t3: Xing 無し、iTunSMPB、ID3v1
+			uint32_t valid = 80001;
+			uint32_t delay = 1105;
+			uint32_t nf = (delay + valid + 1151) / 1152;
+			uint32_t pad = nf * 1152 - delay - valid;
+			char smpb[64];
+			std::snprintf(smpb, sizeof(smpb), " 00000000 %08X %08X %016X 00000000", delay, pad, valid);
+			auto d = id3v2_({ { "COMM", std::string("\0engiTunSMPB\0", 13) + smpb } })
+				+ audio_(nf, delay, valid);
+			d += "TAG";
+			auto title = std::string("Title three");
+			d += title + std::string(30 - title.size(), '\0');
+			d += std::string(128 - 33, '\0');
+			ok &= test::write_file("t3.mp3", d.data(), d.size());
+			t3_org_ = expect_.size();
+			ramp_(valid);
+		}
+		{  // t4: LAME タグ、大きな APIC
+			uint32_t valid = 60000;
+			uint32_t delay = 1152;
+			uint32_t nf = (delay + valid + LIBMAD_DELAY + 1151) / 1152;
+			uint32_t pad = nf * 1152 - delay - valid;
+			auto apic = std::string("\0image/jpeg\0\x03\0", 14) + std::string(100000, '\0');
+			auto d = id3v2_({ { "TIT2", std::string("\0Track four", 11) }, { "APIC", apic } })
+				+ info_frame_(nf, delay, pad) + audio_(nf, delay + LIBMAD_DELAY, valid);
+			ok &= test::write_file("t4.mp3", d.data(), d.size());
+			ramp_(valid);
+		}
+		return ok;
+	}
+
+
+	//----- null DAC -----//
+
+	std::atomic<bool>		dac_run_;
+	std::vector<int16_t>	rec_;
+
+	void dac_task_()
+	{
+		uint32_t per_ms = 48 * SPEED;
+		test::stopwatch sw;
+		uint64_t done = 0;
+		while(dac_run_) {
+			uint64_t want = static_cast<uint64_t>(sw.sec() * 1000.0 * per_ms);
+			while((done + 64) <= want) {
+				sound_out_.service(64);
+				auto pos = sound_out_.get_sample_pos();
+				for(uint32_t i = 0; i < 64; ++i) {
+					rec_.push_back(sound_out_.get_sample((pos - 64 + i) & 1023)->l_ch);
+				}
+				done += 64;
+			}
+			usleep(500);
+		}
+	}
+
+
+	struct result_t {
+		std::vector<int16_t>	pcm;		///< 無音を除いたサンプル
+		uint32_t				gaps;
+		uint32_t				gap_samples;
+	};
+
+	result_t analyze_()
+	{
+		result_t r;
+		r.gaps = 0;
+		r.gap_samples = 0;
+		size_t first = 0;
+		while(first < rec_.size() && rec_[first] == 0) ++first;
+		size_t last = rec_.size();
+		while(last > first && rec_[last - 1] == 0) --last;
+		bool in = false;
+		for(size_t i = first; i < last; ++i) {
+			if(rec_[i] == 0) {
+				if(!in) ++r.gaps;
+				in = true;
+				++r.gap_samples;
+			} else {
+				in = false;
+				r.pcm.push_back(rec_[i]);
+			}
+		}
+		return r;
+	}
+
+
+	uint32_t mismatch_(const std::vector<int16_t>& a, const int16_t* b, uint32_t n)
+	{
+		uint32_t m = 0;
+		for(uint32_t i = 0; i < n; ++i) {
+			if(i >= a.size() || a[i] != b[i]) ++m;
+		}
+		return m;
+	}
+
+
+	void start_()
+	{
+		rec_.clear();
+		sound_out_.at_fifo().clear();
+		dac_run_ = true;
+	}
+
+
+	//----- パイプライン再生 -----//
+
+	void test_pipeline_(bool ctrl)
+	{
+		list_ctrl lc;
+		lc.ctrl_ena_ = ctrl;
+		auto mgr = new sound::codec_mgr<list_ctrl, SOUND_OUT>(lc, sound_out_);
+		mgr->at_mp3_in().enable_dither(false);  // ビット単位で比較する
+		typedef sound::af_prefetch<65536> PREFETCH;
+		auto& pf = *new PREFETCH;
+		auto under = sound_out_.get_underrun();
+
+		test::disk().clear_count();
+		start_();
+		std::thread dac(dac_task_);
+		std::atomic<bool> io_run(true);
+		std::thread io([&]() {
+			while(io_run) {
+				if(!mgr->io_service(pf)) vTaskDelay(1);
+			}
+		});
+		mgr->play("");
+		uint32_t idle = 0;
+		bool again = ctrl;
+		while(idle < 20) {
+			if(!mgr->decode_service(pf)) {
+				++idle;
+				vTaskDelay(10);
+			} else {
+				idle = 0;
+			}
+			if(again && idle > 10) {
+				again = false;
+				mgr->play("t3.mp3");
+				idle = 0;
+			}
+		}
+		while(sound_out_.at_fifo().length() > 0) vTaskDelay(5);
+		vTaskDelay(50);
+		io_run = false;
+		io.join();
+		dac_run_ = false;
+		dac.join();
+		delete mgr;
+
+		auto r = analyze_();
+		under = sound_out_.get_underrun() - under;
+		std::fprintf(stderr, "pipeline%s: %zu samples, gaps %u (%.1f ms), sound_out underrun %u, "
+			"prefetch underrun %u, fetch %u, reopen %u, disk read %u cmd\n",
+			ctrl ? " (REPLAY/NEXT/STOP, play)" : "",
+			r.pcm.size(), r.gaps, r.gap_samples / 48.0, under, pf.get_underrun(),
+			pf.get_fetch_count(), pf.get_reopen_count(), test::disk().read_cmd.load());
+		delete &pf;
+		if(ctrl) {
+			// 最後に play した t3 から、t4 まで続けて再生される
+			uint32_t len = expect_.size() - t3_org_;
+			CHECK(r.pcm.size() >= len);
+			if(r.pcm.size() >= len) {
+				std::vector<int16_t> tail(r.pcm.end() - len, r.pcm.end());
+				CHECK_EQ(mismatch_(tail, &expect_[t3_org_], len), 0u);
+			}
+			CHECK(lc.starts_ > 4);
+		} else {
+			CHECK_EQ(r.pcm.size(), expect_.size());
+			CHECK_EQ(mismatch_(r.pcm, expect_.data(), expect_.size()), 0u);
+			CHECK_EQ(r.gaps, 0u);
+			CHECK_EQ(lc.starts_, 4u);
+			CHECK_EQ(lc.tags_, 4u);
+		}
+	}
+
+
+	//----- 同期再生（比較用）-----//
+
+	void test_sync_()
+	{
+		list_ctrl lc;
+		auto mgr = new sound::codec_mgr<list_ctrl, SOUND_OUT>(lc, sound_out_);
+		mgr->at_mp3_in().enable_dither(false);  // ビット単位で比較する
+		start_();
+		std::thread dac(dac_task_);
+		mgr->play("");
+		for(uint32_t i = 0; i < 8; ++i) {
+			mgr->service();
+		}
+		while(sound_out_.at_fifo().length() > 0) vTaskDelay(5);
+		vTaskDelay(50);
+		dac_run_ = false;
+		dac.join();
+		delete mgr;
+
+		auto r = analyze_();
+		std::fprintf(stderr, "sync: %zu samples, gaps %u (%.1f ms)\n", r.pcm.size(), r.gaps, r.gap_samples / 48.0);
+		CHECK_EQ(r.pcm.size(), expect_.size());
+		CHECK_EQ(mismatch_(r.pcm, expect_.data(), expect_.size()), 0u);
+		CHECK_EQ(lc.starts_, 4u);
+	}
+
+
+	/// utils::format の出力（コンソール表示）を捨てる
+	void quiet_(bool ena)
+	{
+		static int save = -1;
+		std::fflush(stdout);
+		if(ena) {
+			save = dup(STDOUT_FILENO);
+			int fd = open("/dev/null", O_WRONLY);
+			dup2(fd, STDOUT_FILENO);
+			close(fd);
+		} else if(save >= 0) {
+			dup2(save, STDOUT_FILENO);
+			close(save);
+			save = -1;
+		}
+	}
+}
+
+
+int main(int argc, char* argv[])
+{
+	CHECK(test::mount_ram_disk(65536, 8));
+	CHECK(make_media_());
+	std::printf("media: %zu samples (%.2f s)\n", expect_.size(), expect_.size() / 48000.0);
+
+	// SD の遅延：コマンド毎の待ちと、周期的なストール
+	test::disk().set_hook([](bool write, uint32_t sector, uint32_t count) {
+		static std::atomic<uint32_t> n(0);
+		usleep(READ_US);
+		if((++n % STALL_EVERY) == 0) usleep(STALL_US);
+		return true;
+	});
+
+	quiet_(true);
+	test_pipeline_(false);
+	test_sync_();
+	test_pipeline_(true);
+	quiet_(false);
+
+	return test::result("audio");
+}
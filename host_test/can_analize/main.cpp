@@ -0,0 +1,541 @@
+//=====================================================================//
+/*!	@file
+	@brief	can_analize、can_log のテスト @n
+			candump (-l) 形式のログを、モックの CAN_IO（16 ビットのタイムスタンプ・ @n
+			カウンタ、レジスタ・アクセス毎に進む仮想時間）で再生し、@n
+			フレーム時間、ID 毎の受信数、最小／最大受信間隔、レート、ペイロード変化、@n
+			テーブルの溢れを確かめる。@n
+			can_log の candump 出力が元のログと一致する事、途中の flush 後も @n
+			書き込みがセクター境界から始まる事、バイナリ・レコード、@n
+			バンクが一杯の時の取りこぼしの報告、時間が戻った場合を確かめる。@n
+			再生の速度を「bench:」行で表示する @n
+			引数に candump ファイルを与えると、それを再生して ID のリストを表示する
+    @author 平松邦仁 (hira@rvf-rc45.net)
+	@copyright	Copyright (C) 2021 Kunihito Hiramatsu @n
+				Released under the MIT license @n
+				https://github.com/hirakuni45/RX/blob/master/LICENSE
+*/
+//=====================================================================//
+#include <vector>
+#include <deque>
+#include <string>
+#include <random>
+#include <algorithm>
+#include "test.hpp"
+#include "host_stub.hpp"
+#include "common/can_analize.hpp"
+#include "common/can_log.hpp"
+
+namespace {
+
+	typedef device::can_frame FRAME;
+
+	static const uint32_t SEC0 = 1600000000;	// 再生の開始時刻
+
+	//----- candump -----//
+
+	struct line_t {
+		uint64_t	t;		// SEC0 からの時間 [us]
+		FRAME		frm;
+	};
+
+	bool parse_candump_(const char* text, std::vector<line_t>& out, uint64_t& sec0)
+	{
+		out.clear();
+		sec0 = 0;
+		while(*text != 0) {
+			unsigned long sec, usec;
+			char name[16];
+			char id[16];
+			char data[32];
+			int len = 0;
+			data[0] = 0;
+			if(std::sscanf(text, "(%lu.%lu) %15s %15[0-9A-Fa-f]#%31[0-9A-Fa-fR]%n",
+				&sec, &usec, name, id, data, &len) < 4) {
+				return false;
+			}
+			if(len == 0) {  // データ無し（DLC = 0）
+				std::sscanf(text, "(%lu.%lu) %15s %15[0-9A-Fa-f]#%n", &sec, &usec, name, id, &len);
+			}
+			if(out.empty()) sec0 = sec;
+			line_t l;
+			l.t = static_cast<uint64_t>(sec - sec0) * 1'000'000 + usec;
+			l.frm.set_id(std::strtoul(id, nullptr, 16));
+			l.frm.set_IDE(std::strlen(id) > 3);
+			bool rtr = data[0] == 'R';
+			l.frm.set_RTR(rtr);
+			uint32_t dlc = 0;
+			if(!rtr) {
+				for(uint32_t i = 0; data[i * 2] != 0 && i < 8; ++i) {
+					char tmp[3] = { data[i * 2], data[i * 2 + 1], 0 };
+					l.frm.set_DATA(i, std::strtoul(tmp, nullptr, 16));
+					++dlc;
+				}
+			}
+			l.frm.set_DLC(dlc);
+			out.push_back(l);
+			text += len;
+			while(*text == '\n' || *text == '\r') ++text;
+		}
+		return true;
+	}
+
+	std::string candump_line_(uint64_t t, const FRAME& f)
+	{
+		char tmp[80];
+		int n = std::snprintf(tmp, sizeof(tmp), f.get_IDE() ? "(%u.%06u) can0 %08X#" : "(%u.%06u) can0 %03X#",
+			static_cast<uint32_t>(SEC0 + t / 1'000'000), static_cast<uint32_t>(t % 1'000'000), f.get_id());
+		if(f.get_RTR()) {
+			n += std::snprintf(&tmp[n], sizeof(tmp) - n, "R");
+		} else {
+			for(uint32_t i = 0; i < f.get_DLC(); ++i) {
+				n += std::snprintf(&tmp[n], sizeof(tmp) - n, "%02X", f.get_DATA(i));
+			}
+		}
+		std::snprintf(&tmp[n], sizeof(tmp) - n, "\n");
+		return tmp;
+	}
+
+	FRAME frame_(uint32_t id, bool ext, bool rtr, uint32_t dlc, const uint8_t* d)
+	{
+		FRAME f;
+		f.set_id(id);
+		f.set_IDE(ext);
+		f.set_RTR(rtr);
+		f.set_DLC(dlc);
+		for(uint32_t i = 0; i < dlc; ++i) f.set_DATA(i, d[i]);
+		return f;
+	}
+
+	// 車載バスの模擬（時間は偶数 [us]、500Kbps のカウンタ周期に合わせる）
+	std::string make_bus_(uint32_t sec, uint32_t bgnum, uint32_t seed)
+	{
+		std::mt19937 rnd(seed);
+		std::vector<line_t> ls;
+		uint64_t end = static_cast<uint64_t>(sec) * 1'000'000;
+		auto even = [](uint64_t t) { return t & ~static_cast<uint64_t>(1); };
+
+		// 10ms 周期、ジッター ±200us、DATA0 はカウンタ
+		uint8_t d[8] = { 0, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77 };
+		for(uint64_t t = 5000, i = 0; t < end; t += 10000, ++i) {
+			d[0] = i;
+			ls.push_back(line_t{ even(t + rnd() % 400 - 200), frame_(0x123, false, false, 8, d) });
+		}
+		// 20ms 周期の拡張 ID、５回毎に DATA2,3 が変わる
+		uint8_t e[8] = { 0x02, 0x01, 0, 0, 0, 0, 0, 0 };
+		for(uint64_t t = 7000, i = 0; t < end; t += 20000, ++i) {
+			e[2] = i / 5;
+			e[3] = ~(i / 5);
+			ls.push_back(line_t{ even(t + rnd() % 100), frame_(0x18DAF110, true, false, 8, e) });
+		}
+		// 100ms 周期の OBD2 要求（変化無し）
+		uint8_t q[8] = { 0x02, 0x01, 0x0c, 0x55, 0x55, 0x55, 0x55, 0x55 };
+		for(uint64_t t = 9000; t < end; t += 100000) {
+			ls.push_back(line_t{ even(t), frame_(0x7DF, false, false, 8, q) });
+		}
+		// 50ms 周期のリモート・フレーム
+		for(uint64_t t = 11000; t < end; t += 50000) {
+			ls.push_back(line_t{ even(t), frame_(0x321, false, true, 0, nullptr) });
+		}
+		// 背景：ランダムな ID、長さ、間隔
+		for(uint32_t k = 0; k < bgnum; ++k) {
+			uint32_t per = 2000 + rnd() % 30000;
+			uint32_t dlc = rnd() % 9;
+			for(uint64_t t = rnd() % per; t < end; t += per) {
+				uint8_t r[8];
+				for(auto& b : r) b = rnd() % 4 == 0 ? rnd() : 0x5a;
+				ls.push_back(line_t{ even(t), frame_(0x400 + k, false, false, dlc, r) });
+			}
+		}
+		std::stable_sort(ls.begin(), ls.end(), [](const line_t& a, const line_t& b) { return a.t < b.t; });
+		std::string s;
+		for(const auto& l : ls) s += candump_line_(l.t, l.frm);
+		return s;
+	}
+
+
+	//----- モックの CAN_IO -----//
+
+	class mock_can {
+		const std::vector<line_t>&	src_;
+		std::deque<FRAME>			rbf_;
+	public:
+		uint32_t				speed = 500'000;
+		uint64_t				now = 0;		// 仮想時間 [us]
+		uint32_t				step = 0;		// レジスタ・アクセス毎に進む時間 [us]
+		size_t					next = 0;
+		std::deque<uint64_t>	arrive;			// 受信済み、未読のフレームの到着時間
+
+		mock_can(const std::vector<line_t>& src) : src_(src) { }
+
+		uint16_t ticks(uint64_t t) const { return t * speed / 1'000'000; }
+
+		void advance(uint64_t us)
+		{
+			now += us;
+			while(next < src_.size() && src_[next].t <= now) {
+				auto f = src_[next].frm;
+				f.set_TS(ticks(src_[next].t));
+				rbf_.push_back(f);
+				arrive.push_back(src_[next].t);
+				++next;
+			}
+		}
+
+		bool done() const { return next >= src_.size() && rbf_.empty(); }
+
+		uint32_t get_recv_num() { advance(step); return rbf_.size(); }
+
+		FRAME get_recv_frame()
+		{
+			advance(step);
+			auto f = rbf_.front();
+			rbf_.pop_front();
+			return f;
+		}
+
+		uint16_t get_timestamp() { advance(step); return ticks(now); }
+
+		uint32_t get_speed() const { return speed; }
+	};
+
+
+	//----- モックのファイル -----//
+
+	struct mock_file {
+		enum class SEEK { SET, CUR, END };
+
+		std::vector<uint8_t>	img;
+		uint32_t				pos = 0;
+		uint32_t				writes = 0;
+		uint32_t				unaligned = 0;	// セクター境界以外から始まる書き込み
+		uint32_t				bytes = 0;
+
+		uint32_t write(const void* src, uint32_t len)
+		{
+			if((pos % 512) != 0) ++unaligned;
+			if(img.size() < (pos + len)) img.resize(pos + len);
+			std::memcpy(&img[pos], src, len);
+			pos += len;
+			bytes += len;
+			++writes;
+			return len;
+		}
+
+		bool flush() { return true; }
+
+		uint32_t tell() const { return pos; }
+
+		bool seek(SEEK s, uint32_t ofs)
+		{
+			if(s != SEEK::SET || ofs > img.size()) return false;
+			pos = ofs;
+			return true;
+		}
+
+		std::string str() const { return std::string(img.begin(), img.end()); }
+	};
+
+	typedef utils::can_analize<mock_can> ANALIZE;
+	typedef utils::can_log<mock_file, FRAME> LOG;
+
+
+	//----- 再生 -----//
+
+	struct replay_t {
+		uint32_t	frames = 0;
+		uint32_t	bad_time = 0;		// 到着時間と一致しない
+		uint32_t	backward = 0;		// 時間が戻った
+		uint32_t	put_fail = 0;
+		uint32_t	flushes = 0;
+		bool		flush_ok = true;
+	};
+
+	template <class AN>
+	replay_t replay_(AN& an, mock_can& can, LOG* log, uint32_t seed)
+	{
+		replay_t r;
+		std::mt19937 rnd(seed);
+		uint32_t last = 0;
+		uint64_t flush_t = 700'000;
+		an.service();  // 時間の原点（step = 0）
+		can.step = 3;
+		while(!can.done()) {
+			// 普段は 1ms 毎、時々 20ms 遅れる（カウンタの周回は 131ms）
+			can.advance(rnd() % 16 == 0 ? 20'000 : 1'000);
+			an.service([&](const FRAME& frm, uint32_t t) {
+				if(can.arrive.empty() || t != can.arrive.front()) ++r.bad_time;
+				if(!can.arrive.empty()) can.arrive.pop_front();
+				if(r.frames > 0 && static_cast<int32_t>(t - last) < 0) ++r.backward;
+				last = t;
+				++r.frames;
+				if(log != nullptr && !log->put(frm, t)) ++r.put_fail;
+			});
+			if(log != nullptr) {
+				log->service();
+				if(can.now >= flush_t) {
+					r.flush_ok &= log->flush();
+					++r.flushes;
+					flush_t += 700'000 + rnd() % 1000;
+				}
+			}
+		}
+		if(log != nullptr) r.flush_ok &= log->flush();
+		return r;
+	}
+
+
+	// ID 毎の期待値
+	struct expect_t {
+		uint32_t	count = 0;
+		uint32_t	min_dt = 0xffffffff;
+		uint32_t	max_dt = 0;
+		uint32_t	change = 0;
+		uint8_t		cmask = 0;
+		uint64_t	last = 0;
+		FRAME		frm;
+	};
+
+	expect_t expect_(const std::vector<line_t>& src, uint32_t id)
+	{
+		expect_t e;
+		for(const auto& l : src) {
+			if(l.frm.get_id() != id) continue;
+			if(e.count > 0) {
+				uint32_t dt = l.t - e.last;
+				e.min_dt = std::min(e.min_dt, dt);
+				e.max_dt = std::max(e.max_dt, dt);
+				uint8_t m = l.frm.get_DLC() != e.frm.get_DLC() ? 0xff : 0;
+				for(uint32_t i = 0; i < 8; ++i) {
+					if(l.frm.get_DATA(i) != e.frm.get_DATA(i)) m |= 1 << i;
+				}
+				if(m != 0) {
+					e.cmask |= m;
+					++e.change;
+				}
+			}
+			++e.count;
+			e.last = l.t;
+			e.frm = l.frm;
+		}
+		return e;
+	}
+
+
+	void test_replay_(const std::string& text, const std::vector<line_t>& src)
+	{
+		static mock_can can(src);
+		static ANALIZE an(can);
+		static mock_file file;
+		static LOG log(file);
+		log.set_time(SEC0, 0);
+
+		test::stopwatch sw;
+		auto r = replay_(an, can, &log, 1);
+		auto sec = sw.sec();
+
+		CHECK_EQ(r.frames, src.size());
+		CHECK_EQ(r.bad_time, 0u);
+		CHECK_EQ(r.backward, 0u);
+		CHECK_EQ(r.put_fail, 0u);
+		CHECK(r.flushes >= 5);
+		CHECK(r.flush_ok);
+		CHECK_EQ(log.get_count(), src.size());
+		CHECK_EQ(log.get_lost(), 0u);
+		CHECK_EQ(log.get_error(), 0u);
+
+		// candump 出力は元のログと一致、書き込みは常にセクター境界から
+		CHECK(file.str() == text);
+		CHECK_EQ(file.unaligned, 0u);
+		std::printf("candump: %zu frames, %zu bytes, %u writes, %u flush, %u bytes written\n",
+			src.size(), text.size(), file.writes, r.flushes, file.bytes);
+
+		for(uint32_t id : { 0x123u, 0x18DAF110u, 0x7DFu, 0x321u, 0x400u, 0x40Fu }) {
+			auto e = expect_(src, id);
+			auto p = an.get(id);
+			CHECK(p != nullptr);
+			if(p == nullptr) continue;
+			CHECK_EQ(p->count_, e.count);
+			CHECK_EQ(p->min_dt_, e.min_dt);
+			CHECK_EQ(p->max_dt_, e.max_dt);
+			CHECK_EQ(p->change_, e.change);
+			CHECK_EQ(p->cmask_, e.cmask);
+			CHECK_EQ(p->last_, e.last);
+		}
+		CHECK_EQ(an.get(0x123)->cmask_, 0x01);
+		CHECK_EQ(an.get(0x18DAF110)->cmask_, 0x0c);
+		CHECK_EQ(an.get(0x18DAF110)->change_, (an.get(0x18DAF110)->count_ - 1) / 5);
+		CHECK_EQ(an.get(0x7DF)->change_, 0u);
+		CHECK(an.get(0x321)->frame_.get_RTR());
+		CHECK(an.get(0x18DAF110)->frame_.get_IDE());
+		auto rate = an.get(0x123)->rate_;
+		CHECK(rate >= 99 && rate <= 101);
+		CHECK_EQ(an.get(0x7DF)->rate_, 10);
+		CHECK_EQ(an.size(), 4u + 40u);
+		CHECK_EQ(an.get_overflow(), 0u);
+
+		std::printf("bench: replay %zu frames (%u IDs), analyzer + candump log: %.0f frames/s\n",
+			src.size(), an.size(), src.size() / sec);
+	}
+
+
+	// バイナリ・レコード
+	void test_binary_(const std::vector<line_t>& src)
+	{
+		static mock_can can(src);
+		static ANALIZE an(can);
+		static mock_file file;
+		static LOG log(file, LOG::FORMAT::BINARY);
+		log.set_time(SEC0, 0);
+
+		auto r = replay_(an, can, &log, 2);
+		CHECK_EQ(r.bad_time, 0u);
+		CHECK(r.flush_ok);
+		CHECK_EQ(file.unaligned, 0u);
+		CHECK_EQ(file.img.size(), src.size() * sizeof(LOG::record_t));
+
+		uint32_t bad = 0;
+		for(size_t i = 0; i < src.size() && (i + 1) * sizeof(LOG::record_t) <= file.img.size(); ++i) {
+			LOG::record_t rec;
+			std::memcpy(&rec, &file.img[i * sizeof(rec)], sizeof(rec));
+			const auto& l = src[i];
+			uint32_t id = l.frm.get_id() | (static_cast<uint32_t>(l.frm.get_IDE()) << 31)
+				| (static_cast<uint32_t>(l.frm.get_RTR()) << 30);
+			bool ok = rec.sec_ == SEC0 + l.t / 1'000'000 && rec.usec_ == l.t % 1'000'000
+				&& rec.id_ == id && rec.dlc_ == l.frm.get_DLC();
+			for(uint32_t j = 0; j < 8; ++j) {
+				if(rec.data_[j] != (j < rec.dlc_ ? l.frm.get_DATA(j) : 0)) ok = false;
+			}
+			if(!ok) ++bad;
+		}
+		CHECK_EQ(bad, 0u);
+	}
+
+
+	// 旧来の順（タイムスタンプを読んでから受信数）では、その間に届いたフレームの時間が一周戻る
+	void test_order_(const std::vector<line_t>& src)
+	{
+		static mock_can can(src);
+		static ANALIZE an(can);
+		auto r = replay_(an, can, nullptr, 3);
+		CHECK_EQ(r.bad_time, 0u);
+		CHECK_EQ(r.backward, 0u);
+		auto e = expect_(src, 0x123);
+		CHECK_EQ(an.get(0x123)->min_dt_, e.min_dt);
+		CHECK_EQ(an.get(0x123)->max_dt_, e.max_dt);
+	}
+
+
+	// テーブルが一杯（容量 16 の 3/4）
+	void test_overflow_(const std::vector<line_t>& src)
+	{
+		static mock_can can(src);
+		static utils::can_analize<mock_can, 16> an(can);
+		auto r = replay_(an, can, nullptr, 4);
+		CHECK_EQ(r.frames, src.size());
+		CHECK_EQ(an.size(), 12u);
+		CHECK(an.get_overflow() > 0);
+		uint32_t sum = 0;
+		for(const auto& l : src) {
+			if(an.get(l.frm.get_id()) != nullptr) ++sum;
+		}
+		CHECK_EQ(sum + an.get_overflow(), src.size());
+	}
+
+
+	// バンクが一杯：取りこぼしは put、get_lost、flush で報告される
+	void test_lost_(const std::vector<line_t>& src)
+	{
+		static mock_file file;
+		static utils::can_log<mock_file, FRAME, 1, 2> log(file);
+		log.set_time(SEC0, 0);
+		std::string ok;
+		uint32_t fail = 0;
+		for(size_t i = 0; i < 100; ++i) {
+			if(log.put(src[i].frm, src[i].t)) {
+				ok += candump_line_(src[i].t, src[i].frm);
+			} else {
+				++fail;
+			}
+		}
+		CHECK(fail > 0);
+		CHECK_EQ(log.get_lost(), fail);
+		CHECK_EQ(log.get_count() + log.get_lost(), 100u);
+		CHECK(!log.flush());
+		CHECK(file.str() == ok);
+		CHECK_EQ(file.unaligned, 0u);
+	}
+
+
+	// 時間が戻っても、前のフレームと同じ時刻で記録する
+	void test_backward_()
+	{
+		static mock_file file;
+		static LOG log(file);
+		log.set_time(100, 0);
+		uint8_t d[1] = { 0xab };
+		auto f = frame_(0x12, false, false, 1, d);
+		CHECK(log.put(f, 1000));
+		CHECK(log.put(f, 500));
+		CHECK(log.put(f, 2000));
+		CHECK(log.put(f, 1'002'000));
+		CHECK(log.flush());
+		CHECK(file.str() ==
+			"(100.001000) can0 012#AB\n"
+			"(100.001000) can0 012#AB\n"
+			"(100.002000) can0 012#AB\n"
+			"(101.002000) can0 012#AB\n");
+	}
+
+
+	// candump ファイルを再生して、ID のリストを表示
+	int replay_file_(const char* path)
+	{
+		auto fp = std::fopen(path, "rb");
+		if(fp == nullptr) {
+			std::printf("Can't open: '%s'\n", path);
+			return 1;
+		}
+		std::string text;
+		char tmp[4096];
+		size_t n;
+		while((n = std::fread(tmp, 1, sizeof(tmp), fp)) > 0) text.append(tmp, n);
+		std::fclose(fp);
+
+		static std::vector<line_t> src;
+		uint64_t sec0;
+		if(!parse_candump_(text.c_str(), src, sec0)) {
+			std::printf("Parse error: '%s'\n", path);
+			return 1;
+		}
+		static mock_can can(src);
+		static ANALIZE an(can);
+		replay_(an, can, nullptr, 0);
+		an.list_all();
+		return 0;
+	}
+}
+
+
+int main(int argc, char* argv[])
+{
+	if(argc > 1) {
+		return replay_file_(argv[1]);
+	}
+
+	static std::vector<line_t> src;
+	auto text = make_bus_(5, 40, 1);
+	uint64_t sec0;
+	CHECK(parse_candump_(text.c_str(), src, sec0));
+	CHECK_EQ(sec0, SEC0);
+	CHECK(src.size() > 10000);
+
+	test_replay_(text, src);
+	test_binary_(src);
+	test_order_(src);
+	test_overflow_(src);
+	test_lost_(src);
+	test_backward_();
+
+	return test::result("can_analize");
+}
@@ -0,0 +1,168 @@
+#pragma once
+//=====================================================================//
+/*!	@file
+	@brief	ホスト・テスト用 common/renesas.hpp の代用 @n
+			can_io が使う CAN レジスタ、メールボックスを、sim::read/sim::write @n
+			（main.cpp のモデル）に繋ぐ、can_frame は RX600/can.hpp と同じ配置
+    @author 平松邦仁 (hira@rvf-rc45.net)
+	@copyright	Copyright (C) 2021 Kunihito Hiramatsu @n
+				Released under the MIT license @n
+				https://github.com/hirakuni45/RX/blob/master/LICENSE
+*/
+//=====================================================================//
+#include <cstdint>
+#include "common/vect.h"
+#include "common/format.hpp"
+#include "common/fixed_fifo.hpp"
+
+namespace sim {
+	enum REG : int {
+		CTLR, STR, BCR, MKR, MKIVLR, MIER, EIER, FIDCR0, FIDCR1, RFCR, RFPCR, MCTL,
+		REG_NUM
+	};
+	extern uint32_t idx[REG_NUM];	// MKR[j]、MCTL[j] の j
+	uint32_t read(int id);
+	void write(int id, uint32_t v);
+	uint32_t peek(int id);
+	uint32_t mb_read(uint32_t mb, uint32_t w);
+	void mb_write(uint32_t mb, uint32_t w, uint32_t v);
+	const void* mb_addr(uint32_t mb);
+}
+
+namespace device {
+
+	enum class peripheral : uint16_t { CAN0 };
+
+	struct ICU {
+		enum class VECTOR : uint8_t { NONE = 0, GROUPBE0 = 106, RXF0 = 52, TXF0, RXM0, TXM0 };
+		enum class VECTOR_BE0 : uint8_t { ERS0 };
+	};
+
+	struct clock_profile {
+		static constexpr uint32_t PCLKB = 60'000'000;
+	};
+
+	struct power_mgr {
+		static bool turn(peripheral, bool ena = true) { return true; }
+	};
+
+	struct port_map {
+		enum class ORDER : uint8_t { FIRST, SECOND, THIRD };
+		static bool turn(peripheral, bool ena = true, ORDER = ORDER::FIRST) { return true; }
+	};
+
+	struct icu_mgr {
+		static void set_interrupt(ICU::VECTOR vec, void (*task)(), uint32_t lvl) {
+			sim::vec_task[static_cast<uint8_t>(vec)] = lvl > 0 ? task : nullptr;
+		}
+		static ICU::VECTOR get_group_vector(ICU::VECTOR_BE0) { return ICU::VECTOR::GROUPBE0; }
+		static uint32_t get_level(ICU::VECTOR) { return 0; }
+		static void set_level(ICU::VECTOR, uint32_t) { }
+		static bool install_group_task(ICU::VECTOR_BE0, void (*)()) { return true; }
+	};
+
+	// RX600/can.hpp の can_frame と同じ（32 ビット x 4 ワード）
+	class can_frame {
+		uint32_t	pad[4];
+	public:
+		can_frame() : pad{ 0 } { }
+		void set_IDE(bool v) { if(v) pad[0] |= 1u << 31; else pad[0] &= ~(1u << 31); }
+		bool get_IDE() const { return (pad[0] >> 31) & 1; }
+		void set_RTR(bool v) { if(v) pad[0] |= 1 << 30; else pad[0] &= ~(1 << 30); }
+		bool get_RTR() const { return (pad[0] >> 30) & 1; }
+		void set_SID(uint32_t id) { pad[0] &= ~(0x7ff << 18); pad[0] |= (id << 18); }
+		uint32_t get_SID() const { return (pad[0] >> 18) & 0x7ff; }
+		void set_EID(uint32_t id) { pad[0] &= ~(0x3ffff); pad[0] |= id; }
+		uint32_t get_EID() const { return pad[0] & 0x3ffff; }
+		void set_DLC(uint32_t n) { pad[1] &= ~(0xf << 16); pad[1] |= (n << 16); }
+		uint32_t get_DLC() const { return (pad[1] >> 16) & 0xf; }
+		void set_DATA(uint32_t idx, uint8_t d) {
+			uint32_t sfc = (~(idx + 6) & 0x3) << 3;
+			uint32_t ofs = (idx + 6) >> 2;
+			pad[ofs] &= ~(0xff << sfc);
+			pad[ofs] |= static_cast<uint32_t>(d) << sfc;
+		}
+		uint8_t get_DATA(uint32_t idx) const {
+			uint32_t sfc = (~(idx + 6) & 0x3) << 3;
+			uint32_t ofs = (idx + 6) >> 2;
+			return pad[ofs] >> sfc;
+		}
+		void set_TS(uint16_t ts) { pad[3] &= 0xffff0000; pad[3] |= ts; }
+		uint16_t get_TS() const { return pad[3] & 0xffff; }
+		void set_id(uint32_t id) { set_SID(id); set_EID(id >> 11); }
+		uint32_t get_id() const {
+			if(get_IDE() == 0) return get_SID();
+			else return get_SID() | (get_EID() << 11);
+		}
+		const uint32_t& operator [] (uint32_t idx) const { return pad[idx]; }
+		uint32_t& operator [] (uint32_t idx) { return pad[idx]; }
+	};
+
+	// 汎用レジスタ
+	template <int ID>
+	struct reg_t {
+		uint32_t operator () () const { return sim::read(ID); }
+		void operator = (uint32_t v) { sim::write(ID, v); }
+	};
+
+	template <int ID, int POS, int LEN = 1>
+	struct bits_t {
+		static constexpr uint32_t M = (LEN >= 32) ? 0xFFFFFFFF : ((1u << LEN) - 1);
+		static constexpr uint32_t b(uint32_t v = 1) { return (v & M) << POS; }
+		uint32_t operator () () const { return (sim::read(ID) >> POS) & M; }
+		void operator = (uint32_t v) { sim::write(ID, (sim::peek(ID) & ~(M << POS)) | ((v & M) << POS)); }
+	};
+
+	struct CAN0 {
+		static constexpr auto PERIPHERAL = peripheral::CAN0;
+		static constexpr auto RXF_VEC = ICU::VECTOR::RXF0;
+		static constexpr auto RXM_VEC = ICU::VECTOR::RXM0;
+		static constexpr auto TXM_VEC = ICU::VECTOR::TXM0;
+		static constexpr auto ERS_VEC = ICU::VECTOR_BE0::ERS0;
+
+		struct ctlr_t : reg_t<sim::CTLR> { using reg_t::operator =;
+			bits_t<sim::CTLR, 0> MBM; bits_t<sim::CTLR, 1, 2> IDFM; bits_t<sim::CTLR, 3> MLM;
+			bits_t<sim::CTLR, 4> TPM; bits_t<sim::CTLR, 8, 2> CANM; bits_t<sim::CTLR, 10> SLPM;
+			bits_t<sim::CTLR, 11, 2> BOM; };
+		static inline ctlr_t CTLR;
+		struct str_t : reg_t<sim::STR> {
+			bits_t<sim::STR, 8> RSTST; bits_t<sim::STR, 9> HLTST; bits_t<sim::STR, 10> SLPST; };
+		static inline str_t STR;
+		struct bcr_t : reg_t<sim::BCR> { using reg_t::operator =;
+			bits_t<sim::BCR, 0> CCLKS; bits_t<sim::BCR, 8, 3> TSEG2; bits_t<sim::BCR, 12, 2> SJW;
+			bits_t<sim::BCR, 16, 10> BRP; bits_t<sim::BCR, 28, 4> TSEG1; };
+		static inline bcr_t BCR;
+		struct mkr_t : reg_t<sim::MKR> { using reg_t::operator =;
+			mkr_t& operator [] (uint32_t j) { sim::idx[sim::MKR] = j & 7; return *this; } };
+		static inline mkr_t MKR;
+		static inline reg_t<sim::MKIVLR> MKIVLR;
+		static inline reg_t<sim::MIER> MIER;
+		struct eier_t : reg_t<sim::EIER> { using reg_t::operator =; bits_t<sim::EIER, 6> ORIE; };
+		static inline eier_t EIER;
+		static inline reg_t<sim::FIDCR0> FIDCR0;
+		static inline reg_t<sim::FIDCR1> FIDCR1;
+		struct rfcr_t : reg_t<sim::RFCR> { using reg_t::operator =;
+			bits_t<sim::RFCR, 0> RFE; bits_t<sim::RFCR, 4> RFMLF; bits_t<sim::RFCR, 7> RFEST; };
+		static inline rfcr_t RFCR;
+		static inline reg_t<sim::RFPCR> RFPCR;
+
+		struct mctl_t : reg_t<sim::MCTL> { using reg_t::operator =;
+			bits_t<sim::MCTL, 0> SENTDATA; bits_t<sim::MCTL, 0> NEWDATA;
+			bits_t<sim::MCTL, 1> TRMACTIVE; bits_t<sim::MCTL, 1> INVALDATA;
+			bits_t<sim::MCTL, 2> TRMABT; bits_t<sim::MCTL, 2> TMSGLOST;
+			bits_t<sim::MCTL, 4> ONESHOT; bits_t<sim::MCTL, 6> RECREQ; bits_t<sim::MCTL, 7> TRMREQ;
+			mctl_t& operator [] (uint32_t j) { sim::idx[sim::MCTL] = j & 31; return *this; } };
+		static inline mctl_t MCTL;
+
+		struct mb_t {
+			uint32_t	j;
+			void set(const can_frame& src) { for(uint32_t w = 0; w < 4; ++w) sim::mb_write(j, w, src[w]); }
+			void get(can_frame& dst) { for(uint32_t w = 0; w < 4; ++w) dst[w] = sim::mb_read(j, w); }
+			void clear(uint32_t d = 0) { for(uint32_t w = 0; w < 4; ++w) sim::mb_write(j, w, d); }
+			// メールボックスをフレームとして参照（コピーしない）
+			const can_frame& at_frame() { return *static_cast<const can_frame*>(sim::mb_addr(j)); }
+			mb_t& operator [] (uint32_t idx) { j = idx & 31; return *this; }
+		};
+		static inline mb_t MB;
+	};
+}
@@ -0,0 +1,18 @@
+#pragma once
+//=====================================================================//
+/*!	@file
+	@brief	ホスト・テスト用 common/vect.h の代用 @n
+			割り込みタスクは sim::vec_task に登録し、モデルから呼ぶ
+    @author 平松邦仁 (hira@rvf-rc45.net)
+	@copyright	Copyright (C) 2021 Kunihito Hiramatsu @n
+				Released under the MIT license @n
+				https://github.com/hirakuni45/RX/blob/master/LICENSE
+*/
+//=====================================================================//
+#include <cstdint>
+
+#define INTERRUPT_FUNC
+
+namespace sim {
+	extern void (*vec_task[256])();
+}
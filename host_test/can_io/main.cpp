@@ -0,0 +1,617 @@
+//=====================================================================//
+/*!	@file
+	@brief	can_io、CAN レジスタ・モデルでのテスト @n
+			受信の検索（RECREQ のメールボックスを番号順、MKR/MKIVLR、FIDCR0/1 の @n
+			受信 FIFO）、NEWDATA/INVALDATA/MSGLOST、動作モードをモデル化し、@n
+			ルールとコールバックの一致、読み出し中の上書き、コールバック中の @n
+			フレームの不変、Halt/スリープ・モードでの set_filter を確認する。@n
+			受信割り込みの処理速度を「bench:」行で表示する
+    @author 平松邦仁 (hira@rvf-rc45.net)
+	@copyright	Copyright (C) 2021 Kunihito Hiramatsu @n
+				Released under the MIT license @n
+				https://github.com/hirakuni45/RX/blob/master/LICENSE
+*/
+//=====================================================================//
+#include <vector>
+#include <array>
+#include <random>
+#include <utility>
+#include "test.hpp"
+#include "common/renesas.hpp"
+#include "common/can_io.hpp"
+
+//----- CAN のモデル -----//
+namespace sim {
+
+	uint32_t regs[REG_NUM];
+	uint32_t idx[REG_NUM];
+	void (*vec_task[256])();
+
+	uint32_t mb[32][4];
+	uint8_t mctl[32];
+	uint32_t mkr[8];
+
+	enum class ST : uint8_t { RESET, HALT, OPER, SLEEP };
+	ST st = ST::SLEEP;		// リセット後は、リセット・モード、スリープ
+	ST next = ST::SLEEP;	// STR は CTLR を書いた次の読み出しから変わる
+
+	uint32_t fifo[4][4];
+	uint32_t fifo_num = 0;
+
+	bool rxm_pend = false;
+	bool rxf_pend = false;
+	bool txm_pend = false;
+
+	uint16_t ts = 0;
+	uint32_t dropped = 0;	// 受けるメールボックスが無い
+	uint32_t sent = 0;
+	uint32_t bad = 0;		// リセット、Halt 以外でのフィルター・レジスタへの書き込み
+
+	// メールボックスの読み出し中のフック（hook_word を読んだ後に１回呼ぶ）
+	uint32_t hook_mb = 32;
+	uint32_t hook_word = 0;
+	void (*hook)() = nullptr;
+	uint32_t hook_fired = 0;
+
+	// 格納中（INVALDATA）のメールボックス
+	int32_t store_mb = -1;
+	uint32_t store_left = 0;
+	uint32_t store_frm[4];
+
+	void reset()
+	{
+		for(auto& r : regs) r = 0;
+		for(auto& i : idx) i = 0;
+		for(auto& v : vec_task) v = nullptr;
+		for(auto& m : mb) for(auto& w : m) w = 0;
+		for(auto& c : mctl) c = 0;
+		for(auto& k : mkr) k = 0xffffffff;
+		regs[CTLR] = 0x0500;  // CANM = 01、SLPM = 1
+		regs[RFCR] = 0x80;
+		st = next = ST::SLEEP;
+		fifo_num = 0;
+		rxm_pend = rxf_pend = txm_pend = false;
+		dropped = sent = bad = 0;
+		hook = nullptr;
+		hook_fired = 0;
+		store_mb = -1;
+	}
+
+	ST state_(uint32_t ctlr)
+	{
+		if(ctlr & 0x400) return ST::SLEEP;
+		switch((ctlr >> 8) & 3) {
+		case 0b00: return ST::OPER;
+		case 0b10: return ST::HALT;
+		default: return ST::RESET;
+		}
+	}
+
+	bool config_() { return st == ST::RESET || st == ST::HALT; }
+
+	void finish_store_()
+	{
+		auto j = static_cast<uint32_t>(store_mb);
+		for(uint32_t w = 0; w < 4; ++w) mb[j][w] = store_frm[w];
+		if(mctl[j] & 1) mctl[j] |= 4;
+		mctl[j] = (mctl[j] & ~2) | 1;
+		store_mb = -1;
+		if((regs[MIER] >> j) & 1) rxm_pend = true;
+	}
+
+	uint32_t rfcr_()
+	{
+		uint32_t v = regs[RFCR] & 0x11;
+		if(fifo_num == 0) v |= 0x80;
+		return v;
+	}
+
+	uint32_t peek(int id)
+	{
+		switch(id) {
+		case MKR:  return mkr[idx[MKR]];
+		case MCTL: return mctl[idx[MCTL]];
+		case RFCR: return rfcr_();
+		default:   return regs[id];
+		}
+	}
+
+	uint32_t read(int id)
+	{
+		if(id == STR) {
+			uint32_t v = 0;
+			if(st == ST::RESET) v |= 1 << 8;
+			if(st == ST::HALT)  v |= 1 << 9;
+			if(st == ST::SLEEP) v |= 1 << 10;
+			st = next;
+			return v;
+		}
+		if(id == MCTL) {
+			auto j = idx[MCTL];
+			if(store_mb == static_cast<int32_t>(j) && store_left > 0) {
+				--store_left;
+				if(store_left == 0) finish_store_();
+			}
+		}
+		return peek(id);
+	}
+
+	void write(int id, uint32_t v)
+	{
+		switch(id) {
+		case CTLR:
+			regs[CTLR] = v;
+			next = state_(v);
+			break;
+		case MKR:
+			if(!config_()) ++bad;
+			mkr[idx[MKR]] = v;
+			break;
+		case MKIVLR:
+		case FIDCR0:
+		case FIDCR1:
+		case BCR:
+			if(!config_()) ++bad;
+			regs[id] = v;
+			break;
+		case MCTL:
+			{
+				auto j = idx[MCTL];
+				auto old = mctl[j];
+				// NEWDATA/SENTDATA、MSGLOST は「０」だけ書ける、SENTDATA は TRMREQ が「０」の後
+				uint8_t keep = old & v & 0x05;
+				if(old & 0x80) keep |= old & 1;
+				keep |= old & 2;  // INVALDATA は読み出しだけ
+				mctl[j] = keep | (v & 0xd0);
+				if((v & 0x80) != 0 && (old & 0x80) == 0 && st == ST::OPER) {  // 送信（直ぐに終わる）
+					mctl[j] |= 1;
+					++sent;
+					if((regs[MIER] >> j) & 1) txm_pend = true;
+				}
+			}
+			break;
+		case RFCR:
+			regs[RFCR] = (v & 0x01) | (regs[RFCR] & v & 0x10);
+			if((v & 1) == 0) fifo_num = 0;
+			break;
+		case RFPCR:
+			if(fifo_num > 0) {
+				for(uint32_t i = 1; i < fifo_num; ++i) {
+					for(uint32_t w = 0; w < 4; ++w) fifo[i - 1][w] = fifo[i][w];
+				}
+				--fifo_num;
+				for(uint32_t w = 0; w < 4; ++w) mb[28][w] = fifo[0][w];
+			}
+			break;
+		default:
+			regs[id] = v;
+			break;
+		}
+	}
+
+	uint32_t mb_read(uint32_t j, uint32_t w)
+	{
+		auto v = mb[j][w];
+		if(hook != nullptr && j == hook_mb && w == hook_word) {
+			auto h = hook;
+			hook = nullptr;
+			++hook_fired;
+			(*h)();
+		}
+		return v;
+	}
+
+	void mb_write(uint32_t j, uint32_t w, uint32_t v) { mb[j][w] = v; }
+
+	const void* mb_addr(uint32_t j) { return mb[j]; }
+
+	// 受信 ID、マスク（標準 ID フレームは SID だけ比較）
+	bool match_(const uint32_t* f, uint32_t id, uint32_t mask)
+	{
+		if(((f[0] ^ id) & 0xc0000000) != 0) return false;
+		uint32_t cm = (f[0] >> 31) ? 0x1fffffff : 0x1ffc0000;
+		return ((f[0] ^ id) & mask & cm) == 0;
+	}
+
+	void store_(uint32_t j, const uint32_t* f)
+	{
+		for(uint32_t w = 0; w < 4; ++w) store_frm[w] = f[w];
+		store_mb = j;
+		finish_store_();
+	}
+
+	// フレームを受ける、受けたメールボックス（FIFO は 28、無ければ -1）を返す
+	int32_t receive(const device::can_frame& src)
+	{
+		if(st != ST::OPER) { ++dropped; return -1; }
+		uint32_t f[4];
+		for(uint32_t w = 0; w < 4; ++w) f[w] = src[w];
+		f[3] = (f[3] & 0xffff0000) | ts;
+		++ts;
+		bool fm = regs[CTLR] & 1;
+		uint32_t n = fm ? 24 : 32;
+		for(uint32_t j = 0; j < n; ++j) {
+			if((mctl[j] & 0xc0) != 0x40) continue;
+			auto m = ((regs[MKIVLR] >> j) & 1) ? 0xffffffff : mkr[j / 4];
+			if(!match_(f, mb[j][0], m)) continue;
+			store_(j, f);
+			return j;
+		}
+		if(fm && (regs[RFCR] & 1) != 0) {
+			if(match_(f, regs[FIDCR0], mkr[6]) || match_(f, regs[FIDCR1], mkr[7])) {
+				if(fifo_num >= 4) {
+					regs[RFCR] |= 0x10;
+				} else {
+					for(uint32_t w = 0; w < 4; ++w) fifo[fifo_num][w] = f[w];
+					++fifo_num;
+					for(uint32_t w = 0; w < 4; ++w) mb[28][w] = fifo[0][w];
+				}
+				if((regs[MIER] >> 28) & 1) rxf_pend = true;
+				return 28;
+			}
+		}
+		++dropped;
+		return -1;
+	}
+
+	// 格納を始める（INVALDATA）、MCTL[j] を left 回読んだら終わる
+	void begin_store(uint32_t j, const device::can_frame& src, uint32_t left)
+	{
+		store_frm[0] = src[0];
+		store_frm[1] = src[1];
+		store_frm[2] = src[2];
+		store_frm[3] = (src[3] & 0xffff0000) | ts;
+		++ts;
+		mb[j][0] = store_frm[0];
+		mb[j][1] = store_frm[1];
+		mctl[j] |= 2;
+		store_mb = j;
+		store_left = left;
+	}
+
+	// 保留中の割り込みを処理
+	void run()
+	{
+		while(rxm_pend || rxf_pend || txm_pend) {
+			if(rxm_pend) {
+				rxm_pend = false;
+				auto t = vec_task[static_cast<uint8_t>(device::ICU::VECTOR::RXM0)];
+				if(t != nullptr) (*t)();
+			}
+			if(rxf_pend) {
+				rxf_pend = false;
+				auto t = vec_task[static_cast<uint8_t>(device::ICU::VECTOR::RXF0)];
+				if(t != nullptr) (*t)();
+			}
+			if(txm_pend) {
+				txm_pend = false;
+				auto t = vec_task[static_cast<uint8_t>(device::ICU::VECTOR::TXM0)];
+				if(t != nullptr) (*t)();
+			}
+		}
+	}
+}
+
+namespace {
+
+	typedef utils::fixed_fifo<device::can_frame, 64> RBF;
+	typedef utils::fixed_fifo<device::can_frame, 64> TBF;
+	typedef device::can_io<device::CAN0, RBF, TBF> CAN;
+	typedef device::can_io_def::filter_t FILT;
+	typedef device::can_io_def::MODE MODE;
+	typedef device::can_io_def::SPEED SPEED;
+
+	CAN can_;
+
+	struct hit_t {
+		uint32_t			rule;
+		device::can_frame	frm;
+	};
+	std::vector<hit_t> hits_;
+
+	template <uint32_t N>
+	void cb_(const device::can_frame& frm) { hits_.push_back(hit_t{ N, frm }); }
+
+	template <uint32_t... N>
+	constexpr auto table_(std::integer_sequence<uint32_t, N...>)
+	{
+		return std::array<device::can_io_def::recv_task_type, sizeof...(N)>{ cb_<N>... };
+	}
+	const auto cbs_ = table_(std::make_integer_sequence<uint32_t, 16>{});
+
+	device::can_frame frame_(uint32_t id, bool ide, bool rtr, uint32_t seq)
+	{
+		device::can_frame f;
+		f.set_id(id);
+		f.set_IDE(ide);
+		f.set_RTR(rtr);
+		f.set_DLC(8);
+		for(uint32_t i = 0; i < 4; ++i) {
+			f.set_DATA(i, seq >> (i * 8));
+			f.set_DATA(i + 4, ~seq >> (i * 8));
+		}
+		return f;
+	}
+
+	uint32_t seq_(const device::can_frame& f)
+	{
+		uint32_t s = 0;
+		for(uint32_t i = 0; i < 4; ++i) s |= static_cast<uint32_t>(f.get_DATA(i)) << (i * 8);
+		return s;
+	}
+
+	// タイム・スタンプ以外が一致
+	bool same_(const device::can_frame& a, const device::can_frame& b)
+	{
+		return a[0] == b[0] && a[1] == b[1] && a[2] == b[2] && (a[3] >> 16) == (b[3] >> 16);
+	}
+
+	bool regs_match_plan_()
+	{
+		const auto& p = can_.get_filter_plan();
+		for(uint32_t k = 0; k < 8; ++k) {
+			if(p.fifo && k >= 6) continue;
+			if(((p.rx_mbs >> (k * 4)) & 0xf) == 0) continue;
+			if(sim::mkr[k] != p.mkr[k]) return false;
+		}
+		if(sim::regs[sim::MKIVLR] != p.mkivlr) return false;
+		if((sim::regs[sim::CTLR] & 1) != p.fifo) return false;
+		for(uint32_t j = 0; j < 32; ++j) {
+			if(((p.rx_mbs >> j) & 1) == 0) continue;
+			if(sim::mb[j][0] != p.mb_id[j]) return false;
+			if((sim::mctl[j] & 0x40) == 0) return false;
+		}
+		return true;
+	}
+
+	uint32_t first_mb_()
+	{
+		return __builtin_ctz(can_.get_filter_plan().rx_mbs);
+	}
+
+	void restart_()
+	{
+		can_.destroy();
+		sim::reset();
+		hits_.clear();
+		CHECK(can_.start(SPEED::_500K));
+		CHECK(can_.get_mode() == MODE::OPERATION);
+		CHECK(sim::st == sim::ST::OPER);
+		can_.clear_stat();
+	}
+
+
+	// Halt、スリープ・モードでは set_filter は失敗し、何も変えない
+	void test_mode_filter_()
+	{
+		restart_();
+		const FILT r0[] = {
+			FILT(0x100, 0x7f0, cbs_[0]),
+			FILT(0x200, device::can_filter::SID_MASK, cbs_[1]),
+		};
+		CHECK(can_.set_filter(r0, 2));
+		CHECK(can_.get_mode() == MODE::OPERATION);
+		CHECK(regs_match_plan_());
+		const auto org = can_.get_filter_plan();
+
+		const FILT r1[] = {
+			FILT(0x300, 0x700, cbs_[2], false, false, true),
+			FILT(0x12345, device::can_filter::EXT_MASK, cbs_[3], true),
+		};
+		CHECK(can_.set_mode(MODE::HALT));
+		CHECK(sim::st == sim::ST::HALT);
+		CHECK(!can_.set_filter(r1, 2));
+		CHECK(can_.get_mode() == MODE::HALT);
+		CHECK(sim::st == sim::ST::HALT);
+		CHECK(can_.get_filter_plan().rx_mbs == org.rx_mbs);
+		CHECK(can_.get_filter_plan().fifo == org.fifo);
+		CHECK(regs_match_plan_());
+
+		CHECK(can_.start(SPEED::_500K));
+		CHECK(can_.set_mode(MODE::RESET));
+		CHECK(can_.set_mode(MODE::SLEEP));
+		CHECK(sim::st == sim::ST::SLEEP);
+		CHECK(!can_.set_filter(r1, 2));
+		CHECK(can_.get_mode() == MODE::SLEEP);
+		CHECK(can_.get_filter_plan().rx_mbs == org.rx_mbs);
+		CHECK(regs_match_plan_());
+
+		// オペレーション・モードに戻れば、設定出来る
+		CHECK(can_.start(SPEED::_500K));
+		CHECK(can_.set_filter(r1, 2));
+		CHECK(can_.get_filter_plan().fifo);
+		CHECK(regs_match_plan_());
+		CHECK(sim::st == sim::ST::OPER);
+		hits_.clear();
+		sim::receive(frame_(0x345, false, false, 1));
+		sim::receive(frame_(0x12345, true, false, 2));
+		sim::run();
+		CHECK_EQ(hits_.size(), 2u);
+		uint32_t got = 0;
+		for(const auto& h : hits_) got |= 1u << h.rule;
+		CHECK_EQ(got, 0b1100u);
+		CHECK_EQ(sim::bad, 0u);
+	}
+
+
+	// ランダムなフレームで、呼ばれたコールバックが一致したルールと同じ
+	void test_dispatch_()
+	{
+		restart_();
+		static const uint32_t N = 14;
+		std::mt19937 rnd(1);
+		FILT r[N];
+		for(uint32_t i = 0; i < N; ++i) {
+			bool ide = (i % 3) == 2;
+			auto full = ide ? device::can_filter::EXT_MASK : device::can_filter::SID_MASK;
+			uint32_t mask = full;
+			if(i < 10) mask = full & ~((1u << (i % 5 + 1)) - 1) & ~(1u << (i + 1));  // マスクはほぼ全部違う
+			r[i] = FILT(rnd() & full, mask, cbs_[i], ide, (i % 4) == 3, i >= 12);
+		}
+		CHECK(can_.set_filter(r, N));
+		CHECK(regs_match_plan_());
+		const auto& p = can_.get_filter_plan();
+		CHECK(p.merge > 0);
+		CHECK(p.fifo);
+
+		uint32_t bad_set = 0;
+		uint32_t bad_frm = 0;
+		uint32_t matched = 0;
+		for(uint32_t n = 0; n < 20000; ++n) {
+			const auto& b = r[rnd() % N];
+			bool ide = (rnd() & 7) == 0 ? !b.ide : b.ide;
+			bool rtr = (rnd() & 7) == 0 ? !b.rtr : b.rtr;
+			auto full = ide ? device::can_filter::EXT_MASK : device::can_filter::SID_MASK;
+			uint32_t id = (b.id ^ (1u << (rnd() % 11)) ^ ((rnd() & 1) ? 0 : (1u << (rnd() % 29)))) & full;
+			auto f = frame_(id, ide, rtr, n);
+			uint32_t expect = 0;
+			for(uint32_t i = 0; i < N; ++i) {
+				device::can_filter::rule_t rl(r[i].id, r[i].mask, r[i].ide, r[i].rtr);
+				if(device::can_filter::match(rl, id, ide, rtr)) expect |= 1u << i;
+			}
+			hits_.clear();
+			sim::receive(f);
+			sim::run();
+			uint32_t got = 0;
+			for(const auto& h : hits_) {
+				got |= 1u << h.rule;
+				if(!same_(h.frm, f)) ++bad_frm;
+			}
+			if(got != expect) ++bad_set;
+			if(expect != 0) ++matched;
+		}
+		CHECK_EQ(bad_set, 0u);
+		CHECK_EQ(bad_frm, 0u);
+		CHECK(matched > 3000);
+		CHECK_EQ(can_.get_stat().lost, 0u);
+		CHECK_EQ(can_.get_stat().buffer, 0u);
+		std::printf("dispatch: rules %u, merge %u, matched %u, reject %u, dropped by filter %u\n",
+			N, p.merge, matched, can_.get_stat().reject, sim::dropped);
+	}
+
+
+	uint32_t mb_ = 0;
+	uint32_t unstable_ = 0;
+
+	void stable_cb_(const device::can_frame& frm)
+	{
+		hits_.push_back(hit_t{ 0, frm });
+		if(hits_.size() > 1) return;
+		// コールバック中に次のフレームが同じメールボックスに来ても、frm は変わらない
+		auto copy = frm;
+		sim::receive(frame_(0x123, false, false, 2));
+		if(!same_(copy, frm)) ++unstable_;
+	}
+
+	void arrive_() { sim::receive(frame_(0x123, false, false, 2)); }
+
+	void arrive_slow_() { sim::begin_store(mb_, frame_(0x123, false, false, 2), 4); }
+
+	// 読み出し中の上書き（NEWDATA、INVALDATA）と、コールバック中のフレーム
+	void test_overwrite_()
+	{
+		restart_();
+		const FILT r[] = { FILT(0x123, device::can_filter::SID_MASK, stable_cb_) };
+		CHECK(can_.set_filter(r, 1));
+		mb_ = first_mb_();
+
+		// コールバック中に次のフレーム
+		unstable_ = 0;
+		CHECK_EQ(sim::receive(frame_(0x123, false, false, 1)), static_cast<int32_t>(mb_));
+		sim::run();
+		CHECK_EQ(unstable_, 0u);
+		CHECK_EQ(hits_.size(), 2u);
+		if(hits_.size() == 2) {
+			CHECK_EQ(seq_(hits_[0].frm), 1u);
+			CHECK_EQ(seq_(hits_[1].frm), 2u);
+		}
+		CHECK_EQ(can_.get_stat().lost, 0u);
+
+		// コピー中に次のフレーム（NEWDATA）：コピーした分は捨てて読み直す
+		const FILT r2[] = { FILT(0x123, device::can_filter::SID_MASK, cbs_[0]) };
+		CHECK(can_.set_filter(r2, 1));
+		mb_ = first_mb_();
+		hits_.clear();
+		can_.clear_stat();
+		sim::hook_mb = mb_;
+		sim::hook_word = 1;
+		sim::hook = arrive_;
+		sim::receive(frame_(0x123, false, false, 1));
+		sim::run();
+		CHECK_EQ(sim::hook_fired, 1u);
+		CHECK_EQ(hits_.size(), 1u);
+		if(hits_.size() == 1) {
+			CHECK(same_(hits_[0].frm, frame_(0x123, false, false, 2)));
+		}
+		CHECK_EQ(can_.get_stat().lost, 1u);
+
+		// コピー中に格納が始まる（INVALDATA）
+		hits_.clear();
+		can_.clear_stat();
+		sim::hook_fired = 0;
+		sim::hook_word = 2;
+		sim::hook = arrive_slow_;
+		sim::receive(frame_(0x123, false, false, 1));
+		sim::run();
+		CHECK_EQ(sim::hook_fired, 1u);
+		CHECK_EQ(hits_.size(), 1u);
+		if(hits_.size() == 1) {
+			CHECK(same_(hits_[0].frm, frame_(0x123, false, false, 2)));
+		}
+		CHECK_EQ(can_.get_stat().lost, 1u);
+		CHECK(sim::store_mb < 0);
+
+		// 割り込みの前に２つ（MSGLOST）
+		hits_.clear();
+		can_.clear_stat();
+		sim::receive(frame_(0x123, false, false, 1));
+		sim::receive(frame_(0x123, false, false, 2));
+		sim::run();
+		CHECK_EQ(hits_.size(), 1u);
+		if(hits_.size() == 1) {
+			CHECK_EQ(seq_(hits_[0].frm), 2u);
+		}
+		CHECK_EQ(can_.get_stat().lost, 1u);
+		CHECK_EQ(can_.get_stat().recv, 1u);
+	}
+
+
+	uint32_t count_ = 0;
+	void count_cb_(const device::can_frame& frm) { count_ += frm.get_DLC(); }
+
+	void test_bench_()
+	{
+		restart_();
+		FILT r[8];
+		for(uint32_t i = 0; i < 8; ++i) {
+			r[i] = FILT(0x100 + i * 0x10, (i & 1) ? 0x7f0 : 0x7ff, count_cb_, false, false, i == 7);
+		}
+		CHECK(can_.set_filter(r, 8));
+		static const uint32_t N = 2'000'000;
+		count_ = 0;
+		test::stopwatch sw;
+		for(uint32_t n = 0; n < N; ++n) {
+			uint32_t id = 0x100 + (n & 7) * 0x10 + ((n & 1) ? ((n >> 3) & 0xf) : 0);
+			sim::receive(frame_(id, false, false, n));
+			sim::run();
+		}
+		auto t = sw.sec();
+		CHECK_EQ(count_, N * 8);
+		CHECK_EQ(can_.get_stat().lost, 0u);
+		std::printf("bench: receive ISR (model) %.2f Mframes/s, %.0f ns/frame\n",
+			N / t * 1e-6, t / N * 1e9);
+	}
+}
+
+
+int main(int argc, char* argv[])
+{
+	test_mode_filter_();
+	test_dispatch_();
+	test_overwrite_();
+	test_bench_();
+
+	can_.destroy();
+
+	return test::result("can_io");
+}
@@ -0,0 +1,575 @@
+//=====================================================================//
+/*!	@file
+	@brief	code_conv、UTF-8/UTF-16/CP932 (Shift-JIS) 変換のテスト @n
+			CP932 の直接参照テーブルを、FatFs の ff_oem2uni／ff_uni2oem と @n
+			全 65536 コードで比べる。UTF-8 の検証、不正なシーケンスの置き換え、@n
+			１文字ずつ変換する参照との一致、ソースと変換先を小さく区切った @n
+			ストリーム（チャンク）変換と一括変換の一致（４方向）を確かめる。@n
+			ASCII 主体、日本語主体のテキストの変換速度（MB/s）を「bench:」行で表示する
+    @author 平松邦仁 (hira@rvf-rc45.net)
+	@copyright	Copyright (C) 2021 Kunihito Hiramatsu @n
+				Released under the MIT license @n
+				https://github.com/hirakuni45/RX/blob/master/LICENSE
+*/
+//=====================================================================//
+#include <string>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include "test.hpp"
+#include "ff14/source/ff.h"
+#include "common/code_conv.hpp"
+
+namespace {
+
+	typedef utils::code_conv CONV;
+	typedef std::vector<char> U8;
+	typedef std::vector<uint16_t> U16;
+	typedef std::vector<uint32_t> CPS;
+
+	static const WORD CP = 932;
+
+	// Unicode と往復する CP932 の２バイト・コード（Unicode で持つ）
+	std::vector<uint16_t> dbcs_;
+
+
+	void put_utf8_(U8& s, uint32_t c)
+	{
+		if(c < 0x80) {
+			s.push_back(c);
+		} else if(c < 0x800) {
+			s.push_back(0xc0 | (c >> 6));
+			s.push_back(0x80 | (c & 0x3f));
+		} else if(c < 0x10000) {
+			s.push_back(0xe0 | (c >> 12));
+			s.push_back(0x80 | ((c >> 6) & 0x3f));
+			s.push_back(0x80 | (c & 0x3f));
+		} else {
+			s.push_back(0xf0 | (c >> 18));
+			s.push_back(0x80 | ((c >> 12) & 0x3f));
+			s.push_back(0x80 | ((c >> 6) & 0x3f));
+			s.push_back(0x80 | (c & 0x3f));
+		}
+	}
+
+
+	bool lead_(uint8_t c) { return (0x81 <= c && c <= 0x9f) || (0xe0 <= c && c <= 0xfc); }
+
+
+	//-----------------------------------------------------------------//
+	// 参照の変換（正しい入力だけ、１文字ずつ、CP932 は ff_oem2uni／ff_uni2oem）
+	//-----------------------------------------------------------------//
+	U16 ref_utf8_to_utf16_(const U8& s)
+	{
+		U16 d;
+		d.reserve(s.size());
+		size_t i = 0;
+		while(i < s.size()) {
+			uint8_t c = s[i++];
+			uint32_t code = c;
+			if(c >= 0x80) {
+				int n = c >= 0xf0 ? 3 : (c >= 0xe0 ? 2 : 1);
+				code = c & (0x3f >> n);
+				while(n-- > 0) code = (code << 6) | (s[i++] & 0x3f);
+			}
+			if(code < 0x10000) {
+				d.push_back(code);
+			} else {
+				code -= 0x10000;
+				d.push_back(0xd800 | (code >> 10));
+				d.push_back(0xdc00 | (code & 0x3ff));
+			}
+		}
+		return d;
+	}
+
+
+	U8 ref_utf16_to_utf8_(const U16& s)
+	{
+		U8 d;
+		d.reserve(s.size() * 3);
+		for(size_t i = 0; i < s.size(); ++i) {
+			uint32_t c = s[i];
+			if(0xd800 <= c && c <= 0xdbff) {
+				c = 0x10000 + ((c - 0xd800) << 10) + (s[++i] - 0xdc00);
+			}
+			put_utf8_(d, c);
+		}
+		return d;
+	}
+
+
+	U8 ref_sjis_to_utf8_(const U8& s)
+	{
+		U8 d;
+		d.reserve(s.size() * 2);
+		for(size_t i = 0; i < s.size(); ++i) {
+			uint8_t c = s[i];
+			WCHAR oem = c;
+			if(lead_(c) && (i + 1) < s.size()) {
+				oem = (c << 8) | static_cast<uint8_t>(s[++i]);
+			}
+			auto u = ff_oem2uni(oem, CP);
+			put_utf8_(d, u != 0 || oem == 0 ? u : CONV::REPLACE);
+		}
+		return d;
+	}
+
+
+	U8 ref_utf8_to_sjis_(const U8& s)
+	{
+		auto u16 = ref_utf8_to_utf16_(s);
+		U8 d;
+		d.reserve(s.size());
+		for(size_t i = 0; i < u16.size(); ++i) {
+			uint16_t c = u16[i];
+			WCHAR oem = 0;
+			if(0xd800 <= c && c <= 0xdbff) {
+				++i;
+			} else {
+				oem = ff_uni2oem(c, CP);
+			}
+			if(oem == 0 && c != 0) {
+				d.push_back(CONV::REPLACE_SJIS);
+			} else if(oem < 0x100) {
+				d.push_back(oem);
+			} else {
+				d.push_back(oem >> 8);
+				d.push_back(oem & 0xff);
+			}
+		}
+		return d;
+	}
+
+
+	//-----------------------------------------------------------------//
+	// テキストの生成
+	//-----------------------------------------------------------------//
+	void make_dbcs_()
+	{
+		for(uint32_t hi = 0x81; hi <= 0xfc; ++hi) {
+			if(!lead_(hi)) continue;
+			for(uint32_t lo = 0x40; lo <= 0xfc; ++lo) {
+				WCHAR oem = (hi << 8) | lo;
+				auto u = ff_oem2uni(oem, CP);
+				if(u != 0 && ff_uni2oem(u, CP) == oem) dbcs_.push_back(u);
+			}
+		}
+	}
+
+
+	// jp の割合で CP932 の２バイト文字、残りは ASCII（改行を含む）と半角カナ
+	CPS make_cps_(std::mt19937& rnd, uint32_t n, double jp)
+	{
+		std::uniform_real_distribution<double> ur(0.0, 1.0);
+		CPS cps;
+		cps.reserve(n);
+		for(uint32_t i = 0; i < n; ++i) {
+			double r = ur(rnd);
+			if(r < jp) {
+				cps.push_back(dbcs_[rnd() % dbcs_.size()]);
+			} else if(r < (jp + 0.01)) {
+				cps.push_back(0xff61 + rnd() % 63);
+			} else if((rnd() % 40) == 0) {
+				cps.push_back('\n');
+			} else {
+				cps.push_back(0x20 + rnd() % 95);
+			}
+		}
+		return cps;
+	}
+
+
+	struct text_t {
+		U8		u8;
+		U16		u16;
+		U8		sj;
+		uint32_t	unmap;	///< CP932 に無い文字数
+	};
+
+
+	text_t make_text_(const CPS& cps)
+	{
+		text_t t;
+		t.unmap = 0;
+		for(auto c : cps) {
+			put_utf8_(t.u8, c);
+			WCHAR oem = c < 0x10000 ? ff_uni2oem(c, CP) : 0;
+			if(oem == 0 && c != 0) {
+				t.sj.push_back(CONV::REPLACE_SJIS);
+				++t.unmap;
+			} else if(oem < 0x100) {
+				t.sj.push_back(oem);
+			} else {
+				t.sj.push_back(oem >> 8);
+				t.sj.push_back(oem & 0xff);
+			}
+		}
+		t.u16 = ref_utf8_to_utf16_(t.u8);
+		return t;
+	}
+
+
+	U8 u8_(const char* s) { return U8(s, s + std::strlen(s)); }
+
+
+	//-----------------------------------------------------------------//
+	// 一括変換と、ソースを cs、変換先を dcap 単位で区切った変換
+	//-----------------------------------------------------------------//
+	template <typename D, typename S, class FUNC>
+	std::vector<D> oneshot_(FUNC f, const std::vector<S>& src, uint32_t& error)
+	{
+		std::vector<D> out(src.size() * 4 + 16);
+		CONV::state_t st;
+		auto r = f(src.data(), src.size(), out.data(), out.size(), st, true);
+		CHECK_EQ(r.src, src.size());
+		CHECK(st.empty());
+		out.resize(r.dst);
+		error = r.error;
+		return out;
+	}
+
+
+	template <typename D, typename S, class FUNC>
+	bool chunked_(FUNC f, const std::vector<S>& src, uint32_t cs, uint32_t dcap,
+		std::vector<D>& out, uint32_t& error)
+	{
+		out.clear();
+		error = 0;
+		std::vector<D> tmp(dcap);
+		CONV::state_t st;
+		uint32_t pos = 0;
+		while(1) {
+			uint32_t n = std::min<uint32_t>(cs, src.size() - pos);
+			bool last = (pos + n) == src.size();
+			auto r = f(src.data() + pos, n, tmp.data(), dcap, st, last);
+			if(r.src > n || r.dst > dcap) return false;
+			out.insert(out.end(), tmp.begin(), tmp.begin() + r.dst);
+			error += r.error;
+			pos += r.src;
+			if(pos == src.size() && st.empty()) break;
+			if(r.src == 0 && r.dst == 0) return false;  // 進まない
+		}
+		return true;
+	}
+
+
+	// 区切り方を全て試して、一括変換と比べる（不一致の数を返す）
+	template <typename D, typename S, class FUNC>
+	uint32_t compare_chunks_(FUNC f, const std::vector<S>& src, uint32_t dmin)
+	{
+		uint32_t error;
+		auto ref = oneshot_<D>(f, src, error);
+		uint32_t bad = 0;
+		std::vector<D> out;
+		for(uint32_t cs = 1; cs <= 19; ++cs) {
+			for(uint32_t dcap = dmin; dcap <= 10; ++dcap) {
+				uint32_t e;
+				if(!chunked_(f, src, cs, dcap, out, e) || out != ref || e != error) {
+					if(bad == 0) {
+						std::fprintf(stderr, "chunk %u, dst %u: %zu/%zu units, %u/%u errors\n",
+							cs, dcap, out.size(), ref.size(), e, error);
+					}
+					++bad;
+				}
+			}
+		}
+		return bad;
+	}
+
+
+	//-----------------------------------------------------------------//
+	// CP932 テーブル（全 65536 コード）
+	//-----------------------------------------------------------------//
+	void test_table_()
+	{
+		uint32_t bad_oem = 0;
+		uint32_t bad_uni = 0;
+		uint32_t oem_n = 0;
+		uint32_t uni_n = 0;
+		for(uint32_t c = 0; c < 0x10000; ++c) {
+			auto u = CONV::sjis_to_utf16(c);
+			auto fu = ff_oem2uni(c, CP);
+			if(u != fu) {
+				if(bad_oem < 4) std::fprintf(stderr, "sjis_to_utf16(%04X): %04X, ff %04X\n", c, u, fu);
+				++bad_oem;
+			}
+			if(u != 0) ++oem_n;
+			auto s = CONV::utf16_to_sjis(c);
+			auto fs = ff_uni2oem(c, CP);
+			if(s != fs) {
+				if(bad_uni < 4) std::fprintf(stderr, "utf16_to_sjis(%04X): %04X, ff %04X\n", c, s, fs);
+				++bad_uni;
+			}
+			if(s != 0) ++uni_n;
+		}
+		CHECK_EQ(bad_oem, 0u);
+		CHECK_EQ(bad_uni, 0u);
+		// ASCII（０を除く）、半角カナ、２バイト・コード
+		CHECK(oem_n > (127 + 63 + 7000));
+		CHECK(uni_n > (127 + 63 + 7000));
+		CHECK(dbcs_.size() > 7000);
+		std::printf("cp932: %u SJIS codes, %u Unicode codes, %zu double byte round trips\n",
+			oem_n, uni_n, dbcs_.size());
+	}
+
+
+	//-----------------------------------------------------------------//
+	// UTF-8 の検証
+	//-----------------------------------------------------------------//
+	void test_validate_()
+	{
+		static const struct {
+			const char*	src;
+			bool		ok;
+			uint32_t	pos;
+		} tbl[] = {
+			{ "", true, 0 },
+			{ "abc", true, 0 },
+			{ "\xE3\x81\x82\xE3\x81\x84", true, 0 },	// あい
+			{ "\xC2\x80\xDF\xBF", true, 0 },			// U+0080, U+07FF
+			{ "\xEF\xBF\xBF", true, 0 },				// U+FFFF
+			{ "\xF0\x9F\x98\x80", true, 0 },			// U+1F600
+			{ "\xF4\x8F\xBF\xBF", true, 0 },			// U+10FFFF
+			{ "ab\x80", false, 2 },					// 単独の後続バイト
+			{ "abc\xC0\x80", false, 3 },				// 冗長表現（２バイト）
+			{ "a\xC1\xBF", false, 1 },
+			{ "x\xE0\x80\x80", false, 1 },				// 冗長表現（３バイト）
+			{ "x\xE0\x9F\xBF", false, 1 },
+			{ "\xED\xA0\x80", false, 0 },				// サロゲート
+			{ "\xE3\x81\x82\xED\xBF\xBF", false, 3 },
+			{ "\xF0\x8F\xBF\xBF", false, 0 },			// 冗長表現（４バイト）
+			{ "\xF4\x90\x80\x80", false, 0 },			// U+10FFFF を超える
+			{ "\xF5\x80\x80\x80", false, 0 },
+			{ "\xFF", false, 0 },
+			{ "ab\xE3\x81", false, 2 },				// 途中で終わる
+			{ "ab\xE3\x81z", false, 2 },				// 途中で途切れる
+			{ "\xC3", false, 0 },
+			// ワード、１６バイト単位の走査の後
+			{ "0123456789abcdef0123456789abcdef01234\x80", false, 37 },
+			{ "0123456789abcdef\xE3\x81\x82\xE3\x81\x82\xE3\x81\x82\xE3\x81", false, 25 },
+		};
+		for(const auto& t : tbl) {
+			uint32_t pos = 0xffff;
+			bool ok = CONV::validate_utf8(t.src, std::strlen(t.src), &pos);
+			if(!CHECK_EQ(ok, t.ok)) {
+				std::fprintf(stderr, "  validate_utf8(\"%s\")\n", t.src);
+			} else if(!ok && !CHECK_EQ(pos, t.pos)) {
+				std::fprintf(stderr, "  validate_utf8(\"%s\"): pos %u\n", t.src, pos);
+			}
+		}
+		CHECK(CONV::validate_utf8("\xE3\x81\x82", 3));
+		CHECK(!CONV::validate_utf8("\xE3\x81\x82", 2));
+	}
+
+
+	//-----------------------------------------------------------------//
+	// 不正なシーケンスの置き換え
+	//-----------------------------------------------------------------//
+	void test_replace_()
+	{
+		uint32_t e;
+		// é（CP932 に無い）、あ、U+1F600、ｱ
+		auto src = u8_("A\xC3\xA9\xE3\x81\x82\xF0\x9F\x98\x80\xEF\xBD\xB1");
+		CHECK(oneshot_<uint16_t>(CONV::utf8_to_utf16, src, e) == U16({ 0x41, 0xe9, 0x3042, 0xd83d, 0xde00, 0xff71 }));
+		CHECK_EQ(e, 0u);
+		CHECK_EQ(ff_uni2oem(0xe9, CP), 0);
+		CHECK(oneshot_<char>(CONV::utf8_to_sjis, src, e) == u8_("A?\x82\xA0?\xB1"));
+		CHECK_EQ(e, 2u);
+
+		// 単独の後続バイト、途切れたシーケンス、途中で終わる
+		src = u8_("a\x80" "b\xE3\x81" "A\xE3\x81");
+		CHECK(oneshot_<uint16_t>(CONV::utf8_to_utf16, src, e) == U16({ 0x61, 0xfffd, 0x62, 0xfffd, 0x41, 0xfffd }));
+		CHECK_EQ(e, 3u);
+		CHECK(oneshot_<char>(CONV::utf8_to_sjis, src, e) == u8_("a?b?A?"));
+		CHECK_EQ(e, 3u);
+
+		// 正しいペア、単独の下位、単独の上位（次の文字は残す）、最後の上位
+		U16 u16 = { 0x41, 0xd83d, 0xde00, 0xdc00, 0xd800, 0x42, 0xd800 };
+		CHECK(oneshot_<char>(CONV::utf16_to_utf8, u16, e) ==
+			u8_("A\xF0\x9F\x98\x80\xEF\xBF\xBD\xEF\xBF\xBD" "B\xEF\xBF\xBD"));
+		CHECK_EQ(e, 3u);
+
+		// あ、ｱ、範囲外の後続バイト（次の文字は残す）、範囲内でも無いコード（２バイトで１文字）、最後の先行バイト
+		auto sj = u8_("\x82\xA0\xB1\x82 \x85\x40" "A\x81");
+		CHECK_EQ(ff_oem2uni(0x8540, CP), 0);
+		CHECK(oneshot_<char>(CONV::sjis_to_utf8, sj, e) ==
+			u8_("\xE3\x81\x82\xEF\xBD\xB1\xEF\xBF\xBD \xEF\xBF\xBD" "A\xEF\xBF\xBD"));
+		CHECK_EQ(e, 3u);
+
+		// 変換先が足りない場合は止める（上位サロゲートは state_t に残り、続きで変換）
+		CONV::state_t st;
+		char tmp[8];
+		auto r = CONV::utf16_to_utf8(u16.data(), u16.size(), tmp, 4, st);
+		CHECK_EQ(r.src, 2u);
+		CHECK_EQ(r.dst, 1u);
+		CHECK_EQ(st.hold, 0xd83d);
+		r = CONV::utf16_to_utf8(u16.data() + 2, 1, tmp + 1, 4, st, false);
+		CHECK_EQ(r.src, 1u);
+		CHECK(std::memcmp(tmp, "A\xF0\x9F\x98\x80", 5) == 0);
+		CHECK(st.empty());
+		uint16_t w[2];
+		src = u8_("\xF0\x9F\x98\x80");
+		r = CONV::utf8_to_utf16(src.data(), src.size(), w, 1, st);
+		CHECK_EQ(r.dst, 0u);
+		CHECK(r.src < src.size());
+	}
+
+
+	//-----------------------------------------------------------------//
+	// １文字ずつの参照との一致
+	//-----------------------------------------------------------------//
+	void test_convert_(const text_t& t, const char* name)
+	{
+		uint32_t e;
+		bool a = oneshot_<uint16_t>(CONV::utf8_to_utf16, t.u8, e) == t.u16;
+		CHECK(a && e == 0);
+		bool b = oneshot_<char>(CONV::utf16_to_utf8, t.u16, e) == t.u8;
+		CHECK(b && e == 0);
+		bool c = oneshot_<char>(CONV::utf8_to_sjis, t.u8, e) == t.sj;
+		CHECK(c && e == t.unmap);
+		bool d = oneshot_<char>(CONV::sjis_to_utf8, t.sj, e) == ref_sjis_to_utf8_(t.sj);
+		CHECK(d);
+		CHECK(ref_utf8_to_sjis_(t.u8) == t.sj);
+		CHECK(ref_utf16_to_utf8_(t.u16) == t.u8);
+		CHECK(CONV::validate_utf8(t.u8.data(), t.u8.size()));
+		if(!(a && b && c && d)) std::fprintf(stderr, "  %s\n", name);
+	}
+
+
+	//-----------------------------------------------------------------//
+	// ストリーム（チャンク）変換
+	//-----------------------------------------------------------------//
+	void test_chunk_(std::mt19937& rnd)
+	{
+		auto cps = make_cps_(rnd, 300, 0.4);
+		// CP932 に無い文字、４バイト・シーケンス
+		for(uint32_t i = 0; i < 8; ++i) {
+			cps[rnd() % cps.size()] = 0xe9;
+			cps[rnd() % cps.size()] = 0x1f600 + i;
+		}
+		auto t = make_text_(cps);
+		test_convert_(t, "mixed");
+
+		// 壊したコピー、途中で終わるコピー
+		std::vector<U8> u8s = { t.u8 };
+		std::vector<U16> u16s = { t.u16 };
+		std::vector<U8> sjs = { t.sj };
+		auto u8 = t.u8;
+		auto u16 = t.u16;
+		auto sj = t.sj;
+		for(uint32_t i = 0; i < 24; ++i) {
+			u8[rnd() % u8.size()] = 0x80 + rnd() % 0x80;
+			u16[rnd() % u16.size()] = 0xd800 + rnd() % 0x800;
+			sj[rnd() % sj.size()] = 0x80 + rnd() % 0x80;
+		}
+		u8s.push_back(u8);
+		u16s.push_back(u16);
+		sjs.push_back(sj);
+		u8s.push_back(U8(t.u8.begin(), t.u8.end() - 1));
+		u16s.push_back(U16(t.u16.begin(), t.u16.end() - 1));
+		u16s.back().push_back(0xd801);
+		sjs.push_back(U8(t.sj.begin(), t.sj.end()));
+		sjs.back().push_back(0x88);
+		// 乱数
+		U8 rb(400);
+		U16 rw(400);
+		for(auto& c : rb) c = rnd();
+		for(auto& c : rw) c = (rnd() & 1) ? 0xd800 + rnd() % 0x800 : rnd();
+		u8s.push_back(rb);
+		u16s.push_back(rw);
+		sjs.push_back(rb);
+
+		uint32_t bad[4] = { 0 };
+		for(const auto& s : u8s) {
+			bad[0] += compare_chunks_<uint16_t>(CONV::utf8_to_utf16, s, 2);
+			bad[1] += compare_chunks_<char>(CONV::utf8_to_sjis, s, 2);
+		}
+		for(const auto& s : u16s) {
+			bad[2] += compare_chunks_<char>(CONV::utf16_to_utf8, s, 4);
+		}
+		for(const auto& s : sjs) {
+			bad[3] += compare_chunks_<char>(CONV::sjis_to_utf8, s, 4);
+		}
+		CHECK_EQ(bad[0], 0u);
+		CHECK_EQ(bad[1], 0u);
+		CHECK_EQ(bad[2], 0u);
+		CHECK_EQ(bad[3], 0u);
+	}
+
+
+	//-----------------------------------------------------------------//
+	// 速度（UTF-8 側のバイト数で MB/s）
+	//-----------------------------------------------------------------//
+	template <class FUNC>
+	double mbps_(FUNC f, size_t bytes)
+	{
+		uint32_t n = 0;
+		test::stopwatch sw;
+		double t;
+		do {
+			f();
+			++n;
+			t = sw.sec();
+		} while(t < 0.05) ;
+		return static_cast<double>(bytes) * n / t * 1e-6;
+	}
+
+
+	void bench_(const text_t& t, const char* name)
+	{
+		const auto bytes = t.u8.size();
+		U16 w(t.u8.size() + 16);
+		U8 b(t.u8.size() * 2 + 16);
+		uint32_t sum = 0;
+		auto conv = [&](auto f, const auto& src, auto& dst) {
+			CONV::state_t st;
+			auto r = f(src.data(), src.size(), dst.data(), dst.size(), st, true);
+			sum += r.dst;
+		};
+
+		double v[5];
+		double r[4];
+		v[0] = mbps_([&]() { conv(CONV::utf8_to_utf16, t.u8, w); }, bytes);
+		v[1] = mbps_([&]() { conv(CONV::utf16_to_utf8, t.u16, b); }, bytes);
+		v[2] = mbps_([&]() { conv(CONV::utf8_to_sjis, t.u8, b); }, bytes);
+		v[3] = mbps_([&]() { conv(CONV::sjis_to_utf8, t.sj, b); }, bytes);
+		v[4] = mbps_([&]() { sum += CONV::validate_utf8(t.u8.data(), t.u8.size()); }, bytes);
+		r[0] = mbps_([&]() { sum += ref_utf8_to_utf16_(t.u8).size(); }, bytes);
+		r[1] = mbps_([&]() { sum += ref_utf16_to_utf8_(t.u16).size(); }, bytes);
+		r[2] = mbps_([&]() { sum += ref_utf8_to_sjis_(t.u8).size(); }, bytes);
+		r[3] = mbps_([&]() { sum += ref_sjis_to_utf8_(t.sj).size(); }, bytes);
+		CHECK(sum > 0);
+
+		static const char* dir[4] = { "utf8->utf16", "utf16->utf8", "utf8->sjis", "sjis->utf8" };
+		for(uint32_t i = 0; i < 4; ++i) {
+			std::printf("bench: %s %zu KB, %-11s %7.0f MB/s (char by char, ff_*: %5.0f MB/s)\n",
+				name, bytes / 1024, dir[i], v[i], r[i]);
+		}
+		std::printf("bench: %s %zu KB, validate    %7.0f MB/s\n", name, bytes / 1024, v[4]);
+	}
+}
+
+
+int main(int argc, char* argv[])
+{
+	make_dbcs_();
+	std::mt19937 rnd(46);
+
+	test_table_();
+	test_validate_();
+	test_replace_();
+
+	// ASCII 主体（１．５％が日本語）、日本語主体（９２％）
+	auto ascii = make_text_(make_cps_(rnd, 128 * 1024 - 2048, 0.015));
+	auto jp = make_text_(make_cps_(rnd, 88 * 1024, 0.92));
+	test_convert_(ascii, "ascii");
+	test_convert_(jp, "japanese");
+
+	test_chunk_(rnd);
+
+	bench_(ascii, "ASCII-heavy");
+	bench_(jp, "Japanese-heavy");
+
+	return test::result("code_conv");
+}
@@ -0,0 +1,322 @@
+//=====================================================================//
+/*!	@file
+	@brief	disk_cache、セクター・キャッシュ・テスト @n
+			ランダムな読み書き、CTRL_SYNC を参照イメージと比べる。@n
+			FAT16 の RAM ディスク（FatFs）で、ファイル作成、ディレクトリー走査、@n
+			ログ追記、大きなファイルの読み書きを、キャッシュ有り／無しで実行して、@n
+			デバイスのコマンド数と SD での時間の見積もりを比べる。@n
+			キャッシュ無しで再マウントして、内容を検証する
+    @author 平松邦仁 (hira@rvf-rc45.net)
+	@copyright	Copyright (C) 2021 Kunihito Hiramatsu @n
+				Released under the MIT license @n
+				https://github.com/hirakuni45/RX/blob/master/LICENSE
+*/
+//=====================================================================//
+#include "FreeRTOS.h"
+#include <vector>
+#include <random>
+#include "test.hpp"
+#include "host_stub.hpp"
+#include "rtos_host.hpp"
+#define RAM_DISK_NO_DISKIO
+#include "ram_disk.hpp"
+#include "common/format.hpp"
+#include "ff14/disk_cache.hpp"
+
+namespace {
+
+	/// RAM ディスクのドライバー
+	struct ram_dev {
+		DSTATUS disk_status(BYTE) const { return 0; }
+		DSTATUS disk_initialize(BYTE) { return 0; }
+		DRESULT disk_read(BYTE, BYTE* buff, DWORD sector, UINT count) {
+			return test::disk().read(buff, sector, count);
+		}
+		DRESULT disk_write(BYTE, const BYTE* buff, DWORD sector, UINT count) {
+			return test::disk().write(buff, sector, count);
+		}
+		DRESULT disk_ioctl(BYTE, BYTE cmd, void* buff) { return test::disk().ioctl(cmd, buff); }
+	};
+
+	typedef fatfs::disk_cache<ram_dev, 8, 4, 16> CACHE;
+
+	ram_dev	dev_;
+	CACHE	cache_(dev_);
+	bool	use_cache_ = true;
+
+}
+
+extern "C" {
+
+	DSTATUS disk_initialize(BYTE drv) {
+		return use_cache_ ? cache_.disk_initialize(drv) : dev_.disk_initialize(drv);
+	}
+
+	DSTATUS disk_status(BYTE drv) {
+		return use_cache_ ? cache_.disk_status(drv) : dev_.disk_status(drv);
+	}
+
+	DRESULT disk_read(BYTE drv, BYTE* buff, LBA_t sector, UINT count) {
+		return use_cache_ ? cache_.disk_read(drv, buff, sector, count) : dev_.disk_read(drv, buff, sector, count);
+	}
+
+	DRESULT disk_write(BYTE drv, const BYTE* buff, LBA_t sector, UINT count) {
+		return use_cache_ ? cache_.disk_write(drv, buff, sector, count) : dev_.disk_write(drv, buff, sector, count);
+	}
+
+	DRESULT disk_ioctl(BYTE drv, BYTE cmd, void* buff) {
+		return use_cache_ ? cache_.disk_ioctl(drv, cmd, buff) : dev_.disk_ioctl(drv, cmd, buff);
+	}
+}
+
+namespace {
+
+	static const uint32_t SECTORS = 131072;
+	static const uint32_t FILES = 400;
+	static const uint32_t FSIZE = 3000;
+	static const uint32_t LOGS = 2000;
+	static const uint32_t BIG = 4 << 20;
+
+	FATFS	fs_;
+
+
+	uint8_t pat_(uint32_t file, uint32_t pos)
+	{
+		return (file * 131 + pos * 7 + (pos >> 9)) & 0xff;
+	}
+
+
+	/// ランダムな読み書きを参照と比べる
+	void test_coherence_()
+	{
+		static const uint32_t N = 256;
+		CHECK(test::disk().format(SECTORS, 16));
+		auto& img = test::disk().at_image();
+		std::vector<uint8_t> ref(N * 512);
+		for(uint32_t i = 0; i < (N * 512); ++i) ref[i] = img[i] = i * 13;
+		cache_.invalidate();
+		cache_.disk_initialize(0);
+		std::mt19937 rng(1);
+		std::vector<uint8_t> buf(32 * 512);
+		uint32_t bad = 0;
+		uint32_t err = 0;
+		uint32_t seq = 0;
+		for(uint32_t it = 0; it < 200000; ++it) {
+			uint32_t op = rng() % 10;
+			uint32_t cnt = (rng() % 4) == 0 ? (1 + rng() % 24) : 1;
+			uint32_t sec = ((rng() % 3) == 0 && it > 0) ? (rng() % 8) : (rng() % (N - cnt));
+			if((rng() % 5) == 0) {  // 連続した読み書き
+				sec = seq % (N - cnt);
+				seq = sec + cnt;
+			}
+			if(op < 6) {
+				if(cache_.disk_read(0, buf.data(), sec, cnt) != RES_OK) ++err;
+				if(std::memcmp(buf.data(), &ref[sec * 512], cnt * 512) != 0) ++bad;
+			} else if(op < 9) {
+				for(uint32_t i = 0; i < (cnt * 512); ++i) buf[i] = rng();
+				if(cache_.disk_write(0, buf.data(), sec, cnt) != RES_OK) ++err;
+				std::memcpy(&ref[sec * 512], buf.data(), cnt * 512);
+			} else if((rng() % 8) == 0) {
+				if(cache_.disk_ioctl(0, CTRL_SYNC, nullptr) != RES_OK) ++err;
+				if(std::memcmp(img.data(), ref.data(), N * 512) != 0) ++bad;
+			}
+		}
+		CHECK(cache_.sync(0) == RES_OK);
+		CHECK(std::memcmp(img.data(), ref.data(), N * 512) == 0);
+		CHECK_EQ(bad, 0u);
+		CHECK_EQ(err, 0u);
+		CHECK_EQ(cache_.get_dirty_num(), 0u);
+	}
+
+
+	//----- ワークロード -----//
+
+	bool create_()
+	{
+		bool ok = true;
+		char path[64];
+		std::vector<uint8_t> buf(FSIZE);
+		for(uint32_t i = 0; i < FILES; ++i) {
+			utils::sformat("/dir/long_file_name_%04u.dat", path, sizeof(path)) % i;
+			for(uint32_t j = 0; j < FSIZE; ++j) buf[j] = pat_(i, j);
+			ok &= test::write_file(path, buf.data(), FSIZE);
+		}
+		return ok;
+	}
+
+
+	bool scan_()
+	{
+		bool ok = true;
+		for(uint32_t n = 0; n < 3; ++n) {
+			DIR d;
+			FILINFO fi;
+			ok &= f_opendir(&d, "/dir") == FR_OK;
+			uint32_t cnt = 0;
+			while(f_readdir(&d, &fi) == FR_OK && fi.fname[0] != 0) ++cnt;
+			f_closedir(&d);
+			ok &= cnt == FILES;
+			char path[64];
+			for(uint32_t i = 0; i < FILES; i += 3) {
+				utils::sformat("/dir/long_file_name_%04u.dat", path, sizeof(path)) % i;
+				ok &= f_stat(path, &fi) == FR_OK;
+			}
+		}
+		return ok;
+	}
+
+
+	/// 16 行毎に f_sync するログ
+	bool log_()
+	{
+		FIL f;
+		bool ok = f_open(&f, "/log.txt", FA_WRITE | FA_OPEN_APPEND) == FR_OK;
+		char line[80];
+		for(uint32_t i = 0; i < LOGS && ok; ++i) {
+			utils::sformat("%08u: temperature 23.%u, pressure 1013.%02u hPa\n", line, sizeof(line))
+				% i % (i % 10) % (i % 100);
+			UINT bw;
+			ok &= f_write(&f, line, std::strlen(line), &bw) == FR_OK;
+			if((i % 16) == 15) ok &= f_sync(&f) == FR_OK;
+		}
+		ok &= f_close(&f) == FR_OK;
+		return ok;
+	}
+
+
+	bool big_write_()
+	{
+		FIL f;
+		bool ok = f_open(&f, "/big.bin", FA_WRITE | FA_CREATE_ALWAYS) == FR_OK;
+		std::vector<uint8_t> buf(4096);
+		for(uint32_t p = 0; p < BIG && ok; p += 4096) {
+			for(uint32_t j = 0; j < 4096; ++j) buf[j] = pat_(9999, p + j);
+			UINT bw;
+			ok &= f_write(&f, buf.data(), 4096, &bw) == FR_OK && bw == 4096;
+		}
+		ok &= f_close(&f) == FR_OK;
+		return ok;
+	}
+
+
+	bool big_read_(uint32_t chunk)
+	{
+		FIL f;
+		bool ok = f_open(&f, "/big.bin", FA_READ) == FR_OK;
+		std::vector<uint8_t> buf(chunk);
+		uint32_t p = 0;
+		while(ok && p < BIG) {
+			UINT br;
+			if(f_read(&f, buf.data(), chunk, &br) != FR_OK || br == 0) break;
+			for(uint32_t j = 0; j < br; ++j) {
+				if(buf[j] != pat_(9999, p + j)) ok = false;
+			}
+			p += br;
+		}
+		f_close(&f);
+		return ok && p == BIG;
+	}
+
+
+	bool verify_()
+	{
+		bool ok = true;
+		char path[64];
+		std::vector<uint8_t> buf(FSIZE);
+		for(uint32_t i = 0; i < FILES; ++i) {
+			utils::sformat("/dir/long_file_name_%04u.dat", path, sizeof(path)) % i;
+			FIL f;
+			ok &= f_open(&f, path, FA_READ) == FR_OK;
+			UINT br;
+			ok &= f_read(&f, buf.data(), FSIZE, &br) == FR_OK && br == FSIZE;
+			for(uint32_t j = 0; j < FSIZE; ++j) {
+				if(buf[j] != pat_(i, j)) ok = false;
+			}
+			f_close(&f);
+		}
+		FILINFO fi;
+		ok &= f_stat("/log.txt", &fi) == FR_OK && fi.fsize > (LOGS * 40);
+		ok &= big_read_(4096);
+		return ok;
+	}
+
+
+	struct result_t {
+		const char*	name;
+		uint32_t	cmd[2];
+		double		ms[2];
+	};
+
+
+	/// SD（SPI 25MHz 程度）の見積もり：コマンド毎に 0.3ms、読み 2.2MB/s、書き 1.5MB/s
+	template <class F>
+	void run_(std::vector<result_t>& res, uint32_t n, const char* name, F func)
+	{
+		if(res.size() <= n) res.push_back(result_t { name, { 0, 0 }, { 0.0, 0.0 } });
+		auto& d = test::disk();
+		d.clear_count();
+		CHECK(func());
+		uint32_t pass = use_cache_ ? 1 : 0;
+		res[n].cmd[pass] = d.read_cmd + d.write_cmd;
+		res[n].ms[pass] = (d.read_cmd + d.write_cmd) * 0.3 + d.read_sec * 512 / 2200.0
+			+ d.write_sec * 512 / 1500.0;
+	}
+
+
+	void test_workload_()
+	{
+		std::vector<result_t> res;
+		for(uint32_t pass = 0; pass < 2; ++pass) {
+			use_cache_ = pass == 1;
+			CHECK(test::disk().format(SECTORS, 16));
+			cache_.invalidate();
+			CHECK(f_mount(&fs_, "", 1) == FR_OK);
+			CHECK(f_mkdir("/dir") == FR_OK);
+			uint32_t n = 0;
+			run_(res, n++, "create 400 x 3KB", create_);
+			run_(res, n++, "dir scan + stat x3", scan_);
+			run_(res, n++, "log append (sync/16)", log_);
+			run_(res, n++, "write 4MB (4KB)", big_write_);
+			run_(res, n++, "read 4MB (512B)", [] { return big_read_(512); });
+			run_(res, n++, "read 4MB (700B)", [] { return big_read_(700); });
+			run_(res, n++, "read 4MB (32KB)", [] { return big_read_(32768); });
+			f_mount(nullptr, "", 0);
+			CHECK_EQ(cache_.get_dirty_num(), 0u);
+
+			// キャッシュ無しで検証
+			use_cache_ = false;
+			CHECK(f_mount(&fs_, "", 1) == FR_OK);
+			CHECK(verify_());
+			f_mount(nullptr, "", 0);
+		}
+
+		uint32_t cmd[2] = { 0, 0 };
+		for(const auto& r : res) {
+			std::printf("bench: %-20s cmd %6u -> %6u, SD %6.0f ms -> %6.0f ms\n", r.name,
+				r.cmd[0], r.cmd[1], r.ms[0], r.ms[1]);
+			cmd[0] += r.cmd[0];
+			cmd[1] += r.cmd[1];
+		}
+		// 単発アクセス（作成、走査）はコマンド数が大きく減る
+		CHECK((res[0].cmd[1] * 2) < res[0].cmd[0]);
+		CHECK((res[1].cmd[1] * 2) < res[1].cmd[0]);
+		// ログは f_sync 毎に書き出すので、減り方は小さい
+		CHECK((res[2].cmd[1] * 4) < (res[2].cmd[0] * 3));
+		// 細かい連続読み出しは先読みでまとまる
+		CHECK((res[4].cmd[1] * 4) < res[4].cmd[0]);
+		CHECK((res[5].cmd[1] * 4) < res[5].cmd[0]);
+		// 大きな読み書きは悪化しない
+		CHECK(res[3].cmd[1] <= res[3].cmd[0]);
+		CHECK(res[6].cmd[1] <= (res[6].cmd[0] + res[6].cmd[0] / 10));
+		CHECK(cmd[1] < cmd[0]);
+	}
+}
+
+
+int main(int argc, char* argv[])
+{
+	test_coherence_();
+	test_workload_();
+
+	return test::result("disk_cache");
+}
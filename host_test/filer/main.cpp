@@ -0,0 +1,296 @@
+//=====================================================================//
+/*!	@file
+	@brief	filer、10000 ファイルのディレクトリー・ベンチマーク @n
+			FatFs の RAM ディスク上の 10000 エントリーのディレクトリーを、@n
+			行単位の画面モデルを持つ描画モックで開き、スクロール、INFO、@n
+			サブ・ディレクトリーの往復、ソートを行って、画面の内容を検査する。@n
+			アリーナの既定値と、大きなアリーナ（オプトイン）のセクター読み出し数、@n
+			フレーム数、sizeof(filer) を「bench:」行で表示する
+    @author 平松邦仁 (hira@rvf-rc45.net)
+	@copyright	Copyright (C) 2021 Kunihito Hiramatsu @n
+				Released under the MIT license @n
+				https://github.com/hirakuni45/RX/blob/master/LICENSE
+*/
+//=====================================================================//
+#include "FreeRTOS.h"
+#include <string>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <type_traits>
+#include <strings.h>
+#include "test.hpp"
+#include "host_stub.hpp"
+#include "rtos_host.hpp"
+#include "ram_disk.hpp"
+#include "common/vtx.hpp"
+#include "graphics/color.hpp"
+#include "graphics/filer.hpp"
+
+namespace graphics {
+	const share_color def_color::Black(0, 0, 0);
+	const share_color def_color::White(255, 255, 255);
+	const share_color def_color::Blue(0, 0, 255);
+	const share_color def_color::Darkgray(64, 64, 64);
+}
+
+namespace {
+
+	/// 行単位の画面モデルを持つ描画モック
+	struct mock_rdr {
+		struct glc_type {
+			static const int16_t width = 480;
+			static const int16_t height = 272;
+		};
+		struct font_type {
+			static const int16_t height = 16;
+		};
+		static const int16_t FLN = 18;
+		static const int ROWS = 16;
+
+		struct kfont_t {
+			void flush_cash() { }
+		};
+		struct font_t {
+			kfont_t kf_;
+			kfont_t& at_kfont() { return kf_; }
+			vtx::spos get_text_size(const char* t) { return vtx::spos(std::strlen(t) * 8, 16); }
+		};
+
+		font_t		font_;
+		std::string	row_[ROWS];
+		uint32_t	text_ = 0;
+		uint32_t	scroll_ = 0;
+
+		font_t& at_font() { return font_; }
+		template <class T> void set_fore_color(const T&) { }
+		template <class T> void set_back_color(const T&) { }
+		void swap_color() { }
+		void round_box(const vtx::srect&, int16_t) { }
+		void frame(const vtx::srect&) { }
+		void clear(const graphics::share_color&) { for(auto& r : row_) r.clear(); }
+
+		void fill_box(const vtx::srect& r) {
+			int n = (r.org.y - 2) / FLN;
+			if(n >= 0 && n < ROWS) row_[n].clear();
+		}
+
+		void draw_font(const vtx::spos& p, char ch) {
+			int n = (p.y - 2) / FLN;
+			if(n >= 0 && n < ROWS) row_[n] = std::string(1, ch) + row_[n];
+		}
+
+		int16_t draw_text(const vtx::spos& p, const char* t) {
+			++text_;
+			int n = (p.y - 2) / FLN;
+			if(n >= 0 && n < ROWS) row_[n] += t;
+			return 0;
+		}
+
+		void scroll(int16_t h) {
+			++scroll_;
+			int n = h / FLN;
+			if(n > 0) {
+				for(int i = 0; i < ROWS - n; ++i) row_[i] = row_[i + n];
+			} else {
+				n = -n;
+				for(int i = ROWS - 1; i >= n; --i) row_[i] = row_[i - n];
+			}
+		}
+	};
+
+	static const uint32_t NUM = 10000;	///< /big のエントリー数（サブ・ディレクトリーを含む）
+	static const int SCN = 15;			///< 画面の行数
+
+	std::vector<std::string> names_;	///< ディレクトリー順の表示名
+
+
+	bool setup_()
+	{
+		if(!test::mount_ram_disk(131072, 4)) return false;
+		bool ok = f_mkdir("/big") == FR_OK;
+		ok &= f_mkdir("/big/sub") == FR_OK;
+		char tmp[64];
+		char data[100];
+		std::memset(data, 0x55, sizeof(data));
+		for(uint32_t i = 0; i < 20; ++i) {
+			utils::sformat("/big/sub/track_%02u.mp3", tmp, sizeof(tmp)) % i;
+			ok &= test::write_file(tmp, data, 0);
+		}
+		names_.push_back("/sub");
+		for(uint32_t i = 0; i < (NUM - 1); ++i) {
+			// 名前順と作成順が一致しないように（短い名前の衝突を避けて、先頭を番号にする）
+			utils::sformat("/big/%05u_Photo_long_file_name.jpg", tmp, sizeof(tmp)) % ((i * 7919) % NUM);
+			ok &= test::write_file(tmp, data, i % 100);
+			names_.push_back(tmp + 5);
+		}
+		return ok && f_chdir("/big") == FR_OK;
+	}
+
+
+	template <uint32_t ARENA, uint32_t MRU>
+	class bench {
+
+		typedef gui::filer<mock_rdr, ARENA, MRU> FILER;
+
+		mock_rdr	rdr_;
+		FILER		filer_;
+		char		path_[256];
+		uint32_t	frame_;
+
+		struct meas_t {
+			uint32_t	frame;
+			uint32_t	rd;
+			uint32_t	text;
+		};
+		meas_t		org_;
+
+		static uint32_t bit_(gui::filer_base::ctrl c) {
+			uint32_t b = 0;
+			gui::filer_base::set(c, b);
+			return b;
+		}
+
+		void step_(uint32_t bits = 0) {
+			uint32_t ctrl = bit_(gui::filer_base::ctrl::MOUNT) | bits;
+			++frame_;
+			filer_.update(ctrl, path_, sizeof(path_));
+		}
+
+		// 一回押して離し、settle フレーム進める
+		void press_(gui::filer_base::ctrl c, uint32_t settle = 0) {
+			step_(bit_(c));
+			step_();
+			for(uint32_t i = 0; i < settle; ++i) step_();
+		}
+
+		// lines 行スクロールするまで押す（読み込み中は受け付けない）
+		void scroll_(gui::filer_base::ctrl c, uint32_t lines) {
+			auto s = rdr_.scroll_;
+			uint32_t n = 0;
+			while((rdr_.scroll_ - s) < lines && n < 10'000'000) {
+				step_(bit_(c));
+				step_();
+				n += 2;
+			}
+		}
+
+		void begin_() {
+			org_ = meas_t { frame_, test::disk().read_sec, rdr_.text_ };
+		}
+
+		void end_(const char* name, const char* title) {
+			std::printf("bench: %-12s %-22s frames %6u, sector read %6u, draw_text %6u\n", name, title,
+				frame_ - org_.frame, test::disk().read_sec - org_.rd, rdr_.text_ - org_.text);
+		}
+
+		bool screen_(uint32_t top, const std::vector<std::string>& names) {
+			uint32_t bad = 0;
+			for(int i = 0; i < SCN; ++i) {
+				std::string exp = (top + i) < names.size() ? names[top + i] : "";
+				if(rdr_.row_[i] != exp) {
+					if(bad++ < 3) {
+						std::fprintf(stderr, "row %d: '%s' != '%s'\n", i, rdr_.row_[i].c_str(), exp.c_str());
+					}
+				}
+			}
+			return bad == 0;
+		}
+
+	public:
+		bench() : rdr_(), filer_(rdr_), path_{ 0 }, frame_(0), org_{ } { }
+
+		void run(const char* name) {
+			std::printf("bench: %-12s sizeof(filer) %u\n", name, static_cast<uint32_t>(sizeof(FILER)));
+
+			begin_();
+			press_(gui::filer_base::ctrl::OPEN);
+			scroll_(gui::filer_base::ctrl::DOWN, 1);
+			end_(name, "open + list");
+			CHECK(screen_(1, names_));
+
+			begin_();
+			scroll_(gui::filer_base::ctrl::DOWN, 2000);
+			end_(name, "scroll 2000 lines");
+			CHECK(screen_(2001, names_));
+
+			begin_();
+			scroll_(gui::filer_base::ctrl::UP, 100);
+			end_(name, "scroll up 100 lines");
+			CHECK(screen_(1901, names_));
+
+			begin_();
+			press_(gui::filer_base::ctrl::INFO);
+			press_(gui::filer_base::ctrl::INFO, 10);
+			end_(name, "info open/close");
+			CHECK(screen_(1901, names_));
+
+			// 先頭の「/sub」に入って戻る
+			scroll_(gui::filer_base::ctrl::UP, 1901);
+			for(uint32_t i = 0; i < 20; ++i) step_(bit_(gui::filer_base::ctrl::UP)), step_();
+			begin_();
+			press_(gui::filer_base::ctrl::SELECT, 10);
+			CHECK(std::strcmp(path_, "sub") == 0);
+			press_(gui::filer_base::ctrl::BACK);
+			scroll_(gui::filer_base::ctrl::DOWN, 1);
+			end_(name, "enter sub + back");
+			CHECK(screen_(1, names_));
+
+			const auto& st = filer_.get_cache().get_stat();
+			std::printf("bench: %-12s cache hit %u, miss %u, readdir %u, evict %u, reload %u, window %d\n",
+				name, st.hit, st.miss, st.read, st.evict, st.reload, filer_.get_cache().is_window());
+
+			if(filer_.get_cache().is_window()) return;
+
+			// 名前順（大文字、小文字を区別しない）、ディレクトリーが先頭
+			std::vector<std::string> sorted(names_.begin() + 1, names_.end());
+			std::sort(sorted.begin(), sorted.end(), [](const std::string& a, const std::string& b) {
+				return strcasecmp(a.c_str(), b.c_str()) < 0; });
+			sorted.insert(sorted.begin(), names_[0]);
+			test::stopwatch sw;
+			press_(gui::filer_base::ctrl::SORT);
+			std::printf("bench: %-12s sort by name %.1f ms\n", name, sw.sec() * 1e3);
+			CHECK(filer_.get_sort() == FILER::SORT::NAME);
+			CHECK(screen_(0, sorted));  // ソートすると先頭に戻る
+			scroll_(gui::filer_base::ctrl::DOWN, 5000);
+			CHECK(screen_(5000, sorted));
+		}
+
+		const typename FILER::DCACHE& get_cache() const { return filer_.get_cache(); }
+	};
+
+
+	template <uint32_t ARENA, uint32_t MRU>
+	const typename gui::filer<mock_rdr, ARENA, MRU>::DCACHE::stat_t run_(const char* name)
+	{
+		auto b = std::make_unique<bench<ARENA, MRU>>();
+		b->run(name);
+		return b->get_cache().get_stat();
+	}
+}
+
+
+int main(int argc, char* argv[])
+{
+	test::stopwatch sw;
+	if(!CHECK(setup_())) {
+		return test::result("filer");
+	}
+	std::printf("setup: %u entries in /big (%.0f ms)\n", NUM, sw.sec() * 1e3);
+
+	// 既定（１ディレクトリー、ウィンドウ・モード）は、小さいフットプリント
+	static_assert(std::is_same<gui::filer<mock_rdr>, gui::filer<mock_rdr, 2048, 1>>::value,
+		"default arena of gui::filer changed");
+	CHECK(sizeof(gui::filer<mock_rdr>) < 4096);
+	auto def = run_<2048, 1>("default");
+	// ウィンドウの読み直しは、スクロールした行数より十分少ない
+	CHECK(def.reload < ((2000 + 100) / 8));
+
+	// オプトイン：大きなアリーナ、MRU
+	run_<16384, 4>("16K x 4");
+	auto big = run_<524288, 4>("512K x 4");
+	CHECK_EQ(big.reload, 0u);
+	CHECK(big.hit > 0);
+
+	return test::result("filer");
+}
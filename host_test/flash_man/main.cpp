@@ -0,0 +1,296 @@
+//=====================================================================//
+/*!	@file
+	@brief	flash_man、電源断シミュレーション・テスト @n
+			データ・フラッシュのモデル（消去後の値は不定、上書き不可）上で、@n
+			書き込み、消去、マウントの途中に電源断を起こし、再マウント後の各キーが @n
+			「以前の値」か「新しい値」のどちらかである事、他のキーが壊れない事を検査する。@n
+			容量一杯での更新、消去回数の平滑化も検査する
+    @author 平松邦仁 (hira@rvf-rc45.net)
+	@copyright	Copyright (C) 2021 Kunihito Hiramatsu @n
+				Released under the MIT license @n
+				https://github.com/hirakuni45/RX/blob/master/LICENSE
+*/
+//=====================================================================//
+#include <map>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include "test.hpp"
+#include "common/flash_man.hpp"
+
+namespace {
+
+	std::mt19937 rng_(1);
+
+	//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+	/*!
+		@brief	データ・フラッシュのモデル（device::flash_io と同じインターフェース）@n
+				cut_ 回目の操作で電源断、その操作は中途半端な状態になり、@n
+				以降の書き込み、消去は何もしない（CPU が止まったのと同じ）
+	*/
+	//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+	struct sim_flash {
+		static const uint32_t data_flash_size = 16384;
+		static const uint32_t data_flash_block = 64;
+		static const uint32_t data_flash_bank = data_flash_size / data_flash_block;
+		static const uint32_t data_flash_word = 4;
+
+		uint32_t	mem_[data_flash_size / 4];
+		bool		blank_[data_flash_size / 4];
+		uint32_t	ecnt_[data_flash_bank] = { };
+		int			cut_ = -1;		///< 電源断までの操作数（-1 なら無効）
+		bool		dead_ = false;
+		uint32_t	overwrite_ = 0;
+
+		sim_flash() {
+			for(auto& b : blank_) b = false;
+			for(auto& m : mem_) m = rng_();
+		}
+
+		void power_on() { cut_ = -1; dead_ = false; }
+
+		/// 電源断の操作なら「true」
+		bool cut_now_() {
+			if(cut_ > 0 && --cut_ == 0) {
+				dead_ = true;
+				return true;
+			}
+			return false;
+		}
+
+		bool read(uint32_t org, void* dst, uint32_t len) {
+			auto d = static_cast<uint8_t*>(dst);
+			for(uint32_t i = 0; i < len; ++i) {
+				uint32_t a = org + i;
+				if(blank_[a / 4]) d[i] = rng_();  // 消去状態の読み出しは不定
+				else d[i] = mem_[a / 4] >> ((a & 3) * 8);
+			}
+			return true;
+		}
+
+		bool erase_check(uint32_t org, uint32_t len) {
+			for(uint32_t a = org; a < (org + len); a += 4) {
+				if(!blank_[a / 4]) return false;
+			}
+			return true;
+		}
+
+		bool erase(uint32_t org) {
+			if(dead_) return false;
+			uint32_t w = org / data_flash_block * data_flash_block / 4;
+			if(cut_now_()) {  // 消去途中：ワード毎に半端な状態
+				for(uint32_t i = 0; i < data_flash_block / 4; ++i) {
+					if(rng_() & 1) blank_[w + i] = true;
+					else { blank_[w + i] = false; mem_[w + i] = rng_(); }
+				}
+				return false;
+			}
+			for(uint32_t i = 0; i < data_flash_block / 4; ++i) blank_[w + i] = true;
+			++ecnt_[org / data_flash_block];
+			return true;
+		}
+
+		bool write(uint32_t org, const void* src, uint32_t len) {
+			if(dead_ || (org & 3) != 0) return false;
+			auto p = static_cast<const uint8_t*>(src);
+			for(uint32_t ofs = 0; ofs < len; ofs += 4) {
+				uint32_t v = 0xffffffff;
+				for(uint32_t i = 0; i < 4 && (ofs + i) < len; ++i) {
+					v &= ~(0xffu << (i * 8));
+					v |= static_cast<uint32_t>(p[ofs + i]) << (i * 8);
+				}
+				auto a = (org + ofs) / 4;
+				if(!blank_[a]) {
+					++overwrite_;
+					return false;
+				}
+				if(cut_now_()) {  // 書き込み途中：ビット化け
+					if(rng_() & 1) { blank_[a] = false; mem_[a] = v | rng_(); }
+					return false;
+				}
+				blank_[a] = false;
+				mem_[a] = v;
+			}
+			return true;
+		}
+	};
+
+
+	typedef std::map<uint16_t, std::vector<uint8_t>> MODEL;
+
+
+	//-----------------------------------------------------------------//
+	/*!
+		@brief	電源断のテスト
+		@param[in]	name	表示名
+		@param[in]	loops	操作数
+		@param[in]	cold	変化しないデータのサイズ
+		@param[in]	big		大きいデータのサイズ
+	*/
+	//-----------------------------------------------------------------//
+	template <class FM>
+	void test_power_cut_(const char* name, uint32_t loops, uint32_t cold, uint32_t big)
+	{
+		static const uint16_t KEYS = 20;
+		auto fl = new sim_flash;
+		auto fm = new FM(*fl);
+		CHECK(fm->mount());
+		MODEL model;
+		for(uint16_t k = KEYS; k < (KEYS + 4); ++k) {
+			std::vector<uint8_t> v(cold, k);
+			CHECK(fm->write(k, v.data(), v.size()));
+			model[k] = v;
+		}
+
+		uint32_t cuts = 0;
+		uint32_t fails = 0;
+		uint32_t errors = 0;
+		uint32_t oldv = 0;
+		uint32_t newv = 0;
+		// infl: 電源断の時に更新中だったキー（旧か新のどちらか）
+		auto verify = [&](int infl, const std::vector<uint8_t>& nv, bool remove) {
+			for(uint16_t k = 0; k < (KEYS + 4); ++k) {
+				bool has = fm->probe(k);
+				std::vector<uint8_t> got;
+				if(has) {
+					got.resize(fm->get_size(k));
+					fm->read(k, got.data(), got.size());
+				}
+				auto it = model.find(k);
+				bool mhas = it != model.end();
+				bool okold = (has == mhas) && (!has || got == it->second);
+				if(k == infl) {
+					bool oknew = remove ? !has : (has && got == nv);
+					if(oknew && !okold) {
+						++newv;
+						if(remove) model.erase(k);
+						else model[k] = nv;
+					} else if(okold) {
+						++oldv;
+					} else {
+						++errors;
+					}
+				} else if(!okold) {
+					++errors;
+				}
+			}
+		};
+		auto remount = [&]() {
+			while(1) {
+				delete fm;
+				fl->power_on();
+				fm = new FM(*fl);
+				// マウント中の電源断
+				if((rng_() % 4) == 0) fl->cut_ = 1 + rng_() % 20;
+				fm->mount();
+				if(!fl->dead_) break;
+				++cuts;
+			}
+			fl->power_on();
+		};
+
+		for(uint32_t n = 0; n < loops; ++n) {
+			uint16_t key = rng_() % KEYS;
+			bool rem = (rng_() % 8) == 0;
+			std::vector<uint8_t> v(rng_() % ((rng_() % 4) == 0 ? big : 40));
+			for(auto& b : v) b = rng_();
+			if((rng_() % 10) == 0) fl->cut_ = 1 + rng_() % 40;
+			bool ok;
+			if(rem) ok = model.count(key) ? fm->remove(key) : true;
+			else ok = fm->write(key, v.data(), v.size());
+			for(int i = 0; i < 3 && !fl->dead_; ++i) fm->service();
+			if(fl->dead_) {
+				++cuts;
+				remount();
+				verify(key, v, rem);
+				continue;
+			}
+			fl->power_on();
+			if(ok) {
+				if(rem) model.erase(key);
+				else model[key] = v;
+			} else {
+				++fails;
+			}
+			if((n % 500) == 0) verify(-1, v, false);
+		}
+		remount();
+		verify(-1, std::vector<uint8_t>(), false);
+
+		uint32_t smin = ~0u;
+		uint32_t smax = 0;
+		for(uint32_t i = 0; i < FM::SECTOR_NUM; ++i) {
+			smin = std::min(smin, fm->get_erase_count(i));
+			smax = std::max(smax, fm->get_erase_count(i));
+		}
+		std::printf("%s: %u ops, fails %u, power cuts %u (old %u, new %u), sector erase %u..%u\n",
+			name, loops, fails, cuts, oldv, newv, smin, smax);
+		CHECK_EQ(errors, 0u);
+		CHECK_EQ(fl->overwrite_, 0u);
+		CHECK(cuts > (loops / 100));
+		CHECK(oldv > 0 && newv > 0);
+		// 変化しないデータがあっても、消去回数は平滑化される
+		CHECK((smax - smin) <= (smax / 2 + 8));
+		delete fm;
+		delete fl;
+	}
+
+
+	/// 容量一杯までキーを書き、１レコード分を空けた状態での更新と、再マウント後の読み出し
+	template <class FM>
+	void test_full_()
+	{
+		auto fl = new sim_flash;
+		FM fm(*fl);
+		CHECK(fm.mount());
+		std::vector<uint8_t> v(900, 1);
+		uint32_t keys = 0;
+		while(keys < 30) {
+			v[0] = keys;
+			if(!fm.write(keys, v.data(), v.size())) break;
+			++keys;
+		}
+		CHECK(keys > 2);
+		// 空きが無い状態では、更新も出来ない（GC 用の予備セクターは使わない）
+		v[0] = 0;
+		CHECK(!fm.write(0, v.data(), v.size()));
+		--keys;
+		CHECK(fm.remove(keys));
+		uint32_t upd = 0;
+		for(uint32_t n = 0; n < 2000; ++n) {
+			uint16_t k = n % keys;
+			v[0] = k;
+			v[1] = n;
+			if(fm.write(k, v.data(), v.size())) ++upd;
+			for(int i = 0; i < 3; ++i) fm.service();
+		}
+		std::printf("full: %u keys x %zu bytes, updates %u/2000, free %u\n", keys, v.size(), upd, fm.get_free());
+		CHECK_EQ(upd, 2000u);
+
+		FM fm2(*fl);
+		CHECK(fm2.mount());
+		uint32_t good = 0;
+		for(uint16_t k = 0; k < keys; ++k) {
+			std::vector<uint8_t> g(900);
+			if(fm2.read(k, g.data(), g.size()) && g[0] == k) ++good;
+		}
+		CHECK_EQ(good, keys);
+		CHECK(fm2.remove(0));
+		FM fm3(*fl);
+		CHECK(fm3.mount());
+		CHECK(!fm3.probe(0));
+		CHECK(fm3.probe(1));
+		delete fl;
+	}
+}
+
+
+int main(int argc, char* argv[])
+{
+	uint32_t loops = argc > 1 ? std::atoi(argv[1]) : 20000;
+	test_power_cut_<utils::flash_man<sim_flash, 32, 1024>>("sector 1024", loops, 600, 200);
+	test_power_cut_<utils::flash_man<sim_flash, 32, 512>>("sector 512", loops, 300, 150);
+	test_full_<utils::flash_man<sim_flash, 32, 1024>>();
+
+	return test::result("flash_man");
+}
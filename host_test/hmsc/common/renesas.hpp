@@ -0,0 +1,12 @@
+#pragma once
+//=====================================================================//
+/*!	@file
+	@brief	ホスト・テスト用 common/renesas.hpp の代用 @n
+			usb_hmsc が使う utils::format だけ
+    @author 平松邦仁 (hira@rvf-rc45.net)
+	@copyright	Copyright (C) 2021 Kunihito Hiramatsu @n
+				Released under the MIT license @n
+				https://github.com/hirakuni45/RX/blob/master/LICENSE
+*/
+//=====================================================================//
+#include "common/format.hpp"
@@ -0,0 +1,441 @@
+//=====================================================================//
+/*!	@file
+	@brief	hmsc、USB マス・ストレージ（BOT）テスト @n
+			Renesas USB ドライバーを、仮想時間の BOT デバイス・モデル（USB-FS、@n
+			コマンド毎に 1ms、1216 バイト/ms）に置き換え、usb_host::hmsc と @n
+			fatfs::disk_queue を FatFs の RAM ディスク・イメージで動かす。@n
+			・sync_trans は、待っている転送の結果だけを一度返す @n
+			・要求をまとめる、完了コールバック、エラーの伝搬 @n
+			・タスク通知は wait で止まっているタスクにだけ送る（余分な通知を残さない）@n
+			・先読みの窓と書き込みの一貫性 @n
+			同期読み出しとキューの読み出し速度（仮想時間の MB/s）を「bench:」行で表示する
+    @author 平松邦仁 (hira@rvf-rc45.net)
+	@copyright	Copyright (C) 2021 Kunihito Hiramatsu @n
+				Released under the MIT license @n
+				https://github.com/hirakuni45/RX/blob/master/LICENSE
+*/
+//=====================================================================//
+#include "FreeRTOS.h"
+#include <vector>
+#include <thread>
+#include <atomic>
+#include "test.hpp"
+#include "host_stub.hpp"
+#include "rtos_host.hpp"
+#define RAM_DISK_NO_DISKIO
+#include "ram_disk.hpp"
+#include "usb/usb_hmsc.hpp"
+#include "ff14/disk_queue.hpp"
+
+namespace bot {
+
+	static const uint32_t POLL_US = 20;			///< USB スケジューラー１回の時間
+	static const uint32_t CMD_US = 1000;		///< CBW/CSW（フレーム）
+	static const uint32_t BYTES_PER_MS = 1216;	///< バルク転送
+
+	uint64_t	now_ = 0;		///< 仮想時間（us）
+	bool		attach_ = true;
+	uint32_t	fail_ = 0;		///< 失敗させるコマンド数
+	uint32_t	cmd_ = 0;		///< コマンド数
+	uint32_t	overlap_ = 0;	///< 転送中に発行したコマンド数（BOT では不可）
+
+	bool		busy_ = false;
+	bool		bad_;
+	bool		write_;
+	uint8_t*	buff_;
+	uint32_t	sector_;
+	uint32_t	count_;
+	uint64_t	done_;
+	usb_utr_t	msg_;
+
+	usb_er_t issue_(uint8_t* buff, uint32_t sector, uint16_t count, bool write)
+	{
+		if(busy_) {
+			++overlap_;
+			return USB_ERROR;
+		}
+		busy_ = true;
+		bad_ = fail_ > 0;
+		if(bad_) --fail_;
+		write_ = write;
+		buff_ = buff;
+		sector_ = sector;
+		count_ = count;
+		done_ = now_ + CMD_US + static_cast<uint64_t>(count) * 512 * 1000 / BYTES_PER_MS;
+		++cmd_;
+		return USB_OK;
+	}
+
+
+	void detach()
+	{
+		attach_ = false;
+		busy_ = false;
+	}
+}
+
+usb_er_t usb_cstd_rec_msg(uint8_t id, usb_msg_t** mess, uint16_t tm)
+{
+	if(id != USB_HSTRG_MBX || !bot::busy_ || bot::now_ < bot::done_) return USB_ERROR;
+	bot::busy_ = false;
+	if(!bot::bad_) {
+		if(bot::write_) test::disk().write(bot::buff_, bot::sector_, bot::count_);
+		else test::disk().read(bot::buff_, bot::sector_, bot::count_);
+	}
+	bot::msg_.result = bot::bad_ ? USB_ERROR : USB_OK;
+	*mess = &bot::msg_;
+	return USB_OK;
+}
+
+usb_er_t usb_cstd_rel_blk(uint8_t id, usb_utr_t* blk) { return USB_OK; }
+uint8_t usb_cstd_check_schedule(void) { return 0; }
+void usb_cstd_scheduler(void) { bot::now_ += bot::POLL_US; }
+void usb_hstd_hcd_task(usb_vp_int_t) { }
+void usb_hstd_mgr_task(usb_vp_int_t) { }
+void usb_hhub_task(usb_vp_int_t) { }
+void R_USB_HmscTask(void) { }
+usb_err_t R_USB_Open(usb_ctrl_t* ctrl, usb_cfg_t* cfg) { return USB_OK; }
+usb_status_t R_USB_GetEvent(usb_ctrl_t* ctrl) { return USB_STS_NONE; }
+usb_err_t R_USB_HmscGetDriveNo(usb_ctrl_t* ctrl, uint8_t* drvno) { *drvno = 0; return USB_OK; }
+uint16_t R_USB_HmscGetDevSts(uint16_t side) { return bot::attach_ ? USB_TRUE : USB_FALSE; }
+void usb_hmsc_smp_drive2_addr(uint16_t side, usb_utr_t* devadr) { devadr->ip = 0; }
+
+usb_er_t R_USB_HmscStrgReadSector(usb_utr_t* ptr, uint16_t side, uint8_t* buff, uint32_t secno,
+	uint16_t seccnt, uint32_t trans_byte)
+{
+	return bot::issue_(buff, secno, seccnt, false);
+}
+
+usb_er_t R_USB_HmscStrgWriteSector(usb_utr_t* ptr, uint16_t side, uint8_t* buff, uint32_t secno,
+	uint16_t seccnt, uint32_t trans_byte)
+{
+	return bot::issue_(buff, secno, seccnt, true);
+}
+
+namespace {
+
+	struct usb_io { };
+
+	typedef usb_host::hmsc<usb_io> HMSC;
+	typedef fatfs::disk_queue<HMSC, 16, 64, 16, 2> QUEUE;
+
+	usb_io	io_;
+	HMSC	hmsc_(io_);
+	QUEUE	queue_(hmsc_);
+
+	enum class MODE { RAM, SYNC, QUEUE };
+	MODE	mode_ = MODE::RAM;
+
+	static const uint32_t FILE_SIZE = 2 * 1024 * 1024;
+
+	// セクター毎に異なる内容
+	uint8_t pattern_(uint32_t pos, uint32_t gen)
+	{
+		return static_cast<uint8_t>((pos >> 9) * 131 + (pos & 511) * 7 + gen * 29);
+	}
+
+
+	bool check_sector_(const uint8_t* p, uint32_t sector)
+	{
+		std::vector<uint8_t> ref(512);
+		test::disk().read(ref.data(), sector, 1);
+		return std::memcmp(p, ref.data(), 512) == 0;
+	}
+}
+
+extern "C" {
+
+	DSTATUS disk_initialize(BYTE drv) { return 0; }
+
+	DSTATUS disk_status(BYTE drv) { return 0; }
+
+	DRESULT disk_read(BYTE drv, BYTE* buff, LBA_t sector, UINT count) {
+		switch(mode_) {
+		case MODE::SYNC:  return hmsc_.disk_read(drv, buff, sector, count);
+		case MODE::QUEUE: return queue_.disk_read(drv, buff, sector, count);
+		default:          return test::disk().read(buff, sector, count);
+		}
+	}
+
+	DRESULT disk_write(BYTE drv, const BYTE* buff, LBA_t sector, UINT count) {
+		switch(mode_) {
+		case MODE::SYNC:  return hmsc_.disk_write(drv, buff, sector, count);
+		case MODE::QUEUE: return queue_.disk_write(drv, buff, sector, count);
+		default:          return test::disk().write(buff, sector, count);
+		}
+	}
+
+	DRESULT disk_ioctl(BYTE drv, BYTE cmd, void* buff) {
+		if(cmd != CTRL_SYNC || mode_ == MODE::RAM) return test::disk().ioctl(cmd, buff);
+		if(mode_ == MODE::SYNC) return hmsc_.disk_ioctl(drv, cmd, buff);
+		return queue_.disk_ioctl(drv, cmd, buff);
+	}
+}
+
+namespace {
+
+	void test_sync_trans_()
+	{
+		std::vector<uint8_t> a(8 * 512), b(512);
+
+		// 失敗した転送の結果を、次の転送に返さない
+		bot::fail_ = 1;
+		CHECK_EQ(hmsc_.start_read(0, a.data(), 100, 1), RES_OK);
+		CHECK_EQ(hmsc_.start_read(0, b.data(), 101, 1), RES_OK);
+		CHECK_EQ(hmsc_.sync_trans(), RES_OK);
+		CHECK(check_sector_(b.data(), 101));
+		CHECK_EQ(hmsc_.sync_trans(), RES_OK);
+
+		// 失敗は一度だけ返す
+		bot::fail_ = 1;
+		CHECK_EQ(hmsc_.disk_read(0, a.data(), 100, 1), RES_ERROR);
+		CHECK_EQ(hmsc_.sync_trans(), RES_OK);
+		CHECK_EQ(hmsc_.disk_ioctl(0, CTRL_SYNC, nullptr), RES_OK);
+		CHECK_EQ(hmsc_.disk_read(0, a.data(), 100, 1), RES_OK);
+		CHECK(check_sector_(a.data(), 100));
+
+		// 取り出していない書き込みの失敗は、CTRL_SYNC で一度だけ
+		bot::fail_ = 1;
+		CHECK_EQ(hmsc_.start_write(0, a.data(), 100, 1), RES_OK);
+		CHECK_EQ(hmsc_.disk_ioctl(0, CTRL_SYNC, nullptr), RES_ERROR);
+		CHECK_EQ(hmsc_.disk_ioctl(0, CTRL_SYNC, nullptr), RES_OK);
+
+		// 転送中の取り外し
+		CHECK_EQ(hmsc_.start_read(0, a.data(), 200, 8), RES_OK);
+		bot::detach();
+		CHECK_EQ(hmsc_.sync_trans(), RES_ERROR);
+		CHECK_EQ(hmsc_.disk_read(0, a.data(), 200, 8), RES_ERROR);
+		bot::attach_ = true;
+		CHECK_EQ(hmsc_.disk_read(0, a.data(), 200, 8), RES_OK);
+		CHECK(check_sector_(&a[7 * 512], 207));
+		CHECK_EQ(bot::overlap_, 0);
+	}
+
+
+	struct cb_t {
+		uint32_t	num = 0;
+		uint32_t	error = 0;
+		uint32_t	last = 0;
+	};
+
+	void callback_(void* ctx, uint32_t id, DRESULT res)
+	{
+		auto& c = *static_cast<cb_t*>(ctx);
+		++c.num;
+		if(res != RES_OK) ++c.error;
+		c.last = id;
+	}
+
+
+	void test_merge_()
+	{
+		std::vector<uint8_t> buf(28 * 512);
+		cb_t cb;
+		queue_.clear_stat();
+		auto cmd = bot::cmd_;
+		uint32_t id = 0;
+		for(uint32_t i = 0; i < 7; ++i) {
+			CHECK(queue_.push_read(0, &buf[i * 4 * 512], 300 + i * 4, 4, &id, callback_, &cb));
+		}
+		CHECK_EQ(queue_.wait(id), RES_OK);
+		CHECK_EQ(cb.num, 7);
+		CHECK_EQ(cb.last, id);
+		CHECK_EQ(bot::cmd_ - cmd, 1);
+		CHECK_EQ(queue_.get_stat().merge, 6);
+		CHECK_EQ(queue_.get_stat().dev_read_sec, 28);
+		CHECK(check_sector_(&buf[27 * 512], 327));
+
+		// まとめたコマンドの失敗は、全ての要求に返し、次の要求には返さない
+		cb = cb_t();
+		bot::fail_ = 1;
+		uint32_t id0;
+		CHECK(queue_.push_read(0, &buf[0], 400, 2, &id0, callback_, &cb));
+		CHECK(queue_.push_read(0, &buf[2 * 512], 402, 2, &id, callback_, &cb));
+		CHECK_EQ(queue_.wait(id), RES_ERROR);
+		CHECK_EQ(queue_.wait(id0), RES_ERROR);
+		CHECK_EQ(cb.error, 2);
+		CHECK(queue_.push_read(0, &buf[0], 400, 4, &id));
+		CHECK_EQ(queue_.wait(id), RES_OK);
+		CHECK_EQ(queue_.flush(), RES_OK);
+	}
+
+
+	void test_notify_()
+	{
+		std::atomic<bool> stop(false);
+		std::thread svc([&] {
+			while(!stop) {
+				queue_.service();
+				std::this_thread::yield();
+			}
+		});
+
+		uint32_t stray = 0;
+		uint32_t kept = 0;
+		uint32_t extra = 0;
+		uint32_t error = 0;
+		bool data = true;
+		std::thread app([&] {
+			std::vector<uint8_t> buf(8 * 512);
+			uint32_t id = 0;
+			// 積むだけで待たないタスクには通知しない
+			for(uint32_t i = 0; i < 8; ++i) {
+				while(!queue_.push_read(0, &buf[i * 512], 500 + i * 3, 1, &id)) vTaskDelay(1);
+			}
+			while(!queue_.is_done(id)) vTaskDelay(1);
+			stray = ulTaskNotifyTake(pdTRUE, 0);
+
+			// 他の用途の通知を持ったまま待っても、通知は残る
+			xTaskNotifyGive(xTaskGetCurrentTaskHandle());
+			for(uint32_t i = 0; i < 8; ++i) {
+				while(!queue_.push_read(0, &buf[i * 512], 600 + i * 3, 1, &id)) vTaskDelay(1);
+			}
+			if(queue_.wait(id) != RES_OK) ++error;
+			kept = ulTaskNotifyTake(pdTRUE, 0);
+
+			// 待ち（通知）を繰り返しても、余分な通知が残らない
+			for(uint32_t n = 0; n < 200; ++n) {
+				uint32_t org = 700 + (n % 50) * 8;
+				if(!queue_.push_read(0, &buf[0], org, 4, &id)) continue;
+				if(queue_.wait(id) != RES_OK) ++error;
+				if(!check_sector_(&buf[3 * 512], org + 3)) data = false;
+				extra += ulTaskNotifyTake(pdTRUE, 0);
+			}
+		});
+		app.join();
+		stop = true;
+		svc.join();
+
+		CHECK_EQ(stray, 0);
+		CHECK_EQ(kept, 1);
+		CHECK_EQ(extra, 0);
+		CHECK_EQ(error, 0);
+		CHECK(data);
+		CHECK_EQ(queue_.get_queue_num(), 0);
+	}
+
+
+	// アプリケーションの処理（キューの場合、その間に service を回す）
+	void work_(uint32_t us)
+	{
+		auto end = bot::now_ + us;
+		while(bot::now_ < end) {
+			if(mode_ == MODE::QUEUE) queue_.service();
+			bot::now_ += bot::POLL_US;
+		}
+	}
+
+
+	double read_file_(uint32_t chunk, uint32_t work, uint32_t& cmd, bool& ok)
+	{
+		FIL f;
+		if(f_open(&f, "/data.bin", FA_READ) != FR_OK) {
+			ok = false;
+			return 0.0;
+		}
+		auto org = bot::now_;
+		cmd = bot::cmd_;
+		std::vector<uint8_t> buf(chunk);
+		for(uint32_t pos = 0; pos < FILE_SIZE; pos += chunk) {
+			UINT br = 0;
+			if(f_read(&f, buf.data(), chunk, &br) != FR_OK || br != chunk) {
+				ok = false;
+				break;
+			}
+			for(uint32_t i = 0; i < chunk; i += 97) {
+				if(buf[i] != pattern_(pos + i, 0)) ok = false;
+			}
+			work_(work * chunk / 512);
+		}
+		f_close(&f);
+		cmd = bot::cmd_ - cmd;
+		return static_cast<double>(FILE_SIZE) / (bot::now_ - org);
+	}
+
+
+	void test_coherency_()
+	{
+		// 先読みの窓に入っている範囲を書き換えて、続きを読む
+		mode_ = MODE::QUEUE;
+		FIL f;
+		CHECK(f_open(&f, "/data.bin", FA_READ | FA_WRITE) == FR_OK);
+		std::vector<uint8_t> buf(4096);
+		UINT br;
+		queue_.clear_stat();
+		for(uint32_t i = 0; i < 3; ++i) {
+			CHECK(f_read(&f, buf.data(), 2048, &br) == FR_OK);
+		}
+		CHECK(queue_.get_stat().ra_issue > 0);
+		for(uint32_t i = 0; i < 4096; ++i) buf[i] = pattern_(8192 + i, 1);
+		CHECK(f_lseek(&f, 8192) == FR_OK);
+		UINT bw;
+		CHECK(f_write(&f, buf.data(), 4096, &bw) == FR_OK && bw == 4096);
+		CHECK(f_sync(&f) == FR_OK);
+		CHECK(f_lseek(&f, 6144) == FR_OK);
+		bool ok = true;
+		for(uint32_t pos = 6144; pos < 32768; pos += 512) {
+			CHECK(f_read(&f, buf.data(), 512, &br) == FR_OK);
+			uint32_t gen = (pos >= 8192 && pos < 12288) ? 1 : 0;
+			for(uint32_t i = 0; i < 512; ++i) {
+				if(buf[i] != pattern_(pos + i, gen)) ok = false;
+			}
+		}
+		CHECK(ok);
+		CHECK(queue_.get_stat().ra_hit > 0);
+		// 元に戻す
+		for(uint32_t i = 0; i < 4096; ++i) buf[i] = pattern_(8192 + i, 0);
+		CHECK(f_lseek(&f, 8192) == FR_OK);
+		CHECK(f_write(&f, buf.data(), 4096, &bw) == FR_OK);
+		CHECK(f_close(&f) == FR_OK);
+		mode_ = MODE::RAM;
+	}
+
+
+	void test_bench_()
+	{
+		struct conf_t {
+			uint32_t	chunk;
+			uint32_t	work;
+		};
+		static const conf_t conf[] = { { 512, 300 }, { 512, 600 }, { 2048, 300 } };
+		for(const auto& c : conf) {
+			bool ok = true;
+			uint32_t cs, cq;
+			mode_ = MODE::SYNC;
+			auto s = read_file_(c.chunk, c.work, cs, ok);
+			mode_ = MODE::QUEUE;
+			queue_.clear_stat();
+			auto q = read_file_(c.chunk, c.work, cq, ok);
+			CHECK(queue_.flush() == RES_OK);
+			const auto& st = queue_.get_stat();
+			mode_ = MODE::RAM;
+			CHECK(ok);
+			CHECK(q > s * 1.5);
+			// アプリケーションの処理だけの上限
+			auto app = 512.0 / c.work;
+			CHECK(q <= app);
+			std::printf("bench: read %u bytes + %uus/sector (app limit %.2f MB/s): sync %.2f MB/s"
+				" (%u cmds), queue %.2f MB/s (%u cmds, read-ahead %u/%u sectors)\n",
+				c.chunk, c.work, app, s, cs, q, cq, st.ra_hit, st.ra_hit + st.ra_miss);
+		}
+	}
+}
+
+
+int main(int argc, char* argv[])
+{
+	CHECK(test::mount_ram_disk(32768, 4));
+	{
+		std::vector<uint8_t> data(FILE_SIZE);
+		for(uint32_t i = 0; i < FILE_SIZE; ++i) data[i] = pattern_(i, 0);
+		CHECK(test::write_file("/data.bin", data.data(), data.size()));
+	}
+
+	test_sync_trans_();
+	test_merge_();
+	test_notify_();
+	test_coherency_();
+	test_bench_();
+
+	return test::result("hmsc");
+}
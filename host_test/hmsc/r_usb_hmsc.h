@@ -0,0 +1,77 @@
+#pragma once
+//=====================================================================//
+/*!	@file
+	@brief	ホスト・テスト用 Renesas USB ドライバー（HMSC）ヘッダーの代用 @n
+			usb_hmsc が使う型と関数だけ、実体は main.cpp の BOT デバイス・モデル
+    @author 平松邦仁 (hira@rvf-rc45.net)
+	@copyright	Copyright (C) 2021 Kunihito Hiramatsu @n
+				Released under the MIT license @n
+				https://github.com/hirakuni45/RX/blob/master/LICENSE
+*/
+//=====================================================================//
+#include <cstdint>
+
+#define USB_OK				(0)
+#define USB_ERROR			(-1)
+#define USB_TRUE			(1u)
+#define USB_FALSE			(0u)
+#define USB_FLGSET			(1u)
+
+#define USB_IP0				(0)
+#define USB_HOST			(1)
+#define USB_FS				(2)
+#define USB_HMSC			(3)
+
+#define USB_HSTRG_MBX		(1)
+#define USB_HSTRG_MPL		(1)
+
+typedef int16_t		usb_er_t;
+typedef int			usb_err_t;
+typedef void*		usb_vp_int_t;
+
+enum usb_status_t {
+	USB_STS_NONE,
+	USB_STS_CONFIGURED,
+	USB_STS_DETACH,
+};
+
+struct usb_ctrl_t {
+	uint8_t		module;
+	uint8_t		type;
+};
+
+struct usb_cfg_t {
+	uint8_t		usb_mode;
+	uint8_t		usb_speed;
+};
+
+struct usb_utr_t {
+	uint16_t	ip;
+	usb_er_t	result;
+};
+
+typedef usb_utr_t	usb_msg_t;
+typedef usb_utr_t*	usb_mh_t;
+
+usb_er_t usb_cstd_rec_msg(uint8_t id, usb_msg_t** mess, uint16_t tm);
+usb_er_t usb_cstd_rel_blk(uint8_t id, usb_utr_t* blk);
+
+#define USB_TRCV_MSG(ID, MESS, TM)	usb_cstd_rec_msg((uint8_t)(ID), (usb_msg_t**)(MESS), (uint16_t)(TM))
+#define USB_REL_BLK(ID, BLK)		usb_cstd_rel_blk((uint8_t)(ID), (usb_utr_t*)(BLK))
+
+uint8_t usb_cstd_check_schedule(void);
+void usb_cstd_scheduler(void);
+void usb_hstd_hcd_task(usb_vp_int_t);
+void usb_hstd_mgr_task(usb_vp_int_t);
+void usb_hhub_task(usb_vp_int_t);
+void R_USB_HmscTask(void);
+
+usb_err_t R_USB_Open(usb_ctrl_t* ctrl, usb_cfg_t* cfg);
+usb_status_t R_USB_GetEvent(usb_ctrl_t* ctrl);
+usb_err_t R_USB_HmscGetDriveNo(usb_ctrl_t* ctrl, uint8_t* drvno);
+uint16_t R_USB_HmscGetDevSts(uint16_t side);
+void usb_hmsc_smp_drive2_addr(uint16_t side, usb_utr_t* devadr);
+usb_er_t R_USB_HmscStrgReadSector(usb_utr_t* ptr, uint16_t side, uint8_t* buff, uint32_t secno,
+	uint16_t seccnt, uint32_t trans_byte);
+usb_er_t R_USB_HmscStrgWriteSector(usb_utr_t* ptr, uint16_t side, uint8_t* buff, uint32_t secno,
+	uint16_t seccnt, uint32_t trans_byte);
@@ -0,0 +1,3 @@
+#pragma once
+// ホスト・テスト用、r_usb_hmsc.h に纏める
+#include "r_usb_hmsc.h"
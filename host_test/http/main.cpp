@@ -0,0 +1,516 @@
+//=====================================================================//
+/*!	@file
+	@brief	http_server 負荷テスト（モック・イーサーネット） @n
+			キープ・アライブ、パイプライン、条件付き GET（304）、gzip、@n
+			後のセグメントで届く POST ボディー、413/404 を検査し、@n
+			同時接続でのリクエスト／秒と p99 レイテンシを表示する
+    @author 平松邦仁 (hira@rvf-rc45.net)
+	@copyright	Copyright (C) 2021 Kunihito Hiramatsu @n
+				Released under the MIT license @n
+				https://github.com/hirakuni45/RX/blob/master/LICENSE
+*/
+//=====================================================================//
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <sys/stat.h>
+#include <utime.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "test.hpp"
+#include "host_stub.hpp"
+#include "net2/http_server.hpp"
+
+namespace {
+
+	static const uint32_t SLOT_NUM = 4;
+	static const time_t FILE_TIME = 1616502919;  // 2021-03-23 12:35:19 UTC
+
+	/// TCP ディスクリプタ毎の状態（サーバー側から見た接続）
+	struct conn_t {
+		bool		open_;
+		bool		listen_;
+		bool		connected_;
+		std::string	in_;	///< クライアント → サーバー
+		std::string	out_;	///< サーバー → クライアント
+		conn_t() : open_(false), listen_(false), connected_(false) { }
+	};
+	conn_t	conn_[SLOT_NUM];
+
+
+	struct tcp_mock {
+		bool open(void*, uint16_t, void*, uint16_t, uint32_t& desc) {
+			for(uint32_t i = 0; i < SLOT_NUM; ++i) {
+				if(!conn_[i].open_) {
+					conn_[i].open_ = true;
+					desc = i;
+					return true;
+				}
+			}
+			return false;
+		}
+		bool start(uint32_t desc, const net::ip_adrs&, uint16_t, bool) {
+			conn_[desc].listen_ = true;
+			return true;
+		}
+		bool close(uint32_t desc) {
+			conn_[desc] = conn_t();
+			return true;
+		}
+		bool connected(uint32_t desc) const { return conn_[desc].connected_; }
+		int recv(uint32_t desc, void* dst, uint16_t len) {
+			auto& in = conn_[desc].in_;
+			uint32_t n = std::min<uint32_t>(len, in.size());
+			std::memcpy(dst, in.data(), n);
+			in.erase(0, n);
+			return n;
+		}
+		int send(uint32_t desc, const void* src, uint16_t len) {
+			conn_[desc].out_.append(static_cast<const char*>(src), len);
+			return len;
+		}
+		int get_send_length(uint32_t) const { return 0; }
+		const net::ip_adrs& get_ip(uint32_t) const { static net::ip_adrs a; return a; }
+	};
+
+	struct ipv4_mock {
+		tcp_mock	tcp_;
+		tcp_mock& at_tcp() { return tcp_; }
+	};
+
+	struct info_mock {
+		net::ip_adrs	ip;
+	};
+
+	struct eth_mock {
+		static const uint32_t TCP_OPEN_MAX = SLOT_NUM;
+		ipv4_mock	ipv4_;
+		info_mock	info_;
+		ipv4_mock& at_ipv4() { return ipv4_; }
+		info_mock& at_info() { return info_; }
+	};
+
+	struct sdc_mock {
+		bool probe(const char* path) const {
+			struct stat st;
+			return ::stat(path, &st) == 0;
+		}
+		uint32_t size(const char* path) const {
+			struct stat st;
+			if(::stat(path, &st) != 0) return 0;
+			return st.st_size;
+		}
+		time_t get_time(const char* path) const {
+			struct stat st;
+			if(::stat(path, &st) != 0) return 0;
+			return st.st_mtime;
+		}
+	};
+
+	typedef net::http_server<eth_mock, sdc_mock, 16, 4096, SLOT_NUM> HTTP;
+
+	eth_mock	eth_;
+	sdc_mock	sdc_;
+	HTTP		http_(eth_, sdc_);
+
+	std::string	file_body_;
+	std::string	gz_body_;
+	std::string	post_;
+	uint32_t	cgi_count_ = 0;
+
+
+	/// http_server のデバッグ出力（stdout）を捨てる
+	int quiet_(bool on, int org = -1)
+	{
+		std::fflush(stdout);
+		if(on) {
+			int fd = dup(STDOUT_FILENO);
+			int nul = open("/dev/null", O_WRONLY);
+			dup2(nul, STDOUT_FILENO);
+			close(nul);
+			return fd;
+		} else {
+			dup2(org, STDOUT_FILENO);
+			close(org);
+			return -1;
+		}
+	}
+
+
+	/// 応答
+	struct resp_t {
+		int			status_;
+		uint32_t	clen_;
+		bool		close_;
+		bool		gzip_;
+		bool		vary_;
+		std::string	etag_;
+		std::string	lmod_;
+		std::string	body_;
+		resp_t() : status_(0), clen_(0), close_(false), gzip_(false), vary_(false) { }
+	};
+
+
+	std::string header_(const std::string& h, const char* key)
+	{
+		auto p = h.find(std::string("\r\n") + key + ": ");
+		if(p == std::string::npos) return "";
+		p += std::strlen(key) + 4;
+		return h.substr(p, h.find("\r\n", p) - p);
+	}
+
+
+	/// 応答を１つ取り出す、揃っていない場合「false」
+	bool take_(std::string& out, resp_t& r)
+	{
+		auto p = out.find("\r\n\r\n");
+		if(p == std::string::npos) return false;
+		std::string h = out.substr(0, p + 2);
+		r = resp_t();
+		r.clen_ = std::atoi(header_(h, "Content-Length").c_str());
+		if(out.size() < (p + 4 + r.clen_)) return false;
+		r.status_ = std::atoi(h.c_str() + 9);
+		r.close_ = header_(h, "Connection") == "close";
+		r.gzip_ = header_(h, "Content-Encoding") == "gzip";
+		r.vary_ = header_(h, "Vary") == "Accept-Encoding";
+		r.etag_ = header_(h, "ETag");
+		r.lmod_ = header_(h, "Last-Modified");
+		r.body_ = out.substr(p + 4, r.clen_);
+		out.erase(0, p + 4 + r.clen_);
+		return true;
+	}
+
+
+	/// 全てのスロットを待ち受けにして、接続する
+	void connect_all_()
+	{
+		for(int i = 0; i < 200; ++i) {
+			http_.service();
+			bool all = true;
+			for(auto& c : conn_) {
+				if(c.listen_ && !c.connected_) {
+					c.connected_ = true;
+					c.out_.clear();
+				}
+				if(!c.connected_) all = false;
+			}
+			if(all) {
+				http_.service();
+				return;
+			}
+		}
+	}
+
+
+	/// 応答が揃うまでサービスを回す
+	bool wait_(uint32_t desc, resp_t& r, int loop = 100)
+	{
+		for(int i = 0; i < loop; ++i) {
+			if(take_(conn_[desc].out_, r)) return true;
+			http_.service();
+		}
+		return take_(conn_[desc].out_, r);
+	}
+
+
+	std::string get_(const char* path, const char* extra = "")
+	{
+		return std::string("GET ") + path + " HTTP/1.1\r\nHost: rx\r\n" + extra + "\r\n";
+	}
+
+
+	void make_files_()
+	{
+		for(int i = 0; i < 3000; ++i) file_body_ += static_cast<char>('a' + (i * 7) % 26);
+		for(int i = 0; i < 700; ++i) gz_body_ += static_cast<char>(i * 13);
+		auto fp = fopen("http_a.txt", "wb");
+		fwrite(file_body_.data(), 1, file_body_.size(), fp);
+		fclose(fp);
+		fp = fopen("http_a.txt.gz", "wb");
+		fwrite(gz_body_.data(), 1, gz_body_.size(), fp);
+		fclose(fp);
+		struct utimbuf ut;
+		ut.actime = ut.modtime = FILE_TIME;
+		utime("http_a.txt", &ut);
+		utime("http_a.txt.gz", &ut);
+	}
+
+
+	void setup_()
+	{
+		make_files_();
+		http_.start("RX host");
+		http_.set_file("/a.txt", "", "http_a.txt");
+		http_.set_link("/", "Top", [] {
+			HTTP::http_format("<p>hello</p>\n");
+		});
+		http_.set_cgi("/cgi/set.cgi", "", [] {
+			post_ = http_.get_post_body();
+			++cgi_count_;
+			HTTP::http_format::chaout().clear();
+			http_.make_info(200, 2);
+			HTTP::http_format("OK");
+			HTTP::http_format::chaout().flush();
+		});
+		connect_all_();
+	}
+
+
+	void test_get_()
+	{
+		auto& c = conn_[0];
+		resp_t r;
+		c.in_ = get_("/a.txt");
+		CHECK(wait_(0, r));
+		CHECK_EQ(r.status_, 200);
+		CHECK(r.body_ == file_body_);
+		CHECK(!r.gzip_);
+		CHECK(!r.close_);
+		CHECK(r.etag_ == "\"6059e087-bb8\"");
+		CHECK(r.lmod_ == "Tue, 23 Mar 2021 12:35:19 GMT");
+		auto etag = r.etag_;
+		auto lmod = r.lmod_;
+
+		// gzip
+		c.in_ = get_("/a.txt", "Accept-Encoding: gzip, deflate\r\n");
+		CHECK(wait_(0, r));
+		CHECK_EQ(r.status_, 200);
+		CHECK(r.gzip_);
+		CHECK(r.vary_);
+		CHECK(r.body_ == gz_body_);
+		// gzip の表現は、無圧縮と別の ETag
+		CHECK(r.etag_ == "\"6059e087-2bc-gz\"");
+		auto gz_etag = r.etag_;
+
+		// Accept-Encoding は自分の行だけ、q=0 は拒否
+		static const struct { const char* h; bool gz; } ae[] = {
+			{ "Accept-Encoding: identity\r\nUser-Agent: gzip-bot/1\r\n", false },
+			{ "Accept-Encoding: gzip;q=0\r\n", false },
+			{ "Accept-Encoding: gzip; q=0.000, deflate\r\n", false },
+			{ "Accept-Encoding: gzip;q=0.5\r\n", true },
+			{ "Accept-Encoding: deflate, x-gzip\r\n", true },
+			{ "Accept-Encoding: *\r\n", true },
+			{ "Accept-Encoding: *, gzip;q=0\r\n", false },
+			{ "Accept-Encoding: gzipx, br\r\n", false },
+		};
+		for(const auto& a : ae) {
+			c.in_ = get_("/a.txt", a.h);
+			CHECK(wait_(0, r));
+			CHECK_EQ(r.status_, 200);
+			CHECK_EQ(r.gzip_, a.gz);
+			CHECK(r.body_ == (a.gz ? gz_body_ : file_body_));
+			CHECK(r.etag_ == (a.gz ? gz_etag : etag));
+		}
+
+		// If-None-Match は送る表現の ETag とだけ一致する
+		c.in_ = get_("/a.txt", ("Accept-Encoding: gzip\r\nIf-None-Match: " + etag + "\r\n").c_str());
+		CHECK(wait_(0, r));
+		CHECK_EQ(r.status_, 200);
+		CHECK(r.gzip_);
+		c.in_ = get_("/a.txt", ("Accept-Encoding: gzip\r\nIf-None-Match: " + gz_etag + "\r\n").c_str());
+		CHECK(wait_(0, r));
+		CHECK_EQ(r.status_, 304);
+		CHECK(r.vary_);
+		c.in_ = get_("/a.txt", ("If-None-Match: " + gz_etag + "\r\n").c_str());
+		CHECK(wait_(0, r));
+		CHECK_EQ(r.status_, 200);
+		CHECK(!r.gzip_);
+
+		// 条件付き GET
+		c.in_ = get_("/a.txt", ("If-None-Match: " + etag + "\r\n").c_str());
+		CHECK(wait_(0, r));
+		CHECK_EQ(r.status_, 304);
+		CHECK_EQ(r.clen_, 0u);
+		c.in_ = get_("/a.txt", ("If-Modified-Since: " + lmod + "\r\n").c_str());
+		CHECK(wait_(0, r));
+		CHECK_EQ(r.status_, 304);
+		c.in_ = get_("/a.txt", "If-None-Match: \"0-0\"\r\n");
+		CHECK(wait_(0, r));
+		CHECK_EQ(r.status_, 200);
+
+		// リンク、404
+		c.in_ = get_("/");
+		CHECK(wait_(0, r));
+		CHECK_EQ(r.status_, 200);
+		CHECK(r.body_.find("<p>hello</p>") != std::string::npos);
+		CHECK(r.body_.find("</html>") != std::string::npos);
+		c.in_ = get_("/none");
+		CHECK(wait_(0, r));
+		CHECK_EQ(r.status_, 404);
+		CHECK(!r.close_);
+		CHECK(c.connected_);
+	}
+
+
+	void test_pipeline_()
+	{
+		auto& c = conn_[1];
+		c.in_ = get_("/a.txt") + get_("/") + get_("/a.txt", "Accept-Encoding: gzip\r\n");
+		resp_t r;
+		CHECK(wait_(1, r));
+		CHECK(r.status_ == 200 && r.body_ == file_body_);
+		CHECK(wait_(1, r));
+		CHECK(r.status_ == 200 && r.body_.find("hello") != std::string::npos);
+		CHECK(wait_(1, r));
+		CHECK(r.status_ == 200 && r.body_ == gz_body_);
+		CHECK(c.out_.empty());
+	}
+
+
+	/// POST のボディーがヘッダーより後のセグメントで届く場合
+	void test_post_split_()
+	{
+		auto& c = conn_[2];
+		std::string body = "name=abc%21&v=1+2";
+		std::string head = "POST /cgi/set.cgi HTTP/1.1\r\nHost: rx\r\nContent-Type: "
+			"application/x-www-form-urlencoded\r\nContent-Length: "
+			+ std::to_string(body.size()) + "\r\n\r\n";
+		// ヘッダーも途中で切る
+		c.in_ = head.substr(0, 20);
+		for(int i = 0; i < 5; ++i) http_.service();
+		c.in_ = head.substr(20);
+		for(int i = 0; i < 5; ++i) http_.service();
+		CHECK(c.out_.empty());
+		CHECK_EQ(cgi_count_, 0u);
+		c.in_ = body.substr(0, 5);
+		for(int i = 0; i < 5; ++i) http_.service();
+		CHECK(c.out_.empty());
+		c.in_ = body.substr(5);
+		resp_t r;
+		CHECK(wait_(2, r));
+		CHECK_EQ(r.status_, 200);
+		CHECK(r.body_ == "OK");
+		CHECK_EQ(cgi_count_, 1u);
+		CHECK(post_ == "name=abc!&v=1 2");
+		// CGI の後は切断
+		for(int i = 0; i < 50; ++i) http_.service();
+		CHECK(!c.connected_);
+	}
+
+
+	void test_limit_()
+	{
+		connect_all_();
+		auto& c = conn_[3];
+		c.in_ = "POST /cgi/set.cgi HTTP/1.1\r\nContent-Length: 100000\r\n\r\n";
+		resp_t r;
+		CHECK(wait_(3, r));
+		CHECK_EQ(r.status_, 413);
+		CHECK(r.close_);
+		for(int i = 0; i < 50; ++i) http_.service();
+		CHECK(!c.connected_);
+
+		// 最大リクエスト数で切断
+		connect_all_();
+		http_.set_keep_alive(15, 3);
+		c.in_ = get_("/") + get_("/") + get_("/");
+		CHECK(wait_(3, r));
+		CHECK(!r.close_);
+		CHECK(wait_(3, r));
+		CHECK(!r.close_);
+		CHECK(wait_(3, r));
+		CHECK(r.close_);
+		for(int i = 0; i < 50; ++i) http_.service();
+		CHECK(!c.connected_);
+		http_.set_keep_alive(15, 100);
+		// Connection: close
+		connect_all_();
+		c.in_ = get_("/", "Connection: close\r\n");
+		CHECK(wait_(3, r));
+		CHECK(r.close_);
+		for(int i = 0; i < 50; ++i) http_.service();
+		CHECK(!c.connected_);
+		connect_all_();
+	}
+
+
+	/// 同時接続の負荷
+	void bench_()
+	{
+		typedef std::chrono::steady_clock clock;
+		struct client_t {
+			std::vector<clock::time_point>	sent_;
+			uint32_t	round_;
+			bool		close_;		///< サーバーの切断待ち
+			client_t() : round_(0), close_(false) { }
+		};
+		client_t cl[SLOT_NUM];
+		std::vector<double> lat;
+		static const uint32_t ROUND = 2000;
+		uint32_t done = 0;
+		uint32_t errs = 0;
+		std::string etag = "\"6059e087-bb8\"";
+		test::stopwatch sw;
+		while(done < (ROUND * SLOT_NUM * 3)) {
+			for(uint32_t i = 0; i < SLOT_NUM; ++i) {
+				auto& c = conn_[i];
+				auto& t = cl[i];
+				if(!c.connected_) {
+					if(!t.sent_.empty()) {  // 応答の途中で切断された
+						errs += t.sent_.size();
+						t.sent_.clear();
+					}
+					t.close_ = false;
+					if(c.listen_) c.connected_ = true;
+				}
+				if(!c.connected_ || t.close_ || !t.sent_.empty() || t.round_ >= ROUND) continue;
+				// ３つのリクエストをパイプラインで送る、１０回に１回は切断を要求
+				const char* conn = (t.round_ % 10) == 9 ? "Connection: close\r\n" : "";
+				c.in_ += get_("/a.txt", "Accept-Encoding: gzip\r\n")
+					+ get_("/a.txt", ("If-None-Match: " + etag + "\r\n").c_str())
+					+ get_("/", conn);
+				auto now = clock::now();
+				t.sent_.assign(3, now);
+				++t.round_;
+			}
+			http_.service();
+			for(uint32_t i = 0; i < SLOT_NUM; ++i) {
+				auto& t = cl[i];
+				resp_t r;
+				while(!t.sent_.empty() && take_(conn_[i].out_, r)) {
+					static const int expect[3] = { 200, 304, 200 };
+					if(r.status_ != expect[3 - t.sent_.size()]) ++errs;
+					if(r.close_) t.close_ = true;
+					lat.push_back(std::chrono::duration<double>(clock::now() - t.sent_.front()).count());
+					t.sent_.erase(t.sent_.begin());
+					++done;
+				}
+			}
+			if(sw.sec() > 30.0) break;
+		}
+		auto sec = sw.sec();
+		CHECK_EQ(done, ROUND * SLOT_NUM * 3);
+		CHECK_EQ(errs, 0u);
+		std::sort(lat.begin(), lat.end());
+		double p50 = lat.empty() ? 0 : lat[lat.size() / 2];
+		double p99 = lat.empty() ? 0 : lat[lat.size() * 99 / 100];
+		std::fprintf(stderr, "bench: %u slots, %u requests, %.0f requests/s, p50 %.1f us, p99 %.1f us, connections %u\n",
+			SLOT_NUM, done, done / sec, p50 * 1e6, p99 * 1e6, http_.get_count());
+	}
+}
+
+
+extern "C" {
+
+	time_t get_time() { return FILE_TIME + 3600; }
+
+	int tcp_send(uint32_t desc, const void* src, uint32_t len)
+	{
+		conn_[desc].out_.append(static_cast<const char*>(src), len);
+		return len;
+	}
+}
+
+
+int main(int argc, char* argv[])
+{
+	auto org = quiet_(true);
+	setup_();
+	test_get_();
+	test_pipeline_();
+	test_post_split_();
+	test_limit_();
+	bench_();
+	quiet_(false, org);
+	return test::result("http");
+}
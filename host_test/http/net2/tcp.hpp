@@ -0,0 +1,12 @@
+#pragma once
+//=====================================================================//
+/*!	@file
+	@brief	ホスト・テスト用 net2/tcp.hpp の代用 @n
+			desc_string（udp_tcp_common.hpp）だけを使い、TCP はテスト側のモック
+    @author 平松邦仁 (hira@rvf-rc45.net)
+	@copyright	Copyright (C) 2021 Kunihito Hiramatsu @n
+				Released under the MIT license @n
+				https://github.com/hirakuni45/RX/blob/master/LICENSE
+*/
+//=====================================================================//
+#include "net2/udp_tcp_common.hpp"
@@ -0,0 +1,421 @@
+//=====================================================================//
+/*!	@file
+	@brief	HUB75 テスト（模擬ポート・シンク） @n
+			chip::HUB75 をモックのポート、CMT、DMAC で動かし、パネル側で @n
+			シフト、ラッチ、/OE 期間を積分して BCM の重みとタイミングを検査する。@n
+			最後にエンコードの時間を表示する
+    @author 平松邦仁 (hira@rvf-rc45.net)
+	@copyright	Copyright (C) 2021 Kunihito Hiramatsu @n
+				Released under the MIT license @n
+				https://github.com/hirakuni45/RX/blob/master/LICENSE
+*/
+//=====================================================================//
+#include <vector>
+#include "test.hpp"
+#include "chip/HUB75.hpp"
+
+namespace {
+
+	static const uint32_t WIDTH  = 64;
+	static const uint32_t HEIGHT = 64;
+
+	typedef chip::hub75_encoder<WIDTH, HEIGHT, 8> ENC;
+
+	/// パネルとタイマー、DMA の模擬
+	struct sim_t {
+		const ENC*	enc_ = nullptr;
+		uint64_t	now_ = 0;
+
+		// DMA（１ワード／１カウント）
+		bool		dma_act_ = false;
+		uint64_t	dma_end_ = 0;
+		uint32_t	dma_src_ = 0;
+		uint32_t	dma_len_ = 0;
+
+		// 表示時間タイマー
+		bool		tm_act_ = false;
+		uint64_t	tm_end_ = 0;
+		uint32_t	cmcor_ = 0;
+
+		// パネル
+		uint8_t		last_ = 0;
+		std::vector<uint8_t>	shreg_;
+		uint8_t		latch_[WIDTH] = { };
+		uint32_t	row_ = 0;
+		bool		lat_ = false;
+		bool		oe_ = true;		// /OE（true で消灯）
+		uint64_t	oe_org_ = 0;
+
+		// 表示したラインの履歴
+		struct line_t {
+			uint32_t	buf;
+			uint32_t	plane;
+			uint32_t	row;
+		};
+		line_t		shift_line_ = { };
+		line_t		latch_line_ = { };
+		std::vector<line_t>	lines_;
+
+		std::vector<double>	acc_;	// [y][x][rgb] の点灯時間
+
+		uint32_t	err_edge_ = 0;		// １行のクロック数の間違い
+		uint32_t	err_ghost_ = 0;		// 点灯中のラッチ、行変更
+		uint32_t	err_dma_ = 0;		// 転送中の再起動
+
+		sim_t() : acc_(WIDTH * HEIGHT * 3, 0.0) { }
+
+		// DMA の転送元アドレス（下位 32 ビット）からエンコーダー内のラインを得る
+		const uint8_t* ptr_(uint32_t src, line_t& l) const {
+			auto base = reinterpret_cast<uintptr_t>(enc_);
+			auto p = reinterpret_cast<const uint8_t*>(base + static_cast<uint32_t>(src - static_cast<uint32_t>(base)));
+			// 表示面の先頭から、面０の先頭を求める（面１の後には ２面分の余地が無い）
+			auto f0 = enc_->get_line(0, 0);
+			auto end = reinterpret_cast<const uint8_t*>(enc_ + 1);
+			auto b0 = (f0 + 2 * ENC::FRAME) <= end ? f0 : f0 - ENC::FRAME;
+			uint32_t ofs = p - b0;
+			l.buf = ofs / ENC::FRAME;
+			l.plane = (ofs % ENC::FRAME) / ENC::PLANE;
+			l.row = (ofs % ENC::PLANE) / ENC::LINE;
+			if((ofs % ENC::LINE) != 0 || l.buf > 1) l.buf = 99;
+			return p;
+		}
+
+		void dma_start(uint32_t src, uint32_t len) {
+			if(dma_act_) ++err_dma_;
+			dma_src_ = src;
+			dma_len_ = len;
+			dma_act_ = true;
+			dma_end_ = now_ + len;
+			// パネルのシフト・レジスタへ（点灯とは独立）
+			auto p = ptr_(src, shift_line_);
+			uint32_t edge = 0;
+			shreg_.clear();
+			for(uint32_t i = 0; i < len; ++i) {
+				uint8_t w = p[i];
+				if(!(last_ & chip::hub75_bits::CLK) && (w & chip::hub75_bits::CLK)) {
+					shreg_.push_back(w & 0x3f);
+					++edge;
+				}
+				last_ = w;
+			}
+			if(edge != WIDTH) ++err_edge_;
+		}
+
+		void lat(bool v) {
+			if(v && !lat_) {
+				if(!oe_) ++err_ghost_;
+				for(uint32_t x = 0; x < WIDTH && x < shreg_.size(); ++x) latch_[x] = shreg_[x];
+				latch_line_ = shift_line_;
+			}
+			lat_ = v;
+		}
+
+		void adr(uint32_t v) {
+			if(!oe_) ++err_ghost_;
+			row_ = v;
+		}
+
+		void oe(bool v) {
+			if(!v && oe_) {
+				oe_org_ = now_;
+				lines_.push_back(latch_line_);
+			} else if(v && !oe_) {
+				double t = static_cast<double>(now_ - oe_org_);
+				for(uint32_t x = 0; x < WIDTH; ++x) {
+					auto w = latch_[x];
+					for(uint32_t c = 0; c < 3; ++c) {
+						if(w & (1 << c)) acc_[(row_ * WIDTH + x) * 3 + c] += t;
+						if(w & (8 << c)) acc_[((row_ + ENC::ROWS) * WIDTH + x) * 3 + c] += t;
+					}
+				}
+			}
+			oe_ = v;
+		}
+
+		void timer_start() {
+			tm_act_ = true;
+			tm_end_ = now_ + cmcor_ + 1;
+		}
+
+		void clear_acc() {
+			for(auto& a : acc_) a = 0.0;
+			lines_.clear();
+		}
+	};
+	sim_t	sim_;
+
+
+	// ポートのモック
+	struct bit_t {
+		void (*fn_)(bool);
+		void operator = (uint8_t v) { if(fn_ != nullptr) fn_(v != 0); }
+	};
+
+	struct LAT_PORT {
+		static bit_t	DIR;
+		static bit_t	P;
+	};
+	bit_t LAT_PORT::DIR = { nullptr };
+	bit_t LAT_PORT::P = { [](bool v) { sim_.lat(v); } };
+
+	struct OE_PORT {
+		static bit_t	DIR;
+		static bit_t	P;
+	};
+	bit_t OE_PORT::DIR = { nullptr };
+	bit_t OE_PORT::P = { [](bool v) { sim_.oe(v); } };
+
+	struct ADR_PORT {
+		static void init() { }
+		static void out(uint32_t v) { sim_.adr(v); }
+	};
+
+	struct reg_t {
+		uint32_t	v_ = 0;
+		void operator = (uint32_t v) { v_ = v; }
+		uint32_t address() const { return 0x0008c020; }
+	};
+
+	struct DATA_PORT {
+		static reg_t	PODR;
+		static reg_t	PDR;
+	};
+	reg_t DATA_PORT::PODR;
+	reg_t DATA_PORT::PDR;
+
+	struct CMT_MOCK {
+		struct cmcor_t { void operator = (uint32_t v) { sim_.cmcor_ = v; } };
+		struct cmcnt_t { void operator = (uint32_t) { sim_.timer_start(); } };
+		static cmcor_t	CMCOR;
+		static cmcnt_t	CMCNT;
+	};
+	CMT_MOCK::cmcor_t CMT_MOCK::CMCOR;
+	CMT_MOCK::cmcnt_t CMT_MOCK::CMCNT;
+
+	struct DMAC_MOCK {
+		struct dmcnt_t {
+			struct dte_t {
+				void operator = (uint32_t v) { if(v) sim_.dma_start(DMSAR.v_, DMCRA.v_ & 0x3ff); }
+			} DTE;
+		};
+		static dmcnt_t	DMCNT;
+		static reg_t	DMSAR;
+		static reg_t	DMCRA;
+		static reg_t	DMCRB;
+	};
+	DMAC_MOCK::dmcnt_t DMAC_MOCK::DMCNT;
+	reg_t DMAC_MOCK::DMSAR;
+	reg_t DMAC_MOCK::DMCRA;
+	reg_t DMAC_MOCK::DMCRB;
+
+	struct DMA_MGR {
+		typedef DMAC_MOCK value_type;
+		enum class trans_type { SP_DN_8 };
+		bool start(int trg, trans_type, uint32_t src, uint32_t dst, uint32_t len, uint8_t lvl, bool) {
+			if(dst != DATA_PORT::PODR.address()) return false;
+			sim_.dma_start(src, len);
+			return true;
+		}
+	};
+
+	typedef chip::HUB75<DATA_PORT, LAT_PORT, OE_PORT, ADR_PORT, DMA_MGR, CMT_MOCK, ENC> HUB;
+
+	ENC		enc_;
+	DMA_MGR	dma_;
+	HUB		hub_(dma_, enc_);
+
+	uint16_t	fb_[2][WIDTH * HEIGHT];
+
+
+	/// イベント（DMA 完了、タイマー）を時間順に処理して、指定フレーム数進める
+	void run_(uint32_t frames)
+	{
+		auto end = hub_.at_scan().get_frame() + frames;
+		while(hub_.at_scan().get_frame() < end) {
+			bool d = sim_.dma_act_;
+			bool t = sim_.tm_act_;
+			if(!d && !t) break;  // 停止
+			if(d && (!t || sim_.dma_end_ <= sim_.tm_end_)) {
+				sim_.now_ = sim_.dma_end_;
+				sim_.dma_act_ = false;
+				hub_.dma_task();
+			} else {
+				sim_.now_ = sim_.tm_end_;
+				sim_.tm_act_ = false;
+				hub_.timer_task();
+			}
+		}
+	}
+
+
+	uint8_t expand_(uint16_t c, uint32_t ch)
+	{
+		switch(ch) {
+		case 0: { uint8_t v = (c >> 11) & 0x1f; return (v << 3) | (v >> 2); }
+		case 1: { uint8_t v = (c >> 5) & 0x3f; return (v << 2) | (v >> 4); }
+		default: { uint8_t v = c & 0x1f; return (v << 3) | (v >> 2); }
+		}
+	}
+
+
+	/// 点灯時間を検査（depth プレーン、最下位の時間 base、frames フレーム分）
+	uint32_t verify_(const uint16_t* fb, uint32_t depth, uint32_t base, uint32_t frames)
+	{
+		uint32_t bad = 0;
+		uint32_t low = ENC::DEPTH_ - depth;
+		for(uint32_t i = 0; i < WIDTH * HEIGHT; ++i) {
+			for(uint32_t c = 0; c < 3; ++c) {
+				double e = static_cast<double>((enc_.get_gamma(expand_(fb[i], c)) >> low) * base * frames);
+				if(sim_.acc_[i * 3 + c] != e) ++bad;
+			}
+		}
+		return bad;
+	}
+
+
+	void make_fb_()
+	{
+		for(uint32_t y = 0; y < HEIGHT; ++y) {
+			for(uint32_t x = 0; x < WIDTH; ++x) {
+				uint32_t r = x * 4;
+				uint32_t g = y * 4;
+				uint32_t b = (x + y) * 2;
+				fb_[0][y * WIDTH + x] = ((r & 0xf8) << 8) | ((g & 0xfc) << 3) | (b >> 3);
+				fb_[1][y * WIDTH + x] = ((255 - r) & 0xf8) << 8 | (b >> 3);
+			}
+		}
+	}
+
+
+	void test_scan_()
+	{
+		static const uint32_t BASE = 4;
+		static const uint32_t SHIFT = ENC::LINE;
+		sim_.enc_ = &enc_;
+		make_fb_();
+		enc_.encode(fb_[0], WIDTH);
+		enc_.swap();
+		hub_.at_scan().set_depth(8, BASE);
+		CHECK(hub_.start(0, 2));
+
+		// 最初のフレームの境目で面が切り替わる
+		// （run_ はラッチで止まるので、積分はラッチ１回分ずれる、前のフレームも同じ画像にしておく）
+		run_(2);
+		sim_.clear_acc();
+		auto t0 = sim_.now_;
+		run_(2);
+		auto ft8 = hub_.at_scan().get_frame_time(SHIFT);
+		CHECK_EQ(sim_.now_ - t0, 2ull * ft8);
+		CHECK_EQ(verify_(fb_[0], 8, BASE, 2), 0u);
+		CHECK_EQ(sim_.lines_.size(), 2u * 8 * ENC::ROWS);
+
+		// 行毎に下位プレーンから、行の中では連続する
+		bool order = true;
+		for(uint32_t i = 0; i < sim_.lines_.size(); ++i) {
+			const auto& l = sim_.lines_[i];
+			uint32_t n = i % (8 * ENC::ROWS);
+			if(l.plane != (n % 8) || l.row != (n / 8)) order = false;
+		}
+		CHECK(order);
+
+		// 階調を減らすと、フレーム時間が短くなる
+		hub_.at_scan().set_depth(6, BASE);
+		run_(1);  // 途中から切り替わるフレームは捨てる
+		sim_.clear_acc();
+		t0 = sim_.now_;
+		run_(3);
+		auto ft6 = hub_.at_scan().get_frame_time(SHIFT);
+		CHECK_EQ(sim_.now_ - t0, 3ull * ft6);
+		CHECK(ft6 < ft8);
+		CHECK_EQ(verify_(fb_[0], 6, BASE, 3), 0u);
+		// 転送時間がプレーンの表示時間より長い場合、転送時間で決まる
+		CHECK_EQ(ft6, ENC::ROWS * (SHIFT * 5 + BASE * 32));
+
+		// ダブル・バッファ：切り替えはフレームの境目だけ
+		hub_.at_scan().set_depth(8, BASE);
+		run_(1);
+		enc_.encode(fb_[1], WIDTH);
+		enc_.swap();
+		sim_.clear_acc();
+		run_(3);
+		uint32_t per = 8 * ENC::ROWS;
+		bool tear = false;
+		uint32_t swaps = 0;
+		for(uint32_t i = 1; i < sim_.lines_.size(); ++i) {
+			if(sim_.lines_[i].buf != sim_.lines_[i - 1].buf) {
+				++swaps;
+				if((i % per) != 0) tear = true;
+			}
+		}
+		CHECK(!tear);
+		CHECK_EQ(swaps, 1u);
+		CHECK(!enc_.is_swap());
+
+		CHECK_EQ(sim_.err_edge_, 0u);
+		CHECK_EQ(sim_.err_ghost_, 0u);
+		CHECK_EQ(sim_.err_dma_, 0u);
+	}
+
+
+	void test_encode_()
+	{
+		// RGB888 と RGB565 は、同じ値で同じプレーンになる
+		static uint32_t fb32[WIDTH * HEIGHT];
+		static uint16_t fb16[WIDTH * HEIGHT];
+		for(uint32_t i = 0; i < WIDTH * HEIGHT; ++i) {
+			uint8_t r = (i * 8) & 0xf8;
+			uint8_t g = (i * 4) & 0xfc;
+			uint8_t b = (i * 24) & 0xf8;
+			fb16[i] = ((r & 0xf8) << 8) | ((g & 0xfc) << 3) | (b >> 3);
+			fb32[i] = (static_cast<uint32_t>(r | (r >> 5)) << 16)
+				| (static_cast<uint32_t>(g | (g >> 6)) << 8) | (b | (b >> 5));
+		}
+		static ENC a;
+		static ENC b;
+		a.encode(fb16, WIDTH);
+		a.swap();
+		a.frame_end();
+		b.encode(fb32, WIDTH);
+		b.swap();
+		b.frame_end();
+		bool same = true;
+		for(uint32_t p = 0; p < 8; ++p) {
+			for(uint32_t r = 0; r < ENC::ROWS; ++r) {
+				if(std::memcmp(a.get_line(p, r), b.get_line(p, r), ENC::LINE) != 0) same = false;
+			}
+		}
+		CHECK(same);
+		CHECK_EQ(a.get_gamma(0), 0);
+		CHECK_EQ(a.get_gamma(255), 255);
+		a.set_gamma(1.0f);
+		CHECK_EQ(a.get_gamma(128), 128);
+	}
+
+
+	template <uint32_t W, uint32_t H>
+	void bench_()
+	{
+		typedef chip::hub75_encoder<W, H, 8> E;
+		static E enc;
+		static uint16_t fb[W * H];
+		for(uint32_t i = 0; i < W * H; ++i) fb[i] = i * 2654435761u >> 16;
+		static const uint32_t N = 2000;
+		test::stopwatch sw;
+		for(uint32_t i = 0; i < N; ++i) {
+			fb[i % (W * H)] ^= 0x1234;
+			enc.encode(fb, W);
+		}
+		auto t = sw.sec();
+		std::printf("bench: encode %ux%u RGB565: %.1f us/frame (%.0f fps)\n", W, H, t / N * 1e6, N / t);
+	}
+}
+
+
+int main(int argc, char* argv[])
+{
+	test_scan_();
+	test_encode_();
+	bench_<64, 32>();
+	bench_<64, 64>();
+	return test::result("hub75");
+}
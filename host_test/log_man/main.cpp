@@ -0,0 +1,222 @@
+//=====================================================================//
+/*!	@file
+	@brief	log_man、トレース・レコード・テスト @n
+			トレース・レコードの復元（フォーマット適用）、折り返し、@n
+			書き込み途中の電源断の後に全レコードが読める事、範囲外 ID の扱いを検査する。@n
+			sformat + puts（テキスト記録）とトレース記録の速度を比較する
+    @author 平松邦仁 (hira@rvf-rc45.net)
+	@copyright	Copyright (C) 2021 Kunihito Hiramatsu @n
+				Released under the MIT license @n
+				https://github.com/hirakuni45/RX/blob/master/LICENSE
+*/
+//=====================================================================//
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include "test.hpp"
+#include "host_stub.hpp"
+#include "common/log_man.hpp"
+
+namespace {
+
+	//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+	/*!
+		@brief	バックアップ RAM のモデル @n
+				cut_ 回目の書き込みは半分だけ書いて電源断、以降の書き込みは何もしない
+	*/
+	//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+	struct ram_mem {
+		static const uint32_t SIZE = 8192;
+		static inline uint8_t	buf_[SIZE];
+		static inline int		cut_ = -1;
+		static inline bool		dead_ = false;
+
+		static void start() { }
+
+		static uint32_t copy(const void* src, uint32_t len, uint32_t dst) {
+			if(dst >= SIZE || len > SIZE || src == nullptr) return 0;
+			if((dst + len) > SIZE) len = SIZE - dst;
+			if(dead_) return len;
+			if(cut_ > 0 && --cut_ == 0) {
+				std::memcpy(buf_ + dst, src, len / 2);
+				dead_ = true;
+				return len;
+			}
+			std::memcpy(buf_ + dst, src, len);
+			return len;
+		}
+
+		static uint32_t copy(uint32_t src, uint32_t len, void* dst) {
+			if(dst == nullptr || src >= SIZE || len > SIZE) return 0;
+			if((src + len) > SIZE) len = SIZE - src;
+			std::memcpy(dst, buf_ + src, len);
+			return len;
+		}
+	};
+
+	struct tick_t {
+		static inline uint32_t	cnt_ = 0;
+		static uint32_t get_counter() { return ++cnt_; }
+	};
+
+	typedef utils::log_man<ram_mem, tick_t> LOG;
+
+	static const char* name_ = "motor";
+
+
+	std::string render_(const LOG::record_t& r)
+	{
+		char tmp[512];
+		if(r.id == LOG::TEXT_ID) return r.text;
+		if(LOG::get_format(r) == nullptr) return "";
+		utils::sformat f(LOG::get_format(r), tmp, sizeof(tmp));
+		LOG::apply(f, r);
+		return std::string(tmp, f.size());
+	}
+
+
+	std::vector<std::string> list_(const LOG& log)
+	{
+		std::vector<std::string> v;
+		uint16_t ofs = 0;
+		LOG::record_t r;
+		while(log.get_record(ofs, r)) v.push_back(render_(r));
+		return v;
+	}
+
+
+	void test_record_()
+	{
+		LOG log;
+		CHECK(!log.start());
+		LOG_TRACE(log, "ctrl %d: %u %x %s %5.2f%%", -12, 34u, 0xBEEF, name_, 1.5);
+		LOG_TRACE(log, "no args");
+		log.puts("hello\n");
+		for(const char* p = "line\n"; *p != 0; ++p) log.putch(*p);
+		auto v = list_(log);
+		CHECK_EQ(v.size(), 4u);
+		if(v.size() == 4) {
+			CHECK(v[0] == "ctrl -12: 34 beef motor  1.50%");
+			CHECK(v[1] == "no args");
+			CHECK(v[2] == "hello\n");
+			CHECK(v[3] == "line\n");
+		}
+		CHECK_EQ(log.get_drop(), 0u);
+
+		// 再起動後も残る
+		LOG l2;
+		CHECK(l2.start());
+		CHECK_EQ(l2.get_length(), log.get_length());
+
+		// log_fmt セクション外のフォーマットは記録しない
+		auto len = log.get_length();
+		log.trace("not in log_fmt %d", 1);
+		log.trace(__stop_log_fmt);
+		CHECK_EQ(log.get_length(), len);
+		CHECK_EQ(log.get_drop(), 2u);
+	}
+
+
+	/// 折り返しても、最後のレコードまで連続している
+	void test_wrap_()
+	{
+		static const uint32_t N = 20000;
+		LOG log;
+		log.start();
+		log.clear();
+		for(uint32_t i = 0; i < N; ++i) {
+			if((i % 3) == 0) LOG_TRACE(log, "seq %u", i);
+			else if((i % 3) == 1) LOG_TRACE(log, "seq %u %d %d %d %d", i, 1, 2, 3, 4);
+			else {
+				char tmp[32];
+				utils::sformat("seq %u\n", tmp, sizeof(tmp)) % i;
+				log.puts(tmp);
+			}
+		}
+		uint16_t ofs = 0;
+		LOG::record_t r;
+		uint32_t n = 0;
+		uint32_t last = 0;
+		bool seq = true;
+		while(log.get_record(ofs, r)) {
+			uint32_t s = (r.id == LOG::TEXT_ID) ? std::atoi(r.text + 4) : r.arg[0];
+			if(n > 0 && s != (last + 1)) seq = false;
+			last = s;
+			++n;
+		}
+		std::printf("wrap: %u records kept, %u dropped, %u bytes\n", n, log.get_drop(), log.get_length());
+		CHECK(seq);
+		CHECK_EQ(last, N - 1);
+		CHECK_EQ(ofs, log.get_length());
+		CHECK_EQ(n + log.get_drop(), N);
+	}
+
+
+	/// 書き込み途中の電源断：再起動後、全レコードが読める
+	void test_power_cut_()
+	{
+		uint32_t cuts = 0;
+		uint32_t broken = 0;
+		for(uint32_t k = 0; k < 2000; ++k) {
+			{
+				LOG l;
+				l.start();
+				ram_mem::cut_ = 1 + std::rand() % 40;
+				for(uint32_t i = 0; i < 200 && !ram_mem::dead_; ++i) LOG_TRACE(l, "cut %u %u", i, k);
+			}
+			if(ram_mem::dead_) ++cuts;
+			ram_mem::cut_ = -1;
+			ram_mem::dead_ = false;
+
+			LOG r;
+			uint16_t ofs = 0;
+			LOG::record_t rec;
+			bool ok = r.start();
+			while(r.get_record(ofs, rec)) ;
+			if(!ok || ofs != r.get_length()) ++broken;
+		}
+		std::printf("power cut: %u cuts, broken %u\n", cuts, broken);
+		CHECK(cuts > 1000);
+		CHECK_EQ(broken, 0u);
+	}
+
+
+	void bench_()
+	{
+		static const uint32_t N = 200000;
+		LOG log;
+		log.start();
+		log.clear();
+		char tmp[128];
+		uint32_t bytes = 0;
+		test::stopwatch sw;
+		for(uint32_t i = 0; i < N; ++i) {
+			utils::sformat("ctrl %d: %u %x %5.2f\n", tmp, sizeof(tmp)) % static_cast<int>(i)
+				% (i * 3) % i % (i * 0.01f);
+			bytes += std::strlen(tmp);
+			log.puts(tmp);
+		}
+		auto t0 = sw.sec();
+		log.clear();
+		test::stopwatch sw2;
+		for(uint32_t i = 0; i < N; ++i) {
+			LOG_TRACE(log, "ctrl %d: %u %x %5.2f", static_cast<int>(i), i * 3, i, i * 0.01f);
+		}
+		auto t1 = sw2.sec();
+		std::printf("bench: sformat + puts %.2f M rec/s, %.1f bytes/rec\n",
+			N / t0 / 1e6, static_cast<double>(bytes) / N + 8);
+		std::printf("bench: LOG_TRACE      %.2f M rec/s, %u bytes/rec\n", N / t1 / 1e6, 8 + 4 * 4);
+	}
+}
+
+
+int main(int argc, char* argv[])
+{
+	test_record_();
+	test_wrap_();
+	test_power_cut_();
+
+	bench_();
+
+	return test::result("log_man");
+}
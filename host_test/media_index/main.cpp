@@ -0,0 +1,495 @@
+//=====================================================================//
+/*!	@file
+	@brief	media_index、メディア・ライブラリー・テスト @n
+			FAT16 の RAM ディスク（FatFs）に、ID3v2 タグとカバー画像（BMP/PNG）付きの @n
+			1000 曲を置いて走査し、各順番のソート、検索、サムネイルを参照と比較する。@n
+			変更の無い再走査でファイルを開かない事、更新、削除、追加の差分更新、@n
+			index.db を失った場合の再構築、メモリー不足で失敗する事を検査する。@n
+			走査時間と、ディスクのコマンド数から SD での時間を見積もる
+    @author 平松邦仁 (hira@rvf-rc45.net)
+	@copyright	Copyright (C) 2021 Kunihito Hiramatsu @n
+				Released under the MIT license @n
+				https://github.com/hirakuni45/RX/blob/master/LICENSE
+*/
+//=====================================================================//
+#include "FreeRTOS.h"
+#include "task.h"
+#include <new>
+#include <vector>
+#include <string>
+#include <tuple>
+#include <algorithm>
+#include <unistd.h>
+#include <fcntl.h>
+#include <png.h>
+#include "test.hpp"
+#include "host_stub.hpp"
+#include "rtos_host.hpp"
+#include "ram_disk.hpp"
+#include "sound/media_index.hpp"
+
+namespace {
+
+	bool	fail_alloc_ = false;
+
+}
+
+/// メモリー不足の模擬（nothrow 版だけを置き換える）
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+	if(fail_alloc_) return nullptr;
+	return std::malloc(size);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+	std::free(ptr);
+}
+
+void* operator new[](std::size_t size)
+{
+	auto p = std::malloc(size);
+	if(p == nullptr) throw std::bad_alloc();
+	return p;
+}
+
+namespace {
+
+	typedef sound::media_index<8192, 64, 64> INDEX;
+	INDEX	idx_;
+
+	static const uint32_t ARTISTS = 20;
+	static const uint32_t ALBUMS = 5;
+	static const uint32_t TRACKS = 10;
+
+	struct ref_t {
+		std::string	path;
+		std::string	title;
+		std::string	artist;
+		std::string	album;
+		int			disc;
+		int			track;
+	};
+	std::vector<ref_t>	refs_;
+
+
+	//----- 合成メディア -----//
+
+	std::vector<uint8_t> make_bmp_(int w, int h, uint8_t r, uint8_t g, uint8_t b)
+	{
+		int stride = (w * 3 + 3) & ~3;
+		std::vector<uint8_t> v(54 + stride * h);
+		auto p32 = [&](int o, uint32_t x) { std::memcpy(&v[o], &x, 4); };
+		auto p16 = [&](int o, uint16_t x) { std::memcpy(&v[o], &x, 2); };
+		v[0] = 'B';
+		v[1] = 'M';
+		p32(2, v.size());
+		p32(10, 54);
+		p32(14, 40);
+		p32(18, w);
+		p32(22, h);
+		p16(26, 1);
+		p16(28, 24);
+		p32(34, stride * h);
+		for(int y = 0; y < h; ++y) {
+			for(int x = 0; x < w; ++x) {
+				uint8_t* q = &v[54 + y * stride + x * 3];
+				q[0] = b;
+				q[1] = g;
+				q[2] = r;
+			}
+		}
+		return v;
+	}
+
+
+	void png_write_(png_structp png, png_bytep data, png_size_t len)
+	{
+		auto v = static_cast<std::vector<uint8_t>*>(png_get_io_ptr(png));
+		v->insert(v->end(), data, data + len);
+	}
+
+
+	void png_flush_(png_structp) { }
+
+
+	std::vector<uint8_t> make_png_(int w, int h, uint8_t r, uint8_t g, uint8_t b)
+	{
+		std::vector<uint8_t> v;
+		auto png = png_create_write_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr);
+		auto info = png_create_info_struct(png);
+		png_set_write_fn(png, &v, png_write_, png_flush_);
+		png_set_IHDR(png, info, w, h, 8, PNG_COLOR_TYPE_RGB, PNG_INTERLACE_NONE,
+			PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+		png_write_info(png, info);
+		std::vector<uint8_t> row(w * 3);
+		for(int x = 0; x < w; ++x) {
+			row[x * 3 + 0] = r;
+			row[x * 3 + 1] = g;
+			row[x * 3 + 2] = b;
+		}
+		for(int y = 0; y < h; ++y) png_write_row(png, row.data());
+		png_write_end(png, info);
+		png_destroy_write_struct(&png, &info);
+		return v;
+	}
+
+
+	void be32_(std::vector<uint8_t>& v, uint32_t x)
+	{
+		v.insert(v.end(), { static_cast<uint8_t>(x >> 24), static_cast<uint8_t>(x >> 16),
+			static_cast<uint8_t>(x >> 8), static_cast<uint8_t>(x) });
+	}
+
+
+	void frame_(std::vector<uint8_t>& v, const char* id, const std::vector<uint8_t>& body)
+	{
+		v.insert(v.end(), id, id + 4);
+		be32_(v, body.size());
+		v.push_back(0);
+		v.push_back(0);
+		v.insert(v.end(), body.begin(), body.end());
+	}
+
+
+	void text_(std::vector<uint8_t>& v, const char* id, const std::string& s, bool utf16 = false)
+	{
+		std::vector<uint8_t> b;
+		if(utf16) {
+			b.insert(b.end(), { 1, 0xff, 0xfe });
+			for(char c : s) {
+				b.push_back(c);
+				b.push_back(0);
+			}
+			b.push_back(0);
+			b.push_back(0);
+		} else {
+			b.push_back(3);
+			b.insert(b.end(), s.begin(), s.end());
+		}
+		frame_(v, id, b);
+	}
+
+
+	/// カバー画像の種類（0: 無し、1: BMP、2: PNG）
+	int cover_type_(int a, int l)
+	{
+		int k = a * 10 + l;
+		return (k % 7) == 3 ? 0 : ((k % 5) == 1 ? 2 : 1);
+	}
+
+
+	void cover_rgb_(int a, int l, uint8_t& r, uint8_t& g, uint8_t& b)
+	{
+		r = a * 12;
+		g = l * 50;
+		b = 255 - a * 12;
+	}
+
+
+	bool write_track_(const ref_t& t, int a, int l, int rev)
+	{
+		std::vector<uint8_t> tag;
+		text_(tag, "TIT2", t.title, (t.track % 3) == 0);
+		text_(tag, "TPE1", t.artist);
+		text_(tag, "TALB", t.album);
+		text_(tag, "TRCK", std::to_string(t.track) + "/10");
+		text_(tag, "TPOS", std::to_string(t.disc));
+		text_(tag, "TYER", "2001");
+		int ct = cover_type_(a, l);
+		if(ct != 0) {
+			uint8_t r, g, b;
+			cover_rgb_(a, l, r, g, b);
+			// BMP は横長（上下に余白）、PNG は縦長（左右に余白）
+			auto img = ct == 1 ? make_bmp_(120, 100, r, g, b) : make_png_(100, 140, r, g, b);
+			std::vector<uint8_t> ap;
+			ap.push_back(0);
+			const char* mime = ct == 1 ? "image/bmp" : "image/png";
+			ap.insert(ap.end(), mime, mime + std::strlen(mime) + 1);
+			ap.push_back(3);
+			ap.push_back(0);
+			ap.insert(ap.end(), img.begin(), img.end());
+			frame_(tag, "APIC", ap);
+		}
+		std::vector<uint8_t> f = { 'I', 'D', '3', 3, 0, 0 };
+		uint32_t sz = tag.size();
+		f.insert(f.end(), { static_cast<uint8_t>((sz >> 21) & 0x7f), static_cast<uint8_t>((sz >> 14) & 0x7f),
+			static_cast<uint8_t>((sz >> 7) & 0x7f), static_cast<uint8_t>(sz & 0x7f) });
+		f.insert(f.end(), tag.begin(), tag.end());
+		f.resize(f.size() + 3000 + rev * 7, 0x55);  // 音声データの代わり
+		return test::write_file(t.path.c_str(), f.data(), f.size());
+	}
+
+
+	bool make_media_()
+	{
+		static const char* names[] = { "Red", "Blue", "Green", "Silver", "Orange", "Night", "Sun", "Moon" };
+		bool ok = f_mkdir("/Music") == FR_OK;
+		char tmp[256];
+		for(uint32_t a = 0; a < ARTISTS; ++a) {
+			utils::sformat("/Music/A%02d", tmp, sizeof(tmp)) % a;
+			ok &= f_mkdir(tmp) == FR_OK;
+			for(uint32_t l = 0; l < ALBUMS; ++l) {
+				utils::sformat("/Music/A%02d/L%d", tmp, sizeof(tmp)) % a % l;
+				ok &= f_mkdir(tmp) == FR_OK;
+				for(uint32_t t = 1; t <= TRACKS; ++t) {
+					ref_t r;
+					utils::sformat("/Music/A%02d/L%d/%02d track.mp3", tmp, sizeof(tmp)) % a % l % t;
+					r.path = tmp;
+					if(a < 4) utils::sformat("Artist With A Long Common Prefix %02d", tmp, sizeof(tmp)) % ((a * 37) % 50);
+					else utils::sformat("%s Band %02d", tmp, sizeof(tmp)) % names[a % 8] % ((a * 37) % 50);
+					r.artist = tmp;
+					// 大小文字の混在
+					if((a % 10) == 0) r.artist = "the same artist";
+					if((a % 10) == 5) r.artist = "The Same Artist";
+					utils::sformat("%s Album %d", tmp, sizeof(tmp)) % ((l & 1) ? "live" : "Studio") % ((a * 7 + l) % 13);
+					r.album = tmp;
+					utils::sformat("Song %d of %s", tmp, sizeof(tmp)) % ((t * 13 + a) % 17) % r.album.c_str();
+					r.title = tmp;
+					r.disc = 1 + (t > 5);
+					r.track = t;
+					ok &= write_track_(r, a, l, 0);
+					refs_.push_back(r);
+				}
+			}
+		}
+		// 音声以外のファイル
+		ok &= test::write_file("/Music/readme.txt", "x", 1);
+		return ok;
+	}
+
+
+	//----- 検査 -----//
+
+	std::string fold_(const std::string& s)
+	{
+		std::string r = s;
+		for(auto& c : r) if(c >= 'A' && c <= 'Z') c += 0x20;
+		return r;
+	}
+
+
+	bool check_order_(INDEX::ORDER o)
+	{
+		std::vector<const ref_t*> v;
+		for(const auto& r : refs_) v.push_back(&r);
+		auto key = [&](const ref_t* r) {
+			switch(o) {
+			case INDEX::ORDER::ARTIST:
+				return std::make_tuple(fold_(r->artist), fold_(r->album), r->disc, r->track, fold_(r->title));
+			case INDEX::ORDER::ALBUM:
+				return std::make_tuple(fold_(r->album), std::string(), r->disc, r->track, fold_(r->title));
+			default:
+				return std::make_tuple(fold_(r->title), fold_(r->artist), 0, 0, fold_(r->album));
+			}
+		};
+		std::stable_sort(v.begin(), v.end(), [&](const ref_t* a, const ref_t* b) { return key(a) < key(b); });
+		if(idx_.size() != v.size()) return false;
+		INDEX::record_t r;
+		for(uint32_t i = 0; i < v.size(); ++i) {
+			if(!idx_.get(o, i, r)) return false;
+			// 同じキーのものは順不同なので、キーで比較
+			ref_t x { r.path, r.title, r.artist, r.album, r.disc, r.track };
+			if(key(&x) != key(v[i])) return false;
+		}
+		return true;
+	}
+
+
+	void check_all_(const char* name)
+	{
+		CHECK(check_order_(INDEX::ORDER::ARTIST));
+		CHECK(check_order_(INDEX::ORDER::ALBUM));
+		CHECK(check_order_(INDEX::ORDER::TITLE));
+		uint32_t nf = 0;
+		uint32_t field = 0;
+		uint32_t thumb_ok = 0;
+		uint32_t thumb_bad = 0;
+		static uint16_t th[64 * 64];
+		for(const auto& t : refs_) {
+			INDEX::record_t r;
+			if(!idx_.find(t.path.c_str(), r)) {
+				++nf;
+				continue;
+			}
+			if(t.title != r.title || t.artist != r.artist || t.album != r.album || t.track != r.track) ++field;
+			int a = 3;
+			int l = 3;
+			std::sscanf(t.path.c_str(), "/Music/A%d/L%d", &a, &l);
+			int ct = cover_type_(a, l);
+			if((ct != 0) != (r.thumb != INDEX::NO_THUMB)) {
+				++thumb_bad;
+				continue;
+			}
+			if(ct == 0) continue;
+			if(!idx_.read_thumb(r.thumb, th)) {
+				++thumb_bad;
+				continue;
+			}
+			uint8_t R, G, B;
+			cover_rgb_(a, l, R, G, B);
+			uint16_t c = th[32 * 64 + 32];
+			uint16_t e = ((R >> 3) << 11) | ((G >> 2) << 5) | (B >> 3);
+			uint16_t edge = ct == 1 ? th[0 * 64 + 32] : th[32 * 64 + 0];
+			if(c == e && edge == 0) ++thumb_ok;
+			else ++thumb_bad;
+		}
+		INDEX::record_t r;
+		CHECK(!idx_.find("/Music/none.mp3", r));
+		std::fprintf(stderr, "%s: %zu tracks, thumb ok %u\n", name, refs_.size(), thumb_ok);
+		CHECK_EQ(nf, 0u);
+		CHECK_EQ(field, 0u);
+		CHECK_EQ(thumb_bad, 0u);
+	}
+
+
+	/// 走査（SD の時間は 2.2MB/s 読み、1.5MB/s 書き、コマンド毎に 0.3ms と仮定）
+	const INDEX::scan_t& scan_(const char* name)
+	{
+		auto& d = test::disk();
+		d.clear_count();
+		test::stopwatch sw;
+		idx_.start("/");
+		while(idx_.service(4)) ;
+		auto t = sw.sec();
+		const auto& s = idx_.get_scan();
+		double sd = d.read_sec * 512.0 / 2.2e6 + d.write_sec * 512.0 / 1.5e6
+			+ (d.read_cmd + d.write_cmd) * 0.3e-3;
+		std::fprintf(stderr, "bench: %s %.1f ms, files %u, update %u, remove %u, thumb %u, error %u, "
+			"read %u cmd, write %u cmd, SD %.0f ms\n", name, t * 1e3, s.files, s.update, s.remove,
+			s.thumb, s.error, d.read_cmd.load(), d.write_cmd.load(), sd * 1e3);
+		return s;
+	}
+
+
+	void test_scan_()
+	{
+		CHECK(idx_.open());
+		auto& cold = scan_("cold scan");
+		CHECK_EQ(cold.files, refs_.size());
+		CHECK_EQ(cold.error, 0u);
+		check_all_("cold scan");
+
+		// 変化が無ければファイルを開かない
+		auto& warm = scan_("warm scan");
+		CHECK_EQ(warm.update, 0u);
+
+		// 再マウント（電源再投入）後
+		static FATFS fs;
+		f_mount(nullptr, "", 0);
+		CHECK(f_mount(&fs, "", 1) == FR_OK);
+		CHECK(idx_.open());
+		auto& reopen = scan_("warm scan (reopen)");
+		CHECK_EQ(reopen.update, 0u);
+		check_all_("reopen");
+	}
+
+
+	/// 更新 10、削除 20、追加 30
+	void test_update_()
+	{
+		auto& d = test::disk();
+		for(int i = 0; i < 10; ++i) {
+			auto& r = refs_[i * 97];
+			r.title = "Changed " + std::to_string(i);
+			int a, l;
+			std::sscanf(r.path.c_str(), "/Music/A%d/L%d", &a, &l);
+			CHECK(write_track_(r, a, l, 1));
+		}
+		for(int i = 0; i < 20; ++i) {
+			auto p = refs_.begin() + 300 + i * 31 - i;
+			CHECK(f_unlink(p->path.c_str()) == FR_OK);
+			refs_.erase(p);
+		}
+		CHECK(f_mkdir("/New") == FR_OK);
+		for(int i = 0; i < 30; ++i) {
+			ref_t r;
+			char tmp[64];
+			utils::sformat("/New/n%02d.mp3", tmp, sizeof(tmp)) % i;
+			r.path = tmp;
+			r.artist = "Newcomer";
+			r.album = "Fresh";
+			utils::sformat("New %02d", tmp, sizeof(tmp)) % i;
+			r.title = tmp;
+			r.disc = 0;
+			r.track = i + 1;
+			CHECK(write_track_(r, 3, 3, 0));
+			refs_.push_back(r);
+		}
+		auto& s = scan_("incremental scan");
+		CHECK_EQ(s.update, 40u);
+		CHECK_EQ(s.remove, 20u);
+		check_all_("incremental scan");
+		auto rd = d.read_cmd.load();
+		scan_("warm scan");
+		CHECK_EQ(idx_.get_scan().update, 0u);
+		// 変化の無い走査は、差分更新より少ないコマンドで終わる
+		CHECK(d.read_cmd < rd);
+	}
+
+
+	/// index.db を失った場合は、stat を再構築する
+	void test_lost_index_()
+	{
+		CHECK(f_unlink("/.medialib/index.db") == FR_OK);
+		CHECK(idx_.open());
+		scan_("scan (index.db lost)");
+		check_all_("index.db lost");
+	}
+
+
+	/// メモリー不足（nothrow の new が nullptr）では失敗を返し、落ちない
+	void test_no_memory_()
+	{
+		// インデックスを作り直す時のメモリー不足
+		auto& r = refs_[5];
+		r.title = "Changed again";
+		int a, l;
+		std::sscanf(r.path.c_str(), "/Music/A%d/L%d", &a, &l);
+		CHECK(write_track_(r, a, l, 2));
+		CHECK(idx_.open());
+		CHECK(idx_.start("/"));
+		fail_alloc_ = true;
+		while(idx_.service(4)) ;
+		fail_alloc_ = false;
+		CHECK(idx_.get_scan().error > 0);
+
+		// 回復後は、普通に使える
+		CHECK(idx_.open());
+		scan_("scan (after no memory)");
+		check_all_("after no memory");
+	}
+
+
+	void quiet_(bool ena)
+	{
+		static int save = -1;
+		std::fflush(stdout);
+		if(ena) {
+			save = dup(1);
+			auto fd = open("/dev/null", O_WRONLY);
+			dup2(fd, 1);
+			close(fd);
+		} else if(save >= 0) {
+			dup2(save, 1);
+			close(save);
+			save = -1;
+		}
+	}
+}
+
+
+int main(int argc, char* argv[])
+{
+	CHECK(test::mount_ram_disk(131072, 16));
+	CHECK(make_media_());
+
+	quiet_(true);
+	test_scan_();
+	test_update_();
+	test_lost_index_();
+	test_no_memory_();
+	quiet_(false);
+
+	return test::result("media_index");
+}
@@ -0,0 +1,249 @@
+//=====================================================================//
+/*!	@file
+	@brief	monograph、モノクロ LCD/OLED 部分転送テスト @n
+			ラスター操作を１ピクセル毎の参照実装と比較し、更新範囲（ダーティ・マップ）@n
+			が全ての変更を含む事を検査する。@n
+			SSD1306/ST7565/UC1701 で、典型的な表示更新の転送バイト数を数える
+    @author 平松邦仁 (hira@rvf-rc45.net)
+	@copyright	Copyright (C) 2021 Kunihito Hiramatsu @n
+				Released under the MIT license @n
+				https://github.com/hirakuni45/RX/blob/master/LICENSE
+*/
+//=====================================================================//
+#include <cstring>
+#include "test.hpp"
+#include "common/delay.hpp"
+#include "graphics/monograph.hpp"
+#include "chip/SSD1306.hpp"
+#include "chip/ST7565.hpp"
+#include "chip/UC1701.hpp"
+
+/// 端子のモック（CS/A0）
+struct pin_t {
+	static inline int P;
+	static inline int PMC;
+	static inline int PM;
+	static inline int DIR;
+};
+
+namespace {
+
+	static const int16_t WIDTH  = 128;
+	static const int16_t HEIGHT = 64;
+	static const uint32_t FB_SIZE = WIDTH * HEIGHT / 8;
+
+	/// 6x12 のフォント（パターンは文字コードから作る）
+	struct font_t {
+		static const int8_t width = 6;
+		static const int8_t height = 12;
+		static uint8_t	d_[9];
+		static const uint8_t* get(uint8_t c) {
+			for(int i = 0; i < 9; ++i) d_[i] = c * 37 + i * 11;
+			return d_;
+		}
+		static int8_t get_width(uint8_t) { return 6; }
+		static int8_t get_kern(uint8_t) { return 0; }
+	};
+	uint8_t font_t::d_[9];
+
+	typedef graphics::monograph<WIDTH, HEIGHT, font_t> MONO;
+
+
+	/// １ピクセル毎の参照実装
+	struct ref_t {
+		uint8_t	fb_[FB_SIZE] = { };
+		void ps(int x, int y, bool c) {
+			if(x < 0 || y < 0 || x >= WIDTH || y >= HEIGHT) return;
+			if(c) fb_[(y >> 3) * WIDTH + x] |= 1 << (y & 7);
+			else fb_[(y >> 3) * WIDTH + x] &= ~(1 << (y & 7));
+		}
+		void rev(int x, int y) {
+			if(x < 0 || y < 0 || x >= WIDTH || y >= HEIGHT) return;
+			fb_[(y >> 3) * WIDTH + x] ^= 1 << (y & 7);
+		}
+		void fill(int x, int y, int w, int h, bool c) {
+			for(int i = y; i < y + h; ++i) for(int j = x; j < x + w; ++j) ps(j, i, c);
+		}
+	};
+
+
+	/// SPI のモック（転送バイト数を数える）
+	struct spi_t {
+		uint32_t	n_ = 0;
+		uint8_t xchg(uint8_t) { ++n_; return 0; }
+		void send(const void*, uint32_t s) { n_ += s; }
+	};
+
+
+	uint32_t rnd_()
+	{
+		static uint32_t seed = 1;
+		seed = seed * 1103515245 + 12345;
+		return (seed >> 16) & 0x7fff;
+	}
+
+
+	/// 更新範囲の外で、変わったバイトの数
+	uint32_t outside_(const MONO& bm, const uint8_t* prev)
+	{
+		uint32_t n = 0;
+		for(uint16_t page = 0; page < bm.page_num(); ++page) {
+			uint16_t org = WIDTH;
+			uint16_t len = 0;
+			bm.get_dirty(page, org, len);
+			for(int16_t x = 0; x < WIDTH; ++x) {
+				uint32_t i = page * WIDTH + x;
+				if(bm.fb()[i] != prev[i] && (x < org || x >= (org + len))) ++n;
+			}
+		}
+		return n;
+	}
+
+
+	void test_raster_()
+	{
+		static graphics::kfont_null kf;
+		static MONO bm(kf);
+		static ref_t r;
+		bm.clear(0);
+		bm.clear_dirty();
+		uint8_t prev[FB_SIZE];
+		uint32_t mismatch = 0;
+		uint32_t outside = 0;
+		for(uint32_t t = 0; t < 20000; ++t) {
+			std::memcpy(prev, bm.fb(), FB_SIZE);
+			int x = rnd_() % 160 - 16;
+			int y = rnd_() % 90 - 13;
+			int w = rnd_() % 40;
+			int h = rnd_() % 30;
+			switch(rnd_() % 6) {
+			case 0:
+				bm.fill(x, y, w, h, 1);
+				r.fill(x, y, w, h, 1);
+				break;
+			case 1:
+				bm.fill(x, y, w, h, 0);
+				r.fill(x, y, w, h, 0);
+				break;
+			case 2:
+				bm.reverse(x, y, w, h);
+				for(int i = y; i < y + h; ++i) for(int j = x; j < x + w; ++j) r.rev(j, i);
+				break;
+			case 3:
+				{
+					bool c = rnd_() & 1;
+					bm.frame(x, y, w, h, c);
+					if(w > 0 && h > 0) {
+						r.fill(x, y, w, 1, c);
+						r.fill(x, y + h - 1, w, 1, c);
+						r.fill(x, y, 1, h, c);
+						r.fill(x + w - 1, y, 1, h, c);
+					}
+				}
+				break;
+			case 4:
+				{
+					uint8_t img[32 * 24 / 8];
+					for(auto& b : img) b = rnd_();
+					uint8_t iw = 1 + (w % 32);
+					uint8_t ih = 1 + (h % 24);
+					bm.draw_image(x, y, img, iw, ih);
+					for(int i = 0; i < ih; ++i) {
+						for(int j = 0; j < iw; ++j) {
+							uint32_t idx = i * iw + j;
+							if(img[idx >> 3] & (1 << (idx & 7))) r.ps(x + j, y + i, 1);
+						}
+					}
+				}
+				break;
+			default:
+				{
+					uint8_t ch = rnd_() & 0x7f;
+					auto p = font_t::get(ch);
+					for(int i = 0; i < font_t::height; ++i) {
+						for(int j = 0; j < font_t::width; ++j) {
+							uint32_t idx = i * font_t::width + j;
+							if(p[idx >> 3] & (1 << (idx & 7))) r.ps(x + j, y + i, 1);
+						}
+					}
+					bm.draw_font_utf16(x, y, ch);
+				}
+				break;
+			}
+			if(std::memcmp(bm.fb(), r.fb_, FB_SIZE) != 0) {
+				++mismatch;
+				std::memcpy(r.fb_, bm.fb(), FB_SIZE);
+			}
+			outside += outside_(bm, prev);
+			if((t % 7) == 0) bm.clear_dirty();
+		}
+		CHECK_EQ(mismatch, 0u);
+		CHECK_EQ(outside, 0u);
+	}
+
+
+	/// 時計表示（mm:ss）とバーの更新を frames 回、転送バイト数を返す
+	template <class LCD>
+	uint32_t ui_update_(LCD& lcd, spi_t& spi, MONO& bm, uint32_t frames)
+	{
+		lcd.update(bm);
+		spi.n_ = 0;
+		char s[8];
+		for(uint32_t f = 0; f < frames; ++f) {
+			snprintf(s, sizeof(s), "%02u:%02u", f / 60, f % 60);
+			bm.fill(80, 2, 30, 12, 0);
+			bm.draw_text(80, 2, s);
+			bm.fill(0, 56, f % 128, 4, 1);
+			lcd.update(bm);
+		}
+		CHECK(!bm.is_dirty());
+		return spi.n_;
+	}
+
+
+	void test_update_()
+	{
+		static graphics::kfont_null kf;
+		static MONO bm(kf);
+		static const uint32_t FRAMES = 100;
+		bm.clear(0);
+
+		spi_t spi;
+		chip::ST7565<spi_t, pin_t, pin_t> st7565(spi);
+		auto n = ui_update_(st7565, spi, bm, FRAMES);
+		spi.n_ = 0;
+		for(uint32_t f = 0; f < FRAMES; ++f) st7565.copy(bm.fb(), 8);
+		auto full = spi.n_;
+		std::printf("bench: ST7565 UI update %.1f bytes/frame, full copy %.1f bytes/frame\n",
+			static_cast<double>(n) / FRAMES, static_cast<double>(full) / FRAMES);
+		CHECK(full >= FRAMES * FB_SIZE);
+		CHECK(n * 8 < full);
+
+		chip::UC1701<spi_t, pin_t, pin_t> uc1701(spi);
+		n = ui_update_(uc1701, spi, bm, FRAMES);
+		std::printf("bench: UC1701 UI update %.1f bytes/frame\n", static_cast<double>(n) / FRAMES);
+		CHECK(n * 8 < full);
+
+		chip::SSD1306<spi_t, pin_t, pin_t> ssd1306(spi);
+		n = ui_update_(ssd1306, spi, bm, FRAMES);
+		spi.n_ = 0;
+		for(uint32_t f = 0; f < FRAMES; ++f) ssd1306.copy(bm.fb());
+		full = spi.n_;
+		std::printf("bench: SSD1306 UI update %.1f bytes/frame, full copy %.1f bytes/frame\n",
+			static_cast<double>(n) / FRAMES, static_cast<double>(full) / FRAMES);
+		CHECK(n * 8 < full);
+
+		// 変更が無ければ何も送らない
+		spi.n_ = 0;
+		CHECK_EQ(ssd1306.update(bm), 0u);
+		CHECK_EQ(spi.n_, 0u);
+	}
+}
+
+
+int main(int argc, char* argv[])
+{
+	test_raster_();
+	test_update_();
+	return test::result("monograph");
+}
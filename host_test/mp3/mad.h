@@ -0,0 +1,177 @@
+#pragma once
+//=====================================================================//
+/*!	@file
+	@brief	ホスト・テスト用 libmad のモック（mp3_in の入出力、変換の検査用） @n
+			フレームは本物の MPEG-1 Layer III ヘッダー（44.1KHz、32 ～ 320Kbps、@n
+			パディング、CRC）で、フレーム長はヘッダーから求める（VBR、ゴミの読み飛ばし）@n
+			デコードはペイロードのハッシュから sbsample を作り（フル・スケールの約 1.2 倍、@n
+			飽和も通る）、合成は pcm[s * 32 + sb] = sbsample[s][sb] の線形な写像 @n
+			※ハフマン、IMDCT、合成フィルターの時間は含まない
+    @author 平松邦仁 (hira@rvf-rc45.net)
+	@copyright	Copyright (C) 2021 Kunihito Hiramatsu @n
+				Released under the MIT license @n
+				https://github.com/hirakuni45/RX/blob/master/LICENSE
+*/
+//=====================================================================//
+#include <cstdint>
+#include <cstring>
+
+typedef int32_t mad_fixed_t;
+
+#define MAD_F_FRACBITS		28
+#define MAD_F_ONE			0x10000000L
+#define MAD_BUFFER_GUARD	8
+#define mad_f_mul(a, b)		((mad_fixed_t)(((int64_t)(a) * (b)) >> MAD_F_FRACBITS))
+
+enum mad_layer { MAD_LAYER_I = 1, MAD_LAYER_II = 2, MAD_LAYER_III = 3 };
+enum mad_mode {
+	MAD_MODE_SINGLE_CHANNEL = 0, MAD_MODE_DUAL_CHANNEL = 1, MAD_MODE_JOINT_STEREO = 2, MAD_MODE_STEREO = 3
+};
+enum { MAD_FLAG_PROTECTION = 0x0010, MAD_FLAG_LSF_EXT = 0x1000 };
+enum mad_error { MAD_ERROR_NONE = 0, MAD_ERROR_BUFLEN = 0x0001, MAD_ERROR_LOSTSYNC = 0x0101 };
+
+#define MAD_RECOVERABLE(error)	((error) & 0xff00)
+
+struct mad_stream {
+	const unsigned char*	buffer;
+	const unsigned char*	bufend;
+	const unsigned char*	this_frame;
+	const unsigned char*	next_frame;
+	int						error;
+};
+
+struct mad_header {
+	enum mad_layer	layer;
+	enum mad_mode	mode;
+	int				flags;
+	unsigned long	bitrate;
+	unsigned int	samplerate;
+};
+
+struct mad_frame {
+	mad_header		header;
+	mad_fixed_t		sbsample[2][36][32];
+};
+
+struct mad_pcm {
+	unsigned short	length;
+	mad_fixed_t		samples[2][1152];
+};
+
+struct mad_synth {
+	mad_pcm		pcm;
+};
+
+#define MAD_NSBSAMPLES(h)	(36)
+#define MAD_NCHANNELS(h)	((h)->mode ? 2 : 1)
+
+static const unsigned MOCK_PAYLOAD_ORG = 40;	///< ハッシュするペイロードの先頭（サイド情報の後）
+
+inline void mad_stream_init(mad_stream* s) { memset(s, 0, sizeof(*s)); }
+inline void mad_stream_finish(mad_stream*) { }
+inline void mad_stream_buffer(mad_stream* s, const unsigned char* b, unsigned long len)
+{
+	s->buffer = b;
+	s->bufend = b + len;
+	s->this_frame = b;
+	s->next_frame = b;
+}
+inline void mad_header_init(mad_header* h) { memset(h, 0, sizeof(*h)); }
+#define mad_header_finish(h)	do { } while(0)
+inline void mad_frame_init(mad_frame* f) { memset(f, 0, sizeof(*f)); }
+#define mad_frame_finish(f)		do { } while(0)
+inline void mad_frame_mute(mad_frame*) { }
+inline void mad_synth_init(mad_synth* s) { memset(s, 0, sizeof(*s)); }
+#define mad_synth_finish(s)		do { } while(0)
+inline void mad_synth_mute(mad_synth*) { }
+
+
+inline unsigned mock_bitrate(const unsigned char* p)
+{
+	static const unsigned br[16] = { 0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 0 };
+	return br[p[2] >> 4];
+}
+
+
+inline unsigned mock_samplerate(const unsigned char* p)
+{
+	static const unsigned sr[4] = { 44100, 48000, 32000, 0 };
+	return sr[(p[2] >> 2) & 3];
+}
+
+
+// MPEG-1 Layer III のフレーム長（不正なヘッダーは０）
+inline unsigned mock_frame_len(const unsigned char* p)
+{
+	if(p[0] != 0xff || (p[1] & 0xfe) != 0xfa) return 0;
+	auto b = mock_bitrate(p);
+	auto s = mock_samplerate(p);
+	if(b == 0 || s == 0) return 0;
+	return 144 * b * 1000 / s + ((p[2] >> 1) & 1);
+}
+
+
+inline int mad_header_decode(mad_header* h, mad_stream* s)
+{
+	const unsigned char* p = s->next_frame;
+	const unsigned char* q = p;
+	while((q + 4) <= s->bufend && mock_frame_len(q) == 0) ++q;
+	if((q + 4) > s->bufend) {
+		s->next_frame = (s->bufend - p) >= MAD_BUFFER_GUARD ? s->bufend - MAD_BUFFER_GUARD : p;
+		s->error = MAD_ERROR_BUFLEN;
+		return -1;
+	}
+	if(q != p) {
+		s->next_frame = q;
+		s->error = MAD_ERROR_LOSTSYNC;
+		return -1;
+	}
+	auto len = mock_frame_len(p);
+	if((p + len) > s->bufend) {
+		s->error = MAD_ERROR_BUFLEN;
+		return -1;
+	}
+	h->layer = MAD_LAYER_III;
+	h->mode = (p[3] >> 6) == 3 ? MAD_MODE_SINGLE_CHANNEL : MAD_MODE_STEREO;
+	h->flags = (p[1] & 1) ? 0 : MAD_FLAG_PROTECTION;
+	h->bitrate = mock_bitrate(p) * 1000;
+	h->samplerate = mock_samplerate(p);
+	s->this_frame = p;
+	s->next_frame = p + len;
+	s->error = 0;
+	return 0;
+}
+
+
+inline int mad_frame_decode(mad_frame* f, mad_stream* s)
+{
+	if(mad_header_decode(&f->header, s)) return -1;
+	const unsigned char* pl = s->this_frame + MOCK_PAYLOAD_ORG;
+	unsigned len = (s->next_frame - s->this_frame) - MOCK_PAYLOAD_ORG;
+	uint32_t h = 2166136261u;
+	for(unsigned i = 0; i < len; ++i) h = (h ^ pl[i]) * 16777619u;
+	int chn = MAD_NCHANNELS(&f->header);
+	for(int ch = 0; ch < chn; ++ch) {
+		for(int t = 0; t < 36; ++t) {
+			for(int sb = 0; sb < 32; ++sb) {
+				h = h * 1103515245u + 12345u;
+				f->sbsample[ch][t][sb] = static_cast<mad_fixed_t>(static_cast<int32_t>(h) >> 2) / 5 * 6 / 5;
+			}
+		}
+	}
+	return 0;
+}
+
+
+inline void mad_synth_frame(mad_synth* sy, const mad_frame* f)
+{
+	sy->pcm.length = 1152;
+	int chn = MAD_NCHANNELS(&f->header);
+	for(int ch = 0; ch < chn; ++ch) {
+		for(int t = 0; t < 36; ++t) {
+			for(int sb = 0; sb < 32; ++sb) {
+				sy->pcm.samples[ch][t * 32 + sb] = f->sbsample[ch][t][sb];
+			}
+		}
+	}
+}
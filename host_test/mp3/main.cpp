@@ -0,0 +1,393 @@
+//=====================================================================//
+/*!	@file
+	@brief	mp3_in、入力リング、ブロック PCM 出力、処理時間のテスト @n
+			FAT16 の RAM ディスク（FatFs）に合成した MP3（VBR、パディング、CRC、@n
+			フレーム間のゴミ、奇数長の ID3v2、ID3v1、モノラル）を置き、@n
+			連続バッファの参照デコードとビット単位で一致する事を確かめる。@n
+			小さな FIFO（折り返し）、REPLAY、サブバンド・フィルター（一様、非一様）、@n
+			ディザ（平均誤差）、セクター単位の読み込みも検査する。@n
+			128/320Kbps の 52 秒のファイルで、実時間の倍率（CPU のみ、SD の見積もり込み）と @n
+			フレーム毎の処理時間を「bench:」行で表示する @n
+			※libmad はモック（mad.h）なので、倍率は libmad 以外の部分の比較用
+    @author 平松邦仁 (hira@rvf-rc45.net)
+	@copyright	Copyright (C) 2021 Kunihito Hiramatsu @n
+				Released under the MIT license @n
+				https://github.com/hirakuni45/RX/blob/master/LICENSE
+*/
+//=====================================================================//
+#include "FreeRTOS.h"
+#include "task.h"
+#include <vector>
+#include <string>
+#include <random>
+#include <chrono>
+#include "test.hpp"
+#include "host_stub.hpp"
+#include "rtos_host.hpp"
+#include "ram_disk.hpp"
+#include "sound/mp3_in.hpp"
+
+extern "C" {
+	void set_sample_rate(uint32_t freq) { }
+}
+
+namespace {
+
+	typedef sound::wave_t<int16_t> WAVE;
+
+	static const uint32_t SAMPLE_RATE = 44100;
+
+	/// SD（SPI 25MHz 程度）の見積もり：コマンド毎に 0.3ms、読み 2.2MB/s
+	static const double SD_CMD_MS = 0.3;
+	static const double SD_READ_KBPS = 2200.0;
+
+	//----- 出力 -----//
+
+	// length() を呼ばれた時に取り出す FIFO（取り出したサンプルは保存、又は、チェックサム）
+	template <uint32_t SIZE>
+	struct drain_fifo : public utils::fixed_fifo<WAVE, SIZE> {
+		typedef utils::fixed_fifo<WAVE, SIZE> BASE;
+		std::vector<WAVE>	v;
+		bool				keep = true;
+		uint64_t			num = 0;
+		uint32_t			sum = 0;
+
+		uint32_t length() noexcept
+		{
+			while(BASE::length() > 0) {
+				auto t = BASE::get();
+				if(keep) v.push_back(t);
+				sum = sum * 31 + static_cast<uint16_t>(t.l_ch) + (static_cast<uint32_t>(t.r_ch) << 16);
+				++num;
+			}
+			return 0;
+		}
+
+		void clear() noexcept { length(); v.clear(); num = 0; sum = 0; }
+	};
+
+	template <uint32_t SIZE>
+	struct drain_out {
+		typedef drain_fifo<SIZE> FIFO;
+		FIFO	fifo_;
+		FIFO& at_fifo() noexcept { return fifo_; }
+		void mute() noexcept { }
+	};
+
+	typedef drain_out<8192> OUT;
+	typedef drain_out<333> SMALL_OUT;	// span が頻繁に折り返す
+
+	//----- 合成メディア -----//
+
+	struct media_t {
+		const char*		name;
+		std::string		data;
+	};
+	std::vector<media_t> media_;
+
+	static const uint32_t BITRATE[] = { 0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320 };
+
+	std::string id3v2_(uint32_t len)
+	{
+		std::string body("TIT2\x00\x00\x00\x06\x00\x00\x00title", 15);
+		body.resize(len, '\0');
+		std::string s("ID3\x03\x00\x00", 6);
+		s += static_cast<char>((len >> 21) & 0x7f);
+		s += static_cast<char>((len >> 14) & 0x7f);
+		s += static_cast<char>((len >> 7) & 0x7f);
+		s += static_cast<char>(len & 0x7f);
+		return s + body;
+	}
+
+	// bitrate が０なら VBR
+	std::string make_mp3_(uint32_t frames, uint32_t seed, bool mono, bool junk, uint32_t id3,
+		bool v1, uint32_t bitrate)
+	{
+		std::mt19937 rnd(seed);
+		std::string s;
+		if(id3 > 0) s += id3v2_(id3);
+		for(uint32_t i = 0; i < frames; ++i) {
+			uint32_t bi = 0;
+			if(bitrate == 0) {
+				bi = rnd() % 14 + 1;
+			} else {
+				while(BITRATE[bi] != bitrate) ++bi;
+			}
+			uint32_t pad = rnd() & 1;
+			uint32_t crc = rnd() & 1;
+			s += static_cast<char>(0xff);
+			s += static_cast<char>(crc ? 0xfa : 0xfb);
+			s += static_cast<char>((bi << 4) | (pad << 1));
+			s += static_cast<char>(mono ? (3 << 6) : (1 << 6));
+			uint32_t len = 144 * BITRATE[bi] * 1000 / SAMPLE_RATE + pad;
+			for(uint32_t j = 4; j < len; ++j) s += static_cast<char>(rnd());
+			if(junk && (rnd() % 20) == 0) {
+				uint32_t n = rnd() % 40 + 1;
+				for(uint32_t j = 0; j < n; ++j) s += static_cast<char>(rnd() % 0xff);
+			}
+		}
+		if(v1) {
+			s += "TAG";
+			s += std::string(125, '\0');
+		}
+		return s;
+	}
+
+	bool make_media_()
+	{
+		media_.push_back(media_t{ "/a.mp3", make_mp3_(400, 1, false, true, 1037, true, 0) });
+		media_.push_back(media_t{ "/b.mp3", make_mp3_(300, 2, true, true, 0, true, 0) });
+		media_.push_back(media_t{ "/c.mp3", make_mp3_(500, 3, false, false, 501, false, 0) });
+		media_.push_back(media_t{ "/d.mp3", make_mp3_(2000, 4, false, false, 0, true, 128) });
+		media_.push_back(media_t{ "/e.mp3", make_mp3_(2000, 5, false, false, 0, true, 320) });
+		for(const auto& m : media_) {
+			if(!test::write_file(m.name, m.data.data(), m.data.size())) return false;
+		}
+		return true;
+	}
+
+	const media_t& media_at_(const char* name)
+	{
+		for(const auto& m : media_) {
+			if(strcmp(m.name, name) == 0) return m;
+		}
+		return media_[0];
+	}
+
+	//----- 参照デコード（連続バッファ、丸め） -----//
+
+	int16_t quantize_(int64_t v)
+	{
+		if(v >= MAD_F_ONE) v = MAD_F_ONE - 1;
+		else if(v < -MAD_F_ONE) v = -MAD_F_ONE;
+		v = (v + (1 << 12)) >> 13;
+		if(v > 32767) v = 32767;
+		else if(v < -32768) v = -32768;
+		return v;
+	}
+
+	std::vector<WAVE> reference_(const char* name, const mad_fixed_t* gain)
+	{
+		const auto& d = media_at_(name).data;
+		size_t org = 0;
+		if(d.compare(0, 3, "ID3") == 0) {
+			org = 10 + ((d[6] << 21) | (d[7] << 14) | (d[8] << 7) | d[9]);
+		}
+		size_t end = d.size();
+		if(end >= 128 && d.compare(end - 128, 3, "TAG") == 0) end -= 128;
+		std::vector<unsigned char> b(d.begin() + org, d.begin() + end);
+		b.resize(b.size() + MAD_BUFFER_GUARD, 0);
+
+		mad_stream s;
+		mad_stream_init(&s);
+		mad_stream_buffer(&s, b.data(), b.size());
+		static mad_frame f;
+		std::vector<WAVE> out;
+		while(1) {
+			if(mad_frame_decode(&f, &s) != 0) {
+				if(MAD_RECOVERABLE(s.error)) continue;
+				break;
+			}
+			int chn = MAD_NCHANNELS(&f.header);
+			for(uint32_t i = 0; i < 1152; ++i) {
+				auto get = [&](int ch) {
+					int64_t v = f.sbsample[ch][i / 32][i % 32];
+					if(gain != nullptr) v = (v * gain[i % 32]) >> MAD_F_FRACBITS;
+					return quantize_(v);
+				};
+				WAVE w;
+				w.l_ch = get(0);
+				w.r_ch = chn == 2 ? get(1) : w.l_ch;
+				out.push_back(w);
+			}
+		}
+		return out;
+	}
+
+	uint32_t diff_(const std::vector<WAVE>& a, const std::vector<WAVE>& b, int32_t& maxd)
+	{
+		maxd = 0;
+		if(a.size() != b.size()) return 0xffffffff;
+		uint32_t n = 0;
+		for(size_t i = 0; i < a.size(); ++i) {
+			int32_t d = std::max(std::abs(a[i].l_ch - b[i].l_ch), std::abs(a[i].r_ch - b[i].r_ch));
+			maxd = std::max(maxd, d);
+			if(d != 0) ++n;
+		}
+		return n;
+	}
+
+	uint32_t ns_counter_()
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	sound::mp3_in	mp3_;
+
+	template <class OUT_>
+	bool play_(const char* name, OUT_& out)
+	{
+		utils::file_io fin;
+		if(!fin.open(name, "rb")) return false;
+		sound::audio_info info;
+		if(!mp3_.info(fin, info)) return false;
+		return mp3_.decode(fin, out);
+	}
+
+
+	// 参照と一致、小さな FIFO、セクター単位の読み込み
+	void test_exact_()
+	{
+		mp3_.enable_dither(false);
+		static OUT out;
+		for(const auto& m : media_) {
+			auto ref = reference_(m.name, nullptr);
+			out.fifo_.clear();
+			test::disk().clear_count();
+			CHECK(play_(m.name, out));
+			out.at_fifo().length();
+			int32_t maxd;
+			CHECK_EQ(diff_(ref, out.fifo_.v, maxd), 0u);
+			CHECK(ref.size() > 0);
+			CHECK_EQ(mp3_.get_stat().samples, ref.size());
+			uint32_t cmd = test::disk().read_cmd;
+			uint32_t sec = test::disk().read_sec;
+			// 4KB 単位の読み込みは、ほぼ複数セクターの直接転送になる
+			CHECK(sec > cmd * 3);
+			std::printf("%s: %zu samples, read cmd %u, sectors %u\n", m.name, ref.size(), cmd, sec);
+		}
+
+		static SMALL_OUT small;
+		small.fifo_.clear();
+		CHECK(play_("/a.mp3", small));
+		small.at_fifo().length();
+		int32_t maxd;
+		CHECK_EQ(diff_(reference_("/a.mp3", nullptr), small.fifo_.v, maxd), 0u);
+	}
+
+
+	// REPLAY：途中から最初に戻る
+	void test_replay_()
+	{
+		mp3_.enable_dither(false);
+		uint32_t n = 0;
+		mp3_.set_ctrl_task([&]() {
+			return ++n == 101 ? sound::af_play::CTRL::REPLAY : sound::af_play::CTRL::NONE; });
+		static OUT out;
+		out.fifo_.clear();
+		CHECK(play_("/a.mp3", out));
+		out.at_fifo().length();
+		mp3_.set_ctrl_task(nullptr);
+		auto ref = reference_("/a.mp3", nullptr);
+		CHECK(out.fifo_.v.size() > ref.size());
+		if(out.fifo_.v.size() > ref.size()) {
+			auto head = out.fifo_.v.size() - ref.size();
+			std::vector<WAVE> tail(out.fifo_.v.begin() + head, out.fifo_.v.end());
+			int32_t maxd;
+			CHECK_EQ(diff_(ref, tail, maxd), 0u);
+		}
+	}
+
+
+	// サブバンド・フィルター（一様は変換の倍率だけ、非一様）
+	void test_subband_()
+	{
+		mp3_.enable_dither(false);
+		mad_fixed_t g[32];
+		static OUT out;
+		int32_t maxd;
+		for(uint32_t i = 0; i < 32; ++i) g[i] = MAD_F_ONE / 2;
+		mp3_.set_subband_filter(g);
+		out.fifo_.clear();
+		CHECK(play_("/a.mp3", out));
+		out.at_fifo().length();
+		CHECK_EQ(diff_(reference_("/a.mp3", g), out.fifo_.v, maxd), 0u);
+
+		for(uint32_t i = 0; i < 32; ++i) {
+			g[i] = i < 4 ? MAD_F_ONE * 3 / 2 : (i > 24 ? MAD_F_ONE / 4 : MAD_F_ONE / 2);
+		}
+		mp3_.set_subband_filter(g);
+		out.fifo_.clear();
+		CHECK(play_("/a.mp3", out));
+		out.at_fifo().length();
+		CHECK_EQ(diff_(reference_("/a.mp3", g), out.fifo_.v, maxd), 0u);
+		mp3_.set_subband_filter(nullptr);
+	}
+
+
+	// ディザ：±1 LSB、平均誤差はほぼ０
+	void test_dither_()
+	{
+		mp3_.enable_dither(true);
+		static OUT out;
+		out.fifo_.clear();
+		CHECK(play_("/b.mp3", out));
+		out.at_fifo().length();
+		auto ref = reference_("/b.mp3", nullptr);
+		int32_t maxd;
+		auto n = diff_(ref, out.fifo_.v, maxd);
+		CHECK(n != 0xffffffff);
+		CHECK(n > 0);
+		CHECK(maxd <= 1);
+		if(out.fifo_.v.size() == ref.size()) {
+			double sum = 0.0;
+			for(size_t i = 0; i < ref.size(); ++i) sum += out.fifo_.v[i].l_ch - ref[i].l_ch;
+			double mean = sum / ref.size();
+			CHECK(mean > -0.01 && mean < 0.01);
+			std::printf("dither: differ %u / %zu, max %d LSB, mean %.4f LSB\n", n, ref.size(), maxd, mean);
+		}
+	}
+
+
+	void test_bench_()
+	{
+		mp3_.enable_dither(true);
+		mp3_.set_counter(ns_counter_);
+		for(const char* name : { "/d.mp3", "/e.mp3" }) {
+			static OUT out;
+			out.fifo_.keep = false;
+			double best = 1e9;
+			uint64_t samples = 0;
+			uint32_t cmd = 0;
+			uint32_t sec = 0;
+			for(uint32_t r = 0; r < 3; ++r) {
+				out.fifo_.clear();
+				test::disk().clear_count();
+				test::stopwatch sw;
+				CHECK(play_(name, out));
+				out.at_fifo().length();
+				best = std::min(best, sw.sec());
+				samples = out.fifo_.num;
+				cmd = test::disk().read_cmd;
+				sec = test::disk().read_sec;
+			}
+			double audio = static_cast<double>(samples) / SAMPLE_RATE;
+			double sd = (cmd * SD_CMD_MS + sec * 512 / SD_READ_KBPS) * 1e-3;
+			const auto& st = mp3_.get_stat();
+			auto us = [&](uint64_t v) { return v * 1e-3 / st.frames; };
+			std::printf("bench: %s %.1f s, x%.0f realtime (CPU), x%.0f realtime (SD estimate %.0f ms, %u cmd)\n",
+				name, audio, audio / best, audio / (best + sd), sd * 1e3, cmd);
+			std::printf("bench: %s us/frame: decode %.2f, synth %.2f, convert %.2f, read %.2f, wait %.2f\n",
+				name, us(st.total.decode), us(st.total.synth), us(st.total.convert),
+				us(st.total.read), us(st.total.wait));
+			CHECK(audio > 50.0);
+		}
+		mp3_.set_counter(nullptr);
+	}
+}
+
+
+int main(int argc, char* argv[])
+{
+	CHECK(test::mount_ram_disk(65536, 8));
+	CHECK(make_media_());
+
+	test_exact_();
+	test_replay_();
+	test_subband_();
+	test_dither_();
+	test_bench_();
+
+	return test::result("mp3");
+}
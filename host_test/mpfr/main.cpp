@@ -0,0 +1,337 @@
+//=====================================================================//
+/*!	@file
+	@brief	mpfr::value のテスト @n
+			式テンプレートの評価（a * b + c、a * b - c は mpfr_fma、mpfr_fms の１回の丸め）、@n
+			代入先と重なる式、複合代入、スカラーとの演算、auto で受けた式、@n
+			limb_pool の使い切り（ヒープへの切り替えと解放）を確かめる。@n
+			a * b + c の評価回数／秒を「bench:」行で表示する
+    @author 平松邦仁 (hira@rvf-rc45.net)
+	@copyright	Copyright (C) 2021 Kunihito Hiramatsu @n
+				Released under the MIT license @n
+				https://github.com/hirakuni45/RX/blob/master/LICENSE
+*/
+//=====================================================================//
+#include <memory>
+#include <type_traits>
+#include "test.hpp"
+#include "host_stub.hpp"
+#include "common/format.hpp"
+#include "common/mpfr.hpp"
+
+namespace {
+
+	static const uint32_t PREC = 64;
+	typedef mpfr::value<PREC> VAL;
+
+	// CALC_sample と同じく、value より先に構築する（１バンク３２ブロック）
+	typedef mpfr::limb_pool<mpfr::limb_size<PREC>::value, 1> POOL;
+	POOL	pool_;
+
+	// 参照（C の関数で直接計算）
+	struct ref_t {
+		mpfr_t	t;
+		ref_t() { mpfr_init2(t, PREC); }
+		~ref_t() { mpfr_clear(t); }
+	};
+
+	bool same_(const VAL& v, const ref_t& r) { return mpfr_equal_p(v.get(), r.t) != 0; }
+	bool same_(const VAL& v, const VAL& r) { return mpfr_equal_p(v.get(), r.get()) != 0; }
+
+
+	// a * b + c、c + a * b、a * b - c は、１回の丸め
+	void test_fma_()
+	{
+		// a * b = 1 - 2^-80 は 64 ビットでは 1 に丸められる
+		VAL a("1");
+		VAL b("1");
+		mpfr_add_d(a.get(), a.get(), std::ldexp(1.0, -40), MPFR_RNDN);
+		mpfr_sub_d(b.get(), b.get(), std::ldexp(1.0, -40), MPFR_RNDN);
+		VAL c(-1);
+
+		ref_t fma;
+		mpfr_fma(fma.t, a.get(), b.get(), c.get(), MPFR_RNDN);
+		CHECK(mpfr_cmp_d(fma.t, -std::ldexp(1.0, -80)) == 0);
+
+		VAL d = a * b + c;
+		CHECK(same_(d, fma));
+		d = c + a * b;
+		CHECK(same_(d, fma));
+
+		// 別々に丸めると 0 になる
+		VAL m = a * b;
+		VAL s = m + c;
+		CHECK(s == 0);
+
+		ref_t fms;
+		VAL e(1);
+		mpfr_fms(fms.t, a.get(), b.get(), e.get(), MPFR_RNDN);
+		d = a * b - e;
+		CHECK(same_(d, fms));
+		CHECK(mpfr_cmp_d(fms.t, -std::ldexp(1.0, -80)) == 0);
+
+		// 代入先と重なる
+		VAL x = a;
+		x = x * b + c;
+		CHECK(same_(x, fma));
+		x = b;
+		x = a * x - e;
+		CHECK(same_(x, fms));
+		x = c;
+		x = a * b + x;
+		CHECK(same_(x, fma));
+	}
+
+
+	// 一般の式（一時オブジェクトを作る場合を含む）
+	void test_expr_()
+	{
+		VAL a(1.25);
+		VAL b("3.1415926535897932384626");
+		VAL c(-7);
+		VAL d("0.1");
+
+		ref_t t0, t1, r;
+		// (a + b) * (c - d) / (a - c)
+		mpfr_add(t0.t, a.get(), b.get(), MPFR_RNDN);
+		mpfr_sub(t1.t, c.get(), d.get(), MPFR_RNDN);
+		mpfr_mul(r.t, t0.t, t1.t, MPFR_RNDN);
+		mpfr_sub(t0.t, a.get(), c.get(), MPFR_RNDN);
+		mpfr_div(r.t, r.t, t0.t, MPFR_RNDN);
+
+		VAL v = (a + b) * (c - d) / (a - c);
+		CHECK(same_(v, r));
+		// 代入先が左にも右にもある
+		VAL x = a;
+		x = (x + b) * (c - d) / (x - c);
+		CHECK(same_(x, r));
+		x = c;
+		x = (a + b) * (x - d) / (a - x);
+		CHECK(same_(x, r));
+
+		// d - (a / b)、右辺が式で左辺が代入先
+		mpfr_div(t0.t, a.get(), b.get(), MPFR_RNDN);
+		mpfr_sub(r.t, d.get(), t0.t, MPFR_RNDN);
+		x = d;
+		x = x - a / b;
+		CHECK(same_(x, r));
+
+		// auto で受けた式（途中の式は値で持つので、オペランドが有効な間は使える）
+		mpfr_fma(r.t, a.get(), b.get(), c.get(), MPFR_RNDN);
+		auto e = a * b + c;
+		static_assert(!std::is_same<decltype(e), VAL>::value, "expr");
+		VAL y = e;
+		CHECK(same_(y, r));
+		auto f = (a + b) * (c - d);
+		mpfr_add(t0.t, a.get(), b.get(), MPFR_RNDN);
+		mpfr_sub(t1.t, c.get(), d.get(), MPFR_RNDN);
+		mpfr_mul(r.t, t0.t, t1.t, MPFR_RNDN);
+		y = f;
+		CHECK(same_(y, r));
+	}
+
+
+	// 複合代入
+	void test_compound_()
+	{
+		VAL a("1.000000000001");
+		VAL b("0.999999999999");
+		VAL c(-1);
+
+		ref_t r;
+		VAL v = c;
+		v += a * b;
+		mpfr_fma(r.t, a.get(), b.get(), c.get(), MPFR_RNDN);
+		CHECK(same_(v, r));
+
+		// v -= a * b は v - a * b を１回の丸め
+		VAL w(1);
+		w -= a * b;
+		VAL one(1);
+		mpfr_fms(r.t, a.get(), b.get(), one.get(), MPFR_RNDN);
+		mpfr_neg(r.t, r.t, MPFR_RNDN);
+		CHECK(same_(w, r));
+
+		ref_t t;
+		v = a;
+		v += a + b;
+		mpfr_add(t.t, a.get(), b.get(), MPFR_RNDN);
+		mpfr_add(r.t, a.get(), t.t, MPFR_RNDN);
+		CHECK(same_(v, r));
+
+		v = a;
+		v *= a - b;
+		mpfr_sub(t.t, a.get(), b.get(), MPFR_RNDN);
+		mpfr_mul(r.t, a.get(), t.t, MPFR_RNDN);
+		CHECK(same_(v, r));
+
+		v = b;
+		v /= a + c;
+		mpfr_add(t.t, a.get(), c.get(), MPFR_RNDN);
+		mpfr_div(r.t, b.get(), t.t, MPFR_RNDN);
+		CHECK(same_(v, r));
+
+		v = a;
+		v -= a / b;
+		mpfr_div(t.t, a.get(), b.get(), MPFR_RNDN);
+		mpfr_sub(r.t, a.get(), t.t, MPFR_RNDN);
+		CHECK(same_(v, r));
+
+		// スカラー（int、unsigned、long、float、double）
+		v = 10;
+		CHECK(v == 10);
+		v += 1;
+		v -= 2u;
+		v *= 3L;
+		v /= 4.0f;
+		CHECK(v == 6.75);
+		v = 0.5;
+		v += -1.5;
+		CHECK(v == -1);
+		v = 4000000000u;
+		CHECK(mpfr_cmp_ui(v.get(), 4000000000u) == 0);
+	}
+
+
+	// スカラーとの二項演算
+	void test_scalar_()
+	{
+		VAL a(3);
+		VAL b(0.5);
+		static_assert(std::is_same<decltype(a + 1), VAL>::value, "value + int");
+		static_assert(std::is_same<decltype(1.0 * (a + b)), VAL>::value, "double * expr");
+
+		VAL v = a + 1;
+		CHECK(v == 4);
+		v = 1 + a;
+		CHECK(v == 4);
+		v = a - 1;
+		CHECK(v == 2);
+		v = 1 - a;
+		CHECK(v == -2);
+		v = a * 2;
+		CHECK(v == 6);
+		v = 2u * a;
+		CHECK(v == 6);
+		v = a / 4;
+		CHECK(v == 0.75);
+		v = 3 / a;
+		CHECK(v == 1);
+		v = 1.5 - b;
+		CHECK(v == 1);
+		v = 2.0 / b;
+		CHECK(v == 4);
+		v = a * b + 1;
+		CHECK(v == 2.5);
+		v = 10 - a * b;
+		CHECK(v == 8.5);
+		v = (a + b) / 7L;
+		CHECK(v == 0.5);
+		// 符号無しの大きな値
+		v = a + 4000000000u;
+		CHECK(mpfr_cmp_ui(v.get(), 4000000003u) == 0);
+		v = 4000000000u - a;
+		CHECK(mpfr_cmp_ui(v.get(), 3999999997u) == 0);
+	}
+
+
+	// limb_pool の使い切り
+	void test_pool_()
+	{
+		CHECK(POOL::get_alloc_count() > 0);
+		auto used = POOL::get_used();
+		auto heap = POOL::get_heap_count();
+		const uint32_t cap = POOL::capacity();
+		CHECK_EQ(cap, 32u);
+
+		{
+			// プールより多い value
+			std::unique_ptr<VAL[]> vs(new VAL[cap + 8]);
+			CHECK_EQ(POOL::get_used(), cap);
+			CHECK_EQ(POOL::get_peak(), cap);
+			CHECK(POOL::get_heap_count() >= heap + 8);
+			for(uint32_t i = 0; i < cap + 8; ++i) {
+				vs[i] = static_cast<long>(i);
+				vs[i] = vs[i] * vs[i] + vs[i];
+			}
+			bool ok = true;
+			for(uint32_t i = 0; i < cap + 8; ++i) {
+				if(vs[i] != static_cast<long>(i * i + i)) ok = false;
+			}
+			CHECK(ok);
+		}
+		CHECK_EQ(POOL::get_used(), used);
+
+		// 解放されたブロックを再利用
+		heap = POOL::get_heap_count();
+		{
+			VAL a(1);
+			VAL b(2);
+			VAL c = a + b;
+			CHECK(c == 3);
+			CHECK_EQ(POOL::get_used(), used + 3);
+		}
+		CHECK_EQ(POOL::get_heap_count(), heap);
+		CHECK_EQ(POOL::get_used(), used);
+
+		// UNIT を超える精度はヒープ
+		{
+			mpfr::value<PREC * 4> big(7);
+			CHECK(POOL::get_heap_count() > heap);
+			CHECK_EQ(POOL::get_used(), used);
+			big = big * big + big;
+			CHECK(big == 56);
+		}
+
+		// 精度の変更（realloc）：プールからヒープ、ヒープからプールへ
+		{
+			VAL v(5);
+			CHECK_EQ(POOL::get_used(), used + 1);
+			mpfr_prec_round(v.get(), PREC * 4, MPFR_RNDN);
+			CHECK_EQ(POOL::get_used(), used);
+			CHECK(v == 5);
+			mpfr_prec_round(v.get(), PREC, MPFR_RNDN);
+			CHECK(v == 5);
+		}
+		CHECK_EQ(POOL::get_used(), used);
+	}
+
+
+	void bench_()
+	{
+		VAL a("1.0000001");
+		VAL b("0.9999999");
+		VAL c("0.000001");
+		VAL v(0);
+		static const uint32_t LOOP = 2000000;
+		auto alloc = POOL::get_alloc_count();
+		test::stopwatch sw;
+		for(uint32_t i = 0; i < LOOP; ++i) {
+			v = a * b + c;
+			a = v * b - c;
+		}
+		auto sec = sw.sec();
+		alloc = POOL::get_alloc_count() - alloc;
+		CHECK_EQ(alloc, 0u);
+		char tmp[64];
+		v(10, tmp, sizeof(tmp));
+		std::printf("bench: %u-bit a * b + c: %.1f M/s (%u allocations in the loop), result %s\n",
+			PREC, LOOP * 2 / sec * 1e-6, alloc, tmp);
+	}
+}
+
+
+int main(int argc, char* argv[])
+{
+	test_fma_();
+	test_expr_();
+	test_compound_();
+	test_scalar_();
+	test_pool_();
+
+	bench_();
+
+	std::printf("pool: %u requests, %u heap, peak %u / %u blocks\n",
+		POOL::get_alloc_count(), POOL::get_heap_count(), POOL::get_peak(), POOL::capacity());
+
+	return test::result("mpfr");
+}
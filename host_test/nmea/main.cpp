@@ -0,0 +1,365 @@
+//=====================================================================//
+/*!	@file
+	@brief	nmea_parse / nmea_dec 適合テスト @n
+			チェックサム、GGA/RMC/VTG/GSV の固定小数点値、トーカー、@n
+			分割入力、途中で切れたセンテンス、UBX NAV-PVT、文字列取得を検査 @n
+			最後にセンテンス／秒を表示する
+    @author 平松邦仁 (hira@rvf-rc45.net)
+	@copyright	Copyright (C) 2021 Kunihito Hiramatsu @n
+				Released under the MIT license @n
+				https://github.com/hirakuni45/RX/blob/master/LICENSE
+*/
+//=====================================================================//
+#include <cstring>
+#include <string>
+#include "test.hpp"
+#include "host_stub.hpp"
+#include "common/nmea_dec.hpp"
+
+namespace {
+
+	typedef utils::nmea_parse::TALKER TALKER;
+
+	/// nmea_dec に渡す SCI の代用
+	struct sci_mock {
+		const char*	ptr_;
+		uint32_t	len_;
+		void auto_crlf(bool) { }
+		void start(uint32_t, int) { }
+		uint32_t get_error_count() const { return 0; }
+		void flush_recv() { }
+		uint32_t recv_length() const { return len_; }
+		char getch() { --len_; return *ptr_++; }
+		void puts(const char*) { }
+	};
+
+
+	/// チェックサムを付けてセンテンスを作る（body は '$' と '*' の間）
+	std::string make_(const char* body)
+	{
+		uint8_t sum = 0;
+		for(auto p = body; *p != 0; ++p) sum ^= static_cast<uint8_t>(*p);
+		char tmp[8];
+		snprintf(tmp, sizeof(tmp), "*%02X\r\n", sum);
+		return std::string("$") + body + tmp;
+	}
+
+
+	bool feed_(utils::nmea_parse& p, const char* s)
+	{
+		return p.put(s, std::strlen(s));
+	}
+
+
+	bool feed_(utils::nmea_parse& p, const std::string& s)
+	{
+		return p.put(s.data(), s.size());
+	}
+
+
+	bool same_(const utils::nmea_parse::fix_t& a, const utils::nmea_parse::fix_t& b)
+	{
+		return a.lat_ == b.lat_ && a.lon_ == b.lon_ && a.alt_ == b.alt_ && a.speed_ == b.speed_
+			&& a.heading_ == b.heading_ && a.dop_ == b.dop_ && a.year_ == b.year_
+			&& a.mon_ == b.mon_ && a.day_ == b.day_ && a.hour_ == b.hour_ && a.min_ == b.min_
+			&& a.sec_ == b.sec_ && a.ms_ == b.ms_ && a.quality_ == b.quality_
+			&& a.satellite_ == b.satellite_ && a.valid_ == b.valid_ && a.talker_ == b.talker_;
+	}
+
+
+	void test_checksum_()
+	{
+		utils::nmea_parse p;
+		// 既知の正しいセンテンス
+		CHECK(feed_(p, "$GPGGA,123519,4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,*47\r\n"));
+		CHECK_EQ(p.get_error_count(), 0u);
+		CHECK_EQ(p.get_id(), 1u);
+		// 同じセンテンスでチェックサム不一致
+		CHECK(!feed_(p, "$GPGGA,123519,4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,*48\r\n"));
+		CHECK_EQ(p.get_error_count(), 1u);
+		CHECK_EQ(p.get_id(), 1u);
+		// 小文字の１６進
+		CHECK(feed_(p, "$GNRMC,001031.00,A,4404.13993,N,12118.86023,W,0.146,,100117,,,A*7b\r\n"));
+		CHECK(feed_(p, "$GPVTG,054.7,T,034.4,M,005.5,N,010.2,K*48\r\n"));
+		// チェックサムの無いセンテンスは捨てる
+		CHECK(!feed_(p, "$GPGGA,123519,4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,\r\n"));
+		CHECK_EQ(p.get_id(), 3u);
+	}
+
+
+	void test_gga_()
+	{
+		utils::nmea_parse p;
+		CHECK(feed_(p, make_("GPGGA,123519.25,4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,")));
+		const auto& f = p.get_fix();
+		CHECK_EQ(f.hour_, 12);
+		CHECK_EQ(f.min_, 35);
+		CHECK_EQ(f.sec_, 19);
+		CHECK_EQ(f.ms_, 250);
+		CHECK_EQ(f.lat_, 481173000);			// 48 + 7.038 / 60
+		CHECK_EQ(f.lon_ / 10, 115166666 / 10);	// 11 + 31 / 60
+		CHECK_EQ(f.quality_, 1);
+		CHECK_EQ(f.satellite_, 8);
+		CHECK_EQ(f.dop_, 90u);
+		CHECK_EQ(f.alt_, 545400);
+		CHECK(f.talker_ == TALKER::GP);
+
+		// 南緯、西経、負の高度
+		CHECK(feed_(p, make_("GNGGA,000000,3351.000,S,15112.600,W,2,12,1.25,-12.5,M,0,M,,")));
+		CHECK_EQ(p.get_fix().lat_, -338500000);
+		CHECK_EQ(p.get_fix().lon_, -1512100000);
+		CHECK_EQ(p.get_fix().alt_, -12500);
+		CHECK_EQ(p.get_fix().dop_, 125u);
+		CHECK_EQ(p.get_fix().quality_, 2);
+		CHECK(p.get_fix().talker_ == TALKER::GN);
+	}
+
+
+	void test_rmc_vtg_()
+	{
+		utils::nmea_parse p;
+		CHECK(feed_(p, make_("GNRMC,001031.00,A,4404.13993,N,12118.86023,W,0.146,,100117,,,A")));
+		const auto& f = p.get_fix();
+		CHECK(f.valid_);
+		CHECK_EQ(f.year_, 2017);
+		CHECK_EQ(f.mon_, 1);
+		CHECK_EQ(f.day_, 10);
+		CHECK_EQ(f.hour_, 0);
+		CHECK_EQ(f.min_, 10);
+		CHECK_EQ(f.sec_, 31);
+		CHECK_EQ(f.lat_, 440689988);	// 44 + 4.13993 / 60
+		CHECK_EQ(f.lon_, -1213143371);	// -(121 + 18.86023 / 60)
+		CHECK_EQ(f.speed_, 75u);		// 0.146 kn = 75.1 mm/s
+
+		CHECK(feed_(p, make_("GPRMC,235959,V,,,,,,,311220,,,N")));
+		CHECK(!p.get_fix().valid_);
+		CHECK_EQ(p.get_fix().year_, 2020);
+
+		CHECK(feed_(p, make_("GPVTG,054.7,T,034.4,M,005.5,N,010.2,K")));
+		CHECK_EQ(p.get_fix().heading_, 5470000);
+		CHECK_EQ(p.get_fix().speed_, 2833u);	// 10.2 km/h
+	}
+
+
+	void test_gsv_()
+	{
+		utils::nmea_parse p;
+		CHECK(!feed_(p, make_("GPGSV,2,1,06,03,03,111,00,04,15,270,00,06,01,010,00,13,06,292,00")));
+		CHECK_EQ(p.get_iid(), 1u);
+		CHECK_EQ(p.get_satellite_info_num(), 4u);
+		// 最後のメッセージは衛星が２つ、途中の欠けたフィールドは０
+		CHECK(!feed_(p, make_("GPGSV,2,2,06,21,45,,38,22,,123,")));
+		CHECK_EQ(p.get_satellite_info_num(), 6u);
+		const auto& s0 = p.get_satellite_info(0);
+		CHECK_EQ(s0.no_, 3);
+		CHECK_EQ(s0.elv_, 3);
+		CHECK_EQ(s0.azi_, 111);
+		CHECK_EQ(s0.cn_, 0);
+		const auto& s4 = p.get_satellite_info(4);
+		CHECK_EQ(s4.no_, 21);
+		CHECK_EQ(s4.elv_, 45);
+		CHECK_EQ(s4.azi_, 0);
+		CHECK_EQ(s4.cn_, 38);
+		CHECK_EQ(p.get_satellite_info(5).azi_, 123);
+
+		// 別トーカーは追加、同じトーカーの新しいサイクルは置き換え
+		CHECK(!feed_(p, make_("GLGSV,1,1,02,65,10,020,30,66,20,040,31")));
+		CHECK_EQ(p.get_satellite_info_num(), 8u);
+		CHECK(p.get_satellite_info(7).talker_ == TALKER::GL);
+		CHECK(!feed_(p, make_("GPGSV,1,1,01,07,50,180,44")));
+		CHECK_EQ(p.get_satellite_info_num(), 3u);
+		CHECK(p.get_satellite_info(0).talker_ == TALKER::GL);
+		CHECK_EQ(p.get_satellite_info(2).no_, 7);
+		CHECK_EQ(p.get_satellite_info(2).cn_, 44);
+	}
+
+
+	void test_talker_()
+	{
+		static const struct { const char* t; TALKER k; } tbl[] = {
+			{ "GP", TALKER::GP }, { "GN", TALKER::GN }, { "GL", TALKER::GL },
+			{ "GA", TALKER::GA }, { "GB", TALKER::GB }, { "BD", TALKER::GB },
+		};
+		for(const auto& t : tbl) {
+			utils::nmea_parse p;
+			std::string b = std::string(t.t) + "GGA,010203,3500.000,N,13900.000,E,1,05,1.0,10.0,M,,M,,";
+			CHECK(feed_(p, make_(b.c_str())));
+			CHECK(p.get_fix().talker_ == t.k);
+		}
+		// 知らないトーカー、知らないセンテンスは無視
+		utils::nmea_parse p;
+		CHECK(!feed_(p, make_("XXGGA,010203,3500.000,N,13900.000,E,1,05,1.0,10.0,M,,M,,")));
+		CHECK(!feed_(p, make_("GPZDA,201530.00,04,07,2002,00,00")));
+		CHECK_EQ(p.get_id(), 0u);
+		CHECK_EQ(p.get_error_count(), 0u);
+	}
+
+
+	void test_split_()
+	{
+		auto s = make_("GPGGA,123519,4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,")
+			+ make_("GNRMC,001031.00,A,4404.13993,N,12118.86023,W,0.146,,100117,,,A");
+		// １バイトずつ
+		utils::nmea_parse a;
+		uint32_t n = 0;
+		for(auto c : s) { if(a.put(c)) ++n; }
+		CHECK_EQ(n, 2u);
+		// 任意の位置で分割
+		for(uint32_t cut = 1; cut < s.size(); ++cut) {
+			utils::nmea_parse b;
+			b.put(s.data(), cut);
+			b.put(s.data() + cut, s.size() - cut);
+			CHECK_EQ(b.get_id(), 2u);
+			CHECK(same_(a.get_fix(), b.get_fix()));
+		}
+		// 途中で切れたセンテンスは次の '$' で捨てられ、以前の値は保持
+		utils::nmea_parse c;
+		feed_(c, make_("GPGGA,123519,4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,"));
+		feed_(c, "$GPGGA,999999,0000.000,S,000");
+		CHECK(feed_(c, make_("GPVTG,054.7,T,034.4,M,005.5,N,010.2,K")));
+		CHECK_EQ(c.get_fix().lat_, 481173000);
+		CHECK_EQ(c.get_fix().hour_, 12);
+		CHECK_EQ(c.get_id(), 2u);
+		// 制御コード、ゴミの後でも同期する
+		CHECK(feed_(c, "\x01\xff\x7f,*\r\n$GPVTG,054.7,T,034.4,M,005.5,N,010.2,K*48\r\n"));
+	}
+
+
+	uint32_t ubx_pvt_(uint8_t* b)
+	{
+		std::memset(b, 0, 100);
+		b[0] = 0xB5; b[1] = 0x62; b[2] = 0x01; b[3] = 0x07; b[4] = 92; b[5] = 0;
+		auto pl = b + 6;
+		pl[4] = 2021 & 0xff; pl[5] = 2021 >> 8; pl[6] = 10; pl[7] = 19;
+		pl[8] = 1; pl[9] = 2; pl[10] = 3; pl[11] = 0x03;
+		int32_t nano = 456000000;
+		std::memcpy(pl + 16, &nano, 4);
+		pl[20] = 3;  // 3D-Fix
+		pl[21] = 1;  // gnssFixOK
+		pl[23] = 12;
+		int32_t lon = 1397671234;
+		int32_t lat = 356812345;
+		int32_t hmsl = 40123;
+		int32_t gs = 1500;
+		int32_t head = 9000000;
+		uint16_t pdop = 135;
+		std::memcpy(pl + 24, &lon, 4);
+		std::memcpy(pl + 28, &lat, 4);
+		std::memcpy(pl + 36, &hmsl, 4);
+		std::memcpy(pl + 60, &gs, 4);
+		std::memcpy(pl + 64, &head, 4);
+		std::memcpy(pl + 76, &pdop, 2);
+		uint8_t a = 0;
+		uint8_t c = 0;
+		for(int i = 2; i < 98; ++i) { a += b[i]; c += a; }
+		b[98] = a;
+		b[99] = c;
+		return 100;
+	}
+
+
+	void test_ubx_()
+	{
+		uint8_t b[100];
+		auto n = ubx_pvt_(b);
+		utils::nmea_parse p;
+		CHECK(p.put(b, n));
+		const auto& f = p.get_fix();
+		CHECK_EQ(p.get_ubx_count(), 1u);
+		CHECK(f.talker_ == TALKER::UBX);
+		CHECK_EQ(f.year_, 2021);
+		CHECK_EQ(f.mon_, 10);
+		CHECK_EQ(f.day_, 19);
+		CHECK_EQ(f.hour_, 1);
+		CHECK_EQ(f.min_, 2);
+		CHECK_EQ(f.sec_, 3);
+		CHECK_EQ(f.ms_, 456);
+		CHECK_EQ(f.lat_, 356812345);
+		CHECK_EQ(f.lon_, 1397671234);
+		CHECK_EQ(f.alt_, 40123);
+		CHECK_EQ(f.speed_, 1500u);
+		CHECK_EQ(f.heading_, 9000000);
+		CHECK_EQ(f.dop_, 135u);
+		CHECK_EQ(f.satellite_, 12);
+		CHECK_EQ(f.quality_, 1);
+		CHECK(f.valid_);
+
+		// NMEA と混在
+		auto s = make_("GPVTG,054.7,T,034.4,M,005.5,N,010.2,K");
+		std::string mix = s + std::string(reinterpret_cast<char*>(b), n) + s;
+		utils::nmea_parse q;
+		q.put(mix.data(), mix.size());
+		CHECK_EQ(q.get_id(), 3u);
+		CHECK_EQ(q.get_ubx_count(), 1u);
+		CHECK_EQ(q.get_fix().lat_, 356812345);
+
+		// チェックサム不良、別メッセージは無視
+		b[99] ^= 1;
+		utils::nmea_parse r;
+		CHECK(!r.put(b, n));
+		CHECK_EQ(r.get_error_count(), 1u);
+		ubx_pvt_(b);
+		b[3] = 0x03;  // NAV-STATUS
+		uint8_t a = 0;
+		uint8_t c = 0;
+		for(int i = 2; i < 98; ++i) { a += b[i]; c += a; }
+		b[98] = a;
+		b[99] = c;
+		CHECK(!r.put(b, n));
+		CHECK_EQ(r.get_ubx_count(), 0u);
+		CHECK_EQ(r.get_error_count(), 1u);
+	}
+
+
+	void test_dec_()
+	{
+		auto s = make_("GPGGA,123519,4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,")
+			+ make_("GNRMC,123519,A,4807.038,N,01131.000,E,0.146,,230321,,,A");
+		sci_mock sci{ s.data(), static_cast<uint32_t>(s.size()) };
+		utils::nmea_dec<sci_mock> d(sci);
+		CHECK(d.service());
+		CHECK_EQ(d.get_id(), 2u);
+		CHECK(std::strcmp(d.get_time(), "123519.00") == 0);
+		CHECK(std::strcmp(d.get_date(), "230321") == 0);
+		CHECK(std::strcmp(d.get_lat(), "4807.03800") == 0);
+		CHECK(std::strcmp(d.get_lon(), "1131.00000") == 0 || std::strcmp(d.get_lon(), "1130.99999") == 0);
+		CHECK(std::strcmp(d.get_altitude(), "545.4") == 0);
+		CHECK(std::strcmp(d.get_holizontal_quality(), "0.9") == 0 || std::strcmp(d.get_holizontal_quality(), "0.90") == 0);
+		CHECK_EQ(d.get_satellite_num(), 8);
+		CHECK_EQ(d.get_gmtime(), static_cast<time_t>(1616502919));  // 2021-03-23 12:35:19 UTC
+	}
+
+
+	void bench_()
+	{
+		std::string s = make_("GPGGA,123519,4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,")
+			+ make_("GNRMC,001031.00,A,4404.13993,N,12118.86023,W,0.146,,100117,,,A")
+			+ make_("GPGSV,3,1,11,03,03,111,00,04,15,270,00,06,01,010,00,13,06,292,00")
+			+ make_("GPVTG,054.7,T,034.4,M,005.5,N,010.2,K");
+		static const uint32_t loop = 200000;
+		utils::nmea_parse p;
+		test::stopwatch sw;
+		for(uint32_t i = 0; i < loop; ++i) {
+			p.put(s.data(), s.size());
+		}
+		auto t = sw.sec();
+		CHECK_EQ(p.get_sentence_count(), loop * 4);
+		std::printf("bench: %.0f sentences/s, %.1f MB/s\n", loop * 4 / t,
+			static_cast<double>(s.size()) * loop / t / 1e6);
+	}
+}
+
+
+int main(int argc, char* argv[])
+{
+	test_checksum_();
+	test_gga_();
+	test_rmc_vtg_();
+	test_gsv_();
+	test_talker_();
+	test_split_();
+	test_ubx_();
+	test_dec_();
+	bench_();
+	return test::result("nmea");
+}
@@ -0,0 +1,269 @@
+//=====================================================================//
+/*!	@file
+	@brief	psg_mng、PSG 音源テスト @n
+			ゴールデン出力（ハッシュ）との比較、矩形波のエイリアス、ノイズ、@n
+			飽和加算、各出力形式の一致を検査し、レンダリング速度を計測する
+    @author 平松邦仁 (hira@rvf-rc45.net)
+	@copyright	Copyright (C) 2021 Kunihito Hiramatsu @n
+				Released under the MIT license @n
+				https://github.com/hirakuni45/RX/blob/master/LICENSE
+*/
+//=====================================================================//
+#include <cmath>
+#include <cstdlib>
+#include "test.hpp"
+#include "host_stub.hpp"
+#include "sound/psg_mng.hpp"
+
+namespace {
+
+	typedef utils::psg_base BASE;
+	typedef utils::psg_mng<48000, 100, 3> PSG;
+
+	static const uint16_t FRAME = 48000 / 100;
+
+	/// sound_out のモック（WAVE と FIFO だけ）
+	struct sound_out_t {
+		struct WAVE {
+			int16_t	l_ch;
+			int16_t	r_ch;
+		};
+		struct fifo_t {
+			WAVE		buf_[FRAME * 4];
+			uint32_t	n_ = 0;
+			void put(const WAVE& w) { if(n_ < (FRAME * 4)) buf_[n_++] = w; }
+		};
+		fifo_t	fifo_;
+		fifo_t& at_fifo() { return fifo_; }
+	};
+
+
+	uint32_t fnv_(uint32_t h, uint8_t v)
+	{
+		h ^= v;
+		return h * 16777619u;
+	}
+
+
+	double mag_(const int16_t* x, uint32_t n, double f)
+	{
+		double re = 0.0;
+		double im = 0.0;
+		for(uint32_t i = 0; i < n; ++i) {
+			re += x[i] * std::cos(2.0 * M_PI * f * i / 48000.0);
+			im += x[i] * std::sin(2.0 * M_PI * f * i / 48000.0);
+		}
+		return std::sqrt(re * re + im * im);
+	}
+
+
+	/// 三角波は以前の８ビット・レンダラーと同じ波形（音量、音程の変化を含む）
+	void test_tri_golden_()
+	{
+		static const BASE::SCORE score[] = {
+			BASE::CTRL::VOLUME, 128, BASE::CTRL::TRI, BASE::KEY::A_4, 100, BASE::KEY::E_5, 50,
+			BASE::CTRL::VOLUME, 64, BASE::KEY::C_4, 150, BASE::CTRL::END
+		};
+		// 以前のレンダラー（１チャネル時は２で割った８ビット出力）の FNV-1a
+		static const uint32_t GOLDEN = 0x05374c2c;
+
+		PSG psg;
+		psg.set_score(0, score);
+		psg.service();
+		int16_t x[FRAME];
+		uint32_t h = 2166136261u;
+		for(uint32_t f = 0; f < 300; ++f) {
+			psg.render(FRAME, x);
+			psg.service();
+			for(auto v : x) {
+				h = fnv_(h, static_cast<int8_t>((v >> 6) / 2));
+			}
+		}
+		CHECK_EQ(h, GOLDEN);
+	}
+
+
+	/// 全波形を含む３チャネルの出力（現在のレンダラーの FNV-1a）
+	void test_mix_golden_()
+	{
+		static const BASE::SCORE ch0[] = {
+			BASE::CTRL::VOLUME, 100, BASE::CTRL::SQ25, BASE::KEY::C_5, 60, BASE::KEY::G_5, 60,
+			BASE::CTRL::SQ75, BASE::KEY::E_5, 80, BASE::CTRL::END
+		};
+		static const BASE::SCORE ch1[] = {
+			BASE::CTRL::VOLUME, 120, BASE::CTRL::SQ50, BASE::KEY::A_3, 100, BASE::CTRL::TRI,
+			BASE::KEY::A_2, 100, BASE::CTRL::END
+		};
+		static const BASE::SCORE ch2[] = {
+			BASE::CTRL::VOLUME, 80, BASE::CTRL::NOISE, BASE::KEY::A_4, 30, BASE::KEY::A_6, 30,
+			BASE::KEY::A_2, 140, BASE::CTRL::END
+		};
+		static const uint32_t GOLDEN = 0xc20f1a8a;
+
+		PSG psg;
+		psg.set_score(0, ch0);
+		psg.set_score(1, ch1);
+		psg.set_score(2, ch2);
+		psg.service();
+		int16_t x[FRAME];
+		uint32_t h = 2166136261u;
+		for(uint32_t f = 0; f < 220; ++f) {
+			psg.render(FRAME, x);
+			psg.service();
+			for(auto v : x) {
+				h = fnv_(h, v & 0xff);
+				h = fnv_(h, static_cast<uint16_t>(v) >> 8);
+			}
+		}
+		if(h != GOLDEN) std::fprintf(stderr, "mix hash: %08x\n", h);
+		CHECK_EQ(h, GOLDEN);
+	}
+
+
+	/// polyBLEP の矩形波は、素朴な矩形波よりエイリアスが小さい
+	void test_square_alias_()
+	{
+		static const BASE::SCORE score[] = {
+			BASE::CTRL::VOLUME, 128, BASE::CTRL::SQ50, BASE::KEY::A_6, 200, BASE::CTRL::END
+		};
+		static const uint32_t N = 4800;
+		PSG psg;
+		psg.set_score(0, score);
+		psg.service();
+		static int16_t x[N];
+		psg.render(N, x);
+
+		int16_t peak = 0;
+		for(auto v : x) if(std::abs(v) > peak) peak = std::abs(v);
+		static int16_t naive[N];
+		uint16_t acc = 0;
+		uint16_t spd = static_cast<uint16_t>(3520 * 65536.0 / 48000) >> 1;
+		for(uint32_t i = 0; i < N; ++i) {
+			acc += spd;
+			naive[i] = acc >= 0x8000 ? peak : -peak;
+		}
+		// 1760Hz の 15 次高調波（26400Hz）は 21600Hz に折り返す
+		auto a = mag_(x, N, 21600) / mag_(x, N, 1760);
+		auto b = mag_(naive, N, 21600) / mag_(naive, N, 1760);
+		std::printf("SQ50 1760Hz: alias(21600Hz)/fund %.4f (naive %.4f)\n", a, b);
+		CHECK(peak > 0);
+		CHECK(a < (b * 0.5));
+	}
+
+
+	/// ノイズは直流を含まず、両極性の値を出す
+	void test_noise_()
+	{
+		static const BASE::SCORE score[] = {
+			BASE::CTRL::VOLUME, 128, BASE::CTRL::NOISE, BASE::KEY::A_4, 200, BASE::CTRL::END
+		};
+		PSG psg;
+		psg.set_score(0, score);
+		psg.service();
+		static int16_t x[48000];
+		for(uint32_t f = 0; f < 100; ++f) {
+			psg.render(FRAME, &x[f * FRAME]);
+			psg.service();
+		}
+		int64_t sum = 0;
+		int64_t pow = 0;
+		uint32_t pos = 0;
+		uint32_t neg = 0;
+		for(auto v : x) {
+			sum += v;
+			pow += v * v;
+			if(v > 0) ++pos;
+			else if(v < 0) ++neg;
+		}
+		auto rms = std::sqrt(static_cast<double>(pow) / 48000);
+		auto mean = static_cast<double>(sum) / 48000;
+		CHECK(rms > 1000.0);
+		CHECK(std::abs(mean) < (rms * 0.05));
+		CHECK(pos > 18000 && neg > 18000);
+	}
+
+
+	/// ３チャネル同時の最大振幅でもクリップしない、８ビット、sound_out 出力は同じ波形
+	void test_mix_()
+	{
+		static const BASE::SCORE score[] = {
+			BASE::CTRL::VOLUME, 128, BASE::CTRL::SQ50, BASE::KEY::A_2, 200, BASE::CTRL::END
+		};
+		PSG a;
+		PSG b;
+		PSG c;
+		for(uint8_t ch = 0; ch < 3; ++ch) {
+			a.set_score(ch, score);
+			b.set_score(ch, score);
+			c.set_score(ch, score);
+		}
+		a.service();
+		b.service();
+		c.service();
+		int16_t peak = 0;
+		uint32_t err8 = 0;
+		uint32_t errw = 0;
+		sound_out_t sout;
+		for(uint32_t f = 0; f < 100; ++f) {
+			int16_t x[FRAME];
+			int8_t y[FRAME];
+			a.render(FRAME, x);
+			b.render(FRAME, y);
+			sout.fifo_.n_ = 0;
+			c.render_wave(sout, FRAME);
+			CHECK_EQ(sout.fifo_.n_, FRAME);
+			for(uint32_t i = 0; i < FRAME; ++i) {
+				if(std::abs(x[i]) > peak) peak = std::abs(x[i]);
+				if(y[i] != (x[i] >> 8)) ++err8;
+				auto w = sout.fifo_.buf_[i];
+				if(w.l_ch != x[i] || w.r_ch != x[i]) ++errw;
+			}
+			a.service();
+			b.service();
+			c.service();
+		}
+		std::printf("3ch unison peak %d\n", peak);
+		CHECK(peak > 16384 && peak < 32767);
+		CHECK_EQ(err8, 0u);
+		CHECK_EQ(errw, 0u);
+	}
+
+
+	void bench_(BASE::CTRL wave, const char* name)
+	{
+		const BASE::SCORE s0[] = { BASE::CTRL::VOLUME, 128, wave, BASE::KEY::A_4, 250, BASE::CTRL::END };
+		const BASE::SCORE s1[] = { BASE::CTRL::VOLUME, 128, wave, BASE::KEY::C_5, 250, BASE::CTRL::END };
+		const BASE::SCORE s2[] = { BASE::CTRL::VOLUME, 128, wave, BASE::KEY::E_5, 250, BASE::CTRL::END };
+		PSG psg;
+		psg.set_score(0, s0);
+		psg.set_score(1, s1);
+		psg.set_score(2, s2);
+		psg.service();
+		static const uint32_t N = 20000;
+		int16_t x[FRAME];
+		volatile int32_t sink = 0;
+		test::stopwatch sw;
+		for(uint32_t i = 0; i < N; ++i) {
+			psg.render(FRAME, x);
+			sink += x[7];
+		}
+		auto t = sw.sec();
+		std::printf("bench: %s 3ch %.1f M channel-samples/s\n", name, 3.0 * N * FRAME / t / 1e6);
+	}
+}
+
+
+int main(int argc, char* argv[])
+{
+	test_tri_golden_();
+	test_mix_golden_();
+	test_square_alias_();
+	test_noise_();
+	test_mix_();
+
+	bench_(BASE::CTRL::SQ50, "SQ50");
+	bench_(BASE::CTRL::TRI, "TRI");
+	bench_(BASE::CTRL::NOISE, "NOISE");
+
+	return test::result("psg");
+}
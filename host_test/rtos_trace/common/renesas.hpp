@@ -0,0 +1,21 @@
+#pragma once
+//=====================================================================//
+/*!	@file
+	@brief	ホスト・テスト用 common/renesas.hpp の代用 @n
+			rtos_trace が使う utils::format と、タイムスタンプの CMT/CMTW で @n
+			参照する power_mgr だけ（テストはモックのタイマーを使う）
+    @author 平松邦仁 (hira@rvf-rc45.net)
+	@copyright	Copyright (C) 2021 Kunihito Hiramatsu @n
+				Released under the MIT license @n
+				https://github.com/hirakuni45/RX/blob/master/LICENSE
+*/
+//=====================================================================//
+#include "common/format.hpp"
+
+namespace device {
+
+	struct power_mgr {
+		template <typename T>
+		static bool turn(T, bool ena = true) { return true; }
+	};
+}
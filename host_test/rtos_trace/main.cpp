@@ -0,0 +1,819 @@
+//=====================================================================//
+/*!	@file
+	@brief	rtos_trace、トレース・レコーダーと rtostrace コンバーターのテスト @n
+			モックのタイマー（３２／１６ビット）で、スケジューラーを模したイベント列 @n
+			（タスク切り替え、レディー、ティック、割り込み、ユーザー・イベント）を記録し、@n
+			バイナリ、又は dump() の１６進で rtostrace に通して、統計（実行時間、切り替え、@n
+			起床遅延、割り込み）と JSON（厳密に解析）を、期待値と比べる。@n
+			１６ビット・カウンターの拡張（周回）、リングの上書き、ストリームの欠落 @n
+			（LOST と状態の分からない期間）を確かめる。@n
+			put() の時間と、１イベントのバイト数を「bench:」行で表示する
+    @author 平松邦仁 (hira@rvf-rc45.net)
+	@copyright	Copyright (C) 2021 Kunihito Hiramatsu @n
+				Released under the MIT license @n
+				https://github.com/hirakuni45/RX/blob/master/LICENSE
+*/
+//=====================================================================//
+#include <cmath>
+#include <string>
+#include <vector>
+#include <map>
+#include <functional>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "test.hpp"
+#include "host_stub.hpp"
+#include "common/rtos_trace.hpp"
+
+// コンバーターは、この翻訳単位に含めて、子プロセスで実行する（状態が大域変数の為）
+#define main rtostrace_main
+#include "rtostrace/main.cpp"
+#undef main
+
+namespace {
+
+	static const uint32_t FREQ = 1000000;	///< モックのタイマー周波数（1us）
+
+	//-----------------------------------------------------------------//
+	// モックのタイマー（フリーラン・カウンター）
+	//-----------------------------------------------------------------//
+	template <uint32_t B>
+	struct mock_timer {
+		static const uint32_t BITS = B;
+		static uint32_t	raw_;
+
+		static void start() noexcept { }
+		static uint32_t get_freq() noexcept { return FREQ; }
+		static uint32_t get_counter() noexcept {
+			return B >= 32 ? raw_ : (raw_ & ((1u << B) - 1));
+		}
+	};
+	template <uint32_t B> uint32_t mock_timer<B>::raw_ = 0;
+
+	typedef mock_timer<32> TM32;
+	typedef mock_timer<16> TM16;
+
+	typedef utils::rtos_trace<TM32, utils::rtos_trace_null_lock, 64> TRACE32;
+	typedef utils::rtos_trace<TM16, utils::rtos_trace_null_lock, 64> TRACE16;
+	typedef utils::rtos_trace<TM32, utils::rtos_trace_null_lock, 4, 256, 8> RING;
+	typedef utils::rtos_trace<TM16, utils::rtos_trace_null_lock, 4, 256, 8> STREAM;
+
+	typedef std::vector<uint8_t> DUMP;
+
+
+	//-----------------------------------------------------------------//
+	// 期待値のモデル（切り替えの区間と、記録出来た期間）
+	//-----------------------------------------------------------------//
+	struct model_t {
+		struct slice_t {
+			uint32_t	task;
+			uint64_t	s;
+			uint64_t	e;
+		};
+		typedef std::pair<uint64_t, uint64_t> WIN;
+
+		std::vector<slice_t>	slices;
+		std::vector<WIN>		wins;
+		uint64_t	now = 0;
+		uint32_t	cur = 0;
+		uint64_t	org = 0;
+		bool		run = false;
+		bool		in = false;
+		uint32_t	events = 0;
+
+		void event(uint64_t t, uint32_t ev, uint32_t a, bool rec) {
+			if(ev == RTOS_TRACE_EV_SWITCH_IN) {
+				if(run) slices.push_back(slice_t { cur, org, t });
+				cur = a;
+				org = t;
+				run = true;
+			}
+			if(rec) {
+				if(!in) wins.push_back(WIN(t, t));
+				wins.back().second = t;
+				++events;
+			}
+			in = rec;
+		}
+
+		void finish() {
+			if(run) slices.push_back(slice_t { cur, org, now });
+			run = false;
+		}
+
+		// 記録出来た期間の実行時間 [us]
+		uint64_t run_time(uint32_t task, const std::vector<WIN>& ws) const {
+			uint64_t sum = 0;
+			for(const auto& s : slices) {
+				if(s.task != task) continue;
+				for(const auto& w : ws) {
+					auto a = std::max(s.s, w.first);
+					auto b = std::min(s.e, w.second);
+					if(a < b) sum += b - a;
+				}
+			}
+			return sum;
+		}
+	};
+
+
+	//-----------------------------------------------------------------//
+	// レコーダーへの入力（時間を進めてから記録）
+	//-----------------------------------------------------------------//
+	template <class TR, class TM>
+	struct driver_t {
+		TR&			tr;
+		model_t&	m;
+
+		void at(uint64_t t, uint32_t ev, uint32_t a = 0, uint32_t b = 0) {
+			TM::raw_ += static_cast<uint32_t>(t - m.now);
+			m.now = t;
+			auto lost = tr.get_lost();
+			tr.put(ev, a, b);
+			m.event(t, ev, a, tr.get_lost() == lost);
+		}
+
+		void task(uint64_t t, uint32_t id, const char* name, uint32_t prio) {
+			TM::raw_ += static_cast<uint32_t>(t - m.now);
+			m.now = t;
+			auto lost = tr.get_lost();
+			tr.task(id, name, prio);
+			m.event(t, RTOS_TRACE_EV_CREATE, id, tr.get_lost() == lost);
+		}
+	};
+
+
+	static const uint32_t AUDIO = 1;
+	static const uint32_t GUI   = 2;
+	static const uint32_t IDLE  = 3;
+	static const uint32_t ISR_NO = 42;
+	static const uint32_t QUEUE = 0x20001234;
+
+	// 1ms 毎のティックで、audio（起床遅延 5us）、gui（107us）、idle が動く @n
+	// ４ティック毎に 20us の割り込み
+	template <class DRV>
+	void script_(DRV& d, uint32_t ticks, std::function<void(uint32_t)> tick_end = nullptr)
+	{
+		d.task(0, AUDIO, "audio", 3);
+		d.task(1, GUI, "gui", 2);
+		d.task(2, IDLE, "idle", 0);
+		d.at(10, RTOS_TRACE_EV_SWITCH_IN, IDLE);
+		for(uint32_t k = 1; k <= ticks; ++k) {
+			uint64_t t0 = k * 1000;
+			d.at(t0, RTOS_TRACE_EV_TICK);
+			d.at(t0, RTOS_TRACE_EV_READY, AUDIO);
+			d.at(t0 + 5, RTOS_TRACE_EV_SWITCH_IN, AUDIO);
+			d.at(t0 + 100, RTOS_TRACE_EV_READY, GUI);
+			d.at(t0 + 205, RTOS_TRACE_EV_QUEUE_RECV, QUEUE);
+			d.at(t0 + 207, RTOS_TRACE_EV_SWITCH_IN, GUI);
+			d.at(t0 + 507, RTOS_TRACE_EV_DELAY);
+			d.at(t0 + 510, RTOS_TRACE_EV_SWITCH_IN, IDLE);
+			if((k % 4) == 0) {
+				d.at(t0 + 600, RTOS_TRACE_EV_ISR_ENTER, ISR_NO);
+				d.at(t0 + 620, RTOS_TRACE_EV_ISR_EXIT);
+			}
+			d.at(t0 + 700, RTOS_TRACE_EV_USER, 1, k);
+			if(tick_end) tick_end(k);
+		}
+		d.at((ticks + 1) * 1000, RTOS_TRACE_EV_TICK);
+		d.m.finish();
+	}
+
+
+	//-----------------------------------------------------------------//
+	// ダンプ
+	//-----------------------------------------------------------------//
+	template <class TR>
+	void read_blocks_(TR& tr, DUMP& out, uint32_t size)
+	{
+		while(const uint8_t* p = tr.get_block()) {
+			out.insert(out.end(), p, p + size);
+			tr.free_block();
+		}
+	}
+
+
+	// save() と同じ（情報ブロック、データ・ブロック）
+	template <class TR>
+	DUMP dump_bin_(TR& tr, uint32_t size)
+	{
+		tr.enable(false);
+		auto p = tr.get_info(tr.get_block_num());
+		DUMP out(p, p + size);
+		read_blocks_(tr, out, size);
+		return out;
+	}
+
+
+	// dump() の出力を文字列に
+	struct hex_form {
+		static std::string	out_;
+		const char*	form_;
+
+		hex_form(const char* form) : form_(form) {
+			if(std::strchr(form, '%') == nullptr) out_ += form;
+		}
+
+		hex_form& operator % (uint32_t v) {
+			char tmp[16];
+			std::snprintf(tmp, sizeof(tmp), form_, v);
+			out_ += tmp;
+			return *this;
+		}
+	};
+	std::string hex_form::out_;
+
+
+	//-----------------------------------------------------------------//
+	// JSON（厳密な構文）
+	//-----------------------------------------------------------------//
+	struct jval {
+		enum class TYPE : uint8_t { NUL, BOOL, NUM, STR, ARR, OBJ };
+		TYPE		type = TYPE::NUL;
+		double		num = 0.0;
+		std::string	str;
+		std::vector<jval>	arr;
+		std::vector<std::pair<std::string, jval>>	obj;
+
+		const jval* get(const char* key) const {
+			for(const auto& kv : obj) {
+				if(kv.first == key) return &kv.second;
+			}
+			return nullptr;
+		}
+
+		std::string get_str(const char* key) const {
+			auto v = get(key);
+			return v != nullptr && v->type == TYPE::STR ? v->str : "";
+		}
+
+		double get_num(const char* key, double def = -1.0) const {
+			auto v = get(key);
+			return v != nullptr && v->type == TYPE::NUM ? v->num : def;
+		}
+	};
+
+
+	class json_parser {
+		const char*	p_;
+		const char*	e_;
+
+		void ws_() {
+			while(p_ < e_ && (*p_ == ' ' || *p_ == '\t' || *p_ == '\n' || *p_ == '\r')) ++p_;
+		}
+
+		bool lit_(const char* s) {
+			auto n = std::strlen(s);
+			if(static_cast<size_t>(e_ - p_) < n || std::strncmp(p_, s, n) != 0) return false;
+			p_ += n;
+			return true;
+		}
+
+		bool digits_() {
+			if(p_ >= e_ || !isdigit(*p_)) return false;
+			while(p_ < e_ && isdigit(*p_)) ++p_;
+			return true;
+		}
+
+		bool num_(double& v) {
+			auto org = p_;
+			if(p_ < e_ && *p_ == '-') ++p_;
+			if(p_ < e_ && *p_ == '0') ++p_;
+			else if(!digits_()) return false;
+			if(p_ < e_ && *p_ == '.') {
+				++p_;
+				if(!digits_()) return false;
+			}
+			if(p_ < e_ && (*p_ == 'e' || *p_ == 'E')) {
+				++p_;
+				if(p_ < e_ && (*p_ == '+' || *p_ == '-')) ++p_;
+				if(!digits_()) return false;
+			}
+			v = std::strtod(std::string(org, p_).c_str(), nullptr);
+			return true;
+		}
+
+		bool str_(std::string& s) {
+			if(p_ >= e_ || *p_ != '"') return false;
+			++p_;
+			while(p_ < e_) {
+				char ch = *p_++;
+				if(ch == '"') return true;
+				if(static_cast<uint8_t>(ch) < 0x20) return false;
+				if(ch != '\\') {
+					s += ch;
+					continue;
+				}
+				if(p_ >= e_) return false;
+				ch = *p_++;
+				switch(ch) {
+				case '"': case '\\': case '/': s += ch; break;
+				case 'b': s += '\b'; break;
+				case 'f': s += '\f'; break;
+				case 'n': s += '\n'; break;
+				case 'r': s += '\r'; break;
+				case 't': s += '\t'; break;
+				case 'u':
+					for(int i = 0; i < 4; ++i) {
+						if(p_ >= e_ || !isxdigit(*p_)) return false;
+						++p_;
+					}
+					s += '?';
+					break;
+				default:
+					return false;
+				}
+			}
+			return false;
+		}
+
+		bool val_(jval& v) {
+			ws_();
+			if(p_ >= e_) return false;
+			if(*p_ == '{') {
+				++p_;
+				v.type = jval::TYPE::OBJ;
+				ws_();
+				if(p_ < e_ && *p_ == '}') { ++p_; return true; }
+				while(1) {
+					ws_();
+					std::string key;
+					if(!str_(key)) return false;
+					ws_();
+					if(p_ >= e_ || *p_++ != ':') return false;
+					v.obj.emplace_back(key, jval());
+					if(!val_(v.obj.back().second)) return false;
+					ws_();
+					if(p_ >= e_) return false;
+					char ch = *p_++;
+					if(ch == '}') return true;
+					if(ch != ',') return false;
+				}
+			} else if(*p_ == '[') {
+				++p_;
+				v.type = jval::TYPE::ARR;
+				ws_();
+				if(p_ < e_ && *p_ == ']') { ++p_; return true; }
+				while(1) {
+					v.arr.emplace_back();
+					if(!val_(v.arr.back())) return false;
+					ws_();
+					if(p_ >= e_) return false;
+					char ch = *p_++;
+					if(ch == ']') return true;
+					if(ch != ',') return false;
+				}
+			} else if(*p_ == '"') {
+				v.type = jval::TYPE::STR;
+				return str_(v.str);
+			} else if(lit_("true") || lit_("false")) {
+				v.type = jval::TYPE::BOOL;
+				return true;
+			} else if(lit_("null")) {
+				return true;
+			}
+			v.type = jval::TYPE::NUM;
+			return num_(v.num);
+		}
+
+	public:
+		bool parse(const std::string& s, jval& v) {
+			p_ = s.data();
+			e_ = p_ + s.size();
+			if(!val_(v)) return false;
+			ws_();
+			return p_ == e_;
+		}
+	};
+
+
+	//-----------------------------------------------------------------//
+	// rtostrace の実行と、統計（stderr）の読み込み
+	//-----------------------------------------------------------------//
+	struct row_t {
+		uint32_t	prio = 0;
+		double		run = 0.0;
+		double		cpu = 0.0;
+		uint32_t	count = 0;
+		double		lat = 0.0;
+		double		max = 0.0;
+	};
+
+	struct stats_t {
+		uint32_t	blocks = 0;
+		uint32_t	events = 0;
+		double		bpe = 0.0;
+		double		time = 0.0;
+		uint32_t	freq = 0;
+		uint32_t	ticks = 0;
+		std::map<std::string, row_t>	tasks;
+		std::map<uint32_t, row_t>		isrs;
+		bool		lost_line = false;
+		uint32_t	lost = 0;
+		uint32_t	lost_total = 0;
+		uint32_t	gaps = 0;
+		double		unknown = 0.0;
+		bool		broken = false;
+		jval		json;
+	};
+
+
+	std::string read_file_(const std::string& path)
+	{
+		std::string s;
+		FILE* fp = std::fopen(path.c_str(), "rb");
+		if(fp == nullptr) return s;
+		char tmp[4096];
+		size_t n;
+		while((n = std::fread(tmp, 1, sizeof(tmp), fp)) > 0) s.append(tmp, n);
+		std::fclose(fp);
+		return s;
+	}
+
+
+	bool parse_stats_(const std::string& text, stats_t& st)
+	{
+		bool head = false;
+		size_t i = 0;
+		while(i < text.size()) {
+			auto j = text.find('\n', i);
+			if(j == std::string::npos) j = text.size();
+			auto line = text.substr(i, j - i);
+			i = j + 1;
+			char name[64];
+			row_t r;
+			if(std::sscanf(line.c_str(), "Blocks: %u, Events: %u (%lf bytes/event), Time: %lf [ms], Freq: %u [Hz], Ticks: %u",
+				&st.blocks, &st.events, &st.bpe, &st.time, &st.freq, &st.ticks) == 6) {
+				head = true;
+			} else if(std::sscanf(line.c_str(), "Lost events: %u (total %u), block gaps: %u, unknown: %lf [ms]",
+				&st.lost, &st.lost_total, &st.gaps, &st.unknown) == 4) {
+				st.lost_line = true;
+			} else if(line.compare(0, 13, "Broken event:") == 0) {
+				st.broken = true;
+			} else if(std::sscanf(line.c_str(), "ISR %u %lf %lf%% %u %lf %lf",
+				&r.prio, &r.run, &r.cpu, &r.count, &r.lat, &r.max) == 6) {
+				st.isrs[r.prio] = r;
+			} else if(std::sscanf(line.c_str(), "%63s %u %lf %lf%% %u %lf %lf",
+				name, &r.prio, &r.run, &r.cpu, &r.count, &r.lat, &r.max) == 7) {
+				st.tasks[name] = r;
+			}
+		}
+		return head;
+	}
+
+
+	bool convert_(const DUMP& dump, const char* base, bool hex, stats_t& st)
+	{
+		std::string src = std::string(base) + (hex ? ".hex" : ".bin");
+		std::string json = std::string(base) + ".json";
+		std::string txt = std::string(base) + ".txt";
+		{
+			FILE* fp = std::fopen(src.c_str(), "wb");
+			if(fp == nullptr) return false;
+			std::fwrite(dump.data(), 1, dump.size(), fp);
+			std::fclose(fp);
+		}
+		std::fflush(stdout);
+		std::fflush(stderr);
+		auto pid = fork();
+		if(pid < 0) return false;
+		if(pid == 0) {
+			if(std::freopen(txt.c_str(), "w", stderr) == nullptr) _exit(2);
+			char* argv[] = { const_cast<char*>("rtostrace"), const_cast<char*>(src.c_str()),
+				const_cast<char*>(json.c_str()), nullptr };
+			int ret = rtostrace_main(3, argv);
+			std::fflush(stderr);
+			_exit(ret);
+		}
+		int status = 0;
+		waitpid(pid, &status, 0);
+		if(!WIFEXITED(status) || WEXITSTATUS(status) != 0) return false;
+
+		if(!parse_stats_(read_file_(txt), st)) return false;
+		json_parser jp;
+		return jp.parse(read_file_(json), st.json);
+	}
+
+
+	//-----------------------------------------------------------------//
+	// JSON の集計
+	//-----------------------------------------------------------------//
+	struct jsum_t {
+		std::map<uint32_t, double>		run;	///< tid 毎の "X" の時間 [us]
+		std::map<uint32_t, uint32_t>	count;	///< tid 毎の "X" の数
+		std::map<uint32_t, std::string>	name;	///< thread_name
+		double		lost = 0.0;
+		uint32_t	user = 0;
+		uint32_t	ready = 0;
+		uint32_t	queue = 0;
+		double		ts_max = 0.0;
+		bool		ok = true;
+	};
+
+
+	jsum_t sum_json_(const jval& js)
+	{
+		jsum_t s;
+		auto evs = js.get("traceEvents");
+		if(js.type != jval::TYPE::OBJ || evs == nullptr || evs->type != jval::TYPE::ARR) {
+			s.ok = false;
+			return s;
+		}
+		for(const auto& e : evs->arr) {
+			auto ph = e.get_str("ph");
+			auto name = e.get_str("name");
+			uint32_t tid = e.get_num("tid", 0);
+			if(e.get_num("pid") != 1.0) s.ok = false;
+			if(ph == "X") {
+				auto ts = e.get_num("ts");
+				auto dur = e.get_num("dur");
+				if(ts < 0.0 || dur < 0.0) s.ok = false;
+				s.ts_max = std::max(s.ts_max, ts + dur);
+				s.run[tid] += dur;
+				++s.count[tid];
+			} else if(ph == "M") {
+				if(name == "thread_name") {
+					auto a = e.get("args");
+					s.name[tid] = a != nullptr ? a->get_str("name") : "";
+				}
+			} else if(ph == "i") {
+				if(e.get_num("ts") < 0.0) s.ok = false;
+				if(name == "lost") {
+					auto a = e.get("args");
+					s.lost += a != nullptr ? a->get_num("events", 0.0) : 0.0;
+				} else if(name == "ready") {
+					++s.ready;
+				} else if(name == "queue recv") {
+					auto a = e.get("args");
+					if(a == nullptr || a->get_str("queue") != "0x20001234") s.ok = false;
+					++s.queue;
+				}
+			} else if(ph == "C") {
+				++s.user;
+			} else {
+				s.ok = false;
+			}
+		}
+		return s;
+	}
+
+
+	bool near_(double a, double b, double eps = 0.01) { return std::fabs(a - b) <= eps; }
+
+
+	// 記録出来た期間について、タスクの実行時間（統計と JSON）を比べる
+	void check_run_(const stats_t& st, const jsum_t& js, const model_t& m, const std::vector<model_t::WIN>& ws)
+	{
+		static const struct {
+			const char*	name;
+			uint32_t	id;
+		} tbl[] = { { "audio", AUDIO }, { "gui", GUI }, { "idle", IDLE } };
+		double all = 0.0;
+		double cpu = 0.0;
+		for(const auto& t : tbl) {
+			auto it = st.tasks.find(t.name);
+			if(!CHECK(it != st.tasks.end())) continue;
+			double exp = m.run_time(t.id, ws);
+			if(!CHECK(near_(it->second.run, exp, 0.05))) {
+				std::fprintf(stderr, "  %s: run %.1f us, expected %.1f us\n", t.name, it->second.run, exp);
+			}
+			CHECK(near_(js.run.at(t.id), exp, 0.001 * js.count.at(t.id) + 0.01));
+			CHECK_EQ(js.name.at(t.id), std::string(t.name));
+			all += exp;
+			cpu += it->second.cpu;
+		}
+		// 記録出来た期間は、いずれかのタスクが動いている
+		double known = 0.0;
+		for(const auto& w : ws) known += w.second - w.first;
+		CHECK(near_(all, known - 10.0, 0.01));		// 最初の切り替えまで 10us
+		CHECK(near_(st.time * 1000.0, known, 1.0));
+		CHECK(near_(cpu, 100.0 * all / known, 0.05));
+	}
+
+
+	// 起床遅延は、レディーから切り替えまで（audio 5us、gui 107us）
+	void check_latency_(const stats_t& st)
+	{
+		auto a = st.tasks.find("audio");
+		auto g = st.tasks.find("gui");
+		if(!CHECK(a != st.tasks.end() && g != st.tasks.end())) return;
+		CHECK(near_(a->second.lat, 5.0));
+		CHECK(near_(a->second.max, 5.0));
+		CHECK(near_(g->second.lat, 107.0));
+		CHECK(near_(g->second.max, 107.0));
+	}
+
+
+	//-----------------------------------------------------------------//
+	// 全てを記録（３２ビット、バイナリ）と、１６ビット・カウンター（dump() の１６進）
+	//-----------------------------------------------------------------//
+	TRACE32	trace32_;
+	TRACE16	trace16_;
+	RING	ring_;
+	STREAM	stream_;
+
+	static const uint32_t TICKS = 200;
+
+	double	bpe_ = 0.0;		///< １イベントのバイト数（スクリプト）
+
+
+	void check_full_(const stats_t& st, const model_t& m)
+	{
+		CHECK(!st.broken);
+		CHECK(!st.lost_line);
+		CHECK_EQ(st.freq, FREQ);
+		CHECK_EQ(st.events, m.events);
+		CHECK_EQ(st.ticks, TICKS + 1);
+		CHECK(near_(st.time, TICKS + 1.0, 0.0005));
+
+		auto js = sum_json_(st.json);
+		CHECK(js.ok);
+		check_run_(st, js, m, m.wins);
+		check_latency_(st);
+		CHECK_EQ(st.tasks.at("audio").count, TICKS);
+		CHECK_EQ(st.tasks.at("gui").count, TICKS);
+		CHECK_EQ(st.tasks.at("idle").count, TICKS + 1);
+		CHECK_EQ(js.count[AUDIO], TICKS);
+		CHECK_EQ(js.count[IDLE], TICKS + 1);
+		CHECK_EQ(st.tasks.at("audio").prio, 3u);
+		// 割り込み
+		if(!CHECK_EQ(st.isrs.size(), 1u) || !CHECK(st.isrs.count(ISR_NO) != 0)) return;
+		const auto& is = st.isrs.at(ISR_NO);
+		CHECK_EQ(is.count, TICKS / 4);
+		CHECK(near_(is.run, 20.0 * TICKS / 4, 0.05));
+		CHECK(near_(is.max, 20.0));
+		CHECK_EQ(js.count[ISR_TID + ISR_NO], TICKS / 4);
+		CHECK_EQ(js.name[ISR_TID + ISR_NO], std::string("ISR 42"));
+		CHECK_EQ(js.user, TICKS);
+		CHECK_EQ(js.ready, TICKS * 2);
+		CHECK_EQ(js.queue, TICKS);
+		CHECK(near_(js.ts_max, (TICKS + 1) * 1000.0, 0.01));
+	}
+
+
+	void test_full_()
+	{
+		model_t m;
+		TM32::raw_ = 0x12345678;
+		trace32_.start();
+		driver_t<TRACE32, TM32> d { trace32_, m };
+		script_(d, TICKS);
+		CHECK_EQ(m.wins.size(), 1u);
+		CHECK_EQ(trace32_.get_lost(), 0u);
+		auto dump = dump_bin_(trace32_, 512);
+		CHECK(std::memcmp(dump.data(), "RTTR", 4) == 0);
+		stats_t st;
+		if(!CHECK(convert_(dump, "trace_32", false, st))) return;
+		check_full_(st, m);
+		bpe_ = st.bpe;
+	}
+
+
+	void test_cmt16_()
+	{
+		// 開始直後に周回、全体で約３周
+		model_t m;
+		TM16::raw_ = 0xff00;
+		trace16_.start();
+		driver_t<TRACE16, TM16> d { trace16_, m };
+		script_(d, TICKS);
+		CHECK(m.now > 3 * 65536);
+		// 実行時間統計のカウンターも拡張した時間
+		CHECK_EQ(trace16_.get_runtime(), m.now);
+		hex_form::out_.clear();
+		trace16_.dump<hex_form>();
+		CHECK(hex_form::out_[0] == '#');
+		CHECK_EQ(trace16_.get_block_num(), 0u);
+		DUMP dump(hex_form::out_.begin(), hex_form::out_.end());
+		stats_t st;
+		if(!CHECK(convert_(dump, "trace_16", true, st))) return;
+		check_full_(st, m);
+	}
+
+
+	//-----------------------------------------------------------------//
+	// リング（古いブロックを上書き）
+	//-----------------------------------------------------------------//
+	void test_ring_()
+	{
+		model_t m;
+		TM32::raw_ = 0xfffff000;
+		ring_.start(RING::MODE::RING);
+		driver_t<RING, TM32> d { ring_, m };
+		script_(d, TICKS);
+		auto dump = dump_bin_(ring_, 256);
+		CHECK_EQ(dump.size(), 256u * 5);
+		// 残るのは最後の４ブロック、最初のブロックの時間から後
+		const uint8_t* b = &dump[256];
+		uint32_t seq = get32_(b);
+		uint64_t t = get32_(b + 8) | (static_cast<uint64_t>(get32_(b + 12)) << 32);
+		CHECK(seq > 4);
+		CHECK(t > 100000);
+		std::vector<model_t::WIN> ws = { model_t::WIN(t, m.now) };
+
+		stats_t st;
+		if(!CHECK(convert_(dump, "trace_ring", false, st))) return;
+		CHECK(!st.broken);
+		CHECK(!st.lost_line);
+		CHECK_EQ(st.blocks, 4u);
+		auto js = sum_json_(st.json);
+		CHECK(js.ok);
+		// 残った期間は、いずれかのタスクが動いている
+		double known = m.now - t;
+		double exp = 0.0;
+		for(auto id : { AUDIO, GUI, IDLE }) exp += m.run_time(id, ws);
+		CHECK(near_(exp, known));
+		// 名前は情報ブロックから（CREATE は上書きされている）
+		for(auto id : { AUDIO, GUI, IDLE }) {
+			const char* name = id == AUDIO ? "audio" : (id == GUI ? "gui" : "idle");
+			auto it = st.tasks.find(name);
+			if(!CHECK(it != st.tasks.end())) continue;
+			CHECK(near_(it->second.run, m.run_time(id, ws), 0.05));
+			CHECK(near_(js.run[id], m.run_time(id, ws), 0.001 * js.count[id] + 0.01));
+			CHECK_EQ(js.name[id], std::string(name));
+		}
+		CHECK(near_(st.time * 1000.0, known, 1.0));
+		check_latency_(st);
+		std::printf("ring: blocks %u..%u, %.3f ms of %.3f ms\n", seq, seq + 3,
+			known * 1e-3, m.now * 1e-3);
+	}
+
+
+	//-----------------------------------------------------------------//
+	// ストリーム（読み出しが止まった期間のイベントは LOST）
+	//-----------------------------------------------------------------//
+	void test_stream_()
+	{
+		model_t m;
+		TM16::raw_ = 0x8000;
+		stream_.start(STREAM::MODE::STREAM);
+		driver_t<STREAM, TM16> d { stream_, m };
+		DUMP blocks;
+		// 80ms から 40ms の間、読み出しが止まる
+		script_(d, TICKS, [&](uint32_t k) {
+			if(k < 80 || k >= 120) read_blocks_(stream_, blocks, 256);
+		});
+		stream_.flush();
+		read_blocks_(stream_, blocks, 256);
+		auto lost = stream_.get_lost();
+		CHECK(lost > 100);
+		CHECK_EQ(m.wins.size(), 2u);
+		auto p = stream_.get_info(0);
+		DUMP dump(p, p + 256);
+		dump.insert(dump.end(), blocks.begin(), blocks.end());
+
+		stats_t st;
+		if(!CHECK(convert_(dump, "trace_stream", false, st))) return;
+		CHECK(!st.broken);
+		CHECK(st.lost_line);
+		CHECK_EQ(st.lost, lost);
+		CHECK_EQ(st.lost_total, lost);
+		CHECK_EQ(st.gaps, 0u);
+		CHECK_EQ(st.blocks, blocks.size() / 256);
+		// 状態の分からない期間は、記録出来た最後のイベントから、欠落後の最初のイベントまで
+		double unknown = m.wins[1].first - m.wins[0].second;
+		CHECK(near_(st.unknown * 1000.0, unknown, 1.0));
+		// ４ブロック分は読み出しが止まっても記録出来る
+		CHECK(unknown > 10000.0 && unknown < 40000.0);
+		auto js = sum_json_(st.json);
+		CHECK(js.ok);
+		CHECK(near_(js.lost, lost));
+		check_run_(st, js, m, m.wins);
+		check_latency_(st);
+		std::printf("stream: lost %u events, unknown %.3f ms\n", lost, unknown * 1e-3);
+	}
+
+
+	//-----------------------------------------------------------------//
+	// put() の時間、１イベントのバイト数
+	//-----------------------------------------------------------------//
+	void bench_()
+	{
+		static const uint32_t LOOP = 4000000;
+		TM16::raw_ = 0;
+		trace16_.start();
+		test::stopwatch sw;
+		for(uint32_t i = 0; i < LOOP; ++i) {
+			TM16::raw_ += 37;
+			trace16_.put(RTOS_TRACE_EV_SWITCH_IN, 1 + (i & 3));
+		}
+		auto sec = sw.sec();
+		trace16_.enable(false);
+		CHECK_EQ(trace16_.get_lost(), 0u);
+		std::printf("bench: put() %.1f ns/event, %.2f bytes/event (%u ticks of the script)\n",
+			sec * 1e9 / LOOP, bpe_, TICKS);
+	}
+}
+
+
+int main(int argc, char* argv[])
+{
+	test_full_();
+	test_cmt16_();
+	test_ring_();
+	test_stream_();
+
+	bench_();
+
+	return test::result("rtos_trace");
+}
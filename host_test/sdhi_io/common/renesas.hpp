@@ -0,0 +1,173 @@
+#pragma once
+//=====================================================================//
+/*!	@file
+	@brief	ホスト・テスト用 common/renesas.hpp の代用 @n
+			sdhi_io が使う SDHI/DMAC レジスタを、sim::read/sim::write（main.cpp のモデル）@n
+			に繋ぐ
+    @author 平松邦仁 (hira@rvf-rc45.net)
+	@copyright	Copyright (C) 2021 Kunihito Hiramatsu @n
+				Released under the MIT license @n
+				https://github.com/hirakuni45/RX/blob/master/LICENSE
+*/
+//=====================================================================//
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include "common/vect.h"
+#include "common/delay.hpp"
+
+// ホストの <endian.h> が定義する BIG_ENDIAN は RX の意味と違う
+#include <endian.h>
+#undef BIG_ENDIAN
+#ifndef LITTLE_ENDIAN
+#define LITTLE_ENDIAN
+#endif
+
+namespace sim {
+	enum REG : int {
+		SDCMD, SDARG, SDSTOP, SDBLKCNT, SDRSP10, SDRSP32, SDRSP54, SDRSP76,
+		SDSTS1, SDSTS2, SDIMSK1, SDIMSK2, SDCLKCR, SDSIZE, SDOPT, SDBUFR,
+		SDDMAEN, SDRST, SDSWAP,
+		DMSAR, DMDAR, DMCRA, DMCRB, DMTMD, DMINT, DMAMD, DMCNT, DMREQ, DMSTS, DMCSL,
+		DMAST, REG_NUM
+	};
+	uint32_t read(int id);
+	void write(int id, uint32_t v);
+	uint32_t peek(int id);
+	void advance(double us);
+	extern uint8_t ier[256];
+	extern uint8_t dmrsr;
+}
+
+namespace device {
+
+	enum class peripheral : uint16_t { SDHI, DMAC0 };
+
+	struct ICU {
+		enum class VECTOR : uint8_t { NONE = 0, SBFAI = 44, DMAC0I = 198 };
+	};
+
+	struct clock_profile {
+		static constexpr uint32_t PCLKB = 60'000'000;
+	};
+
+	struct power_mgr {
+		static void turn(peripheral, bool ena = true) { }
+	};
+
+	struct icu_mgr {
+		static void set_level(ICU::VECTOR vec, uint32_t lvl) { sim::ier[static_cast<uint8_t>(vec)] = lvl > 0; }
+		static bool set_dmac(peripheral, ICU::VECTOR vec) { sim::dmrsr = static_cast<uint8_t>(vec); return true; }
+	};
+
+	struct port_map {
+		enum class ORDER : uint8_t { FIRST, SECOND, THIRD };
+		enum class sdhi_situation : uint8_t { START, INSERT, BUS, EJECT, DESTROY };
+		static void turn_sdhi(sdhi_situation, ORDER) { }
+		static uint32_t probe_sdhi_clock(ORDER) { static uint32_t n = 0; ++n; return (n >> 1) & 1; }
+	};
+
+	struct null_bit {
+		void operator = (uint32_t) { }
+		uint32_t operator () () const { return 0; }
+	};
+	struct NULL_PORT {
+		static constexpr uint8_t BIT_POS = 0xFF;
+		static null_bit DIR;
+		static null_bit P;
+		static null_bit PU;
+	};
+	inline null_bit NULL_PORT::DIR;
+	inline null_bit NULL_PORT::P;
+	inline null_bit NULL_PORT::PU;
+
+	// 汎用レジスタ
+	template <int ID, uint32_t ADR = 0>
+	struct reg_t {
+		static uint32_t address() { return ADR; }
+		uint32_t operator () () const { return sim::read(ID); }
+		void operator = (uint32_t v) { sim::write(ID, v); }
+	};
+
+	template <int ID, int POS, int LEN = 1>
+	struct bits_t {
+		static constexpr uint32_t M = (LEN >= 32) ? 0xFFFFFFFF : ((1u << LEN) - 1);
+		static constexpr uint32_t b(uint32_t v = 1) { return (v & M) << POS; }
+		uint32_t operator () () const { return (sim::read(ID) >> POS) & M; }
+		void operator = (uint32_t v) { sim::write(ID, (sim::peek(ID) & ~(M << POS)) | ((v & M) << POS)); }
+	};
+
+	struct SDHI {
+		static constexpr auto PERIPHERAL = peripheral::SDHI;
+		static constexpr auto SBFA_VEC = ICU::VECTOR::SBFAI;
+
+		struct sdcmd_t : reg_t<sim::SDCMD> { using reg_t::operator =; };
+		static inline sdcmd_t SDCMD;
+		static inline reg_t<sim::SDARG> SDARG;
+		struct sdstop_t : reg_t<sim::SDSTOP> { using reg_t::operator =;
+			bits_t<sim::SDSTOP, 0> STP; bits_t<sim::SDSTOP, 8> SDBLKCNTEN; };
+		static inline sdstop_t SDSTOP;
+		static inline reg_t<sim::SDBLKCNT> SDBLKCNT;
+		static inline reg_t<sim::SDRSP10> SDRSP10;
+		static inline reg_t<sim::SDRSP32> SDRSP32;
+		static inline reg_t<sim::SDRSP54> SDRSP54;
+		static inline reg_t<sim::SDRSP76> SDRSP76;
+		struct sdsts1_t : reg_t<sim::SDSTS1> { using reg_t::operator =;
+			bits_t<sim::SDSTS1, 0> RSPEND; bits_t<sim::SDSTS1, 2> ACEND;
+			bits_t<sim::SDSTS1, 5> SDCDMON; bits_t<sim::SDSTS1, 7> SDWPMON; };
+		static inline sdsts1_t SDSTS1;
+		struct sdsts2_t : reg_t<sim::SDSTS2> { using reg_t::operator =;
+			bits_t<sim::SDSTS2, 0> CMDE; bits_t<sim::SDSTS2, 1> CRCE; bits_t<sim::SDSTS2, 2> ENDE;
+			bits_t<sim::SDSTS2, 3> DTO; bits_t<sim::SDSTS2, 4> ILW; bits_t<sim::SDSTS2, 5> ILR;
+			bits_t<sim::SDSTS2, 6> RSPTO; bits_t<sim::SDSTS2, 8> BRE; bits_t<sim::SDSTS2, 9> BWE;
+			bits_t<sim::SDSTS2, 13> SDCLKCREN; bits_t<sim::SDSTS2, 14> CBSY; bits_t<sim::SDSTS2, 15> ILA; };
+		static inline sdsts2_t SDSTS2;
+		static inline reg_t<sim::SDIMSK1> SDIMSK1;
+		struct sdimsk2_t : reg_t<sim::SDIMSK2> { using reg_t::operator =;
+			bits_t<sim::SDIMSK2, 8> BREM; bits_t<sim::SDIMSK2, 9> BWEM; };
+		static inline sdimsk2_t SDIMSK2;
+		struct sdclkcr_t : reg_t<sim::SDCLKCR> { using reg_t::operator =;
+			bits_t<sim::SDCLKCR, 0, 8> CLKSEL; bits_t<sim::SDCLKCR, 8> CLKEN; bits_t<sim::SDCLKCR, 9> CLKCTRLEN; };
+		static inline sdclkcr_t SDCLKCR;
+		static inline reg_t<sim::SDSIZE> SDSIZE;
+		struct sdopt_t : reg_t<sim::SDOPT> { using reg_t::operator =;
+			bits_t<sim::SDOPT, 0, 4> CTOP; bits_t<sim::SDOPT, 4, 4> TOP; bits_t<sim::SDOPT, 15> WIDTH; };
+		static inline sdopt_t SDOPT;
+		static inline reg_t<sim::SDBUFR, 0x0008AC60> SDBUFR;
+		struct sddmaen_t : reg_t<sim::SDDMAEN> { using reg_t::operator =; bits_t<sim::SDDMAEN, 1> DMAEN; };
+		static inline sddmaen_t SDDMAEN;
+		struct sdrst_t : reg_t<sim::SDRST> { using reg_t::operator =; bits_t<sim::SDRST, 0> SDRST; };
+		static inline sdrst_t SDRST;
+	};
+
+	struct DMAC0 {
+		static constexpr auto PERIPHERAL = peripheral::DMAC0;
+		static constexpr auto IVEC = ICU::VECTOR::DMAC0I;
+		static inline reg_t<sim::DMSAR> DMSAR;
+		static inline reg_t<sim::DMDAR> DMDAR;
+		static inline reg_t<sim::DMCRA> DMCRA;
+		static inline reg_t<sim::DMCRB> DMCRB;
+		struct dmtmd_t : reg_t<sim::DMTMD> { using reg_t::operator =;
+			bits_t<sim::DMTMD, 0, 2> DCTG; bits_t<sim::DMTMD, 8, 2> SZ;
+			bits_t<sim::DMTMD, 12, 2> DTS; bits_t<sim::DMTMD, 14, 2> MD; };
+		static inline dmtmd_t DMTMD;
+		struct dmint_t : reg_t<sim::DMINT> { using reg_t::operator =; bits_t<sim::DMINT, 4> DTIE; };
+		static inline dmint_t DMINT;
+		struct dmamd_t : reg_t<sim::DMAMD> { using reg_t::operator =;
+			bits_t<sim::DMAMD, 6, 2> DM; bits_t<sim::DMAMD, 14, 2> SM; };
+		static inline dmamd_t DMAMD;
+		struct dmcnt_t : reg_t<sim::DMCNT> { using reg_t::operator =; bits_t<sim::DMCNT, 0> DTE; };
+		static inline dmcnt_t DMCNT;
+		struct dmreq_t : reg_t<sim::DMREQ> { using reg_t::operator =;
+			bits_t<sim::DMREQ, 0> SWREQ; bits_t<sim::DMREQ, 4> CLRS; };
+		static inline dmreq_t DMREQ;
+		struct dmsts_t : reg_t<sim::DMSTS> { using reg_t::operator =;
+			bits_t<sim::DMSTS, 0> ESIF; bits_t<sim::DMSTS, 4> DTIF; bits_t<sim::DMSTS, 7> ACT; };
+		static inline dmsts_t DMSTS;
+		struct dmcsl_t : reg_t<sim::DMCSL> { using reg_t::operator =; bits_t<sim::DMCSL, 0> DISEL; };
+		static inline dmcsl_t DMCSL;
+	};
+
+	struct dmast_t : reg_t<sim::DMAST> { using reg_t::operator =; bits_t<sim::DMAST, 0> DMST; };
+	inline dmast_t DMAST;
+}
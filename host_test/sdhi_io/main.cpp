@@ -0,0 +1,571 @@
+//=====================================================================//
+/*!	@file
+	@brief	sdhi_io、SDHI/DMAC レジスタ・モデルでのテスト @n
+			SD カード（CMD/応答、ブロック転送、CRC エラー、プログラム・ビジー）と @n
+			DMAC（SBFAI 起動、ブロック転送、完了割り込み）をモデル化し、@n
+			初期化、HS 切り替え、DMA/CPU 転送、CRC エラーでのクロック低下を確認する。@n
+			RTOS 有効で、スケジューラー起動前に vTaskDelay/ulTaskNotifyTake を @n
+			呼ばない事、起動後は長い待ちをタスクに譲る事を確認する。@n
+			時間はモデルの時間（us）で、転送速度を「bench:」行で表示する
+    @author 平松邦仁 (hira@rvf-rc45.net)
+	@copyright	Copyright (C) 2021 Kunihito Hiramatsu @n
+				Released under the MIT license @n
+				https://github.com/hirakuni45/RX/blob/master/LICENSE
+*/
+//=====================================================================//
+#include <vector>
+#include <sys/mman.h>
+#include "test.hpp"
+#include "common/renesas.hpp"
+#include "RX600/sdhi_io.hpp"
+
+//----- SD カード、DMAC のモデル -----//
+namespace sim {
+
+	uint32_t regs[REG_NUM];
+	void (*vec_task[256])();
+	uint8_t ier[256];
+	uint8_t dmrsr;
+	double now = 0.0;
+
+	std::vector<uint8_t> image(16384 * 512);
+	bool hs_support = true;
+	bool hs_active = false;
+	bool hs_broken = false;		// HS に切り替わるが、25MHz を超えると CRC エラー
+	uint32_t crc_inject = 0;	// 次の n ブロックで CRC エラー
+	bool bus4 = false;
+	uint32_t dma_blocks = 0;
+	uint32_t bad = 0;
+	double prog_busy = 250.0;	// 書き込み後のプログラム・ビジー (us)
+
+	struct xfer_t {
+		bool	active = false;
+		bool	read = false;
+		uint32_t left = 0;
+		uint32_t sector = 0;
+		uint32_t buf[128];
+		uint32_t words = 128;
+		uint32_t idx = 0;
+		bool	full = false;
+		bool	wait_bwe = false;
+		double	ready_at = 0;
+		bool	acend_pend = false;
+		double	acend_at = 0;
+		const uint8_t* src = nullptr;	// 固定データ (CMD6/CMD9)
+	} x;
+	uint8_t fixed[64];
+
+	uint32_t clk() {
+		uint32_t sel = regs[SDCLKCR] & 0xFF;
+		uint32_t div = sel == 0xFF ? 1 : (sel == 0 ? 2 : (sel << 2));
+		return 60'000'000 / div;
+	}
+	double block_us(uint32_t bytes) {
+		double bits = bytes * 8 + 16 * 8 + 2;
+		return bits / (bus4 ? 4.0 : 1.0) / clk() * 1e6;
+	}
+	bool data_crc() {
+		if(crc_inject > 0) { --crc_inject; return true; }
+		uint32_t lim = hs_active ? 50'000'000 : 25'000'000;
+		if(hs_broken) lim = 25'000'000;
+		return clk() > lim;
+	}
+
+	uint32_t buf_read() {
+		if(!x.active || !x.read || !x.full) { ++bad; return 0; }
+		uint32_t v = x.buf[x.idx++];
+		if(x.idx >= x.words) {
+			x.full = false;
+			x.idx = 0;
+			regs[SDSTS2] &= ~(1u << 8);
+			--x.left;
+			if(x.left == 0) {
+				x.acend_pend = true;
+				x.acend_at = now + 1.0;
+			} else {
+				x.ready_at = now + block_us(512);
+			}
+		}
+		return v;
+	}
+
+	void buf_write(uint32_t v) {
+		if(!x.active || x.read || x.wait_bwe) { ++bad; return; }
+		x.buf[x.idx++] = v;
+		if(x.idx >= 128) {
+			x.idx = 0;
+			regs[SDSTS2] &= ~(1u << 9);
+			if(data_crc()) {
+				regs[SDSTS2] |= 2;  // CRCE
+				x.active = false;
+				return;
+			}
+			std::memcpy(&image[x.sector * 512], x.buf, 512);
+			++x.sector;
+			--x.left;
+			if(x.left == 0) {
+				x.acend_pend = true;
+				x.acend_at = now + block_us(512) + prog_busy;
+			} else {
+				x.wait_bwe = true;
+				x.ready_at = now + block_us(512) + 5.0;
+			}
+		}
+	}
+
+	void mem_or_fifo_copy(uint32_t& src, uint32_t& dst, uint32_t num, uint32_t sm, uint32_t dm) {
+		for(uint32_t i = 0; i < num; ++i) {
+			uint32_t v;
+			if(src == 0x0008AC60) v = buf_read();
+			else std::memcpy(&v, reinterpret_cast<void*>(static_cast<uintptr_t>(src)), 4);
+			if(dst == 0x0008AC60) buf_write(v);
+			else std::memcpy(reinterpret_cast<void*>(static_cast<uintptr_t>(dst)), &v, 4);
+			if(sm == 0b10) src += 4;
+			if(dm == 0b10) dst += 4;
+		}
+	}
+
+	void process() {
+		if(x.active && x.read && !x.full && x.left > 0 && now >= x.ready_at) {
+			if(x.src != nullptr) {
+				std::memcpy(x.buf, x.src, x.words * 4);
+			} else {
+				if(data_crc()) {
+					regs[SDSTS2] |= 2;  // CRCE
+					x.active = false;
+					return;
+				}
+				std::memcpy(x.buf, &image[x.sector * 512], 512);
+				++x.sector;
+			}
+			x.full = true;
+			x.idx = 0;
+			regs[SDSTS2] |= 1u << 8;  // BRE
+		}
+		if(x.active && !x.read && x.wait_bwe && now >= x.ready_at) {
+			x.wait_bwe = false;
+			regs[SDSTS2] |= 1u << 9;  // BWE
+		}
+		if(x.acend_pend && now >= x.acend_at) {
+			x.acend_pend = false;
+			x.active = false;
+			regs[SDSTS1] |= 1u << 2;
+		}
+		// DMAC (SBFAI 起動)
+		if((regs[DMCNT] & 1) && (regs[DMAST] & 1) && dmrsr == 44 && ier[44] && (regs[SDDMAEN] & 2)
+			&& (regs[SDSTS2] & (3u << 8))) {
+			uint32_t tmd = regs[DMTMD];
+			if(((tmd >> 14) & 3) != 0b10 || (tmd & 3) != 1 || ((tmd >> 8) & 3) != 2) { ++bad; return; }
+			if(((regs[DMCRA] >> 16) & 0x3FF) != (regs[DMCRA] & 0x3FF)) ++bad;
+			uint32_t sm = (regs[DMAMD] >> 14) & 3;
+			uint32_t dm = (regs[DMAMD] >> 6) & 3;
+			uint32_t src = regs[DMSAR];
+			uint32_t dst = regs[DMDAR];
+			mem_or_fifo_copy(src, dst, regs[DMCRA] & 0x3FF, sm, dm);
+			now += (regs[DMCRA] & 0x3FF) * 0.017;  // 2 cycle @ 120MHz
+			regs[DMSAR] = src;
+			regs[DMDAR] = dst;
+			++dma_blocks;
+			uint32_t b = regs[DMCRB] == 0 ? 1024 : regs[DMCRB];
+			--b;
+			regs[DMCRB] = b;
+			if(b == 0) {
+				regs[DMCNT] = 0;
+				regs[DMSTS] |= 1u << 4;
+				if((regs[DMINT] & (1u << 4)) && ier[198] && vec_task[198] != nullptr) {
+					vec_task[198]();
+				}
+			}
+		}
+	}
+
+	void advance(double us) { now += us; process(); }
+
+	uint32_t peek(int id) {
+		if(id == SDSTS1) return regs[id] | (1u << 5);
+		if(id == SDSTS2) return regs[id] | (1u << 13);
+		return regs[id];
+	}
+
+	uint32_t read(int id) {
+		now += 0.02;
+		process();
+		if(id == SDBUFR) return buf_read();
+		return peek(id);
+	}
+
+	void command(uint32_t v) {
+		regs[SDSTS1] &= ~1u;
+		uint32_t idx = v & 0x3F;
+		bool app = ((v >> 6) & 3) == 1;
+		uint32_t arg = regs[SDARG];
+		auto resp = [&](uint32_t r) { regs[SDRSP10] = r; regs[SDSTS1] |= 1; };
+		if(v == 0x1C06) {  // CMD6
+			if(regs[SDSIZE] != 64) { ++bad; regs[SDSTS2] |= 1; return; }
+			std::memset(fixed, 0, sizeof(fixed));
+			fixed[13] = hs_support ? 0x03 : 0x01;
+			if(hs_support && (arg & 0xF) == 1) {
+				fixed[16] = 0x01;
+				if(arg & 0x80000000) hs_active = true;
+			} else {
+				fixed[16] = 0x00;
+			}
+			x = xfer_t();
+			x.active = true; x.read = true; x.left = 1; x.words = 16; x.src = fixed;
+			x.ready_at = now + 50.0;
+			resp(0x900);
+			return;
+		}
+		if(app) {
+			switch(idx) {
+			case 41: resp(0xC0FF8000); return;
+			case 6: bus4 = (arg & 3) == 2; resp(0x900); return;
+			default: regs[SDSTS2] |= 1; return;
+			}
+		}
+		switch(idx) {
+		case 0: regs[SDSTS1] |= 1; hs_active = false; bus4 = false; return;
+		case 8: resp(0x1AA); return;
+		case 55: resp(0x120); return;
+		case 2: regs[SDRSP76] = 0x00035344; regs[SDRSP54] = 0x53443136; regs[SDRSP32] = 0x47800000; resp(0x01234567); return;
+		case 3: resp(0x12340500); return;
+		case 7: resp(0x00000700); return;
+		case 16: resp(0x900); return;
+		case 9:
+			{
+				std::memset(fixed, 0, sizeof(fixed));
+				fixed[0] = 0x40;
+				uint32_t cs = image.size() / (512 * 1024) - 1;
+				fixed[7] = (cs >> 16) & 63; fixed[8] = cs >> 8; fixed[9] = cs;
+				x = xfer_t();
+				x.active = true; x.read = true; x.left = 1; x.words = 4; x.src = fixed;
+				x.ready_at = now + 10.0;
+				resp(0x900);
+			}
+			return;
+		case 17: case 18: case 24: case 25:
+			{
+				if(regs[SDSIZE] != 512) ++bad;
+				x = xfer_t();
+				x.active = true;
+				x.read = idx < 20;
+				x.left = (idx == 17 || idx == 24) ? 1 : regs[SDBLKCNT];
+				x.sector = arg;
+				if((x.sector + x.left) * 512 > image.size()) { ++bad; regs[SDSTS2] |= 1; return; }
+				x.ready_at = now + (x.read ? 100.0 : 2.0);
+				x.wait_bwe = !x.read;
+				resp(0x900);
+			}
+			return;
+		default:
+			regs[SDSTS2] |= 1;
+			return;
+		}
+	}
+
+	void write(int id, uint32_t v) {
+		now += 0.02;
+		switch(id) {
+		case SDSTS1: regs[id] &= v; break;
+		case SDSTS2: regs[id] &= v; break;
+		case SDCMD: regs[id] = v; command(v); break;
+		case SDBUFR: buf_write(v); break;
+		case SDSTOP:
+			regs[id] = v;
+			if(v & 1) { x.active = false; x.acend_pend = false; }
+			break;
+		default: regs[id] = v; break;
+		}
+		process();
+	}
+}
+
+
+//----- スケジューラーの状態を切り替えられる FreeRTOS API（モデルの時間）-----//
+namespace {
+
+	BaseType_t	sch_state_ = taskSCHEDULER_NOT_STARTED;
+	uint32_t	notify_ = 0;
+	uint32_t	delay_num_ = 0;		///< vTaskDelay の回数
+	uint32_t	take_num_ = 0;		///< ulTaskNotifyTake の回数
+	uint32_t	misuse_ = 0;		///< スケジューラー起動前の呼び出し
+
+	bool running_() { return sch_state_ == taskSCHEDULER_RUNNING; }
+}
+
+extern "C" {
+
+	BaseType_t xTaskGetSchedulerState(void) { return sch_state_; }
+
+
+	TaskHandle_t xTaskGetCurrentTaskHandle(void)
+	{
+		static int task;
+		if(!running_()) ++misuse_;
+		return &task;
+	}
+
+
+	void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t* woken)
+	{
+		++notify_;
+		*woken = pdTRUE;
+	}
+
+
+	uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t wait)
+	{
+		if(!running_()) ++misuse_;
+		++take_num_;
+		for(uint32_t i = 0; i < (wait * 1000) && notify_ == 0; ++i) {
+			sim::advance(1);
+		}
+		auto n = notify_;
+		notify_ = 0;
+		return n;
+	}
+
+
+	void vTaskDelay(TickType_t ticks)
+	{
+		if(!running_()) ++misuse_;
+		++delay_num_;
+		sim::advance(ticks * 1000.0);
+	}
+}
+
+
+namespace {
+
+	struct SDC_POWER {
+		static inline device::null_bit DIR, P, PU;
+	};
+
+	typedef fatfs::sdhi_io<device::SDHI, SDC_POWER, device::NULL_PORT, device::port_map::ORDER::THIRD> SDC_CPU;
+	typedef fatfs::sdhi_io<device::SDHI, SDC_POWER, device::NULL_PORT, device::port_map::ORDER::THIRD, device::DMAC0> SDC_DMA;
+
+	uint8_t*	wbuf_;
+	uint8_t*	rbuf_;
+
+
+	/// DMAC のアドレスは 32 ビットなので、下位 4G に確保する
+	uint8_t* low_alloc_(size_t sz)
+	{
+		void* p = mmap(nullptr, sz, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_32BIT, -1, 0);
+		return p == MAP_FAILED ? nullptr : static_cast<uint8_t*>(p);
+	}
+
+
+	void reset_card_(bool hs, bool broken = false)
+	{
+		std::memset(sim::regs, 0, sizeof(sim::regs));
+		sim::hs_support = hs;
+		sim::hs_broken = broken;
+		sim::hs_active = false;
+		sim::x = sim::xfer_t();
+		sim::crc_inject = 0;
+		sim::prog_busy = 250.0;
+		sim::bad = 0;
+	}
+
+
+	/// 書き込んで、読み出しの速度 (MB/s)
+	template <class SDC>
+	double read_speed_(SDC& sdc, uint32_t sector, uint32_t count, uint32_t loops, bool& ok)
+	{
+		ok = true;
+		for(uint32_t i = 0; i < loops; ++i) {
+			for(uint32_t j = 0; j < (count * 512); ++j) wbuf_[j] = rand();
+			if(sdc.disk_write(0, wbuf_, sector + i * count, count) != RES_OK) ok = false;
+		}
+		auto t0 = sim::now;
+		for(uint32_t i = 0; i < loops; ++i) {
+			if(sdc.disk_read(0, rbuf_, sector + i * count, count) != RES_OK) ok = false;
+			if(std::memcmp(rbuf_, &sim::image[(sector + i * count) * 512], count * 512) != 0) ok = false;
+		}
+		return (count * 512.0 * loops) / (sim::now - t0);
+	}
+
+
+	template <class SDC>
+	double write_speed_(SDC& sdc, uint32_t sector, uint32_t count, uint32_t loops, bool& ok)
+	{
+		ok = true;
+		auto t0 = sim::now;
+		for(uint32_t i = 0; i < loops; ++i) {
+			if(sdc.disk_write(0, wbuf_, sector + i * count, count) != RES_OK) ok = false;
+			if(std::memcmp(wbuf_, &sim::image[(sector + i * count) * 512], count * 512) != 0) ok = false;
+		}
+		return (count * 512.0 * loops) / (sim::now - t0);
+	}
+
+
+	void test_dma_()
+	{
+		reset_card_(true);
+		SDC_DMA sdc;
+		sdc.start(1);
+		CHECK(sdc.disk_initialize(0) == 0);
+		CHECK(sdc.is_high_speed());
+		CHECK_EQ(sdc.get_bus_clock(), 30'000'000u);
+		CHECK(sim::bus4);
+		DWORD n = 0;
+		CHECK(sdc.disk_ioctl(0, GET_SECTOR_COUNT, &n) == RES_OK);
+		CHECK_EQ(n, 16384u);
+		bool ok;
+		auto rd = read_speed_(sdc, 100, 128, 16, ok);
+		CHECK(ok);
+		auto wr = write_speed_(sdc, 4000, 128, 16, ok);
+		CHECK(ok);
+		auto rd1 = read_speed_(sdc, 3000, 1, 64, ok);
+		CHECK(ok);
+		std::printf("bench: DMA HS 30MHz: read 64K %.2f MB/s, write 64K %.2f MB/s, read 512 %.2f MB/s\n",
+			rd, wr, rd1);
+		auto dmat = sdc.get_stat().dma_trans;
+		CHECK(dmat > 0);
+
+		// 非整列バッファは CPU 転送
+		CHECK(sdc.disk_write(0, wbuf_ + 1, 50, 3) == RES_OK);
+		CHECK(sdc.disk_read(0, rbuf_ + 2, 50, 3) == RES_OK);
+		CHECK(std::memcmp(wbuf_ + 1, rbuf_ + 2, 3 * 512) == 0);
+		CHECK_EQ(sdc.get_stat().dma_trans, dmat);
+
+		// 非同期
+		for(uint32_t i = 0; i < (512 * 8); ++i) wbuf_[i] = i * 7;
+		CHECK(sdc.start_write(0, wbuf_, 200, 8) == RES_OK);
+		CHECK(sdc.probe_trans());
+		sim::advance(20);  // 他の処理
+		CHECK(sdc.sync_trans() == RES_OK);
+		CHECK(!sdc.probe_trans());
+		CHECK(sdc.start_read(0, rbuf_, 200, 8) == RES_OK);
+		CHECK(sdc.probe_trans());
+		CHECK(sdc.disk_ioctl(0, CTRL_SYNC, nullptr) == RES_OK);
+		CHECK(std::memcmp(wbuf_, rbuf_, 8 * 512) == 0);
+
+		// CRC エラー１回 -> クロックを下げて再試行
+		sim::crc_inject = 1;
+		CHECK(sdc.disk_read(0, rbuf_, 100, 16) == RES_OK);
+		CHECK(std::memcmp(rbuf_, &sim::image[100 * 512], 16 * 512) == 0);
+		CHECK_EQ(sdc.get_stat().retry, 1u);
+		CHECK_EQ(sdc.get_stat().crc_error, 1u);
+		CHECK_EQ(sdc.get_bus_clock(), 15'000'000u);
+		CHECK_EQ(sim::bad, 0u);
+	}
+
+
+	void test_dma_poll_()
+	{
+		reset_card_(true);
+		SDC_DMA sdc;
+		sdc.start(0);
+		CHECK(sdc.disk_initialize(0) == 0);
+		bool ok;
+		auto rd = read_speed_(sdc, 500, 64, 8, ok);
+		CHECK(ok);
+		CHECK_EQ(sim::bad, 0u);
+		std::printf("bench: DMA (poll): read 32K %.2f MB/s\n", rd);
+	}
+
+
+	void test_cpu_()
+	{
+		reset_card_(true);
+		SDC_CPU sdc;
+		sdc.start(0);
+		CHECK(sdc.disk_initialize(0) == 0);
+		CHECK(sdc.is_high_speed());
+		bool ok;
+		auto rd = read_speed_(sdc, 100, 128, 16, ok);
+		CHECK(ok);
+		auto wr = write_speed_(sdc, 4000, 128, 16, ok);
+		CHECK(ok);
+		CHECK_EQ(sdc.get_stat().dma_trans, 0u);
+		CHECK_EQ(sim::bad, 0u);
+		std::printf("bench: CPU HS 30MHz: read 64K %.2f MB/s, write 64K %.2f MB/s\n", rd, wr);
+	}
+
+
+	void test_no_hs_()
+	{
+		reset_card_(false);
+		SDC_DMA sdc;
+		sdc.start(1);
+		CHECK(sdc.disk_initialize(0) == 0);
+		CHECK(!sdc.is_high_speed());
+		CHECK_EQ(sdc.get_bus_clock(), 15'000'000u);
+		bool ok;
+		auto rd = read_speed_(sdc, 100, 128, 4, ok);
+		CHECK(ok);
+		CHECK_EQ(sdc.get_stat().crc_error, 0u);
+		CHECK_EQ(sim::bad, 0u);
+		std::printf("bench: DMA DS 15MHz: read 64K %.2f MB/s\n", rd);
+	}
+
+
+	/// HS に切り替わったが、高速クロックで CRC エラーになるカード
+	void test_broken_hs_()
+	{
+		reset_card_(true, true);
+		SDC_DMA sdc;
+		sdc.start(1);
+		CHECK(sdc.disk_initialize(0) == 0);
+		CHECK_EQ(sdc.get_bus_clock(), 30'000'000u);
+		bool ok;
+		read_speed_(sdc, 100, 32, 2, ok);
+		CHECK(ok);
+		CHECK_EQ(sdc.get_bus_clock(), 15'000'000u);
+		CHECK_EQ(sdc.get_stat().retry, 1u);
+		CHECK_EQ(sim::bad, 0u);
+	}
+
+
+	/// 長いプログラム・ビジー：起動前はビジー・ループ、起動後はタスクに譲る
+	void test_scheduler_()
+	{
+		for(uint32_t pass = 0; pass < 2; ++pass) {
+			sch_state_ = pass == 0 ? taskSCHEDULER_NOT_STARTED : taskSCHEDULER_RUNNING;
+			delay_num_ = 0;
+			take_num_ = 0;
+			misuse_ = 0;
+			reset_card_(true);
+			sim::prog_busy = 20'000.0;  // 20ms
+			SDC_DMA sdc;
+			sdc.start(1);
+			CHECK(sdc.disk_initialize(0) == 0);
+			for(uint32_t i = 0; i < (512 * 16); ++i) wbuf_[i] = i * 3 + pass;
+			CHECK(sdc.disk_write(0, wbuf_, 300, 16) == RES_OK);
+			CHECK(sdc.disk_read(0, rbuf_, 300, 16) == RES_OK);
+			CHECK(std::memcmp(wbuf_, rbuf_, 16 * 512) == 0);
+			CHECK_EQ(misuse_, 0u);
+			CHECK_EQ(sim::bad, 0u);
+			if(pass == 0) {
+				CHECK_EQ(delay_num_, 0u);
+				CHECK_EQ(take_num_, 0u);
+			} else {
+				CHECK(delay_num_ > 0);
+				CHECK(take_num_ > 0);
+			}
+		}
+		sch_state_ = taskSCHEDULER_NOT_STARTED;
+	}
+}
+
+
+int main(int argc, char* argv[])
+{
+	wbuf_ = low_alloc_(128 * 512 + 16);
+	rbuf_ = low_alloc_(128 * 512 + 16);
+	if(!CHECK(wbuf_ != nullptr && rbuf_ != nullptr)) {
+		return test::result("sdhi_io");
+	}
+	srand(1);
+
+	test_scheduler_();
+	test_dma_();
+	test_dma_poll_();
+	test_cpu_();
+	test_no_hs_();
+	test_broken_hs_();
+
+	return test::result("sdhi_io");
+}
@@ -0,0 +1,27 @@
+#pragma once
+//=====================================================================//
+/*!	@file
+	@brief	ホスト・テスト用 FreeRTOS.h の代用 @n
+			型と定数だけ、API の実体は rtos_host.hpp（C からもインクルードできる）@n
+			※ティックは 1ms
+    @author 平松邦仁 (hira@rvf-rc45.net)
+	@copyright	Copyright (C) 2021 Kunihito Hiramatsu @n
+				Released under the MIT license @n
+				https://github.com/hirakuni45/RX/blob/master/LICENSE
+*/
+//=====================================================================//
+#include <stdint.h>
+#include <stddef.h>
+
+typedef long BaseType_t;
+typedef unsigned long UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdFALSE				((BaseType_t)0)
+#define pdTRUE				((BaseType_t)1)
+#define pdPASS				pdTRUE
+#define pdFAIL				pdFALSE
+#define portMAX_DELAY		((TickType_t)0xffffffffUL)
+#define configTICK_RATE_HZ	1000
+#define portTICK_PERIOD_MS	((TickType_t)1)
+#define pdMS_TO_TICKS(ms)	((TickType_t)(ms))
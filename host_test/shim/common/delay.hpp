@@ -0,0 +1,24 @@
+#pragma once
+//=====================================================================//
+/*!	@file
+	@brief	ホスト・テスト用 common/delay.hpp の代用 @n
+			ソフトウェア・ループによる待ちは、ホストでは何もしない
+    @author 平松邦仁 (hira@rvf-rc45.net)
+	@copyright	Copyright (C) 2021 Kunihito Hiramatsu @n
+				Released under the MIT license @n
+				https://github.com/hirakuni45/RX/blob/master/LICENSE
+*/
+//=====================================================================//
+#include <cstdint>
+
+namespace utils {
+
+	struct delay {
+
+		static void loop(uint32_t cnt) { }
+
+		static void micro_second(uint32_t us) { }
+
+		static void milli_second(uint32_t ms) { }
+	};
+}
@@ -0,0 +1,30 @@
+#pragma once
+//=====================================================================//
+/*!	@file
+	@brief	ホスト・テスト用 common/time.h の代用 @n
+			ホストの <ctime> と衝突しない様に、標準の struct tm を使う
+    @author 平松邦仁 (hira@rvf-rc45.net)
+	@copyright	Copyright (C) 2021 Kunihito Hiramatsu @n
+				Released under the MIT license @n
+				https://github.com/hirakuni45/RX/blob/master/LICENSE
+*/
+//=====================================================================//
+#include <ctime>
+#include <cstdint>
+
+extern "C" {
+	time_t mktime_gmt(const struct tm* tmp);
+}
+
+inline const char* get_wday(uint8_t idx)
+{
+	static const char* tbl[] = { "Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat" };
+	return tbl[idx % 7];
+}
+
+inline const char* get_mon(uint8_t idx)
+{
+	static const char* tbl[] = { "Jan", "Feb", "Mar", "Apr", "May", "Jun",
+		"Jul", "Aug", "Sep", "Oct", "Nov", "Dec" };
+	return tbl[idx % 12];
+}
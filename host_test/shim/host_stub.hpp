@@ -0,0 +1,34 @@
+#pragma once
+//=====================================================================//
+/*!	@file
+	@brief	ホスト・テスト用、ターゲット依存 C 関数のスタブ @n
+			common/format.hpp 等が参照する SCI 出力、時間関数をホストで定義
+			（テスト毎に１回だけインクルードする事）
+    @author 平松邦仁 (hira@rvf-rc45.net)
+	@copyright	Copyright (C) 2021 Kunihito Hiramatsu @n
+				Released under the MIT license @n
+				https://github.com/hirakuni45/RX/blob/master/LICENSE
+*/
+//=====================================================================//
+#include <cstdio>
+#include <cstdint>
+#include <ctime>
+
+extern "C" {
+
+	void sci_putch(char ch) { std::putchar(ch); }
+
+	void sci_puts(const char* str) { std::fputs(str, stdout); }
+
+	char sci_getch(void) { return 0; }
+
+	uint16_t sci_length(void) { return 0; }
+
+	uint16_t sci_get_length(void) { return 0; }
+
+	time_t mktime_gmt(const struct tm* tmp)
+	{
+		struct tm t = *tmp;
+		return timegm(&t);
+	}
+}
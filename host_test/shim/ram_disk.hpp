@@ -0,0 +1,255 @@
+#pragma once
+//=====================================================================//
+/*!	@file
+	@brief	ホスト・テスト用 RAM ディスク（FatFs の diskio） @n
+			FAT16 でフォーマットしたメモリ上のイメージを FatFs（ff14）から使う。@n
+			コマンド数、セクター数を数え、フックで遅延や電源断を模擬できる @n
+			（テスト毎に１回だけインクルードする事）@n
+			disk_xxx をテスト側で定義する場合は「RAM_DISK_NO_DISKIO」を define する
+    @author 平松邦仁 (hira@rvf-rc45.net)
+	@copyright	Copyright (C) 2021 Kunihito Hiramatsu @n
+				Released under the MIT license @n
+				https://github.com/hirakuni45/RX/blob/master/LICENSE
+*/
+//=====================================================================//
+#include <cstring>
+#include <vector>
+#include <atomic>
+#include <functional>
+#include "ff14/source/ff.h"
+#include "ff14/source/diskio.h"
+
+namespace test {
+
+	//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+	/*!
+		@brief	RAM ディスク・クラス
+	*/
+	//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+	class ram_disk {
+	public:
+		static const uint32_t SECTOR = 512;
+
+		//=============================================================//
+		/*!
+			@brief	アクセス・フック型 @n
+					write: 書き込みなら「true」、戻り値が「false」ならエラーにする
+		*/
+		//=============================================================//
+		typedef std::function<bool (bool write, uint32_t sector, uint32_t count)> HOOK;
+
+	private:
+		std::vector<uint8_t>	img_;
+		HOOK					hook_;
+
+		static void put16_(uint8_t* p, uint16_t v) { p[0] = v; p[1] = v >> 8; }
+		static void put32_(uint8_t* p, uint32_t v) { put16_(p, v); put16_(p + 2, v >> 16); }
+
+	public:
+		std::atomic<uint32_t>	read_cmd;
+		std::atomic<uint32_t>	read_sec;
+		std::atomic<uint32_t>	write_cmd;
+		std::atomic<uint32_t>	write_sec;
+
+		ram_disk() : img_(), hook_(), read_cmd(0), read_sec(0), write_cmd(0), write_sec(0) { }
+
+
+		//-------------------------------------------------------------//
+		/*!
+			@brief	FAT16 でフォーマット（パーティション無し）
+			@param[in]	sectors	セクター数
+			@param[in]	spc		クラスター当たりのセクター数（２のべき乗）
+			@return クラスター数が FAT16 の範囲外なら「false」
+		*/
+		//-------------------------------------------------------------//
+		bool format(uint32_t sectors, uint8_t spc)
+		{
+			static const uint32_t RSV = 1;
+			static const uint32_t ROOT_ENT = 512;
+			static const uint32_t ROOT_SEC = ROOT_ENT * 32 / SECTOR;
+			uint32_t fatsz = (((sectors - RSV - ROOT_SEC) / spc + 2) * 2 + SECTOR - 1) / SECTOR;
+			uint32_t ncl = (sectors - RSV - fatsz * 2 - ROOT_SEC) / spc;
+			if(ncl < 4086 || ncl > 65524) return false;
+
+			img_.assign(static_cast<size_t>(sectors) * SECTOR, 0);
+			uint8_t* bs = &img_[0];
+			bs[0] = 0xeb;
+			bs[1] = 0x3c;
+			bs[2] = 0x90;
+			std::memcpy(bs + 3, "MSWIN4.1", 8);
+			put16_(bs + 11, SECTOR);
+			bs[13] = spc;
+			put16_(bs + 14, RSV);
+			bs[16] = 2;
+			put16_(bs + 17, ROOT_ENT);
+			put16_(bs + 19, sectors < 0x10000 ? sectors : 0);
+			bs[21] = 0xf8;
+			put16_(bs + 22, fatsz);
+			put16_(bs + 24, 63);
+			put16_(bs + 26, 255);
+			put32_(bs + 32, sectors < 0x10000 ? 0 : sectors);
+			bs[36] = 0x80;
+			bs[38] = 0x29;
+			put32_(bs + 39, 0x12345678);
+			std::memcpy(bs + 43, "HOST_TEST  ", 11);
+			std::memcpy(bs + 54, "FAT16   ", 8);
+			bs[510] = 0x55;
+			bs[511] = 0xaa;
+			for(uint32_t i = 0; i < 2; ++i) {
+				uint8_t* fat = &img_[(RSV + fatsz * i) * SECTOR];
+				put16_(fat, 0xfff8);
+				put16_(fat + 2, 0xffff);
+			}
+			return true;
+		}
+
+
+		//-------------------------------------------------------------//
+		/*!
+			@brief	イメージを得る
+			@return イメージ
+		*/
+		//-------------------------------------------------------------//
+		std::vector<uint8_t>& at_image() { return img_; }
+
+
+		//-------------------------------------------------------------//
+		/*!
+			@brief	フックを設定
+			@param[in]	hook	フック
+		*/
+		//-------------------------------------------------------------//
+		void set_hook(HOOK hook) { hook_ = hook; }
+
+
+		//-------------------------------------------------------------//
+		/*!
+			@brief	カウンターをクリア
+		*/
+		//-------------------------------------------------------------//
+		void clear_count()
+		{
+			read_cmd = 0;
+			read_sec = 0;
+			write_cmd = 0;
+			write_sec = 0;
+		}
+
+
+		DRESULT read(BYTE* buff, LBA_t sector, UINT count)
+		{
+			if((static_cast<size_t>(sector) + count) * SECTOR > img_.size()) return RES_PARERR;
+			if(hook_ && !hook_(false, sector, count)) return RES_ERROR;
+			std::memcpy(buff, &img_[static_cast<size_t>(sector) * SECTOR], count * SECTOR);
+			++read_cmd;
+			read_sec += count;
+			return RES_OK;
+		}
+
+
+		DRESULT write(const BYTE* buff, LBA_t sector, UINT count)
+		{
+			if((static_cast<size_t>(sector) + count) * SECTOR > img_.size()) return RES_PARERR;
+			if(hook_ && !hook_(true, sector, count)) return RES_ERROR;
+			std::memcpy(&img_[static_cast<size_t>(sector) * SECTOR], buff, count * SECTOR);
+			++write_cmd;
+			write_sec += count;
+			return RES_OK;
+		}
+
+
+		DRESULT ioctl(BYTE cmd, void* buff)
+		{
+			switch(cmd) {
+			case CTRL_SYNC:
+				return RES_OK;
+			case GET_SECTOR_COUNT:
+				*static_cast<LBA_t*>(buff) = img_.size() / SECTOR;
+				return RES_OK;
+			case GET_SECTOR_SIZE:
+				*static_cast<WORD*>(buff) = SECTOR;
+				return RES_OK;
+			case GET_BLOCK_SIZE:
+				*static_cast<DWORD*>(buff) = 1;
+				return RES_OK;
+			default:
+				return RES_PARERR;
+			}
+		}
+	};
+
+
+	inline ram_disk& disk()
+	{
+		static ram_disk d;
+		return d;
+	}
+
+
+	//-----------------------------------------------------------------//
+	/*!
+		@brief	RAM ディスクをフォーマットしてマウント
+		@param[in]	sectors	セクター数
+		@param[in]	spc		クラスター当たりのセクター数
+		@return 成功なら「true」
+	*/
+	//-----------------------------------------------------------------//
+	inline bool mount_ram_disk(uint32_t sectors, uint8_t spc)
+	{
+		static FATFS fs;
+		if(!disk().format(sectors, spc)) return false;
+		return f_mount(&fs, "", 1) == FR_OK;
+	}
+
+
+	//-----------------------------------------------------------------//
+	/*!
+		@brief	RAM ディスクにファイルを書く
+		@param[in]	path	パス
+		@param[in]	src		データ
+		@param[in]	len		長さ
+		@return 成功なら「true」
+	*/
+	//-----------------------------------------------------------------//
+	inline bool write_file(const char* path, const void* src, uint32_t len)
+	{
+		FIL fp;
+		if(f_open(&fp, path, FA_WRITE | FA_CREATE_ALWAYS) != FR_OK) return false;
+		UINT bw = 0;
+		auto ret = f_write(&fp, src, len, &bw);
+		f_close(&fp);
+		return ret == FR_OK && bw == len;
+	}
+}
+
+#ifndef RAM_DISK_NO_DISKIO
+extern "C" {
+
+	DSTATUS disk_initialize(BYTE pdrv) { return pdrv == 0 ? 0 : STA_NOINIT; }
+
+	DSTATUS disk_status(BYTE pdrv) { return pdrv == 0 ? 0 : STA_NOINIT; }
+
+	DRESULT disk_read(BYTE pdrv, BYTE* buff, LBA_t sector, UINT count)
+	{
+		if(pdrv != 0) return RES_PARERR;
+		return test::disk().read(buff, sector, count);
+	}
+
+	DRESULT disk_write(BYTE pdrv, const BYTE* buff, LBA_t sector, UINT count)
+	{
+		if(pdrv != 0) return RES_PARERR;
+		return test::disk().write(buff, sector, count);
+	}
+
+	DRESULT disk_ioctl(BYTE pdrv, BYTE cmd, void* buff)
+	{
+		if(pdrv != 0) return RES_PARERR;
+		return test::disk().ioctl(cmd, buff);
+	}
+}
+#endif
+
+extern "C" {
+	/// 2021-01-01 00:00:00
+	DWORD get_fattime(void) { return (41UL << 25) | (1UL << 21) | (1UL << 16); }
+}
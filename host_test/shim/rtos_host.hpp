@@ -0,0 +1,132 @@
+#pragma once
+//=====================================================================//
+/*!	@file
+	@brief	ホスト・テスト用 FreeRTOS API の実体 @n
+			タスクはテスト側で std::thread として起動する @n
+			（テスト毎に１回だけインクルードする事）
+    @author 平松邦仁 (hira@rvf-rc45.net)
+	@copyright	Copyright (C) 2021 Kunihito Hiramatsu @n
+				Released under the MIT license @n
+				https://github.com/hirakuni45/RX/blob/master/LICENSE
+*/
+//=====================================================================//
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+
+extern "C" {
+
+	void vTaskDelay(TickType_t ticks)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(ticks));
+	}
+
+
+	TickType_t xTaskGetTickCount(void)
+	{
+		static const auto org = std::chrono::steady_clock::now();
+		return std::chrono::duration_cast<std::chrono::milliseconds>(
+			std::chrono::steady_clock::now() - org).count();
+	}
+
+
+	/// クリティカル・セクションは全タスク共通の再帰ミューテックス
+	inline std::recursive_mutex& rtos_critical_()
+	{
+		static std::recursive_mutex m;
+		return m;
+	}
+
+
+	void vTaskEnterCritical(void) { rtos_critical_().lock(); }
+
+
+	void vTaskExitCritical(void) { rtos_critical_().unlock(); }
+
+
+	void vPortYield(void) { std::this_thread::yield(); }
+
+
+	SemaphoreHandle_t xSemaphoreCreateMutex(void)
+	{
+		return new std::timed_mutex;
+	}
+
+
+	BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t wait)
+	{
+		auto m = static_cast<std::timed_mutex*>(sem);
+		if(wait == portMAX_DELAY) {
+			m->lock();
+			return pdTRUE;
+		}
+		return m->try_lock_for(std::chrono::milliseconds(wait)) ? pdTRUE : pdFALSE;
+	}
+
+
+	BaseType_t xSemaphoreGive(SemaphoreHandle_t sem)
+	{
+		static_cast<std::timed_mutex*>(sem)->unlock();
+		return pdTRUE;
+	}
+
+
+	void vSemaphoreDelete(SemaphoreHandle_t sem)
+	{
+		delete static_cast<std::timed_mutex*>(sem);
+	}
+
+
+	/// タスクの通知（スレッド毎）
+	struct rtos_notify_t {
+		std::mutex				m;
+		std::condition_variable	cv;
+		uint32_t				value = 0;
+	};
+
+
+	BaseType_t xTaskGetSchedulerState(void) { return taskSCHEDULER_RUNNING; }
+
+
+	TaskHandle_t xTaskGetCurrentTaskHandle(void)
+	{
+		static thread_local rtos_notify_t n;
+		return &n;
+	}
+
+
+	BaseType_t xTaskNotifyGive(TaskHandle_t task)
+	{
+		auto n = static_cast<rtos_notify_t*>(task);
+		{
+			std::lock_guard<std::mutex> lock(n->m);
+			++n->value;
+		}
+		n->cv.notify_one();
+		return pdPASS;
+	}
+
+
+	void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t* woken)
+	{
+		xTaskNotifyGive(task);
+		if(woken != nullptr) *woken = pdTRUE;
+	}
+
+
+	uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t wait)
+	{
+		auto n = static_cast<rtos_notify_t*>(xTaskGetCurrentTaskHandle());
+		std::unique_lock<std::mutex> lock(n->m);
+		auto f = [n] { return n->value != 0; };
+		if(wait == portMAX_DELAY) n->cv.wait(lock, f);
+		else n->cv.wait_for(lock, std::chrono::milliseconds(wait), f);
+		auto v = n->value;
+		if(v != 0) n->value = clear ? 0 : (v - 1);
+		return v;
+	}
+}
@@ -0,0 +1,26 @@
+#pragma once
+//=====================================================================//
+/*!	@file
+	@brief	ホスト・テスト用 semphr.h の代用（ミューテックスのみ）
+    @author 平松邦仁 (hira@rvf-rc45.net)
+	@copyright	Copyright (C) 2021 Kunihito Hiramatsu @n
+				Released under the MIT license @n
+				https://github.com/hirakuni45/RX/blob/master/LICENSE
+*/
+//=====================================================================//
+#include "FreeRTOS.h"
+#include "task.h"
+
+typedef void* SemaphoreHandle_t;
+typedef SemaphoreHandle_t xSemaphoreHandle;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+	SemaphoreHandle_t xSemaphoreCreateMutex(void);
+	BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t wait);
+	BaseType_t xSemaphoreGive(SemaphoreHandle_t sem);
+	void vSemaphoreDelete(SemaphoreHandle_t sem);
+#ifdef __cplusplus
+}
+#endif
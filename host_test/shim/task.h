@@ -0,0 +1,39 @@
+#pragma once
+//=====================================================================//
+/*!	@file
+	@brief	ホスト・テスト用 task.h の代用
+    @author 平松邦仁 (hira@rvf-rc45.net)
+	@copyright	Copyright (C) 2021 Kunihito Hiramatsu @n
+				Released under the MIT license @n
+				https://github.com/hirakuni45/RX/blob/master/LICENSE
+*/
+//=====================================================================//
+#include "FreeRTOS.h"
+
+typedef void* TaskHandle_t;
+
+#define taskSCHEDULER_SUSPENDED		((BaseType_t)0)
+#define taskSCHEDULER_NOT_STARTED	((BaseType_t)1)
+#define taskSCHEDULER_RUNNING		((BaseType_t)2)
+
+#define portYIELD_FROM_ISR(woken)	(void)(woken)
+#define taskENTER_CRITICAL()		vTaskEnterCritical()
+#define taskEXIT_CRITICAL()			vTaskExitCritical()
+#define taskYIELD()					vPortYield()
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+	void vTaskDelay(TickType_t ticks);
+	TickType_t xTaskGetTickCount(void);
+	void vTaskEnterCritical(void);
+	void vTaskExitCritical(void);
+	void vPortYield(void);
+	BaseType_t xTaskGetSchedulerState(void);
+	TaskHandle_t xTaskGetCurrentTaskHandle(void);
+	BaseType_t xTaskNotifyGive(TaskHandle_t task);
+	void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t* woken);
+	uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t wait);
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,286 @@
+//=====================================================================//
+/*!	@file
+	@brief	SIDE_sample、i8080 とインベーダー・マシンのテスト @n
+			テスト用の ROM（フレーム割り込みでビデオ RAM に書く）を、@n
+			I8080<モックのマシン> と InvadersMachine で N フレーム動かし、@n
+			フレーム毎の変化したライン・グループ（fetchDirty）をビデオ RAM の差分と、@n
+			フレーム毎のサイクル数、run() と step() の一致を確かめる。@n
+			エミュレーションのフレーム／秒を「bench:」行で表示する
+    @author 平松邦仁 (hira@rvf-rc45.net)
+	@copyright	Copyright (C) 2021 Kunihito Hiramatsu @n
+				Released under the MIT license @n
+				https://github.com/hirakuni45/RX/blob/master/LICENSE
+*/
+//=====================================================================//
+#include <cstring>
+#include "test.hpp"
+
+// サンプルのソースは、この翻訳単位に含める（モックのマシンでも CPU を実体化する為）
+#include "side/i8080.cpp"
+#include "side/arcade.cpp"
+
+namespace {
+
+	// インベーダー・マシンと同じメモリー配置（ROM 8K、ワーク RAM 1K、ビデオ RAM 7K）で、@n
+	// アクセス回数を数えるモック
+	class mock_machine {
+		friend class I8080<mock_machine>;
+
+		unsigned char	mem_[0x4000];
+		uint32_t	read_;
+		uint32_t	write_;
+		uint32_t	rom_write_;
+		uint32_t	port_;
+
+	protected:
+		unsigned char readByte(unsigned addr) {
+			++read_;
+			return addr < sizeof(mem_) ? mem_[addr] : 0xFF;
+		}
+		unsigned readWord(unsigned addr) {
+			return readByte(addr) | (static_cast<unsigned>(readByte(addr + 1)) << 8);
+		}
+		void writeByte(unsigned addr, unsigned char b) {
+			++write_;
+			if(addr < 0x2000 || addr >= 0x4000) {
+				++rom_write_;
+				return;
+			}
+			mem_[addr] = b;
+		}
+		void writeWord(unsigned addr, unsigned value) {
+			writeByte(addr, value & 0xFF);
+			writeByte(addr + 1, (value >> 8) & 0xFF);
+		}
+		unsigned char readPort(unsigned port) { ++port_; return 0; }
+		void writePort(unsigned port, unsigned char value) { ++port_; }
+
+	public:
+		I8080<mock_machine>	cpu_;
+
+		mock_machine() : mem_{ }, read_(0), write_(0), rom_write_(0), port_(0), cpu_(*this) { }
+
+		void set_rom(const unsigned char* rom, uint32_t len) { std::memcpy(mem_, rom, len); }
+		const unsigned char* get_mem() const { return mem_; }
+		uint32_t get_write() const { return write_; }
+		uint32_t get_rom_write() const { return rom_write_; }
+	};
+}
+
+template class I8080<mock_machine>;
+
+namespace {
+
+	// InvadersMachine::step() と同じ、６０フレーム／秒
+	static const unsigned CYCLES_PER_INTERRUPT = 2000000 / (2 * 60);
+	// 一番長い命令（XTHL、CALL 等）
+	static const unsigned MAX_OPCODE_CYCLES = 18;
+
+	// テスト用 ROM
+	//   0000: JMP 0040h
+	//   0008: EI / RET                       ; RST 1（フレームの途中）
+	//   0010: JMP 0080h                      ; RST 2（フレームの最後）
+	//   0040: LXI SP,2400h / EI
+	//   0044: LHLD 2002h / INX H / SHLD 2002h / JMP 0044h
+	//   0080: n = ++[2000h]、g = n & 31
+	//         [2400h + g] = n                ; x = 0 の行グループ g は毎フレーム変わる
+	//         [3000h + g] = 0                ; 同じ値（変化しない）
+	//         n % 4 == 0 なら [3F00h + (g ^ 16)] = n
+	//         [0044h] = A                    ; ROM への書き込み（無視される事）
+	static const unsigned char rom_[] = {
+		/* 0000 */ 0xC3, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+		/* 0008 */ 0xFB, 0xC9, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+		/* 0010 */ 0xC3, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+		/* 0018 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+		/* 0020 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+		/* 0028 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+		/* 0030 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+		/* 0038 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+		/* 0040 */ 0x31, 0x00, 0x24,	// LXI  SP,2400h
+		/* 0043 */ 0xFB,				// EI
+		/* 0044 */ 0x2A, 0x02, 0x20,	// LHLD 2002h
+		/* 0047 */ 0x23,				// INX  H
+		/* 0048 */ 0x22, 0x02, 0x20,	// SHLD 2002h
+		/* 004B */ 0xC3, 0x44, 0x00,	// JMP  0044h
+		/* 004E */ 0x00, 0x00,
+		/* 0050 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+		/* 0058 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+		/* 0060 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+		/* 0068 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+		/* 0070 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+		/* 0078 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+		/* 0080 */ 0xF5,				// PUSH PSW
+		/* 0081 */ 0xE5,				// PUSH H
+		/* 0082 */ 0xC5,				// PUSH B
+		/* 0083 */ 0x3A, 0x00, 0x20,	// LDA  2000h
+		/* 0086 */ 0x3C,				// INR  A
+		/* 0087 */ 0x32, 0x00, 0x20,	// STA  2000h
+		/* 008A */ 0x47,				// MOV  B,A
+		/* 008B */ 0xE6, 0x1F,			// ANI  1Fh
+		/* 008D */ 0x6F,				// MOV  L,A
+		/* 008E */ 0x26, 0x24,			// MVI  H,24h
+		/* 0090 */ 0x70,				// MOV  M,B
+		/* 0091 */ 0x26, 0x30,			// MVI  H,30h
+		/* 0093 */ 0x36, 0x00,			// MVI  M,0
+		/* 0095 */ 0x78,				// MOV  A,B
+		/* 0096 */ 0xE6, 0x03,			// ANI  03h
+		/* 0098 */ 0xC2, 0xA3, 0x00,	// JNZ  00A3h
+		/* 009B */ 0x7D,				// MOV  A,L
+		/* 009C */ 0xEE, 0x10,			// XRI  10h
+		/* 009E */ 0x6F,				// MOV  L,A
+		/* 009F */ 0x26, 0x3F,			// MVI  H,3Fh
+		/* 00A1 */ 0x70,				// MOV  M,B
+		/* 00A2 */ 0xAF,				// XRA  A
+		/* 00A3 */ 0x32, 0x44, 0x00,	// STA  0044h
+		/* 00A6 */ 0xC1,				// POP  B
+		/* 00A7 */ 0xE1,				// POP  H
+		/* 00A8 */ 0xF1,				// POP  PSW
+		/* 00A9 */ 0xFB,				// EI
+		/* 00AA */ 0xC9,				// RET
+	};
+
+	char rom_image_[0x2000];
+
+	// InvadersMachine::step() と同じ手順（run() か、step() の繰り返し）
+	template <class CPU>
+	void frame_(CPU& cpu, bool use_run, unsigned& min_cycles, unsigned& max_cycles)
+	{
+		for(int i = 0; i < 2; ++i) {
+			if(use_run) {
+				cpu.run(CYCLES_PER_INTERRUPT);
+			} else {
+				while(cpu.getCycles() < CYCLES_PER_INTERRUPT) cpu.step();
+			}
+			auto c = cpu.getCycles();
+			if(c < min_cycles) min_cycles = c;
+			if(c > max_cycles) max_cycles = c;
+			cpu.setCycles(c - CYCLES_PER_INTERRUPT);
+			cpu.interrupt(i ? 0x10 : 0x08);
+		}
+	}
+
+	bool same_cpu_(const I8080<mock_machine>& a, const I8080<mock_machine>& b)
+	{
+		return a.AF() == b.AF() && a.BC() == b.BC() && a.DE() == b.DE() && a.HL() == b.HL()
+			&& a.PC == b.PC && a.SP == b.SP && a.getCycles() == b.getCycles();
+	}
+
+
+	void test_frames_()
+	{
+		std::memcpy(rom_image_, rom_, sizeof(rom_));
+
+		mock_machine mock;
+		mock.set_rom(rom_, sizeof(rom_));
+		mock_machine mock_step;
+		mock_step.set_rom(rom_, sizeof(rom_));
+
+		static InvadersMachine im;
+		im.setROM(rom_image_);
+		im.reset();
+		// リセット後は全てのグループ
+		CHECK_EQ(im.fetchDirty(), 0xFFFFFFFFu);
+		CHECK_EQ(im.fetchDirty(), 0u);
+
+		const unsigned char* vram = im.getVideoRAM();
+		const unsigned char* im_ram = vram - 0x2400;
+
+		// メイン・ループの周回数（16 ビット）が溢れない様に 60 フレーム
+		static const uint32_t FRAMES = 60;
+		uint32_t dirty_err = 0;
+		uint32_t diff_err = 0;
+		uint32_t step_err = 0;
+		uint32_t vram_err = 0;
+		unsigned min_c = ~0u;
+		unsigned max_c = 0;
+		unsigned min_s = ~0u;
+		unsigned max_s = 0;
+		unsigned char prev[0x1C00];
+		std::memcpy(prev, mock.get_mem() + 0x2400, sizeof(prev));
+		for(uint32_t n = 1; n <= FRAMES; ++n) {
+			frame_(mock.cpu_, true, min_c, max_c);
+			frame_(mock_step.cpu_, false, min_s, max_s);
+			im.step();
+
+			// ビデオ RAM の差分から求めたライン・グループ
+			uint32_t diff = 0;
+			const auto* vr = mock.get_mem() + 0x2400;
+			for(uint32_t i = 0; i < sizeof(prev); ++i) {
+				if(vr[i] != prev[i]) diff |= 1u << (i & 31);
+			}
+			std::memcpy(prev, vr, sizeof(prev));
+
+			// フレームの最後の割り込み（RST 2）の処理は、次のフレームで行われる
+			uint32_t m = n - 1;
+			uint32_t g = m & 31;
+			uint32_t expect = m != 0 ? (1u << g) : 0;
+			if(m != 0 && (m & 3) == 0) expect |= 1u << (g ^ 16);
+
+			auto d = im.fetchDirty();
+			if(d != expect) ++dirty_err;
+			if(diff != expect) ++diff_err;
+			if(!same_cpu_(mock.cpu_, mock_step.cpu_)) ++step_err;
+			if(std::memcmp(vr, vram, sizeof(prev)) != 0) ++vram_err;
+		}
+		CHECK_EQ(dirty_err, 0u);
+		CHECK_EQ(diff_err, 0u);
+		CHECK_EQ(step_err, 0u);
+		CHECK_EQ(vram_err, 0u);
+		CHECK(std::memcmp(mock.get_mem(), mock_step.get_mem(), 0x4000) == 0);
+
+		// フレーム・カウンター、ROM は変わらない
+		CHECK_EQ(mock.get_mem()[0x2000], (FRAMES - 1) & 0xFF);
+		CHECK_EQ(im_ram[0x2000], (FRAMES - 1) & 0xFF);
+		CHECK(std::memcmp(im_ram, rom_, sizeof(rom_)) == 0);
+		CHECK(std::memcmp(mock.get_mem(), rom_, sizeof(rom_)) == 0);
+		CHECK_EQ(mock.get_rom_write(), FRAMES - 1);
+		// メイン・ループは止まらない（１周 47 サイクル）
+		uint32_t loops = mock.get_mem()[0x2002] | (mock.get_mem()[0x2003] << 8);
+		CHECK(loops > 0);
+		CHECK_EQ(static_cast<uint32_t>(im_ram[0x2002] | (im_ram[0x2003] << 8)), loops);
+
+		// 割り込み毎のサイクル数は、CYCLES_PER_INTERRUPT から命令１つ分を超えない
+		CHECK(min_c >= CYCLES_PER_INTERRUPT);
+		CHECK(max_c < CYCLES_PER_INTERRUPT + MAX_OPCODE_CYCLES);
+		CHECK_EQ(min_c, min_s);
+		CHECK_EQ(max_c, max_s);
+		uint32_t total = FRAMES * 2 * CYCLES_PER_INTERRUPT + mock.cpu_.getCycles();
+		std::printf("frames: %u, %u cycles (%.1f per frame, per interrupt %u to %u), main loop %u\n",
+			FRAMES, total, static_cast<double>(total) / FRAMES, min_c, max_c, loops);
+		// 割り込み処理以外はメイン・ループ（47 サイクル）なので、周回数から概算出来る
+		CHECK(loops * 47 < total);
+		CHECK(loops * 47 > total * 9 / 10);
+
+		// 同じ値の書き込みは、変化とならない
+		CHECK_EQ(vram[0x3000 - 0x2400 + 5], 0);
+	}
+
+
+	void bench_()
+	{
+		static InvadersMachine im;
+		im.setROM(rom_image_);
+		im.reset();
+		static const uint32_t FRAMES = 6000;
+		test::stopwatch sw;
+		uint32_t dirty = 0;
+		for(uint32_t i = 0; i < FRAMES; ++i) {
+			im.step();
+			dirty |= im.fetchDirty();
+		}
+		auto sec = sw.sec();
+		CHECK(dirty != 0);
+		std::printf("bench: InvadersMachine %.0f frames/s (%.1f MHz 8080, %.1fx realtime)\n",
+			FRAMES / sec, FRAMES * 2.0 * CYCLES_PER_INTERRUPT / sec * 1e-6, FRAMES / sec / 60.0);
+	}
+}
+
+
+int main(int argc, char* argv[])
+{
+	test_frames_();
+
+	bench_();
+
+	return test::result("side");
+}
@@ -0,0 +1,68 @@
+#pragma once
+//=====================================================================//
+/*!	@file
+	@brief	ホスト・テスト用 common/file_io.hpp の代用 @n
+			stdio でファイルを読み、seek/read の回数を数える
+    @author 平松邦仁 (hira@rvf-rc45.net)
+	@copyright	Copyright (C) 2021 Kunihito Hiramatsu @n
+				Released under the MIT license @n
+				https://github.com/hirakuni45/RX/blob/master/LICENSE
+*/
+//=====================================================================//
+#include <cstdio>
+#include <cstdint>
+
+namespace utils {
+
+	class file_io {
+		FILE*	fp_;
+
+	public:
+		static inline uint32_t seek_count = 0;
+		static inline uint32_t read_count = 0;
+
+		enum class SEEK {
+			SET,
+			CUR,
+			END
+		};
+
+		file_io() noexcept : fp_(nullptr) { }
+
+		~file_io() { close(); }
+
+		bool open(const char* fname, const char* mode) noexcept
+		{
+			close();
+			fp_ = std::fopen(fname, mode);
+			return fp_ != nullptr;
+		}
+
+		bool close() noexcept
+		{
+			if(fp_ == nullptr) return false;
+			std::fclose(fp_);
+			fp_ = nullptr;
+			return true;
+		}
+
+		uint32_t read(void* dst, uint32_t len) noexcept
+		{
+			++read_count;
+			if(fp_ == nullptr) return 0;
+			return std::fread(dst, 1, len, fp_);
+		}
+
+		bool seek(SEEK s, uint32_t ofs) noexcept
+		{
+			++seek_count;
+			if(fp_ == nullptr) return false;
+			int w = SEEK_SET;
+			if(s == SEEK::CUR) w = SEEK_CUR;
+			else if(s == SEEK::END) w = SEEK_END;
+			return std::fseek(fp_, ofs, w) == 0;
+		}
+
+		uint32_t tell() const noexcept { return fp_ != nullptr ? std::ftell(fp_) : 0; }
+	};
+}
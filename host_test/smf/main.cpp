@@ -0,0 +1,270 @@
+//=====================================================================//
+/*!	@file
+	@brief	smf_stream、SMF 再生タイミング・テスト @n
+			合成したフォーマット１の SMF（16 トラック、テンポ変更、ランニング・ステータス）@n
+			を MEMORY/STREAM モードで再生し、イベントの順序、内容、テンポ・マップの @n
+			変換誤差、揺らぎのあるモック・クロックでの遅れ、ファイル・シーク回数を検査する。@n
+			ロード（パース）の速度を計測する
+    @author 平松邦仁 (hira@rvf-rc45.net)
+	@copyright	Copyright (C) 2021 Kunihito Hiramatsu @n
+				Released under the MIT license @n
+				https://github.com/hirakuni45/RX/blob/master/LICENSE
+*/
+//=====================================================================//
+#include <vector>
+#include <algorithm>
+#include <random>
+#include <cmath>
+#include "test.hpp"
+#include "sound/smf_stream.hpp"
+
+namespace {
+
+	static const char* FNAME = "smf_test.mid";
+	static const uint32_t TRACKS = 16;
+	static const uint32_t DIVISION = 480;
+
+	typedef sound::smf_stream<TRACKS, 128> SMF;
+
+	struct ref_t {
+		double					time_;	///< [us]
+		uint32_t				track_;
+		std::vector<uint8_t>	msg_;
+	};
+	std::vector<ref_t>	ref_;
+
+	struct tempo_t {
+		uint32_t	tick_;
+		uint32_t	us_;
+	};
+	static const tempo_t tempo_map_[] = {
+		{ 0, 500000 }, { 9600, 400000 }, { 19200, 650000 }, { 33600, 300000 }
+	};
+
+
+	double tick_to_us_(uint32_t tick)
+	{
+		double us = 0.0;
+		uint32_t last = 0;
+		uint32_t tempo = 500000;
+		for(const auto& t : tempo_map_) {
+			if(t.tick_ > tick) break;
+			us += static_cast<double>(t.tick_ - last) * tempo / DIVISION;
+			last = t.tick_;
+			tempo = t.us_;
+		}
+		return us + static_cast<double>(tick - last) * tempo / DIVISION;
+	}
+
+
+	void put_var_(std::vector<uint8_t>& v, uint32_t x)
+	{
+		uint8_t t[5];
+		uint32_t n = 0;
+		t[n++] = x & 0x7f;
+		while(x >>= 7) t[n++] = (x & 0x7f) | 0x80;
+		while(n > 0) v.push_back(t[--n]);
+	}
+
+
+	void put32_(std::vector<uint8_t>& v, uint32_t x)
+	{
+		v.insert(v.end(), {
+			static_cast<uint8_t>(x >> 24), static_cast<uint8_t>(x >> 16),
+			static_cast<uint8_t>(x >> 8), static_cast<uint8_t>(x) });
+	}
+
+
+	/// SMF を合成してファイルに書き、時間順の参照イベント列を作る
+	uint32_t make_smf_()
+	{
+		std::mt19937 rng(7);
+		std::vector<uint8_t> f = { 'M', 'T', 'h', 'd', 0, 0, 0, 6, 0, 1, 0, TRACKS,
+			DIVISION >> 8, DIVISION & 0xff };
+		for(uint32_t tr = 0; tr < TRACKS; ++tr) {
+			std::vector<uint8_t> d;
+			if(tr == 0) {
+				uint32_t last = 0;
+				for(const auto& t : tempo_map_) {
+					put_var_(d, t.tick_ - last);
+					last = t.tick_;
+					d.insert(d.end(), { 0xff, 0x51, 3, static_cast<uint8_t>(t.us_ >> 16),
+						static_cast<uint8_t>(t.us_ >> 8), static_cast<uint8_t>(t.us_) });
+				}
+			} else {
+				uint8_t run = 0;
+				uint32_t tick = 0;
+				for(uint32_t e = 0; e < 1200; ++e) {
+					uint32_t dt = (rng() % 4) == 0 ? 0 : (rng() % 4) * 60;
+					tick += dt;
+					put_var_(d, dt);
+					uint8_t st = ((rng() % 3) == 0 ? 0xb0 : ((e & 1) ? 0x80 : 0x90)) | (tr - 1);
+					if((rng() % 10) == 0) st = 0xc0 | (tr - 1);
+					uint8_t a = rng() & 0x7f;
+					uint8_t b = rng() & 0x7f;
+					bool two = (st & 0xe0) != 0xc0;
+					if(st != run) d.push_back(st);
+					run = st;
+					d.push_back(a);
+					if(two) d.push_back(b);
+					ref_t r;
+					r.time_ = tick_to_us_(tick);
+					r.track_ = tr;
+					r.msg_ = { st, a };
+					if(two) r.msg_.push_back(b);
+					ref_.push_back(r);
+				}
+			}
+			put_var_(d, 0);
+			d.insert(d.end(), { 0xff, 0x2f, 0 });
+			f.insert(f.end(), { 'M', 'T', 'r', 'k' });
+			put32_(f, d.size());
+			f.insert(f.end(), d.begin(), d.end());
+		}
+		std::stable_sort(ref_.begin(), ref_.end(), [](const ref_t& a, const ref_t& b) {
+			auto ta = std::llround(a.time_);
+			auto tb = std::llround(b.time_);
+			return ta < tb || (ta == tb && a.track_ < b.track_);
+		});
+		auto fp = std::fopen(FNAME, "wb");
+		if(fp == nullptr) return 0;
+		std::fwrite(f.data(), 1, f.size(), fp);
+		std::fclose(fp);
+		return f.size();
+	}
+
+
+	struct got_t {
+		uint32_t				time_;
+		std::vector<uint8_t>	msg_;
+	};
+
+
+	/// 1.0 ～ 1.2ms 周期で揺らぐモック・クロックで再生
+	void test_jitter_(uint8_t* buf, uint32_t size, SMF::MODE mode, const char* name)
+	{
+		SMF smf(buf, size);
+		std::vector<got_t> got;
+		uint32_t now = 0;
+		smf.set_midi_task([&](const uint8_t* msg, uint32_t len) {
+			got.push_back({ now, std::vector<uint8_t>(msg, msg + len) });
+		});
+		CHECK(smf.load(FNAME));
+		CHECK(smf.get_mode() == mode);
+		CHECK_EQ(smf.get_track_num(), TRACKS);
+		auto seek = utils::file_io::seek_count;
+
+		static const uint32_t ORG = 0xfff00000;	// 途中で時刻がラップする
+		std::mt19937 rng(3);
+		now = ORG;
+		smf.service(now);
+		while(!smf.is_eof()) {
+			now += 1000 + (rng() % 200);
+			smf.service(now);
+		}
+		seek = utils::file_io::seek_count - seek;
+
+		CHECK_EQ(got.size(), ref_.size());
+		uint32_t err = 0;
+		uint32_t early = 0;
+		double late_max = 0.0;
+		double late_sum = 0.0;
+		for(uint32_t i = 0; i < std::min(got.size(), ref_.size()); ++i) {
+			if(got[i].msg_ != ref_[i].msg_) ++err;
+			double late = static_cast<double>(got[i].time_ - ORG) - ref_[i].time_;
+			if(late < -0.5) ++early;
+			late_max = std::max(late_max, late);
+			late_sum += late;
+		}
+		std::printf("%s: play seeks %u, lateness max %.0f us avg %.0f us\n",
+			name, seek, late_max, late_sum / ref_.size());
+		CHECK_EQ(err, 0u);
+		CHECK_EQ(early, 0u);
+		// 遅れはサービス周期を超えない（テンポ変換の丸めで +1us まで）
+		CHECK(late_max <= 1200.0);
+		if(mode == SMF::MODE::MEMORY) {
+			CHECK_EQ(seek, 0u);
+		} else {
+			CHECK(seek < (ref_.size() / 16));
+		}
+	}
+
+
+	/// イベント時刻に正確にサービスした時の、テンポ・マップ変換誤差と再スタート
+	void test_tempo_map_(uint8_t* buf, uint32_t size)
+	{
+		SMF smf(buf, size);
+		std::vector<uint32_t> tt;
+		uint32_t now = 0;
+		smf.set_midi_task([&](const uint8_t*, uint32_t) { tt.push_back(now); });
+		CHECK(smf.load(FNAME));
+		for(uint32_t loop = 0; loop < 2; ++loop) {
+			tt.clear();
+			now = 0;
+			smf.service(now);
+			while(!smf.is_eof()) {
+				now = smf.get_next_time();
+				smf.service(now);
+			}
+			CHECK_EQ(tt.size(), ref_.size());
+			double err = 0.0;
+			for(uint32_t i = 0; i < std::min(tt.size(), ref_.size()); ++i) {
+				err = std::max(err, std::fabs(tt[i] - ref_[i].time_));
+			}
+			CHECK(err < 1.0);
+			smf.restart();
+		}
+		std::printf("tempo map: %zu events over %.1f s\n", ref_.size(), ref_.back().time_ / 1e6);
+	}
+
+
+	/// 一時停止中は通知せず、再開後は停止時間だけずれる
+	void test_pause_(uint8_t* buf, uint32_t size)
+	{
+		SMF smf(buf, size);
+		uint32_t n = 0;
+		smf.set_midi_task([&](const uint8_t*, uint32_t) { ++n; });
+		CHECK(smf.load(FNAME));
+		smf.service(0);
+		auto t = smf.get_next_time();
+		smf.pause(true, 10);
+		CHECK_EQ(smf.service(t + 1000000), 0u);
+		smf.pause(false, 500000);
+		CHECK_EQ(smf.service(t + 500000 - 10 - 1), 0u);
+		CHECK(smf.service(t + 500000 - 10) > 0);
+	}
+
+
+	void bench_(uint8_t* buf, uint32_t size, uint32_t fsize)
+	{
+		SMF smf(buf, size);
+		static const uint32_t N = 200;
+		test::stopwatch sw;
+		for(uint32_t i = 0; i < N; ++i) {
+			smf.load(FNAME);
+		}
+		auto t = sw.sec();
+		std::printf("bench: load %u bytes, %u events -> %u bytes: %.3f ms, %.1f M events/s\n",
+			fsize, smf.get_event_num(), smf.get_buffer_length(), t * 1e3 / N,
+			static_cast<double>(smf.get_event_num()) * N / t / 1e6);
+	}
+}
+
+
+int main(int argc, char* argv[])
+{
+	auto fsize = make_smf_();
+	CHECK(fsize > 0);
+
+	static uint8_t buf[256 * 1024];
+	test_jitter_(buf, sizeof(buf), SMF::MODE::MEMORY, "MEMORY");
+	test_jitter_(buf, 1000, SMF::MODE::STREAM, "STREAM");
+	test_jitter_(nullptr, 0, SMF::MODE::STREAM, "STREAM (no buffer)");
+	test_tempo_map_(buf, sizeof(buf));
+	test_tempo_map_(nullptr, 0);
+	test_pause_(buf, sizeof(buf));
+
+	bench_(buf, sizeof(buf), fsize);
+
+	return test::result("smf");
+}
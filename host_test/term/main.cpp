@@ -0,0 +1,411 @@
+//=====================================================================//
+/*!	@file
+	@brief	term、VT100/ANSI ターミナル・リプレイ・テスト @n
+			シェル・セッション（ls --color、git log --stat、スクロール領域を使う @n
+			全画面アプリ、grep --color、日本語）を合成し、115200bps 相当 @n
+			（１フレーム 192 バイト）で流して毎フレーム描画する。@n
+			差分描画の結果を全描画と比べ（最後、途中のフレーム、スクロールバック）、@n
+			描画したセル数、ブロック転送の回数を「bench:」行で表示する
+    @author 平松邦仁 (hira@rvf-rc45.net)
+	@copyright	Copyright (C) 2021 Kunihito Hiramatsu @n
+				Released under the MIT license @n
+				https://github.com/hirakuni45/RX/blob/master/LICENSE
+*/
+//=====================================================================//
+#include <string>
+#include <vector>
+#include <random>
+#include <cstdarg>
+#include "test.hpp"
+#include "host_stub.hpp"
+#include "graphics/term.hpp"
+
+namespace graphics {
+	const share_color def_color::White(255, 255, 255);
+}
+
+bool insert_widget(gui::widget* w) { return true; }
+void remove_widget(gui::widget* w) { }
+
+namespace {
+
+	static const int SX = 60;
+	static const int SY = 17;
+
+	typedef gui::term<SX, SY, 32768> TERM;
+
+	/// セル単位の指紋を書き込むピクセル・フレームバッファ
+	struct mock_rdr {
+		struct afont {
+			static const int16_t width = 8;
+			static const int16_t height = 16;
+		};
+		struct font_type {
+			typedef afont a_type;
+			static const int16_t height = 16;
+		};
+		static const int W = SX * 8;
+		static const int H = SY * 16;
+
+		std::vector<uint64_t>	fb_;
+		uint16_t	fore_ = 0;
+		uint16_t	back_ = 0;
+		uint64_t	pix_ = 0;	///< 書き込んだピクセル数
+
+		mock_rdr() : fb_(W * H, 0) { }
+
+		void set_fore_color(const graphics::share_color& c) { fore_ = c.rgb565; }
+		void set_back_color(const graphics::share_color& c) { back_ = c.rgb565; }
+
+		void box_(int x, int y, int w, int h, uint64_t v) {
+			for(int j = y; j < (y + h); ++j) {
+				for(int i = x; i < (x + w); ++i) {
+					if(i >= 0 && i < W && j >= 0 && j < H) {
+						fb_[j * W + i] = v;
+						++pix_;
+					}
+				}
+			}
+		}
+
+		void fill_box(const vtx::srect& r) {
+			box_(r.org.x, r.org.y, r.size.x, r.size.y, static_cast<uint64_t>(' ') | (static_cast<uint64_t>(fore_) << 32));
+		}
+
+		void draw_font_utf16(const vtx::spos& p, uint16_t code, bool back) {
+			int w = code >= 0x80 ? 16 : 8;
+			box_(p.x, p.y, w, 16, static_cast<uint64_t>(code) | (static_cast<uint64_t>(fore_) << 16)
+				| (static_cast<uint64_t>(back_) << 32));
+		}
+
+		void line_h(int16_t y, int16_t x, int16_t w) {
+			box_(x, y, w, 1, (0xabcdULL << 48) | fore_);
+		}
+
+		void move(const vtx::srect& src, const vtx::spos& dst) {
+			for(int y = 0; y < src.size.y; ++y) {
+				auto d = &fb_[dst.x + (dst.y + y) * W];
+				const auto* s = &fb_[src.org.x + (src.org.y + y) * W];
+				for(int x = 0; x < src.size.x; ++x) {
+					*d++ = *s++;
+					++pix_;
+				}
+			}
+		}
+
+		/// 行のテキスト（全角は「#」）
+		std::string row_text(int y) const {
+			std::string s;
+			for(int x = 0; x < SX; ++x) {
+				auto v = fb_[(y * 16) * W + x * 8];
+				uint16_t c = v & 0xffff;
+				if(c >= 0x80) {
+					s += '#';
+					++x;
+				} else {
+					s += static_cast<char>(c);
+				}
+			}
+			return s;
+		}
+	};
+
+
+	//----- セッションの合成 -----//
+
+	std::mt19937	rng_(12345);
+
+	std::string fmt_(const char* form, ...) __attribute__ ((format (printf, 1, 2)));
+	std::string fmt_(const char* form, ...)
+	{
+		char tmp[512];
+		va_list ap;
+		va_start(ap, form);
+		vsnprintf(tmp, sizeof(tmp), form, ap);
+		va_end(ap);
+		return tmp;
+	}
+
+
+	std::string word_(uint32_t min, uint32_t max)
+	{
+		static const char* sy[] = { "ka", "ne", "ri", "to", "su", "mo", "ra", "shi", "n", "ko", "de", "-", "_", "x" };
+		std::string s;
+		uint32_t n = min + rng_() % (max - min + 1);
+		while(s.size() < n) s += sy[rng_() % (sizeof(sy) / sizeof(sy[0]))];
+		return s;
+	}
+
+
+	/// ls -l --color
+	void ls_(std::string& out, uint32_t num)
+	{
+		out += fmt_("total %u\r\n", num * 37);
+		for(uint32_t i = 0; i < num; ++i) {
+			auto r = rng_() % 10;
+			auto name = word_(3, 24);
+			out += fmt_("%s  1 root root %10u Mar %2u  2023 ", r < 2 ? "drwxr-xr-x" : (r < 4 ? "lrwxrwxrwx" : "-rwxr-xr-x"),
+				static_cast<uint32_t>(rng_() % 1000000), 1 + i % 28);
+			if(r < 2) {
+				out += "\033[01;34m" + name + "\033[0m\r\n";
+			} else if(r < 4) {
+				out += "\033[01;36m" + name + "\033[0m -> ../lib/" + word_(4, 30) + "\r\n";
+			} else {
+				out += "\033[01;32m" + name + "\033[0m\r\n";
+			}
+		}
+	}
+
+
+	/// git log --stat
+	void git_log_(std::string& out, uint32_t num)
+	{
+		for(uint32_t i = 0; i < num; ++i) {
+			std::string hash;
+			for(int j = 0; j < 40; ++j) hash += "0123456789abcdef"[rng_() % 16];
+			out += "\033[33mcommit " + hash + "\033[m\r\n";
+			out += "Author: 平松邦仁 <hira@rvf-rc45.net>\r\n";
+			out += fmt_("Date:   Mon Oct %u 12:%02u:00 2021 +0900\r\n\r\n", 1 + i % 30, i % 60);
+			out += "    " + word_(10, 50) + "\r\n\r\n";
+			uint32_t files = 1 + rng_() % 5;
+			for(uint32_t j = 0; j < files; ++j) {
+				uint32_t add = rng_() % 30;
+				uint32_t del = rng_() % 20;
+				out += fmt_(" %-36s | %3u ", (word_(3, 12) + "/" + word_(3, 16) + ".hpp").c_str(), add + del);
+				out += "\033[32m" + std::string(add / 2, '+') + "\033[m\033[31m" + std::string(del / 2, '-') + "\033[m\r\n";
+			}
+			out += fmt_(" %u files changed, %u insertions(+), %u deletions(-)\r\n\r\n", files,
+				static_cast<uint32_t>(rng_() % 200), static_cast<uint32_t>(rng_() % 100));
+		}
+	}
+
+
+	/// スクロール領域を使う全画面アプリ（ステータス行を固定してログを流す、行の挿入、削除）
+	void region_(std::string& out, bool clear)
+	{
+		out += "\033[2J\033[H\033[7m status: tail -f log  \033[0m\n";
+		out += "\033[2;16r\033[2;1H";
+		for(uint32_t i = 1; i <= 300; ++i) {
+			out += fmt_("\033[32m%05u\033[0m log line %u \033[1;33mWARN\033[0m 日本語の行\r\n", i, i * 7);
+		}
+		out += "\033[17;1H\033[44m\033[K -- 100% --\033[0m";
+		out += "\033[r\033[17;1H\n";
+		for(uint32_t i = 1; i <= 40; ++i) {
+			out += fmt_("\033[3;1H\033[L inserted %u\033[10;1H\033[M", i);
+		}
+		if(clear) out += "\033[2J\033[H";
+	}
+
+
+	/// grep --color（画面幅を超える行、日本語を含む）
+	void grep_(std::string& out, uint32_t num)
+	{
+		for(uint32_t i = 0; i < num; ++i) {
+			out += "\033[35m\033[K" + word_(4, 12) + ".cpp\033[m\033[K\033[36m\033[K:\033[m\033[K";
+			out += fmt_("\033[32m\033[K%u\033[m\033[K\033[36m\033[K:\033[m\033[K", 1 + static_cast<uint32_t>(rng_() % 2000));
+			out += "\t" + word_(0, 40) + "\033[01;31m\033[Kmatch\033[m\033[K" + word_(0, 60);
+			if((i % 7) == 0) out += " // 全角の文字列、折り返し";
+			out += "\r\n";
+		}
+	}
+
+
+	std::string session_()
+	{
+		std::string s;
+		for(uint32_t i = 0; i < 2; ++i) {
+			s += "$ ls -l --color /usr/bin\r\n";
+			ls_(s, 600);
+			s += "$ git log --stat\r\n";
+			git_log_(s, 150);
+			s += "$ ./region.sh\r\n";
+			region_(s, true);
+			s += "$ grep --color -rn match .\r\n";
+			grep_(s, 400);
+		}
+		return s;
+	}
+
+
+	void test_replay_(const std::string& src)
+	{
+		std::printf("session: %u bytes\n", static_cast<uint32_t>(src.size()));
+
+		// パーサーのみの速度
+		{
+			static TERM t;
+			test::stopwatch sw;
+			for(int i = 0; i < 20; ++i) t.write(src.data(), src.size());
+			std::printf("bench: parse only %.1f Mchars/s (host)\n", src.size() * 20 / sw.sec() / 1e6);
+		}
+
+		// 115200bps 相当（１フレーム 192 バイト）で流して、毎フレーム描画
+		static const uint32_t CHUNK = 192;
+		static TERM term;
+		static mock_rdr rdr;
+		uint32_t frames = 0;
+		test::stopwatch sw;
+		for(uint32_t i = 0; i < src.size(); i += CHUNK) {
+			uint32_t n = std::min<uint32_t>(CHUNK, src.size() - i);
+			term.write(&src[i], n);
+			term.draw(rdr);
+			++frames;
+		}
+		auto sec = sw.sec();
+		const auto& st = term.get_stat();
+		uint64_t full = static_cast<uint64_t>(frames) * SX * SY;
+		std::printf("bench: %u frames, %u lines scrolled, %u moves, %.1f Mchars/s parse+draw (host)\n",
+			frames, st.lines, st.moves, src.size() / sec / 1e6);
+		std::printf("bench: cells drawn %u, repaint every frame %u (%.1f%%)\n",
+			st.cells, static_cast<uint32_t>(full), 100.0 * st.cells / full);
+		CHECK(st.cells < (full / 5));
+		CHECK(st.moves > 0 && st.moves < st.lines);
+		CHECK(term.get_scrollback() > 0);
+
+		// 差分描画の結果が、全描画と一致するか
+		{
+			static TERM ref;
+			static mock_rdr rr;
+			ref.write(src.data(), src.size());
+			ref.draw(rr);
+			CHECK(rr.fb_ == rdr.fb_);
+			uint32_t bad = 0;
+			for(int y = 0; y < SY; ++y) {
+				if(rr.row_text(y) != rdr.row_text(y)) {
+					if(bad++ < 3) {
+						std::fprintf(stderr, "row %d\n '%s'\n '%s'\n", y, rr.row_text(y).c_str(), rdr.row_text(y).c_str());
+					}
+				}
+			}
+			CHECK_EQ(bad, 0u);
+		}
+
+		// 途中のフレームでも一致するか（スクロール領域、挿入削除を含む）
+		{
+			static TERM a, b;
+			static mock_rdr ra, rb;
+			uint32_t mism = 0;
+			uint32_t num = 0;
+			for(uint32_t i = 0; i < src.size(); i += 97) {
+				uint32_t n = std::min<uint32_t>(97, src.size() - i);
+				a.write(&src[i], n);
+				b.write(&src[i], n);
+				a.draw(ra);
+				if(((i / 97) % 53) == 0) {
+					b.redraw();
+					b.draw(rb);
+					if(ra.fb_ != rb.fb_) ++mism;
+					++num;
+				}
+			}
+			CHECK(num > 50);
+			CHECK_EQ(mism, 0u);
+		}
+
+		// スクロールバック表示
+		{
+			auto row0 = rdr.row_text(0);
+			auto m0 = term.get_stat().moves;
+			term.set_view(5);
+			term.draw(rdr);
+			CHECK(rdr.row_text(5) == row0);
+			CHECK_EQ(term.get_stat().moves, m0 + 1);
+			term.set_view(6);
+			term.draw(rdr);
+			CHECK(rdr.row_text(6) == row0);
+			static mock_rdr r2;
+			term.redraw();
+			term.draw(r2);
+			CHECK(r2.fb_ == rdr.fb_);
+			term.set_view(100000);
+			CHECK_EQ(term.get_view(), term.get_scrollback());
+			term.draw(rdr);
+			term.putch('x');  // 出力で最新に戻る
+			CHECK_EQ(term.get_view(), 0u);
+			term.draw(rdr);
+			static mock_rdr r3;
+			term.redraw();
+			term.draw(r3);
+			CHECK(r3.fb_ == rdr.fb_);
+		}
+	}
+
+
+	/// スクロール領域、行の挿入、削除の結果
+	void test_region_()
+	{
+		static TERM t;
+		static mock_rdr r;
+		std::string s;
+		region_(s, false);
+		// ログを流している間、ステータス行は動かない
+		auto half = s.find("\033[17;1H");
+		for(uint32_t i = 0; i < s.size(); i += 192) {
+			auto n = std::min<uint32_t>(192, s.size() - i);
+			if(i < half && (i + n) >= half) {
+				t.write(&s[i], half - i);
+				t.draw(r);
+				CHECK(r.row_text(0).find(" status: tail -f log") == 0);
+				CHECK(r.row_text(14).find("00300 log line 2100") == 0);
+				t.write(&s[half], n - (half - i));
+			} else {
+				t.write(&s[i], n);
+			}
+			t.draw(r);
+		}
+		// 領域を解除して最終行で改行したので、全体が１行上にずれている
+		CHECK(r.row_text(0).find("00287 log line 2009 WARN ##") == 0);
+		CHECK(r.row_text(1).find("00288 log line 2016 WARN ##") == 0);
+		// 行 3 への挿入と、行 10 の削除の間
+		for(int y = 2; y < 9; ++y) {
+			CHECK(r.row_text(y).find(fmt_(" inserted %d ", 42 - y)) == 0);
+		}
+		CHECK(r.row_text(9).find("00296 log line 2072") == 0);
+		CHECK(r.row_text(13).find("00300 log line 2100") == 0);
+		CHECK(r.row_text(14) == std::string(SX, ' '));
+		CHECK(r.row_text(15).find(" -- 100% --") == 0);
+		CHECK_EQ(t.get_cell(SX - 1, 15).color, (TERM::DEF_FG << 4) | 4);  // 青の背景で行末まで消去
+		CHECK(r.row_text(16) == std::string(SX, ' '));
+		CHECK(t.get_scrollback() > 0);
+	}
+
+
+	/// 個別のシーケンス
+	void test_seq_()
+	{
+		static TERM t;
+		t.puts("\033[2J\033[H\033[31;1mR\033[0m\033[5;10Habc\033[2Ddef\033[1;1H\033[K");
+		CHECK(t.get_cell(9, 4).code == 'a' && t.get_cell(10, 4).code == 'd' && t.get_cell(12, 4).code == 'f');
+		CHECK(t.get_cell(0, 0).code == ' ');
+		t.puts("\033[3;1H\xe6\x97\xa5\xe6\x9c\xac");  // 日本
+		CHECK(t.get_cell(0, 2).code == 0x65e5 && (t.get_cell(1, 2).attr & TERM::ATTR::WIDE) != 0);
+		CHECK(t.get_cell(2, 2).code == 0x672c);
+		t.puts("\033[3;2HA");  // 全角の右半分を上書き
+		CHECK(t.get_cell(0, 2).code == ' ' && t.get_cell(1, 2).code == 'A');
+		t.puts("\033[1;1H\033[4;41mU\033[m");
+		CHECK(t.get_cell(0, 0).color == ((7 << 4) | 1) && t.get_cell(0, 0).attr == TERM::ATTR::UNDERLINE);
+		t.puts("\033[1;1H\033[@");
+		CHECK(t.get_cell(1, 0).code == 'U' && t.get_cell(0, 0).code == ' ');
+		t.puts("\033[P");
+		CHECK(t.get_cell(0, 0).code == 'U');
+		// 自動改行（右端で保留）
+		t.puts("\033[10;1H");
+		for(int i = 0; i < SX; ++i) t.putch('0' + i % 10);
+		CHECK(t.get_cursor().y == 9 && t.get_cursor().x == SX - 1);
+		t.putch('Z');
+		CHECK(t.get_cursor().y == 10 && t.get_cell(0, 10).code == 'Z');
+		// カーソル保存、復帰
+		t.puts("\0337\033[1;1H\0338");
+		CHECK(t.get_cursor().y == 10 && t.get_cursor().x == 1);
+	}
+}
+
+
+int main(int argc, char* argv[])
+{
+	test_seq_();
+	test_region_();
+	test_replay_(session_());
+
+	return test::result("term");
+}
@@ -0,0 +1,63 @@
+#pragma once
+//=====================================================================//
+/*!	@file
+	@brief	ホスト・テスト用ヘルパー @n
+			CHECK で失敗を数え、main の戻り値を test::result() とする
+    @author 平松邦仁 (hira@rvf-rc45.net)
+	@copyright	Copyright (C) 2021 Kunihito Hiramatsu @n
+				Released under the MIT license @n
+				https://github.com/hirakuni45/RX/blob/master/LICENSE
+*/
+//=====================================================================//
+#include <cstdio>
+#include <cstdint>
+#include <chrono>
+
+namespace test {
+
+	inline uint32_t& fail_count() { static uint32_t n = 0; return n; }
+	inline uint32_t& check_count() { static uint32_t n = 0; return n; }
+
+	inline bool check(bool ok, const char* expr, const char* file, int line)
+	{
+		++check_count();
+		if(!ok) {
+			++fail_count();
+			std::fprintf(stderr, "%s:%d: CHECK failed: %s\n", file, line, expr);
+		}
+		return ok;
+	}
+
+
+	//-----------------------------------------------------------------//
+	/*!
+		@brief  結果の表示
+		@param[in]	name	テスト名
+		@return 全て成功なら「0」（main の戻り値）
+	*/
+	//-----------------------------------------------------------------//
+	inline int result(const char* name)
+	{
+		std::printf("%s: %u checks, %u failed\n", name, check_count(), fail_count());
+		return fail_count() == 0 ? 0 : 1;
+	}
+
+
+	//-----------------------------------------------------------------//
+	/*!
+		@brief  経過時間計測（ベンチマーク用）
+	*/
+	//-----------------------------------------------------------------//
+	class stopwatch {
+		std::chrono::steady_clock::time_point	org_;
+	public:
+		stopwatch() : org_(std::chrono::steady_clock::now()) { }
+
+		double sec() const {
+			return std::chrono::duration<double>(std::chrono::steady_clock::now() - org_).count();
+		}
+	};
+}
+
+#define CHECK(expr) test::check(static_cast<bool>(expr), #expr, __FILE__, __LINE__)
+#define CHECK_EQ(a, b) test::check((a) == (b), #a " == " #b, __FILE__, __LINE__)
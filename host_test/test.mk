@@ -0,0 +1,87 @@
+# -*- tab-width : 4 -*-
+#=======================================================================
+#   @file
+#   @brief  ホスト・テスト共通ルール @n
+#			各テストの Makefile で TARGET, PSOURCES 等を定義してインクルード @n
+#			CSOURCES（C ソース、FatFs 等）はファイル名だけでオブジェクトを作る
+#   @author 平松邦仁 (hira@rvf-rc45.net)
+#	@copyright	Copyright (C) 2021 Kunihito Hiramatsu @n
+#				Released under the MIT license @n
+#				https://github.com/hirakuni45/RX/blob/master/LICENSE
+#=======================================================================
+# 'debug' or 'release'
+BUILD		?=	release
+
+# テスト固有のシム（PINC_APP）が先、共通シム、リポジトリの順で探す
+PINC_APP	+=	. .. ../shim ../..
+
+INC_P	=	$(addprefix -I, $(PINC_APP))
+LIBN	=	$(addprefix -l, $(STDLIBS))
+
+CC	=	gcc
+CP	?=	g++
+LK	?=	g++
+
+COPT	=	-O2 -std=gnu99
+POPT	=	-O2 -std=gnu++17
+
+PFLAGS	+=	-DHAVE_STDINT_H
+
+ifeq ($(BUILD),debug)
+	COPT += -g -fsanitize=address,undefined
+	POPT += -g -fsanitize=address,undefined
+	LOPT += -fsanitize=address,undefined
+	PFLAGS += -DDEBUG
+endif
+
+ifeq ($(BUILD),release)
+	PFLAGS += -DNDEBUG
+endif
+
+CPWARN	=	-Wall -Werror \
+			-Wno-unused-function
+
+CCWARN	=	-Wall -Werror
+
+OBJECTS	=	$(addprefix $(BUILD)/,$(patsubst %.cpp,%.o,$(PSOURCES))) \
+			$(addprefix $(BUILD)/,$(patsubst %.c,%.o,$(notdir $(CSOURCES))))
+DEPENDS =   $(patsubst %.o,%.d, $(OBJECTS))
+
+vpath %.c $(sort $(dir $(CSOURCES)))
+
+.PHONY: all run clean
+.SUFFIXES :
+.SUFFIXES : .hpp .h .c .cpp .o
+
+all: $(TARGET)
+
+run: $(TARGET)
+	./$(TARGET) $(RUN_ARGS)
+
+$(TARGET): $(OBJECTS) Makefile
+	$(LK) $(LOPT) $(OBJECTS) $(LIBN) -o $(TARGET)
+
+$(BUILD)/%.o : %.cpp
+	mkdir -p $(dir $@); \
+	$(CP) -c $(POPT) $(PFLAGS) $(INC_P) $(CPWARN) -o $@ $<
+
+$(BUILD)/%.o : %.c
+	mkdir -p $(dir $@); \
+	$(CC) -c $(COPT) $(PFLAGS) $(INC_P) $(CCWARN) -o $@ $<
+
+$(BUILD)/%.d : %.cpp
+	mkdir -p $(dir $@); \
+	$(CP) -MM -DDEPEND_ESCAPE $(POPT) $(PFLAGS) $(INC_P) $< \
+	| sed 's/$(notdir $*)\.o:/$(subst /,\/,$(patsubst %.d,%.o,$@) $@):/' > $@ ; \
+	[ -s $@ ] || rm -f $@
+
+$(BUILD)/%.d : %.c
+	mkdir -p $(dir $@); \
+	$(CC) -MM -DDEPEND_ESCAPE $(COPT) $(PFLAGS) $(INC_P) $< \
+	| sed 's/$(notdir $*)\.o:/$(subst /,\/,$(patsubst %.d,%.o,$@) $@):/' > $@ ; \
+	[ -s $@ ] || rm -f $@
+
+clean:
+	rm -rf release debug $(TARGET) $(CLEAN_FILES)
+
+-include $(DEPENDS)
@@ -0,0 +1,393 @@
+//=====================================================================//
+/*!	@file
+	@brief	tgl、記録するモックのバックエンドでのテスト @n
+			DrawElements、DrawArrays、Begin/End が同じ頂点列をバックエンドに渡す事、@n
+			変換済み頂点キャッシュのヒット数と変換数（キャッシュの衝突、頂点配列の切り替え）、@n
+			SphereVisible による視錐台の検査を確かめる。@n
+			DrawElements と DrawArrays の三角形／秒を「bench:」行で表示する
+    @author 平松邦仁 (hira@rvf-rc45.net)
+	@copyright	Copyright (C) 2021 Kunihito Hiramatsu @n
+				Released under the MIT license @n
+				https://github.com/hirakuni45/RX/blob/master/LICENSE
+*/
+//=====================================================================//
+#include <cmath>
+#include <vector>
+#include "test.hpp"
+#include "host_stub.hpp"
+#include "graphics/tgl.hpp"
+
+namespace {
+
+	struct mock_render { };
+
+	// バックエンドに渡されたプリミティブを記録する
+	class record {
+	public:
+		typedef graphics::tgl_base::cvtx_t cvtx_t;
+		typedef graphics::tgl_base::FORMAT FORMAT;
+
+		struct prim_t {
+			uint32_t	n;
+			cvtx_t		v[4];
+		};
+
+	private:
+		std::vector<prim_t>	prims_;
+		uint32_t	begin_;
+
+		void add_(uint32_t n, const cvtx_t* a, const cvtx_t* b, const cvtx_t* c, const cvtx_t* d)
+		{
+			prim_t t;
+			t.n = n;
+			t.v[0] = *a;
+			if(b != nullptr) t.v[1] = *b;
+			if(c != nullptr) t.v[2] = *c;
+			if(d != nullptr) t.v[3] = *d;
+			prims_.push_back(t);
+		}
+
+	public:
+		record(mock_render& rdr) : prims_(), begin_(0) { }
+
+		void line_width(float w) { }
+		void begin(int ox, int oy, int w, int h, uint32_t flags) { ++begin_; }
+		void set_texture(const void* image, const vtx::spos& size, FORMAT form) { }
+		void point(const cvtx_t& a) { add_(1, &a, nullptr, nullptr, nullptr); }
+		void line(const cvtx_t& a, const cvtx_t& b) { add_(2, &a, &b, nullptr, nullptr); }
+		void triangle(const cvtx_t& a, const cvtx_t& b, const cvtx_t& c) { add_(3, &a, &b, &c, nullptr); }
+		void quad(const cvtx_t& a, const cvtx_t& b, const cvtx_t& c, const cvtx_t& d) { add_(4, &a, &b, &c, &d); }
+
+		void clear() { prims_.clear(); }
+		const std::vector<prim_t>& get() const { return prims_; }
+	};
+
+	typedef graphics::tgl<mock_render, 1000, 100, 4, record> TGL;
+
+	mock_render	render_;
+	TGL			tgl_(render_);
+
+	void setup_(float ax, float ay)
+	{
+		auto& m = tgl_.at_matrix();
+		m.set_viewport(0, 0, 480, 272);
+		m.set_mode(gl::matrixf::mode::projection);
+		m.identity();
+		m.perspective(45.0f, 480.0f / 272.0f, 1.0f, 50.0f);
+		m.set_mode(gl::matrixf::mode::modelview);
+		m.identity();
+		m.translate(0.0f, 0.0f, -10.0f);
+		m.rotate(ax, 1.0f, 0.0f, 0.0f);
+		m.rotate(ay, 0.0f, 1.0f, 0.0f);
+	}
+
+
+	bool same_(const record::cvtx_t& a, const record::cvtx_t& b)
+	{
+		static const float e = 1e-5f;
+		return std::fabs(a.x - b.x) <= e && std::fabs(a.y - b.y) <= e && std::fabs(a.z - b.z) <= e
+			&& std::fabs(a.w - b.w) <= e && a.r == b.r && a.g == b.g && a.b == b.b && a.s == b.s && a.t == b.t;
+	}
+
+	bool same_(const std::vector<record::prim_t>& a, const std::vector<record::prim_t>& b)
+	{
+		if(a.size() != b.size()) return false;
+		for(uint32_t i = 0; i < a.size(); ++i) {
+			if(a[i].n != b[i].n) return false;
+			for(uint32_t j = 0; j < a[i].n; ++j) {
+				if(!same_(a[i].v[j], b[i].v[j])) return false;
+			}
+		}
+		return true;
+	}
+
+
+	// 格子状のメッシュ（頂点は共有）
+	struct mesh_t {
+		std::vector<vtx::fvtx>	v;
+		std::vector<graphics::share_color>	c;
+		std::vector<vtx::fpos>	t;
+		std::vector<uint16_t>	idx;
+		// インデックスを展開した配列
+		std::vector<vtx::fvtx>	ev;
+		std::vector<graphics::share_color>	ec;
+		std::vector<vtx::fpos>	et;
+
+		mesh_t(uint32_t w, uint32_t h)
+		{
+			for(uint32_t y = 0; y <= h; ++y) {
+				for(uint32_t x = 0; x <= w; ++x) {
+					float fx = static_cast<float>(x) / w * 4.0f - 2.0f;
+					float fy = static_cast<float>(y) / h * 4.0f - 2.0f;
+					v.emplace_back(fx, fy, std::sin(fx) * std::cos(fy));
+					c.emplace_back(x * 255 / w, y * 255 / h, (x ^ y) & 255);
+					t.emplace_back(static_cast<float>(x) / w, static_cast<float>(y) / h);
+				}
+			}
+			for(uint32_t y = 0; y < h; ++y) {
+				for(uint32_t x = 0; x < w; ++x) {
+					uint16_t i = y * (w + 1) + x;
+					uint16_t q[6] = { i, static_cast<uint16_t>(i + 1), static_cast<uint16_t>(i + w + 1),
+						static_cast<uint16_t>(i + 1), static_cast<uint16_t>(i + w + 2), static_cast<uint16_t>(i + w + 1) };
+					idx.insert(idx.end(), q, q + 6);
+				}
+			}
+			for(auto i : idx) {
+				ev.push_back(v[i]);
+				ec.push_back(c[i]);
+				et.push_back(t[i]);
+			}
+		}
+	};
+
+
+	void draw_elements_(const mesh_t& m, TGL::PTYPE pt, uint32_t num, const uint16_t* idx)
+	{
+		tgl_.VertexPointer(m.v.data());
+		tgl_.ColorPointer(m.c.data());
+		tgl_.TexCoordPointer(m.t.data());
+		tgl_.DrawElements(pt, num, idx);
+	}
+
+	void draw_arrays_(const mesh_t& m, TGL::PTYPE pt, uint32_t first, uint32_t num)
+	{
+		tgl_.VertexPointer(m.ev.data());
+		tgl_.ColorPointer(m.ec.data());
+		tgl_.TexCoordPointer(m.et.data());
+		tgl_.DrawArrays(pt, first, num);
+	}
+
+	void draw_begin_(const mesh_t& m, TGL::PTYPE pt, uint32_t num, const uint16_t* idx)
+	{
+		tgl_.Begin(pt);
+		for(uint32_t i = 0; i < num; ++i) {
+			auto j = idx[i];
+			tgl_.Color(m.c[j]);
+			tgl_.TexCoord(m.t[j].x, m.t[j].y);
+			tgl_.Vertex(m.v[j]);
+		}
+		tgl_.End();
+	}
+
+
+	// DrawElements、DrawArrays、Begin/End が同じ頂点列を渡す
+	void test_equivalence_()
+	{
+		auto& rec = tgl_.at_backend();
+		static const TGL::PTYPE pts[] = {
+			TGL::PTYPE::TRIANGLE, TGL::PTYPE::TRIANGLE_STRIP, TGL::PTYPE::TRIANGLE_FAN,
+			TGL::PTYPE::QUAD, TGL::PTYPE::LINES, TGL::PTYPE::LINE_STRIP,
+			TGL::PTYPE::LINE_LOOP, TGL::PTYPE::POINTS
+		};
+		// 13x11 の格子、インデックスは 64 を超えるのでキャッシュは衝突する
+		mesh_t m(12, 10);
+		uint32_t num = 600;  // Begin/End の頂点数（VNUM）以内
+		for(auto pt : pts) {
+			setup_(30.0f, 20.0f);
+			rec.clear();
+			draw_elements_(m, pt, num, m.idx.data());
+			tgl_.renderring();
+			auto a = rec.get();
+
+			rec.clear();
+			draw_arrays_(m, pt, 0, num);
+			tgl_.renderring();
+			auto b = rec.get();
+
+			rec.clear();
+			draw_begin_(m, pt, num, m.idx.data());
+			tgl_.renderring();
+			auto c = rec.get();
+
+			CHECK(!a.empty());
+			CHECK(same_(a, b));
+			CHECK(same_(a, c));
+		}
+
+		// DrawArrays の first
+		setup_(0.0f, 45.0f);
+		rec.clear();
+		draw_elements_(m, TGL::PTYPE::TRIANGLE, 30, m.idx.data() + 90);
+		tgl_.renderring();
+		auto a = rec.get();
+		rec.clear();
+		draw_arrays_(m, TGL::PTYPE::TRIANGLE, 90, 30);
+		tgl_.renderring();
+		CHECK_EQ(a.size(), 10u);
+		CHECK(same_(a, rec.get()));
+
+		// 同じフレームで頂点配列を切り替えても、前の配列の変換済み頂点を使わない
+		mesh_t m2(12, 10);
+		for(auto& v : m2.v) v.z += 1.0f;
+		for(auto& c : m2.c) c = graphics::share_color(1, 2, 3);
+		setup_(10.0f, 10.0f);
+		rec.clear();
+		draw_elements_(m, TGL::PTYPE::TRIANGLE, 60, m.idx.data());
+		draw_elements_(m2, TGL::PTYPE::TRIANGLE, 60, m2.idx.data());
+		tgl_.renderring();
+		auto ab = rec.get();
+		rec.clear();
+		draw_begin_(m, TGL::PTYPE::TRIANGLE, 60, m.idx.data());
+		draw_begin_(m2, TGL::PTYPE::TRIANGLE, 60, m2.idx.data());
+		tgl_.renderring();
+		CHECK_EQ(ab.size(), 40u);
+		CHECK(same_(ab, rec.get()));
+	}
+
+
+	// 変換済み頂点キャッシュ
+	void test_cache_()
+	{
+		// 立方体（８頂点、１２三角形）
+		static const vtx::fvtx cube[8] = {
+			{ -1, -1, -1 }, {  1, -1, -1 }, {  1,  1, -1 }, { -1,  1, -1 },
+			{ -1, -1,  1 }, {  1, -1,  1 }, {  1,  1,  1 }, { -1,  1,  1 },
+		};
+		static const uint16_t idx[36] = {
+			0, 2, 1, 0, 3, 2,  4, 5, 6, 4, 6, 7,  0, 1, 5, 0, 5, 4,
+			3, 7, 6, 3, 6, 2,  0, 4, 7, 0, 7, 3,  1, 2, 6, 1, 6, 5,
+		};
+		setup_(30.0f, 30.0f);
+		tgl_.reset_count();
+		tgl_.at_backend().clear();
+		tgl_.ColorPointer(nullptr);
+		tgl_.TexCoordPointer(nullptr);
+		tgl_.VertexPointer(cube);
+		tgl_.DrawElements(TGL::PTYPE::TRIANGLE, 36, idx);
+		tgl_.renderring();
+		CHECK_EQ(tgl_.get_transform_count(), 8u);
+		CHECK_EQ(tgl_.get_cache_hit_count(), 28u);
+		CHECK_EQ(tgl_.at_backend().get().size(), 12u);
+
+		// ２回描けば、それぞれでキャッシュを無効にする
+		tgl_.reset_count();
+		tgl_.at_backend().clear();
+		tgl_.DrawElements(TGL::PTYPE::TRIANGLE, 36, idx);
+		tgl_.DrawElements(TGL::PTYPE::TRIANGLE, 36, idx);
+		tgl_.renderring();
+		CHECK_EQ(tgl_.get_transform_count(), 16u);
+		CHECK_EQ(tgl_.get_cache_hit_count(), 56u);
+
+		// 格子：各頂点は最大６回参照、横に並ぶ頂点は近いインデックスなのでほぼヒットする
+		mesh_t m(12, 10);
+		tgl_.reset_count();
+		tgl_.at_backend().clear();
+		draw_elements_(m, TGL::PTYPE::TRIANGLE, m.idx.size(), m.idx.data());
+		tgl_.renderring();
+		auto xf = tgl_.get_transform_count();
+		auto hit = tgl_.get_cache_hit_count();
+		CHECK_EQ(xf + hit, m.idx.size());
+		CHECK(xf >= m.v.size());
+		CHECK(xf <= m.v.size() * 2);
+		std::printf("cache: mesh %u vertices, %u indices: %u transforms, %u hits\n",
+			static_cast<uint32_t>(m.v.size()), static_cast<uint32_t>(m.idx.size()), xf, hit);
+
+		// DrawArrays はインデックスが重ならないので全て変換
+		tgl_.reset_count();
+		draw_arrays_(m, TGL::PTYPE::TRIANGLE, 0, m.idx.size());
+		tgl_.renderring();
+		CHECK_EQ(tgl_.get_transform_count(), m.idx.size());
+		CHECK_EQ(tgl_.get_cache_hit_count(), 0u);
+
+		// Begin/End はまとめて変換
+		tgl_.reset_count();
+		draw_begin_(m, TGL::PTYPE::TRIANGLE, 300, m.idx.data());
+		tgl_.renderring();
+		CHECK_EQ(tgl_.get_transform_count(), 300u);
+		CHECK_EQ(tgl_.get_cache_hit_count(), 0u);
+	}
+
+
+	// 境界球による視錐台の検査（perspective(45, 480/272, 1, 50)、Z は -10）
+	void test_sphere_()
+	{
+		setup_(0.0f, 0.0f);
+		tgl_.reset_count();
+		// Z = -10 での縦の半分は tan(22.5) * 10 = 4.14、横は 7.31
+		CHECK(tgl_.SphereVisible(vtx::fvtx(0.0f, 0.0f, 0.0f), 1.0f));
+		CHECK(tgl_.SphereVisible(vtx::fvtx(0.0f, 4.8f, 0.0f), 1.0f));
+		CHECK(!tgl_.SphereVisible(vtx::fvtx(0.0f, 5.4f, 0.0f), 1.0f));
+		CHECK(tgl_.SphereVisible(vtx::fvtx(0.0f, -4.8f, 0.0f), 1.0f));
+		CHECK(!tgl_.SphereVisible(vtx::fvtx(0.0f, -5.4f, 0.0f), 1.0f));
+		CHECK(tgl_.SphereVisible(vtx::fvtx(8.0f, 0.0f, 0.0f), 1.0f));
+		CHECK(!tgl_.SphereVisible(vtx::fvtx(8.6f, 0.0f, 0.0f), 1.0f));
+		CHECK(!tgl_.SphereVisible(vtx::fvtx(-8.6f, 0.0f, 0.0f), 1.0f));
+		// 近い面（Z = -1）、遠い面（Z = -50）
+		CHECK(!tgl_.SphereVisible(vtx::fvtx(0.0f, 0.0f, 9.5f), 0.4f));
+		CHECK(tgl_.SphereVisible(vtx::fvtx(0.0f, 0.0f, 9.5f), 0.6f));
+		CHECK(!tgl_.SphereVisible(vtx::fvtx(0.0f, 0.0f, 15.0f), 1.0f));
+		CHECK(!tgl_.SphereVisible(vtx::fvtx(0.0f, 0.0f, -41.0f), 0.9f));
+		CHECK(tgl_.SphereVisible(vtx::fvtx(0.0f, 0.0f, -41.0f), 1.1f));
+		CHECK_EQ(tgl_.get_cull_count(), 7u);
+
+		// モデル行列も含めて検査する（Y 軸で 90 度回すと +X は -Z になる）
+		setup_(0.0f, 90.0f);
+		tgl_.reset_count();
+		CHECK(!tgl_.SphereVisible(vtx::fvtx(45.0f, 0.0f, 0.0f), 1.0f));
+		CHECK(tgl_.SphereVisible(vtx::fvtx(35.0f, 0.0f, 0.0f), 1.0f));
+		CHECK(!tgl_.SphereVisible(vtx::fvtx(-35.0f, 0.0f, 0.0f), 1.0f));
+		CHECK(!tgl_.SphereVisible(vtx::fvtx(0.0f, 0.0f, 30.0f), 1.0f));
+		CHECK_EQ(tgl_.get_cull_count(), 3u);
+
+		// 検査した球の中だけの頂点は、クリップ座標で視錐台の中
+		setup_(0.0f, 0.0f);
+		static const vtx::fvtx p[3] = { { 0.0f, 4.0f, 0.0f }, { 7.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 8.0f } };
+		tgl_.at_backend().clear();
+		tgl_.VertexPointer(p);
+		tgl_.ColorPointer(nullptr);
+		tgl_.TexCoordPointer(nullptr);
+		tgl_.DrawArrays(TGL::PTYPE::POINTS, 0, 3);
+		tgl_.renderring();
+		const auto& r = tgl_.at_backend().get();
+		CHECK_EQ(r.size(), 3u);
+		for(const auto& t : r) {
+			const auto& v = t.v[0];
+			CHECK(std::fabs(v.x) <= v.w && std::fabs(v.y) <= v.w && std::fabs(v.z) <= v.w);
+		}
+	}
+
+
+	void bench_()
+	{
+		mesh_t m(40, 40);
+		static const uint32_t LOOP = 400;
+		auto& rec = tgl_.at_backend();
+
+		tgl_.reset_count();
+		test::stopwatch sw;
+		for(uint32_t i = 0; i < LOOP; ++i) {
+			setup_(i * 0.5f, i * 0.7f);
+			rec.clear();
+			draw_elements_(m, TGL::PTYPE::TRIANGLE, m.idx.size(), m.idx.data());
+			tgl_.renderring();
+		}
+		auto se = sw.sec();
+		auto xe = tgl_.get_transform_count();
+
+		tgl_.reset_count();
+		sw = test::stopwatch();
+		for(uint32_t i = 0; i < LOOP; ++i) {
+			setup_(i * 0.5f, i * 0.7f);
+			rec.clear();
+			draw_arrays_(m, TGL::PTYPE::TRIANGLE, 0, m.idx.size());
+			tgl_.renderring();
+		}
+		auto sa = sw.sec();
+		auto xa = tgl_.get_transform_count();
+		double tri = static_cast<double>(m.idx.size() / 3) * LOOP;
+		std::printf("bench: mesh %u triangles: DrawElements %.0f triangles/s (%u transforms), DrawArrays %.0f triangles/s (%u transforms)\n",
+			static_cast<uint32_t>(m.idx.size() / 3), tri / se, xe / LOOP, tri / sa, xa / LOOP);
+	}
+}
+
+
+int main(int argc, char* argv[])
+{
+	test_equivalence_();
+	test_cache_();
+	test_sphere_();
+
+	bench_();
+
+	return test::result("tgl");
+}
@@ -0,0 +1,307 @@
+//=====================================================================//
+/*!	@file
+	@brief	tgl_soft、モックのレンダラーでのテスト @n
+			スクリーンの向き（従来の tgl と同じ）、裏面の除去、@n
+			２のべき乗で無いテクスチャーの負の座標でのリピート（参照との一致、@n
+			テクスチャーの外を読まない事）を確かめる。@n
+			TGL_sample と同じテクスチャー付き SolidCube の三角形／秒を「bench:」行で表示する
+    @author 平松邦仁 (hira@rvf-rc45.net)
+	@copyright	Copyright (C) 2021 Kunihito Hiramatsu @n
+				Released under the MIT license @n
+				https://github.com/hirakuni45/RX/blob/master/LICENSE
+*/
+//=====================================================================//
+#include <cmath>
+#include <set>
+#include "test.hpp"
+#include "host_stub.hpp"
+#include "graphics/tgl.hpp"
+#include "graphics/tgl_soft.hpp"
+#include "graphics/shape_3d.hpp"
+
+namespace graphics {
+	const share_color def_color::White(255, 255, 255);
+	const share_color def_color::Red(255, 0, 0);
+	const share_color def_color::Blue(0, 0, 255);
+	const share_color def_color::Green(0, 128, 0);
+	const share_color def_color::Fuchsi(255, 0, 255);
+	const share_color def_color::Yellow(255, 255, 0);
+}
+
+namespace {
+
+	static const int16_t LCD_X = 480;
+	static const int16_t LCD_Y = 272;
+
+	// graphics::render の代わり（フレーム・バッファ、クリップ領域、点と線の数）
+	template <int16_t W, int16_t H>
+	struct mock_render {
+		struct glc_type {
+			static const int16_t width  = W;
+			static const int16_t height = H;
+			static const int16_t line_width = W;
+		};
+
+		uint16_t	fb_[W * H];
+		vtx::srect	clip_;
+		uint32_t	plot_;
+		uint32_t	line_;
+
+		mock_render() : fb_{ }, clip_(0, 0, W, H), plot_(0), line_(0) { }
+
+		uint16_t* at_fb() { return fb_; }
+		const vtx::srect& get_clip() const { return clip_; }
+		void fast_plot(const vtx::spos& p, uint16_t c) { fb_[p.y * W + p.x] = c; ++plot_; }
+		void set_fore_color(const graphics::share_color& c) { }
+		void line(const vtx::spos& a, const vtx::spos& b) { ++line_; }
+
+		void clear() { for(auto& c : fb_) c = 0; }
+	};
+
+	typedef mock_render<LCD_X, LCD_Y> RENDER;
+	typedef graphics::tgl_soft<RENDER> SOFT;
+	typedef graphics::tgl<RENDER, 500, 300, 4, SOFT> TGL;
+	typedef graphics::tgl_soft<RENDER, true> SOFT_Z;
+	typedef graphics::tgl<RENDER, 500, 300, 4, SOFT_Z> TGL_Z;
+
+	RENDER		render_;
+	TGL			tgl_(render_);
+
+	template <class T>
+	void identity_(T& tgl)
+	{
+		auto& m = tgl.at_matrix();
+		m.set_viewport(0, 0, LCD_X, LCD_Y);
+		m.set_mode(gl::matrixf::mode::projection);
+		m.identity();
+		m.set_mode(gl::matrixf::mode::modelview);
+		m.identity();
+	}
+
+
+	// 描かれたピクセルの範囲
+	struct bound_t {
+		int32_t	x0 = LCD_X;
+		int32_t	y0 = LCD_Y;
+		int32_t	x1 = -1;
+		int32_t	y1 = -1;
+		uint32_t num = 0;
+	};
+
+	bound_t bound_()
+	{
+		bound_t b;
+		for(int32_t y = 0; y < LCD_Y; ++y) {
+			for(int32_t x = 0; x < LCD_X; ++x) {
+				if(render_.fb_[y * LCD_X + x] == 0) continue;
+				b.x0 = std::min(b.x0, x);
+				b.x1 = std::max(b.x1, x);
+				b.y0 = std::min(b.y0, y);
+				b.y1 = std::max(b.y1, y);
+				++b.num;
+			}
+		}
+		return b;
+	}
+
+
+	// スクリーンの Y は正規化座標と同じ向き（従来の tgl と同じ）、裏面の除去
+	void test_orientation_()
+	{
+		identity_(tgl_);
+		render_.clear();
+		tgl_.Color(graphics::share_color(255, 255, 255));
+		tgl_.Begin(TGL::PTYPE::TRIANGLE);
+		tgl_.Vertex(-0.2f, 0.3f);
+		tgl_.Vertex( 0.2f, 0.3f);
+		tgl_.Vertex( 0.0f, 0.7f);
+		tgl_.End();
+		tgl_.renderring();
+		auto b = bound_();
+		CHECK(b.num > 0);
+		CHECK(b.y0 >= LCD_Y * 13 / 20 - 1);
+		CHECK(b.y1 <= LCD_Y * 17 / 20 + 1);
+		// 頂点 (0, 0.7) は底辺より下
+		CHECK_EQ(render_.fb_[(LCD_Y * 17 / 20 - 2) * LCD_X + LCD_X / 2], 0xffff);
+		CHECK_EQ(render_.fb_[(LCD_Y * 13 / 20 + 2) * LCD_X + LCD_X * 4 / 10 + 2], 0xffff);
+
+		// 反時計回り（正規化座標）が表
+		tgl_.enable(TGL::CTRL::CULL_FACE);
+		tgl_.at_backend().reset_count();
+		render_.clear();
+		tgl_.Begin(TGL::PTYPE::TRIANGLE);
+		tgl_.Vertex(-0.5f, -0.5f);
+		tgl_.Vertex( 0.5f, -0.5f);
+		tgl_.Vertex( 0.0f,  0.5f);
+		tgl_.End();
+		tgl_.Begin(TGL::PTYPE::TRIANGLE);
+		tgl_.Vertex( 0.6f, -0.5f);
+		tgl_.Vertex( 0.6f,  0.5f);
+		tgl_.Vertex( 0.9f,  0.0f);
+		tgl_.End();
+		tgl_.renderring();
+		CHECK_EQ(tgl_.at_backend().get_triangle_count(), 1u);
+		CHECK_EQ(tgl_.at_backend().get_cull_count(), 1u);
+		b = bound_();
+		CHECK(b.num > 0);
+		CHECK(b.x1 < LCD_X * 8 / 10);
+		tgl_.enable(TGL::CTRL::CULL_FACE, false);
+	}
+
+
+	// ２のべき乗で無いテクスチャー（前に番兵を置き、外を読めば判る）
+	struct tex_mem_t {
+		uint16_t	guard[64];
+		uint16_t	tex[7 * 5];
+		uint16_t	tail[64];
+	};
+	tex_mem_t	tex_;
+	uint16_t	tex4_[4 * 4];
+
+	uint32_t texture_quad_(const uint16_t* tex, int16_t tw, int16_t th, float s0, float t0, float ss, float ts,
+		uint32_t& outside)
+	{
+		identity_(tgl_);
+		render_.clear();
+		tgl_.enable(TGL::CTRL::TEXTURE_2D);
+		auto hnd = tgl_.GenTexture();
+		CHECK(hnd < 4);
+		if(hnd >= 4) return 0;
+		tgl_.BindTexture(TGL::TARGET::TEXTURE_2D, hnd);
+		tgl_.TexImage2D(TGL::TARGET::TEXTURE_2D, vtx::spos(tw, th), TGL::FORMAT::RGB565, tex);
+		tgl_.Color(graphics::share_color(255, 255, 255));
+		tgl_.Begin(TGL::PTYPE::QUAD);
+		tgl_.TexCoord(s0, t0);
+		tgl_.Vertex(-1.0f, -1.0f);
+		tgl_.TexCoord(s0 + ss, t0);
+		tgl_.Vertex( 1.0f, -1.0f);
+		tgl_.TexCoord(s0 + ss, t0 + ts);
+		tgl_.Vertex( 1.0f,  1.0f);
+		tgl_.TexCoord(s0, t0 + ts);
+		tgl_.Vertex(-1.0f,  1.0f);
+		tgl_.End();
+		tgl_.renderring();
+		tgl_.DeleteTexture(hnd);
+		tgl_.enable(TGL::CTRL::TEXTURE_2D, false);
+
+		std::set<uint16_t> cols(tex, tex + tw * th);
+		outside = 0;
+		uint32_t match = 0;
+		for(int32_t y = 0; y < LCD_Y; ++y) {
+			for(int32_t x = 0; x < LCD_X; ++x) {
+				auto c = render_.fb_[y * LCD_X + x];
+				if(cols.count(c) == 0) ++outside;
+				double u = (s0 + (x + 0.5) / LCD_X * ss) * tw;
+				double v = (t0 + (y + 0.5) / LCD_Y * ts) * th;
+				// 座標が大きいと float の補間誤差でテクセルの境界がずれるので、隣までは許す
+				bool m = false;
+				for(int32_t j = -1; j <= 1; ++j) {
+					for(int32_t i = -1; i <= 1; ++i) {
+						int32_t ix = (static_cast<int32_t>(std::floor(u)) + i) % tw;
+						int32_t iy = (static_cast<int32_t>(std::floor(v)) + j) % th;
+						if(ix < 0) ix += tw;
+						if(iy < 0) iy += th;
+						if(c == tex[iy * tw + ix]) m = true;
+					}
+				}
+				if(m) ++match;
+			}
+		}
+		return match;
+	}
+
+	void test_texture_wrap_()
+	{
+		for(uint32_t i = 0; i < 64; ++i) tex_.guard[i] = tex_.tail[i] = 0x0001;
+		for(uint32_t i = 0; i < 35; ++i) tex_.tex[i] = graphics::share_color(32 + i * 6, 255 - i * 5, 128 + i * 3).rgb565 | 0x0820;
+		for(uint32_t i = 0; i < 16; ++i) tex4_[i] = graphics::share_color(20 + i * 14, 200 - i * 9, 90 + i * 3).rgb565 | 0x0820;
+
+		const uint32_t all = LCD_X * LCD_Y;
+		// 約４ピクセルで１テクセル、-256 周より小さい座標
+		static const struct { float s0; float t0; } cs[] = {
+			{ -1000.37f, -777.13f },
+			{ -300.21f, 2.31f },
+			{ 5.17f, -260.43f },
+			{ 0.13f, 0.21f },
+		};
+		for(const auto& c : cs) {
+			uint32_t outside;
+			auto match = texture_quad_(tex_.tex, 7, 5, c.s0, c.t0, LCD_X / 28.0f, LCD_Y / 20.0f, outside);
+			CHECK_EQ(outside, 0u);
+			CHECK(match >= all * 99 / 100);
+			std::printf("texture 7x5 (%.2f, %.2f): %u / %u match\n", c.s0, c.t0, match, all);
+			match = texture_quad_(tex4_, 4, 4, c.s0, c.t0, LCD_X / 16.0f, LCD_Y / 16.0f, outside);
+			CHECK_EQ(outside, 0u);
+			CHECK(match >= all * 99 / 100);
+		}
+	}
+
+
+	// TGL_sample と同じ、テクスチャー付きの回転する SolidCube
+	template <class T>
+	void bench_cube_(T& tgl, const char* name, bool depth)
+	{
+		static graphics::rgba8_t tex[32 * 32];
+		for(int16_t y = 0; y < 32; ++y) {
+			for(int16_t x = 0; x < 32; ++x) {
+				auto& t = tex[y * 32 + x];
+				t.a = 255;
+				t.r = ((y & 3) < 3) ? 192 : 255;
+				t.g = ((x & 3) < 3) ? 192 : 255;
+				t.b = ((x & 7) < 6) ? 192 : 255;
+			}
+		}
+		auto hnd = tgl.GenTexture();
+		CHECK(hnd < 4);
+		if(hnd >= 4) return;
+		tgl.BindTexture(T::TARGET::TEXTURE_2D, hnd);
+		tgl.TexImage2D(T::TARGET::TEXTURE_2D, vtx::spos(32, 32), T::FORMAT::RGBA8, tex);
+		tgl.enable(T::CTRL::TEXTURE_2D);
+		tgl.enable(T::CTRL::DEPTH_TEST, depth);
+
+		graphics::shape_3d<T> shape(tgl);
+		tgl.at_backend().reset_count();
+		static const uint32_t FRAMES = 2000;
+		float ax = 0.0f;
+		float ay = 0.0f;
+		test::stopwatch sw;
+		for(uint32_t i = 0; i < FRAMES; ++i) {
+			auto& m = tgl.at_matrix();
+			m.set_viewport(0, 0, LCD_X, LCD_Y);
+			m.set_mode(gl::matrixf::mode::projection);
+			m.identity();
+			m.perspective(45.0f, static_cast<float>(LCD_X) / static_cast<float>(LCD_Y), 1.0f, 50.0f);
+			m.set_mode(gl::matrixf::mode::modelview);
+			m.identity();
+			m.translate(0.0f, 0.0f, -10.0f);
+			m.rotate(ax, 1.0f, 0.0f, 0.0f);
+			m.rotate(ay, 0.0f, 1.0f, 0.0f);
+			shape.SolidCube(2.0f);
+			tgl.renderring();
+			ax = std::fmod(ax + 1.0f, 360.0f);
+			ay = std::fmod(ay + 1.5f, 360.0f);
+		}
+		auto sec = sw.sec();
+		const auto& b = tgl.at_backend();
+		CHECK(b.get_triangle_count() >= FRAMES * 6);
+		CHECK(b.get_pixel_count() > FRAMES * 1000);
+		std::printf("bench: %s SolidCube %ux%u: %.0f triangles/s, %.1f Mpixel/s, %.0f frames/s (%.0f pixels/frame)\n",
+			name, LCD_X, LCD_Y, b.get_triangle_count() / sec, b.get_pixel_count() / sec * 1e-6,
+			FRAMES / sec, static_cast<double>(b.get_pixel_count()) / FRAMES);
+		tgl.DeleteTexture(hnd);
+	}
+}
+
+
+int main(int argc, char* argv[])
+{
+	test_orientation_();
+	test_texture_wrap_();
+
+	bench_cube_(tgl_, "textured", false);
+	static RENDER render_z;
+	static TGL_Z tgl_z(render_z);
+	bench_cube_(tgl_z, "textured + z-buffer", true);
+
+	return test::result("tgl_soft");
+}
@@ -0,0 +1,336 @@
+//=====================================================================//
+/*!	@file
+	@brief	ufont、Unicode フォント・テスト @n
+			2bpp のフォント・イメージを作り、ufont_rom と、FatFs の RAM ディスク @n
+			上の ufont_file で展開した画素を、元の画素と比べる。@n
+			ブロック・サイズより大きなグリフ（３ブロックに跨る）、glyph_max が @n
+			TSIZE を超えるフォントの拒否、glyph_max の無い（古い）ファイルを検査する。@n
+			ROM／ファイルのグリフ／秒、キャッシュのヒット率、セクター読み出し数を @n
+			「bench:」行で表示する
+    @author 平松邦仁 (hira@rvf-rc45.net)
+	@copyright	Copyright (C) 2021 Kunihito Hiramatsu @n
+				Released under the MIT license @n
+				https://github.com/hirakuni45/RX/blob/master/LICENSE
+*/
+//=====================================================================//
+#include "FreeRTOS.h"
+#include <vector>
+#include <random>
+#include "test.hpp"
+#include "host_stub.hpp"
+#include "rtos_host.hpp"
+#include "ram_disk.hpp"
+#include "graphics/ufont.hpp"
+
+namespace {
+
+	typedef graphics::ufont_def DEF;
+
+	static const uint16_t BIG_CODE = 0x3013;	///< 64x64 のノイズ（生データ 1024 バイト）
+	static const uint16_t CJK_ORG = 0x4e00;
+	static const uint32_t CJK_NUM = 512;
+
+	struct src_glyph_t {
+		uint16_t	code;
+		uint8_t		w;
+		uint8_t		h;
+	};
+
+	// 元の画素（0～3）
+	uint8_t pixel_(uint16_t code, uint32_t x, uint32_t y)
+	{
+		if(code == BIG_CODE) {
+			uint32_t v = (code * 2654435761u) ^ (x * 40503u) ^ (y * 2246822519u);
+			v ^= v >> 13;
+			v *= 0x5bd1e995;
+			v ^= v >> 15;
+			return v & 3;
+		}
+		// 文字らしく、横線と縦線
+		uint32_t k = code * 7 + 3;
+		if(((y + k) % 5) == 0 && x >= (k % 3) && x < (12u - (k % 4))) return 3;
+		if(((x + k) % 6) == 1) return 2;
+		if(((x + y + k) % 11) == 0) return 1;
+		return 0;
+	}
+
+
+	template <typename T>
+	void put_(std::vector<uint8_t>& out, uint32_t ofs, const T& t)
+	{
+		std::memcpy(&out[ofs], &t, sizeof(T));
+	}
+
+
+	void align_(std::vector<uint8_t>& out)
+	{
+		while(out.size() & 3) out.push_back(0);
+	}
+
+
+	/// ufontconv と同じ配置で、１フェイス（2bpp、生データ）のイメージを作る
+	std::vector<uint8_t> build_(const std::vector<src_glyph_t>& src, bool glyph_max)
+	{
+		std::vector<uint8_t> out(sizeof(DEF::header_t) + sizeof(DEF::face_t), 0);
+		DEF::face_t f;
+		std::memset(&f, 0, sizeof(f));
+		f.height = 24;
+		f.ascent = 20;
+		f.bpp = 2;
+		f.glyph_num = src.size();
+		f.def_code = BIG_CODE;
+
+		uint16_t l1[256];
+		for(auto& v : l1) v = DEF::NO_PAGE;
+		std::vector<DEF::page_t> pages;
+		for(uint32_t i = 0; i < src.size(); ++i) {
+			auto code = src[i].code;
+			if(l1[code >> 8] == DEF::NO_PAGE) {
+				l1[code >> 8] = pages.size();
+				DEF::page_t pg;
+				std::memset(&pg, 0, sizeof(pg));
+				pg.base = i;
+				pages.push_back(pg);
+			}
+			pages[l1[code >> 8]].bits[(code & 0xff) >> 5] |= 1UL << (code & 31);
+		}
+		f.page_num = pages.size();
+		f.l1_ofs = out.size();
+		out.resize(out.size() + sizeof(l1));
+		std::memcpy(&out[f.l1_ofs], l1, sizeof(l1));
+		align_(out);
+		f.l2_ofs = out.size();
+		for(const auto& pg : pages) {
+			auto o = out.size();
+			out.resize(o + sizeof(pg));
+			put_(out, o, pg);
+		}
+		f.glyph_ofs = out.size();
+		out.resize(out.size() + sizeof(DEF::glyph_t) * src.size());
+		f.bits_ofs = out.size();
+
+		uint32_t maxlen = 0;
+		for(uint32_t i = 0; i < src.size(); ++i) {
+			const auto& s = src[i];
+			DEF::glyph_t g;
+			g.ofs = out.size() - f.bits_ofs;
+			g.w = s.w;
+			g.h = s.h;
+			g.bx = 0;
+			g.by = 0;
+			g.adv = s.w;
+			g.enc = DEF::ENC::RAW;
+			uint32_t num = static_cast<uint32_t>(s.w) * s.h;
+			g.len = (num * 2 + 7) / 8;
+			if(maxlen < g.len) maxlen = g.len;
+			auto o = out.size();
+			out.resize(o + g.len, 0);
+			for(uint32_t n = 0; n < num; ++n) {
+				out[o + n / 4] |= pixel_(s.code, n % s.w, n / s.w) << ((n % 4) * 2);
+			}
+			if(f.max_adv < g.adv) f.max_adv = g.adv;
+			put_(out, f.glyph_ofs + i * sizeof(DEF::glyph_t), g);
+		}
+		f.bits_size = out.size() - f.bits_ofs;
+		align_(out);
+		put_(out, sizeof(DEF::header_t), f);
+
+		DEF::header_t h;
+		std::memcpy(h.magic, "UFNT", 4);
+		h.version = DEF::VERSION;
+		h.face_num = 1;
+		h.size = out.size();
+		h.glyph_max = glyph_max ? maxlen : 0;
+		put_(out, 0, h);
+		return out;
+	}
+
+
+	std::vector<src_glyph_t> glyphs_()
+	{
+		std::vector<src_glyph_t> src;
+		for(uint16_t c = 0x20; c < 0x7f; ++c) src.push_back(src_glyph_t { c, 12, 20 });
+		src.push_back(src_glyph_t { BIG_CODE, 64, 64 });
+		for(uint32_t i = 0; i < CJK_NUM; ++i) {
+			src.push_back(src_glyph_t { static_cast<uint16_t>(CJK_ORG + i), 22, 22 });
+		}
+		return src;
+	}
+
+
+	/// 展開した画素を元の画素と比べる（不一致の画素数、失敗なら -1）
+	template <class UFONT>
+	int32_t verify_(UFONT& uf, uint16_t code)
+	{
+		typename UFONT::glyph_t g;
+		if(!uf.find(code, g)) return -1;
+		std::vector<uint8_t> pix(static_cast<uint32_t>(g.w) * g.h, 0);
+		bool ovf = false;
+		if(!uf.decode(g, [&](int16_t x, int16_t y, int16_t len, uint8_t lvl) {
+			if(x < 0 || y < 0 || (x + len) > g.w || y >= g.h) { ovf = true; return; }
+			for(int16_t i = 0; i < len; ++i) pix[y * g.w + x + i] = lvl;
+		})) return -1;
+		if(ovf) return -1;
+		int32_t bad = 0;
+		for(uint32_t y = 0; y < g.h; ++y) {
+			for(uint32_t x = 0; x < g.w; ++x) {
+				if(pix[y * g.w + x] != pixel_(code, x, y)) ++bad;
+			}
+		}
+		return bad;
+	}
+
+
+	template <class UFONT>
+	bool verify_all_(UFONT& uf, const std::vector<src_glyph_t>& src)
+	{
+		uint32_t bad = 0;
+		for(const auto& s : src) {
+			if(verify_(uf, s.code) != 0) {
+				std::fprintf(stderr, "  mismatch U+%04X\n", s.code);
+				++bad;
+			}
+		}
+		return bad == 0;
+	}
+
+
+	typedef graphics::ufont_file<8, 512> UFILE;
+	typedef graphics::ufont_file<8, 512, 512> UFILE_SMALL;
+
+
+	void test_rom_(const std::vector<uint8_t>& img, const std::vector<src_glyph_t>& src)
+	{
+		graphics::ufont_rom rom(img.data(), img.size());
+		graphics::ufont<graphics::ufont_rom> uf(rom);
+		CHECK(uf.open());
+		CHECK(verify_all_(uf, src));
+		// 無いコードは def_code（BIG_CODE）
+		graphics::ufont_def::glyph_t g;
+		CHECK(uf.find(0x9fff, g));
+		CHECK_EQ(g.w, 64);
+	}
+
+
+	void test_file_(const std::vector<uint8_t>& img, const std::vector<src_glyph_t>& src)
+	{
+		static UFILE file;
+		graphics::ufont<UFILE> uf(file);
+		CHECK(file.open("/font.ufn"));
+		CHECK(uf.open());
+		CHECK(verify_all_(uf, src));
+
+		// ブロック・サイズを超えるグリフは、３ブロックに跨る位置にある
+		graphics::ufont_def::glyph_t g;
+		CHECK(uf.find(BIG_CODE, g));
+		CHECK(g.len > 512);
+		auto ofs = uf.get_face(0).bits_ofs + g.ofs;
+		CHECK(((ofs % 512) + g.len) > 1024);
+		auto span = file.get_stat().span;
+		CHECK_EQ(verify_(uf, BIG_CODE), 0);
+		CHECK_EQ(file.get_stat().span, span + 1);
+		auto p = file.read(ofs, g.len);
+		CHECK(p != nullptr && std::memcmp(p, &img[ofs], g.len) == 0);
+
+		// TSIZE までは読め、超えると失敗
+		CHECK(file.read(100, UFILE::READ_MAX) != nullptr);
+		CHECK(file.read(100, UFILE::READ_MAX + 1) == nullptr);
+		CHECK(file.read(img.size() - 10, 11) == nullptr);
+		file.close();
+	}
+
+
+	void test_reject_()
+	{
+		// glyph_max（1024）が TSIZE（512）を超えるので、open で失敗
+		static UFILE_SMALL file;
+		graphics::ufont<UFILE_SMALL> uf(file);
+		CHECK(file.open("/font.ufn"));
+		CHECK(!uf.open());
+		file.close();
+
+		// glyph_max の無い（古い）ファイルは開けるが、大きなグリフの展開は失敗
+		CHECK(file.open("/old.ufn"));
+		CHECK(uf.open());
+		CHECK_EQ(verify_(uf, 'A'), 0);
+		CHECK_EQ(verify_(uf, BIG_CODE), -1);
+		file.close();
+	}
+
+
+	template <class UFONT>
+	double bench_(UFONT& uf, const std::vector<uint16_t>& text, uint32_t& runs)
+	{
+		runs = 0;
+		test::stopwatch sw;
+		for(auto code : text) {
+			typename UFONT::glyph_t g;
+			if(!uf.find(code, g)) continue;
+			uf.decode(g, [&](int16_t, int16_t, int16_t, uint8_t) { ++runs; });
+		}
+		return sw.sec();
+	}
+
+
+	void test_bench_(const std::vector<uint8_t>& img)
+	{
+		// 先頭の文字ほど多く出る、文章に近い分布
+		std::mt19937 rnd(45);
+		std::vector<uint16_t> text;
+		for(uint32_t i = 0; i < 200000; ++i) {
+			uint32_t a = rnd() % CJK_NUM;
+			uint32_t b = rnd() % CJK_NUM;
+			if((i % 4) == 0) text.push_back(0x20 + rnd() % 95);
+			else text.push_back(CJK_ORG + a * b / CJK_NUM);
+		}
+
+		graphics::ufont_rom rom(img.data(), img.size());
+		graphics::ufont<graphics::ufont_rom> ufr(rom);
+		CHECK(ufr.open());
+		uint32_t rr;
+		auto tr = bench_(ufr, text, rr);
+
+		static UFILE file;
+		graphics::ufont<UFILE> uff(file);
+		CHECK(file.open("/font.ufn"));
+		CHECK(uff.open());
+		test::disk().clear_count();
+		uint32_t rf;
+		auto tf = bench_(uff, text, rf);
+		CHECK_EQ(rr, rf);
+		const auto& st = file.get_stat();
+		auto acc = st.hit + st.miss;
+		uint32_t sec = test::disk().read_sec;
+		std::printf("bench: rom  %u glyphs, %.0f glyphs/s\n", static_cast<uint32_t>(text.size()),
+			text.size() / tr);
+		std::printf("bench: file %u glyphs, %.0f glyphs/s, cache hit %.1f%%, %u sectors read"
+			" (%.3f per glyph)\n", static_cast<uint32_t>(text.size()), text.size() / tf,
+			acc > 0 ? 100.0 * st.hit / acc : 0.0, sec, static_cast<double>(sec) / text.size());
+
+		// 大きなグリフだけ
+		std::vector<uint16_t> big(20000, BIG_CODE);
+		auto tb = bench_(uff, big, rf);
+		std::printf("bench: file 64x64 (%u bytes) %.0f glyphs/s\n", 64 * 64 * 2 / 8,
+			big.size() / tb);
+		file.close();
+	}
+}
+
+
+int main(int argc, char* argv[])
+{
+	auto src = glyphs_();
+	auto img = build_(src, true);
+	auto old = build_(src, false);
+
+	CHECK(test::mount_ram_disk(32768, 4));
+	CHECK(test::write_file("/font.ufn", img.data(), img.size()));
+	CHECK(test::write_file("/old.ufn", old.data(), old.size()));
+
+	test_rom_(img, src);
+	test_file_(img, src);
+	test_reject_();
+	test_bench_(img);
+
+	return test::result("ufont");
+}
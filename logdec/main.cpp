@@ -0,0 +1,313 @@
+//=====================================================================//
+/*!	@file
+	@brief	log_man トレース・レコード・デコーダー @n
+			・ELF ファイルの「__start_log_fmt」～「__stop_log_fmt」（無ければ「log_fmt」@n
+			  セクション）からフォーマットを取得 @n
+			・「log dump」コマンドの出力（'#' で始まる１６進の行）を読み、@n
+			  テキストに変換して出力する @n
+			・「%s」の引数は、ELF の ROM 上の文字列を参照する
+    @author 平松邦仁 (hira@rvf-rc45.net)
+	@copyright	Copyright (C) 2021 Kunihito Hiramatsu @n
+				Released under the MIT license @n
+				https://github.com/hirakuni45/RX/blob/master/LICENSE
+*/
+//=====================================================================//
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+namespace {
+
+	static const char* version_ = "0.50b";
+
+	struct section_t {
+		uint64_t	addr;
+		uint64_t	size;
+		uint64_t	offset;
+	};
+
+	std::vector<uint8_t>	elf_;
+	std::vector<section_t>	sections_;
+	section_t				fmt_;
+
+
+	template <typename T>
+	T get_(uint64_t ofs)
+	{
+		T v = 0;
+		if((ofs + sizeof(T)) <= elf_.size()) {
+			std::memcpy(&v, &elf_[ofs], sizeof(T));  // little endian
+		}
+		return v;
+	}
+
+
+	bool load_elf_(const std::string& file)
+	{
+		std::ifstream ifs(file, std::ios::binary);
+		if(!ifs) return false;
+		elf_.assign(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+		if(elf_.size() < 52 || std::memcmp(&elf_[0], "\x7f" "ELF", 4) != 0) return false;
+		if(elf_[5] != 1) {
+			std::cerr << "Big endian ELF is not supported" << std::endl;
+			return false;
+		}
+		bool e64 = elf_[4] == 2;
+		uint64_t shoff;
+		uint32_t shentsize, shnum, shstrndx;
+		if(e64) {
+			shoff = get_<uint64_t>(0x28);
+			shentsize = get_<uint16_t>(0x3A);
+			shnum = get_<uint16_t>(0x3C);
+			shstrndx = get_<uint16_t>(0x3E);
+		} else {
+			shoff = get_<uint32_t>(0x20);
+			shentsize = get_<uint16_t>(0x2E);
+			shnum = get_<uint16_t>(0x30);
+			shstrndx = get_<uint16_t>(0x32);
+		}
+
+		auto sec = [&](uint32_t idx, uint32_t& name, uint32_t& type, uint64_t& flags, section_t& s) {
+			auto o = shoff + idx * shentsize;
+			name = get_<uint32_t>(o);
+			type = get_<uint32_t>(o + 4);
+			if(e64) {
+				flags = get_<uint64_t>(o + 8);
+				s.addr = get_<uint64_t>(o + 16);
+				s.offset = get_<uint64_t>(o + 24);
+				s.size = get_<uint64_t>(o + 32);
+			} else {
+				flags = get_<uint32_t>(o + 8);
+				s.addr = get_<uint32_t>(o + 12);
+				s.offset = get_<uint32_t>(o + 16);
+				s.size = get_<uint32_t>(o + 20);
+			}
+		};
+
+		uint32_t name, type;
+		uint64_t flags;
+		section_t strs;
+		sec(shstrndx, name, type, flags, strs);
+		fmt_ = section_t { 0, 0, 0 };
+		section_t symtab = { 0, 0, 0 };
+		uint32_t strtab = 0;
+		for(uint32_t i = 0; i < shnum; ++i) {
+			section_t s;
+			sec(i, name, type, flags, s);
+			if(type == 2) {  // SYMTAB
+				symtab = s;
+				strtab = get_<uint32_t>(shoff + i * shentsize + (e64 ? 40 : 24));
+				continue;
+			}
+			if(type != 1 || (flags & 2) == 0) continue;  // PROGBITS, ALLOC
+			if((s.offset + s.size) > elf_.size()) continue;
+			sections_.push_back(s);
+			auto no = strs.offset + name;
+			if(no < elf_.size() && std::strcmp(reinterpret_cast<const char*>(&elf_[no]), "log_fmt") == 0) {
+				fmt_ = s;
+			}
+		}
+
+		// リンカー・スクリプトで .rodata に置いた場合は、シンボルで範囲を得る
+		if(symtab.size != 0 && strtab < shnum) {
+			section_t str;
+			sec(strtab, name, type, flags, str);
+			uint32_t esz = e64 ? 24 : 16;
+			uint64_t start = 0;
+			uint64_t stop = 0;
+			for(uint64_t o = symtab.offset; (o + esz) <= (symtab.offset + symtab.size); o += esz) {
+				auto no = str.offset + get_<uint32_t>(o);
+				if(no >= elf_.size()) continue;
+				auto sym = reinterpret_cast<const char*>(&elf_[no]);
+				uint64_t value = e64 ? get_<uint64_t>(o + 8) : get_<uint32_t>(o + 4);
+				if(std::strcmp(sym, "__start_log_fmt") == 0) start = value;
+				else if(std::strcmp(sym, "__stop_log_fmt") == 0) stop = value;
+			}
+			if(start != 0 && stop > start) {
+				for(const auto& s : sections_) {
+					if(start >= s.addr && stop <= (s.addr + s.size)) {
+						fmt_ = section_t { start, stop - start, s.offset + (start - s.addr) };
+						break;
+					}
+				}
+			}
+		}
+		return fmt_.size != 0;
+	}
+
+
+	// ターゲットのアドレスにある文字列
+	std::string target_str_(uint32_t addr)
+	{
+		for(const auto& s : sections_) {
+			if(addr >= s.addr && addr < (s.addr + s.size)) {
+				std::string str;
+				for(auto o = s.offset + (addr - s.addr); o < (s.offset + s.size) && elf_[o] != 0; ++o) {
+					str += static_cast<char>(elf_[o]);
+				}
+				return str;
+			}
+		}
+		char tmp[32];
+		snprintf(tmp, sizeof(tmp), "(%08X)", addr);
+		return tmp;
+	}
+
+
+	// utils::format のフォーマットを printf に置き換えて出力
+	std::string format_(const char* form, const uint32_t* arg, uint32_t num)
+	{
+		std::string out;
+		uint32_t n = 0;
+		char tmp[256];
+		while(*form != 0) {
+			char ch = *form++;
+			if(ch != '%') {
+				out += ch;
+				continue;
+			}
+			std::string spec = "%";
+			uint32_t bitlen = 0;
+			bool bit = false;
+			while((ch = *form) != 0) {
+				++form;
+				if(ch == ':') { bit = true; continue; }
+				if(bit && ch >= '0' && ch <= '9') { bitlen = bitlen * 10 + (ch - '0'); continue; }
+				if(ch == '+' || ch == '-' || ch == '.' || (ch >= '0' && ch <= '9')) {
+					spec += ch;
+					continue;
+				}
+				break;
+			}
+			if(ch == '%') {
+				out += '%';
+				continue;
+			}
+			if(n >= num) break;
+			auto v = arg[n++];
+			switch(ch) {
+			case 'd': case 'i':
+				snprintf(tmp, sizeof(tmp), (spec + 'd').c_str(), static_cast<int32_t>(v));
+				break;
+			case 'u': case 'x': case 'X': case 'o':
+				snprintf(tmp, sizeof(tmp), (spec + ch).c_str(), v);
+				break;
+			case 'c':
+				snprintf(tmp, sizeof(tmp), (spec + 'c').c_str(), static_cast<int>(v));
+				break;
+			case 'b':
+				{
+					std::string s;
+					for(int i = 31; i >= 0; --i) {
+						if(!s.empty() || (v >> i) & 1 || i == 0) s += ((v >> i) & 1) ? '1' : '0';
+					}
+					snprintf(tmp, sizeof(tmp), (spec + 's').c_str(), s.c_str());
+				}
+				break;
+			case 'y':
+				snprintf(tmp, sizeof(tmp), (spec + 'f').c_str(), static_cast<double>(v) / static_cast<double>(1ULL << bitlen));
+				break;
+			case 's':
+				snprintf(tmp, sizeof(tmp), (spec + 's').c_str(), target_str_(v).c_str());
+				break;
+			case 'p':
+				snprintf(tmp, sizeof(tmp), "%08X", v);
+				break;
+			case 'f': case 'F': case 'e': case 'E': case 'g': case 'G':
+				{
+					float f;
+					std::memcpy(&f, &v, 4);
+					snprintf(tmp, sizeof(tmp), (spec + ch).c_str(), static_cast<double>(f));
+				}
+				break;
+			default:
+				snprintf(tmp, sizeof(tmp), "(?%c)", ch);
+				break;
+			}
+			out += tmp;
+		}
+		return out;
+	}
+
+
+	bool decode_(const std::string& line)
+	{
+		std::vector<uint8_t> rec;
+		for(uint32_t i = 1; (i + 1) < line.size(); i += 2) {
+			auto h = line.substr(i, 2);
+			if(!isxdigit(h[0]) || !isxdigit(h[1])) break;
+			rec.push_back(std::stoul(h, nullptr, 16));
+		}
+		if(rec.size() < 8 || (rec[2] ^ 0xA5) != rec[3] || rec.size() != (8u + rec[2])) {
+			return false;
+		}
+		uint16_t id = rec[0] | (rec[1] << 8);
+		uint32_t time;
+		std::memcpy(&time, &rec[4], 4);
+		printf("%10u: ", time);
+		if(id == 0xFFFF) {
+			std::string s(rec.begin() + 8, rec.end());
+			if(s.empty() || s.back() != '\n') s += '\n';
+			fputs(s.c_str(), stdout);
+		} else if(id < fmt_.size) {
+			uint32_t arg[64];
+			uint32_t num = rec[2] / 4;
+			std::memcpy(arg, &rec[8], num * 4);
+			auto form = reinterpret_cast<const char*>(&elf_[fmt_.offset + id]);
+			printf("%s\n", format_(form, arg, num).c_str());
+		} else {
+			printf("(ID: %04X)\n", id);
+		}
+		return true;
+	}
+
+
+	void help_(const char* cmd)
+	{
+		printf("log_man trace decoder Version %s\n", version_);
+		printf("usage:\n");
+		printf("    %s ELF-file [dump-file]\n", cmd);
+		printf("    dump-file: output of 'log dump' ('#' hex lines), stdin if omitted\n");
+	}
+}
+
+
+int main(int argc, char* argv[])
+{
+	if(argc < 2) {
+		help_(argv[0]);
+		return 1;
+	}
+
+	if(!load_elf_(argv[1])) {
+		std::cerr << "Can't find 'log_fmt' formats: '" << argv[1] << "'" << std::endl;
+		return 1;
+	}
+
+	std::ifstream ifs;
+	if(argc >= 3) {
+		ifs.open(argv[2]);
+		if(!ifs) {
+			std::cerr << "Can't open dump file: '" << argv[2] << "'" << std::endl;
+			return 1;
+		}
+	}
+	std::istream& in = (argc >= 3) ? ifs : std::cin;
+
+	std::string line;
+	uint32_t error = 0;
+	while(std::getline(in, line)) {
+		while(!line.empty() && (line.back() == '\r' || line.back() == '\n')) line.pop_back();
+		if(line.empty() || line[0] != '#') continue;
+		if(!decode_(line)) ++error;
+	}
+	if(error > 0) {
+		std::cerr << "Broken record: " << error << std::endl;
+	}
+	return 0;
+}
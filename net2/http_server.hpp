@@ -1,9 +1,15 @@
 #pragma once
 //=====================================================================//
 /*!	@file
-	@brief	HTTP サーバー・クラス
+	@brief	HTTP サーバー・クラス @n
+			・複数の接続スロットで、同時に複数のクライアントを処理する。@n
+			・HTTP/1.1 キープ・アライブ、パイプライン・リクエストに対応 @n
+			・ファイルは、FatFs のタイムスタンプから ETag/Last-Modified を生成し、@n
+			  条件付き GET には「304 Not Modified」を返す。@n
+			・クライアントが gzip を受け付ける場合、「xxx.gz」があれば、@n
+			  それを「Content-Encoding: gzip」で送る。
     @author 平松邦仁 (hira@rvf-rc45.net)
-	@copyright	Copyright (C) 2017 Kunihito Hiramatsu @n
+	@copyright	Copyright (C) 2017, 2021 Kunihito Hiramatsu @n
 				Released under the MIT license @n
 				https://github.com/hirakuni45/RX/blob/master/LICENSE
 */
@@ -13,6 +19,7 @@
 #include <functional>
 #include "common/sdc_io.hpp"
 #include "common/fixed_string.hpp"
+#include "common/string_utils.hpp"
 #include "graphics/color.hpp"
 #include "common/format.hpp"
 #include "net2/tcp.hpp"
@@ -34,13 +41,13 @@ namespace net {
 		@param[in]	SDC			ＳＤカードファイル操作クラス
 		@param[in]	MAX_LINK	登録リンクの最大数
 		@param[in]	MAX_SIZE	文字列、一時バッファの最大数
+		@param[in]	SLOT_NUM	同時接続数（TCP ディスクリプタを同数使う）
 	*/
 	//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
-	template <class ETHERNET, class SDC, uint32_t MAX_LINK = 16, uint32_t MAX_SIZE = 4096>
+	template <class ETHERNET, class SDC, uint32_t MAX_LINK = 16, uint32_t MAX_SIZE = 4096,
+		uint32_t SLOT_NUM = 2>
 	class http_server {
 	public:
-		typedef utils::line_manage<2048, 20> LINE_MAN;
-
 		typedef utils::basic_format<desc_string<format_id::http, MAX_SIZE> > http_format;
 
 		typedef std::function< void () > http_task_type;
@@ -61,6 +68,10 @@ namespace net {
 	private:
 
 		static const uint16_t DISCONNECT_LOOP = 25;   ///< ０．２５秒
+		static const uint32_t RECV_SIZE  = 4096;	///< スロット毎の TCP 受信バッファ
+		static const uint32_t SEND_SIZE  = 8192;	///< スロット毎の TCP 送信バッファ
+		static const uint32_t REQ_SIZE   = 2048;	///< リクエスト（ヘッダー＋ボディー）の最大
+		static const uint32_t FILE_CHUNK = 512;		///< ファイル送信の単位
 
 		// デバッグ以外で出力を無効にする
 #ifdef HTTP_DEBUG
@@ -72,20 +83,11 @@ namespace net {
 		ETHERNET&		eth_;
 		SDC&			sdc_;
 
-		LINE_MAN		line_man_;
-
-		uint8_t			recv_buff_[4096];
-		uint8_t			send_buff_[8192];
-		uint32_t		desc_;
-
-		time_t			last_modified_;
 		char			server_name_[32];
 		uint32_t		timeout_;
 		uint32_t		max_;
 
 		uint32_t		count_;
-		uint32_t		disconnect_loop_;
-		uint32_t		delay_loop_;
 
 		struct link_t {
 			const char*	path_;
@@ -94,9 +96,10 @@ namespace net {
 			const char* file_;	// link file path.
 
 			http_task_type	task_;
+			uint32_t		hash_;
 			bool			cgi_;
 			link_t() : path_(nullptr), title_(nullptr), file_(nullptr),
-				task_(), cgi_(false) { }
+				task_(), hash_(0), cgi_(false) { }
 		};
 		uint32_t		link_num_;
 		link_t			link_[MAX_LINK];
@@ -108,23 +111,38 @@ namespace net {
 			begin_http,
 			wait_http,
 			main_loop,
+			send_file,
 			disconnect_delay,
 			delay_begin,
 			disconnect,
 		};
-		task		task_;
+
+		struct slot_t {
+			uint8_t		recv_buff_[RECV_SIZE];
+			uint8_t		send_buff_[SEND_SIZE];
+			char		req_[REQ_SIZE + 1];
+			uint32_t	desc_;
+			uint32_t	req_len_;
+			uint32_t	loop_;		///< 切断待ち、アイドル、再オープン待ちのカウンター
+			uint32_t	served_;	///< この接続で処理したリクエスト数
+			FILE*		fp_;
+			uint32_t	remain_;	///< ファイル送信の残りバイト数
+			task		task_;
+			bool		keep_;		///< 応答後も接続を維持する場合「true」
+			slot_t() : desc_(ETHERNET::TCP_OPEN_MAX), req_len_(0), loop_(0), served_(0),
+				fp_(nullptr), remain_(0), task_(task::none), keep_(false) { }
+		};
+		slot_t			slot_[SLOT_NUM];
+		slot_t*			cur_;		///< 応答を生成中のスロット
 
 		color			back_color_;
 		color			fore_color_;
 
 
-		bool			favicon_;
-		bool			other_link_;
-
-		static void get_path_(const char* src, char* dst) {
-			int n = 0;
+		static void get_path_(const char* src, char* dst, uint32_t len) {
+			uint32_t n = 0;
 			char ch;
-			while((ch = src[n]) != 0) {
+			while((ch = src[n]) != 0 && n < (len - 1)) {
 				if(ch == ' ') break;
 				dst[n] = ch;
 				++n;
@@ -133,6 +151,32 @@ namespace net {
 		}
 
 
+		// FNV-1a
+		static uint32_t hash_(const char* path) {
+			uint32_t h = 2166136261;
+			char ch;
+			while((ch = *path++) != 0) {
+				h ^= static_cast<uint8_t>(ch);
+				h *= 16777619;
+			}
+			return h;
+		}
+
+
+		// ヘッダー名の比較（大文字、小文字を区別しない）、一致したら値の位置を返す
+		static const char* match_key_(const char* line, const char* key) {
+			while(*key != 0) {
+				char a = *line++;
+				char b = *key++;
+				if(a >= 'A' && a <= 'Z') a += 'a' - 'A';
+				if(b >= 'A' && b <= 'Z') b += 'a' - 'A';
+				if(a != b) return nullptr;
+			}
+			while(*line == ' ' || *line == '\t') ++line;
+			return line;
+		}
+
+
 		void render_404page(const char* path)
 		{
 			exec_link(path);
@@ -160,14 +204,553 @@ namespace net {
 
 		int find_link_(const char* path, bool cgi)
 		{
+			auto h = hash_(path);
 			for(int i = 0; i < static_cast<int>(link_num_); ++i) {
-				if(std::strcmp(link_[i].path_, path) == 0 && link_[i].cgi_ == cgi) {
+				if(link_[i].hash_ != h || link_[i].cgi_ != cgi) continue;
+				if(std::strcmp(link_[i].path_, path) == 0) {
 					return i;
 				}
 			}
 			return -1;
 		}
 
+
+		void set_link_entry_(int idx, const char* path, const char* title, const char* file,
+			http_task_type task, bool cgi)
+		{
+			link_[idx].path_  = path;
+			link_[idx].title_ = title;
+			link_[idx].file_  = file;
+			link_[idx].task_  = task;
+			link_[idx].hash_  = hash_(path);
+			link_[idx].cgi_   = cgi;
+		}
+
+
+		bool keep_() const { return cur_ != nullptr && cur_->keep_; }
+
+
+		static void gmt_str_(time_t t, char* dst, uint32_t len)
+		{
+			struct tm *m = gmtime(&t);
+			// Sun, 11 Jan 2004 16:06:23 GMT
+			utils::sformat("%s, %02d %s %4d %02d:%02d:%02d GMT", dst, len)
+				% get_wday(m->tm_wday)
+				% static_cast<uint32_t>(m->tm_mday)
+				% get_mon(m->tm_mon)
+				% static_cast<uint32_t>(m->tm_year + 1900)
+				% static_cast<uint32_t>(m->tm_hour)
+				% static_cast<uint32_t>(m->tm_min)
+				% static_cast<uint32_t>(m->tm_sec);
+		}
+
+
+		void make_status_(int status)
+		{
+			http_format("HTTP/1.1 %d ") % status;
+			switch(status) {
+			case 200: http_format("OK\n"); break;
+			case 304: http_format("Not Modified\n"); break;
+			case 400: http_format("Bad Request\n"); break;
+			case 404: http_format("Not Found\n"); break;
+			case 413: http_format("Payload Too Large\n"); break;
+			default:  http_format("NG\n"); break;
+			}
+			char tmp[40];
+			gmt_str_(get_time(), tmp, sizeof(tmp));
+			http_format("Date: %s\n") % tmp;
+			http_format("Server: %s\n") % server_name_;
+		}
+
+
+		void make_connection_()
+		{
+			if(keep_()) {
+				http_format("Keep-Alive: timeout=%u, max=%u\n") % timeout_ % max_;
+			}
+			http_format("Connection: %s\n") % (keep_() ? "keep-alive" : "close");
+		}
+
+
+		static const char* mime_(const char* path)
+		{
+			const char* ext = std::strrchr(path, '.');
+			if(ext == nullptr) return "text/plain";
+			++ext;
+			static const char* tbl[] = {
+				"html", "text/html",
+				"htm",  "text/html",
+				"css",  "text/css",
+				"js",   "application/javascript",
+				"json", "application/json",
+				"png",  "image/png",
+				"jpg",  "image/jpeg",
+				"jpeg", "image/jpeg",
+				"gif",  "image/gif",
+				"svg",  "image/svg+xml",
+				"ico",  "image/x-icon",
+				"txt",  "text/plain",
+			};
+			for(uint32_t i = 0; i < (sizeof(tbl) / sizeof(tbl[0])); i += 2) {
+				if(std::strcmp(ext, tbl[i]) == 0) return tbl[i + 1];
+			}
+			return "application/octet-stream";
+		}
+
+
+		// 空のボディーで応答（404 等）
+		void send_status_(int status)
+		{
+			http_format::chaout().clear();
+			make_status_(status);
+			http_format("Content-Length: 0\n");
+			make_connection_();
+			http_format("\n");
+			http_format::chaout().flush();
+		}
+
+
+		struct request_t {
+			const char*	if_none_match_;
+			const char*	if_modified_since_;
+			uint32_t	content_length_;
+			bool		gzip_;
+			request_t() : if_none_match_(nullptr), if_modified_since_(nullptr),
+				content_length_(0), gzip_(false) { }
+		};
+
+
+		// Accept-Encoding の値（行末まで）で gzip が使えるか
+		// 「gzip」、「x-gzip」、又は「*」（gzip の指定が無い場合）で、q=0 で無い事
+		static bool accept_gzip_(const char* v)
+		{
+			int8_t gzip = -1;
+			int8_t any = -1;
+			while(*v != 0 && *v != '\r' && *v != '\n') {
+				while(*v == ' ' || *v == '\t' || *v == ',') ++v;
+				const char* top = v;
+				while(*v != 0 && *v != '\r' && *v != '\n' && *v != ',' && *v != ';'
+					&& *v != ' ' && *v != '\t') ++v;
+				uint32_t len = v - top;
+				// パラメーター（q 値）
+				bool zero = false;
+				while(*v != 0 && *v != '\r' && *v != '\n' && *v != ',') {
+					if(*v == ';') {
+						++v;
+						while(*v == ' ' || *v == '\t') ++v;
+						if((*v == 'q' || *v == 'Q') && v[1] == '=') {
+							v += 2;
+							zero = *v == '0';
+							if(zero) {
+								++v;
+								if(*v == '.') ++v;
+								while(*v == '0') ++v;
+								if(*v >= '1' && *v <= '9') zero = false;
+							}
+						}
+						continue;
+					}
+					++v;
+				}
+				if(len == 0) continue;
+				if((len == 4 && match_key_(top, "gzip") != nullptr)
+				 || (len == 6 && match_key_(top, "x-gzip") != nullptr)) {
+					gzip = zero ? 0 : 1;
+				} else if(len == 1 && *top == '*') {
+					any = zero ? 0 : 1;
+				}
+			}
+			if(gzip >= 0) return gzip != 0;
+			return any > 0;
+		}
+
+
+		// ヘッダーの終端（空行）を探す、見つかったらヘッダー長を返す
+		static uint32_t find_term_(const char* p, uint32_t len)
+		{
+			for(uint32_t i = 0; i < len; ++i) {
+				if(p[i] != '\n') continue;
+				if((i + 1) < len && p[i + 1] == '\n') return i + 2;
+				if((i + 2) < len && p[i + 1] == '\r' && p[i + 2] == '\n') return i + 3;
+			}
+			return 0;
+		}
+
+
+		// ヘッダーから Content-Length を取得（バッファは変更しない）
+		static uint32_t scan_content_length_(const char* p, uint32_t hlen)
+		{
+			for(uint32_t i = 0; (i + 1) < hlen; ++i) {
+				if(p[i] != '\n') continue;
+				auto v = match_key_(&p[i + 1], "Content-Length:");
+				if(v == nullptr) continue;
+				uint32_t n = 0;
+				while(*v >= '0' && *v <= '9' && n <= REQ_SIZE) {
+					n = n * 10 + (*v - '0');
+					++v;
+				}
+				return n;
+			}
+			return 0;
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief  ファイル送信の開始（ヘッダーを送り、ボディーは pump_file_ で送る）
+			@param[in]	s		スロット
+			@param[in]	file	ファイル・パス
+			@param[in]	req		リクエスト
+			@return ファイルが無い場合「false」
+		*/
+		//-----------------------------------------------------------------//
+		bool send_file_(slot_t& s, const char* file, const request_t& req)
+		{
+			if(!sdc_.probe(file)) {
+				return false;
+			}
+
+			// 圧縮済みファイルがあれば、それを送る
+			char gzf[256];
+			bool gz = false;
+			if(req.gzip_) {
+				utils::sformat("%s.gz", gzf, sizeof(gzf)) % file;
+				gz = sdc_.probe(gzf);
+			}
+			const char* src = gz ? gzf : file;
+
+			// ETag、Last-Modified は、送るファイルのタイムスタンプとサイズから生成する
+			// （gzip は表現が違うので「-gz」を付け、無圧縮の ETag と一致させない）
+			time_t t = sdc_.get_time(src);
+			uint32_t fsz = sdc_.size(src);
+			char etag[32];
+			utils::sformat("\"%x-%x%s\"", etag, sizeof(etag)) % static_cast<uint32_t>(t) % fsz
+				% (gz ? "-gz" : "");
+			char lmod[40];
+			gmt_str_(t, lmod, sizeof(lmod));
+
+			bool match = false;
+			if(req.if_none_match_ != nullptr) {
+				match = std::strstr(req.if_none_match_, etag) != nullptr;
+			} else if(req.if_modified_since_ != nullptr) {
+				match = std::strcmp(req.if_modified_since_, lmod) == 0;
+			}
+
+			http_format::chaout().clear();
+			if(match) {
+				make_status_(304);
+				if(req.gzip_ || gz) {
+					http_format("Vary: Accept-Encoding\n");
+				}
+				http_format("ETag: %s\n") % etag;
+				make_connection_();
+				http_format("\n");
+				http_format::chaout().flush();
+				debug_format("HTTP Server: '%s' not modified\n") % file;
+				return true;
+			}
+
+			s.fp_ = fopen(src, "rb");
+			if(s.fp_ == nullptr) {
+				return false;
+			}
+			s.remain_ = fsz;
+
+			make_status_(200);
+			http_format("Content-Type: %s\n") % mime_(file);
+			http_format("Content-Length: %u\n") % fsz;
+			if(gz) {
+				http_format("Content-Encoding: gzip\n");
+			}
+			if(req.gzip_ || gz) {
+				http_format("Vary: Accept-Encoding\n");
+			}
+			http_format("ETag: %s\n") % etag;
+			http_format("Last-Modified: %s\n") % lmod;
+			make_connection_();
+			http_format("\n");
+			http_format::chaout().flush();
+
+			debug_format("HTTP Server: '%s'%s, size(%u)\n") % file % (gz ? " (gzip)" : "") % fsz;
+			return true;
+		}
+
+
+		// 送信バッファの空きだけ、ファイルを送る、終了したら「true」
+		bool pump_file_(slot_t& s)
+		{
+			auto& tcp = eth_.at_ipv4().at_tcp();
+			while(s.remain_ > 0) {
+				int len = tcp.get_send_length(s.desc_);
+				if(len < 0) break;
+				uint32_t spc = SEND_SIZE - 1 - len;
+				if(spc < FILE_CHUNK && spc < s.remain_) return false;
+				uint8_t tmp[FILE_CHUNK];
+				uint32_t n = s.remain_ < FILE_CHUNK ? s.remain_ : FILE_CHUNK;
+				uint32_t rl = fread(tmp, 1, n, s.fp_);
+				if(rl == 0) break;
+				tcp.send(s.desc_, tmp, rl);
+				s.remain_ -= rl;
+			}
+			if(s.remain_ > 0) {  // 読み込みエラー、応答が不完全なので切断する
+				s.keep_ = false;
+			}
+			fclose(s.fp_);
+			s.fp_ = nullptr;
+			s.remain_ = 0;
+			return true;
+		}
+
+
+		void close_file_(slot_t& s)
+		{
+			if(s.fp_ != nullptr) {
+				fclose(s.fp_);
+				s.fp_ = nullptr;
+			}
+			s.remain_ = 0;
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief  リクエストを１つ処理する
+			@param[in]	s	スロット
+			@return リクエストが揃っていない場合「false」
+		*/
+		//-----------------------------------------------------------------//
+		bool exec_request_(slot_t& s)
+		{
+			uint32_t hlen = find_term_(s.req_, s.req_len_);
+			if(hlen == 0) {
+				if(s.req_len_ >= REQ_SIZE) {
+					debug_format("HTTP Server: request header over\n");
+					s.keep_ = false;
+					send_status_(413);
+					s.req_len_ = 0;
+					return true;
+				}
+				return false;
+			}
+
+			// ボディーが揃うまで待つ（バッファはまだ変更しない）
+			request_t req;
+			req.content_length_ = scan_content_length_(s.req_, hlen);
+			uint32_t total = hlen + req.content_length_;
+			if(total > REQ_SIZE) {
+				debug_format("HTTP Server: request body over (%u)\n") % req.content_length_;
+				s.keep_ = false;
+				send_status_(413);
+				s.req_len_ = 0;
+				return true;
+			}
+			if(s.req_len_ < total) {
+				return false;
+			}
+
+			// ヘッダーを行に分解
+			const char* cmd = s.req_;
+			bool http11;
+			bool keep_req = false;
+			bool close_req = false;
+			for(uint32_t i = 0; i < hlen; ++i) {
+				char ch = s.req_[i];
+				if(ch != '\r' && ch != '\n') continue;
+				s.req_[i] = 0;
+				if(ch == '\r') continue;
+				const char* p = &s.req_[i + 1];
+				if(*p == '\r' || *p == '\n') break;
+				const char* v;
+				if((v = match_key_(p, "Connection:")) != nullptr) {
+					if(match_key_(v, "close") != nullptr) close_req = true;
+					else if(match_key_(v, "keep-alive") != nullptr) keep_req = true;
+				} else if((v = match_key_(p, "If-None-Match:")) != nullptr) {
+					req.if_none_match_ = v;
+				} else if((v = match_key_(p, "If-Modified-Since:")) != nullptr) {
+					req.if_modified_since_ = v;
+				} else if((v = match_key_(p, "Accept-Encoding:")) != nullptr) {
+					req.gzip_ = accept_gzip_(v);
+				}
+			}
+			http11 = std::strstr(cmd, " HTTP/1.1") != nullptr;
+
+			++s.served_;
+			s.keep_ = (http11 || keep_req) && !close_req && s.served_ < max_;
+
+			char path[256];
+			path[0] = 0;
+			if(std::strncmp(cmd, "GET ", 4) == 0) {
+				get_path_(cmd + 4, path, sizeof(path));
+				debug_format("HTTP Server: GET '%s' desc(%d)\n") % path % s.desc_;
+				int idx = find_link_(path, false);
+				bool find = false;
+				if(idx >= 0 && link_[idx].file_ != nullptr) {
+					find = send_file_(s, link_[idx].file_, req);
+				} else {
+					find = exec_link(path, false);
+				}
+				if(!find) {
+					debug_format("HTTP Server: can't find GET: '%s'\n") % path;
+					send_status_(404);
+				}
+			} else if(std::strncmp(cmd, "POST ", 5) == 0) {
+				get_path_(cmd + 5, path, sizeof(path));
+				debug_format("HTTP Server: POST '%s' (%u)\n") % path % req.content_length_;
+				char ch = s.req_[total];
+				s.req_[total] = 0;
+				utils::str::url_encode_to_str(&s.req_[hlen], post_body_, sizeof(post_body_));
+				s.req_[total] = ch;
+				// CGI の応答長は判らないので、応答後に切断する
+				s.keep_ = false;
+				bool find = exec_link(path, true);
+				if(!find) {
+					debug_format("HTTP Server: can't find POST: '%s'\n") % path;
+					send_status_(404);
+				}
+			} else {
+				debug_format("HTTP Server: request fail command '%s'\n") % cmd;
+				s.keep_ = false;
+				send_status_(400);
+			}
+
+			// パイプラインされた後続のリクエストを先頭へ
+			s.req_len_ -= total;
+			if(s.req_len_ > 0) {
+				std::memmove(s.req_, &s.req_[total], s.req_len_);
+			}
+			return true;
+		}
+
+
+		void service_slot_(slot_t& s, uint16_t http_port)
+		{
+			auto& ipv4 = eth_.at_ipv4();
+			auto& tcp  = ipv4.at_tcp();
+
+			switch(s.task_) {
+
+			case task::begin_http:
+				{
+					ip_adrs adrs;
+					bool err = false;
+					if(tcp.open(s.send_buff_, sizeof(s.send_buff_),
+						s.recv_buff_, sizeof(s.recv_buff_), s.desc_)) {
+						if(tcp.start(s.desc_, adrs, http_port, true)) {
+							debug_format("HTTP Server Start: '%s' port(%d), desc(%d)\n")
+								% eth_.at_info().ip.c_str()
+								% static_cast<int>(http_port)
+								% s.desc_;
+							s.task_ = task::wait_http;
+						} else {
+							tcp.close(s.desc_);
+							err = true;
+						}
+					} else {
+						err = true;
+					}
+					if(err) {
+						debug_format("HTTP TCP open error\n");
+						s.task_ = task::delay_begin;
+						s.loop_ = 100; // 1 sec
+					}
+				}
+				break;
+
+			case task::wait_http:
+				if(tcp.connected(s.desc_)) {
+					debug_format("HTTP Server: New connected, form: %s desc(%d)\n")
+						% tcp.get_ip(s.desc_).c_str() % s.desc_;
+					++count_;
+					s.req_len_ = 0;
+					s.served_ = 0;
+					s.keep_ = false;
+					s.loop_ = timeout_ * 100;
+					s.task_ = task::main_loop;
+				}
+				break;
+
+			case task::main_loop:
+				if(!tcp.connected(s.desc_)) {
+					debug_format("HTTP Server: connection un-link (out main) desc(%d)\n") % s.desc_;
+					s.loop_ = 0;
+					s.task_ = task::disconnect_delay;
+					break;
+				}
+				{
+					int len = tcp.recv(s.desc_, &s.req_[s.req_len_], REQ_SIZE - s.req_len_);
+					if(len > 0) {
+						s.req_len_ += len;
+						s.loop_ = timeout_ * 100;
+					} else if(s.loop_ > 0) {
+						--s.loop_;
+					} else {
+						debug_format("HTTP Server: keep-alive timeout desc(%d)\n") % s.desc_;
+						s.task_ = task::disconnect_delay;
+						break;
+					}
+				}
+				if(s.req_len_ == 0) break;
+
+				http_format::chaout().set_desc(s.desc_);
+				cur_ = &s;
+				if(exec_request_(s)) {
+					if(s.fp_ != nullptr) {
+						s.task_ = task::send_file;
+					} else if(!s.keep_) {
+						s.loop_ = DISCONNECT_LOOP;
+						s.task_ = task::disconnect_delay;
+					}
+				}
+				cur_ = nullptr;
+				break;
+
+			case task::send_file:
+				if(!tcp.connected(s.desc_)) {
+					close_file_(s);
+					s.loop_ = 0;
+					s.task_ = task::disconnect_delay;
+					break;
+				}
+				if(pump_file_(s)) {
+					if(s.keep_) {
+						s.loop_ = timeout_ * 100;
+						s.task_ = task::main_loop;
+					} else {
+						s.loop_ = DISCONNECT_LOOP;
+						s.task_ = task::disconnect_delay;
+					}
+				}
+				break;
+
+			case task::disconnect_delay:
+				if(s.loop_ > 0) {
+					--s.loop_;
+				} else {
+					close_file_(s);
+					tcp.close(s.desc_);
+					s.task_ = task::disconnect;
+				}
+				break;
+
+			case task::delay_begin:
+				if(s.loop_ > 0) {
+					--s.loop_;
+				} else {
+					s.task_ = task::begin_http;
+				}
+				break;
+
+			case task::disconnect:
+				debug_format("HTTP Server: disconnected desc(%d)\n") % s.desc_;
+				s.task_ = task::begin_http;
+				break;
+
+			case task::none:
+			default:
+				break;
+			}
+		}
+
 	public:
 		//-----------------------------------------------------------------//
 		/*!
@@ -177,13 +760,11 @@ namespace net {
 		*/
 		//-----------------------------------------------------------------//
 		http_server(ETHERNET& eth, SDC& sdc) : eth_(eth), sdc_(sdc),
-			line_man_(0x0a), desc_(ETHERNET::TCP_OPEN_MAX),
-			last_modified_(0), server_name_{ 0 }, timeout_(15), max_(60),
-			count_(0), disconnect_loop_(0), delay_loop_(0),
-			link_num_(0), link_{ },
-			task_(task::none),
-			back_color_(255, 255, 255), fore_color_(0, 0, 0),
-			favicon_(false), other_link_(false)
+			server_name_{ 0 }, timeout_(15), max_(100),
+			count_(0),
+			link_num_(0), link_{ }, post_body_{ 0 },
+			slot_{ }, cur_(nullptr),
+			back_color_(255, 255, 255), fore_color_(0, 0, 0)
 		{ }
 
 
@@ -198,35 +779,27 @@ namespace net {
 
 		//-----------------------------------------------------------------//
 		/*!
-			@brief クライアントからの応答を解析して終端（空行）があったら行数を返す
-			@return 行数
+			@brief  キープ・アライブの設定
+			@param[in]	timeout	アイドル・タイムアウト（秒）
+			@param[in]	max		１接続で処理する最大リクエスト数
 		*/
 		//-----------------------------------------------------------------//
-		int analize_request(const char* tmp, int len)
+		void set_keep_alive(uint32_t timeout, uint32_t max)
 		{
-			for(int i = 0; i < len; ++i) {
-				char ch = tmp[i];
-				if(ch == 0 || ch == 0x0d) continue;
-				if(!line_man_.add(ch)) {
-					debug_format("HTTP Server: line_man:- memory over\n");
-					return -1;
-				}
-			}
-			if(len > 0) {
-				line_man_.set_term();
-				if(!line_man_.empty()) {
-					for(uint32_t i = 0; i < line_man_.size(); ++i) {
-						const char* p = line_man_[i];
-						if(p[0] == 0) {  // 応答の終端！（空行）
-							return i;
-						}
-					}
-				}
-			}
-			return -1;
+			timeout_ = timeout;
+			max_ = max;
 		}
 
 
+		//-----------------------------------------------------------------//
+		/*!
+			@brief  接続数を取得
+			@return 接続数
+		*/
+		//-----------------------------------------------------------------//
+		uint32_t get_count() const { return count_; }
+
+
 		//-----------------------------------------------------------------//
 		/*!
 			@brief  スタート
@@ -237,12 +810,11 @@ namespace net {
 		{
 			std::strncpy(server_name_, server_name, sizeof(server_name_) - 1);
 
-			last_modified_ = get_time();
-
 			count_ = 0;
-			disconnect_loop_ = 0;
 
-			task_ = task::begin_http;
+			for(uint32_t i = 0; i < SLOT_NUM; ++i) {
+				slot_[i].task_ = task::begin_http;
+			}
 		}
 
 
@@ -252,56 +824,28 @@ namespace net {
 					※「Content-Length: 」には５文字のスペースが予約されている
 			@param[in]	status	ステータスコード
 			@param[in]	length	コンテンツ長（バイト）負の値なら、５文字の空白
-			@param[in]	keep	セッション・キープの場合「true」
+			@param[in]	keep	セッション・キープの場合「true」@n
+							※クライアントがキープ・アライブを要求していない場合は無視
 			@return 「Content-Length: 」数値を埋め込む位置
 		*/
 		//-----------------------------------------------------------------//
 		uint32_t make_info(int status, int length, bool keep = false)
 		{
-			uint32_t lp = 0;
-			http_format("HTTP/1.1 %d ") % status;
-			if(status == 200) {
-				http_format("OK\n");
-			} else if(status == 404) {
-				http_format("Not Found\n");
-			} else {
-				http_format("NG\n");
+			if(!keep && cur_ != nullptr) {
+				cur_->keep_ = false;
 			}
 
-			time_t t = get_time();
-			struct tm *m = gmtime(&t);
-			// Sun, 11 Jan 2004 16:06:23 GMT
-			http_format("Date: %s, %02d %s %4d %02d:%02d:%02d GMT\n")
-				% get_wday(m->tm_wday)
-				% static_cast<uint32_t>(m->tm_mon + 1)
-				% get_mon(m->tm_mon)
-				% static_cast<uint32_t>(m->tm_year + 1900)
-				% static_cast<uint32_t>(m->tm_hour)
-				% static_cast<uint32_t>(m->tm_min)
-				% static_cast<uint32_t>(m->tm_sec);
-			http_format("Server: %s\n") % server_name_;
-
-			http_format("Last-Modified: %s,%02d %s %4d %02d:%02d:%02d GMT\n")
-				% get_wday(m->tm_wday)
-				% static_cast<uint32_t>(m->tm_mon + 1)
-				% get_mon(m->tm_mon)
-				% static_cast<uint32_t>(m->tm_year + 1900)
-				% static_cast<uint32_t>(m->tm_hour)
-				% static_cast<uint32_t>(m->tm_min)
-				% static_cast<uint32_t>(m->tm_sec);
-			http_format("Accept_ranges: bytes\n");
+			uint32_t lp = 0;
+			make_status_(status);
+			http_format("Accept-Ranges: bytes\n");
 			if(length >= 0) {
 				http_format("Content-Length: %d\n") % length;
 			} else {
 				http_format("Content-Length: ");
 				lp = http_format::chaout().size();
-				// % http_format::chaout().at_str().capacity();
 				http_format("     \n");
 			}
-			if(keep) {
-				http_format("Keep-Alive: timeout=%u,max=%u\n") % timeout_ % max_;
-			}
-			http_format("Connection: %s\n") % (keep == true ? "keep-alive" : "close");
+			make_connection_();
 			http_format("Content-Type: text/html\n\n");
 
 			return lp;
@@ -339,24 +883,6 @@ namespace net {
 			uint32_t clp = 0;
 			uint32_t org = 0;
 
-			if(std::strcmp(path, "/favicon.ico") == 0) {
-				clp = make_info(404, -1, false);
-				http_format("<!DOCTYPE HTML><html><head><title>404 Not Found</title></head>");
-				http_format("<body></body></html>");
-				uint32_t end = http_format::chaout().size();
-				char tmp[5 + 1];  // 数字５文字＋終端
-				utils::sformat("%5d", tmp, sizeof(tmp)) % (end - org);
-				strncpy(&http_format::chaout().at_str()[clp], tmp, 5); // 数字部のみコピー
-				http_format::chaout().flush();  // 最終的な書き込み
-
-				debug_format("HTTP Server: '%s', size(%d)\n") % path % (end - org);
-
-				favicon_ = true;
-				return true;
-			}
-
-			other_link_ = true;
-
 			int idx = find_link_(path, cgi);
 			if(idx < 0) return false;
 
@@ -385,7 +911,7 @@ namespace net {
 			uint32_t end = http_format::chaout().size();
 			char tmp[5 + 1];  // 数字５文字＋終端
 			utils::sformat("%5d", tmp, sizeof(tmp)) % (end - org);
-			strncpy(&http_format::chaout().at_str()[clp], tmp, 5); // 数字部のみコピー
+			std::memcpy(&http_format::chaout().at_str()[clp], tmp, 5); // 数字部のみコピー
 			http_format::chaout().flush();  // 最終的な書き込み
 
 			debug_format("HTTP Server: '%s', size(%d)\n") % path % (end - org);
@@ -394,37 +920,6 @@ namespace net {
 		}
 
 
-		//-----------------------------------------------------------------//
-		/*!
-			@brief  URL エンコードとパース
-			@param[in]	pos		データの行位置
-		*/
-		//-----------------------------------------------------------------//
-		void parse_cgi(int pos)
-		{
-			int len = 0;
-			for(int i = 0; i < static_cast<int>(line_man_.size()); ++i) {
-				const char* p = line_man_[i];
-				static const char* key = { "Content-Length: " };
-				if(strncmp(p, key, strlen(key)) == 0) {
-					utils::input("%d", p + strlen(key)) % len;
-					break;
-				}
-			}
-
-			int lines = static_cast<int>(line_man_.size());
-			++pos;
-			post_body_[0] = 0;
-			if(pos >= lines) {
-				debug_format("CGI No Body\n");
-			} else {
-//				utils::format("CGI param (URL enocde): '%s'\n") % line_man_[pos];
-				utils::str::url_encode_to_str(line_man_[pos], post_body_);
-//				debug_format("CGI param (str): '%s'\n") % post_body_;
-			}
-		}
-
-
 		//-----------------------------------------------------------------//
 		/*!
 			@brief  リンク登録全クリア
@@ -447,11 +942,7 @@ namespace net {
 			int idx = set_link_(path);
 			if(idx < 0) return false;
 
-			link_[idx].path_  = path;
-			link_[idx].title_ = title;
-			link_[idx].file_  = nullptr;
-			link_[idx].task_  = task;
-			link_[idx].cgi_   = false;
+			set_link_entry_(idx, path, title, nullptr, task, false);
 			return true;
 		}
 
@@ -470,18 +961,15 @@ namespace net {
 			int idx = set_link_(path);
 			if(idx < 0) return false;
 
-			link_[idx].path_  = path;
-			link_[idx].title_ = title;
-			link_[idx].file_  = nullptr;
-			link_[idx].task_  = task;
-			link_[idx].cgi_   = true;
+			set_link_entry_(idx, path, title, nullptr, task, true);
 			return true;
 		}
 
 
 		//-----------------------------------------------------------------//
 		/*!
-			@brief  ファイルの登録
+			@brief  ファイルの登録 @n
+					「file.gz」があれば、gzip を受け付けるクライアントにはそれを送る
 			@param[in]	path	ページ・パス
 			@param[in]	title	ページ・タイトル
 			@param[in]	file	ファイル・パス
@@ -493,196 +981,21 @@ namespace net {
 			int idx = set_link_(path);
 			if(idx < 0) return false;
 
-			link_[idx].path_  = path;
-			link_[idx].title_ = title;
-			link_[idx].file_  = file;
-			link_[idx].task_  = nullptr;
-			link_[idx].cgi_   = false;
-
+			set_link_entry_(idx, path, title, file, nullptr, false);
 			return true;
 		}
 
 
 		//-----------------------------------------------------------------//
 		/*!
-			@brief  ファイル送信
-			@param[in]	path	ファイル・パス
-			@return 成功なら「true」
-		*/
-		//-----------------------------------------------------------------//
-		bool send_file(const char* path)
-		{
-			FILE* fp = fopen(path, "rb");
-			if(fp == nullptr) {
-				return false;
-			}
-			uint32_t fsz = sdc_.size(path);
-
-			http_format::chaout().clear();
-			http_format("HTTP/1.1 200 OK\n");
-			http_format("Content-Type: ");
-			const char* ext = strrchr(path, '.');
-			if(ext != nullptr) {
-				++ext;
-				if(strcmp(ext, "png") == 0 || strcmp(ext, "jpeg") == 0 || strcmp(ext, "jpg") == 0) {
-					http_format("image/%s\n") % ext;
-				} else {
-					http_format("text/%s\n") % ext;
-				}
-			} else {
-				http_format("text/plain\n");
-			}
-			http_format("Content-Length: %u\n") % fsz;
-			http_format("Connection: close\n\n");
-			http_format::chaout().flush();				
-			uint8_t tmp[512];
-			uint32_t total = 0;
-			uint32_t len;
-			while((len = fread(tmp, 1, sizeof(tmp), fp)) == sizeof(tmp)) {
-				eth_.at_tcp().send(desc_, tmp, sizeof(tmp));
-				total += len;
-			}
-			if(len > 0) {
-				eth_.at_tcp().send(desc_, tmp, len);
-				total += len;
-			}
-			fclose(fp);
-		}
-
-
-		//-----------------------------------------------------------------//
-		/*!
-			@brief  サービス
+			@brief  サービス（１０ｍｓ毎に呼ぶ）
 			@param[in]	http_port	HTTP ポート番号（通常８０番）
 		*/
 		//-----------------------------------------------------------------//
 		void service(uint16_t http_port = 80)
 		{
-			auto& ipv4 = eth_.at_ipv4();
-			auto& tcp  = ipv4.at_tcp();
-
-			switch(task_) {
-
-			case task::begin_http:
-				{
-					ip_adrs adrs;
-					bool err = false;
-					if(tcp.open(send_buff_, sizeof(send_buff_),
-						recv_buff_, sizeof(recv_buff_), desc_)) {
-						if(tcp.start(desc_, adrs, http_port, true)) {
-							debug_format("HTTP Server Start: '%s' port(%d), desc(%d)\n")
-								% eth_.at_info().ip.c_str()
-								% static_cast<int>(http_port)
-								% desc_;
-							http_format::chaout().set_desc(desc_);
-							debug_format("HTTP Server: format capacity: %d\n")
-								% http_format::chaout().at_str().capacity();
-							task_ = task::wait_http;
-						} else {
-							tcp.close(desc_);
-							err = true;
-						}
-					} else {
-						err = true;
-					}
-					if(err) {
-						debug_format("HTTP TCP open error\n");
-						task_ = task::delay_begin;
-						delay_loop_ = 100; // 1 sec
-					}
-				}
-				break;
-
-			case task::wait_http:
-				if(tcp.connected(desc_)) {
-					debug_format("HTTP Server: New connected, form: %s\n") % tcp.get_ip(desc_).c_str();
-					++count_;
-					line_man_.clear();
-					favicon_ = false;
-					other_link_ = false;
-					disconnect_loop_ = DISCONNECT_LOOP;
-					task_ = task::main_loop;
-				}
-				break;
-
-			case task::main_loop:
-				if(tcp.connected(desc_)) {
-					char tmp[2048];  // 大きな POST データに備えた大きさ
-					int len = tcp.recv(desc_, tmp, sizeof(tmp));
-					if(len == 0) {
-						break;
-					}
-/// tmp[len] = 0;
-/// utils::format("Recv:\n%s\n") % tmp;
-					auto pos = analize_request(tmp, len);
-					if(pos > 0) {
-						if(!line_man_.empty()) {
-							char path[256];
-							path[0] = 0;
-							const char* t = line_man_[0];
-							if(strncmp(t, "GET ", 4) == 0) {
-								get_path_(t + 4, path);
-								debug_format("HTTP Server: GET '%s' (%d)\n") % path % len;
-								bool find = exec_link(path, false);
-								if(!find) {
-									debug_format("HTTP Server: can't find GET: '%s'\n") % path;
-									make_info(404, -1, false);
-									http_format::chaout().flush();
-								}
-							} else if(strncmp(t, "POST ", 5) == 0) {
-								get_path_(t + 5, path);
-								debug_format("HTTP Server: POST '%s' (%d)\n") % path % len;
-								parse_cgi(pos);
-								bool find = exec_link(path, true);
-								if(!find) {
-									debug_format("HTTP Server: can't find POST: '%s' (%d)\n") % path % len;
-									make_info(404, -1, false);
-									http_format::chaout().flush();
-								}
-							} else {
-								debug_format("HTTP Server: request fail command '%s'\n") % t;
-							}
-							line_man_.clear();
-							task_ = task::disconnect_delay;
-						} else {
-							debug_format("HTTP Server: request fail section.\n");
-						}
-					}
-				} else {
-					debug_format("HTTP Server: connection un-link (out main).\n");
-					task_ = task::disconnect_delay;
-				}
-				break;
-
-			case task::disconnect_delay:
-				{
-					auto len = tcp.get_recv_length(desc_);
-					if(len > 0) {
-						disconnect_loop_ = DISCONNECT_LOOP;
-						task_ = task::main_loop;
-					}
-				}
-				if(disconnect_loop_ > 0) {
-					--disconnect_loop_;
-				} else {
-					tcp.close(desc_);
-					task_ = task::disconnect;
-				}
-				break;
-
-			case task::delay_begin:
-				if(delay_loop_ > 0) {
-					--delay_loop_;
-				} else {
-					task_ = task::begin_http;
-				}
-				break;
-
-			case task::disconnect:
-			default:
-				debug_format("HTTP Server: disconnected\n");
-				task_ = task::begin_http;
-				break;
+			for(uint32_t i = 0; i < SLOT_NUM; ++i) {
+				service_slot_(slot_[i], http_port);
 			}
 		}
 
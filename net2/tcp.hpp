@@ -359,6 +359,20 @@ namespace net {
 		}
 
 
+		bool find_server_(uint16_t src_port, uint16_t dst_port, const ip_adrs& adrs) const noexcept
+		{
+			for(uint32_t i = 0; i < NMAX; ++i) {
+				if(!probe(i)) continue;
+				const context& ctx = common_.get_blocks().get(i);
+				if(ctx.server_ && ctx.src_port_ == src_port && ctx.dst_port_ == dst_port
+					&& ctx.adrs_ == adrs) {
+					return true;
+				}
+			}
+			return false;
+		}
+
+
 		bool recv_(context& ctx, const eth_h& eh, const ipv4_h& ih, const tcp_h* tcp)
 		{
 			// TCP サムの計算
@@ -716,12 +730,14 @@ debug_format("(EST) CMP:  SEQ: 0x%08X, ACK: 0x%08X\n")
 				return false;
 			}
 
-			// 同じポートがある場合は無効（ロック状態）
+			// 同じポートがある場合は無効（ロック状態）@n
+			// ※サーバー同士は、同じポートで複数待ち受け出来る
 			for(uint32_t i = 0; i < NMAX; ++i) {
 				if(!common_.at_blocks().is_alloc(i)) continue;
 				const context& ctx = common_.get_blocks().get(i);
 				uint16_t pp;
 				if(server) {
+					if(ctx.server_) continue;
 					pp = ctx.src_port_;
 				} else {
 					pp = ctx.dst_port_;
@@ -1040,11 +1056,17 @@ debug_format("(EST) CMP:  SEQ: 0x%08X, ACK: 0x%08X\n")
 							continue;
 						}
 					} else {
-						if(tcp->get_flag_syn()) {
-							ctx.dst_port_ = tcp->get_src_port();
-							debug_format("TCP Server First Connection dst_port(%d) desc(%d)\n")
-								% ctx.dst_port_ % i;
+						// 待ち受け中は SYN だけを受け取る（同じポートの他の接続を横取りしない）
+						if(!tcp->get_flag_syn()) {
+							continue;
+						}
+						// 接続済みのコンテキストへの再送 SYN
+						if(find_server_(tcp->get_dst_port(), tcp->get_src_port(), ih.get_src_ipa())) {
+							continue;
 						}
+						ctx.dst_port_ = tcp->get_src_port();
+						debug_format("TCP Server First Connection dst_port(%d) desc(%d)\n")
+							% ctx.dst_port_ % i;
 					}
 				} else {
 					if(ctx.src_port_ != tcp->get_dst_port()) continue;
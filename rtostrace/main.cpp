@@ -0,0 +1,484 @@
+//=====================================================================//
+/*!	@file
+	@brief	rtos_trace ダンプ・コンバーター @n
+			・utils::rtos_trace（common/rtos_trace.hpp）の記録を読み、@n
+			  Chrome Trace Event 形式の JSON（chrome://tracing、Perfetto）に変換する @n
+			・入力はバイナリ（SD に保存したもの、ストリーム）、又は「dump」の出力 @n
+			  （'#' で始まる１６進の行）@n
+			・タスク毎の実行時間、CPU 使用率、起床遅延、割り込み時間を stderr に表示
+    @author 平松邦仁 (hira@rvf-rc45.net)
+	@copyright	Copyright (C) 2021 Kunihito Hiramatsu @n
+				Released under the MIT license @n
+				https://github.com/hirakuni45/RX/blob/master/LICENSE
+*/
+//=====================================================================//
+#include <cstdio>
+#include <cstdarg>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+#include "common/rtos_trace.h"
+
+namespace {
+
+	static const char* version_ = "0.50b";
+
+	static const uint32_t INFO_SIZE  = 32;
+	static const uint32_t HEAD_SIZE  = 16;
+	static const uint32_t NAME_SIZE  = 12;
+	static const uint32_t ISR_TID    = 0x10000;	///< 割り込みのスレッド ID（+ 番号）
+	static const uint32_t KERNEL_TID = 0xFFFFF;	///< ティックなどのスレッド ID
+
+	struct task_t {
+		std::string	name;
+		uint32_t	prio = 0;
+		uint64_t	run = 0;		///< 実行時間
+		uint32_t	count = 0;		///< 切り替え回数
+		uint64_t	ready = ~0ULL;	///< レディーになった時間（~0 なら無し）
+		uint64_t	lat_sum = 0;	///< 起床遅延の合計
+		uint64_t	lat_max = 0;
+		uint32_t	lat_num = 0;
+	};
+
+	struct isr_t {
+		uint64_t	run = 0;
+		uint64_t	max = 0;
+		uint32_t	count = 0;
+	};
+
+	std::vector<uint8_t>	src_;
+
+	uint32_t	block_size_;
+	uint32_t	freq_;
+	uint32_t	info_lost_;
+
+	std::map<uint32_t, task_t>	tasks_;
+	std::map<uint32_t, isr_t>	isrs_;
+
+	FILE*		out_;
+	bool		first_ = true;
+	bool		tick_ = false;
+
+	uint64_t	top_ = 0;		///< 最初のイベントの時間
+	uint64_t	end_ = 0;
+	bool		valid_ = false;
+
+	uint32_t	cur_ = 0;		///< 実行中タスク
+	uint64_t	slice_ = 0;		///< 実行開始時間
+	bool		run_ = false;
+	std::vector<std::pair<uint32_t, uint64_t>>	isr_stack_;
+
+	uint32_t	ticks_ = 0;
+	uint32_t	events_ = 0;
+	uint64_t	bytes_ = 0;
+	uint32_t	lost_ = 0;
+	uint64_t	lost_time_ = 0;	///< 欠落で状態が分からない期間
+	uint32_t	gap_ = 0;
+	uint32_t	error_ = 0;
+
+
+	uint32_t get16_(const uint8_t* p) { return p[0] | (p[1] << 8); }
+	uint32_t get32_(const uint8_t* p) { return get16_(p) | (get16_(p + 2) << 16); }
+
+
+	bool load_(const std::string& file)
+	{
+		std::ifstream ifs(file, std::ios::binary);
+		if(!ifs) return false;
+		src_.assign(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+		return true;
+	}
+
+
+	// '#' で始まる１６進の行をバイナリに
+	void from_hex_()
+	{
+		std::vector<uint8_t> out;
+		uint32_t i = 0;
+		while(i < src_.size()) {
+			auto j = i;
+			while(j < src_.size() && src_[j] != '\n') ++j;
+			if(src_[i] == '#') {
+				for(auto k = i + 1; (k + 1) < j; k += 2) {
+					if(!isxdigit(src_[k]) || !isxdigit(src_[k + 1])) break;
+					char h[3] = { static_cast<char>(src_[k]), static_cast<char>(src_[k + 1]), 0 };
+					out.push_back(std::strtoul(h, nullptr, 16));
+				}
+			}
+			i = j + 1;
+		}
+		src_.swap(out);
+	}
+
+
+	double usec_(uint64_t t)
+	{
+		return static_cast<double>(t - top_) * 1e6 / static_cast<double>(freq_);
+	}
+
+
+	std::string json_str_(const std::string& s)
+	{
+		std::string o;
+		for(auto ch : s) {
+			if(ch == '"' || ch == '\\') o += '\\';
+			if(static_cast<uint8_t>(ch) < 0x20) continue;
+			o += ch;
+		}
+		return o;
+	}
+
+
+	void emit_(const char* form, ...) __attribute__((format(printf, 1, 2)));
+	void emit_(const char* form, ...)
+	{
+		fputs(first_ ? "\n" : ",\n", out_);
+		first_ = false;
+		va_list ap;
+		va_start(ap, form);
+		vfprintf(out_, form, ap);
+		va_end(ap);
+	}
+
+
+	const std::string task_name_(uint32_t id)
+	{
+		auto it = tasks_.find(id);
+		if(it != tasks_.end() && !it->second.name.empty()) return it->second.name;
+		return "Task" + std::to_string(id);
+	}
+
+
+	void slice_end_(uint64_t t)
+	{
+		if(!run_) return;
+		auto& tk = tasks_[cur_];
+		tk.run += t - slice_;
+		++tk.count;
+		emit_("{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+			json_str_(task_name_(cur_)).c_str(), cur_, usec_(slice_), usec_(t) - usec_(slice_));
+		run_ = false;
+	}
+
+
+	void instant_(uint32_t tid, const char* name, uint64_t t, const std::string& args = "")
+	{
+		emit_("{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"t\",\"pid\":1,\"tid\":%u,\"ts\":%.3f%s%s%s}",
+			name, tid, usec_(t), args.empty() ? "" : ",\"args\":{", args.c_str(), args.empty() ? "" : "}");
+	}
+
+
+	uint32_t leb_(const uint8_t*& p, const uint8_t* end)
+	{
+		uint32_t v = 0;
+		uint32_t sh = 0;
+		while(p < end) {
+			auto c = *p++;
+			v |= static_cast<uint32_t>(c & 0x7f) << sh;
+			if((c & 0x80) == 0) return v;
+			sh += 7;
+		}
+		++error_;
+		return v;
+	}
+
+
+	uint32_t nargs_(uint32_t ev)
+	{
+		switch(ev) {
+		case RTOS_TRACE_EV_DELAY:
+		case RTOS_TRACE_EV_NOTIFY:
+		case RTOS_TRACE_EV_TICK:
+		case RTOS_TRACE_EV_ISR_EXIT:
+			return 0;
+		case RTOS_TRACE_EV_CREATE:
+		case RTOS_TRACE_EV_USER:
+			return 2;
+		default:
+			return 1;
+		}
+	}
+
+
+	void event_(uint32_t ev, uint64_t t, uint32_t a, uint32_t b, const std::string& name)
+	{
+		char tmp[64];
+		end_ = t;
+		switch(ev) {
+		case RTOS_TRACE_EV_SWITCH_IN:
+			slice_end_(t);
+			{
+				auto& tk = tasks_[a];
+				if(tk.ready != ~0ULL) {
+					auto lat = t - tk.ready;
+					tk.lat_sum += lat;
+					tk.lat_max = std::max(tk.lat_max, lat);
+					++tk.lat_num;
+					tk.ready = ~0ULL;
+				}
+			}
+			cur_ = a;
+			slice_ = t;
+			run_ = true;
+			break;
+		case RTOS_TRACE_EV_READY:
+			if(a != cur_ || !run_) {
+				auto& tk = tasks_[a];
+				if(tk.ready == ~0ULL) tk.ready = t;
+			}
+			instant_(a, "ready", t);
+			break;
+		case RTOS_TRACE_EV_DELAY:
+			instant_(cur_, "delay", t);
+			break;
+		case RTOS_TRACE_EV_QUEUE_RECV:
+		case RTOS_TRACE_EV_QUEUE_SEND:
+			snprintf(tmp, sizeof(tmp), "\"queue\":\"0x%08X\"", a);
+			instant_(cur_, ev == RTOS_TRACE_EV_QUEUE_RECV ? "queue recv" : "queue send", t, tmp);
+			break;
+		case RTOS_TRACE_EV_NOTIFY:
+			instant_(cur_, "notify wait", t);
+			break;
+		case RTOS_TRACE_EV_TICK:
+			++ticks_;
+			if(tick_) instant_(KERNEL_TID, "tick", t);
+			break;
+		case RTOS_TRACE_EV_ISR_ENTER:
+			isr_stack_.emplace_back(a, t);
+			break;
+		case RTOS_TRACE_EV_ISR_EXIT:
+			if(isr_stack_.empty()) break;  // ブロックの途中から
+			{
+				auto n = isr_stack_.back().first;
+				auto s = isr_stack_.back().second;
+				isr_stack_.pop_back();
+				auto& is = isrs_[n];
+				is.run += t - s;
+				is.max = std::max(is.max, t - s);
+				++is.count;
+				emit_("{\"name\":\"ISR %u\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+					n, ISR_TID + n, usec_(s), usec_(t) - usec_(s));
+			}
+			break;
+		case RTOS_TRACE_EV_CREATE:
+			tasks_[a].prio = b;
+			if(!name.empty()) tasks_[a].name = name;
+			snprintf(tmp, sizeof(tmp), "\"prio\":%u", b);
+			instant_(a, "create", t, tmp);
+			break;
+		case RTOS_TRACE_EV_DELETE:
+			if(run_ && cur_ == a) slice_end_(t);
+			instant_(a, "delete", t);
+			break;
+		case RTOS_TRACE_EV_LOST:
+			lost_ += a;
+			snprintf(tmp, sizeof(tmp), "\"events\":%u", a);
+			instant_(KERNEL_TID, "lost", t, tmp);
+			break;
+		case RTOS_TRACE_EV_USER:
+			emit_("{\"name\":\"user %u\",\"ph\":\"C\",\"pid\":1,\"ts\":%.3f,\"args\":{\"value\":%u}}",
+				a, usec_(t), b);
+			break;
+		default:
+			break;
+		}
+	}
+
+
+	void block_(const uint8_t* blk, bool cont)
+	{
+		auto len = get16_(blk + 4);
+		auto task = get16_(blk + 6);
+		uint64_t t = get32_(blk + 8) | (static_cast<uint64_t>(get32_(blk + 12)) << 32);
+		if(len < HEAD_SIZE || len > block_size_) {
+			++error_;
+			return;
+		}
+		const uint8_t* p = blk + HEAD_SIZE;
+		const uint8_t* e = blk + len;
+		if(!valid_) {
+			top_ = t;
+			end_ = t;
+			valid_ = true;
+		} else if(p < e && *p == RTOS_TRACE_EV_LOST) {
+			cont = false;
+		}
+		if(!cont) {  // 不連続（上書き、欠落）なら、ブロックの状態から始める
+			slice_end_(end_);
+			if(t > end_) lost_time_ += t - end_;
+			isr_stack_.clear();
+			for(auto& tk : tasks_) tk.second.ready = ~0ULL;
+			cur_ = task;
+			slice_ = t;
+			run_ = task != 0;
+		}
+		bytes_ += e - p;
+		while(p < e) {
+			++events_;
+			auto ev = *p++;
+			t += leb_(p, e);
+			uint32_t a = 0;
+			uint32_t b = 0;
+			auto n = nargs_(ev);
+			if(n >= 1) a = leb_(p, e);
+			if(n >= 2) b = leb_(p, e);
+			std::string name;
+			if(ev == RTOS_TRACE_EV_CREATE && p < e) {
+				uint32_t l = *p++;
+				l = std::min(l, static_cast<uint32_t>(e - p));
+				name.assign(reinterpret_cast<const char*>(p), l);
+				p += l;
+			}
+			event_(ev, t, a, b, name);
+		}
+	}
+
+
+	void help_(const char* cmd)
+	{
+		std::string s = cmd;
+		auto p = s.find_last_of("/\\");
+		if(p != std::string::npos) s = s.substr(p + 1);
+		printf("rtos_trace dump converter Version %s\n", version_);
+		printf("usage:\n");
+		printf("    %s [options] dump-file [output.json]\n", s.c_str());
+		printf("    dump-file: binary, or output of 'dump' ('#' hex lines)\n");
+		printf("    -tick      output system tick events\n");
+	}
+}
+
+
+int main(int argc, char* argv[])
+{
+	std::vector<std::string> files;
+	for(int i = 1; i < argc; ++i) {
+		std::string s = argv[i];
+		if(s == "-tick") tick_ = true;
+		else if(s[0] == '-') {
+			help_(argv[0]);
+			return 1;
+		} else files.push_back(s);
+	}
+	if(files.empty() || files.size() > 2) {
+		help_(argv[0]);
+		return 1;
+	}
+
+	if(!load_(files[0])) {
+		std::cerr << "Can't open dump file: '" << files[0] << "'" << std::endl;
+		return 1;
+	}
+	if(src_.size() < 4 || std::memcmp(&src_[0], "RTTR", 4) != 0) {
+		from_hex_();
+	}
+	if(src_.size() < INFO_SIZE || std::memcmp(&src_[0], "RTTR", 4) != 0) {
+		std::cerr << "Not rtos_trace dump: '" << files[0] << "'" << std::endl;
+		return 1;
+	}
+
+	block_size_ = get16_(&src_[6]);
+	freq_ = get32_(&src_[8]);
+	auto blocks = get32_(&src_[12]);
+	info_lost_ = get32_(&src_[16]);
+	auto task_num = get16_(&src_[20]);
+	auto entry = get16_(&src_[22]);
+	if(block_size_ < INFO_SIZE || freq_ == 0 || src_.size() < block_size_
+		|| (INFO_SIZE + task_num * entry) > block_size_) {
+		std::cerr << "Broken header" << std::endl;
+		return 1;
+	}
+	for(uint32_t i = 0; i < task_num; ++i) {
+		const uint8_t* p = &src_[INFO_SIZE + i * entry];
+		auto& tk = tasks_[get16_(p)];
+		tk.prio = p[2];
+		tk.name.assign(reinterpret_cast<const char*>(p + 4), strnlen(reinterpret_cast<const char*>(p + 4), NAME_SIZE));
+	}
+
+	// 通番順に並べる（リングのダンプは古い順だが、念の為）
+	std::vector<const uint8_t*> list;
+	uint32_t n = (src_.size() / block_size_) - 1;
+	if(blocks != 0 && blocks < n) n = blocks;
+	for(uint32_t i = 0; i < n; ++i) {
+		list.push_back(&src_[(i + 1) * block_size_]);
+	}
+	std::stable_sort(list.begin(), list.end(), [](const uint8_t* a, const uint8_t* b) {
+		return get32_(a) < get32_(b);
+	});
+
+	if(files.size() >= 2) {
+		out_ = fopen(files[1].c_str(), "wb");
+		if(out_ == nullptr) {
+			std::cerr << "Can't open output: '" << files[1] << "'" << std::endl;
+			return 1;
+		}
+	} else {
+		out_ = stdout;
+	}
+
+	fputs("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[", out_);
+	emit_("{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"FreeRTOS\"}}");
+	uint32_t seq = 0;
+	for(uint32_t i = 0; i < list.size(); ++i) {
+		auto s = get32_(list[i]);
+		bool cont = i > 0 && s == (seq + 1);
+		if(i > 0 && !cont) ++gap_;
+		block_(list[i], cont);
+		seq = s;
+	}
+	slice_end_(end_);
+
+	for(const auto& t : tasks_) {
+		emit_("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+			t.first, json_str_(task_name_(t.first)).c_str());
+		emit_("{\"name\":\"thread_sort_index\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"sort_index\":%u}}",
+			t.first, 100 - t.second.prio);
+	}
+	for(const auto& t : isrs_) {
+		emit_("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"ISR %u\"}}",
+			ISR_TID + t.first, t.first);
+	}
+	if(tick_ || lost_ > 0) {
+		emit_("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"Kernel\"}}",
+			KERNEL_TID);
+	}
+	fputs("\n]}\n", out_);
+	if(out_ != stdout) fclose(out_);
+
+	// 統計
+	double all = usec_(end_) - static_cast<double>(lost_time_) * 1e6 / freq_;
+	fprintf(stderr, "Blocks: %u, Events: %u (%.2f bytes/event), Time: %.3f [ms], Freq: %u [Hz], Ticks: %u\n",
+		static_cast<uint32_t>(list.size()), events_, events_ > 0 ? static_cast<double>(bytes_) / events_ : 0.0,
+		all / 1000.0, freq_, ticks_);
+	fprintf(stderr, "%-12s %4s %12s %7s %7s %10s %10s\n",
+		"Name", "Prio", "Run [us]", "CPU", "Switch", "Lat [us]", "Max [us]");
+	for(const auto& t : tasks_) {
+		const auto& tk = t.second;
+		double run = static_cast<double>(tk.run) * 1e6 / freq_;
+		double lat = tk.lat_num > 0 ? static_cast<double>(tk.lat_sum) * 1e6 / freq_ / tk.lat_num : 0.0;
+		fprintf(stderr, "%-12s %4u %12.1f %6.2f%% %7u %10.2f %10.2f\n",
+			task_name_(t.first).c_str(), tk.prio, run, all > 0.0 ? run * 100.0 / all : 0.0,
+			tk.count, lat, static_cast<double>(tk.lat_max) * 1e6 / freq_);
+	}
+	for(const auto& t : isrs_) {
+		const auto& is = t.second;
+		double run = static_cast<double>(is.run) * 1e6 / freq_;
+		fprintf(stderr, "ISR %-8u %4s %12.1f %6.2f%% %7u %10.2f %10.2f\n",
+			t.first, "", run, all > 0.0 ? run * 100.0 / all : 0.0, is.count,
+			is.count > 0 ? run / is.count : 0.0, static_cast<double>(is.max) * 1e6 / freq_);
+	}
+	if(lost_ > 0 || info_lost_ > 0 || gap_ > 0) {
+		fprintf(stderr, "Lost events: %u (total %u), block gaps: %u, unknown: %.3f [ms]\n",
+			lost_, info_lost_, gap_, static_cast<double>(lost_time_) * 1e3 / freq_);
+	}
+	if(error_ > 0) {
+		std::cerr << "Broken event: " << error_ << std::endl;
+	}
+	return 0;
+}
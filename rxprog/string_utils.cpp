@@ -383,7 +383,9 @@ namespace utils {
 		utf8_to_utf16(src, ws);
 		for(auto wc : ws) {
 			uint16_t ww = utf16_to_sjis(wc);
-			if(ww <= 255) {
+			if(ww == 0xffff) {
+				dst += '?';
+			} else if(ww <= 255) {
 				dst += ww;
 			} else {
 				dst += ww >> 8;
@@ -145,6 +145,19 @@ namespace sound {
 		}
 
 
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	タグ・タスクへ渡す「file_io」を取得 @n
+					※先読み（af_prefetch）から読む場合、トラックのファイルを別に開く
+			@param[in]	fin	入力
+			@return file_io の参照
+		*/
+		//-----------------------------------------------------------------//
+		static utils::file_io& tag_file(utils::file_io& fin) noexcept { return fin; }
+		template <class FIN>
+		static utils::file_io& tag_file(FIN& fin) noexcept { return fin.at_file(); }
+
+
 		//-----------------------------------------------------------------//
 		/*!
 			@brief	ステートを設定
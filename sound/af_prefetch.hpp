@@ -0,0 +1,585 @@
+#pragma once
+//=====================================================================//
+/*!	@file
+	@brief	オーディオ・ファイル先読みリング・バッファ @n
+			・I/O タスクが圧縮データをリング・バッファへ先読みする（次のトラックも含む）@n
+			・デコード・タスクは「utils::file_io」と同じ形のインターフェースで読み出す @n
+			・デコード側が保持領域外へシークした場合、I/O 側でファイルを読み直す @n
+			※ I/O 側（push, service）とデコード側（open, read, seek, close, flush）は、@n
+			それぞれ一つのタスクから呼ぶ事 @n
+			※ RTOS 無しの場合、デコード側の待ちで「service」を直接呼ぶ
+    @author 平松邦仁 (hira@rvf-rc45.net)
+	@copyright	Copyright (C) 2021 Kunihito Hiramatsu @n
+				Released under the MIT license @n
+				https://github.com/hirakuni45/RX/blob/master/LICENSE
+*/
+//=====================================================================//
+#include <cstring>
+#include "common/file_io.hpp"
+
+namespace sound {
+
+	//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+	/*!
+		@brief	オーディオ・ファイル先読みクラス
+		@param[in]	SIZE	リング・バッファのサイズ（２のべき乗）
+		@param[in]	TNUM	キューに積めるトラック数
+		@param[in]	UNIT	一回の読み込み単位（ファイル位置をこの単位に揃える）
+	*/
+	//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+	template <uint32_t SIZE, uint32_t TNUM = 4, uint32_t UNIT = 4096>
+	class af_prefetch {
+
+		static_assert((SIZE & (SIZE - 1)) == 0, "SIZE must be power of 2");
+		static_assert((UNIT & (UNIT - 1)) == 0, "UNIT must be power of 2");
+		static_assert(SIZE >= (UNIT * 4), "SIZE must be at least 4 UNIT");
+
+	public:
+		static const uint32_t NAME_SIZE = 256;	///< トラック名の最大長
+		static const uint32_t TAIL_SIZE = 128;	///< 終端保持サイズ（ID3v1 タグ）
+		static const uint32_t HIST_SIZE = 4096;	///< 読み出し済みデータの保持サイズ（後方シーク用）
+
+	private:
+		enum class TSTATE : uint8_t {
+			PENDING,	///< 読み込み待ち
+			FETCH,		///< 読み込み中
+			DONE,		///< 読み込み完了
+			ERROR,		///< オープン失敗
+		};
+
+		struct track_t {
+			char				name[NAME_SIZE];
+			volatile TSTATE		state;
+			volatile bool		cancel;
+			uint32_t			size;		///< ファイル・サイズ
+			uint32_t			top;		///< ファイル先頭に相当するリング位置
+			uint32_t			tail_len;
+			uint8_t				tail[TAIL_SIZE];
+		};
+
+		track_t				track_[TNUM];
+		volatile uint32_t	tput_;		///< 次に積むトラック（I/O 側）
+		volatile uint32_t	tget_;		///< デコード側のトラック
+		uint32_t			tfetch_;	///< 読み込み中のトラック（I/O 側）
+
+		uint8_t				ring_[SIZE];
+		volatile uint32_t	wpos_;		///< 書き込み位置（I/O 側）
+		volatile uint32_t	rel_;		///< 解放位置（デコード側）
+		uint32_t			rpos_;		///< 読み出し位置（デコード側）
+
+		utils::file_io		fin_;		///< I/O 側のファイル
+		utils::file_io		tag_fin_;	///< デコード側のファイル（タグ用）
+
+		volatile bool		seek_req_;
+		volatile uint32_t	seek_ofs_;
+		volatile bool		flush_req_;
+
+		bool				open_;
+		bool				error_;
+
+		uint32_t			underrun_;
+		uint32_t			fetch_count_;
+		uint32_t			reopen_count_;
+
+		track_t& at_get_() noexcept { return track_[tget_ % TNUM]; }
+		const track_t& get_get_() const noexcept { return track_[tget_ % TNUM]; }
+
+		static int32_t diff_(uint32_t a, uint32_t b) noexcept { return static_cast<int32_t>(a - b); }
+
+		void wait_() noexcept
+		{
+#ifdef RTOS
+			vTaskDelay(1);
+#else
+			service();
+#endif
+		}
+
+
+		bool open_track_(track_t& t, uint32_t ofs) noexcept
+		{
+			if(!fin_.open(t.name, "rb")) {
+				return false;
+			}
+			t.size = fin_.get_file_size();
+			if(ofs == 0) {  // ID3v1 等、終端のタグは先に読んでおく
+				t.tail_len = 0;
+				if(t.size >= (TAIL_SIZE * 2) && fin_.seek(utils::file_io::SEEK::END, TAIL_SIZE)) {
+					t.tail_len = fin_.read(t.tail, TAIL_SIZE);
+				}
+			}
+			fin_.seek(utils::file_io::SEEK::SET, ofs);
+			t.top = wpos_ - ofs;
+			return true;
+		}
+
+
+		void finish_fetch_(track_t& t) noexcept
+		{
+			fin_.close();
+			t.state = TSTATE::DONE;
+			++tfetch_;
+		}
+
+
+		void reopen_() noexcept
+		{
+			fin_.close();
+			// 後続のトラックは読み直す
+			for(uint32_t i = tget_ + 1; i != tput_; ++i) {
+				track_[i % TNUM].state = TSTATE::PENDING;
+			}
+			tfetch_ = tget_;
+			auto& t = at_get_();
+			wpos_ = rel_;
+			if(open_track_(t, seek_ofs_)) {
+				t.state = TSTATE::FETCH;
+			} else {
+				t.size = seek_ofs_;
+				t.top = wpos_ - seek_ofs_;
+				finish_fetch_(t);
+			}
+			++reopen_count_;
+		}
+
+	public:
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	コンストラクター
+		*/
+		//-----------------------------------------------------------------//
+		af_prefetch() noexcept : track_{ }, tput_(0), tget_(0), tfetch_(0),
+			ring_{ }, wpos_(0), rel_(0), rpos_(0), fin_(), tag_fin_(),
+			seek_req_(false), seek_ofs_(0), flush_req_(false),
+			open_(false), error_(false),
+			underrun_(0), fetch_count_(0), reopen_count_(0)
+		{ }
+
+
+		//=================================================================//
+		// I/O 側
+		//=================================================================//
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	トラックをキューに積む（I/O 側）
+			@param[in]	name	ファイル名
+			@return キューが一杯なら「false」
+		*/
+		//-----------------------------------------------------------------//
+		bool push(const char* name) noexcept
+		{
+			if(name == nullptr || (tput_ - tget_) >= TNUM) return false;
+
+			auto& t = track_[tput_ % TNUM];
+			std::strncpy(t.name, name, NAME_SIZE - 1);
+			t.name[NAME_SIZE - 1] = 0;
+			t.cancel = false;
+			t.size = 0;
+			t.tail_len = 0;
+			t.state = TSTATE::PENDING;
+			++tput_;
+			return true;
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	サービス（I/O 側）@n
+					一回の呼び出しで、最大「UNIT」バイトを読み込む
+			@return 何も処理が無ければ「false」
+		*/
+		//-----------------------------------------------------------------//
+		bool service() noexcept
+		{
+			if(flush_req_) {
+				fin_.close();
+				tfetch_ = tput_;
+				tget_ = tput_;
+				rel_ = wpos_;
+				flush_req_ = false;
+				return true;
+			}
+
+			if(seek_req_) {
+				reopen_();
+				seek_req_ = false;
+				return true;
+			}
+
+			if(tfetch_ == tput_) return false;
+
+			auto& t = track_[tfetch_ % TNUM];
+			if(!fin_.is_open()) {
+				if(!open_track_(t, 0)) {
+					t.size = 0;
+					t.top = wpos_;
+					t.state = TSTATE::ERROR;
+					++tfetch_;
+					return true;
+				}
+				t.state = TSTATE::FETCH;
+			}
+
+			if(t.cancel) {  // デコード側が途中でクローズした
+				t.size = wpos_ - t.top;
+				finish_fetch_(t);
+				return true;
+			}
+
+			uint32_t fpos = wpos_ - t.top;
+			if(fpos >= t.size) {
+				finish_fetch_(t);
+				return true;
+			}
+
+			uint32_t free = SIZE - (wpos_ - rel_);
+			uint32_t len = UNIT - (fpos & (UNIT - 1));
+			if(free < len) return false;
+			uint32_t ptr = wpos_ & (SIZE - 1);
+			if(len > (SIZE - ptr)) len = SIZE - ptr;
+			if(len > (t.size - fpos)) len = t.size - fpos;
+
+			auto n = fin_.read(&ring_[ptr], len);
+			++fetch_count_;
+			wpos_ = wpos_ + n;
+			if(n < len || fin_.get_error()) {
+				t.size = wpos_ - t.top;
+				finish_fetch_(t);
+			} else if((fpos + n) >= t.size) {
+				finish_fetch_(t);
+			}
+			return true;
+		}
+
+
+		//=================================================================//
+		// デコード側（utils::file_io 互換）
+		//=================================================================//
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	次のトラックを開く（デコード側）
+			@return キューが空、又は、オープン失敗なら「false」
+		*/
+		//-----------------------------------------------------------------//
+		bool open() noexcept
+		{
+			if(open_) close();
+			if(tget_ == tput_) return false;
+
+			while(at_get_().state == TSTATE::PENDING) {
+				wait_();
+				if(tget_ == tput_) return false;  // flush された
+			}
+			auto& t = at_get_();
+			if(t.state == TSTATE::ERROR) {
+				++tget_;
+				return false;
+			}
+			rpos_ = t.top;
+			error_ = false;
+			open_ = true;
+			return true;
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	トラックを閉じる（デコード側）@n
+					読み残したデータは捨てて、次のトラックへ進む
+		*/
+		//-----------------------------------------------------------------//
+		void close() noexcept
+		{
+			tag_fin_.close();
+			if(!open_) return;
+
+			auto& t = at_get_();
+			if(t.state == TSTATE::FETCH) {
+				t.cancel = true;
+				while(t.state == TSTATE::FETCH) {
+					wait_();
+				}
+			}
+			rel_ = t.top + t.size;
+			rpos_ = rel_;
+			++tget_;
+			open_ = false;
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	全てのトラックを破棄（デコード側）
+		*/
+		//-----------------------------------------------------------------//
+		void flush() noexcept
+		{
+			tag_fin_.close();
+			flush_req_ = true;
+			while(flush_req_) {
+				wait_();
+			}
+			rpos_ = rel_;
+			open_ = false;
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	オープンしているか
+			@return オープンしていれば「true」
+		*/
+		//-----------------------------------------------------------------//
+		bool is_open() const noexcept { return open_; }
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	読み出し（デコード側）@n
+					データが無い場合は、I/O 側の読み込みを待つ
+			@param[in]	dst	読み出し先
+			@param[in]	len	読み出しサイズ
+			@return 読み出したサイズ
+		*/
+		//-----------------------------------------------------------------//
+		uint32_t read(void* dst, uint32_t len) noexcept
+		{
+			if(!open_) return 0;
+
+			auto& t = at_get_();
+			uint8_t* out = static_cast<uint8_t*>(dst);
+			uint32_t ofs = rpos_ - t.top;
+			if(ofs >= t.size) return 0;
+			if(len > (t.size - ofs)) len = t.size - ofs;
+
+			bool wait = false;
+			uint32_t cnt = 0;
+			while(cnt < len) {
+				if((rpos_ - t.top) >= t.size) break;  // 読み込みエラーで縮んだ
+				auto w = wpos_;
+				if(diff_(w, rpos_) > 0) {
+					uint32_t n = w - rpos_;
+					uint32_t ptr = rpos_ & (SIZE - 1);
+					if(n > (SIZE - ptr)) n = SIZE - ptr;
+					if(n > (len - cnt)) n = len - cnt;
+					std::memcpy(&out[cnt], &ring_[ptr], n);
+					rpos_ += n;
+					cnt += n;
+				} else if(t.tail_len > 0 && (rpos_ - t.top) >= (t.size - t.tail_len)) {
+					uint32_t tp = (rpos_ - t.top) - (t.size - t.tail_len);
+					uint32_t n = t.tail_len - tp;
+					if(n > (len - cnt)) n = len - cnt;
+					std::memcpy(&out[cnt], &t.tail[tp], n);
+					rpos_ += n;
+					cnt += n;
+				} else if(t.state != TSTATE::FETCH && diff_(wpos_, rpos_) <= 0) {  // 読み込みが途中で終了した
+					error_ = true;
+					break;
+				} else {
+					if(!wait) {
+						++underrun_;
+						wait = true;
+					}
+					wait_();
+				}
+			}
+
+			// 後方シーク用に少しだけ残して解放
+			if(diff_(wpos_, rpos_) >= 0 && diff_(rpos_, rel_) > static_cast<int32_t>(HIST_SIZE)) {
+				rel_ = rpos_ - HIST_SIZE;
+			}
+			return cnt;
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	シーク（デコード側、fseek 準拠）@n
+					保持範囲外の場合、I/O 側でファイルを読み直す
+			@param[in]	seek	シーク形式
+			@param[in]	ofs		オフセット
+			@return 成功なら「true」
+		*/
+		//-----------------------------------------------------------------//
+		bool seek(utils::file_io::SEEK seek, uint32_t ofs) noexcept
+		{
+			if(!open_) return false;
+
+			auto& t = at_get_();
+			uint32_t pos;
+			switch(seek) {
+			case utils::file_io::SEEK::SET:
+				pos = ofs;
+				break;
+			case utils::file_io::SEEK::CUR:
+				pos = (rpos_ - t.top) + ofs;
+				break;
+			case utils::file_io::SEEK::END:
+				pos = t.size - ofs;
+				break;
+			default:
+				return false;
+			}
+			if(pos > t.size) {
+				error_ = true;
+				return false;
+			}
+
+			uint32_t abs = t.top + pos;
+			if(diff_(abs, rel_) >= 0 && diff_(wpos_, abs) >= 0) {
+				rpos_ = abs;
+			} else if(t.tail_len > 0 && pos >= (t.size - t.tail_len)) {
+				rpos_ = abs;
+			} else if(t.state == TSTATE::FETCH && diff_(abs, wpos_) > 0
+				&& (abs - rel_) <= (SIZE - UNIT)) {  // 近い前方は、読み込みを待つ
+				rpos_ = abs;
+			} else {
+				seek_ofs_ = pos;
+				seek_req_ = true;
+				while(seek_req_) {
+					wait_();
+				}
+				rpos_ = at_get_().top + pos;
+			}
+			return true;
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	ファイル位置を返す（デコード側）
+			@return ファイル位置
+		*/
+		//-----------------------------------------------------------------//
+		uint32_t tell() const noexcept
+		{
+			if(!open_) return 0;
+			return rpos_ - get_get_().top;
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	ファイルの終端か検査（デコード側）
+			@return ファイルの終端なら「true」
+		*/
+		//-----------------------------------------------------------------//
+		bool eof() const noexcept
+		{
+			if(!open_) return false;
+			return tell() >= get_get_().size;
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	エラーの取得（デコード側）
+			@return エラーなら「true」
+		*/
+		//-----------------------------------------------------------------//
+		bool get_error() const noexcept { return error_; }
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	ファイルサイズを返す（デコード側）
+			@return ファイルサイズ
+		*/
+		//-----------------------------------------------------------------//
+		uint32_t get_file_size() const noexcept
+		{
+			if(!open_) return 0;
+			return get_get_().size;
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	トラック名を返す（デコード側）
+			@return トラック名
+		*/
+		//-----------------------------------------------------------------//
+		const char* get_name() const noexcept { return get_get_().name; }
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	トラックの「file_io」を返す（デコード側）@n
+					タグ・タスク（アルバム画像等）の為、必要になった時に開く
+			@return file_io の参照
+		*/
+		//-----------------------------------------------------------------//
+		utils::file_io& at_file() noexcept
+		{
+			if(open_ && !tag_fin_.is_open()) {
+				tag_fin_.open(get_name(), "rb");
+			}
+			return tag_fin_;
+		}
+
+
+		//=================================================================//
+		// 状態
+		//=================================================================//
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	リング・バッファのサイズを返す
+			@return リング・バッファのサイズ
+		*/
+		//-----------------------------------------------------------------//
+		static uint32_t get_size() noexcept { return SIZE; }
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	先読み済みのバイト数を返す（次のトラック分も含む）
+			@return 先読み済みのバイト数
+		*/
+		//-----------------------------------------------------------------//
+		uint32_t get_level() const noexcept
+		{
+			auto n = diff_(wpos_, rpos_);
+			return n > 0 ? n : 0;
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	キューにあるトラック数を返す（デコード中のトラックを含む）
+			@return トラック数
+		*/
+		//-----------------------------------------------------------------//
+		uint32_t get_track_num() const noexcept { return tput_ - tget_; }
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	アンダーラン回数を返す @n
+					デコード側が I/O 側の読み込みを待った回数
+			@return アンダーラン回数
+		*/
+		//-----------------------------------------------------------------//
+		uint32_t get_underrun() const noexcept { return underrun_; }
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	ファイル読み込み回数を返す
+			@return ファイル読み込み回数
+		*/
+		//-----------------------------------------------------------------//
+		uint32_t get_fetch_count() const noexcept { return fetch_count_; }
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	読み直し回数を返す（保持範囲外へのシーク）
+			@return 読み直し回数
+		*/
+		//-----------------------------------------------------------------//
+		uint32_t get_reopen_count() const noexcept { return reopen_count_; }
+	};
+}
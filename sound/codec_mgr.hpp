@@ -4,7 +4,10 @@
 	@brief	オーディオ・コーデック・マネージャー @n
 			複数のオーディオ・コーデックを扱う。@n
 			・wav（wav_in.hpp）@n
-			・mp3（mp3_in.hpp）
+			・mp3（mp3_in.hpp）@n
+			「service」はファイルを開いて、デコードが終わるまで戻らない（同期再生）。@n
+			「io_service」と「decode_service」を別のタスクで回すと、af_prefetch を介した @n
+			パイプライン再生となり、次の曲を先読みして曲間を空けずに再生する。
     @author 平松邦仁 (hira@rvf-rc45.net)
 	@copyright	Copyright (C) 2020 Kunihito Hiramatsu @n
 				Released under the MIT license @n
@@ -132,26 +135,30 @@ namespace sound {
 		};
 		loop_t		loop_t_;
 
-		bool		stop_;
+		volatile bool	stop_;
+		volatile bool	cancel_;
+		volatile bool	play_req_;
+		char		start_[FF_MAX_LFN + 1];
 
 		CODEC		codec_;
 
 
-		bool play_wav_(const char* fname) noexcept
+		af_play::CTRL ctrl_() noexcept
 		{
-			utils::file_io fin;
-			if(!fin.open(fname, "rb")) {
-				return false;
+			if(cancel_) return af_play::CTRL::STOP;
+			auto c = list_ctrl_.ctrl();
+			if(c == af_play::CTRL::STOP) {
+				stop_ = true;
 			}
+			return c;
+		}
+
+
+		template <class FIN>
+		bool decode_wav_(FIN& fin, const char* fname) noexcept
+		{
 			codec_ = CODEC::WAV;
-			wav_in_.set_ctrl_task([=]() {
-					auto c = list_ctrl_.ctrl();
-					if(c == sound::af_play::CTRL::STOP) {
-						dlist_.stop();
-						stop_ = true;
-					}
-					return c;
-				} );
+			wav_in_.set_ctrl_task([=]() { return ctrl_(); } );
 			wav_in_.set_tag_task([=](utils::file_io& fin, const sound::tag_t& tag) {
 				list_ctrl_.tag(fin, tag); }
 			);
@@ -160,43 +167,52 @@ namespace sound {
 			if(wav_in_.info(fin, info_)) {
 				wav_in_.set_update_task([=](uint32_t t) { list_ctrl_.update(t); });
 				list_ctrl_.start(fname);
-				stop_ = false;
 				ret = wav_in_.decode(fin, sound_out_);
 			}
 			list_ctrl_.close();
-			fin.close();
 			return ret;
 		}
 
 
-		bool play_mp3_(const char* fname) noexcept
+		template <class FIN>
+		bool decode_mp3_(FIN& fin, const char* fname) noexcept
 		{
-			utils::file_io fin;
-			if(!fin.open(fname, "rb")) {
-				return false;
-			}
 			codec_ = CODEC::MP3;
-			mp3_in_.set_ctrl_task([=]() {
-					auto c = list_ctrl_.ctrl();
-					if(c == sound::af_play::CTRL::STOP) {
-						dlist_.stop();
-						stop_ = true;
-					}
-					return c;
-				} );
+			mp3_in_.set_ctrl_task([=]() { return ctrl_(); } );
 			mp3_in_.set_tag_task([=](utils::file_io& fin, const sound::tag_t& tag) {
 				list_ctrl_.tag(fin, tag); }
 			);
-
 			// 情報取得
 			bool ret = false;
 			if(mp3_in_.info(fin, info_)) {
 				mp3_in_.set_update_task([=](uint32_t t) { list_ctrl_.update(t); });
 				list_ctrl_.start(fname);
-				stop_ = false;
 				ret = mp3_in_.decode(fin, sound_out_);
 			}
 			list_ctrl_.close();
+			return ret;
+		}
+
+
+		bool play_wav_(const char* fname) noexcept
+		{
+			utils::file_io fin;
+			if(!fin.open(fname, "rb")) {
+				return false;
+			}
+			auto ret = decode_wav_(fin, fname);
+			fin.close();
+			return ret;
+		}
+
+
+		bool play_mp3_(const char* fname) noexcept
+		{
+			utils::file_io fin;
+			if(!fin.open(fname, "rb")) {
+				return false;
+			}
+			auto ret = decode_mp3_(fin, fname);
 			fin.close();
 			return ret;
 		}
@@ -248,6 +264,43 @@ namespace sound {
 					if(!ret && !stop_) {
 						utils::format("Can't open audio file: '%s'\n") % name;
 					}
+					if(stop_) {
+						dlist_.stop();
+					}
+				}
+			}
+		}
+
+
+		// パイプライン再生：デコードする曲を先読みのキューに積む
+		template <class PREFETCH>
+		void queue_func_(PREFETCH& pf, const char* name, bool dir, void* option) noexcept
+		{
+			loop_t* t = static_cast<loop_t*>(option);
+			if(t->enable) {
+				if(strcmp(name, t->start) != 0) {
+					return;
+				} else {
+					t->enable = false;
+				}
+			}
+			if(dir) {
+				play_loop_(name, "");
+				return;
+			}
+			const char* ext = strrchr(name, '.');
+			if(ext == nullptr) return;
+			if(utils::str::strcmp_no_caps(ext, ".wav") != 0
+			 && utils::str::strcmp_no_caps(ext, ".mp3") != 0) {
+				return;
+			}
+			// キューが空くまで、先読みを続ける
+			while(!pf.push(name)) {
+				if(stop_ || cancel_ || play_req_) return;
+				if(!pf.service()) {
+#ifdef RTOS
+					vTaskDelay(1);
+#endif
 				}
 			}
 		}
@@ -264,34 +317,117 @@ namespace sound {
 		codec_mgr(LIST_CTRL& list_ctrl, SOUND_OUT& sound_out) noexcept :
 			list_ctrl_(list_ctrl), sound_out_(sound_out),
 			info_(), wav_in_(), mp3_in_(),
-			dlist_(), loop_t_(), stop_(false), codec_(CODEC::NONE)
+			dlist_(), loop_t_(), stop_(false), cancel_(false), play_req_(false), start_{ 0 },
+			codec_(CODEC::NONE)
 		{ }
 
 
 		//-----------------------------------------------------------------//
 		/*!
-			@brief	コーデックファイル再生
+			@brief	コーデックファイル再生 @n
+					※要求を記録し、「service」又は「io_service」で開始する
 			@param[in]	name	ファイル名
 		*/
 		//-----------------------------------------------------------------//
 		void play(const char* name) noexcept
 		{
-			play_loop_("", name);
+			strncpy(start_, name, sizeof(start_) - 1);
+			start_[sizeof(start_) - 1] = 0;
+			play_req_ = true;
 		}
 
 
 		//-----------------------------------------------------------------//
 		/*!
-			@brief	サービス
+			@brief	サービス（同期再生）
 		*/
 		//-----------------------------------------------------------------//
 		void service() noexcept
 		{
+			if(play_req_) {
+				play_req_ = false;
+				stop_ = false;
+				play_loop_("", start_);
+			}
 			dlist_.service(1, [=](const char* name, const FILINFO* fi, bool dir, void* option) {
 				play_loop_func_(name, fi, dir, option); }, true, &loop_t_);
 		}
 
 
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	I/O サービス（パイプライン再生） @n
+					ファイルを列挙して先読みのキューへ積み、圧縮データを先読みする。@n
+					※I/O タスクから呼ぶ（デコード・タスクより優先度を高くする）
+			@param[in]	pf	先読みクラス（af_prefetch）
+			@return 何も処理が無ければ「false」
+		*/
+		//-----------------------------------------------------------------//
+		template <class PREFETCH>
+		bool io_service(PREFETCH& pf) noexcept
+		{
+			if(play_req_) {
+				if(pf.get_track_num() > 0) {  // 再生中の曲を止めてから開始
+					cancel_ = true;
+					dlist_.stop();
+				} else if(!cancel_) {
+					play_req_ = false;
+					stop_ = false;
+					play_loop_("", start_);
+				}
+			}
+			if(stop_ || cancel_) {
+				dlist_.stop();
+			}
+			dlist_.service(1, [&](const char* name, const FILINFO* fi, bool dir, void* option) {
+				queue_func_(pf, name, dir, option); }, true, &loop_t_);
+			return pf.service();
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	デコード・サービス（パイプライン再生） @n
+					先読みのキューから曲を取り出してデコードする。@n
+					曲の境目で sound_out を止めないので、曲間が空かない。@n
+					※デコード・タスクから呼ぶ
+			@param[in]	pf	先読みクラス（af_prefetch）
+			@return 曲をデコードしたら「true」
+		*/
+		//-----------------------------------------------------------------//
+		template <class PREFETCH>
+		bool decode_service(PREFETCH& pf) noexcept
+		{
+			if(!pf.open()) {
+				if(cancel_ && pf.get_track_num() == 0) {
+					cancel_ = false;
+				}
+				return false;
+			}
+
+			const char* name = pf.get_name();
+			const char* ext = strrchr(name, '.');
+			bool ret = false;
+			if(ext != nullptr) {
+				if(utils::str::strcmp_no_caps(ext, ".wav") == 0) {
+					ret = decode_wav_(pf, name);
+				} else if(utils::str::strcmp_no_caps(ext, ".mp3") == 0) {
+					ret = decode_mp3_(pf, name);
+				}
+			}
+			if(!ret && !stop_ && !cancel_) {
+				utils::format("Can't decode audio file: '%s'\n") % name;
+			}
+			if(stop_ || cancel_) {
+				pf.flush();
+				cancel_ = false;
+			} else {
+				pf.close();
+			}
+			return true;
+		}
+
+
 		//-----------------------------------------------------------------//
 		/*!
 			@brief	ステートを取得
@@ -311,6 +447,16 @@ namespace sound {
 		}
 
 
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	MP3 デコーダーの参照 @n
+					※デコード統計、サブバンド・フィルター、ディザの設定
+			@return MP3 デコーダー
+		*/
+		//-----------------------------------------------------------------//
+		mp3_in& at_mp3_in() noexcept { return mp3_in_; }
+
+
 		//-----------------------------------------------------------------//
 		/*!
 			@brief	オーディオ情報を取得
@@ -42,9 +42,27 @@ namespace sound {
 		uint8_t		flag_;
 		bool		id3v1_;
 		uint32_t	size_;
+		bool		verbose_;
 
 		tag_t		tag_;
 
+	public:
+		//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+		/*!
+			@brief	ギャップレス情報（iTunSMPB）
+		*/
+		//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+		struct smpb_t {
+			uint32_t	delay;		///< エンコーダー・ディレイ（サンプル）
+			uint32_t	padding;	///< 終端のパディング（サンプル）
+			uint32_t	samples;	///< 有効サンプル数
+			bool		valid;
+			smpb_t() noexcept : delay(0), padding(0), samples(0), valid(false) { }
+		};
+
+	private:
+		smpb_t		smpb_;
+
 		static ID scan_id_(char* id) noexcept
 		{
 			if(strncmp(id, "TIT2", 4) == 0) return ID::TIT2;
@@ -70,7 +88,52 @@ namespace sound {
 		}
 
 
-		static bool get_text64_(utils::file_io& fin, char* dst, uint32_t& len) noexcept
+		// iTunSMPB: " 00000000 DDDDDDDD PPPPPPPP SSSSSSSSSSSSSSSS ..."
+		static bool parse_smpb_(const char* src, uint32_t len, smpb_t& t) noexcept
+		{
+			uint32_t val[4] = { 0 };
+			uint32_t idx = 0;
+			bool num = false;
+			for(uint32_t i = 0; i < len && src[i] != 0; ++i) {
+				char ch = src[i];
+				uint32_t d;
+				if('0' <= ch && ch <= '9') d = ch - '0';
+				else if('A' <= ch && ch <= 'F') d = ch - 'A' + 10;
+				else if('a' <= ch && ch <= 'f') d = ch - 'a' + 10;
+				else {
+					if(num) {
+						++idx;
+						if(idx >= 4) break;
+					}
+					num = false;
+					continue;
+				}
+				val[idx] = (val[idx] << 4) | d;  // 64 ビットのサンプル数は下位 32 ビットのみ
+				num = true;
+			}
+			if(num) ++idx;
+			if(idx < 4) return false;
+
+			t.delay   = val[1];
+			t.padding = val[2];
+			t.samples = val[3];
+			t.valid   = true;
+			return true;
+		}
+
+
+		// COMM: 言語（3）、説明（終端 0）、本文
+		void scan_comment_(const char* src, uint32_t len) noexcept
+		{
+			static const char key[] = "iTunSMPB";
+			if(len <= (3 + sizeof(key))) return;
+			if(strncmp(&src[3], key, sizeof(key)) != 0) return;
+			parse_smpb_(&src[3 + sizeof(key)], len - 3 - sizeof(key), smpb_);
+		}
+
+
+		template <class FIN>
+		static bool get_text64_(FIN& fin, char* dst, uint32_t& len) noexcept
 		{
 			for(int i = 0; i < 63; ++i) {
 				char ch;
@@ -83,7 +146,8 @@ namespace sound {
 		}
 
 
-		static bool skip_text_(uint8_t code, utils::file_io& fin, uint32_t& len) noexcept
+		template <class FIN>
+		static bool skip_text_(uint8_t code, FIN& fin, uint32_t& len) noexcept
 		{
 			for(int i = 0; i < 64; ++i) {
 				switch(code) {
@@ -110,7 +174,8 @@ namespace sound {
 			return false;
 		}
 
-		bool set_apic_(utils::file_io& fin, uint32_t len, bool v2_3) noexcept
+		template <class FIN>
+		bool set_apic_(FIN& fin, uint32_t len, bool v2_3) noexcept
 		{
 			uint8_t code;
 			if(fin.read(&code, 1) != 1) {
@@ -139,7 +204,7 @@ namespace sound {
 					return false;
 				}
 				len--;
-				utils::format("V2.3: '%s'\n") % tmp;
+				if(verbose_) utils::format("V2.3: '%s'\n") % tmp;
 			} else {
 				if(fin.read(tag_.at_apic().ext_, 3) != 3) {
 					return false;
@@ -149,7 +214,7 @@ namespace sound {
 					return false;
 				}
 				len--;
-				utils::format("V2.2: '%s'\n") % tag_.get_apic().ext_;
+				if(verbose_) utils::format("V2.2: '%s'\n") % tag_.get_apic().ext_;
 			}
 			auto ret = skip_text_(code, fin, len);
 			if(!ret) {
@@ -162,7 +227,8 @@ namespace sound {
 		}
 
 
-		bool set_info_(ID id, utils::file_io& fin, uint32_t len, bool v2_3) noexcept
+		template <class FIN>
+		bool set_info_(ID id, FIN& fin, uint32_t len, bool v2_3) noexcept
 		{
 			if(len == 0) {
 				// len が「０」のタグ検査
@@ -186,6 +252,7 @@ namespace sound {
 					return false;
 				}
 				tmp[len] = 0;
+				if(id == ID::COMM) scan_comment_(tmp, len);
 				utils::str::oemc_to_utf8(tmp, dst, dstlen); 
 			} else if(code == 0x01) {  // UTF-16 (with BOM)
 				uint16_t tmp[len / 2 + 1];
@@ -207,13 +274,14 @@ namespace sound {
 				tmp[len / 2] = 0;
 				utils::str::utf16_to_utf8(tmp, dst, dstlen);
 			} else if(code == 0x03) {  // UTF-8
-				if(len > dstlen) {
+				if(len >= dstlen) {
 					return false;
 				}
 				if(fin.read(dst, len) != len) {
 					return false;
 				}
 				dst[len] = 0;
+				if(id == ID::COMM) scan_comment_(dst, len);
 			} else {
 				fin.seek(utils::file_io::SEEK::CUR, len);
 				return false;
@@ -310,7 +378,8 @@ namespace sound {
 		}
 
 
-		bool parse_frame_v2_3_(utils::file_io& fin, ID& id) noexcept
+		template <class FIN>
+		bool parse_frame_v2_3_(FIN& fin, ID& id) noexcept
 		{
 			char tmp[10];
 			if(fin.read(tmp, 10) != 10) {
@@ -342,7 +411,8 @@ namespace sound {
 		}
 
 
-		bool parse_frame_v2_2_(utils::file_io& fin, ID& id) noexcept
+		template <class FIN>
+		bool parse_frame_v2_2_(FIN& fin, ID& id) noexcept
 		{
 			char tmp[6];
 			if(fin.read(tmp, 6) != 6) {
@@ -366,7 +436,8 @@ namespace sound {
 		}
 
 
-		bool parse_v1_(utils::file_io& fin) noexcept
+		template <class FIN>
+		bool parse_v1_(FIN& fin) noexcept
 		{
 			if(!fin.seek(utils::file_io::SEEK::END, 128)) {
 				return false;
@@ -400,10 +471,21 @@ namespace sound {
 			@brief	コンストラクター
 		*/
 		//-----------------------------------------------------------------//
-		id3_mgr() noexcept : org_pos_(0), ver_(0), flag_(0), id3v1_(false), size_(0), tag_()
+		id3_mgr() noexcept : org_pos_(0), ver_(0), flag_(0), id3v1_(false), size_(0),
+			verbose_(true), tag_(), smpb_()
 		{ }
 
 
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	パース情報表示の設定 @n
+					※インデックス作成など、大量のファイルを処理する場合に無効にする
+			@param[in]	ena	「false」なら表示しない
+		*/
+		//-----------------------------------------------------------------//
+		void set_verbose(bool ena = true) noexcept { verbose_ = ena; }
+
+
 		//-----------------------------------------------------------------//
 		/*!
 			@brief	ID3 タグを検出したらスキップする
@@ -411,7 +493,8 @@ namespace sound {
 			@return	成功なら「true」
 		*/
 		//-----------------------------------------------------------------//
-		bool skip_header(utils::file_io& fin) noexcept
+		template <class FIN>
+		bool skip_header(FIN& fin) noexcept
 		{
 			auto org = fin.tell();
 
@@ -445,13 +528,15 @@ namespace sound {
 			@return	成功なら「true」
 		*/
 		//-----------------------------------------------------------------//
-		bool parse(utils::file_io& fin) noexcept
+		template <class FIN>
+		bool parse(FIN& fin) noexcept
 		{
 			if(!fin.is_open()) {
 				return false;
 			}
 
 			id3v1_ = false;
+			smpb_ = smpb_t();
 
 			org_pos_ = fin.tell();
 			char tmp[10];
@@ -473,8 +558,10 @@ namespace sound {
 
 ///			utils::format("FS: %d\n") % fin.get_file_size();
 
-			utils::format("ID3v2: Ver: %04X, Flag: %02X (%d)\n")
-				% ver_ % static_cast<uint16_t>(flag_) % size_;
+			if(verbose_) {
+				utils::format("ID3v2: Ver: %04X, Flag: %02X (%d)\n")
+					% ver_ % static_cast<uint16_t>(flag_) % size_;
+			}
 
 			if(flag_ & 0b01000000) {  // EXT header
 				if(fin.read(tmp, 4) != 4) {
@@ -529,5 +616,14 @@ namespace sound {
 		*/
 		//-----------------------------------------------------------------//
 		const tag_t& get_tag() const noexcept { return tag_; }
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	ギャップレス情報（iTunSMPB コメント）を取得
+			@return ギャップレス情報
+		*/
+		//-----------------------------------------------------------------//
+		const smpb_t& get_smpb() const noexcept { return smpb_; }
 	};
 }
@@ -0,0 +1,1463 @@
+#pragma once
+//=====================================================================//
+/*!	@file
+	@brief	メディア・ライブラリー・インデックス・クラス @n
+			・オーディオ・ファイル（mp3, wav）を走査して、タグ情報を固定長 @n
+			  レコード（512 バイト）として SD カード上に保存する @n
+			・アーティスト、アルバム、タイトル順のソート済みインデックス @n
+			・カバー画像（APIC）を縮小した RGB565 サムネイル @n
+			・FatFs のファイル・サイズと日付、時間で差分更新する @n
+			  （変更の無いファイルは開かない） @n
+			データベースの構成（デフォルトは「/.medialib」）： @n
+			・track.db：ヘッダー（512 バイト）＋ record_t × count @n
+			・thumb.db：TW × TH の RGB565 スロット @n
+			・index.db：ヘッダー、stat_t × count、各順番のレコード番号（uint16_t）
+    @author 平松邦仁 (hira@rvf-rc45.net)
+	@copyright	Copyright (C) 2021 Kunihito Hiramatsu @n
+				Released under the MIT license @n
+				https://github.com/hirakuni45/RX/blob/master/LICENSE
+*/
+//=====================================================================//
+#include <cstddef>
+#include <new>
+#include <algorithm>
+#include "common/file_io.hpp"
+#include "common/format.hpp"
+#include "common/string_utils.hpp"
+#include "sound/id3_mgr.hpp"
+#include "graphics/img_in.hpp"
+
+namespace sound {
+
+	//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+	/*!
+		@brief	メディア・ライブラリー・インデックス・クラス
+		@param[in]	TMAX	最大レコード数（65535 以下）
+		@param[in]	TW		サムネイルの横幅
+		@param[in]	TH		サムネイルの高さ
+	*/
+	//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+	template <uint32_t TMAX = 8192, uint32_t TW = 64, uint32_t TH = 64>
+	class media_index {
+
+		static_assert(TMAX <= 65535, "TMAX must be less than 65536");
+
+	public:
+		static const uint32_t PATH_SIZE = 288;		///< レコードのパス最大長
+		static const uint32_t TEXT_SIZE = 64;		///< レコードの文字列最大長
+		static const uint16_t NO_THUMB = 0xFFFF;	///< サムネイル無し
+		static const uint32_t THUMB_SIZE = TW * TH * sizeof(uint16_t);	///< サムネイルのバイト数
+
+		static const uint8_t FLAG_ALIVE = 0x01;		///< 有効なレコード
+		static const uint8_t FLAG_TAG   = 0x02;		///< タグ情報を含む
+
+		//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+		/*!
+			@brief	インデックスの順番
+		*/
+		//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+		enum class ORDER : uint8_t {
+			ARTIST,		///< アーティスト、アルバム、ディスク、トラック順
+			ALBUM,		///< アルバム、ディスク、トラック順
+			TITLE,		///< タイトル、アーティスト順
+		};
+
+
+		//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+		/*!
+			@brief	トラック・レコード（512 バイト固定長）
+		*/
+		//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+		struct record_t {
+			uint32_t	fsize;				///< ファイル・サイズ
+			uint16_t	fdate;				///< FatFs の日付
+			uint16_t	ftime;				///< FatFs の時間
+			uint16_t	track;				///< トラック番号
+			uint16_t	disc;				///< ディスク番号
+			uint16_t	year;				///< リリース年
+			uint16_t	thumb;				///< サムネイル・スロット
+			uint32_t	apic_ofs;			///< APIC のファイル位置
+			uint32_t	apic_len;			///< APIC の長さ
+			char		apic_ext[4];		///< APIC の画像形式（拡張子）
+			uint8_t		flags;				///< フラグ
+			uint8_t		reserve[3];
+			char		title[TEXT_SIZE];	///< タイトル（UTF-8）
+			char		artist[TEXT_SIZE];	///< アーティスト（UTF-8）
+			char		album[TEXT_SIZE];	///< アルバム（UTF-8）
+			char		path[PATH_SIZE];	///< フル・パス
+		};
+		static_assert(sizeof(record_t) == 512, "record_t must be 512 bytes");
+
+
+		//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+		/*!
+			@brief	走査結果
+		*/
+		//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+		struct scan_t {
+			uint32_t	files;		///< 検出したオーディオ・ファイル数
+			uint32_t	update;		///< 更新（パース）したファイル数
+			uint32_t	remove;		///< 削除したレコード数
+			uint32_t	thumb;		///< 作成したサムネイル数
+			uint32_t	skip;		///< パスが長い、階層が深い為スキップした数
+			uint32_t	error;		///< エラー数
+			scan_t() noexcept : files(0), update(0), remove(0), thumb(0), skip(0), error(0) { }
+		};
+
+
+		//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+		/*!
+			@brief	サムネイル描画ファンクタ @n
+					※img_in から呼ばれ、ボックス・フィルターで TW × TH に縮小 @n
+					（縦横比を保ち、余白は黒）
+		*/
+		//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+		class thumb_plot {
+
+			uint16_t*	acc_;	// R, G, B（5, 6, 5 ビット）の積算 × TW × TH
+			int32_t		w_;
+			int32_t		h_;
+			int32_t		num_;
+			int32_t		den_;
+			int32_t		step_;
+			int32_t		ox_;
+			int32_t		oy_;
+
+			void range_(int32_t s, int32_t ofs, int32_t lim, int32_t& d0, int32_t& d1) const noexcept
+			{
+				d0 = s * num_ / den_;
+				d1 = (s + 1) * num_ / den_;
+				if(d1 <= d0) d1 = d0 + 1;
+				d0 = std::max(d0 + ofs, static_cast<int32_t>(0));
+				d1 = std::min(d1 + ofs, lim);
+			}
+
+			void count_(int32_t len, int32_t ofs, int32_t lim, uint16_t* cnt) const noexcept
+			{
+				for(int32_t i = 0; i < lim; ++i) cnt[i] = 0;
+				for(int32_t s = 0; s < len; s += step_) {
+					int32_t d0, d1;
+					range_(s, ofs, lim, d0, d1);
+					for(int32_t d = d0; d < d1; ++d) ++cnt[d];
+				}
+			}
+
+		public:
+			thumb_plot() noexcept : acc_(nullptr), w_(0), h_(0), num_(1), den_(1),
+				step_(1), ox_(0), oy_(0) { }
+
+
+			//---------------------------------------------------------//
+			/*!
+				@brief	描画開始
+				@param[in]	acc	積算バッファ（TW × TH × 3 個の uint16_t）
+				@param[in]	w	元画像の横幅
+				@param[in]	h	元画像の高さ
+			*/
+			//---------------------------------------------------------//
+			void start(uint16_t* acc, int16_t w, int16_t h) noexcept
+			{
+				acc_ = acc;
+				std::memset(acc_, 0, TW * TH * 3 * sizeof(uint16_t));
+				w_ = std::max(w, static_cast<int16_t>(1));
+				h_ = std::max(h, static_cast<int16_t>(1));
+				if(w_ * static_cast<int32_t>(TH) >= h_ * static_cast<int32_t>(TW)) {
+					num_ = TW;
+					den_ = w_;
+				} else {
+					num_ = TH;
+					den_ = h_;
+				}
+				// 積算数が 30 × 30 を超えない様に間引く（G: 63 × 31 × 31 < 65536）
+				step_ = (den_ + num_ * 30 - 1) / (num_ * 30);
+				ox_ = (static_cast<int32_t>(TW) - w_ * num_ / den_) / 2;
+				oy_ = (static_cast<int32_t>(TH) - h_ * num_ / den_) / 2;
+			}
+
+
+			//---------------------------------------------------------//
+			/*!
+				@brief	描画ファンクタ
+				@param[in]	x	X 座標
+				@param[in]	y	Y 座標
+				@param[in]	r	R カラー
+				@param[in]	g	G カラー
+				@param[in]	b	B カラー
+				@param[in]	a	アルファ
+			*/
+			//---------------------------------------------------------//
+			void operator() (int16_t x, int16_t y, uint8_t r, uint8_t g, uint8_t b, uint8_t a = 255) noexcept
+			{
+				if(acc_ == nullptr || a == 0) return;
+				if(x < 0 || x >= w_ || y < 0 || y >= h_) return;
+				if((x % step_) != 0 || (y % step_) != 0) return;
+
+				int32_t x0, x1, y0, y1;
+				range_(x, ox_, TW, x0, x1);
+				range_(y, oy_, TH, y0, y1);
+				for(int32_t yy = y0; yy < y1; ++yy) {
+					auto p = &acc_[(yy * TW + x0) * 3];
+					for(int32_t xx = x0; xx < x1; ++xx) {
+						p[0] += r >> 3;
+						p[1] += g >> 2;
+						p[2] += b >> 3;
+						p += 3;
+					}
+				}
+			}
+
+
+			//---------------------------------------------------------//
+			/*!
+				@brief	描画終了 @n
+						※積算バッファの先頭に RGB565 の画像（TW × TH）を作成
+			*/
+			//---------------------------------------------------------//
+			void finish() noexcept
+			{
+				if(acc_ == nullptr) return;
+
+				uint16_t cx[TW];
+				uint16_t cy[TH];
+				count_(w_, ox_, TW, cx);
+				count_(h_, oy_, TH, cy);
+				auto out = acc_;
+				auto p = acc_;
+				for(uint32_t y = 0; y < TH; ++y) {
+					for(uint32_t x = 0; x < TW; ++x) {
+						uint32_t n = cx[x] * cy[y];
+						uint16_t c = 0;
+						if(n > 0) {
+							c  = std::min(p[0] / n, static_cast<uint32_t>(31)) << 11;
+							c |= std::min(p[1] / n, static_cast<uint32_t>(63)) << 5;
+							c |= std::min(p[2] / n, static_cast<uint32_t>(31));
+						}
+						*out++ = c;  // 出力は常に入力より前なので上書きしても良い
+						p += 3;
+					}
+				}
+				acc_ = nullptr;
+			}
+		};
+
+	private:
+		static const uint32_t TRACK_MAGIC = 0x4B52544D;	// "MTRK"
+		static const uint32_t INDEX_MAGIC = 0x5844494D;	// "MIDX"
+		static const uint16_t VERSION = 1;
+		static const uint32_t ORDER_NUM = 3;		// ARTIST, ALBUM, TITLE
+		static const uint32_t DEPTH = 8;			// ディレクトリーの最大階層
+		static constexpr uint32_t KEY_LEN = 12;
+		static const uint32_t SORT_STR_SIZE = TEXT_SIZE * 3 + 4;
+		static const uint32_t RUN_MAX = 32;			// ソート文字列全体で並べる最大数
+		static constexpr uint32_t CHUNK = 8;			// キー作成時にまとめて読むレコード数
+		static const uint32_t THUMB_CACHE = 8;
+		static const uint32_t MERGE_RATIO = 16;		// 変更がこの割合以下なら、前回のインデックスに挿入
+		static const uint8_t MARK_SEEN = 0x01;		// 走査で見つかった
+		static const uint8_t MARK_CHG  = 0x02;		// 更新、又は削除した
+
+		struct head_t {
+			uint32_t	magic;
+			uint16_t	version;
+			uint16_t	tw;
+			uint16_t	th;
+			uint16_t	thumbs;
+			uint32_t	serial;
+			uint32_t	count;
+			uint32_t	alive;
+		};
+
+		struct ihead_t {
+			uint32_t	magic;
+			uint32_t	serial;
+			uint32_t	count;
+			uint32_t	alive;
+		};
+
+		// 変更検出用（パスのハッシュと、サイズ、日付、時間のハッシュ）
+		// sig が「０」のレコードは空き
+		struct stat_t {
+			uint32_t	hash;
+			uint32_t	sig;
+		};
+
+		// ソート・キー（ソート文字列の一部、more が「１」なら続きがある）
+		struct key_t {
+			uint8_t		key[KEY_LEN];
+			uint16_t	rec;
+			uint16_t	more;
+			bool operator < (const key_t& t) const noexcept {
+				auto ret = std::memcmp(key, t.key, KEY_LEN);
+				if(ret != 0) return ret < 0;
+				return rec < t.rec;
+			}
+		};
+
+		struct level_t {
+			DIR			dir;
+			uint16_t	len;
+		};
+
+		struct thumb_cache_t {
+			uint32_t	key;
+			uint16_t	slot;
+		};
+
+		// id3_mgr 用の読み込みバッファ（ID3 フレームは１バイト単位で読まれる為）
+		class buff_in {
+			utils::file_io&	fin_;
+			uint8_t*		buf_;
+			uint32_t		size_;
+			uint32_t		top_;
+			uint32_t		len_;
+			uint32_t		pos_;
+
+		public:
+			buff_in(utils::file_io& fin, uint8_t* buf, uint32_t size) noexcept :
+				fin_(fin), buf_(buf), size_(size), top_(fin.tell()), len_(0), pos_(top_) { }
+
+			bool is_open() const noexcept { return fin_.is_open(); }
+
+			uint32_t tell() const noexcept { return pos_; }
+
+			uint32_t get_file_size() const noexcept { return fin_.get_file_size(); }
+
+			uint32_t read(void* dst, uint32_t len) noexcept
+			{
+				auto d = static_cast<uint8_t*>(dst);
+				uint32_t n = 0;
+				while(n < len) {
+					if(pos_ >= top_ && pos_ < (top_ + len_)) {
+						auto l = std::min(len - n, top_ + len_ - pos_);
+						std::memcpy(&d[n], &buf_[pos_ - top_], l);
+						n += l;
+						pos_ += l;
+						continue;
+					}
+					if(fin_.tell() != pos_ && !fin_.seek(utils::file_io::SEEK::SET, pos_)) break;
+					if((len - n) >= size_) {  // 大きい場合は直接読む
+						auto l = fin_.read(&d[n], len - n);
+						n += l;
+						pos_ += l;
+						break;
+					}
+					top_ = pos_;
+					len_ = fin_.read(buf_, size_);
+					if(len_ == 0) break;
+				}
+				return n;
+			}
+
+			bool seek(utils::file_io::SEEK seek, uint32_t ofs) noexcept
+			{
+				auto fsz = fin_.get_file_size();
+				switch(seek) {
+				case utils::file_io::SEEK::SET:
+					pos_ = ofs;
+					break;
+				case utils::file_io::SEEK::CUR:
+					pos_ += ofs;
+					break;
+				case utils::file_io::SEEK::END:
+					pos_ = fsz - ofs;
+					break;
+				default:
+					return false;
+				}
+				if(pos_ > fsz) {
+					pos_ = fsz;
+					return false;
+				}
+				return true;
+			}
+		};
+
+		char		dir_[32];
+		head_t		head_;
+		ihead_t		ihead_;
+		bool		open_;
+
+		// 走査中のみ有効
+		bool		busy_;
+		bool		dirty_;
+		bool		rebuild_;
+		utils::file_io	db_;
+		utils::file_io	th_;
+		stat_t*		stat_;
+		uint8_t*	mark_;
+		uint32_t	cap_;
+		uint32_t	predict_;
+		uint32_t	free_;
+		uint16_t*	acc_;
+		level_t		level_[DEPTH];
+		uint32_t	depth_;
+		char		path_[PATH_SIZE];
+		FILINFO		fi_;
+		thumb_cache_t	tcache_[THUMB_CACHE];
+		uint32_t	tcache_pos_;
+		record_t*	chunk_;
+		uint32_t	chunk_top_;
+		uint32_t	chunk_num_;
+		uint8_t*	run_;
+
+		scan_t		scan_;
+
+		id3_mgr		id3_;
+		thumb_plot	plot_;
+		img::img_in<thumb_plot>	img_;
+
+		uint8_t		buf_[512];
+
+
+		static uint32_t fnv_(const void* src, uint32_t len, uint32_t h = 2166136261) noexcept
+		{
+			auto p = static_cast<const uint8_t*>(src);
+			for(uint32_t i = 0; i < len; ++i) {
+				h ^= p[i];
+				h *= 16777619;
+			}
+			return h;
+		}
+
+
+		static uint32_t hash_(const char* path) noexcept
+		{
+			auto h = fnv_(path, std::strlen(path));
+			return h != 0 ? h : 1;
+		}
+
+
+		static uint32_t sig_(uint32_t fsize, uint16_t fdate, uint16_t ftime) noexcept
+		{
+			auto h = fnv_(&fsize, sizeof(fsize));
+			h = fnv_(&fdate, sizeof(fdate), h);
+			h = fnv_(&ftime, sizeof(ftime), h);
+			return h != 0 ? h : 1;
+		}
+
+
+		// UTF-8 の文字境界で切り詰めてコピー
+		static void copy_str_(char* dst, const char* src, uint32_t size) noexcept
+		{
+			uint32_t n = 0;
+			while(src[n] != 0 && n < (size - 1)) ++n;
+			if(src[n] != 0) {
+				while(n > 0 && (static_cast<uint8_t>(src[n]) & 0xC0) == 0x80) --n;
+			}
+			std::memcpy(dst, src, n);
+			dst[n] = 0;
+		}
+
+
+		// "3/12" などの先頭の数値
+		static uint16_t dec_(const char* src) noexcept
+		{
+			uint32_t v = 0;
+			while(*src == ' ') ++src;
+			while(*src >= '0' && *src <= '9') {
+				v = v * 10 + (*src - '0');
+				if(v > 65535) return 65535;
+				++src;
+			}
+			return v;
+		}
+
+
+		void make_path_(const char* name, char* dst, uint32_t len) const noexcept
+		{
+			utils::sformat("%s/%s", dst, len) % dir_ % name;
+		}
+
+
+		bool seen_get_(uint32_t rec) const noexcept { return (mark_[rec] & MARK_SEEN) != 0; }
+		void seen_set_(uint32_t rec) noexcept { mark_[rec] |= MARK_SEEN; }
+		bool chg_get_(uint32_t rec) const noexcept { return (mark_[rec] & MARK_CHG) != 0; }
+		void chg_set_(uint32_t rec) noexcept { mark_[rec] |= MARK_CHG; }
+
+
+		bool reserve_(uint32_t cap) noexcept
+		{
+			if(cap <= cap_) return true;
+			cap = std::min(std::max(cap, cap_ * 2), TMAX);
+			auto st = new (std::nothrow) stat_t[cap];
+			auto mk = new (std::nothrow) uint8_t[cap];
+			if(st == nullptr || mk == nullptr) {
+				delete[] st;
+				delete[] mk;
+				return false;
+			}
+			std::memset(mk, 0, cap);
+			if(stat_ != nullptr) {
+				std::memcpy(st, stat_, sizeof(stat_t) * cap_);
+				std::memcpy(mk, mark_, cap_);
+			}
+			delete[] stat_;
+			delete[] mark_;
+			stat_ = st;
+			mark_ = mk;
+			cap_ = cap;
+			return true;
+		}
+
+
+		void release_() noexcept
+		{
+			delete[] stat_;
+			stat_ = nullptr;
+			delete[] mark_;
+			mark_ = nullptr;
+			cap_ = 0;
+			delete[] acc_;
+			acc_ = nullptr;
+			while(depth_ > 0) {
+				--depth_;
+				f_closedir(&level_[depth_].dir);
+			}
+			db_.close();
+			th_.close();
+		}
+
+
+		bool write_head_() noexcept
+		{
+			std::memset(buf_, 0, sizeof(buf_));
+			std::memcpy(buf_, &head_, sizeof(head_));
+			if(!db_.seek(utils::file_io::SEEK::SET, 0)) return false;
+			return db_.write(buf_, sizeof(buf_)) == sizeof(buf_);
+		}
+
+
+		static bool read_record_(utils::file_io& fin, uint32_t rec, record_t* dst, uint32_t num = 1) noexcept
+		{
+			if(!fin.seek(utils::file_io::SEEK::SET, (rec + 1) * sizeof(record_t))) return false;
+			return fin.read(dst, sizeof(record_t) * num) == (sizeof(record_t) * num);
+		}
+
+
+		bool write_record_(uint32_t rec, const record_t& r) noexcept
+		{
+			if(!db_.seek(utils::file_io::SEEK::SET, (rec + 1) * sizeof(record_t))) return false;
+			return db_.write(&r, sizeof(record_t)) == sizeof(record_t);
+		}
+
+
+		// index.db の stat_t を読む、無効ならレコードから作り直す
+		bool load_stat_() noexcept
+		{
+			if(!reserve_(head_.count + 64)) return false;
+
+			if(ihead_.magic == INDEX_MAGIC && ihead_.serial == head_.serial
+			  && ihead_.count == head_.count) {
+				char tmp[48];
+				make_path_("index.db", tmp, sizeof(tmp));
+				utils::file_io fin;
+				if(fin.open(tmp, "rb")) {
+					fin.seek(utils::file_io::SEEK::SET, sizeof(ihead_t));
+					auto len = sizeof(stat_t) * head_.count;
+					if(fin.read(stat_, len) == len) {
+						return true;
+					}
+				}
+			}
+
+			if(head_.count > 0) {
+				utils::format("Media index: rebuild stat (%u records)\n") % head_.count;
+			}
+			auto r = reinterpret_cast<record_t*>(buf_);
+			for(uint32_t i = 0; i < head_.count; ++i) {
+				if(!read_record_(db_, i, r)) return false;
+				if(r->flags & FLAG_ALIVE) {
+					r->path[PATH_SIZE - 1] = 0;
+					stat_[i].hash = hash_(r->path);
+					stat_[i].sig = sig_(r->fsize, r->fdate, r->ftime);
+				} else {
+					stat_[i].hash = 0;
+					stat_[i].sig = 0;
+				}
+			}
+			dirty_ = true;  // インデックスも作り直す
+			rebuild_ = true;
+			return true;
+		}
+
+
+		int32_t find_stat_(uint32_t hash) const noexcept
+		{
+			// ディレクトリーの並びは前回と同じ事が多いので、次のレコードから調べる
+			if(predict_ < head_.count && stat_[predict_].hash == hash && stat_[predict_].sig != 0
+			  && !seen_get_(predict_)) {
+				return predict_;
+			}
+			for(uint32_t i = 0; i < head_.count; ++i) {
+				if(stat_[i].hash == hash && stat_[i].sig != 0 && !seen_get_(i)) {
+					return i;
+				}
+			}
+			return -1;
+		}
+
+
+		int32_t alloc_record_() noexcept
+		{
+			while(free_ < head_.count) {
+				if(stat_[free_].sig == 0 && !seen_get_(free_)) {
+					return free_++;
+				}
+				++free_;
+			}
+			if(head_.count >= TMAX) return -1;
+			if(!reserve_(head_.count + 1)) return -1;
+			auto rec = head_.count;
+			++head_.count;
+			free_ = head_.count;
+			stat_[rec].hash = 0;
+			stat_[rec].sig = 0;
+			return rec;
+		}
+
+
+		uint16_t make_thumb_(utils::file_io& fin, const record_t& r) noexcept
+		{
+			if(acc_ == nullptr) return NO_THUMB;
+
+			// 同じアルバムの同じ画像は共有する
+			uint32_t key;
+			if(r.album[0] != 0) {
+				key = fnv_(r.album, std::strlen(r.album), fnv_(r.artist, std::strlen(r.artist)));
+			} else {
+				auto p = std::strrchr(r.path, '/');
+				key = fnv_(r.path, p != nullptr ? (p - r.path) : 0);
+			}
+			key = fnv_(&r.apic_len, sizeof(r.apic_len), key);
+			for(uint32_t i = 0; i < THUMB_CACHE; ++i) {
+				if(tcache_[i].slot != NO_THUMB && tcache_[i].key == key) {
+					return tcache_[i].slot;
+				}
+			}
+
+			if(head_.thumbs >= NO_THUMB) return NO_THUMB;
+			if(!img_.select_decoder(r.apic_ext)) return NO_THUMB;
+
+			fin.seek(utils::file_io::SEEK::SET, r.apic_ofs);
+			img::img_info ifo;
+			if(!img_.info(fin, ifo) || ifo.width <= 0 || ifo.height <= 0) {
+				++scan_.error;
+				return NO_THUMB;
+			}
+			fin.seek(utils::file_io::SEEK::SET, r.apic_ofs);
+			plot_.start(acc_, ifo.width, ifo.height);
+			auto ret = img_.load(fin);
+			plot_.finish();
+			if(!ret) {
+				++scan_.error;
+				return NO_THUMB;
+			}
+
+			uint16_t slot = head_.thumbs;
+			if(!th_.seek(utils::file_io::SEEK::SET, slot * THUMB_SIZE)
+			  || th_.write(acc_, THUMB_SIZE) != THUMB_SIZE) {
+				++scan_.error;
+				return NO_THUMB;
+			}
+			++head_.thumbs;
+			++scan_.thumb;
+			tcache_[tcache_pos_].key = key;
+			tcache_[tcache_pos_].slot = slot;
+			++tcache_pos_;
+			tcache_pos_ %= THUMB_CACHE;
+			return slot;
+		}
+
+
+		void fill_record_(record_t& r) noexcept
+		{
+			std::memset(&r, 0, sizeof(record_t));
+			r.fsize = fi_.fsize;
+			r.fdate = fi_.fdate;
+			r.ftime = fi_.ftime;
+			r.thumb = NO_THUMB;
+			r.flags = FLAG_ALIVE;
+			copy_str_(r.path, path_, sizeof(r.path));
+
+			utils::file_io fin;
+			if(!fin.open(path_, "rb")) {
+				++scan_.error;
+			} else if(utils::str::scan_ext(path_, "mp3")) {
+				buff_in bin(fin, buf_, sizeof(buf_));
+				if(id3_.parse(bin)) {
+					const auto& t = id3_.get_tag();
+					copy_str_(r.title, t.get_title().c_str(), sizeof(r.title));
+					copy_str_(r.artist, t.get_artist().c_str(), sizeof(r.artist));
+					copy_str_(r.album, t.get_album().c_str(), sizeof(r.album));
+					r.track = dec_(t.get_track().c_str());
+					r.disc = dec_(t.get_disc().c_str());
+					r.year = dec_(t.get_year().c_str());
+					r.apic_ofs = t.get_apic().ofs_;
+					r.apic_len = t.get_apic().len_;
+					copy_str_(r.apic_ext, t.get_apic().ext_, sizeof(r.apic_ext));
+					r.flags |= FLAG_TAG;
+				}
+			}
+			if(r.title[0] == 0) {
+				char tmp[TEXT_SIZE];
+				utils::str::get_file_base(path_, tmp, sizeof(tmp));
+				copy_str_(r.title, tmp, sizeof(r.title));
+			}
+			if(fin.is_open() && r.apic_len > 0) {
+				r.thumb = make_thumb_(fin, r);
+			}
+		}
+
+
+		void update_file_() noexcept
+		{
+			++scan_.files;
+			auto hash = hash_(path_);
+			auto sig = sig_(fi_.fsize, fi_.fdate, fi_.ftime);
+			auto rec = find_stat_(hash);
+			if(rec >= 0 && stat_[rec].sig == sig) {  // 変更無し
+				seen_set_(rec);
+				predict_ = rec + 1;
+				return;
+			}
+			if(rec < 0) {
+				rec = alloc_record_();
+				if(rec < 0) {
+					++scan_.error;
+					return;
+				}
+			}
+			record_t r;
+			fill_record_(r);
+			if(!write_record_(rec, r)) {
+				++scan_.error;
+				return;
+			}
+			stat_[rec].hash = hash;
+			stat_[rec].sig = sig;
+			seen_set_(rec);
+			chg_set_(rec);
+			predict_ = rec + 1;
+			dirty_ = true;
+			++scan_.update;
+		}
+
+
+		// ソート文字列（フィールドを「０」で区切り、英字は小文字にする）
+		static uint32_t sort_str_(ORDER order, const record_t& r, uint8_t* dst) noexcept
+		{
+			uint32_t pos = 0;
+			auto str = [&](const char* s) {
+				for(uint32_t i = 0; i < TEXT_SIZE && s[i] != 0; ++i) {
+					uint8_t ch = s[i];
+					if(ch >= 'A' && ch <= 'Z') ch += 'a' - 'A';
+					dst[pos++] = ch;
+				}
+				dst[pos++] = 0;
+			};
+			auto num = [&](uint16_t v) {
+				dst[pos++] = v >> 8;
+				dst[pos++] = v & 0xff;
+			};
+			switch(order) {
+			case ORDER::ARTIST:
+				str(r.artist);
+				str(r.album);
+				num(r.disc);
+				num(r.track);
+				str(r.title);
+				break;
+			case ORDER::ALBUM:
+				str(r.album);
+				num(r.disc);
+				num(r.track);
+				str(r.title);
+				break;
+			case ORDER::TITLE:
+				str(r.title);
+				str(r.artist);
+				str(r.album);
+				break;
+			}
+			return pos;
+		}
+
+
+		// ソート文字列の skip から KEY_LEN バイトをキーにする
+		static void make_key_(ORDER order, const record_t& r, uint32_t skip, key_t& k) noexcept
+		{
+			uint8_t tmp[SORT_STR_SIZE];
+			auto len = sort_str_(order, r, tmp);
+			std::memset(k.key, 0, KEY_LEN);
+			if(skip < len) {
+				std::memcpy(k.key, &tmp[skip], std::min(len - skip, KEY_LEN));
+			}
+			k.more = len > (skip + KEY_LEN);
+		}
+
+
+		// レコードの読み込み（インデックス作成時） @n
+		// 順番に読む場合は CHUNK 単位でまとめて読む
+		const record_t* fetch_(uint32_t rec, bool seq) noexcept
+		{
+			if(rec >= chunk_top_ && rec < (chunk_top_ + chunk_num_)) {
+				return &chunk_[rec - chunk_top_];
+			}
+			if(!seq) {
+				auto r = reinterpret_cast<record_t*>(buf_);
+				return read_record_(db_, rec, r) ? r : nullptr;
+			}
+			auto n = std::min(CHUNK, head_.count - rec);
+			chunk_num_ = 0;
+			if(!read_record_(db_, rec, chunk_, n)) return nullptr;
+			chunk_top_ = rec;
+			chunk_num_ = n;
+			return chunk_;
+		}
+
+
+		// キーが同じで続きがある範囲は、最初に異なる位置からのキーで並べ直す
+		bool refine_(ORDER order, key_t* top, uint32_t num) noexcept
+		{
+			uint32_t i = 0;
+			while(i < num) {
+				uint32_t j = i + 1;
+				while(j < num && std::memcmp(top[i].key, top[j].key, KEY_LEN) == 0) ++j;
+				if((j - i) > 1 && (j - i) <= RUN_MAX && top[i].more) {
+					// 短い範囲は、ソート文字列全体を読んで並べる
+					for(uint32_t k = i; k < j; ++k) {
+						auto r = fetch_(top[k].rec, false);
+						if(r == nullptr) return false;
+						auto p = &run_[(k - i) * SORT_STR_SIZE];
+						auto len = sort_str_(order, *r, p);
+						std::memset(&p[len], 0, SORT_STR_SIZE - len);
+						top[k].more = k - i;
+					}
+					std::sort(&top[i], &top[j], [this](const key_t& a, const key_t& b) {
+						auto ret = std::memcmp(&run_[a.more * SORT_STR_SIZE], &run_[b.more * SORT_STR_SIZE],
+							SORT_STR_SIZE);
+						if(ret != 0) return ret < 0;
+						return a.rec < b.rec;
+					});
+				} else if((j - i) > 1 && top[i].more) {
+					// 共通の長さ（長いアーティスト名などは１回で読み飛ばす）
+					uint8_t ref[SORT_STR_SIZE];
+					uint8_t str[SORT_STR_SIZE];
+					auto r = fetch_(top[i].rec, false);
+					if(r == nullptr) return false;
+					auto com = sort_str_(order, *r, ref);
+					for(uint32_t k = i + 1; k < j; ++k) {
+						r = fetch_(top[k].rec, false);
+						if(r == nullptr) return false;
+						auto len = std::min(sort_str_(order, *r, str), com);
+						uint32_t n = 0;
+						while(n < len && ref[n] == str[n]) ++n;
+						com = n;
+					}
+					for(uint32_t k = i; k < j; ++k) {
+						r = fetch_(top[k].rec, false);
+						if(r == nullptr) return false;
+						make_key_(order, *r, com, top[k]);
+					}
+					std::sort(&top[i], &top[j]);
+					if(!refine_(order, &top[i], j - i)) return false;
+				}
+				i = j;
+			}
+			return true;
+		}
+
+
+		bool sort_(ORDER order, key_t* keys) noexcept
+		{
+			uint32_t n = 0;
+			for(uint32_t i = 0; i < head_.count; ++i) {
+				if(stat_[i].sig == 0) continue;
+				auto r = fetch_(i, true);
+				if(r == nullptr || n >= head_.alive) return false;
+				make_key_(order, *r, 0, keys[n]);
+				keys[n].rec = i;
+				++n;
+			}
+			std::sort(&keys[0], &keys[n]);
+			return refine_(order, keys, n);
+		}
+
+
+		// ソート文字列（０で埋める）
+		bool fill_str_(ORDER order, uint32_t rec, uint8_t* dst) noexcept
+		{
+			auto r = fetch_(rec, false);
+			if(r == nullptr) return false;
+			auto len = sort_str_(order, *r, dst);
+			std::memset(&dst[len], 0, SORT_STR_SIZE - len);
+			return true;
+		}
+
+
+		// 変更が少ない場合、前回のリストから変更したレコードを除き、二分探索で挿入する
+		bool merge_(ORDER order, utils::file_io& fin, uint16_t* list) noexcept
+		{
+			auto ofs = sizeof(ihead_t) + sizeof(stat_t) * ihead_.count
+				+ static_cast<uint32_t>(order) * ihead_.alive * sizeof(uint16_t);
+			if(!fin.seek(utils::file_io::SEEK::SET, ofs)) return false;
+
+			uint32_t n = 0;
+			auto tmp = reinterpret_cast<uint16_t*>(buf_);
+			const uint32_t lmax = sizeof(buf_) / sizeof(uint16_t);
+			for(uint32_t i = 0; i < ihead_.alive; i += lmax) {
+				auto l = std::min(lmax, ihead_.alive - i);
+				if(fin.read(tmp, l * sizeof(uint16_t)) != (l * sizeof(uint16_t))) return false;
+				for(uint32_t j = 0; j < l; ++j) {
+					auto rec = tmp[j];
+					if(rec >= head_.count || stat_[rec].sig == 0 || chg_get_(rec)) continue;
+					if(n >= head_.alive) return false;
+					list[n++] = rec;
+				}
+			}
+
+			for(uint32_t rec = 0; rec < head_.count; ++rec) {
+				if(stat_[rec].sig == 0 || !chg_get_(rec)) continue;
+				if(n >= head_.alive) return false;
+				auto sa = &run_[0];
+				auto sb = &run_[SORT_STR_SIZE];
+				if(!fill_str_(order, rec, sa)) return false;
+				uint32_t lo = 0;
+				uint32_t hi = n;
+				while(lo < hi) {
+					auto mid = (lo + hi) / 2;
+					if(!fill_str_(order, list[mid], sb)) return false;
+					auto ret = std::memcmp(sa, sb, SORT_STR_SIZE);
+					if(ret > 0 || (ret == 0 && rec > list[mid])) lo = mid + 1;
+					else hi = mid;
+				}
+				std::memmove(&list[lo + 1], &list[lo], (n - lo) * sizeof(uint16_t));
+				list[lo] = rec;
+				++n;
+			}
+			return n == head_.alive;
+		}
+
+
+		bool write_index_(uint32_t serial) noexcept
+		{
+			ihead_t ih;
+			ih.magic = INDEX_MAGIC;
+			ih.serial = serial;
+			ih.count = head_.count;
+			ih.alive = head_.alive;
+
+			char org[48];
+			make_path_("index.db", org, sizeof(org));
+			char path[48];
+			make_path_("index.tmp", path, sizeof(path));
+
+			utils::file_io fin;
+			bool merge = !rebuild_ && ihead_.magic == INDEX_MAGIC && ihead_.serial == head_.serial
+				&& ((scan_.update + scan_.remove) * MERGE_RATIO) <= head_.alive
+				&& fin.open(org, "rb");
+
+			auto alive = std::max(head_.alive, static_cast<uint32_t>(1));
+			key_t* keys = nullptr;
+			uint16_t* list;
+			if(merge) {
+				list = new (std::nothrow) uint16_t[alive];
+			} else {
+				keys = new (std::nothrow) key_t[alive];
+				list = reinterpret_cast<uint16_t*>(keys);
+			}
+			chunk_ = new (std::nothrow) record_t[CHUNK];
+			chunk_num_ = 0;
+			run_ = new (std::nothrow) uint8_t[RUN_MAX * SORT_STR_SIZE];
+
+			utils::file_io fout;
+			bool ret = list != nullptr && chunk_ != nullptr && run_ != nullptr;
+			if(ret) {
+				ret = fout.open(path, "wb");
+			}
+			if(ret) {
+				ret = fout.write(&ih, sizeof(ih)) == sizeof(ih);
+			}
+			if(ret) {
+				auto len = sizeof(stat_t) * head_.count;
+				ret = fout.write(stat_, len) == len;
+			}
+			for(uint32_t i = 0; i < ORDER_NUM && ret; ++i) {
+				auto order = static_cast<ORDER>(i);
+				if(merge) {
+					ret = merge_(order, fin, list);
+				} else {
+					ret = sort_(order, keys);
+					for(uint32_t j = 0; j < head_.alive; ++j) list[j] = keys[j].rec;
+				}
+				if(ret) {
+					auto len = head_.alive * sizeof(uint16_t);
+					ret = fout.write(list, len) == len;
+				}
+			}
+			if(ret) {  // パスのハッシュ順（検索用）
+				uint32_t n = 0;
+				for(uint32_t i = 0; i < head_.count; ++i) {
+					if(stat_[i].sig != 0) list[n++] = i;
+				}
+				std::sort(&list[0], &list[n], [this](uint16_t a, uint16_t b) {
+					if(stat_[a].hash != stat_[b].hash) return stat_[a].hash < stat_[b].hash;
+					return a < b;
+				});
+				auto len = n * sizeof(uint16_t);
+				ret = fout.write(list, len) == len;
+			}
+			fout.close();
+			fin.close();
+
+			delete[] run_;
+			run_ = nullptr;
+			delete[] chunk_;
+			chunk_ = nullptr;
+			if(merge) delete[] list;
+			delete[] keys;
+
+			if(ret) {
+				utils::file_io::remove(org);
+				ret = utils::file_io::rename(path, org);
+			}
+			if(ret) ihead_ = ih;
+			return ret;
+		}
+
+
+		void finish_() noexcept
+		{
+			// 見つからなかったファイルのレコードを削除
+			head_.alive = 0;
+			for(uint32_t i = 0; i < head_.count; ++i) {
+				if(stat_[i].sig == 0) continue;
+				if(seen_get_(i)) {
+					++head_.alive;
+					continue;
+				}
+				uint8_t flags = 0;
+				if(!db_.seek(utils::file_io::SEEK::SET, (i + 1) * sizeof(record_t) + offsetof(record_t, flags))
+				  || db_.write(&flags, 1) != 1) {
+					++scan_.error;
+				}
+				stat_[i].hash = 0;
+				stat_[i].sig = 0;
+				chg_set_(i);
+				++scan_.remove;
+				dirty_ = true;
+			}
+
+			if(dirty_) {
+				auto serial = head_.serial + 1;
+				if(write_index_(serial)) {
+					head_.serial = serial;
+				} else {
+					std::memset(&ihead_, 0, sizeof(ihead_));
+					++scan_.error;
+				}
+				if(!write_head_()) ++scan_.error;
+			}
+			release_();
+			busy_ = false;
+		}
+
+	public:
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	コンストラクター
+		*/
+		//-----------------------------------------------------------------//
+		media_index() noexcept : dir_{ 0 }, head_(), ihead_(), open_(false),
+			busy_(false), dirty_(false), rebuild_(false), db_(), th_(),
+			stat_(nullptr), mark_(nullptr), cap_(0), predict_(0), free_(0), acc_(nullptr),
+			level_(), depth_(0), path_{ 0 }, fi_(), tcache_(), tcache_pos_(0),
+			chunk_(nullptr), chunk_top_(0), chunk_num_(0), run_(nullptr),
+			scan_(), id3_(), plot_(), img_(plot_), buf_{ 0 }
+		{
+			id3_.set_verbose(false);
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	デストラクター
+		*/
+		//-----------------------------------------------------------------//
+		~media_index() { release_(); }
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	データベースを開く @n
+					※無い場合や、形式が異なる場合は新規に作成する
+			@param[in]	dir		データベースのディレクトリー
+			@return 成功なら「true」
+		*/
+		//-----------------------------------------------------------------//
+		bool open(const char* dir = "/.medialib") noexcept
+		{
+			if(busy_ || dir == nullptr) return false;
+
+			open_ = false;
+			utils::str::strncpy_(dir_, dir, sizeof(dir_));
+			if(!utils::file_io::is_directory(dir_)) {
+				if(!utils::file_io::mkdir(dir_)) return false;
+			}
+
+			char path[48];
+			make_path_("track.db", path, sizeof(path));
+			utils::file_io fin;
+			bool valid = false;
+			if(fin.open(path, "rb")) {
+				if(fin.read(&head_, sizeof(head_)) == sizeof(head_)) {
+					valid = head_.magic == TRACK_MAGIC && head_.version == VERSION
+						&& head_.tw == TW && head_.th == TH && head_.count <= TMAX
+						&& fin.get_file_size() >= ((head_.count + 1) * sizeof(record_t));
+				}
+				fin.close();
+			}
+			if(!valid) {
+				return format();
+			}
+
+			make_path_("index.db", path, sizeof(path));
+			std::memset(&ihead_, 0, sizeof(ihead_));
+			if(fin.open(path, "rb")) {
+				if(fin.read(&ihead_, sizeof(ihead_)) != sizeof(ihead_)) {
+					std::memset(&ihead_, 0, sizeof(ihead_));
+				}
+				fin.close();
+			}
+			open_ = true;
+			return true;
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	データベースを初期化（空にする）
+			@return 成功なら「true」
+		*/
+		//-----------------------------------------------------------------//
+		bool format() noexcept
+		{
+			if(busy_ || dir_[0] == 0) return false;
+
+			open_ = false;
+			std::memset(&head_, 0, sizeof(head_));
+			head_.magic = TRACK_MAGIC;
+			head_.version = VERSION;
+			head_.tw = TW;
+			head_.th = TH;
+			std::memset(&ihead_, 0, sizeof(ihead_));
+
+			char path[48];
+			make_path_("track.db", path, sizeof(path));
+			if(!db_.open(path, "wb")) return false;
+			auto ret = write_head_();
+			db_.close();
+			if(!ret) return false;
+
+			make_path_("thumb.db", path, sizeof(path));
+			if(!th_.open(path, "wb")) return false;
+			th_.close();
+
+			make_path_("index.db", path, sizeof(path));
+			utils::file_io::remove(path);
+			open_ = true;
+			return true;
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	走査を開始
+			@param[in]	root	走査するディレクトリー
+			@return 成功なら「true」
+		*/
+		//-----------------------------------------------------------------//
+		bool start(const char* root = "/") noexcept
+		{
+			if(busy_) return false;
+			if(!open_ && !open()) return false;
+
+			scan_ = scan_t();
+			dirty_ = false;
+			rebuild_ = false;
+			predict_ = 0;
+			free_ = 0;
+			tcache_pos_ = 0;
+			for(uint32_t i = 0; i < THUMB_CACHE; ++i) {
+				tcache_[i].key = 0;
+				tcache_[i].slot = NO_THUMB;
+			}
+
+			char path[48];
+			make_path_("track.db", path, sizeof(path));
+			bool ret = db_.open(path, "r+");
+			if(ret) {
+				make_path_("thumb.db", path, sizeof(path));
+				ret = th_.open(path, "r+");
+			}
+			if(ret) {
+				ret = load_stat_();
+			}
+			if(ret) {
+				acc_ = new (std::nothrow) uint16_t[TW * TH * 3];
+				ret = acc_ != nullptr;
+			}
+			if(ret) {
+				utils::str::strncpy_(path_, root, sizeof(path_));
+				auto len = std::strlen(path_);
+				while(len > 0 && path_[len - 1] == '/') --len;
+				path_[len] = 0;
+				level_[0].len = len;
+				ret = f_opendir(&level_[0].dir, len > 0 ? path_ : "/") == FR_OK;
+			}
+			if(!ret) {
+				release_();
+				return false;
+			}
+			depth_ = 1;
+			busy_ = true;
+			return true;
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	走査サービス @n
+					※走査が終わると、インデックスを作成してデータベースを更新する
+			@param[in]	num		１回で処理するオーディオ・ファイル数
+			@return 走査中なら「true」
+		*/
+		//-----------------------------------------------------------------//
+		bool service(uint32_t num = 1) noexcept
+		{
+			if(!busy_) return false;
+
+			while(num > 0) {
+				if(depth_ == 0) {
+					finish_();
+					return false;
+				}
+				auto& lv = level_[depth_ - 1];
+				if(f_readdir(&lv.dir, &fi_) != FR_OK || fi_.fname[0] == 0) {
+					f_closedir(&lv.dir);
+					--depth_;
+					if(depth_ > 0) path_[level_[depth_ - 1].len] = 0;
+					continue;
+				}
+				if((fi_.fattrib & (AM_HID | AM_SYS)) != 0 || fi_.fname[0] == '.') continue;
+
+				auto len = lv.len;
+				auto n = std::strlen(fi_.fname);
+				if((len + 1 + n + 1) > PATH_SIZE) {
+					++scan_.skip;
+					continue;
+				}
+				path_[len] = '/';
+				std::strcpy(&path_[len + 1], fi_.fname);
+				if(fi_.fattrib & AM_DIR) {
+					if(depth_ < DEPTH && f_opendir(&level_[depth_].dir, path_) == FR_OK) {
+						level_[depth_].len = len + 1 + n;
+						++depth_;
+					} else {
+						++scan_.skip;
+						path_[len] = 0;
+					}
+					continue;
+				}
+				if(utils::str::scan_ext(fi_.fname, "mp3,wav")) {
+					update_file_();
+					--num;
+				}
+				path_[len] = 0;
+			}
+			return true;
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	走査（終わるまで戻らない）
+			@param[in]	root	走査するディレクトリー
+			@return 成功なら「true」
+		*/
+		//-----------------------------------------------------------------//
+		bool scan(const char* root = "/") noexcept
+		{
+			if(!start(root)) return false;
+			while(service(16)) ;
+			return scan_.error == 0;
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	走査中か検査
+			@return 走査中なら「true」
+		*/
+		//-----------------------------------------------------------------//
+		bool is_busy() const noexcept { return busy_; }
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	走査結果を取得
+			@return 走査結果
+		*/
+		//-----------------------------------------------------------------//
+		const auto& get_scan() const noexcept { return scan_; }
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	有効なレコード数（インデックスの長さ）を取得
+			@return レコード数
+		*/
+		//-----------------------------------------------------------------//
+		uint32_t size() const noexcept { return ihead_.alive; }
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	サムネイル数を取得
+			@return サムネイル数
+		*/
+		//-----------------------------------------------------------------//
+		uint32_t get_thumb_num() const noexcept { return head_.thumbs; }
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	レコードを取得
+			@param[in]	rec		レコード番号
+			@param[out]	r		レコード
+			@return 有効なレコードなら「true」
+		*/
+		//-----------------------------------------------------------------//
+		bool get_record(uint32_t rec, record_t& r) const noexcept
+		{
+			if(!open_ || rec >= ihead_.count) return false;
+
+			char path[48];
+			make_path_("track.db", path, sizeof(path));
+			utils::file_io fin;
+			if(!fin.open(path, "rb")) return false;
+			if(!read_record_(fin, rec, &r)) return false;
+			r.path[PATH_SIZE - 1] = 0;
+			return (r.flags & FLAG_ALIVE) != 0;
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	インデックスの順番でレコード番号を取得
+			@param[in]	order	順番
+			@param[in]	pos		位置（0 ～ size() - 1）
+			@param[in]	num		取得数
+			@param[out]	dst		レコード番号
+			@return 取得した数
+		*/
+		//-----------------------------------------------------------------//
+		uint32_t get_list(ORDER order, uint32_t pos, uint32_t num, uint16_t* dst) const noexcept
+		{
+			if(!open_ || pos >= ihead_.alive || dst == nullptr) return 0;
+
+			num = std::min(num, ihead_.alive - pos);
+			char path[48];
+			make_path_("index.db", path, sizeof(path));
+			utils::file_io fin;
+			if(!fin.open(path, "rb")) return 0;
+			auto ofs = sizeof(ihead_t) + sizeof(stat_t) * ihead_.count
+				+ (static_cast<uint32_t>(order) * ihead_.alive + pos) * sizeof(uint16_t);
+			if(!fin.seek(utils::file_io::SEEK::SET, ofs)) return 0;
+			return fin.read(dst, num * sizeof(uint16_t)) / sizeof(uint16_t);
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	インデックスの順番でレコードを取得
+			@param[in]	order	順番
+			@param[in]	pos		位置（0 ～ size() - 1）
+			@param[out]	r		レコード
+			@return 成功なら「true」
+		*/
+		//-----------------------------------------------------------------//
+		bool get(ORDER order, uint32_t pos, record_t& r) const noexcept
+		{
+			uint16_t rec;
+			if(get_list(order, pos, 1, &rec) != 1) return false;
+			return get_record(rec, r);
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	パスからレコードを探す
+			@param[in]	path	フル・パス
+			@param[out]	r		レコード
+			@return 見つかれば「true」
+		*/
+		//-----------------------------------------------------------------//
+		bool find(const char* path, record_t& r) const noexcept
+		{
+			if(!open_ || path == nullptr || ihead_.alive == 0) return false;
+
+			char tmp[48];
+			make_path_("index.db", tmp, sizeof(tmp));
+			utils::file_io fin;
+			if(!fin.open(tmp, "rb")) return false;
+			auto list = sizeof(ihead_t) + sizeof(stat_t) * ihead_.count
+				+ ORDER_NUM * ihead_.alive * sizeof(uint16_t);
+			auto hash_at = [&](uint32_t pos, uint16_t& rec, uint32_t& h) {
+				if(!fin.seek(utils::file_io::SEEK::SET, list + pos * sizeof(uint16_t))) return false;
+				if(fin.read(&rec, sizeof(rec)) != sizeof(rec) || rec >= ihead_.count) return false;
+				if(!fin.seek(utils::file_io::SEEK::SET, sizeof(ihead_t) + rec * sizeof(stat_t))) return false;
+				return fin.read(&h, sizeof(h)) == sizeof(h);
+			};
+
+			auto hash = hash_(path);
+			uint32_t lo = 0;
+			uint32_t hi = ihead_.alive;
+			while(lo < hi) {
+				auto mid = (lo + hi) / 2;
+				uint16_t rec;
+				uint32_t h;
+				if(!hash_at(mid, rec, h)) return false;
+				if(h < hash) lo = mid + 1;
+				else hi = mid;
+			}
+			for(; lo < ihead_.alive; ++lo) {
+				uint16_t rec;
+				uint32_t h;
+				if(!hash_at(lo, rec, h) || h != hash) break;
+				if(get_record(rec, r) && std::strcmp(r.path, path) == 0) return true;
+			}
+			return false;
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	サムネイルを読み込む
+			@param[in]	slot	サムネイル・スロット
+			@param[out]	dst		RGB565 画像（TW × TH）
+			@return 成功なら「true」
+		*/
+		//-----------------------------------------------------------------//
+		bool read_thumb(uint16_t slot, uint16_t* dst) const noexcept
+		{
+			if(!open_ || slot == NO_THUMB || dst == nullptr) return false;
+
+			char path[48];
+			make_path_("thumb.db", path, sizeof(path));
+			utils::file_io fin;
+			if(!fin.open(path, "rb")) return false;
+			if(!fin.seek(utils::file_io::SEEK::SET, slot * THUMB_SIZE)) return false;
+			return fin.read(dst, THUMB_SIZE) == THUMB_SIZE;
+		}
+	};
+}
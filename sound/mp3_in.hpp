@@ -2,6 +2,11 @@
 //=====================================================================//
 /*!	@file
 	@brief	libmad を使った MP3 デコード・クラス @n
+			・LAME タグ、又は、iTunSMPB があれば、エンコーダー・ディレイとパディングを除く（ギャップレス）@n
+			・入力は「utils::file_io」、又は、「sound::af_prefetch」 @n
+			・入力はセクター境界に揃えたリングへ読み込み、移動はフレームの残りを折り返し時のみ @n
+			・PCM は 16 ビット変換（丸め、又は、ディザ）しながら FIFO の連続領域へまとめて書く @n
+			・フレーム毎の処理時間（デコード、合成、変換、読み込み、出力待ち）を計測できる @n
 			※このクラスを使うには、libmad ライブラリーが必要
     @author 平松邦仁 (hira@rvf-rc45.net)
 	@copyright	Copyright (C) 2018, 2020 Kunihito Hiramatsu @n
@@ -10,6 +15,9 @@
 */
 //=====================================================================//
 #include <mad.h>
+#include <cstring>
+#include <algorithm>
+#include <type_traits>
 #include "common/file_io.hpp"
 #include "sound/id3_mgr.hpp"
 #include "sound/af_play.hpp"
@@ -29,158 +37,321 @@ namespace sound {
 	//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
 	class mp3_in : public af_play {
 
-		static const uint32_t INPUT_BUFFER_SIZE = 2048;
+	public:
+		//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+		/*!
+			@brief	カウンター関数型 @n
+					フリーランのカウンター値を返す（例：rtos_trace_cmtw::get_counter）
+		*/
+		//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+		typedef uint32_t (*COUNTER)();
+
+
+		//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+		/*!
+			@brief	処理時間（カウンターの単位）
+			@param[in]	T	集計型
+		*/
+		//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+		template <typename T>
+		struct prof_t {
+			T	decode;		///< mad_frame_decode（ハフマン、逆量子化、IMDCT）
+			T	synth;		///< サブバンド・フィルターと mad_synth_frame
+			T	convert;	///< 16 ビット変換と FIFO への書き込み
+			T	read;		///< 入力の読み込み
+			T	wait;		///< FIFO の空き待ち
+
+			prof_t() noexcept : decode(0), synth(0), convert(0), read(0), wait(0) { }
+		};
+
+
+		//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+		/*!
+			@brief	デコード統計 @n
+					decode の開始でクリアされる
+		*/
+		//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+		struct stat_t {
+			uint32_t			frames;		///< フレーム数
+			uint32_t			samples;	///< 出力サンプル数
+			prof_t<uint32_t>	last;		///< 最後のフレーム
+			prof_t<uint32_t>	peak;		///< 項目毎の最大値
+			prof_t<uint64_t>	total;		///< 合計
+
+			stat_t() noexcept : frames(0), samples(0), last(), peak(), total() { }
+		};
+
+	private:
+		static const uint32_t SECTOR_SIZE = 512;
+		static const uint32_t INPUT_RING_SIZE = 8192;	///< 入力リング（READ_SIZE の倍数）
+		static const uint32_t INPUT_READ_SIZE = 4096;	///< 一回の読み込み（セクターの倍数）
+		static const uint32_t INPUT_LEAD_SIZE = 3072;	///< 折り返し時にフレームの残りを置く（最大フレーム長以上）
+		static const uint32_t OUTPUT_SPACE = 64;		///< FIFO の空き待ちの単位（サンプル）
+		static const uint32_t DECODER_DELAY = 529;	///< libmad の合成遅延（サンプル）
+		static const int PCM_SHIFT = MAD_F_FRACBITS + 1 - 16;
 
 		mad_stream	mad_stream_;
 		mad_frame	mad_frame_;
 		mad_synth	mad_synth_;
 
-		uint8_t		input_buffer_[INPUT_BUFFER_SIZE + MAD_BUFFER_GUARD];
+		// [LEAD][RING][GUARD]、RING の先頭はセクター境界に相当する
+		alignas(4) uint8_t	input_buffer_[INPUT_LEAD_SIZE + INPUT_RING_SIZE + MAD_BUFFER_GUARD];
+		uint32_t	in_end_;	///< リング内の有効データ終端
 
-		// サブバンド領域フィルター特性用。
+		// サブバンド領域フィルター特性用（共通倍率と異なるバンドだけ）
 		mad_fixed_t		subband_filter_[32];
+		uint8_t			subband_idx_[32];
+		uint32_t		subband_num_;
+		mad_fixed_t		pcm_gain_;	///< 全バンド共通の倍率（PCM 変換で掛ける）
 		bool			subband_filter_enable_;
+		bool			dither_;
 		bool			id3v1_;
+		uint32_t		seed_;
 
 		uint32_t		time_;
 		uint32_t		header_size_;
 
-		int fill_read_buffer_(utils::file_io& fin, mad_stream& strm)
- 		{
-			/* The input bucket must be filled if it becomes empty or if
-			 * it's the first execution of the loop.
-			 */
-			if(strm.buffer == NULL || strm.error == MAD_ERROR_BUFLEN) {
-				size_t size;
-				size_t remaining;
-				unsigned char* ptr;
-
-				/* {2} libmad may not consume all bytes of the input
-				 * buffer. If the last frame in the buffer is not wholly
-				 * contained by it, then that frame's start is pointed by
-				 * the next_frame member of the Stream structure. This
-				 * common situation occurs when mad_frame_decode() fails,
-				 * sets the stream error code to MAD_ERROR_BUFLEN, and
-				 * sets the next_frame pointer to a non NULL value. (See
-				 * also the comment marked {4} bellow.)
-				 *
-				 * When this occurs, the remaining unused bytes must be
-				 * put back at the beginning of the buffer and taken in
-				 * account before refilling the buffer. This means that
-				 * the input buffer must be large enough to hold a whole
-				 * frame at the highest observable bit-rate (currently 448
-				 * kb/s). XXX=XXX Is 2016 bytes the size of the largest
-				 * frame? (448000*(1152/32000))/8
-				 */
-				if(strm.next_frame != NULL) {
-					remaining = strm.bufend - strm.next_frame;
-					memmove(&input_buffer_[0], strm.next_frame, remaining);
-					ptr  = &input_buffer_[remaining];
-					size = INPUT_BUFFER_SIZE - remaining;
-				} else {
-					size = INPUT_BUFFER_SIZE;
-					ptr  = &input_buffer_[0];
-					remaining = 0;
-				}
+		bool			xing_;		///< 先頭が Xing/Info フレーム
+		uint32_t		skip_;		///< 先頭で捨てるサンプル数
+		uint32_t		valid_;		///< 有効サンプル数（０なら不明）
 
-				/* Fill-in the buffer. If an error occurs print a message
-				 * and leave the decoding loop. If the end of stream is
-				 * reached we also leave the loop but the return status is
-				 * left untouched.
-				 */
-				// ReadSize = BstdRead(ReadStart, 1, ReadSize, BstdFile);
-				size_t req = size;
-				size_t rs = fin.read(ptr, req);
-				if(id3v1_) {
-					if(fin.tell() >= (fin.get_file_size() - 128)) return -1;
-				} else {
-					if(fin.eof()) return -1;
-				}
-				size = rs;
-				if(rs < req) {
-					memset(&ptr[rs], 0, MAD_BUFFER_GUARD);
-					size += MAD_BUFFER_GUARD;
-				}
+		COUNTER			counter_;
+		uint32_t		counter_mask_;
+		prof_t<uint32_t>	cur_;
+		stat_t			stat_;
+
+		uint32_t get_count_() const noexcept { return counter_ != nullptr ? counter_() : 0; }
 
-				/* Pipe the new buffer content to libmad's stream decoder
-				 * facility.
-				 */
-				mad_stream_buffer(&strm, &input_buffer_[0], size + remaining);
-				strm.error = MAD_ERROR_NONE;
-				return 0;
+		uint32_t lap_(uint32_t& t) const noexcept
+		{
+			auto n = get_count_();
+			auto d = (n - t) & counter_mask_;
+			t = n;
+			return d;
+		}
+
+
+		void commit_prof_() noexcept
+		{
+			++stat_.frames;
+			stat_.last = cur_;
+			stat_.peak.decode  = std::max(stat_.peak.decode,  cur_.decode);
+			stat_.peak.synth   = std::max(stat_.peak.synth,   cur_.synth);
+			stat_.peak.convert = std::max(stat_.peak.convert, cur_.convert);
+			stat_.peak.read    = std::max(stat_.peak.read,    cur_.read);
+			stat_.peak.wait    = std::max(stat_.peak.wait,    cur_.wait);
+			stat_.total.decode  += cur_.decode;
+			stat_.total.synth   += cur_.synth;
+			stat_.total.convert += cur_.convert;
+			stat_.total.read    += cur_.read;
+			stat_.total.wait    += cur_.wait;
+			cur_ = prof_t<uint32_t>();
+		}
+
+
+		static uint32_t get32_(const uint8_t* p) noexcept
+		{
+			return (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16)
+				| (static_cast<uint32_t>(p[2]) << 8) | static_cast<uint32_t>(p[3]);
+		}
+
+
+		// Xing/Info ヘッダー（総フレーム数）と LAME タグ（エンコーダー・ディレイ、パディング）
+		static bool scan_xing_(const uint8_t* frm, uint32_t len, const mad_header& h,
+			uint32_t& frames, bool& lame, uint32_t& delay, uint32_t& padding) noexcept
+		{
+			if(h.layer != MAD_LAYER_III) return false;
+
+			uint32_t ofs = 4;  // フレーム・ヘッダー
+			if(h.flags & MAD_FLAG_PROTECTION) ofs += 2;  // CRC
+			bool mono = h.mode == MAD_MODE_SINGLE_CHANNEL;
+			if(h.flags & MAD_FLAG_LSF_EXT) {  // サイド情報
+				ofs += mono ? 9 : 17;
 			} else {
+				ofs += mono ? 17 : 32;
+			}
+			if(len < (ofs + 8)) return false;
+
+			const uint8_t* p = &frm[ofs];
+			if(std::strncmp(reinterpret_cast<const char*>(p), "Xing", 4) != 0
+			 && std::strncmp(reinterpret_cast<const char*>(p), "Info", 4) != 0) {
+				return false;
+			}
+			auto flags = get32_(&p[4]);
+			uint32_t pos = 8;
+			frames = 0;
+			if(flags & 1) {
+				if(len < (ofs + pos + 4)) return true;
+				frames = get32_(&p[pos]);
+				pos += 4;
+			}
+			if(flags & 2) pos += 4;    // バイト数
+			if(flags & 4) pos += 100;  // TOC
+			if(flags & 8) pos += 4;    // 品質
+
+			lame = false;
+			if(len >= (ofs + pos + 24)) {
+				const char* enc = reinterpret_cast<const char*>(&p[pos]);
+				if(std::strncmp(enc, "LAME", 4) == 0 || std::strncmp(enc, "Lavc", 4) == 0
+				 || std::strncmp(enc, "Lavf", 4) == 0) {
+					const uint8_t* q = &p[pos + 21];
+					delay   = (static_cast<uint32_t>(q[0]) << 4) | (q[1] >> 4);
+					padding = (static_cast<uint32_t>(q[1] & 0x0f) << 8) | q[2];
+					lame = true;
+				}
+			}
+			return true;
+		}
+
+
+		// 最初、又は、フレームが足りない場合にリングへ読み足す @n
+		// ファイル位置とリング位置のセクター内オフセットを揃え、読み込みはセクター単位になる @n
+		// リング終端では、不完全なフレーム（libmad の next_frame 以降）だけを LEAD へ置いて先頭から続ける
+		template <class FIN>
+		int fill_read_buffer_(FIN& fin, mad_stream& strm) noexcept
+		{
+			if(strm.buffer != NULL && strm.error != MAD_ERROR_BUFLEN) {
 				return 1;
 			}
+
+			// 終端（ID3v1 タグの手前）までを読み、最後の塊もデコードする
+			uint32_t end = fin.get_file_size();
+			if(id3v1_ && end >= 128) end -= 128;
+			uint32_t pos = fin.tell();
+			if(pos >= end) return -1;
+
+			uint32_t t = get_count_();
+			uint8_t* ring = &input_buffer_[INPUT_LEAD_SIZE];
+			const uint8_t* top;
+			if(strm.buffer == NULL || strm.next_frame == NULL) {
+				in_end_ = pos & (SECTOR_SIZE - 1);
+				top = &ring[in_end_];
+			} else {
+				top = strm.next_frame;
+				if(in_end_ >= INPUT_RING_SIZE) {
+					uint32_t rem = &ring[in_end_] - top;
+					if(rem > INPUT_LEAD_SIZE) rem = 0;  // 同期外れ、捨てて再同期させる
+					std::memcpy(ring - rem, top, rem);
+					top = ring - rem;
+					in_end_ = 0;
+				}
+			}
+
+			uint32_t req = INPUT_READ_SIZE - (in_end_ & (INPUT_READ_SIZE - 1));
+			if(req > (end - pos)) req = end - pos;
+			uint32_t rs = fin.read(&ring[in_end_], req);
+			in_end_ += rs;
+			uint32_t len = &ring[in_end_] - top;
+			if(rs < req || fin.tell() >= end) {
+				std::memset(&ring[in_end_], 0, MAD_BUFFER_GUARD);
+				len += MAD_BUFFER_GUARD;
+			}
+			cur_.read += lap_(t);
+
+			mad_stream_buffer(&strm, top, len);
+			strm.error = MAD_ERROR_NONE;
+			return 0;
 		}
 
 
-		/****************************************************************************
-		 * Applies a frequency-domain filter to audio data in the subband-domain.	*
-		 ****************************************************************************/
-		void apply_filter_(mad_frame& frame)
+		// 共通倍率と異なるバンドだけをサブバンド領域で掛ける
+		void apply_filter_(mad_frame& frame) noexcept
 		{
-			/* There is two application loops, each optimized for the number
-			 * of audio channels to process. The first alternative is for
-			 * two-channel frames, the second is for mono-audio.
-			 */
+			if(subband_num_ == 0) return;
+
 			int num = MAD_NSBSAMPLES(&frame.header);
-			if(frame.header.mode != MAD_MODE_SINGLE_CHANNEL) {
-				for(int ch = 0; ch < 2; ++ch) {
-					for(int s = 0; s < num; ++s) {
-						for(int sb = 0; sb < 32; ++sb) {
-							frame.sbsample[ch][s][sb] =
-								mad_f_mul(frame.sbsample[ch][s][sb], subband_filter_[sb]);
-						}
-					}
-				}
-			} else {
+			int chn = MAD_NCHANNELS(&frame.header);
+			for(int ch = 0; ch < chn; ++ch) {
 				for(int s = 0; s < num; ++s) {
-					for(int sb = 0; sb < 32; ++sb) {
-						frame.sbsample[0][s][sb] =
-							mad_f_mul(frame.sbsample[0][s][sb], subband_filter_[sb]);
+					auto* sb = frame.sbsample[ch][s];
+					for(uint32_t i = 0; i < subband_num_; ++i) {
+						auto n = subband_idx_[i];
+						sb[n] = mad_f_mul(sb[n], subband_filter_[i]);
 					}
 				}
 			}
 		}
 
 
-		static const short SHRT_MAX_ = 32767;
+		// mad_fixed_t（SWWW.FFFF...）から 16 ビットへ：飽和、丸め、又は、TPDF ディザ（±1 LSB）
+		template <bool GAIN, bool DITHER>
+		static int32_t quant_(mad_fixed_t v, mad_fixed_t gain, uint32_t& seed) noexcept
+		{
+			static const int32_t MASK = (1 << PCM_SHIFT) - 1;
+			if(GAIN) v = mad_f_mul(v, gain);
+			if(v >= MAD_F_ONE) v = MAD_F_ONE - 1;
+			else if(v < -MAD_F_ONE) v = -MAD_F_ONE;
+			if(DITHER) {
+				seed = seed * 1664525 + 1013904223;
+				v += static_cast<int32_t>(seed >> (32 - PCM_SHIFT))
+					- static_cast<int32_t>((seed >> 6) & MASK);
+			}
+			v += 1 << (PCM_SHIFT - 1);
+			v >>= PCM_SHIFT;
+			if(v > 32767) v = 32767;
+			else if(v < -32768) v = -32768;
+			return v;
+		}
 
-		/****************************************************************************
-		 * Converts a sample from mad's fixed point number format to a signed		*
-		 * short (16 bits).															*
-		 ****************************************************************************/
-		static short MadFixedToSshort(mad_fixed_t v)
+
+		template <bool STEREO, bool GAIN, bool DITHER, class WAVE>
+		void convert_(const mad_fixed_t* l, const mad_fixed_t* r, WAVE* out, uint32_t n) noexcept
 		{
-			/* A fixed point number is formed of the following bit pattern:
-			 *
-			 * SWWWFFFFFFFFFFFFFFFFFFFFFFFFFFFF
-			 * MSB                          LSB
-			 * S ==> Sign (0 is positive, 1 is negative)
-			 * W ==> Whole part bits
-			 * F ==> Fractional part bits
-			 *
-			 * This pattern contains MAD_F_FRACBITS fractional bits, one
-			 * should alway use this macro when working on the bits of a fixed
-			 * point number. It is not guaranteed to be constant over the
-			 * different platforms supported by libmad.
-			 *
-			 * The signed short value is formed, after clipping, by the least
-			 * significant whole part bit, followed by the 15 most significant
-			 * fractional part bits. Warning: this is a quick and dirty way to
-			 * compute the 16-bit number, madplay includes much better
-			 * algorithms.
-			 */
-
-			// Clipping..
-			if(v >= MAD_F_ONE) {
-				return SHRT_MAX_;
+			auto gain = pcm_gain_;
+			auto seed = seed_;
+			for(uint32_t i = 0; i < n; ++i) {
+				out[i].l_ch = quant_<GAIN, DITHER>(l[i], gain, seed);
+				if(STEREO) {
+					out[i].r_ch = quant_<GAIN, DITHER>(r[i], gain, seed);
+				} else {
+					out[i].r_ch = out[i].l_ch;
+				}
 			}
-			if(v <= -MAD_F_ONE) {
-				return -SHRT_MAX_;
+			seed_ = seed;
+		}
+
+
+		template <bool STEREO, class WAVE>
+		void convert_sel_(const mad_fixed_t* l, const mad_fixed_t* r, WAVE* out, uint32_t n, bool gain) noexcept
+		{
+			if(gain) {
+				if(dither_) convert_<STEREO, true, true>(l, r, out, n);
+				else convert_<STEREO, true, false>(l, r, out, n);
+			} else {
+				if(dither_) convert_<STEREO, false, true>(l, r, out, n);
+				else convert_<STEREO, false, false>(l, r, out, n);
 			}
+		}
+
 
-			return (signed short)(v >> (MAD_F_FRACBITS - 15));
+		// 合成 PCM の [org, org + len) を FIFO の連続領域へ書く
+		template <class SOUND_OUT>
+		void output_(SOUND_OUT& out, uint32_t org, uint32_t len) noexcept
+		{
+			auto& fifo = out.at_fifo();
+			bool stereo = MAD_NCHANNELS(&mad_frame_.header) != 1;
+			bool gain = subband_filter_enable_ && pcm_gain_ != MAD_F_ONE;
+			uint32_t t = get_count_();
+			while(len > 0) {
+				uint32_t space = fifo.size() - fifo.length() - 1;
+				if(space < len && space < OUTPUT_SPACE) {
+					cur_.convert += lap_(t);
+					system_delay(1);
+					cur_.wait += lap_(t);
+					continue;
+				}
+				uint32_t n;
+				auto dst = fifo.put_span(n);
+				if(n > len) n = len;
+				const auto* l = &mad_synth_.pcm.samples[0][org];
+				const auto* r = &mad_synth_.pcm.samples[stereo ? 1 : 0][org];
+				if(stereo) convert_sel_<true>(l, r, dst, n, gain);
+				else convert_sel_<false>(l, r, dst, n, gain);
+				fifo.put_go(n);
+				org += n;
+				len -= n;
+			}
+			cur_.convert += lap_(t);
 		}
 
 	public:
@@ -189,7 +360,108 @@ namespace sound {
 			@brief	コンストラクター
 		*/
 		//-----------------------------------------------------------------//
-		mp3_in() : subband_filter_enable_(false), id3v1_(false), time_(0), header_size_(0) { }
+		mp3_in() : in_end_(0), subband_num_(0), pcm_gain_(MAD_F_ONE),
+			subband_filter_enable_(false), dither_(true), id3v1_(false), seed_(0x2545f491),
+			time_(0), header_size_(0), xing_(false), skip_(0), valid_(0),
+			counter_(nullptr), counter_mask_(0xffffffff), cur_(), stat_() { }
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	サブバンド・フィルター（イコライザー）の設定 @n
+					最も多いバンドの倍率は PCM 変換の乗算に含め、@n
+					それと異なるバンドだけをサブバンド領域で掛ける（平坦なら追加の処理は無い）
+			@param[in]	gain	３２バンドの倍率（MAD_F_ONE で 1.0）、nullptr なら無効
+		*/
+		//-----------------------------------------------------------------//
+		void set_subband_filter(const mad_fixed_t* gain) noexcept
+		{
+			subband_num_ = 0;
+			pcm_gain_ = MAD_F_ONE;
+			if(gain == nullptr) {
+				subband_filter_enable_ = false;
+				return;
+			}
+
+			uint32_t best = 0;
+			for(uint32_t i = 0; i < 32; ++i) {
+				uint32_t n = 0;
+				for(uint32_t j = 0; j < 32; ++j) {
+					if(gain[j] == gain[i]) ++n;
+				}
+				if(n > best) {
+					best = n;
+					pcm_gain_ = gain[i];
+				}
+			}
+			if(pcm_gain_ == 0) pcm_gain_ = MAD_F_ONE;  // ０は共通化できない
+
+			for(uint32_t sb = 0; sb < 32; ++sb) {
+				if(gain[sb] == pcm_gain_) continue;
+				int64_t g = (static_cast<int64_t>(gain[sb]) << MAD_F_FRACBITS) / pcm_gain_;
+				if(g > 0x7fffffff) g = 0x7fffffff;
+				else if(g < -0x7fffffff) g = -0x7fffffff;
+				subband_idx_[subband_num_] = sb;
+				subband_filter_[subband_num_] = g;
+				++subband_num_;
+			}
+			subband_filter_enable_ = true;
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	サブバンド・フィルターの許可
+			@param[in]	ena	不許可なら「false」
+		*/
+		//-----------------------------------------------------------------//
+		void enable_subband_filter(bool ena = true) noexcept { subband_filter_enable_ = ena; }
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	ディザの許可 @n
+					不許可の場合は丸めのみ
+			@param[in]	ena	不許可なら「false」
+		*/
+		//-----------------------------------------------------------------//
+		void enable_dither(bool ena = true) noexcept { dither_ = ena; }
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	処理時間計測用カウンターの設定 @n
+					nullptr なら計測しない（フレーム数とサンプル数のみ）
+			@param[in]	counter	カウンター関数
+			@param[in]	bits	カウンターのビット数
+		*/
+		//-----------------------------------------------------------------//
+		void set_counter(COUNTER counter, uint32_t bits = 32) noexcept
+		{
+			counter_ = counter;
+			counter_mask_ = bits >= 32 ? 0xffffffff : ((1u << bits) - 1);
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	デコード統計の取得
+			@return デコード統計
+		*/
+		//-----------------------------------------------------------------//
+		const stat_t& get_stat() const noexcept { return stat_; }
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	デコード統計のクリア
+		*/
+		//-----------------------------------------------------------------//
+		void clear_stat() noexcept
+		{
+			stat_ = stat_t();
+			cur_ = prof_t<uint32_t>();
+		}
 
 
 		//-----------------------------------------------------------------//
@@ -199,7 +471,8 @@ namespace sound {
 			@return エラーなら「false」を返す
 		*/
 		//-----------------------------------------------------------------//
-		bool probe(utils::file_io& fin) noexcept 
+		template <class FIN>
+		bool probe(FIN& fin) noexcept 
 		{
 			// MP3 ファイルの確認は、ある程度デコードしないと判らない・・
 
@@ -212,13 +485,15 @@ namespace sound {
 		/*!
 			@brief	情報を取得 @n
 					可変ビットレートの場合は、情報は正確では無い。@n
-					※全体時間は正確
-			@param[in]	fin		file_io コンテキスト（参照）
+					※Xing/Info ヘッダーがあるか、file_io で全体を走査した場合、全体時間は正確 @n
+					※先読み入力で Xing/Info ヘッダーが無い場合、固定ビットレートと見なして見積もる
+			@param[in]	fin		入力コンテキスト（参照）
 			@param[out]	info	情報
 			@return 正常なら「true」
 		*/
 		//-----------------------------------------------------------------//
-		bool info(utils::file_io& fin, audio_info& info) noexcept
+		template <class FIN>
+		bool info(FIN& fin, audio_info& info) noexcept
 		{
 			id3_mgr id3;
 			set_state(STATE::TAG);
@@ -227,9 +502,10 @@ namespace sound {
 				return false;
 			}
 
+			id3v1_ = id3.is_v1();
 			if(tag_task_) {
 				const auto& tag = id3.get_tag();
-				tag_task_(fin, tag);
+				tag_task_(tag_file(fin), tag);
 			}
 
 			mad_stream_init(&mad_stream_);
@@ -242,6 +518,12 @@ namespace sound {
 			// 全体のフレーム数をカウント
 			uint32_t frames = 0;
 			uint32_t freq = 0;
+			uint32_t spf = 1152;
+			bool first = true;
+			bool lame = false;
+			uint32_t delay = 0;
+			uint32_t padding = 0;
+			xing_ = false;
 			while(fill_read_buffer_(fin, mad_stream_) >= 0) {
 				if(fin.get_error()) {
 					break;
@@ -257,6 +539,28 @@ namespace sound {
 						}
 					}
 				}
+				if(first) {
+					first = false;
+					freq = mad_frame_.header.samplerate;
+					spf = 32 * MAD_NSBSAMPLES(&mad_frame_.header);
+					uint32_t n = 0;
+					if(scan_xing_(mad_stream_.this_frame, mad_stream_.bufend - mad_stream_.this_frame,
+						mad_frame_.header, n, lame, delay, padding)) {
+						xing_ = true;
+						if(n > 0) {
+							frames = n;
+							break;
+						}
+						continue;  // Info フレームは数えない
+					}
+					if(!std::is_same<FIN, utils::file_io>::value && mad_frame_.header.bitrate > 0) {
+						// 先読み入力ではファイル全体を走査しない
+						uint32_t end = fin.get_file_size() - (id3v1_ ? 128 : 0);
+						uint64_t s = static_cast<uint64_t>(end - forg) * 8 * freq / mad_frame_.header.bitrate;
+						frames = (s + spf - 1) / spf;
+						break;
+					}
+				}
 				++frames;
 				if(freq < mad_frame_.header.samplerate) {
 					freq = mad_frame_.header.samplerate;
@@ -264,7 +568,21 @@ namespace sound {
 			}
 			fin.seek(utils::file_io::SEEK::SET, forg);
 
-			info.samples = frames * 1152;
+			// ギャップレス情報（LAME タグを優先、iTunSMPB のディレイは合成遅延を含む）
+			skip_ = 0;
+			valid_ = 0;
+			uint32_t total = frames * spf;
+			if(lame) {
+				skip_ = delay + DECODER_DELAY;
+				if(total > (delay + padding)) valid_ = total - delay - padding;
+			} else if(id3.get_smpb().valid) {
+				const auto& t = id3.get_smpb();
+				skip_ = t.delay;
+				valid_ = t.samples;
+				if(valid_ == 0 && total > (t.delay + t.padding)) valid_ = total - t.delay - t.padding;
+			}
+
+			info.samples = valid_ > 0 ? valid_ : total;
 			if(mad_frame_.header.mode != MAD_MODE_SINGLE_CHANNEL) {
 				info.type = audio_format::PCM16_STEREO;
 				info.chanels = 2;
@@ -298,20 +616,23 @@ namespace sound {
 			@return 正常終了なら「true」
 		*/
 		//-----------------------------------------------------------------//
-		template <class SOUND_OUT>
-		bool decode(utils::file_io& fin, SOUND_OUT& out)
+		template <class FIN, class SOUND_OUT>
+		bool decode(FIN& fin, SOUND_OUT& out)
 		{
 			mad_stream_init(&mad_stream_);
 			mad_frame_init(&mad_frame_);
 			mad_synth_init(&mad_synth_);
 ///			mad_timer_reset(&mad_timer_);
 
-			uint32_t forg = fin.seek(utils::file_io::SEEK::SET, header_size_);
+			uint32_t forg = header_size_;
+			fin.seek(utils::file_io::SEEK::SET, forg);
 
 			uint32_t pos = 0;
+			uint32_t spos = 0;
 			uint32_t frame_count = 0;
 			bool status = true;
 			bool pause = false;
+			clear_stat();
 			set_state(STATE::PLAY);
 			while(fill_read_buffer_(fin, mad_stream_) >= 0) {
 
@@ -334,7 +655,12 @@ namespace sound {
 				} else if(ctrl == CTRL::REPLAY) {
 					out.mute();
 					fin.seek(utils::file_io::SEEK::SET, forg);
+					mad_stream_finish(&mad_stream_);
+					mad_stream_init(&mad_stream_);
+					mad_frame_mute(&mad_frame_);
+					mad_synth_mute(&mad_synth_);
 					pos = 0;
+					spos = 0;
 					time_ = 0;
 					frame_count = 0;
 					status = true;
@@ -352,7 +678,10 @@ namespace sound {
 					set_state(STATE::PLAY);
 				}
 
-				if(mad_frame_decode(&mad_frame_, &mad_stream_)) {
+				uint32_t t = get_count_();
+				auto err = mad_frame_decode(&mad_frame_, &mad_stream_);
+				cur_.decode += lap_(t);
+				if(err) {
 					if(MAD_RECOVERABLE(mad_stream_.error)) {
 						continue;
 					} else {
@@ -366,29 +695,33 @@ namespace sound {
 				}
 
 				frame_count++;
-///				mad_timer_add(&mad_timer_, mad_frame_.header.duration);
+
+				if(xing_ && frame_count == 1) {  // Xing/Info フレームは出力しない
+					continue;
+				}
 
 				if(subband_filter_enable_) {
 					apply_filter_(mad_frame_);
 				}
 
 				mad_synth_frame(&mad_synth_, &mad_frame_);
-
-				// 1152 sample / frame
-				for(uint32_t i = 0; i < mad_synth_.pcm.length; ++i) {
-					while((out.at_fifo().size() - out.at_fifo().length()) < 64) {
-						system_delay(1);
-					}
-					typename SOUND_OUT::WAVE t;
-					if(MAD_NCHANNELS(&mad_frame_.header) == 1) {
-						t.l_ch = t.r_ch = MadFixedToSshort(mad_synth_.pcm.samples[0][i]);
-					} else {
-						t.l_ch = MadFixedToSshort(mad_synth_.pcm.samples[0][i]);
-						t.r_ch = MadFixedToSshort(mad_synth_.pcm.samples[1][i]);
-					}
-					out.at_fifo().put(t);
-					++pos;
+				cur_.synth += lap_(t);
+
+				// 1152 sample / frame、先頭のディレイと終端のパディングは出力しない
+				uint32_t len = mad_synth_.pcm.length;
+				uint32_t org = spos < skip_ ? std::min(skip_ - spos, len) : 0;
+				uint32_t fin_len = len;
+				if(valid_ > 0) {
+					uint32_t lim = skip_ + valid_;
+					fin_len = lim > spos ? std::min(lim - spos, len) : 0;
+				}
+				if(fin_len > org) {
+					output_(out, org, fin_len - org);
+					pos += fin_len - org;
+					stat_.samples += fin_len - org;
 				}
+				spos += len;
+				commit_prof_();
 
 				{
 					uint32_t s = pos / mad_frame_.header.samplerate;
@@ -5,7 +5,8 @@
 			ファミコン内蔵音源と同じような機能を持った波形生成 @n
 			波形をレンダリングして波形バッファに生成する。 @n
 			生成した波形メモリを PWM 変調などで出力する事を前提にしている。 @n
-			分解能は８ビット
+			チャネル毎にブロック単位でレンダリングし、１６ビット飽和加算で合成する。 @n
+			エンベロープは TICK 周期（コントロール・レート）で更新する。
     @author 平松邦仁 (hira@rvf-rc45.net)
 	@copyright	Copyright (C) 2021 Kunihito Hiramatsu @n
 				Released under the MIT license @n
@@ -37,7 +38,7 @@ namespace utils {
 			SQ50,	///< 矩形波 Duty50%
 			SQ75,	///< 矩形波 Duty75%
 			TRI,	///< 三角波
-			NOISE,	///< ノイズ（現在未サポート）
+			NOISE,	///< ノイズ（１５ビット LFSR）
 		};
 
 
@@ -214,6 +215,7 @@ namespace utils {
 			ATTACK,		///< (2) 音のアタック, gain(0 ~ 255)
 			RELEASE,	///< (3) 音のリリース, release_frame(n), gain(0 ~ 255)
 			CHOUT,		///< (2) 文字出力, char（楽譜のデバッグ用に文字を出力）
+			NOISE,		///< (1) 波形 NOISE
 		};
 
 
@@ -267,9 +269,36 @@ namespace utils {
 			static_cast<uint16_t>((3520 * 65536.0 * 1.887748625) / SAMPLE),  ///< G#
 		};
 
+		// 矩形波 SQ25, SQ50, SQ75 の位相しきい値（この位相以上で正）
+		static constexpr uint16_t duty_tbl_[3] = { 0xc000, 0x8000, 0x4000 };
+
+		// 三角波（４ビット階段状）、位相の上位５ビットで引く
+		static constexpr int8_t tri_tbl_[32] = {
+			 0, -1, -2, -3, -4, -5, -6, -7, -7, -6, -5, -4, -3, -2, -1,  0,
+			 0,  1,  2,  3,  4,  5,  6,  7,  7,  6,  5,  4,  3,  2,  1,  0
+		};
+
 		static constexpr uint8_t	SUB_SCORE_NUM = 8;  // サブスコア最大数
 		static constexpr uint8_t	STACK_DEPTH = 4;  // 4 レベル
 		static constexpr uint16_t	ENV_CYCLE = SAMPLE / TICK;
+		static constexpr uint16_t	BLOCK = 64;		// ミキサーのブロック・サイズ
+		static constexpr uint8_t	GAIN = 6;		// 8 ビット振幅から 16 ビットへのシフト
+		static constexpr uint8_t	NOISE_SHIFT = 4;	// ノイズ・クロック（音程周波数の 16 倍）
+
+		// polyBLEP 残差（Q16）、t: エッジからの位相、dt: 位相増分、rdt: (1 << 24) / dt
+		static int32_t blep_(uint16_t t, uint16_t dt, uint32_t rdt) noexcept
+		{
+			if(t < dt) {
+				uint32_t q = 65536 - ((static_cast<uint32_t>(t) * rdt) >> 8);
+				return -static_cast<int32_t>(((q >> 1) * (q >> 1)) >> 14);
+			}
+			uint16_t u = -t;
+			if(u < dt) {
+				uint32_t q = 65536 - ((static_cast<uint32_t>(u) * rdt) >> 8);
+				return static_cast<int32_t>(((q >> 1) * (q >> 1)) >> 14);
+			}
+			return 0;
+		}
 
 		struct share_t {
 			const SCORE*	sub_score_[SUB_SCORE_NUM];
@@ -294,6 +323,8 @@ namespace utils {
 			WTYPE		wtype_;
 			uint16_t	acc_;
 			uint16_t	spd_;
+			uint32_t	nacc_;
+			uint16_t	lfsr_;
 			const SCORE*	score_org_;
 			uint16_t	score_pos_;
 			uint8_t		tempo_;
@@ -311,7 +342,7 @@ namespace utils {
 			uint8_t		stack_pos_;
 			uint16_t	total_count_;
 			channel(share_t& share) noexcept : share_(share), volume_(0), fade_(0), fade_spd_(0), fade_cnt_(0),
-				wtype_(WTYPE::SQ50), acc_(0), spd_(0),
+				wtype_(WTYPE::SQ50), acc_(0), spd_(0), nacc_(0), lfsr_(1),
 				score_org_(nullptr), score_pos_(0),
 				tempo_(0), count_(0),
 				tr_(0), loop_org_(0), loop_cnt_(0),
@@ -335,66 +366,96 @@ namespace utils {
 				rel_frame_ = 6; // リリース TICK 標準
 			}
 
-			void update() noexcept
+			void envelope_() noexcept
 			{
-				acc_ += spd_;
+				if(rel_count_ > 0) {
+					rel_count_--;
+					// +エンベロープ
+					env_ += static_cast<uint16_t>((volume_ - env_) * attack_) >> 8;
+				} else {
+					// -エンベロープ
+					uint8_t n = static_cast<uint16_t>(env_ * release_) >> 8;
+					if(n > 0) env_ -= n;
+					else {
+						if(env_ > 0) --env_;
+					}
+				}
 			}
 
-			int8_t get() noexcept
+			void square_(int32_t* sum, uint16_t n, int32_t a, uint16_t thr) noexcept
 			{
-				if(spd_ == 0) return 0;
-
-				bool on = false;
-				int8_t w = 0;
-				switch(wtype_) {
-				case WTYPE::SQ25:
-					if((acc_ & 0xc000) >= 0xc000) on = true;
-					// 矩形波は、三角波に比べて、音圧が高いので、バランスを取る為少し弱める。
-					w = env_ - (env_ >> 3);
-					break;
-				case WTYPE::SQ50:
-					if((acc_ & 0xc000) >= 0x8000) on = true;
-					// 矩形波は、三角波に比べて、音圧が高いので、バランスを取る為少し弱める。
-					w = env_ - (env_ >> 3);
-					break;
-				case WTYPE::SQ75:
-					if((acc_ & 0xc000) >= 0x4000) on = true;
-					// 矩形波は、三角波に比べて、音圧が高いので、バランスを取る為少し弱める。
-					w = env_ - (env_ >> 3);
-					break;
-				case WTYPE::TRI:
-					{
-						w = (acc_ >> 11) & 0b111;
-						if((acc_ & 0x4000) != 0) w ^= 0b111;
-						w *= env_ >> 3;
-						if((acc_ & 0x8000) != 0) {
-							on = true;
-						}
+				uint16_t dt = spd_;
+				uint32_t rdt = (static_cast<uint32_t>(1) << 24) / dt;
+				uint16_t acc = acc_;
+				for(uint16_t i = 0; i < n; ++i) {
+					acc += dt;
+					int32_t v = acc >= thr ? a : -a;
+					int32_t r = blep_(acc - thr, dt, rdt) - blep_(acc, dt, rdt);
+					if(r != 0) v += (a * r) >> 16;
+					sum[i] += v;
+				}
+				acc_ = acc;
+			}
+
+			void triangle_(int32_t* sum, uint16_t n, int32_t a) noexcept
+			{
+				uint16_t acc = acc_;
+				for(uint16_t i = 0; i < n; ++i) {
+					acc += spd_;
+					sum[i] += tri_tbl_[acc >> 11] * a;
+				}
+				acc_ = acc;
+			}
+
+			void noise_(int32_t* sum, uint16_t n, int32_t a) noexcept
+			{
+				uint32_t step = static_cast<uint32_t>(spd_) << NOISE_SHIFT;
+				uint32_t nacc = nacc_;
+				uint16_t lfsr = lfsr_;
+				for(uint16_t i = 0; i < n; ++i) {
+					nacc += step;
+					while(nacc >= 65536) {
+						nacc -= 65536;
+						uint16_t fb = (lfsr ^ (lfsr >> 1)) & 1;
+						lfsr = (lfsr >> 1) | (fb << 14);
 					}
-					break;
-				case WTYPE::NOISE:
-					w = 0;
-					break;
+					sum[i] += (lfsr & 1) ? a : -a;
 				}
-				if(!on) { w = -w; }
+				nacc_ = nacc;
+				lfsr_ = lfsr;
+			}
 
-				++env_cycle_;
-				if(env_cycle_ >= ENV_CYCLE) {
-					env_cycle_ = 0;
-					if(rel_count_ > 0) {
-						rel_count_--;
-						// +エンベロープ
-						env_ += static_cast<uint16_t>((volume_ - env_) * attack_) >> 8;
-					} else {
-						// -エンベロープ
-						uint8_t n = static_cast<uint16_t>(env_ * release_) >> 8;
-						if(n > 0) env_ -= n;
-						else {
-							if(env_ > 0) --env_;
-						}
+			// エンベロープ更新まで振幅は一定なので、その区間をまとめて生成
+			void render(int32_t* sum, uint16_t len) noexcept
+			{
+				if(spd_ == 0) return;
+
+				while(len > 0) {
+					uint16_t n = ENV_CYCLE - env_cycle_;
+					if(n > len) n = len;
+					switch(wtype_) {
+					case WTYPE::SQ25:
+					case WTYPE::SQ50:
+					case WTYPE::SQ75:
+						// 矩形波は、三角波に比べて、音圧が高いので、バランスを取る為少し弱める。
+						square_(sum, n, static_cast<int32_t>(env_ - (env_ >> 3)) << GAIN,
+							duty_tbl_[static_cast<uint8_t>(wtype_)]);
+						break;
+					case WTYPE::TRI:
+						triangle_(sum, n, static_cast<int32_t>(env_ >> 3) << GAIN);
+						break;
+					case WTYPE::NOISE:
+						noise_(sum, n, static_cast<int32_t>(env_ - (env_ >> 2)) << GAIN);
+						break;
+					}
+					sum += n;
+					len -= n;
+					env_cycle_ += n;
+					if(env_cycle_ >= ENV_CYCLE) {
+						env_cycle_ = 0;
+						envelope_();
 					}
 				}
-				return w;
 			}
 
 			void set_freq(uint16_t frq) noexcept { spd_ = (static_cast<uint32_t>(frq) << 16) / SAMPLE; }
@@ -466,6 +527,9 @@ namespace utils {
 					case CTRL::TRI:
 						wtype_ = WTYPE::TRI;
 						break;
+					case CTRL::NOISE:
+						wtype_ = WTYPE::NOISE;
+						break;
 					case CTRL::VOLUME:
 						volume_ = score_org_[score_pos_].len;
 						++score_pos_;
@@ -581,13 +645,13 @@ namespace utils {
 		/*!
 			@brief  ボリュームの設定
 			@param[in]	ch		チャネル番号
-			@param[in]	vol		ボリューム（0 to 15）	
+			@param[in]	vol		ボリューム（0 to 128）
 		*/
 		//-----------------------------------------------------------------//
 		void set_volume(uint8_t ch, uint8_t vol) noexcept
 		{
 			if(ch >= CNUM) return;
-			channel_[ch].vol_ = vol & 15;
+			channel_[ch].volume_ = vol;
 		}
 
 
@@ -625,26 +689,76 @@ namespace utils {
 
 		//-----------------------------------------------------------------//
 		/*!
-			@brief  レンダリング
+			@brief  レンダリング（16 ビット）
 			@param[in]	count	波形数
 			@param[out]	out		波形出力
 		*/
 		//-----------------------------------------------------------------//
-		void render(uint16_t count, int8_t* out) noexcept
+		void render(uint16_t count, int16_t* out) noexcept
 		{
-			for(uint16_t i = 0; i < count; ++i) {
-				int16_t sum = 0;
-				// int8_t n = 0;
-				int8_t n = 1;  // 理由がイマイチ判らないが、フルスケールで合成するとノイズが乗るので、とりあえず、全体のゲインを下げる。
-				// ノイズが乗る原因は、そもそも PWM 変調に問題があるのかもしれない・・
+			int32_t sum[BLOCK];
+			while(count > 0) {
+				uint16_t n = count > BLOCK ? BLOCK : count;
+				for(uint16_t i = 0; i < n; ++i) sum[i] = 0;
 				for(uint8_t j = 0; j < CNUM; ++j) {
 					if(channel_[j].score_org_ != nullptr) {
-						channel_[j].update();
-						sum += static_cast<int16_t>(channel_[j].get());
-						++n;
+						channel_[j].render(sum, n);
 					}
 				}
-				out[i] = (sum / n);
+				for(uint16_t i = 0; i < n; ++i) {
+					auto v = sum[i];
+					if(v > 32767) v = 32767;
+					else if(v < -32768) v = -32768;
+					out[i] = v;
+				}
+				out += n;
+				count -= n;
+			}
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief  レンダリング（8 ビット）
+			@param[in]	count	波形数
+			@param[out]	out		波形出力
+		*/
+		//-----------------------------------------------------------------//
+		void render(uint16_t count, int8_t* out) noexcept
+		{
+			int16_t tmp[BLOCK];
+			while(count > 0) {
+				uint16_t n = count > BLOCK ? BLOCK : count;
+				render(n, tmp);
+				for(uint16_t i = 0; i < n; ++i) {
+					out[i] = tmp[i] >> 8;
+				}
+				out += n;
+				count -= n;
+			}
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief  レンダリングして sound_out の FIFO へ書き込む
+			@param[in]	sout	sound::sound_out クラス
+			@param[in]	count	波形数
+		*/
+		//-----------------------------------------------------------------//
+		template <class SOUND_OUT>
+		void render_wave(SOUND_OUT& sout, uint16_t count) noexcept
+		{
+			int16_t tmp[BLOCK];
+			typename SOUND_OUT::WAVE t;
+			while(count > 0) {
+				uint16_t n = count > BLOCK ? BLOCK : count;
+				render(n, tmp);
+				for(uint16_t i = 0; i < n; ++i) {
+					t.l_ch = t.r_ch = tmp[i];
+					sout.at_fifo().put(t);
+				}
+				count -= n;
 			}
 		}
 
@@ -725,4 +839,8 @@ namespace utils {
 
 	template<uint16_t SAMPLE, uint16_t TICK, uint16_t CNUM>
 		constexpr uint16_t psg_mng<SAMPLE, TICK, CNUM>::key_tbl_[12];
+	template<uint16_t SAMPLE, uint16_t TICK, uint16_t CNUM>
+		constexpr uint16_t psg_mng<SAMPLE, TICK, CNUM>::duty_tbl_[3];
+	template<uint16_t SAMPLE, uint16_t TICK, uint16_t CNUM>
+		constexpr int8_t psg_mng<SAMPLE, TICK, CNUM>::tri_tbl_[32];
 }
\ No newline at end of file
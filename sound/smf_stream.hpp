@@ -0,0 +1,659 @@
+#pragma once
+//=====================================================================//
+/*!	@file
+	@brief	SMF (Standard MIDI File) ストリーム・クラス @n
+			・ロード時に全トラックを１回だけ解析し、時間順にマージした @n
+			  イベント列（デルタ・マイクロ秒＋メッセージ）をバッファに展開する。@n
+			・テンポ・マップはロード時にマイクロ秒へ変換済みなので、再生は @n
+			  バッファを先頭から読むだけでファイル・アクセスは発生しない。@n
+			・バッファに収まらない場合は、トラック毎の先読みウィンドウから @n
+			  再生中にマージするストリーミング動作に切り替わる。
+    @author 平松邦仁 (hira@rvf-rc45.net)
+	@copyright	Copyright (C) 2021 Kunihito Hiramatsu @n
+				Released under the MIT license @n
+				https://github.com/hirakuni45/RX/blob/master/LICENSE
+*/
+//=====================================================================//
+#include <cstring>
+#include <functional>
+#include "common/file_io.hpp"
+
+namespace sound {
+
+	//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+	/*!
+		@brief	SMF ストリーム・クラス
+		@param[in]	TNUM	最大トラック数
+		@param[in]	WSIZE	トラック毎の先読みウィンドウ・サイズ
+	*/
+	//+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++//
+	template <uint32_t TNUM = 16, uint32_t WSIZE = 128>
+	class smf_stream {
+	public:
+
+		//=============================================================//
+		/*!
+			@brief	MIDI メッセージ・タスク型 @n
+					msg: ステータス（チャネル含む）＋データ、len: バイト数
+		*/
+		//=============================================================//
+		typedef std::function<void (const uint8_t* msg, uint32_t len)> MIDI_TASK;
+
+
+		//=============================================================//
+		/*!
+			@brief	SYSEX タスク型 @n
+					data: 0xF0 を含むデータ（0xF7 のエスケープは含まない）
+		*/
+		//=============================================================//
+		typedef std::function<void (const uint8_t* data, uint32_t len)> SYSEX_TASK;
+
+
+		//=============================================================//
+		/*!
+			@brief	META タスク型
+		*/
+		//=============================================================//
+		typedef std::function<void (uint8_t type, const uint8_t* data, uint32_t len)> META_TASK;
+
+
+		//=============================================================//
+		/*!
+			@brief	動作モード
+		*/
+		//=============================================================//
+		enum class MODE : uint8_t {
+			NONE,		///< 未ロード
+			MEMORY,		///< バッファに展開済み
+			STREAM,		///< トラック毎の先読みでストリーミング
+		};
+
+	private:
+		static const uint32_t META_MAX = 64;	///< META、SYSEX を通知する最大長
+
+		struct track_t {
+			uint32_t	org_;		///< ファイル上のトラック先頭
+			uint32_t	len_;		///< トラック長
+			uint32_t	pos_;		///< 次にウィンドウへ読み込む位置
+			uint32_t	tick_;		///< 次のイベントの絶対 tick
+			uint16_t	bpos_;
+			uint16_t	blen_;
+			uint8_t		status_;	///< ランニング・ステータス
+			bool		end_;
+			uint8_t		buf_[WSIZE];
+		};
+
+		// マージ済みイベント
+		struct event_t {
+			uint32_t	time_;		///< 絶対時間 [us]
+			uint8_t		type_;		///< ステータス、0xF0/0xF7: SYSEX、0xFF: META
+			uint8_t		meta_;		///< META タイプ
+			uint32_t	len_;		///< data_ の有効長
+			uint32_t	org_len_;	///< 元の長さ（SYSEX/META）
+			uint8_t		data_[META_MAX];
+		};
+
+		utils::file_io	fio_;
+
+		track_t		track_[TNUM];
+		uint32_t	track_num_;
+
+		uint16_t	division_;		///< tick / 四分音符（SMPTE の場合 tick / 秒）
+		bool		smpte_;
+		uint32_t	tempo_;			///< us / 四分音符
+		uint32_t	last_tick_;
+		uint32_t	time_;			///< マージ位置の絶対時間 [us]
+		uint32_t	time_rem_;
+
+		uint8_t*	buf_;
+		uint32_t	buf_size_;
+		uint32_t	buf_len_;		///< 展開済みバイト数
+		uint32_t	buf_pos_;
+
+		MODE		mode_;
+		uint32_t	event_num_;
+
+		event_t		ev_;
+		bool		ev_valid_;
+		uint32_t	ev_time_;		///< 再生中イベントの絶対時間 [us]
+
+		uint32_t	start_;			///< 再生開始時刻 [us]
+		uint32_t	pause_;
+		bool		started_;
+		bool		paused_;
+		bool		meta_ena_;
+
+		MIDI_TASK	midi_task_;
+		SYSEX_TASK	sysex_task_;
+		META_TASK	meta_task_;
+
+		static uint32_t get32_(const uint8_t* p) noexcept {
+			return (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16)
+				| (static_cast<uint32_t>(p[2]) << 8) | p[3];
+		}
+
+		static uint16_t get16_(const uint8_t* p) noexcept {
+			return (static_cast<uint16_t>(p[0]) << 8) | p[1];
+		}
+
+		// トラックから１バイト（ウィンドウが空なら次の WSIZE を読む）
+		bool getc_(track_t& t, uint8_t& ch) noexcept
+		{
+			if(t.bpos_ >= t.blen_) {
+				if(t.pos_ >= t.len_) return false;
+				uint32_t n = t.len_ - t.pos_;
+				if(n > WSIZE) n = WSIZE;
+				if(!fio_.seek(utils::file_io::SEEK::SET, t.org_ + t.pos_)) return false;
+				if(fio_.read(t.buf_, n) != n) return false;
+				t.pos_ += n;
+				t.bpos_ = 0;
+				t.blen_ = n;
+			}
+			ch = t.buf_[t.bpos_];
+			++t.bpos_;
+			return true;
+		}
+
+		bool get_var_(track_t& t, uint32_t& val) noexcept
+		{
+			val = 0;
+			for(uint32_t i = 0; i < 4; ++i) {
+				uint8_t ch;
+				if(!getc_(t, ch)) return false;
+				val = (val << 7) | (ch & 0x7f);
+				if((ch & 0x80) == 0) return true;
+			}
+			return false;
+		}
+
+		// 次のイベントのデルタ時間を読んで絶対 tick を進める
+		void next_delta_(track_t& t) noexcept
+		{
+			uint32_t dt;
+			if(!get_var_(t, dt)) {
+				t.end_ = true;
+				return;
+			}
+			t.tick_ += dt;
+		}
+
+		void rewind_() noexcept
+		{
+			for(uint32_t i = 0; i < track_num_; ++i) {
+				auto& t = track_[i];
+				t.pos_ = 0;
+				t.tick_ = 0;
+				t.bpos_ = 0;
+				t.blen_ = 0;
+				t.status_ = 0;
+				t.end_ = false;
+				next_delta_(t);
+			}
+			tempo_ = smpte_ ? 1'000'000 : 500'000;
+			last_tick_ = 0;
+			time_ = 0;
+			time_rem_ = 0;
+		}
+
+		// tick を絶対時間 [us] に変換（端数を持ち越して誤差を蓄積させない）
+		void advance_(uint32_t tick) noexcept
+		{
+			uint64_t n = static_cast<uint64_t>(tick - last_tick_) * tempo_ + time_rem_;
+			time_ += n / division_;
+			time_rem_ = n % division_;
+			last_tick_ = tick;
+		}
+
+		// 全トラックから時間順に次のイベントを取り出す（同時刻はトラック番号順）
+		bool merge_(event_t& ev) noexcept
+		{
+			for(;;) {
+				track_t* t = nullptr;
+				for(uint32_t i = 0; i < track_num_; ++i) {
+					if(track_[i].end_) continue;
+					if(t == nullptr || track_[i].tick_ < t->tick_) t = &track_[i];
+				}
+				if(t == nullptr) return false;
+
+				advance_(t->tick_);
+				ev.time_ = time_;
+				bool ret = parse_(*t, ev);
+				if(!t->end_) next_delta_(*t);
+				if(ret) return true;
+			}
+		}
+
+		bool skip_(track_t& t, uint32_t len, event_t& ev) noexcept
+		{
+			ev.org_len_ = len;
+			ev.len_ = 0;
+			for(uint32_t i = 0; i < len; ++i) {
+				uint8_t ch;
+				if(!getc_(t, ch)) return false;
+				if(ev.len_ < META_MAX) {
+					ev.data_[ev.len_] = ch;
+					++ev.len_;
+				}
+			}
+			return true;
+		}
+
+		// イベントを解析、通知不要なイベントの場合「false」
+		bool parse_(track_t& t, event_t& ev) noexcept
+		{
+			uint8_t ch;
+			if(!getc_(t, ch)) { t.end_ = true; return false; }
+
+			if(ch < 0x80) {  // ランニング・ステータス
+				if(t.status_ == 0) { t.end_ = true; return false; }
+				ev.data_[0] = ch;
+				ch = t.status_;
+				ev.len_ = 1;
+			} else {
+				ev.len_ = 0;
+			}
+
+			if(ch >= 0x80 && ch <= 0xef) {
+				t.status_ = ch;
+				ev.type_ = ch;
+				uint32_t n = ((ch & 0xe0) == 0xc0) ? 1 : 2;
+				while(ev.len_ < n) {
+					if(!getc_(t, ev.data_[ev.len_])) { t.end_ = true; return false; }
+					++ev.len_;
+				}
+				ev.org_len_ = n;
+				return true;
+			} else if(ch == 0xf0 || ch == 0xf7) {
+				t.status_ = 0;
+				uint32_t len;
+				if(!get_var_(t, len)) { t.end_ = true; return false; }
+				ev.type_ = ch;
+				if(!skip_(t, len, ev)) { t.end_ = true; return false; }
+				return true;
+			} else if(ch == 0xff) {
+				t.status_ = 0;
+				uint8_t type;
+				uint32_t len;
+				if(!getc_(t, type) || !get_var_(t, len)) { t.end_ = true; return false; }
+				ev.type_ = ch;
+				ev.meta_ = type;
+				if(!skip_(t, len, ev)) { t.end_ = true; return false; }
+				if(type == 0x2f) {
+					t.end_ = true;
+					return false;
+				} else if(type == 0x51 && ev.len_ >= 3 && !smpte_) {
+					tempo_ = (static_cast<uint32_t>(ev.data_[0]) << 16)
+						| (static_cast<uint32_t>(ev.data_[1]) << 8) | ev.data_[2];
+				}
+				return meta_ena_;
+			}
+			t.end_ = true;  // 不明なイベント
+			return false;
+		}
+
+		// 圧縮形式：<デルタ us:可変長> <ステータス> <データ> @n
+		//   SYSEX: <F0/F7> <長さ:可変長> <データ> @n
+		//   META:  <FF> <タイプ> <長さ:可変長> <データ>
+		bool put_var_(uint32_t val) noexcept
+		{
+			uint8_t tmp[5];
+			uint32_t n = 0;
+			tmp[4 - n] = val & 0x7f;
+			++n;
+			while((val >>= 7) != 0) {
+				tmp[4 - n] = (val & 0x7f) | 0x80;
+				++n;
+			}
+			if((buf_len_ + n) > buf_size_) return false;
+			memcpy(&buf_[buf_len_], &tmp[5 - n], n);
+			buf_len_ += n;
+			return true;
+		}
+
+		bool put_(const uint8_t* src, uint32_t len) noexcept
+		{
+			if((buf_len_ + len) > buf_size_) return false;
+			memcpy(&buf_[buf_len_], src, len);
+			buf_len_ += len;
+			return true;
+		}
+
+		bool encode_(const event_t& ev, uint32_t dt) noexcept
+		{
+			if(!put_var_(dt)) return false;
+			if(!put_(&ev.type_, 1)) return false;
+			if(ev.type_ == 0xff) {
+				if(!put_(&ev.meta_, 1)) return false;
+				if(!put_var_(ev.len_)) return false;
+			} else if(ev.type_ == 0xf0 || ev.type_ == 0xf7) {
+				if(!put_var_(ev.len_)) return false;
+			}
+			return put_(ev.data_, ev.len_);
+		}
+
+		uint32_t get_var_(uint32_t& pos) const noexcept
+		{
+			uint32_t val = 0;
+			uint8_t ch;
+			do {
+				ch = buf_[pos];
+				++pos;
+				val = (val << 7) | (ch & 0x7f);
+			} while(ch & 0x80) ;
+			return val;
+		}
+
+		bool decode_(event_t& ev) noexcept
+		{
+			if(buf_pos_ >= buf_len_) return false;
+			uint32_t dt = get_var_(buf_pos_);
+			ev.time_ = ev_time_ + dt;
+			ev.type_ = buf_[buf_pos_];
+			++buf_pos_;
+			if(ev.type_ == 0xff) {
+				ev.meta_ = buf_[buf_pos_];
+				++buf_pos_;
+				ev.len_ = get_var_(buf_pos_);
+			} else if(ev.type_ == 0xf0 || ev.type_ == 0xf7) {
+				ev.len_ = get_var_(buf_pos_);
+			} else {
+				ev.len_ = ((ev.type_ & 0xe0) == 0xc0) ? 1 : 2;
+			}
+			ev.org_len_ = ev.len_;
+			memcpy(ev.data_, &buf_[buf_pos_], ev.len_);
+			buf_pos_ += ev.len_;
+			return true;
+		}
+
+		bool fetch_() noexcept
+		{
+			if(mode_ == MODE::MEMORY) {
+				ev_valid_ = decode_(ev_);
+			} else if(mode_ == MODE::STREAM) {
+				ev_valid_ = merge_(ev_);
+			} else {
+				ev_valid_ = false;
+			}
+			if(ev_valid_) ev_time_ = ev_.time_;
+			return ev_valid_;
+		}
+
+		void dispatch_(const event_t& ev) noexcept
+		{
+			if(ev.type_ == 0xff) {
+				if(meta_task_) meta_task_(ev.meta_, ev.data_, ev.len_);
+			} else if(ev.type_ == 0xf0 || ev.type_ == 0xf7) {
+				if(sysex_task_) {
+					uint8_t tmp[META_MAX + 1];
+					uint32_t n = 0;
+					if(ev.type_ == 0xf0) tmp[n++] = 0xf0;
+					memcpy(&tmp[n], ev.data_, ev.len_);
+					sysex_task_(tmp, n + ev.len_);
+				}
+			} else {
+				if(midi_task_) {
+					uint8_t tmp[3];
+					tmp[0] = ev.type_;
+					tmp[1] = ev.data_[0];
+					tmp[2] = ev.data_[1];
+					midi_task_(tmp, 1 + ev.len_);
+				}
+			}
+		}
+
+	public:
+		//-------------------------------------------------------------//
+		/*!
+			@brief	コンストラクター
+			@param[in]	buf		イベント展開バッファ（外部 RAM でも良い）
+			@param[in]	size	バッファのサイズ
+		*/
+		//-------------------------------------------------------------//
+		smf_stream(void* buf = nullptr, uint32_t size = 0) noexcept :
+			fio_(), track_(), track_num_(0),
+			division_(48), smpte_(false), tempo_(500'000), last_tick_(0), time_(0), time_rem_(0),
+			buf_(static_cast<uint8_t*>(buf)), buf_size_(size), buf_len_(0), buf_pos_(0),
+			mode_(MODE::NONE), event_num_(0),
+			ev_(), ev_valid_(false), ev_time_(0),
+			start_(0), pause_(0), started_(false), paused_(false), meta_ena_(false),
+			midi_task_(), sysex_task_(), meta_task_()
+		{ }
+
+
+		//-------------------------------------------------------------//
+		/*!
+			@brief	MIDI タスクを設定
+			@param[in]	task	タスク
+		*/
+		//-------------------------------------------------------------//
+		void set_midi_task(MIDI_TASK task) noexcept { midi_task_ = task; }
+
+
+		//-------------------------------------------------------------//
+		/*!
+			@brief	SYSEX タスクを設定
+			@param[in]	task	タスク
+		*/
+		//-------------------------------------------------------------//
+		void set_sysex_task(SYSEX_TASK task) noexcept { sysex_task_ = task; }
+
+
+		//-------------------------------------------------------------//
+		/*!
+			@brief	META タスクを設定 @n
+					※ロード前に設定した場合のみ META イベントを保持する
+			@param[in]	task	タスク
+		*/
+		//-------------------------------------------------------------//
+		void set_meta_task(META_TASK task) noexcept { meta_task_ = task; }
+
+
+		//-------------------------------------------------------------//
+		/*!
+			@brief	ロード
+			@param[in]	fname	ファイル名
+			@return 成功なら「true」
+		*/
+		//-------------------------------------------------------------//
+		bool load(const char* fname) noexcept
+		{
+			close();
+			if(fname == nullptr || fname[0] == 0) return false;
+			if(!fio_.open(fname, "rb")) return false;
+
+			// header chunk = "MThd" + <length:4> + <format:2> + <num_tracks:2> + <division:2>
+			uint8_t hd[14];
+			if(fio_.read(hd, 14) != 14 || strncmp(reinterpret_cast<const char*>(hd), "MThd", 4) != 0
+				|| get32_(&hd[4]) != 6) {
+				fio_.close();
+				return false;
+			}
+			auto format = get16_(&hd[8]);
+			auto num = get16_(&hd[10]);
+			division_ = get16_(&hd[12]);
+			if(format > 1 || num == 0 || num > TNUM || (format == 0 && num != 1)) {
+				fio_.close();
+				return false;
+			}
+			smpte_ = (division_ & 0x8000) != 0;
+			if(smpte_) {  // SMPTE: tick / 秒として扱う
+				uint8_t fps = -static_cast<int8_t>(division_ >> 8);
+				division_ = fps * (division_ & 0xff);
+			}
+			if(division_ == 0) {
+				fio_.close();
+				return false;
+			}
+
+			uint32_t org = 8 + 6;
+			for(uint32_t i = 0; i < num; ++i) {
+				uint8_t th[8];
+				if(!fio_.seek(utils::file_io::SEEK::SET, org) || fio_.read(th, 8) != 8
+					|| strncmp(reinterpret_cast<const char*>(th), "MTrk", 4) != 0) {
+					fio_.close();
+					return false;
+				}
+				track_[i].org_ = org + 8;
+				track_[i].len_ = get32_(&th[4]);
+				org += 8 + track_[i].len_;
+			}
+			track_num_ = num;
+			meta_ena_ = static_cast<bool>(meta_task_);
+			restart();
+
+			// 全トラックをマージしてバッファへ展開
+			if(buf_ != nullptr && buf_size_ > 0) {
+				uint32_t t = 0;
+				bool ok = true;
+				while(merge_(ev_)) {
+					if(!encode_(ev_, ev_.time_ - t)) {
+						ok = false;
+						break;
+					}
+					t = ev_.time_;
+					++event_num_;
+				}
+				if(ok) {
+					fio_.close();
+					mode_ = MODE::MEMORY;
+					restart();
+					return true;
+				}
+				event_num_ = 0;
+				buf_len_ = 0;
+			}
+			mode_ = MODE::STREAM;
+			restart();
+			return true;
+		}
+
+
+		//-------------------------------------------------------------//
+		/*!
+			@brief	クローズ
+		*/
+		//-------------------------------------------------------------//
+		void close() noexcept
+		{
+			fio_.close();
+			mode_ = MODE::NONE;
+			track_num_ = 0;
+			buf_len_ = 0;
+			buf_pos_ = 0;
+			event_num_ = 0;
+			ev_valid_ = false;
+			started_ = false;
+			paused_ = false;
+		}
+
+
+		//-------------------------------------------------------------//
+		/*!
+			@brief	先頭から再生しなおす（次の service で時刻を同期）
+		*/
+		//-------------------------------------------------------------//
+		void restart() noexcept
+		{
+			if(mode_ != MODE::MEMORY) rewind_();
+			buf_pos_ = 0;
+			ev_time_ = 0;
+			started_ = false;
+			if(mode_ != MODE::NONE) fetch_();
+		}
+
+
+		//-------------------------------------------------------------//
+		/*!
+			@brief	一時停止
+			@param[in]	ena		「false」で再開
+			@param[in]	now		現在時刻 [us]
+		*/
+		//-------------------------------------------------------------//
+		void pause(bool ena, uint32_t now) noexcept
+		{
+			if(ena == paused_) return;
+			if(ena) pause_ = now;
+			else start_ += now - pause_;
+			paused_ = ena;
+		}
+
+
+		//-------------------------------------------------------------//
+		/*!
+			@brief	サービス（時刻に達したイベントを全て通知）
+			@param[in]	now		現在時刻 [us]（ラップアラウンド可）
+			@return 通知したイベント数
+		*/
+		//-------------------------------------------------------------//
+		uint32_t service(uint32_t now) noexcept
+		{
+			if(!ev_valid_ || paused_) return 0;
+			if(!started_) {
+				start_ = now;
+				started_ = true;
+			}
+			uint32_t t = now - start_;
+			uint32_t n = 0;
+			while(ev_valid_ && static_cast<int32_t>(t - ev_time_) >= 0) {
+				dispatch_(ev_);
+				++n;
+				fetch_();
+			}
+			return n;
+		}
+
+
+		//-------------------------------------------------------------//
+		/*!
+			@brief	終端か検査
+			@return 終端なら「true」
+		*/
+		//-------------------------------------------------------------//
+		bool is_eof() const noexcept { return !ev_valid_; }
+
+
+		//-------------------------------------------------------------//
+		/*!
+			@brief	動作モードを取得
+			@return 動作モード
+		*/
+		//-------------------------------------------------------------//
+		MODE get_mode() const noexcept { return mode_; }
+
+
+		//-------------------------------------------------------------//
+		/*!
+			@brief	トラック数を取得
+			@return トラック数
+		*/
+		//-------------------------------------------------------------//
+		uint32_t get_track_num() const noexcept { return track_num_; }
+
+
+		//-------------------------------------------------------------//
+		/*!
+			@brief	展開済みイベント数を取得（MEMORY モード）
+			@return イベント数
+		*/
+		//-------------------------------------------------------------//
+		uint32_t get_event_num() const noexcept { return event_num_; }
+
+
+		//-------------------------------------------------------------//
+		/*!
+			@brief	展開済みバイト数を取得（MEMORY モード）
+			@return バイト数
+		*/
+		//-------------------------------------------------------------//
+		uint32_t get_buffer_length() const noexcept { return buf_len_; }
+
+
+		//-------------------------------------------------------------//
+		/*!
+			@brief	次のイベントの時刻を取得（再生開始からの us）
+			@return 時刻
+		*/
+		//-------------------------------------------------------------//
+		uint32_t get_next_time() const noexcept { return ev_time_; }
+	};
+}
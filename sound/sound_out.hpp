@@ -75,6 +75,8 @@ namespace sound {
 		T			zero_ofs_;
 
 		volatile uint32_t	sample_count_;
+		volatile uint32_t	underrun_;
+		bool				run_;
 
 		WAVE		peak_level_;
 		uint16_t	peak_level_frame_;
@@ -103,7 +105,7 @@ namespace sound {
 		//-----------------------------------------------------------------//
 		sound_out(T zero_ofs) noexcept : w_put_(0), fifo_(),
 			out_rate_(48'000), inp_rate_(48'000), timebase_(0), wbase_(), zero_ofs_(zero_ofs),
-			sample_count_(0),
+			sample_count_(0), underrun_(0), run_(false),
 			peak_level_(0), peak_level_frame_(PEAK_LEVEL_FRAME), peak_level_count_(0) 
 		{ }
 
@@ -164,6 +166,7 @@ namespace sound {
 				wave_[i].set(zero_ofs_);
 			}
 			wbase_.set(0);
+			run_ = false;
 		}
 
 
@@ -212,8 +215,13 @@ namespace sound {
 					if(len > 0) {
 						t = fifo_.get();
 						--len;
+						run_ = true;
 					} else {
 						t.set(0);
+						if(run_) {
+							++underrun_;
+							run_ = false;
+						}
 					}
 					wave_[w_put_] = t;
 					wave_[w_put_].offset(zero_ofs_);
@@ -232,9 +240,14 @@ namespace sound {
 							wbase_ = fifo_.get();
 							next = fifo_.get_at();
 							--len;
+							run_ = true;
 						} else {
 							wbase_.set(0);
 							next.set(0);
+							if(run_) {
+								++underrun_;
+								run_ = false;
+							}
 						}
 					}
 //					wave_[w_put_] = WAVE::linear(out_rate_, timebase_, wbase_, next);
@@ -277,6 +290,16 @@ namespace sound {
 		auto get_sample_count() const noexcept { return sample_count_; }
 
 
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	アンダーラン回数の取得 @n
+					再生中に FIFO が空になった回数（mute 後は数えない）
+			@return アンダーラン回数
+		*/
+		//-----------------------------------------------------------------//
+		auto get_underrun() const noexcept { return underrun_; }
+
+
 		//-----------------------------------------------------------------//
 		/*!
 			@brief	ピークレベル・フレームの設定
@@ -64,7 +64,8 @@ namespace sound {
 		uint32_t	time_;
 
 
-		bool list_tag_(utils::file_io& fi, uint16_t size, char* dst, uint32_t dstlen) noexcept
+		template <class FIN>
+		bool list_tag_(FIN& fi, uint16_t size, char* dst, uint32_t dstlen) noexcept
 		{
 			while(size > 0) {
 				char ch = 0;
@@ -100,7 +101,8 @@ namespace sound {
 			@return エラーなら「false」を返す
 		*/
 		//-----------------------------------------------------------------//
-		bool probe(utils::file_io& fin) noexcept 
+		template <class FIN>
+		bool probe(FIN& fin) noexcept 
 		{
 			auto org = fin.tell();
 			WAVEFILEHEADER wh;
@@ -123,7 +125,8 @@ namespace sound {
 			@param[in]	tag		タグの参照
 		*/
 		//-------------------------------------------------------------//
-		bool load_header(utils::file_io& fi, tag_t& tag) noexcept
+		template <class FIN>
+		bool load_header(FIN& fi, tag_t& tag) noexcept
 		{
 			uint32_t ofs = 0;
 			{
@@ -227,7 +230,8 @@ namespace sound {
 			@return 正常なら「true」
 		*/
 		//-----------------------------------------------------------------//
-		bool info(utils::file_io& fin, audio_info& info) noexcept
+		template <class FIN>
+		bool info(FIN& fin, audio_info& info) noexcept
 		{
 			set_state(STATE::TAG);
 			tag_t tag;
@@ -236,7 +240,7 @@ namespace sound {
 				return false;
 			}
 			if(tag_task_) {
-				tag_task_(fin, tag);
+				tag_task_(tag_file(fin), tag);
 			}
 
 			info.type = audio_format::NONE;
@@ -280,8 +284,8 @@ namespace sound {
 			@return 正常終了なら「true」
 		*/
 		//-------------------------------------------------------------//
-		template <class SOUND_OUT>
-		bool decode(utils::file_io& fin, SOUND_OUT& out) noexcept
+		template <class FIN, class SOUND_OUT>
+		bool decode(FIN& fin, SOUND_OUT& out) noexcept
 		{
 			bool status = true;
 			bool pause = false;
@@ -304,6 +308,7 @@ namespace sound {
 				} else if(ctrl == CTRL::REPLAY) {
 					out.mute();
 					fin.seek(utils::file_io::SEEK::SET, data_top_);
+					data_pos_ = 0;
 					pos = 0;
 					time_ = 0;
 					status = true;
@@ -323,7 +328,11 @@ namespace sound {
 
 				uint32_t unit = (bits_ / 8) * channel_;
 				uint8_t tmp[1024];
-				if(fin.read(tmp, unit * 256) != (unit * 256)) {
+				// 最後の半端なブロックも出力する（曲間を詰める為）
+				uint32_t req = unit * 256;
+				if(req > (data_size_ - data_pos_)) req = data_size_ - data_pos_;
+				uint32_t num = fin.read(tmp, req) / unit;
+				if(num == 0) {
 //					utils::format("Read fail abort...\n");
 					out.mute();
 //					status = false;
@@ -331,7 +340,7 @@ namespace sound {
 				}
 				if(bits_ == 16) {
 					const uint16_t* src = reinterpret_cast<const uint16_t*>(tmp);
-					for(uint32_t i = 0; i < 256; ++i) {
+					for(uint32_t i = 0; i < num; ++i) {
 						while((out.at_fifo().size() - out.at_fifo().length()) < 64) {
 							system_delay(1);
 						}
@@ -350,7 +359,7 @@ namespace sound {
 					}
 				} else {  // 8 bits
 					const uint8_t* src = reinterpret_cast<const uint8_t*>(tmp);
-					for(uint32_t i = 0; i < 256; ++i) {
+					for(uint32_t i = 0; i < num; ++i) {
 						while((out.at_fifo().size() - out.at_fifo().length()) < 64) {
 							system_delay(1);
 						}
@@ -381,7 +390,7 @@ namespace sound {
 						time_ = s;
 					}
 				}
-				data_pos_ += unit;
+				data_pos_ += num * unit;
 			}
 			set_state(STATE::IDLE);
 			return status;
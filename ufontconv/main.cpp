@@ -0,0 +1,539 @@
+//=====================================================================//
+/*!	@file
+	@brief	Unicode フォント・コンバーター @n
+			・BDF（ISO10646）、TTF/OTF（FreeType によるラスタライズ）を読み、@n
+			  graphics::ufont 形式（graphics/ufont.hpp）のファイルを作成する @n
+			・引数毎に一つのフェイス（サイズ）、「+」でつないだソースは一つの @n
+			  フェイスにまとめる（先に指定したソースが優先）@n
+			・グリフは空白の行、列を削ってベアリングに変換し、生データと RLE の @n
+			  小さい方で格納する
+    @author 平松邦仁 (hira@rvf-rc45.net)
+	@copyright	Copyright (C) 2021 Kunihito Hiramatsu @n
+				Released under the MIT license @n
+				https://github.com/hirakuni45/RX/blob/master/LICENSE
+*/
+//=====================================================================//
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <cctype>
+#include <string>
+#include <vector>
+#include <map>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include "graphics/ufont.hpp"
+
+#ifdef USE_FREETYPE
+#include <ft2build.h>
+#include FT_FREETYPE_H
+#endif
+
+namespace {
+
+	static const char* version_ = "0.50b";
+
+	typedef graphics::ufont_def DEF;
+
+	static_assert(sizeof(DEF::header_t) == 16, "header_t size");
+	static_assert(sizeof(DEF::face_t) == 32, "face_t size");
+	static_assert(sizeof(DEF::page_t) == 36, "page_t size");
+	static_assert(sizeof(DEF::glyph_t) == 12, "glyph_t size");
+
+	// ファイル・ソースで一度に読めるバイト数（ufont_file のデフォルト TSIZE）
+	static const uint32_t TEMP_SIZE = 512 * 2;
+
+	struct glyph_t {
+		int16_t		adv;
+		int16_t		bx;
+		int16_t		top;	///< ベースラインからビットマップ上端まで（上が正）
+		int16_t		w;
+		int16_t		h;
+		std::vector<uint8_t>	pix;	///< 階調（0 to 3）
+	};
+
+	typedef std::map<uint16_t, glyph_t> GLYPHS;
+
+	struct face_t {
+		int16_t		ascent;
+		int16_t		descent;
+		GLYPHS		glyphs;
+		face_t() : ascent(0), descent(0) { }
+	};
+
+	struct range_t {
+		uint32_t	org;
+		uint32_t	end;
+	};
+
+	std::vector<range_t>	ranges_;
+	bool					aa_ = false;
+	bool					verbose_ = false;
+
+
+	bool in_range_(uint32_t code)
+	{
+		if(code == 0 || code > 0xffff) return false;
+		if(ranges_.empty()) return true;
+		for(const auto& r : ranges_) {
+			if(r.org <= code && code <= r.end) return true;
+		}
+		return false;
+	}
+
+
+	bool parse_ranges_(const std::string& s)
+	{
+		std::stringstream ss(s);
+		std::string t;
+		while(std::getline(ss, t, ',')) {
+			range_t r;
+			char* e;
+			r.org = strtoul(t.c_str(), &e, 0);
+			if(*e == '-') r.end = strtoul(e + 1, &e, 0);
+			else r.end = r.org;
+			if(*e != 0 || r.end < r.org) return false;
+			ranges_.push_back(r);
+		}
+		return true;
+	}
+
+
+	// 空白の行、列を削る
+	void trim_(glyph_t& g)
+	{
+		int16_t x0 = g.w, x1 = -1, y0 = g.h, y1 = -1;
+		for(int16_t y = 0; y < g.h; ++y) {
+			for(int16_t x = 0; x < g.w; ++x) {
+				if(g.pix[y * g.w + x] == 0) continue;
+				if(x < x0) x0 = x;
+				if(x > x1) x1 = x;
+				if(y < y0) y0 = y;
+				if(y > y1) y1 = y;
+			}
+		}
+		if(x1 < 0) {
+			g.w = g.h = 0;
+			g.bx = g.top = 0;
+			g.pix.clear();
+			return;
+		}
+		std::vector<uint8_t> t;
+		for(int16_t y = y0; y <= y1; ++y) {
+			for(int16_t x = x0; x <= x1; ++x) t.push_back(g.pix[y * g.w + x]);
+		}
+		g.bx += x0;
+		g.top -= y0;
+		g.w = x1 - x0 + 1;
+		g.h = y1 - y0 + 1;
+		g.pix.swap(t);
+	}
+
+
+	bool load_bdf_(const std::string& file, face_t& face)
+	{
+		std::ifstream ifs(file);
+		if(!ifs) {
+			std::cerr << "Can't open BDF: '" << file << "'" << std::endl;
+			return false;
+		}
+		std::string line;
+		int ascent = -1, descent = -1, bbh = 0, bby = 0;
+		int32_t code = -1;
+		glyph_t g;
+		int row = -1;
+		uint32_t n = 0;
+		while(std::getline(ifs, line)) {
+			while(!line.empty() && (line.back() == '\r' || line.back() == '\n')) line.pop_back();
+			std::stringstream ss(line);
+			std::string key;
+			ss >> key;
+			if(row >= 0) {
+				if(key == "ENDCHAR") {
+					row = -1;
+					if(in_range_(code) && face.glyphs.find(code) == face.glyphs.end()) {
+						trim_(g);
+						face.glyphs[code] = g;
+						++n;
+					}
+				} else if(row < g.h) {
+					for(int16_t x = 0; x < g.w; ++x) {
+						auto ch = key[x / 4];
+						int v = isdigit(ch) ? ch - '0' : (toupper(ch) - 'A' + 10);
+						g.pix[row * g.w + x] = ((v >> (3 - (x & 3))) & 1) * (aa_ ? 3 : 1);
+					}
+					++row;
+				}
+			} else if(key == "CHARSET_REGISTRY") {
+				std::string reg;
+				ss >> reg;
+				if(reg.find("ISO10646") == std::string::npos && reg.find("ISO8859") == std::string::npos) {
+					std::cerr << "Not a Unicode BDF (" << reg << "): '" << file << "'" << std::endl;
+					return false;
+				}
+			} else if(key == "FONT_ASCENT") {
+				ss >> ascent;
+			} else if(key == "FONT_DESCENT") {
+				ss >> descent;
+			} else if(key == "FONTBOUNDINGBOX") {
+				int w, x;
+				ss >> w >> bbh >> x >> bby;
+			} else if(key == "ENCODING") {
+				ss >> code;
+			} else if(key == "DWIDTH") {
+				ss >> g.adv;
+			} else if(key == "BBX") {
+				int x, y;
+				ss >> g.w >> g.h >> x >> y;
+				g.bx = x;
+				g.top = y + g.h;
+				g.pix.assign(g.w * g.h, 0);
+			} else if(key == "BITMAP") {
+				row = 0;
+			}
+		}
+		if(ascent < 0) ascent = bbh + bby;
+		if(descent < 0) descent = -bby;
+		if(face.ascent < ascent) face.ascent = ascent;
+		if(face.descent < descent) face.descent = descent;
+		if(verbose_) {
+			printf("  %s: %u glyphs, ascent %d, descent %d\n", file.c_str(), n, ascent, descent);
+		}
+		return true;
+	}
+
+
+#ifdef USE_FREETYPE
+	bool load_ttf_(const std::string& file, int size, face_t& face)
+	{
+		static FT_Library lib = nullptr;
+		if(lib == nullptr && FT_Init_FreeType(&lib) != 0) return false;
+		FT_Face ftf;
+		if(FT_New_Face(lib, file.c_str(), 0, &ftf) != 0) {
+			std::cerr << "Can't open font: '" << file << "'" << std::endl;
+			return false;
+		}
+		FT_Set_Pixel_Sizes(ftf, 0, size);
+		int ascent = (ftf->size->metrics.ascender + 63) >> 6;
+		int descent = (-ftf->size->metrics.descender + 63) >> 6;
+		uint32_t n = 0;
+		FT_UInt idx;
+		for(FT_ULong code = FT_Get_First_Char(ftf, &idx); idx != 0; code = FT_Get_Next_Char(ftf, code, &idx)) {
+			if(!in_range_(code) || face.glyphs.find(code) != face.glyphs.end()) continue;
+			auto flag = FT_LOAD_RENDER | (aa_ ? FT_LOAD_TARGET_NORMAL : (FT_LOAD_TARGET_MONO | FT_LOAD_MONOCHROME));
+			if(FT_Load_Glyph(ftf, idx, flag) != 0) continue;
+			const auto* slot = ftf->glyph;
+			const auto& bm = slot->bitmap;
+			glyph_t g;
+			g.adv = (slot->advance.x + 32) >> 6;
+			g.bx = slot->bitmap_left;
+			g.top = slot->bitmap_top;
+			g.w = bm.width;
+			g.h = bm.rows;
+			g.pix.assign(g.w * g.h, 0);
+			for(int16_t y = 0; y < g.h; ++y) {
+				const uint8_t* src = bm.buffer + y * bm.pitch;
+				for(int16_t x = 0; x < g.w; ++x) {
+					uint8_t v;
+					if(bm.pixel_mode == FT_PIXEL_MODE_MONO) {
+						v = (src[x >> 3] >> (7 - (x & 7))) & 1;
+						if(aa_) v *= 3;
+					} else {
+						v = aa_ ? (src[x] * 3 + 127) / 255 : (src[x] >= 128);
+					}
+					g.pix[y * g.w + x] = v;
+				}
+			}
+			trim_(g);
+			face.glyphs[code] = g;
+			++n;
+		}
+		FT_Done_Face(ftf);
+		if(face.ascent < ascent) face.ascent = ascent;
+		if(face.descent < descent) face.descent = descent;
+		if(verbose_) {
+			printf("  %s@%d: %u glyphs, ascent %d, descent %d\n", file.c_str(), size, n, ascent, descent);
+		}
+		return true;
+	}
+#endif
+
+
+	bool load_face_(const std::string& spec, face_t& face)
+	{
+		std::stringstream ss(spec);
+		std::string src;
+		while(std::getline(ss, src, '+')) {
+			auto pos = src.rfind('@');
+			if(pos == std::string::npos) {
+				if(!load_bdf_(src, face)) return false;
+			} else {
+#ifdef USE_FREETYPE
+				if(!load_ttf_(src.substr(0, pos), atoi(src.c_str() + pos + 1), face)) return false;
+#else
+				std::cerr << "TTF support is not built in (make FREETYPE=1): '" << src << "'" << std::endl;
+				return false;
+#endif
+			}
+		}
+		if(face.glyphs.empty()) {
+			std::cerr << "No glyphs: '" << spec << "'" << std::endl;
+			return false;
+		}
+		return true;
+	}
+
+
+	void enc_raw_(const glyph_t& g, uint8_t bpp, std::vector<uint8_t>& out)
+	{
+		out.clear();
+		uint8_t c = 0;
+		uint32_t sh = 0;
+		for(auto v : g.pix) {
+			c |= v << sh;
+			sh += bpp;
+			if(sh >= 8) {
+				out.push_back(c);
+				c = 0;
+				sh = 0;
+			}
+		}
+		if(sh > 0) out.push_back(c);
+	}
+
+
+	void enc_rle_(const glyph_t& g, uint8_t bpp, std::vector<uint8_t>& out)
+	{
+		out.clear();
+		uint32_t maxl = bpp == 1 ? 128 : 64;
+		uint32_t sh = bpp == 1 ? 7 : 6;
+		uint32_t i = 0;
+		while(i < g.pix.size()) {
+			auto v = g.pix[i];
+			uint32_t n = 1;
+			while((i + n) < g.pix.size() && g.pix[i + n] == v && n < maxl) ++n;
+			out.push_back((v << sh) | (n - 1));
+			i += n;
+		}
+	}
+
+
+	template <typename T>
+	void put_(std::vector<uint8_t>& out, uint32_t ofs, const T& t)
+	{
+		std::memcpy(&out[ofs], &t, sizeof(T));  // little endian
+	}
+
+
+	void align_(std::vector<uint8_t>& out)
+	{
+		while(out.size() & 3) out.push_back(0);
+	}
+
+
+	bool build_(std::vector<face_t>& faces, uint16_t defc, std::vector<uint8_t>& out)
+	{
+		out.assign(sizeof(DEF::header_t) + sizeof(DEF::face_t) * faces.size(), 0);
+		DEF::header_t h;
+		std::memcpy(h.magic, "UFNT", 4);
+		h.version = DEF::VERSION;
+		h.face_num = faces.size();
+		h.size = 0;
+		h.glyph_max = 0;
+
+		uint8_t bpp = aa_ ? 2 : 1;
+		for(uint32_t fi = 0; fi < faces.size(); ++fi) {
+			auto& face = faces[fi];
+			DEF::face_t f;
+			std::memset(&f, 0, sizeof(f));
+			int16_t height = face.ascent + face.descent;
+			if(height > 255) {
+				std::cerr << "Face too large: " << height << std::endl;
+				return false;
+			}
+			f.height = height;
+			f.ascent = face.ascent;
+			f.bpp = bpp;
+			f.glyph_num = face.glyphs.size();
+			if(face.glyphs.find(defc) != face.glyphs.end()) f.def_code = defc;
+			else if(face.glyphs.find('?') != face.glyphs.end()) f.def_code = '?';
+
+			// １段目、２段目
+			uint16_t l1[256];
+			for(auto& v : l1) v = DEF::NO_PAGE;
+			std::vector<DEF::page_t> pages;
+			uint32_t idx = 0;
+			for(const auto& t : face.glyphs) {
+				uint16_t code = t.first;
+				if(l1[code >> 8] == DEF::NO_PAGE) {
+					l1[code >> 8] = pages.size();
+					DEF::page_t pg;
+					std::memset(&pg, 0, sizeof(pg));
+					pg.base = idx;
+					pages.push_back(pg);
+				}
+				auto& pg = pages[l1[code >> 8]];
+				pg.bits[(code & 0xff) >> 5] |= 1UL << (code & 31);
+				++idx;
+			}
+			f.page_num = pages.size();
+
+			f.l1_ofs = out.size();
+			out.resize(out.size() + sizeof(l1));
+			std::memcpy(&out[f.l1_ofs], l1, sizeof(l1));
+			align_(out);
+			f.l2_ofs = out.size();
+			for(const auto& pg : pages) {
+				auto o = out.size();
+				out.resize(o + sizeof(pg));
+				put_(out, o, pg);
+			}
+			align_(out);
+			f.glyph_ofs = out.size();
+			out.resize(out.size() + sizeof(DEF::glyph_t) * face.glyphs.size());
+			align_(out);
+			f.bits_ofs = out.size();
+
+			std::vector<uint8_t> raw, rle;
+			uint32_t gi = 0;
+			uint32_t nraw = 0, nrle = 0, maxlen = 0;
+			for(const auto& t : face.glyphs) {
+				const auto& g = t.second;
+				DEF::glyph_t dg;
+				dg.ofs = out.size() - f.bits_ofs;
+				int by = face.ascent - g.top;
+				if(g.w > 255 || g.h > 255 || g.adv < 0 || g.adv > 255 || g.bx < -128 || g.bx > 127
+				  || by < -128 || by > 127) {
+					std::cerr << "Glyph out of range: U+" << std::hex << t.first << std::dec << std::endl;
+					return false;
+				}
+				dg.w = g.w;
+				dg.h = g.h;
+				dg.bx = g.bx;
+				dg.by = by;
+				dg.adv = g.adv;
+				if(f.max_adv < g.adv) f.max_adv = g.adv;
+				enc_raw_(g, bpp, raw);
+				enc_rle_(g, bpp, rle);
+				const auto& src = rle.size() <= raw.size() ? rle : raw;
+				if(&src == &rle) {
+					dg.enc = DEF::ENC::RLE;
+					++nrle;
+				} else {
+					dg.enc = DEF::ENC::RAW;
+					++nraw;
+				}
+				if(src.size() > 0xffff) {
+					std::cerr << "Glyph too large: U+" << std::hex << t.first << std::dec << std::endl;
+					return false;
+				}
+				dg.len = src.size();
+				if(maxlen < dg.len) maxlen = dg.len;
+				out.insert(out.end(), src.begin(), src.end());
+				put_(out, f.glyph_ofs + gi * sizeof(DEF::glyph_t), dg);
+				++gi;
+			}
+			f.bits_size = out.size() - f.bits_ofs;
+			align_(out);
+			put_(out, sizeof(DEF::header_t) + fi * sizeof(DEF::face_t), f);
+
+			printf("Face %u: height %u (ascent %u), %ubpp, %u glyphs, %u pages, bits %u bytes"
+				" (RLE %u, RAW %u, max %u)\n",
+				fi, f.height, f.ascent, f.bpp, f.glyph_num, f.page_num, f.bits_size,
+				nrle, nraw, maxlen);
+			if(h.glyph_max < maxlen) h.glyph_max = maxlen;
+		}
+		if(h.glyph_max > TEMP_SIZE) {
+			printf("Note: ufont_file needs TSIZE %u or larger (default %u)\n", h.glyph_max, TEMP_SIZE);
+		}
+		h.size = out.size();
+		put_(out, 0, h);
+		return true;
+	}
+
+
+	bool write_(const std::string& file, const std::vector<uint8_t>& out, const std::string& sym)
+	{
+		std::ofstream ofs(file, std::ios::binary);
+		if(!ofs) {
+			std::cerr << "Can't write: '" << file << "'" << std::endl;
+			return false;
+		}
+		if(sym.empty()) {
+			ofs.write(reinterpret_cast<const char*>(out.data()), out.size());
+		} else {
+			// ROM に置く場合の C++ ソース
+			ofs << "// ufontconv " << version_ << "\n#include <cstdint>\n\n";
+			ofs << "alignas(4) extern const uint8_t " << sym << "[] = {\n";
+			char tmp[8];
+			for(uint32_t i = 0; i < out.size(); ++i) {
+				if((i & 15) == 0) ofs << "\t";
+				snprintf(tmp, sizeof(tmp), "0x%02x,", out[i]);
+				ofs << tmp;
+				if((i & 15) == 15 || (i + 1) == out.size()) ofs << "\n";
+			}
+			ofs << "};\n";
+			ofs << "extern const uint32_t " << sym << "_size = " << out.size() << ";\n";
+		}
+		return true;
+	}
+
+
+	void help_(const char* cmd)
+	{
+		printf("Unicode font converter Version %s\n", version_);
+		printf("usage:\n");
+		printf("    %s [options] face [face ...]\n", cmd);
+		printf("    face: source[+source...]  (sources are merged, the first one wins)\n");
+		printf("    source: file.bdf | file.ttf@pixel-size\n");
+		printf("    -o file     output file (default: font.ufn)\n");
+		printf("    -c symbol   output C++ source (const uint8_t symbol[]) for ROM\n");
+		printf("    -2          2 bits per pixel (anti-aliased, TTF)\n");
+		printf("    -r ranges   code ranges, ex: 0x20-0x7e,0x3000-0x9fff\n");
+		printf("    -d code     glyph for missing code (default: 0x3013, or '?')\n");
+		printf("    -v          verbose\n");
+	}
+}
+
+
+int main(int argc, char* argv[])
+{
+	std::string out_file = "font.ufn";
+	std::string sym;
+	uint16_t defc = 0x3013;
+	std::vector<std::string> specs;
+	for(int i = 1; i < argc; ++i) {
+		std::string a = argv[i];
+		if(a == "-o" && (i + 1) < argc) out_file = argv[++i];
+		else if(a == "-c" && (i + 1) < argc) sym = argv[++i];
+		else if(a == "-2") aa_ = true;
+		else if(a == "-v") verbose_ = true;
+		else if(a == "-d" && (i + 1) < argc) defc = strtoul(argv[++i], nullptr, 0);
+		else if(a == "-r" && (i + 1) < argc) {
+			if(!parse_ranges_(argv[++i])) {
+				std::cerr << "Illegal range: '" << argv[i] << "'" << std::endl;
+				return 1;
+			}
+		} else if(a[0] == '-') {
+			help_(argv[0]);
+			return 1;
+		} else specs.push_back(a);
+	}
+	if(specs.empty()) {
+		help_(argv[0]);
+		return 1;
+	}
+
+	std::vector<face_t> faces(specs.size());
+	for(uint32_t i = 0; i < specs.size(); ++i) {
+		if(!load_face_(specs[i], faces[i])) return 1;
+	}
+
+	std::vector<uint8_t> out;
+	if(!build_(faces, defc, out)) return 1;
+	if(!write_(out_file, out, sym)) return 1;
+	printf("Write: '%s' %u bytes\n", out_file.c_str(), static_cast<uint32_t>(out.size()));
+	return 0;
+}
@@ -1,7 +1,9 @@
 #pragma once
 //=====================================================================//
 /*!	@file
-	@brief	USB Host Mass Strage Class
+	@brief	USB Host Mass Strage Class @n
+			・start_read/start_write で READ(10)/WRITE(10) を発行し、@n
+			  probe_trans、sync_trans で完了を調べる（fatfs::disk_queue から使う）
     @author 平松邦仁 (hira@rvf-rc45.net)
 	@copyright	Copyright (C) 2020 Kunihito Hiramatsu @n
 				Released under the MIT license @n
@@ -39,6 +41,11 @@ namespace usb_host {
 
 		bool		mount_;
 
+		BYTE		trans_drv_;
+		bool		trans_;			///< 転送中
+		bool		trans_pend_;	///< 結果を sync_trans で取り出していない
+		DRESULT		trans_result_;
+
 		void wait_loop_()
 		{
 			if(usb_cstd_check_schedule() == USB_FLGSET) {
@@ -57,7 +64,8 @@ namespace usb_host {
 			@param[in]	usb	USB_IO インスタンス
 		*/
 		//-----------------------------------------------------------------//
-		hmsc(USB_IO& usb) : usb_(usb), ctrl_(), fatfs_(), mount_(false) { }
+		hmsc(USB_IO& usb) : usb_(usb), ctrl_(), fatfs_(), mount_(false),
+			trans_drv_(0), trans_(false), trans_pend_(false), trans_result_(RES_OK) { }
 
 
 		//-----------------------------------------------------------------//
@@ -110,16 +118,22 @@ namespace usb_host {
 
 		//-----------------------------------------------------------------//
 		/*!
-			@brief	リード・セクター
+			@brief	リード・セクター開始 @n
+					READ(10) を発行して直ぐに戻る（probe_trans、sync_trans で完了を待つ）
 			@param[in]	drv		Physical drive nmuber (0)
 			@param[out]	buff	Pointer to the data buffer to store read data
 			@param[in]	sector	Start sector number (LBA)
-			@param[in]	count	Sector count (1..128)
+			@param[in]	count	Sector count (1..65535)
+			@return 結果
 		 */
 		//-----------------------------------------------------------------//
-		DRESULT disk_read(BYTE drv, void* buff, DWORD sector, UINT count) noexcept
+		DRESULT start_read(BYTE drv, void* buff, DWORD sector, UINT count) noexcept
 		{
-			uint32_t len = count * SECTOR_SIZE;
+			if(count == 0 || count > 0xffff) return RES_PARERR;
+
+			// 前の転送の終了を待つ（前の転送の結果は、この転送には返さない）
+			while(probe_trans()) ;
+			trans_pend_ = false;
 
 			usb_utr_t t;
 			usb_hmsc_smp_drive2_addr(drv, &t);
@@ -128,51 +142,37 @@ namespace usb_host {
 				return RES_ERROR;
 			}
 
-			auto err = R_USB_HmscStrgReadSector(&t, drv, static_cast<uint8_t*>(buff), sector, count, len);
+			auto err = R_USB_HmscStrgReadSector(&t, drv, static_cast<uint8_t*>(buff), sector, count,
+				count * SECTOR_SIZE);
 			if(USB_OK != err) {
-        		return RES_ERROR;
-    		}
-
-			uint16_t res = 0;
-			usb_utr_t* mess = nullptr;
-			do {
-				res = R_USB_HmscGetDevSts(drv);
-				wait_loop_();
-				err = USB_TRCV_MSG(USB_HSTRG_MBX, (usb_msg_t**)&mess, 0);
-			} while((err != USB_OK) && (res != USB_FALSE)) ;
-
-			if(err == USB_OK) { // Complete R_USB_HmscStrgReadSector()
-				err = mess->result;
-				USB_REL_BLK(USB_HSTRG_MPL, (usb_mh_t)mess);
-			} else { // Device detach
-				wait_loop_();
-				err = USB_TRCV_MSG(USB_HSTRG_MBX, (usb_msg_t**)&mess, 0);
-				if(USB_OK == err) {
-					USB_REL_BLK(USB_HSTRG_MPL, (usb_mh_t)mess);
-				}
-				err = USB_ERROR;
-			}
-
-			if(err != USB_OK) {
 				return RES_ERROR;
 			}
-
+			trans_drv_ = drv;
+			trans_ = true;
+			trans_pend_ = true;
+			trans_result_ = RES_OK;
 			return RES_OK;
 		}
 
 
 		//-----------------------------------------------------------------//
 		/*!
-			@brief	ライト・セクター
+			@brief	ライト・セクター開始 @n
+					WRITE(10) を発行して直ぐに戻る（probe_trans、sync_trans で完了を待つ）
 			@param[in]	drv		Physical drive nmuber (0)
-			@param[in]	buff	Pointer to the data to be written	
+			@param[in]	buff	Pointer to the data to be written
 			@param[in]	sector	Start sector number (LBA)
-			@param[in]	count	Sector count (1..128)
+			@param[in]	count	Sector count (1..65535)
+			@return 結果
 		 */
 		//-----------------------------------------------------------------//
-		DRESULT disk_write(BYTE drv, const void* buff, DWORD sector, UINT count) noexcept
+		DRESULT start_write(BYTE drv, const void* buff, DWORD sector, UINT count) noexcept
 		{
-			uint32_t len = count * SECTOR_SIZE;
+			if(count == 0 || count > 0xffff) return RES_PARERR;
+
+			// 前の転送の終了を待つ（前の転送の結果は、この転送には返さない）
+			while(probe_trans()) ;
+			trans_pend_ = false;
 
 			usb_utr_t t;
 			usb_hmsc_smp_drive2_addr(drv, &t);
@@ -181,39 +181,100 @@ namespace usb_host {
 				return RES_ERROR;
 			}
 
-///			auto err = R_USB_HmscStrgWriteSector(&t, drv, static_cast<const uint8_t*>(buff), sector, count, len);
-			auto err = R_USB_HmscStrgWriteSector(&t, drv, (uint8_t*)(buff), sector, count, len);
+			auto err = R_USB_HmscStrgWriteSector(&t, drv, (uint8_t*)(buff), sector, count,
+				count * SECTOR_SIZE);
 			if(USB_OK != err) {
 				return RES_ERROR;
 			}
+			trans_drv_ = drv;
+			trans_ = true;
+			trans_pend_ = true;
+			trans_result_ = RES_OK;
+			return RES_OK;
+		}
 
-			uint16_t res = 0;
-			usb_utr_t* mess = nullptr;
-			do {
-				res = R_USB_HmscGetDevSts(drv);
-
-				wait_loop_();
 
-				err = USB_TRCV_MSG(USB_HSTRG_MBX, (usb_msg_t**)&mess, 0);
-			} while ((err != USB_OK) && (res != USB_FALSE));
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	転送中か検査 @n
+					USB のスケジューラーを一回まわして、完了メッセージを調べる
+			@return 転送中なら「true」
+		 */
+		//-----------------------------------------------------------------//
+		bool probe_trans() noexcept
+		{
+			if(!trans_) return false;
 
-			if(USB_OK == err) {
+			auto res = R_USB_HmscGetDevSts(trans_drv_);
+			wait_loop_();
+			usb_utr_t* mess = nullptr;
+			auto err = USB_TRCV_MSG(USB_HSTRG_MBX, (usb_msg_t**)&mess, 0);
+			if(err == USB_OK) {  // Complete R_USB_HmscStrgRead/WriteSector()
 				err = mess->result;
 				USB_REL_BLK(USB_HSTRG_MPL, (usb_mh_t)mess);
-			} else {
+			} else if(res == USB_FALSE) {  // Device detach
 				wait_loop_();
 				err = USB_TRCV_MSG(USB_HSTRG_MBX, (usb_msg_t**)&mess, 0);
-				if(err == USB_OK) {
+				if(USB_OK == err) {
 					USB_REL_BLK(USB_HSTRG_MPL, (usb_mh_t)mess);
 				}
 				err = USB_ERROR;
+			} else {
+				return true;
 			}
+			trans_result_ = err == USB_OK ? RES_OK : RES_ERROR;
+			trans_ = false;
+			return false;
+		}
 
-			if(err != USB_OK) {
-				return RES_ERROR;
-			}
 
-			return RES_OK;
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	転送の完了を待つ @n
+					結果は、最後に開始した転送のもので、一度だけ返す
+			@return 結果（取り出し済み、又は、転送が無い場合「RES_OK」）
+		 */
+		//-----------------------------------------------------------------//
+		DRESULT sync_trans() noexcept
+		{
+			while(probe_trans()) ;
+			if(!trans_pend_) return RES_OK;
+			trans_pend_ = false;
+			return trans_result_;
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	リード・セクター
+			@param[in]	drv		Physical drive nmuber (0)
+			@param[out]	buff	Pointer to the data buffer to store read data
+			@param[in]	sector	Start sector number (LBA)
+			@param[in]	count	Sector count (1..128)
+		 */
+		//-----------------------------------------------------------------//
+		DRESULT disk_read(BYTE drv, void* buff, DWORD sector, UINT count) noexcept
+		{
+			auto ret = start_read(drv, buff, sector, count);
+			if(ret != RES_OK) return ret;
+			return sync_trans();
+		}
+
+
+		//-----------------------------------------------------------------//
+		/*!
+			@brief	ライト・セクター
+			@param[in]	drv		Physical drive nmuber (0)
+			@param[in]	buff	Pointer to the data to be written	
+			@param[in]	sector	Start sector number (LBA)
+			@param[in]	count	Sector count (1..128)
+		 */
+		//-----------------------------------------------------------------//
+		DRESULT disk_write(BYTE drv, const void* buff, DWORD sector, UINT count) noexcept
+		{
+			auto ret = start_write(drv, buff, sector, count);
+			if(ret != RES_OK) return ret;
+			return sync_trans();
 		}
 
 
@@ -227,6 +288,9 @@ namespace usb_host {
 		//-----------------------------------------------------------------//
 		DRESULT disk_ioctl(BYTE drv, BYTE ctrl, void* buff) noexcept
 		{
+			if(ctrl == CTRL_SYNC) {
+				return sync_trans();
+			}
 			return RES_OK;
 		}
 